@@ -7,6 +7,7 @@
 #include "ColorRuleHelper.h"
 #include "MainResource.h"
 #include "ResourceHelper.h"
+#include "../Helper/CompiledWildcard.h"
 #include "../Helper/Helper.h"
 #include "../Helper/Macros.h"
 #include "../Helper/StringHelper.h"
@@ -289,9 +290,13 @@ void ColorRuleDialogPersistentSettings::SaveExtraXMLSettings(
 
 void ColorRuleDialogPersistentSettings::LoadExtraXMLSettings(BSTR bstrName,BSTR bstrValue)
 {
-	if(CheckWildcardMatch(_T("r*"),bstrName,TRUE) ||
-		CheckWildcardMatch(_T("g*"),bstrName,TRUE) ||
-		CheckWildcardMatch(_T("b*"),bstrName,TRUE))
+	CompiledWildcard redComponent(_T("r*"),true);
+	CompiledWildcard greenComponent(_T("g*"),true);
+	CompiledWildcard blueComponent(_T("b*"),true);
+
+	if(redComponent.Match(bstrName) ||
+		greenComponent.Match(bstrName) ||
+		blueComponent.Match(bstrName))
 	{
 		/* At the very least, the attribute name
 		should reference a color component and index. */
@@ -315,11 +320,11 @@ void ColorRuleDialogPersistentSettings::LoadExtraXMLSettings(BSTR bstrName,BSTR
 		COLORREF clr = m_cfCustomColors[iIndex];
 		BYTE c = static_cast<BYTE>(NXMLSettings::DecodeIntValue(bstrValue));
 
-		if(CheckWildcardMatch(_T("r*"),bstrName,TRUE))
+		if(redComponent.Match(bstrName))
 			m_cfCustomColors[iIndex] = RGB(c,GetGValue(clr),GetBValue(clr));
-		else if(CheckWildcardMatch(_T("g*"),bstrName,TRUE))
+		else if(greenComponent.Match(bstrName))
 			m_cfCustomColors[iIndex] = RGB(GetRValue(clr),c,GetBValue(clr));
-		else if(CheckWildcardMatch(_T("b*"),bstrName,TRUE))
+		else if(blueComponent.Match(bstrName))
 			m_cfCustomColors[iIndex] = RGB(GetRValue(clr),GetGValue(clr),c);
 	}
 	else
@@ -13,9 +13,14 @@
 #include "../Helper/SetDefaultFileManager.h"
 #include "../Helper/ShellHelper.h"
 #include "../Helper/StringHelper.h"
+#include "../Helper/ThumbnailLevels.h"
 
 static const int DEFAULT_LISTVIEW_HOVER_TIME = 500;
 
+/* In megabytes. */
+static const int DEFAULT_THUMBNAIL_MEMORY_BUDGET = 256;
+static const int MIN_THUMBNAIL_MEMORY_BUDGET = 16;
+
 enum StartupMode_t
 {
 	STARTUP_PREVIOUSTABS = 1,
@@ -61,6 +66,7 @@ struct Config
 		handleZipFiles = FALSE;
 		overwriteExistingFilesConfirmation = TRUE;
 		checkBoxSelection = FALSE;
+		virtualListView = FALSE;
 		closeMainWindowOnTabClose = TRUE;
 		playNavigationSound = TRUE;
 		confirmCloseTabs = FALSE;
@@ -100,6 +106,8 @@ struct Config
 		globalFolderSettings.sizeDisplayFormat = SIZE_FORMAT_BYTES;
 		globalFolderSettings.oneClickActivate = FALSE;
 		globalFolderSettings.oneClickActivateHoverTime = DEFAULT_LISTVIEW_HOVER_TIME;
+		globalFolderSettings.thumbnailSize = ThumbnailLevels::DEFAULT_THUMBNAIL_SIZE;
+		globalFolderSettings.thumbnailMemoryBudget = DEFAULT_THUMBNAIL_MEMORY_BUDGET;
 
 		globalFolderSettings.folderColumns.realFolderColumns = std::vector<Column_t>(std::begin(REAL_FOLDER_DEFAULT_COLUMNS), std::end(REAL_FOLDER_DEFAULT_COLUMNS));
 		globalFolderSettings.folderColumns.myComputerColumns = std::vector<Column_t>(std::begin(MY_COMPUTER_DEFAULT_COLUMNS), std::end(MY_COMPUTER_DEFAULT_COLUMNS));
@@ -151,6 +159,14 @@ struct Config
 	BOOL handleZipFiles;
 	BOOL overwriteExistingFilesConfirmation;
 	BOOL checkBoxSelection;
+
+	// Shows folders in an owner-data listview, which only stores the number
+	// of items (rather than a copy of each one). Only applies to tabs
+	// created after the setting is changed. Groups and item positions
+	// aren't supported in this mode, items can't be selected with
+	// checkboxes and tiles only show the item name.
+	BOOL virtualListView;
+
 	BOOL closeMainWindowOnTabClose;
 	BOOL playNavigationSound;
 	BOOL confirmCloseTabs;
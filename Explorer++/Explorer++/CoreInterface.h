@@ -20,8 +20,11 @@ enum MousewheelSource_t
 };
 
 class CachedIcons;
+class ColorRuleSet;
+class ColumnCache;
 struct Config;
 class ShellBrowser;
+class ThumbnailCache;
 __interface IDirectoryMonitor;
 class TabContainer;
 
@@ -43,6 +46,9 @@ __interface IExplorerplusplus
 
 	IconResourceLoader	*GetIconResourceLoader() const;
 	CachedIcons		*GetCachedIcons();
+	ColumnCache		*GetColumnCache();
+	ThumbnailCache	*GetThumbnailCache();
+	const ColorRuleSet	*GetColorRuleSet() const;
 
 	HWND			GetTreeView() const;
 
@@ -7,7 +7,6 @@
 #include "Config.h"
 #include "MainResource.h"
 #include "../DisplayWindow/DisplayWindow.h"
-#include "../Helper/FolderSize.h"
 #include "../Helper/ShellHelper.h"
 
 void Explorerplusplus::UpdateDisplayWindow(const Tab &tab)
@@ -122,54 +121,28 @@ void Explorerplusplus::UpdateDisplayWindowForOneFile(const Tab &tab)
 			if (((dwAttributes & FILE_ATTRIBUTE_DIRECTORY) ==
 				FILE_ATTRIBUTE_DIRECTORY) && m_config->globalFolderSettings.showFolderSizes)
 			{
-				FolderSize_t	*pfs = NULL;
-				FolderSizeExtraInfo_t	*pfsei = NULL;
 				DWFolderSize_t	DWFolderSize;
 				TCHAR			szDisplayText[256];
 				TCHAR			szTotalSize[64];
 				TCHAR			szCalculating[64];
-				DWORD			ThreadId;
 
-				pfs = (FolderSize_t *)malloc(sizeof(FolderSize_t));
+				LoadString(m_hLanguageModule, IDS_GENERAL_TOTALSIZE,
+					szTotalSize, SIZEOF_ARRAY(szTotalSize));
+				LoadString(m_hLanguageModule, IDS_GENERAL_CALCULATING,
+					szCalculating, SIZEOF_ARRAY(szCalculating));
+				StringCchPrintf(szDisplayText, SIZEOF_ARRAY(szDisplayText),
+					_T("%s: %s"), szTotalSize, szCalculating);
+				DisplayWindow_BufferText(m_hDisplayWindow, szDisplayText);
 
-				if (pfs != NULL)
-				{
-					pfsei = (FolderSizeExtraInfo_t *)malloc(sizeof(FolderSizeExtraInfo_t));
-
-					if (pfsei != NULL)
-					{
-						pfsei->pContainer = (void *)this;
-						pfsei->uId = m_iDWFolderSizeUniqueId;
-						pfs->pData = (LPVOID)pfsei;
-
-						pfs->pfnCallback = FolderSizeCallbackStub;
-
-						StringCchCopy(pfs->szPath, SIZEOF_ARRAY(pfs->szPath), szFullItemName);
-
-						LoadString(m_hLanguageModule, IDS_GENERAL_TOTALSIZE,
-							szTotalSize, SIZEOF_ARRAY(szTotalSize));
-						LoadString(m_hLanguageModule, IDS_GENERAL_CALCULATING,
-							szCalculating, SIZEOF_ARRAY(szCalculating));
-						StringCchPrintf(szDisplayText, SIZEOF_ARRAY(szDisplayText),
-							_T("%s: %s"), szTotalSize, szCalculating);
-						DisplayWindow_BufferText(m_hDisplayWindow, szDisplayText);
+				/* Maintain a global list of folder size operations. */
+				DWFolderSize.uId = m_iDWFolderSizeUniqueId;
+				DWFolderSize.iTabId = m_tabContainer->GetSelectedTab().GetId();
+				DWFolderSize.bValid = TRUE;
+				m_DWFolderSizes.push_back(DWFolderSize);
 
-						/* Maintain a global list of folder size operations. */
-						DWFolderSize.uId = m_iDWFolderSizeUniqueId;
-						DWFolderSize.iTabId = m_tabContainer->GetSelectedTab().GetId();
-						DWFolderSize.bValid = TRUE;
-						m_DWFolderSizes.push_back(DWFolderSize);
+				CalculateDisplayWindowFolderSize(szFullItemName, m_iDWFolderSizeUniqueId);
 
-						HANDLE hThread = CreateThread(NULL, 0, Thread_CalculateFolderSize, (LPVOID)pfs, 0, &ThreadId);
-						CloseHandle(hThread);
-
-						m_iDWFolderSizeUniqueId++;
-					}
-					else
-					{
-						free(pfs);
-					}
-				}
+				m_iDWFolderSizeUniqueId++;
 			}
 			else
 			{
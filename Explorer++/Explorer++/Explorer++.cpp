@@ -16,6 +16,7 @@
 #include "PluginManager.h"
 #include "ResourceHelper.h"
 #include "ShellBrowser/ViewModes.h"
+#include "../Helper/IconFetcher.h"
 #include "../Helper/iDirectoryMonitor.h"
 #include "../Helper/ShellHelper.h"
 
@@ -34,10 +35,13 @@ const std::vector<std::wstring> Explorerplusplus::BLACKLISTED_BACKGROUND_MENU_CL
 
 Explorerplusplus::Explorerplusplus(HWND hwnd) :
 	m_hContainer(hwnd),
-	m_cachedIcons(MAX_CACHED_ICONS),
+	m_cachedIcons(MAX_CACHED_ICONS, IconFetcher::ResolveIconLocation),
+	m_columnCache(MAX_COLUMN_CACHE_SIZE),
+	m_thumbnailCache(MAX_THUMBNAIL_CACHE_SIZE),
 	m_pluginMenuManager(hwnd, MENU_PLUGIN_STARTID, MENU_PLUGIN_ENDID),
 	m_acceleratorUpdater(&g_hAccl),
-	m_pluginCommandManager(&g_hAccl, ACCELERATOR_PLUGIN_STARTID, ACCELERATOR_PLUGIN_ENDID)
+	m_pluginCommandManager(&g_hAccl, ACCELERATOR_PLUGIN_STARTID, ACCELERATOR_PLUGIN_ENDID),
+	m_folderSizeTasks(TaskExecutor::GetShared())
 {
 	m_hLanguageModule				= nullptr;
 
@@ -21,9 +21,13 @@
 #include "UiTheming.h"
 #include "ValueWrapper.h"
 #include "../Helper/CachedIcons.h"
+#include "../Helper/ColorRuleSet.h"
+#include "../Helper/ColumnCache.h"
 #include "../Helper/DpiCompatibility.h"
 #include "../Helper/FileActionHandler.h"
 #include "../Helper/FileContextMenuManager.h"
+#include "../Helper/TaskExecutor.h"
+#include "../Helper/ThumbnailCache.h"
 #include <boost/optional.hpp>
 #include <boost/signals2.hpp>
 #include <wil/resource.h>
@@ -120,6 +124,15 @@ private:
 	// shared between various components in the application.
 	static const int MAX_CACHED_ICONS = 1000;
 
+	// The maximum amount of memory (in bytes) used to cache column text. This
+	// cache is shared between tabs and saved on exit.
+	static const size_t MAX_COLUMN_CACHE_SIZE = 16 * 1024 * 1024;
+
+	// The maximum size (in bytes) of the thumbnail cache, both in memory and
+	// on disk. At the default thumbnail size, this is enough for around
+	// 4000 thumbnails.
+	static const size_t MAX_THUMBNAIL_CACHE_SIZE = 256 * 1024 * 1024;
+
 	struct SortMenuItem
 	{
 		UINT SortById;
@@ -143,6 +156,10 @@ private:
 		ULARGE_INTEGER	liFolderSize;
 		int				uId;
 		int				iTabId;
+
+		/* Set once the size has been fully calculated.
+		Otherwise, the size is a running total. */
+		BOOL			bFinished;
 	};
 
 	struct DWFolderSize_t
@@ -152,12 +169,6 @@ private:
 		BOOL bValid;
 	};
 
-	struct FolderSizeExtraInfo_t
-	{
-		void	*pContainer;
-		int		uId;
-	};
-
 	LRESULT CALLBACK		WindowProcedure(HWND hwnd,UINT Msg,WPARAM wParam,LPARAM lParam);
 
 	static LRESULT CALLBACK	ListViewProcStub(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam,
@@ -341,10 +352,14 @@ private:
 	void					SaveAllSettings();
 	void					LoadAllSettings(ILoadSave **pLoadSave);
 	void					ValidateLoadedSettings();
+	void					UpdateColorRuleSet();
 	void					ValidateColumns(FolderColumns &folderColumns);
 	void					ValidateSingleColumnSet(int iColumnSet, std::vector<Column_t> &columns);
 	void					ApplyToolbarSettings(void);
 	void					TestConfigFile(void);
+	std::wstring			GetCacheFilePath(const TCHAR *fileName) const;
+	void					LoadCaches();
+	void					SaveCaches();
 
 	/* Registry settings. */
 	LONG					LoadGenericSettingsFromRegistry();
@@ -473,6 +488,9 @@ private:
 	IDirectoryMonitor		*GetDirectoryMonitor() const;
 	IconResourceLoader		*GetIconResourceLoader() const;
 	CachedIcons				*GetCachedIcons();
+	ColumnCache				*GetColumnCache();
+	ThumbnailCache			*GetThumbnailCache();
+	const ColorRuleSet		*GetColorRuleSet() const;
 	BOOL					GetSavePreferencesToXmlFile() const;
 	void					SetSavePreferencesToXmlFile(BOOL savePreferencesToXmlFile);
 
@@ -496,8 +514,7 @@ private:
 	void					HandleDirectoryMonitoring(int iTabId);
 	int						DetermineListViewObjectIndex(HWND hListView);
 
-	static void				FolderSizeCallbackStub(int nFolders, int nFiles, PULARGE_INTEGER lTotalFolderSize, LPVOID pData);
-	void					FolderSizeCallback(FolderSizeExtraInfo_t *pfsei,int nFolders,int nFiles,PULARGE_INTEGER lTotalFolderSize);
+	void					CalculateDisplayWindowFolderSize(const std::wstring &path, int uId);
 
 	HWND					m_hContainer;
 	HWND					m_hStatusBar;
@@ -543,6 +560,8 @@ private:
 	DpiCompatibility		m_dpiCompat;
 
 	CachedIcons				m_cachedIcons;
+	ColumnCache				m_columnCache;
+	ThumbnailCache			m_thumbnailCache;
 
 	MainMenuPreShowSignal	m_mainMenuPreShowSignal;
 
@@ -582,6 +601,12 @@ private:
 	/* Customize colors. */
 	std::vector<NColorRuleHelper::ColorRule_t>	m_ColorRules;
 
+	/* The rules above, compiled. Each tab classifies its
+	items against these rules as the items are added, so
+	that drawing an item doesn't require the rules to be
+	checked. */
+	ColorRuleSet			m_colorRuleSet;
+
 	/* Undo support. */
 	FileActionHandler		m_FileActionHandler;
 
@@ -594,6 +619,7 @@ private:
 	/* Display window folder sizes. */
 	std::list<DWFolderSize_t>	m_DWFolderSizes;
 	int						m_iDWFolderSizeUniqueId;
+	TaskGroup				m_folderSizeTasks;
 
 	/* Copy/cut. */
 	IDataObject				*m_pClipboardDataObject;
@@ -21,6 +21,12 @@ namespace NExplorerplusplus
 	saved to/loaded from. */
 	const TCHAR XML_FILENAME[]		= _T("config.xml");
 
+	/* The files that the column and thumbnail
+	caches are saved to. */
+	const TCHAR COLUMN_CACHE_FILENAME[]	= _T("ColumnCache.dat");
+	const TCHAR ICON_CACHE_FILENAME[]	= _T("IconCache.dat");
+	const TCHAR THUMBNAIL_CACHE_FILENAME[]	= _T("ThumbnailCache.dat");
+
 	const TCHAR LOG_FILENAME[]		= _T("Explorer++.log");
 
 	/* Command line arguments supplied to the program
@@ -40,6 +40,11 @@ void Explorerplusplus::OnCreate()
 	LoadAllSettings(&pLoadSave);
 	ApplyToolbarSettings();
 
+	/* The location of the caches depends on where
+	settings are saved, so this has to happen after
+	they've been loaded. */
+	LoadCaches();
+
 	m_iconResourceLoader = std::make_unique<IconResourceLoader>(m_config->iconTheme);
 
 	SetLanguageModule();
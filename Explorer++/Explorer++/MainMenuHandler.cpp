@@ -19,12 +19,14 @@
 #include "ScriptingDialog.h"
 #include "SearchDialog.h"
 #include "SplitFileDialog.h"
+#include "TabContainer.h"
 #include "UpdateCheckDialog.h"
 #include "WildcardSelectDialog.h"
 #include "MainResource.h"
 #include "../Helper/ListViewHelper.h"
 #include "../Helper/ProcessHelper.h"
 #include "../Helper/ShellHelper.h"
+#include <boost/range/adaptor/map.hpp>
 #include <boost/scope_exit.hpp>
 #include <wil/com.h>
 
@@ -122,6 +124,13 @@ void Explorerplusplus::OnCustomizeColors()
 	CustomizeColorsDialog customizeColorsDialog(m_hLanguageModule, m_hContainer, this, &m_ColorRules);
 	customizeColorsDialog.ShowModalDialog();
 
+	UpdateColorRuleSet();
+
+	for(auto &tab : m_tabContainer->GetAllTabs() | boost::adaptors::map_values)
+	{
+		tab->GetShellBrowser()->OnColorRulesChanged();
+	}
+
 	/* Causes the active listview to redraw (therefore
 	applying any updated color schemes). */
 	InvalidateRect(m_hActiveListView, NULL, FALSE);
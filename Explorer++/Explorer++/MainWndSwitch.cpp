@@ -172,8 +172,9 @@ LRESULT CALLBACK Explorerplusplus::WindowProcedure(HWND hwnd,UINT Msg,WPARAM wPa
 		{
 			DWFolderSizeCompletion_t *pDWFolderSizeCompletion = NULL;
 			TCHAR szFolderSize[32];
-			TCHAR szSizeString[64];
+			TCHAR szSizeString[128];
 			TCHAR szTotalSize[64];
+			TCHAR szCalculating[64];
 			BOOL bValid = FALSE;
 
 			pDWFolderSizeCompletion = (DWFolderSizeCompletion_t *)wParam;
@@ -193,7 +194,12 @@ LRESULT CALLBACK Explorerplusplus::WindowProcedure(HWND hwnd,UINT Msg,WPARAM wPa
 						bValid = itr->bValid;
 					}
 
-					m_DWFolderSizes.erase(itr);
+					/* Running totals may be sent before the
+					final result. */
+					if(pDWFolderSizeCompletion->bFinished)
+					{
+						m_DWFolderSizes.erase(itr);
+					}
 
 					break;
 				}
@@ -208,8 +214,19 @@ LRESULT CALLBACK Explorerplusplus::WindowProcedure(HWND hwnd,UINT Msg,WPARAM wPa
 				LoadString(m_hLanguageModule,IDS_GENERAL_TOTALSIZE,
 					szTotalSize,SIZEOF_ARRAY(szTotalSize));
 
-				StringCchPrintf(szSizeString,SIZEOF_ARRAY(szSizeString),
-					_T("%s: %s"),szTotalSize,szFolderSize);
+				if(pDWFolderSizeCompletion->bFinished)
+				{
+					StringCchPrintf(szSizeString,SIZEOF_ARRAY(szSizeString),
+						_T("%s: %s"),szTotalSize,szFolderSize);
+				}
+				else
+				{
+					LoadString(m_hLanguageModule,IDS_GENERAL_CALCULATING,
+						szCalculating,SIZEOF_ARRAY(szCalculating));
+
+					StringCchPrintf(szSizeString,SIZEOF_ARRAY(szSizeString),
+						_T("%s: %s (%s)"),szTotalSize,szFolderSize,szCalculating);
+				}
 
 				/* TODO: The line index should be stored in some other (variable) way. */
 				DisplayWindow_SetLine(m_hDisplayWindow,FOLDER_SIZE_LINE_INDEX,szSizeString);
@@ -10,6 +10,7 @@
 #include "MainResource.h"
 #include "SelectColumnsDialog.h"
 #include "../Helper/Controls.h"
+#include "../Helper/FolderSizeService.h"
 #include "../Helper/Logging.h"
 #include "../Helper/Macros.h"
 #include "../Helper/WindowHelper.h"
@@ -305,32 +306,48 @@ void *pData)
 	}
 }
 
-void Explorerplusplus::FolderSizeCallbackStub(int nFolders,int nFiles,PULARGE_INTEGER lTotalFolderSize,LPVOID pData)
+void Explorerplusplus::CalculateDisplayWindowFolderSize(const std::wstring &path, int uId)
 {
-	Explorerplusplus::FolderSizeExtraInfo_t *pfsei = reinterpret_cast<Explorerplusplus::FolderSizeExtraInfo_t *>(pData);
-	reinterpret_cast<Explorerplusplus *>(pfsei->pContainer)->FolderSizeCallback(pfsei,nFolders,nFiles,lTotalFolderSize);
-	free(pfsei);
-}
-
-void Explorerplusplus::FolderSizeCallback(FolderSizeExtraInfo_t *pfsei,
-int nFolders,int nFiles,PULARGE_INTEGER lTotalFolderSize)
-{
-	UNREFERENCED_PARAMETER(nFolders);
-	UNREFERENCED_PARAMETER(nFiles);
+	HWND container = m_hContainer;
+	int iTabId = m_tabContainer->GetSelectedTab().GetId();
+	auto cancellationToken = m_folderSizeTasks.GetCancellationToken();
+
+	m_folderSizeTasks.Push(TaskPriority::Visible, [container, path, uId, iTabId, cancellationToken] {
+		/* Results are queued back to the main thread, so that
+		the folder size can be displayed. It is up to the main
+		thread to determine whether the folder size should actually
+		be shown. */
+		auto postResult = [container, uId, iTabId] (const FolderSizeTotals &totals, BOOL bFinished) {
+			auto *pDWFolderSizeCompletion = (DWFolderSizeCompletion_t *)malloc(sizeof(DWFolderSizeCompletion_t));
+
+			if (pDWFolderSizeCompletion == NULL)
+			{
+				return;
+			}
 
-	DWFolderSizeCompletion_t *pDWFolderSizeCompletion = NULL;
+			pDWFolderSizeCompletion->liFolderSize.QuadPart = totals.size;
+			pDWFolderSizeCompletion->uId = uId;
+			pDWFolderSizeCompletion->iTabId = iTabId;
+			pDWFolderSizeCompletion->bFinished = bFinished;
 
-	pDWFolderSizeCompletion = (DWFolderSizeCompletion_t *)malloc(sizeof(DWFolderSizeCompletion_t));
+			if (!PostMessage(container, WM_APP_FOLDERSIZECOMPLETED, (WPARAM)pDWFolderSizeCompletion, 0))
+			{
+				free(pDWFolderSizeCompletion);
+			}
+		};
 
-	pDWFolderSizeCompletion->liFolderSize = *lTotalFolderSize;
-	pDWFolderSizeCompletion->uId = pfsei->uId;
+		/* The running total is shown while the folder is
+		being counted, so that large folders show progress. */
+		auto totals = FolderSizeService::GetShared().CalculateSize(path, cancellationToken,
+			[&postResult] (const FolderSizeTotals &partialTotals) {
+			postResult(partialTotals, FALSE);
+		});
 
-	/* Queue the result back to the main thread, so that
-	the folder size can be displayed. It is up to the main
-	thread to determine whether the folder size should actually
-	be shown. */
-	PostMessage(m_hContainer,WM_APP_FOLDERSIZECOMPLETED,
-		(WPARAM)pDWFolderSizeCompletion,0);
+		if (totals)
+		{
+			postResult(*totals, TRUE);
+		}
+	}, TaskKind::Blocking);
 }
 
 void Explorerplusplus::OnSelectColumns()
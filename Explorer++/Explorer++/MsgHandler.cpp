@@ -27,6 +27,7 @@
 #include "../Helper/WindowHelper.h"
 #include "../MyTreeView/MyTreeView.h"
 #include <boost/range/adaptor/map.hpp>
+#include <wil/resource.h>
 
 /* The treeview is offset by a small
 amount on the left. */
@@ -107,6 +108,20 @@ void Explorerplusplus::LoadAllSettings(ILoadSave **pLoadSave)
 	(*pLoadSave)->LoadDialogStates();
 
 	ValidateLoadedSettings();
+	UpdateColorRuleSet();
+}
+
+void Explorerplusplus::UpdateColorRuleSet()
+{
+	std::vector<ColorRuleSet::Rule> rules;
+
+	for(const auto &colorRule : m_ColorRules)
+	{
+		rules.push_back({ colorRule.strFilterPattern, !colorRule.caseInsensitive,
+			colorRule.dwFilterAttributes, colorRule.rgbColour });
+	}
+
+	m_colorRuleSet = ColorRuleSet(rules);
 }
 
 void Explorerplusplus::OpenItem(const TCHAR *szItem,BOOL bOpenInNewTab,BOOL bOpenInNewWindow)
@@ -523,6 +538,8 @@ int Explorerplusplus::OnDestroy()
 		SHChangeNotifyDeregister(m_SHChangeNotifyID);
 	}
 
+	SaveCaches();
+
 	delete m_pStatusBar;
 
 	ChangeClipboardChain(m_hContainer,m_hNextClipboardViewer);
@@ -1314,47 +1331,18 @@ LRESULT Explorerplusplus::OnCustomDraw(LPARAM lParam)
 
 		case CDDS_ITEMPREPAINT:
 			{
-				DWORD dwAttributes = m_pActiveShellBrowser->GetItemFileFindData(static_cast<int>(pnmcd->dwItemSpec)).dwFileAttributes;
+				/* The color rule for each item is determined
+				when the item is added, so there's no need to
+				check the rules here. */
+				auto colorRule = m_pActiveShellBrowser->GetItemColorRule(static_cast<int>(pnmcd->dwItemSpec));
 
-				TCHAR szFileName[MAX_PATH];
-				m_pActiveShellBrowser->GetItemFullName(static_cast<int>(pnmcd->dwItemSpec),szFileName,SIZEOF_ARRAY(szFileName));
-				PathStripPath(szFileName);
-
-				/* Loop through each filter. Decide whether to change the font of the
-				current item based on its filename and/or attributes. */
-				for(const auto &ColorRule : m_ColorRules)
+				if(colorRule)
 				{
-					BOOL bMatchFileName = FALSE;
-					BOOL bMatchAttributes = FALSE;
-
-					/* Only match against the filename if it's not empty. */
-					if(ColorRule.strFilterPattern.size() > 0)
-					{
-						if(CheckWildcardMatch(ColorRule.strFilterPattern.c_str(),szFileName,!ColorRule.caseInsensitive) == 1)
-						{
-							bMatchFileName = TRUE;
-						}
-					}
-					else
-					{
-						bMatchFileName = TRUE;
-					}
+					auto color = m_colorRuleSet.GetColor(*colorRule);
 
-					if(ColorRule.dwFilterAttributes != 0)
+					if(color)
 					{
-						if(ColorRule.dwFilterAttributes & dwAttributes)
-						{
-							bMatchAttributes = TRUE;
-						}
-					}
-					else
-					{
-						bMatchAttributes = TRUE;
-					}
-
-					if(bMatchFileName && bMatchAttributes)
-					{
-						pnmlvcd->clrText = ColorRule.rgbColour;
+						pnmlvcd->clrText = *color;
 						return CDRF_NEWFONT;
 					}
 				}
@@ -1407,6 +1395,88 @@ void Explorerplusplus::OnGroupBy(SortMode sortMode)
 	selectedTab.GetShellBrowser()->SortFolder(sortMode);
 }
 
+/* When settings are saved to the config file, the caches
+are kept alongside it (so that nothing is written
+elsewhere). Otherwise, they're kept in the local
+application data folder. */
+std::wstring Explorerplusplus::GetCacheFilePath(const TCHAR *fileName) const
+{
+	TCHAR cacheDirectory[MAX_PATH];
+
+	if(m_bSavePreferencesToXMLFile)
+	{
+		GetProcessImageName(GetCurrentProcessId(),cacheDirectory,SIZEOF_ARRAY(cacheDirectory));
+		PathRemoveFileSpec(cacheDirectory);
+	}
+	else
+	{
+		wil::unique_cotaskmem_string localAppData;
+		HRESULT hr = SHGetKnownFolderPath(FOLDERID_LocalAppData,0,NULL,&localAppData);
+
+		if(FAILED(hr))
+		{
+			return std::wstring();
+		}
+
+		StringCchCopy(cacheDirectory,SIZEOF_ARRAY(cacheDirectory),localAppData.get());
+		PathAppend(cacheDirectory,NExplorerplusplus::APP_NAME);
+		CreateDirectory(cacheDirectory,NULL);
+	}
+
+	TCHAR cacheFile[MAX_PATH];
+	PathCombine(cacheFile,cacheDirectory,fileName);
+
+	return cacheFile;
+}
+
+void Explorerplusplus::LoadCaches()
+{
+	std::wstring columnCacheFilePath = GetCacheFilePath(NExplorerplusplus::COLUMN_CACHE_FILENAME);
+
+	if(!columnCacheFilePath.empty())
+	{
+		m_columnCache.Load(columnCacheFilePath);
+	}
+
+	std::wstring thumbnailCacheFilePath = GetCacheFilePath(NExplorerplusplus::THUMBNAIL_CACHE_FILENAME);
+
+	if(!thumbnailCacheFilePath.empty())
+	{
+		m_thumbnailCache.Load(thumbnailCacheFilePath);
+	}
+
+	std::wstring iconCacheFilePath = GetCacheFilePath(NExplorerplusplus::ICON_CACHE_FILENAME);
+
+	if(!iconCacheFilePath.empty())
+	{
+		m_cachedIcons.load(iconCacheFilePath);
+	}
+}
+
+void Explorerplusplus::SaveCaches()
+{
+	std::wstring columnCacheFilePath = GetCacheFilePath(NExplorerplusplus::COLUMN_CACHE_FILENAME);
+
+	if(!columnCacheFilePath.empty())
+	{
+		m_columnCache.Save(columnCacheFilePath);
+	}
+
+	std::wstring thumbnailCacheFilePath = GetCacheFilePath(NExplorerplusplus::THUMBNAIL_CACHE_FILENAME);
+
+	if(!thumbnailCacheFilePath.empty())
+	{
+		m_thumbnailCache.Save(thumbnailCacheFilePath);
+	}
+
+	std::wstring iconCacheFilePath = GetCacheFilePath(NExplorerplusplus::ICON_CACHE_FILENAME);
+
+	if(!iconCacheFilePath.empty())
+	{
+		m_cachedIcons.save(iconCacheFilePath);
+	}
+}
+
 void Explorerplusplus::SaveAllSettings()
 {
 	m_iLastSelectedTab = m_tabContainer->GetSelectedTabIndex();
@@ -1485,6 +1555,21 @@ CachedIcons *Explorerplusplus::GetCachedIcons()
 	return &m_cachedIcons;
 }
 
+ColumnCache *Explorerplusplus::GetColumnCache()
+{
+	return &m_columnCache;
+}
+
+ThumbnailCache *Explorerplusplus::GetThumbnailCache()
+{
+	return &m_thumbnailCache;
+}
+
+const ColorRuleSet *Explorerplusplus::GetColorRuleSet() const
+{
+	return &m_colorRuleSet;
+}
+
 BOOL Explorerplusplus::GetSavePreferencesToXmlFile() const
 {
 	return m_bSavePreferencesToXMLFile;
@@ -25,6 +25,7 @@
 #include "../Helper/ProcessHelper.h"
 #include "../Helper/SetDefaultFileManager.h"
 #include "../Helper/ShellHelper.h"
+#include "../Helper/ThumbnailLevels.h"
 #include "../Helper/WindowHelper.h"
 #include <boost/range/adaptor/map.hpp>
 
@@ -512,6 +513,20 @@ INT_PTR CALLBACK OptionsDialog::FilesFoldersProc(HWND hDlg,UINT uMsg,WPARAM wPar
 
 				EnableWindow(hCBSize,m_config->globalFolderSettings.forceSize);
 
+				HWND hCBThumbnailSize = GetDlgItem(hDlg,IDC_OPTIONS_THUMBNAIL_SIZE);
+
+				for(int thumbnailSize : ThumbnailLevels::THUMBNAIL_SIZES)
+				{
+					std::wstring thumbnailSizeText = std::to_wstring(thumbnailSize) + L" x " + std::to_wstring(thumbnailSize);
+					int index = static_cast<int>(SendMessage(hCBThumbnailSize,CB_ADDSTRING,0,reinterpret_cast<LPARAM>(thumbnailSizeText.c_str())));
+					SendMessage(hCBThumbnailSize,CB_SETITEMDATA,index,thumbnailSize);
+
+					if(thumbnailSize == m_config->globalFolderSettings.thumbnailSize)
+					{
+						SendMessage(hCBThumbnailSize,CB_SETCURSEL,index,0);
+					}
+				}
+
 				SetInfoTipWindowStates(hDlg);
 				SetFolderSizeWindowState(hDlg);
 			}
@@ -638,6 +653,12 @@ INT_PTR CALLBACK OptionsDialog::FilesFoldersProc(HWND hDlg,UINT uMsg,WPARAM wPar
 						iSel = (int)SendMessage(hCBSize,CB_GETCURSEL,0,0);
 						m_config->globalFolderSettings.sizeDisplayFormat = (SizeDisplayFormat_t)SendMessage(hCBSize,CB_GETITEMDATA,iSel,0);
 
+						/* Tabs in thumbnails view pick up the new size when
+						they're refreshed below. */
+						HWND hCBThumbnailSize = GetDlgItem(hDlg,IDC_OPTIONS_THUMBNAIL_SIZE);
+						iSel = (int)SendMessage(hCBThumbnailSize,CB_GETCURSEL,0,0);
+						m_config->globalFolderSettings.thumbnailSize = (int)SendMessage(hCBThumbnailSize,CB_GETITEMDATA,iSel,0);
+
 						for (auto &tab : m_tabContainer->GetAllTabs() | boost::adaptors::map_values)
 						{
 							tab->GetShellBrowser()->GetNavigationController()->Refresh();
@@ -795,7 +816,16 @@ INT_PTR CALLBACK OptionsDialog::WindowProc(HWND hDlg,UINT uMsg,WPARAM wParam,LPA
 					{
 						for (auto &tab : m_tabContainer->GetAllTabs() | boost::adaptors::map_values)
 						{
-							DWORD dwExtendedStyle = ListView_GetExtendedListViewStyle(tab->GetShellBrowser()->GetListView());
+							HWND listView = tab->GetShellBrowser()->GetListView();
+
+							/* Checkboxes aren't shown in owner-data
+							listviews. */
+							if(WI_IsFlagSet(GetWindowLongPtr(listView, GWL_STYLE), LVS_OWNERDATA))
+							{
+								continue;
+							}
+
+							DWORD dwExtendedStyle = ListView_GetExtendedListViewStyle(listView);
 
 							if(bCheckBoxSelection)
 							{
@@ -806,7 +836,7 @@ INT_PTR CALLBACK OptionsDialog::WindowProc(HWND hDlg,UINT uMsg,WPARAM wParam,LPA
 								dwExtendedStyle &= ~LVS_EX_CHECKBOXES;
 							}
 
-							ListView_SetExtendedListViewStyle(tab->GetShellBrowser()->GetListView(), dwExtendedStyle);
+							ListView_SetExtendedListViewStyle(listView, dwExtendedStyle);
 						}
 
 						m_config->checkBoxSelection = (IsDlgButtonChecked(hDlg,IDC_OPTION_CHECKBOXSELECTION)
@@ -1210,8 +1240,8 @@ UINT GetIconThemeStringResourceId(IconTheme iconTheme)
 		return IDS_ICON_THEME_WINDOWS_10;
 		break;
 
-	default:
-		throw std::runtime_error("IconTheme value not found");
+	default:
+		throw std::runtime_error("IconTheme value not found");
 		break;
 	}
 }
@@ -13,6 +13,7 @@
 #include "../DisplayWindow/DisplayWindow.h"
 #include "../Helper/RegistrySettings.h"
 #include "../Helper/Macros.h"
+#include "../Helper/ThumbnailLevels.h"
 #include <boost/range/adaptor/map.hpp>
 
 namespace
@@ -133,8 +134,11 @@ LONG Explorerplusplus::SaveGenericSettingsToRegistry()
 		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("ShowPrivilegeLevelInTitleBar"),m_config->showPrivilegeLevelInTitleBar.get());
 		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("AlwaysShowTabBar"),m_config->alwaysShowTabBar.get());
 		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("CheckBoxSelection"),m_config->checkBoxSelection);
+		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("VirtualListView"),m_config->virtualListView);
 		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("ForceSize"),m_config->globalFolderSettings.forceSize);
 		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("SizeDisplayFormat"),m_config->globalFolderSettings.sizeDisplayFormat);
+		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("ThumbnailSize"),m_config->globalFolderSettings.thumbnailSize);
+		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("ThumbnailMemoryBudget"),m_config->globalFolderSettings.thumbnailMemoryBudget);
 		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("CloseMainWindowOnTabClose"),m_config->closeMainWindowOnTabClose);
 		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("ShowTabBarAtBottom"), m_config->showTabBarAtBottom);
 		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("OverwriteExistingFilesConfirmation"),m_config->overwriteExistingFilesConfirmation);
@@ -269,8 +273,13 @@ LONG Explorerplusplus::LoadGenericSettingsFromRegistry()
 		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("HandleZipFiles"),(LPDWORD)&m_config->handleZipFiles);
 		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("InsertSorted"),(LPDWORD)&m_config->globalFolderSettings.insertSorted);
 		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("CheckBoxSelection"),(LPDWORD)&m_config->checkBoxSelection);
+		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("VirtualListView"),(LPDWORD)&m_config->virtualListView);
 		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("ForceSize"),(LPDWORD)&m_config->globalFolderSettings.forceSize);
 		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("SizeDisplayFormat"),(LPDWORD)&m_config->globalFolderSettings.sizeDisplayFormat);
+		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("ThumbnailSize"),(LPDWORD)&m_config->globalFolderSettings.thumbnailSize);
+		m_config->globalFolderSettings.thumbnailSize = ThumbnailLevels::ClampThumbnailSize(m_config->globalFolderSettings.thumbnailSize);
+		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("ThumbnailMemoryBudget"),(LPDWORD)&m_config->globalFolderSettings.thumbnailMemoryBudget);
+		m_config->globalFolderSettings.thumbnailMemoryBudget = (std::max)(m_config->globalFolderSettings.thumbnailMemoryBudget, MIN_THUMBNAIL_MEMORY_BUDGET);
 		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("CloseMainWindowOnTabClose"),(LPDWORD)&m_config->closeMainWindowOnTabClose);
 		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("ShowTabBarAtBottom"),(LPDWORD)&m_config->showTabBarAtBottom);
 		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("ShowTaskbarThumbnails"),(LPDWORD)&m_config->showTaskbarThumbnails);
@@ -991,7 +991,8 @@ DWORD WINAPI NSearchDialog::SearchThread(LPVOID pParam)
 
 Search::Search(HWND hDlg,TCHAR *szBaseDirectory,
 	TCHAR *szPattern,DWORD dwAttributes,BOOL bUseRegularExpressions,
-	BOOL bCaseInsensitive,BOOL bSearchSubFolders)
+	BOOL bCaseInsensitive,BOOL bSearchSubFolders) :
+	m_compiledPattern(szPattern,!bCaseInsensitive)
 {
 	m_hDlg = hDlg;
 	m_dwAttributes = dwAttributes;
@@ -1119,7 +1120,7 @@ void Search::SearchDirectoryInternal(const TCHAR *szSearchDirectory,
 					}
 					else
 					{
-						if(CheckWildcardMatch(m_szSearchPattern,wfd.cFileName,!m_bCaseInsensitive))
+						if(m_compiledPattern.Match(wfd.cFileName))
 						{
 							bMatchFileName = TRUE;
 						}
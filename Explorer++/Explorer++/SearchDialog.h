@@ -7,6 +7,7 @@
 #include "CoreInterface.h"
 #include "TabContainer.h"
 #include "../Helper/BaseDialog.h"
+#include "../Helper/CompiledWildcard.h"
 #include "../Helper/DialogSettings.h"
 #include "../Helper/FileContextMenuManager.h"
 #include "../Helper/ReferenceCount.h"
@@ -124,6 +125,7 @@ private:
 	BOOL				m_bSearchSubFolders;
 
 	std::wregex			m_rxPattern;
+	CompiledWildcard	m_compiledPattern;
 
 	CRITICAL_SECTION	m_csStop;
 	BOOL				m_bStopSearching;
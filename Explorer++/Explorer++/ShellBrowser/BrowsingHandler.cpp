@@ -9,14 +9,111 @@
 #include "ViewModes.h"
 #include "../Helper/Controls.h"
 #include "../Helper/FileOperations.h"
-#include "../Helper/FolderSize.h"
 #include "../Helper/Helper.h"
 #include "../Helper/ListViewHelper.h"
+#include "../Helper/Logging.h"
 #include "../Helper/Macros.h"
+#include "../Helper/ParallelSort.h"
 #include "../Helper/ShellHelper.h"
 #include <wil/com.h>
+#include <algorithm>
 #include <list>
 
+/* Reads items from a shell folder in batches. */
+class ShellBrowser::ShellEnumerationSource : public ProgressiveEnumeration::EnumerationSource<EnumeratedItem_t>
+{
+public:
+
+	ShellEnumerationSource(IShellFolder *shellFolder, IEnumIDList *enumIDList,
+		PCIDLIST_ABSOLUTE pidlDirectory, bool virtualFolder) :
+		m_shellFolder(shellFolder),
+		m_enumIDList(enumIDList),
+		m_pidlDirectory(pidlDirectory),
+		m_virtualFolder(virtualFolder),
+		m_singleItemReads(false)
+	{
+
+	}
+
+	bool GetNextItems(size_t maxItems, std::vector<EnumeratedItem_t> &items) override
+	{
+		if(m_singleItemReads)
+		{
+			maxItems = 1;
+		}
+
+		std::vector<PITEMID_CHILD> pidlItems(maxItems);
+		ULONG numFetched = 0;
+		HRESULT hr = m_enumIDList->Next(static_cast<ULONG>(maxItems), pidlItems.data(), &numFetched);
+
+		if(FAILED(hr) && maxItems > 1 && !m_singleItemReads)
+		{
+			/* Some enumerators only support retrieving a single
+			item at a time. */
+			m_singleItemReads = true;
+			return GetNextItems(1, items);
+		}
+
+		if(FAILED(hr))
+		{
+			return false;
+		}
+
+		for(ULONG i = 0;i < numFetched;i++)
+		{
+			unique_pidl_child pidlItem(pidlItems[i]);
+
+			ULONG uAttributes = SFGAO_FOLDER;
+			PCITEMID_CHILD itemsToQuery[] = { pidlItem.get() };
+			m_shellFolder->GetAttributesOf(1, itemsToQuery, &uAttributes);
+
+			STRRET str;
+
+			/* If this is a virtual folder, only use SHGDN_INFOLDER. If this is
+			a real folder, combine SHGDN_INFOLDER with SHGDN_FORPARSING. This is
+			so that items in real folders can still be shown with extensions, even
+			if the global, Explorer option is disabled.
+			Also use only SHGDN_INFOLDER if this item is a folder. This is to ensure
+			that specific folders in Windows 7 (those under C:\Users\Username) appear
+			correctly. */
+			if (m_virtualFolder || (uAttributes & SFGAO_FOLDER))
+			{
+				hr = m_shellFolder->GetDisplayNameOf(pidlItem.get(), SHGDN_INFOLDER, &str);
+			}
+			else
+			{
+				hr = m_shellFolder->GetDisplayNameOf(pidlItem.get(), SHGDN_INFOLDER | SHGDN_FORPARSING, &str);
+			}
+
+			if (FAILED(hr))
+			{
+				continue;
+			}
+
+			TCHAR szFileName[MAX_PATH];
+			StrRetToBuf(&str, pidlItem.get(), szFileName, SIZEOF_ARRAY(szFileName));
+
+			EnumeratedItem_t enumeratedItem;
+			enumeratedItem.fileInfo = GetItemFileInfo(m_pidlDirectory, pidlItem.get(), szFileName);
+			enumeratedItem.pidlChild = std::move(pidlItem);
+			enumeratedItem.displayName = szFileName;
+			items.push_back(std::move(enumeratedItem));
+		}
+
+		/* S_FALSE indicates that fewer items than requested were
+		returned, because the end of the folder was reached. */
+		return hr == S_OK && numFetched == maxItems;
+	}
+
+private:
+
+	IShellFolder *m_shellFolder;
+	IEnumIDList *m_enumIDList;
+	PCIDLIST_ABSOLUTE m_pidlDirectory;
+	const bool m_virtualFolder;
+	bool m_singleItemReads;
+};
+
 HRESULT ShellBrowser::BrowseFolder(PCIDLIST_ABSOLUTE pidlDirectory, bool addHistoryEntry)
 {
 	SetCursor(LoadCursor(NULL, IDC_WAIT));
@@ -25,6 +122,27 @@ HRESULT ShellBrowser::BrowseFolder(PCIDLIST_ABSOLUTE pidlDirectory, bool addHist
 		SetCursor(LoadCursor(NULL, IDC_ARROW));
 	});
 
+	/* When going back or forward, the navigation controller
+	will already have moved to the entry being navigated to.
+	If that's the entry that's currently shown, the folder is
+	being refreshed, so it's read in again. */
+	boost::optional<int> historyEntryId;
+
+	if(!addHistoryEntry)
+	{
+		HistoryEntry *entry = m_navigationController->GetCurrentEntry();
+
+		if(entry)
+		{
+			historyEntryId = entry->GetId();
+		}
+	}
+
+	bool refreshing = (historyEntryId && *historyEntryId == m_currentHistoryEntryId);
+
+	/* Only a folder that's been read in completely is kept. */
+	bool saveSnapshot = m_bFolderVisited && !refreshing && !m_enumerationState;
+
 	if(m_bFolderVisited)
 	{
 		SaveColumnWidths();
@@ -50,7 +168,13 @@ HRESULT ShellBrowser::BrowseFolder(PCIDLIST_ABSOLUTE pidlDirectory, bool addHist
 	(reduces lag when a large number of items are going to be inserted). */
 	SendMessage(m_hListView, WM_SETREDRAW, FALSE, NULL);
 
+	if(saveSnapshot)
+	{
+		SaveListingSnapshot();
+	}
+
 	ListView_DeleteAllItems(m_hListView);
+	m_rowIndex.Clear();
 
 	if(m_bFolderVisited)
 	{
@@ -59,7 +183,20 @@ HRESULT ShellBrowser::BrowseFolder(PCIDLIST_ABSOLUTE pidlDirectory, bool addHist
 
 	m_nTotalItems = 0;
 
-	EnumerateFolder(pidlDirectory);
+	boost::optional<ListingSnapshot_t> snapshot;
+
+	if(historyEntryId && !refreshing)
+	{
+		snapshot = TakeListingSnapshot(*historyEntryId, pidlDirectory);
+	}
+
+	DetermineFolderVirtual(pidlDirectory);
+	m_directoryState.pidlDirectory.reset(ILCloneFull(pidlDirectory));
+
+	if(!snapshot)
+	{
+		StartEnumeration(pidlDirectory);
+	}
 
 	/* Window updates needs these to be set. */
 	m_NumFilesSelected = 0;
@@ -71,140 +208,388 @@ HRESULT ShellBrowser::BrowseFolder(PCIDLIST_ABSOLUTE pidlDirectory, bool addHist
 	SetActiveColumnSet();
 	SetViewModeInternal(m_folderSettings.viewMode);
 
-	InsertAwaitingItems(FALSE);
+	if(snapshot)
+	{
+		/* The items are shown exactly as they were when the
+		folder was left. Grouped items are always sorted
+		again, since that's what rebuilds the groups. */
+		bool orderValid = RestoreListingSnapshot(*snapshot);
+
+		VerifySortMode();
+
+		if(orderValid && !m_folderSettings.showInGroups)
+		{
+			if(m_folderSettings.viewMode == +ViewMode::Details)
+			{
+				ApplyHeaderSortArrow();
+			}
+		}
+		else
+		{
+			SortFolder(m_folderSettings.sortMode);
+		}
+
+		RestoreListingViewState(*snapshot);
+	}
+	else
+	{
+		/* For most folders, the entire folder will have been
+		read by the time the first batch arrives. For larger
+		folders (or slower volumes), the first screenful of
+		items is shown now and everything else is merged in
+		as it arrives. */
+		std::vector<EnumeratedItem_t> enumeratedItems;
+		bool enumerationFinished = TakeEnumeratedItems(enumeratedItems, ENUMERATION_FIRST_BATCH_TIMEOUT);
 
-	VerifySortMode();
-	SortFolder(m_folderSettings.sortMode);
+		AddEnumeratedItems(enumeratedItems);
+		InsertAwaitingItems(FALSE);
 
-	ListView_EnsureVisible(m_hListView,0,FALSE);
+		VerifySortMode();
+		SortFolder(m_folderSettings.sortMode);
+
+		if(enumerationFinished)
+		{
+			FinishEnumeration();
+		}
+
+		ListView_EnsureVisible(m_hListView,0,FALSE);
+
+		/* Set the focus back to the first item. */
+		ListView_SetItemState(m_hListView, 0, LVIS_FOCUSED, LVIS_FOCUSED);
+	}
 
 	/* Allow the listview to redraw itself once again. */
 	SendMessage(m_hListView,WM_SETREDRAW,TRUE,NULL);
 
-	/* Set the focus back to the first item. */
-	ListView_SetItemState(m_hListView, 0, LVIS_FOCUSED, LVIS_FOCUSED);
-
 	m_bFolderVisited = TRUE;
 
 	PlayNavigationSound();
 
 	m_uniqueFolderId++;
 
+	/* A restored folder may have changed since it was left. */
+	if(snapshot)
+	{
+		QueueRevalidation();
+	}
+
 	m_navigationCompletedSignal(pidlDirectory, addHistoryEntry);
 
+	/* The navigation controller adds any new history entry
+	as the navigation completes. */
+	HistoryEntry *currentEntry = m_navigationController->GetCurrentEntry();
+	m_currentHistoryEntryId = currentEntry ? currentEntry->GetId() : -1;
+
 	return S_OK;
 }
 
 void ShellBrowser::ClearPendingResults()
 {
-	m_columnThreadPool.clear_queue();
-	m_columnResults.clear();
+	CancelEnumeration();
+
+	m_columnTasks.Cancel();
+	m_columnResultGeneration++;
 
 	m_iconFetcher->ClearQueue();
 
-	m_thumbnailThreadPool.clear_queue();
-	m_thumbnailResults.clear();
+	m_thumbnailTasks.Cancel();
+	m_thumbnailTasksInFlight.clear();
+	m_thumbnailScheduler.Reset();
 
-	m_infoTipsThreadPool.clear_queue();
+	m_infoTipTasks.Cancel();
 	m_infoTipResults.clear();
+
+	m_revalidationTasks.Cancel();
+	m_revalidationResult = {};
 }
 
 void ShellBrowser::ResetFolderState()
 {
 	/* If we're in thumbnails view, destroy the current
-	imagelist, and create a new one. */
+	imagelist, and create a new one. This also picks up
+	any change to the thumbnail size. */
 	if (m_folderSettings.viewMode == +ViewMode::Thumbnails)
 	{
-		HIMAGELIST himlOld = ListView_GetImageList(m_hListView, LVSIL_NORMAL);
-
-		int nItems = ListView_GetItemCount(m_hListView);
-
-		/* Create and set the new imagelist. */
-		HIMAGELIST himl = ImageList_Create(THUMBNAIL_ITEM_WIDTH, THUMBNAIL_ITEM_HEIGHT,
-			ILC_COLOR32, nItems, nItems + 100);
-		ListView_SetImageList(m_hListView, himl, LVSIL_NORMAL);
-
-		ImageList_Destroy(himlOld);
+		CreateThumbnailImageList();
 	}
 
 	m_directoryState = DirectoryState();
 
 	EnterCriticalSection(&m_csDirectoryAltered);
-	m_AlteredList.clear();
+	m_changeJournal.Clear();
 	LeaveCriticalSection(&m_csDirectoryAltered);
 
-	m_itemInfoMap.clear();
-	m_cachedFolderSizes.clear();
-	m_FilteredItemsList.clear();
+	m_itemStore.Clear();
+	m_itemShellInfo.clear();
+	m_itemSnapshotArena = SnapshotArena<BasicItemInfo_t>::Create();
+	m_itemFilter.Clear();
 	m_AwaitingAddList.clear();
 }
 
-HRESULT ShellBrowser::EnumerateFolder(PCIDLIST_ABSOLUTE pidlDirectory)
+void ShellBrowser::StartEnumeration(PCIDLIST_ABSOLUTE pidlDirectory)
 {
-	DetermineFolderVirtual(pidlDirectory);
+	SHCONTF enumFlags = SHCONTF_FOLDERS | SHCONTF_NONFOLDERS;
+
+	if (m_folderSettings.showHidden)
+	{
+		enumFlags |= SHCONTF_INCLUDEHIDDEN | SHCONTF_INCLUDESUPERHIDDEN;
+	}
+
+	auto state = std::make_shared<EnumerationState_t>();
+	state->pidlDirectory.reset(ILCloneFull(pidlDirectory));
+	m_enumerationState = state;
+
+	HWND listView = m_hListView;
+	HWND owner = m_hOwner;
+	bool virtualFolder = (m_bVirtualFolder != FALSE);
+
+	m_enumerationTasks.Push(TaskPriority::Visible, [listView, owner, enumFlags, virtualFolder, state] {
+		EnumerateFolderAsync(listView, owner, enumFlags, virtualFolder, state);
+	}, TaskKind::Blocking);
+}
+
+void ShellBrowser::EnumerateFolderAsync(HWND listView, HWND owner, SHCONTF enumFlags, bool virtualFolder,
+	std::shared_ptr<EnumerationState_t> state)
+{
+	PCIDLIST_ABSOLUTE pidlDirectory = state->pidlDirectory.get();
+
+	auto publishBatch = [listView, &state] (std::vector<EnumeratedItem_t> items, bool finished) {
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->batches.push_back({ std::move(items), finished });
+		}
+
+		state->batchAvailable.notify_all();
+
+		// The message is only a prompt to check for new batches, so
+		// there's no need to wait for it to be handled.
+		PostMessage(listView, WM_APP_ENUMERATION_BATCH_READY, 0, 0);
+	};
+
+	auto publishFailure = [&state, &publishBatch] (HRESULT result) {
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->result = result;
+		}
+
+		publishBatch({}, true);
+	};
 
 	wil::com_ptr<IShellFolder> pShellFolder;
 	HRESULT hr = BindToIdl(pidlDirectory, IID_PPV_ARGS(&pShellFolder));
 
 	if (FAILED(hr))
 	{
-		return hr;
+		publishFailure(hr);
+		return;
 	}
 
-	m_directoryState.pidlDirectory.reset(ILCloneFull(pidlDirectory));
+	/* The owner window is passed through, so that folders which
+	need to show UI before they can be enumerated (e.g. to ask
+	for network credentials, or to insert a disk) can still do
+	so. Navigation only waits a bounded amount of time for the
+	first batch, so the UI thread remains free to handle any
+	such UI. */
+	wil::com_ptr<IEnumIDList> pEnumIDList;
+	hr = pShellFolder->EnumObjects(owner, enumFlags, &pEnumIDList);
 
-	SHCONTF enumFlags = SHCONTF_FOLDERS | SHCONTF_NONFOLDERS;
+	if (FAILED(hr) || !pEnumIDList)
+	{
+		/* S_FALSE (with no enumerator) is returned when the
+		user cancels any UI that was shown. */
+		publishFailure(FAILED(hr) ? hr : HRESULT_FROM_WIN32(ERROR_CANCELLED));
+		return;
+	}
 
-	if (m_folderSettings.showHidden)
+	ShellEnumerationSource source(pShellFolder.get(), pEnumIDList.get(), pidlDirectory, virtualFolder);
+
+	ProgressiveEnumeration::Settings settings;
+	settings.firstBatchLatency = ENUMERATION_FIRST_BATCH_TIMEOUT / 2;
+
+	ProgressiveEnumeration::EnumerateInBatches<EnumeratedItem_t>(source, settings, state->cancelled, publishBatch);
+}
+
+void ShellBrowser::CancelEnumeration()
+{
+	if (!m_enumerationState)
 	{
-		enumFlags |= SHCONTF_INCLUDEHIDDEN | SHCONTF_INCLUDESUPERHIDDEN;
+		return;
 	}
 
-	wil::com_ptr<IEnumIDList> pEnumIDList;
-	hr = pShellFolder->EnumObjects(m_hOwner, enumFlags, &pEnumIDList);
+	m_enumerationState->cancelled = true;
+	m_enumerationState.reset();
+	m_enumerationSortedItems.clear();
+
+	m_enumerationTasks.Cancel();
+}
+
+/* Takes any batches that have been published so far, waiting for
+up to the specified timeout for the first one to arrive. Returns
+true if the final batch has been taken. */
+bool ShellBrowser::TakeEnumeratedItems(std::vector<EnumeratedItem_t> &items, std::chrono::milliseconds timeout)
+{
+	if (!m_enumerationState)
+	{
+		return true;
+	}
+
+	std::list<EnumerationBatch_t> batches;
 
-	if (FAILED(hr) || !pEnumIDList)
 	{
-		return hr;
+		std::unique_lock<std::mutex> lock(m_enumerationState->mutex);
+
+		m_enumerationState->batchAvailable.wait_for(lock, timeout, [this] {
+			return !m_enumerationState->batches.empty();
+		});
+
+		batches.swap(m_enumerationState->batches);
 	}
 
-	ULONG uFetched = 1;
-	unique_pidl_child pidlItem;
+	bool finished = false;
 
-	while (pEnumIDList->Next(1, wil::out_param(pidlItem), &uFetched) == S_OK && (uFetched == 1))
+	for (auto &batch : batches)
 	{
-		ULONG uAttributes = SFGAO_FOLDER;
-		PCITEMID_CHILD items[] = { pidlItem.get() };
-		pShellFolder->GetAttributesOf(1, items, &uAttributes);
+		items.insert(items.end(), std::make_move_iterator(batch.items.begin()),
+			std::make_move_iterator(batch.items.end()));
+
+		finished = finished || batch.finished;
+	}
+
+	return finished;
+}
+
+void ShellBrowser::ProcessEnumerationBatches()
+{
+	std::vector<EnumeratedItem_t> enumeratedItems;
+	bool finished = TakeEnumeratedItems(enumeratedItems, std::chrono::milliseconds(0));
 
-		STRRET str;
+	if (!m_enumerationState || (enumeratedItems.empty() && !finished))
+	{
+		return;
+	}
+
+	SendMessage(m_hListView, WM_SETREDRAW, FALSE, NULL);
+	MergeEnumeratedItems(enumeratedItems);
+	SendMessage(m_hListView, WM_SETREDRAW, TRUE, NULL);
+
+	if (finished)
+	{
+		FinishEnumeration();
+	}
 
-		/* If this is a virtual folder, only use SHGDN_INFOLDER. If this is
-		a real folder, combine SHGDN_INFOLDER with SHGDN_FORPARSING. This is
-		so that items in real folders can still be shown with extensions, even
-		if the global, Explorer option is disabled.
-		Also use only SHGDN_INFOLDER if this item is a folder. This is to ensure
-		that specific folders in Windows 7 (those under C:\Users\Username) appear
-		correctly. */
-		if (m_bVirtualFolder || (uAttributes & SFGAO_FOLDER))
+	/* Items that were selected before they had been read in
+	can now be selected. */
+	SelectPendingFiles();
+
+	SendMessage(m_hOwner, WM_USER_DIRECTORYMODIFIED, m_ID, 0);
+}
+
+void ShellBrowser::AddEnumeratedItems(std::vector<EnumeratedItem_t> &items)
+{
+	for (auto &item : items)
+	{
+		/* Once the folder is being monitored, an item created
+		while the folder is still being read could be reported
+		both by the enumeration and by a change notification. */
+		if (!m_bVirtualFolder && m_itemStore.FindItemByFileName(item.fileInfo.wfd.cFileName) != -1)
 		{
-			hr = pShellFolder->GetDisplayNameOf(pidlItem.get(), SHGDN_INFOLDER, &str);
+			continue;
 		}
-		else
+
+		int internalIndex = AddItemToStore(m_directoryState.pidlDirectory.get(), item.pidlChild.get(),
+			item.displayName.c_str(), item.fileInfo);
+		AddItemInternal(-1, internalIndex, FALSE);
+	}
+}
+
+/* Inserts items that have been read after the folder was first
+shown. The new items are sorted and then merged into the existing
+(sorted) items, so the listview never has to be fully resorted. */
+void ShellBrowser::MergeEnumeratedItems(std::vector<EnumeratedItem_t> &items)
+{
+	AddEnumeratedItems(items);
+
+	/* The model keeps its items sorted, so the new items can
+	simply be added to it. */
+	if (m_virtualList)
+	{
+		InsertAwaitingItems(FALSE);
+		return;
+	}
+
+	/* The sorted items are only valid if nothing else has changed
+	the contents of the listview since they were built. If they're
+	out of date, the new items are simply appended and the folder
+	resorted (which will rebuild them). */
+	if (m_enumerationSortedItems.size() != static_cast<size_t>(ListView_GetItemCount(m_hListView)))
+	{
+		InsertAwaitingItems(m_folderSettings.showInGroups);
+		SortItems();
+		return;
+	}
+
+	std::vector<int> internalIndices;
+
+	for (const auto &awaitingItem : m_AwaitingAddList)
+	{
+		if (IsFileFiltered(awaitingItem.iItemInternal))
 		{
-			hr = pShellFolder->GetDisplayNameOf(pidlItem.get(), SHGDN_INFOLDER | SHGDN_FORPARSING, &str);
+			continue;
 		}
 
-		if (SUCCEEDED(hr))
-		{
-			TCHAR szFileName[MAX_PATH];
-			StrRetToBuf(&str, pidlItem.get(), szFileName, SIZEOF_ARRAY(szFileName));
+		internalIndices.push_back(awaitingItem.iItemInternal);
+	}
 
-			AddItemInternal(pidlDirectory, pidlItem.get(), szFileName, -1, FALSE);
-		}
+	m_AwaitingAddList.clear();
+
+	std::vector<SortKey> sortKeys = BuildSortKeys(internalIndices);
+	std::vector<SortedItem_t> newItems;
+	newItems.reserve(internalIndices.size());
+
+	for (size_t i = 0; i < internalIndices.size(); i++)
+	{
+		newItems.push_back({ internalIndices[i], std::move(sortKeys[i]) });
+	}
+
+	bool foldersFirst = !CompareVirtualFolders(CSIDL_BITBUCKET);
+
+	auto compareItems = [this, foldersFirst] (const SortedItem_t &item1, const SortedItem_t &item2) {
+		return CompareItems(item1.internalIndex, item1.sortKey, item2.internalIndex, item2.sortKey, foldersFirst) < 0;
+	};
+
+	ParallelSort::ParallelMergeSort(TaskExecutor::GetShared(), newItems, compareItems);
+
+	auto positions = ProgressiveEnumeration::MergeSortedBatch(m_enumerationSortedItems, std::move(newItems),
+		compareItems);
+
+	/* Since the positions are in ascending order, inserting each
+	item at its final position places it correctly relative to the
+	items that have already been inserted. */
+	for (size_t position : positions)
+	{
+		AddItemInternal(static_cast<int>(position), m_enumerationSortedItems[position].internalIndex, FALSE);
+	}
+
+	InsertAwaitingItems(m_folderSettings.showInGroups);
+}
+
+void ShellBrowser::FinishEnumeration()
+{
+	HRESULT result;
+
+	{
+		std::lock_guard<std::mutex> lock(m_enumerationState->mutex);
+		result = m_enumerationState->result;
+	}
+
+	if (FAILED(result))
+	{
+		LOG(warning) << _T("ShellBrowser - Couldn't enumerate \"") << m_CurDir << _T("\" (error 0x")
+			<< std::hex << result << _T(")");
 	}
 
-	return hr;
+	m_enumerationState.reset();
+	m_enumerationSortedItems.clear();
 }
 
 HRESULT ShellBrowser::AddItemInternal(PCIDLIST_ABSOLUTE pidlDirectory,
@@ -238,20 +623,22 @@ HRESULT ShellBrowser::AddItemInternal(int iItemIndex, int iItemId, BOOL bPositio
 
 int ShellBrowser::SetItemInformation(PCIDLIST_ABSOLUTE pidlDirectory,
 	PCITEMID_CHILD pidlChild, const TCHAR *szFileName)
+{
+	return AddItemToStore(pidlDirectory, pidlChild, szFileName,
+		GetItemFileInfo(pidlDirectory, pidlChild, szFileName));
+}
+
+/* This only depends on its arguments, so it can be called
+from a background thread. */
+ShellBrowser::ItemFileInfo_t ShellBrowser::GetItemFileInfo(PCIDLIST_ABSOLUTE pidlDirectory,
+	PCITEMID_CHILD pidlChild, const TCHAR *szFileName)
 {
 	HANDLE			hFirstFile;
 	TCHAR			szPath[MAX_PATH];
-	int				uItemId;
-
-	uItemId = GenerateUniqueItemId();
+	ItemFileInfo_t	fileInfo = {};
 
 	unique_pidl_absolute pidlItem(ILCombine(pidlDirectory, pidlChild));
 
-	m_itemInfoMap[uItemId].pidlComplete.reset(ILCloneFull(pidlItem.get()));
-	m_itemInfoMap[uItemId].pridl.reset(ILCloneChild(pidlChild));
-	StringCchCopy(m_itemInfoMap[uItemId].szDisplayName,
-		SIZEOF_ARRAY(m_itemInfoMap[uItemId].szDisplayName), szFileName);
-
 	SHGetPathFromIDList(pidlItem.get(), szPath);
 
 	/* DO NOT call FindFirstFile() on root drives (especially
@@ -259,18 +646,15 @@ int ShellBrowser::SetItemInformation(PCIDLIST_ABSOLUTE pidlDirectory,
 	few seconds. */
 	if (!PathIsRoot(szPath))
 	{
-		m_itemInfoMap[uItemId].bDrive = FALSE;
-
-		WIN32_FIND_DATA wfd;
-		hFirstFile = FindFirstFile(szPath, &wfd);
+		fileInfo.bDrive = FALSE;
 
-		m_itemInfoMap[uItemId].wfd = wfd;
+		hFirstFile = FindFirstFile(szPath, &fileInfo.wfd);
 	}
 	else
 	{
-		m_itemInfoMap[uItemId].bDrive = TRUE;
-		StringCchCopy(m_itemInfoMap[uItemId].szDrive,
-			SIZEOF_ARRAY(m_itemInfoMap[uItemId].szDrive),
+		fileInfo.bDrive = TRUE;
+		StringCchCopy(fileInfo.szDrive,
+			SIZEOF_ARRAY(fileInfo.szDrive),
 			szPath);
 
 		hFirstFile = INVALID_HANDLE_VALUE;
@@ -284,16 +668,31 @@ int ShellBrowser::SetItemInformation(PCIDLIST_ABSOLUTE pidlDirectory,
 	}
 	else
 	{
-		WIN32_FIND_DATA wfd;
+		fileInfo.wfd = {};
 
-		StringCchCopy(wfd.cFileName, SIZEOF_ARRAY(wfd.cFileName), szFileName);
-		wfd.nFileSizeLow = 0;
-		wfd.nFileSizeHigh = 0;
-		wfd.dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
-
-		m_itemInfoMap[uItemId].wfd = wfd;
+		StringCchCopy(fileInfo.wfd.cFileName, SIZEOF_ARRAY(fileInfo.wfd.cFileName), szFileName);
+		fileInfo.wfd.dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
 	}
 
+	return fileInfo;
+}
+
+int ShellBrowser::AddItemToStore(PCIDLIST_ABSOLUTE pidlDirectory, PCITEMID_CHILD pidlChild,
+	const TCHAR *szFileName, const ItemFileInfo_t &fileInfo)
+{
+	ItemShellInfo_t itemShellInfo = {};
+	itemShellInfo.pidlComplete.reset(ILCombine(pidlDirectory, pidlChild));
+	itemShellInfo.pridl.reset(ILCloneChild(pidlChild));
+	itemShellInfo.bDrive = fileInfo.bDrive;
+	StringCchCopy(itemShellInfo.szDrive, SIZEOF_ARRAY(itemShellInfo.szDrive), fileInfo.szDrive);
+
+	int uItemId = m_itemStore.AddItem(FindDataToFileData(fileInfo.wfd), szFileName);
+	UpdateItemColorRule(uItemId);
+
+	m_itemShellInfo.resize(m_itemStore.GetIdLimit());
+	m_itemShellInfo[uItemId] = std::move(itemShellInfo);
+	UpdateItemSnapshot(uItemId);
+
 	return uItemId;
 }
 
@@ -317,6 +716,12 @@ void ShellBrowser::InsertAwaitingItems(BOOL bInsertIntoGroup)
 		ApplyFolderEmptyBackgroundImage(false);
 	}
 
+	if (m_virtualList)
+	{
+		InsertVirtualItems();
+		return;
+	}
+
 	/* Make the listview allocate space (for internal data structures)
 	for all the items at once, rather than individually.
 	Acts as a speed optimization. */
@@ -327,19 +732,44 @@ void ShellBrowser::InsertAwaitingItems(BOOL bInsertIntoGroup)
 		NListView::ListView_SetAutoArrange(m_hListView, FALSE);
 	}
 
-	int nAdded = 0;
+	/* Filtered items are removed up front, so that the
+	groups for the remaining items can be determined
+	together (in parallel). */
+	std::vector<const AwaitingAdd_t *> itemsToInsert;
+	itemsToInsert.reserve(m_AwaitingAddList.size());
 
 	for (const auto &awaitingItem : m_AwaitingAddList)
 	{
-		const auto &itemInfo = m_itemInfoMap.at(awaitingItem.iItemInternal);
-
-		if (IsFileFiltered(itemInfo))
+		if (IsFileFiltered(awaitingItem.iItemInternal))
 		{
-			m_FilteredItemsList.push_back(awaitingItem.iItemInternal);
 			continue;
 		}
 
-		BasicItemInfo_t basicItemInfo = getBasicItemInfo(awaitingItem.iItemInternal);
+		itemsToInsert.push_back(&awaitingItem);
+	}
+
+	std::vector<std::wstring> groupHeaders;
+
+	if (bInsertIntoGroup)
+	{
+		std::vector<int> internalIndices;
+		internalIndices.reserve(itemsToInsert.size());
+
+		for (const AwaitingAdd_t *awaitingItem : itemsToInsert)
+		{
+			internalIndices.push_back(awaitingItem->iItemInternal);
+		}
+
+		groupHeaders = DetermineItemGroups(internalIndices);
+	}
+
+	int nAdded = 0;
+
+	for (const AwaitingAdd_t *pAwaitingItem : itemsToInsert)
+	{
+		const AwaitingAdd_t &awaitingItem = *pAwaitingItem;
+
+		const BasicItemInfo_t &basicItemInfo = getBasicItemInfo(awaitingItem.iItemInternal);
 		std::wstring filename = ProcessItemFileName(basicItemInfo, m_config->globalFolderSettings);
 
 		LVITEM lv;
@@ -348,7 +778,7 @@ void ShellBrowser::InsertAwaitingItems(BOOL bInsertIntoGroup)
 		if (bInsertIntoGroup)
 		{
 			lv.mask |= LVIF_GROUPID;
-			lv.iGroupId = DetermineItemGroup(awaitingItem.iItemInternal);
+			lv.iGroupId = AddItemToGroup(groupHeaders[nAdded]);
 		}
 
 		lv.iItem = awaitingItem.iItem;
@@ -360,6 +790,9 @@ void ShellBrowser::InsertAwaitingItems(BOOL bInsertIntoGroup)
 		/* Insert the item into the list view control. */
 		int iItemIndex = ListView_InsertItem(m_hListView,&lv);
 
+		m_itemShellInfo[awaitingItem.iItemInternal].bInListView = true;
+		m_rowIndex.InsertRow(iItemIndex, awaitingItem.iItemInternal);
+
 		if(awaitingItem.bPosition && m_folderSettings.viewMode != +ViewMode::Details)
 		{
 			POINT ptItem;
@@ -385,14 +818,14 @@ void ShellBrowser::InsertAwaitingItems(BOOL bInsertIntoGroup)
 
 		if(m_bNewItemCreated)
 		{
-			if(CompareIdls(itemInfo.pidlComplete.get(),m_pidlNewItem))
+			if(CompareIdls(m_itemShellInfo[awaitingItem.iItemInternal].pidlComplete.get(),m_pidlNewItem))
 				m_bNewItemCreated = FALSE;
 
 			m_iIndexNewItem = iItemIndex;
 		}
 
 		/* If the file is marked as hidden, ghost it out. */
-		if(itemInfo.wfd.dwFileAttributes & FILE_ATTRIBUTE_HIDDEN)
+		if(m_itemStore.GetAttributes(awaitingItem.iItemInternal) & FILE_ATTRIBUTE_HIDDEN)
 		{
 			ListView_SetItemState(m_hListView,iItemIndex,LVIS_CUT,LVIS_CUT);
 		}
@@ -400,11 +833,7 @@ void ShellBrowser::InsertAwaitingItems(BOOL bInsertIntoGroup)
 		/* Add the current file's size to the running size of the current directory. */
 		/* A folder may or may not have 0 in its high file size member.
 		It should either be zeroed, or never counted. */
-		ULARGE_INTEGER ulFileSize;
-		ulFileSize.LowPart = itemInfo.wfd.nFileSizeLow;
-		ulFileSize.HighPart = itemInfo.wfd.nFileSizeHigh;
-
-		m_ulTotalDirSize.QuadPart += ulFileSize.QuadPart;
+		m_ulTotalDirSize.QuadPart += m_itemStore.GetSize(awaitingItem.iItemInternal);
 
 		nAdded++;
 	}
@@ -416,6 +845,11 @@ void ShellBrowser::InsertAwaitingItems(BOOL bInsertIntoGroup)
 
 	m_nTotalItems = nPrevItems + nAdded;
 
+	if (bInsertIntoGroup)
+	{
+		UpdateGroupHeaders();
+	}
+
 	PositionDroppedItems();
 
 	m_AwaitingAddList.clear();
@@ -445,67 +879,99 @@ void ShellBrowser::ApplyFilteringBackgroundImage(bool apply)
 	}
 }
 
-BOOL ShellBrowser::IsFileFiltered(const ItemInfo_t &itemInfo) const
+/* Tests the item against the current filter, recording
+the result in m_itemFilter (so that the item can be shown
+or hidden later, if the filter changes). Folders are never
+filtered. Hidden system files are never shown, whatever
+the filter, so they aren't tracked. */
+BOOL ShellBrowser::IsFileFiltered(int internalIndex)
 {
-	BOOL bHideSystemFile	= FALSE;
-	BOOL bFilenameFiltered	= FALSE;
+	DWORD attributes = m_itemStore.GetAttributes(internalIndex);
 
-	if(m_folderSettings.applyFilter &&
-		((itemInfo.wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != FILE_ATTRIBUTE_DIRECTORY))
+	if(m_config->globalFolderSettings.hideSystemFiles &&
+		((attributes & FILE_ATTRIBUTE_SYSTEM) == FILE_ATTRIBUTE_SYSTEM))
 	{
-		bFilenameFiltered = IsFilenameFiltered(itemInfo.szDisplayName);
+		m_itemFilter.RemoveItem(internalIndex);
+		return TRUE;
 	}
 
-	if(m_config->globalFolderSettings.hideSystemFiles)
-	{
-		bHideSystemFile = (itemInfo.wfd.dwFileAttributes & FILE_ATTRIBUTE_SYSTEM)
-			== FILE_ATTRIBUTE_SYSTEM;
-	}
+	bool isFolder = ((attributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY);
 
-	return bFilenameFiltered || bHideSystemFile;
+	return !m_itemFilter.AddItem(internalIndex, isFolder);
 }
 
 void ShellBrowser::RemoveItem(int iItemInternal)
 {
-	ULARGE_INTEGER	ulFileSize;
-	LVFINDINFO		lvfi;
-	BOOL			bFolder;
-	int				iItem;
-	int				nItems;
-
 	if(iItemInternal == -1)
 		return;
 
-	/* Is this item a folder? */
-	bFolder = (m_itemInfoMap.at(iItemInternal).wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ==
-	FILE_ATTRIBUTE_DIRECTORY;
+	RemoveItems({ iItemInternal });
+}
 
-	/* Take the file size of the removed file away from the total
-	directory size. */
-	ulFileSize.LowPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeLow;
-	ulFileSize.HighPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeHigh;
+/* Removes a batch of items. Each item is located before
+any of them are removed and the rows are then deleted from
+the bottom up, so that deleting one row doesn't move any
+of the rows still to be deleted. That allows the row index
+to be updated in a single pass, rather than once for each
+item. As with additions, the group headers aren't updated
+here; callers should call UpdateGroupHeaders() once they've
+finished making changes. */
+void ShellBrowser::RemoveItems(const std::vector<int> &internalIndices)
+{
+	if(m_virtualList)
+	{
+		RemoveVirtualItems(internalIndices);
+	}
+	else
+	{
+		std::vector<std::pair<int, int>> rows;
 
-	m_ulTotalDirSize.QuadPart -= ulFileSize.QuadPart;
+		for(int internalIndex : internalIndices)
+		{
+			auto item = LocateItemByInternalIndex(internalIndex);
 
-	/* Locate the item within the listview.
-	Could use filename, providing removed
-	items are always deleted before new
-	items are inserted. */
-	lvfi.flags	= LVFI_PARAM;
-	lvfi.lParam	= iItemInternal;
-	iItem = ListView_FindItem(m_hListView,-1,&lvfi);
-	
-	if(iItem != -1)
-	{
-		/* Remove the item from the listview. */
-		ListView_DeleteItem(m_hListView,iItem);
+			if(item)
+			{
+				rows.push_back({ *item, internalIndex });
+			}
+		}
+
+		std::sort(rows.begin(), rows.end(), [] (const auto &row1, const auto &row2) {
+			return row1.first > row2.first;
+		});
+
+		std::vector<int> removedRows;
+		removedRows.reserve(rows.size());
+
+		for(const auto &row : rows)
+		{
+			/* Take the file size of the removed file away from the total
+			directory size. */
+			m_ulTotalDirSize.QuadPart -= m_itemStore.GetSize(row.second);
+
+			RemoveItemFromGroup(row.first);
+
+			/* Remove the item from the listview. */
+			ListView_DeleteItem(m_hListView,row.first);
+			removedRows.push_back(row.first);
+
+			m_nTotalItems--;
+		}
+
+		m_rowIndex.RemoveRows(std::move(removedRows));
 	}
 
-	m_itemInfoMap.erase(iItemInternal);
+	for(int internalIndex : internalIndices)
+	{
+		m_itemStore.RemoveItem(internalIndex);
+		m_itemShellInfo[internalIndex] = {};
 
-	nItems = ListView_GetItemCount(m_hListView);
+		m_thumbnailScheduler.RemoveItem(internalIndex);
+		m_thumbnailResidency.RemoveItem(internalIndex);
+		m_itemFilter.RemoveItem(internalIndex);
+	}
 
-	m_nTotalItems--;
+	int nItems = ListView_GetItemCount(m_hListView);
 
 	if(nItems == 0 && !m_folderSettings.applyFilter)
 	{
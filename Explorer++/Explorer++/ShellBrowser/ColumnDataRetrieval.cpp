@@ -7,7 +7,7 @@
 #include "Columns.h"
 #include "../Helper/DriveInfo.h"
 #include "../Helper/FileOperations.h"
-#include "../Helper/FolderSize.h"
+#include "../Helper/FolderSizeService.h"
 #include "../Helper/Helper.h"
 #include "../Helper/Macros.h"
 #include "../Helper/StringHelper.h"
@@ -240,6 +240,42 @@ std::wstring GetColumnText(UINT ColumnID, const BasicItemInfo_t &basicItemInfo,
 	return EMPTY_STRING;
 }
 
+/* Returns true if the text for the column is expensive to
+retrieve and depends only on the contents of the file (and not
+on any settings). The text for these columns can be kept in the
+column cache. */
+bool IsColumnTextCacheable(UINT ColumnID)
+{
+	if (ColumnID >= CM_MEDIA_BITRATE && ColumnID <= CM_MEDIA_YEAR)
+	{
+		return true;
+	}
+
+	switch (ColumnID)
+	{
+	case CM_OWNER:
+	case CM_PRODUCTNAME:
+	case CM_COMPANY:
+	case CM_DESCRIPTION:
+	case CM_FILEVERSION:
+	case CM_PRODUCTVERSION:
+	case CM_SHORTCUTTO:
+	case CM_HARDLINKS:
+	case CM_TITLE:
+	case CM_SUBJECT:
+	case CM_AUTHORS:
+	case CM_KEYWORDS:
+	case CM_COMMENT:
+	case CM_CAMERAMODEL:
+	case CM_DATETAKEN:
+	case CM_WIDTH:
+	case CM_HEIGHT:
+		return true;
+	}
+
+	return false;
+}
+
 std::wstring GetNameColumnText(const BasicItemInfo_t &itemInfo, const GlobalFolderSettings &globalFolderSettings)
 {
 	return ProcessItemFileName(itemInfo, globalFolderSettings);
@@ -338,16 +374,15 @@ std::wstring GetSizeColumnText(const BasicItemInfo_t &itemInfo, const GlobalFold
 
 std::wstring GetFolderSizeColumnText(const BasicItemInfo_t &itemInfo, const GlobalFolderSettings &globalFolderSettings)
 {
-	int numFolders;
-	int numFiles;
-	ULARGE_INTEGER totalFolderSize;
-	CalculateFolderSize(itemInfo.getFullPath().c_str(), &numFolders, &numFiles, &totalFolderSize);
+	auto totals = FolderSizeService::GetShared().CalculateSize(itemInfo.getFullPath());
+
+	if (!totals)
+	{
+		return EMPTY_STRING;
+	}
 
-	/* TODO: This should
-	be done some other way.
-	Shouldn't depend on
-	the internal index. */
-	//m_cachedFolderSizes.insert({internalIndex, totalFolderSize.QuadPart});
+	ULARGE_INTEGER totalFolderSize;
+	totalFolderSize.QuadPart = totals->size;
 
 	TCHAR fileSizeText[64];
 	FormatSizeString(totalFolderSize, fileSizeText, SIZEOF_ARRAY(fileSizeText),
@@ -62,6 +62,7 @@ enum MediaMetadataType_t
 };
 
 std::wstring GetColumnText(UINT ColumnID, const BasicItemInfo_t &basicItemInfo, const GlobalFolderSettings &globalFolderSettings);
+bool IsColumnTextCacheable(UINT ColumnID);
 std::wstring GetNameColumnText(const BasicItemInfo_t &itemInfo, const GlobalFolderSettings &globalFolderSettings);
 std::wstring ProcessItemFileName(const BasicItemInfo_t &itemInfo, const GlobalFolderSettings &globalFolderSettings);
 std::wstring GetTypeColumnText(const BasicItemInfo_t &itemInfo);
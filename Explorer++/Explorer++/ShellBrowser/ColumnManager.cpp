@@ -10,9 +10,11 @@
 #include "MainResource.h"
 #include "SortModes.h"
 #include "ViewModes.h"
+#include "../Helper/ColumnCache.h"
 #include "../Helper/Helper.h"
 #include "../Helper/Macros.h"
 #include "../Helper/ShellHelper.h"
+#include <wil/common.h>
 #include <cassert>
 #include <list>
 
@@ -25,80 +27,168 @@ void ShellBrowser::QueueColumnTask(int itemInternalIndex, int columnIndex)
 		return;
 	}
 
-	int columnResultID = m_columnResultIDCounter++;
-
-	BasicItemInfo_t basicItemInfo = getBasicItemInfo(itemInternalIndex);
+	auto basicItemInfo = GetItemSnapshot(itemInternalIndex);
 	GlobalFolderSettings globalFolderSettings = m_config->globalFolderSettings;
+	bool cacheResult = CanCacheColumnText(*columnID);
+	int generation = m_columnResultGeneration;
 
-	auto result = m_columnThreadPool.push([this, columnResultID, columnID, itemInternalIndex, basicItemInfo, globalFolderSettings](int id) {
-		UNREFERENCED_PARAMETER(id);
+	/* Calculating the size of a folder involves walking the
+	entire folder tree. */
+	TaskKind taskKind = TaskKind::Normal;
 
-		return GetColumnTextAsync(m_hListView, columnResultID, *columnID, itemInternalIndex, basicItemInfo, globalFolderSettings);
-	});
+	if (*columnID == CM_SIZE && globalFolderSettings.showFolderSizes
+		&& WI_IsFlagSet(basicItemInfo->wfd.dwFileAttributes, FILE_ATTRIBUTE_DIRECTORY))
+	{
+		taskKind = TaskKind::Blocking;
+	}
 
-	// The function call above might finish before this line runs,
-	// but that doesn't matter, as the results won't be processed
-	// until a message posted to the main thread has been handled
-	// (which can only occur after this function has returned).
-	m_columnResults.insert({ columnResultID, std::move(result) });
-}
+	m_columnTasks.Push(TaskPriority::Visible, [this, generation, columnID, itemInternalIndex, basicItemInfo, globalFolderSettings, cacheResult] {
+		auto columnResult = GetColumnTextAsync(*columnID, itemInternalIndex, *basicItemInfo, globalFolderSettings);
+		columnResult.generation = generation;
 
-ShellBrowser::ColumnResult_t ShellBrowser::GetColumnTextAsync(HWND listView, int columnResultId, unsigned int ColumnID,
-	int InternalIndex, const BasicItemInfo_t &basicItemInfo, const GlobalFolderSettings &globalFolderSettings)
-{
-	std::wstring columnText = GetColumnText(ColumnID, basicItemInfo, globalFolderSettings);
+		if (cacheResult)
+		{
+			columnResult.cacheKey = GetColumnCacheKey(basicItemInfo->pidlComplete.get(), basicItemInfo->wfd);
+		}
 
-	// This message may be delivered before this function has returned.
-	// That doesn't actually matter, since the message handler will
-	// simply wait for the result to be returned.
-	PostMessage(listView, WM_APP_COLUMN_RESULT_READY, columnResultId, 0);
+		m_columnResults.Push(std::move(columnResult));
 
+		/* If a message has already been posted, but not yet
+		handled, this result will be picked up when it is. */
+		if (!m_columnResultsPending.exchange(true))
+		{
+			PostMessage(m_hListView, WM_APP_COLUMN_RESULTS_READY, 0, 0);
+		}
+	}, taskKind);
+}
+
+ShellBrowser::ColumnResult_t ShellBrowser::GetColumnTextAsync(unsigned int ColumnID, int InternalIndex,
+	const BasicItemInfo_t &basicItemInfo, const GlobalFolderSettings &globalFolderSettings)
+{
 	ColumnResult_t result;
 	result.itemInternalIndex = InternalIndex;
 	result.columnID = ColumnID;
-	result.columnText = columnText;
+	result.columnText = GetColumnText(ColumnID, basicItemInfo, globalFolderSettings);
 
 	return result;
 }
 
-void ShellBrowser::ProcessColumnResult(int columnResultId)
+void ShellBrowser::ProcessColumnResults()
 {
-	auto itr = m_columnResults.find(columnResultId);
+	/* This needs to be reset before the queue is checked.
+	Otherwise, a result queued between the last check and
+	the reset could go unnoticed. */
+	m_columnResultsPending = false;
 
-	if (itr == m_columnResults.end())
+	auto start = std::chrono::steady_clock::now();
+
+	/* The columns can't change while results are being
+	applied, so each column only needs to be looked up in
+	the header once. */
+	std::unordered_map<int, boost::optional<int>> columnIndexes;
+
+	ColumnResult_t result;
+
+	while (m_columnResults.TryPop(result))
 	{
-		// This result is for a previous folder. It can be ignored.
-		return;
+		if (result.cacheKey)
+		{
+			m_columnCache->Insert(result.cacheKey->path, result.cacheKey->fileSize, result.cacheKey->lastWriteTime,
+				result.columnID, result.columnText);
+		}
+
+		/* If the generation doesn't match, this result is for a
+		previous folder (or view), and can be ignored. */
+		if (result.generation == m_columnResultGeneration
+			&& m_folderSettings.viewMode == +ViewMode::Details)
+		{
+			auto columnIndexItr = columnIndexes.find(result.columnID);
+
+			if (columnIndexItr == columnIndexes.end())
+			{
+				columnIndexItr = columnIndexes.insert({ result.columnID, GetColumnIndexById(result.columnID) }).first;
+			}
+
+			/* Either of these may be missing. The item may have
+			been deleted and the column may have been removed. */
+			auto index = LocateItemByInternalIndex(result.itemInternalIndex);
+			auto columnIndex = columnIndexItr->second;
+
+			if (index && columnIndex)
+			{
+				ListView_SetItemText(m_hListView, *index, *columnIndex, result.columnText.data());
+			}
+		}
+
+		if (std::chrono::steady_clock::now() - start >= COLUMN_RESULT_TIME_SLICE)
+		{
+			if (!m_columnResults.IsEmpty() && !m_columnResultsPending.exchange(true))
+			{
+				PostMessage(m_hListView, WM_APP_COLUMN_RESULTS_READY, 0, 0);
+			}
+
+			break;
+		}
 	}
+}
+
+/* Returns the text for the specified item and column from the column
+cache, if it's there. */
+boost::optional<std::wstring> ShellBrowser::GetCachedColumnText(int itemInternalIndex, int columnIndex)
+{
+	auto columnID = GetColumnIdByIndex(columnIndex);
 
-	if (m_folderSettings.viewMode != +ViewMode::Details)
+	if (!columnID || !CanCacheColumnText(*columnID))
 	{
-		return;
+		return boost::none;
 	}
 
-	auto result = itr->second.get();
+	auto cacheKey = GetColumnCacheKey(m_itemShellInfo[itemInternalIndex].pidlComplete.get(),
+		GetItemFindData(itemInternalIndex));
+
+	if (!cacheKey)
+	{
+		return boost::none;
+	}
 
-	auto index = LocateItemByInternalIndex(result.itemInternalIndex);
+	auto text = m_columnCache->Find(cacheKey->path, cacheKey->fileSize, cacheKey->lastWriteTime, *columnID);
 
-	if (!index)
+	if (!text)
 	{
-		// This is a valid state. The item may simply have been deleted.
-		return;
+		return boost::none;
 	}
 
-	auto columnIndex = GetColumnIndexById(result.columnID);
+	return *text;
+}
+
+bool ShellBrowser::CanCacheColumnText(unsigned int columnId) const
+{
+	/* Items in virtual folders don't necessarily have a
+	size or modification time that can be used to detect
+	changes. */
+	return m_columnCache && !m_bVirtualFolder && IsColumnTextCacheable(columnId);
+}
+
+boost::optional<ShellBrowser::ColumnCacheKey_t> ShellBrowser::GetColumnCacheKey(PCIDLIST_ABSOLUTE pidl,
+	const WIN32_FIND_DATA &wfd)
+{
+	TCHAR path[MAX_PATH];
+	HRESULT hr = GetDisplayName(pidl, path, SIZEOF_ARRAY(path), SHGDN_FORPARSING);
 
-	if (!columnIndex)
+	if (FAILED(hr))
 	{
-		// This is also a valid state. The column may have been removed.
-		return;
+		return boost::none;
 	}
 
-	auto columnText = std::make_unique<TCHAR[]>(result.columnText.size() + 1);
-	StringCchCopy(columnText.get(), result.columnText.size() + 1, result.columnText.c_str());
-	ListView_SetItemText(m_hListView, *index, *columnIndex, columnText.get());
+	ULARGE_INTEGER fileSize = { wfd.nFileSizeLow, wfd.nFileSizeHigh };
+	ULARGE_INTEGER lastWriteTime = { wfd.ftLastWriteTime.dwLowDateTime, wfd.ftLastWriteTime.dwHighDateTime };
+
+	ColumnCacheKey_t cacheKey;
+	cacheKey.path = path;
+	cacheKey.fileSize = fileSize.QuadPart;
+	cacheKey.lastWriteTime = lastWriteTime.QuadPart;
 
-	m_columnResults.erase(itr);
+	return cacheKey;
 }
 
 boost::optional<int> ShellBrowser::GetColumnIndexById(unsigned int id) const
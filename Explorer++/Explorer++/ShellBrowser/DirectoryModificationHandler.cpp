@@ -8,7 +8,7 @@
 #include "ViewModes.h"
 #include "../Helper/Controls.h"
 #include "../Helper/FileOperations.h"
-#include "../Helper/FolderSize.h"
+#include "../Helper/FolderSizeService.h"
 #include "../Helper/Helper.h"
 #include "../Helper/ListViewHelper.h"
 #include "../Helper/Logging.h"
@@ -16,73 +16,43 @@
 #include "../Helper/ShellHelper.h"
 #include <list>
 
-BOOL g_bNewFileRenamed = FALSE;
-static int iRenamedItem;
-
 void ShellBrowser::DirectoryAltered(void)
 {
 	BOOL bNewItemCreated;
 
+	/* Take the changes that have built up so far. Any
+	further notifications will start a new batch. The
+	changes are only applied if they were recorded for
+	the current folder (i.e. ensure the directory has not
+	changed since these files were modified). */
 	EnterCriticalSection(&m_csDirectoryAltered);
+	bool changesApply = (m_changeJournalFolderId == m_uniqueFolderId);
+	size_t numEvents = m_changeJournal.GetNumEvents();
+	ChangeJournal::Changes changes = m_changeJournal.TakeChanges();
+	LeaveCriticalSection(&m_csDirectoryAltered);
 
 	bNewItemCreated = m_bNewItemCreated;
 
 	SendMessage(m_hListView,WM_SETREDRAW,(WPARAM)FALSE,(LPARAM)NULL);
 
-	LOG(debug) << _T("ShellBrowser - Starting directory change update for \"") << m_CurDir << _T("\"");
-
-	/* Potential problem:
-	After a file is created, it may be renamed shortly afterwards.
-	If the rename occurs before the file is added here, the
-	addition won't be registered (since technically, the file
-	does not exist), and the rename operation will not take place.
-	Adding an item that does not exist will corrupt the programs
-	state.
-
-	Solution:
-	If a file does not exist when adding it, temporarily remember
-	its filename. On the next rename operation, if the renamed
-	file matches the name of the added file, add the file in-place
-	with its new name.
-	The operation should NOT be queued, as it is possible that
-	other actions for the file will take place before the addition,
-	which will again result in an incorrect state.
-	*/
-	for(const auto &af : m_AlteredList)
-	{
-		/* Only undertake the modification if the unique folder
-		index on the modified item and current folder match up
-		(i.e. ensure the directory has not changed since these
-		files were modified). */
-		if(af.iFolderIndex == m_uniqueFolderId)
-		{
-			switch(af.dwAction)
-			{
-			case FILE_ACTION_ADDED:
-				LOG(debug) << _T("ShellBrowser - Adding \"") << af.szFileName << _T("\"");
-				OnFileActionAdded(af.szFileName);
-				break;
-
-			case FILE_ACTION_MODIFIED:
-				LOG(debug) << _T("ShellBrowser - Modifying \"") << af.szFileName << _T("\"");
-				ModifyItemInternal(af.szFileName);
-				break;
+	LOG(debug) << _T("ShellBrowser - Starting directory change update for \"") << m_CurDir << _T("\" (")
+		<< numEvents << _T(" notifications)");
 
-			case FILE_ACTION_REMOVED:
-				LOG(debug) << _T("ShellBrowser - Removing \"") << af.szFileName << _T("\"");
-				RemoveItemInternal(af.szFileName);
-				break;
-
-			case FILE_ACTION_RENAMED_OLD_NAME:
-				LOG(debug) << _T("ShellBrowser - Old name received \"") << af.szFileName << _T("\"");
-				OnFileActionRenamedOldName(af.szFileName);
-				break;
-
-			case FILE_ACTION_RENAMED_NEW_NAME:
-				LOG(debug) << _T("ShellBrowser - New name received \"") << af.szFileName << _T("\"");
-				OnFileActionRenamedNewName(af.szFileName);
-				break;
-			}
+	if(changesApply)
+	{
+		/* Too many changes have occurred for them to be
+		tracked individually. Listing the directory again can
+		take a while (which is exactly when this happens), so
+		it's done in the background and the differences are
+		applied once the listing is complete. */
+		if(changes.overflowed)
+		{
+			LOG(debug) << _T("ShellBrowser - Too many changes, rescanning directory");
+			QueueRevalidation();
+		}
+		else
+		{
+			ApplyDirectoryChanges(changes);
 		}
 	}
 
@@ -104,8 +74,186 @@ void ShellBrowser::DirectoryAltered(void)
 	if(bNewItemCreated && !m_bNewItemCreated)
 		SendMessage(m_hOwner,WM_USER_NEWITEMINSERTED,0,m_iIndexNewItem);
 
-	m_AlteredList.clear();
+	SelectPendingFiles();
+}
+
+/* Applies a set of coalesced changes. The changes are
+applied in the order described in ChangeJournal::Changes. */
+void ShellBrowser::ApplyDirectoryChanges(const ChangeJournal::Changes &changes)
+{
+	std::vector<int> removedItems;
+
+	for(const auto &fileName : changes.removed)
+	{
+		NotifyFolderSizeItemRemoved(m_itemStore.FindItemByFileName(fileName));
+
+		/* If the item is still waiting to be added, it can
+		simply be dropped from the queue. */
+		if(RemovePendingFileAddition(fileName.c_str()))
+		{
+			continue;
+		}
+
+		int internalIndex = LocateFileItemInternalIndex(fileName.c_str());
+
+		if(internalIndex != -1)
+		{
+			removedItems.push_back(internalIndex);
+		}
+	}
+
+	RemoveItems(removedItems);
+
+	/* All renamed items are located before any of them
+	are renamed. Otherwise, a set of renames that swaps
+	names between items could end up renaming the wrong
+	item. */
+	std::vector<std::pair<int, const std::wstring *>> renamedItems;
+	std::vector<const std::wstring *> renamedPendingAdditions;
+
+	for(const auto &rename : changes.renamed)
+	{
+		/* It is possible that a file was created and then
+		renamed before its addition could be processed. In
+		that case, the file can now be added with its new
+		name. */
+		if(RemovePendingFileAddition(rename.oldName.c_str()))
+		{
+			renamedPendingAdditions.push_back(&rename.newName);
+			continue;
+		}
+
+		renamedItems.push_back({ LocateFileItemInternalIndex(rename.oldName.c_str()), &rename.newName });
+	}
+
+	for(const auto &renamedItem : renamedItems)
+	{
+		std::wstring oldFileName;
+
+		if(renamedItem.first != -1)
+		{
+			oldFileName = m_itemStore.GetFileName(renamedItem.first);
+		}
+
+		RenameItem(renamedItem.first,renamedItem.second->c_str());
+		NotifyFolderSizeItemRenamed(renamedItem.first,oldFileName);
+	}
+
+	for(const auto &fileName : changes.modified)
+	{
+		int internalIndex = m_itemStore.FindItemByFileName(fileName);
+		uint64_t oldSize = (internalIndex != -1) ? m_itemStore.GetSize(internalIndex) : 0;
+
+		ModifyItemInternal(fileName.c_str());
+		NotifyFolderSizeItemModified(internalIndex,oldSize);
+	}
+
+	for(const auto &fileName : changes.added)
+	{
+		OnFileActionAdded(fileName.c_str());
+		NotifyFolderSizeItemAdded(m_itemStore.FindItemByFileName(fileName));
+	}
+
+	for(const auto *fileName : renamedPendingAdditions)
+	{
+		OnFileActionAdded(fileName->c_str());
+		NotifyFolderSizeItemAdded(m_itemStore.FindItemByFileName(*fileName));
+	}
+
+	if(m_virtualList)
+	{
+		FlushVirtualItemChanges();
+	}
+
+	/* Removing, renaming or modifying an item can change
+	the number of items in a group. Each header is updated
+	once, now that every change has been applied. */
+	UpdateGroupHeaders();
+
+	/* If the folder is still being read, the remaining items
+	can no longer simply be merged in. */
+	m_enumerationSortedItems.clear();
+}
+
+/* The folder size service is told about each change
+made to this folder, so that any sizes it has cached for
+this folder (and its parents) remain accurate. */
+std::wstring ShellBrowser::GetFolderSizeItemPath(int internalIndex) const
+{
+	TCHAR fullPath[MAX_PATH];
+	StringCchCopy(fullPath,SIZEOF_ARRAY(fullPath),m_CurDir);
+	PathAppend(fullPath,std::wstring(m_itemStore.GetFileName(internalIndex)).c_str());
+
+	return fullPath;
+}
+
+void ShellBrowser::NotifyFolderSizeItemAdded(int internalIndex)
+{
+	if(internalIndex == -1 || m_bVirtualFolder)
+	{
+		return;
+	}
+
+	if(m_itemStore.IsFolder(internalIndex))
+	{
+		FolderSizeService::GetShared().OnFolderAdded(GetFolderSizeItemPath(internalIndex));
+	}
+	else
+	{
+		FolderSizeService::GetShared().OnFileAdded(GetFolderSizeItemPath(internalIndex),
+			m_itemStore.GetSize(internalIndex));
+	}
+}
+
+void ShellBrowser::NotifyFolderSizeItemRemoved(int internalIndex)
+{
+	if(internalIndex == -1 || m_bVirtualFolder)
+	{
+		return;
+	}
+
+	if(m_itemStore.IsFolder(internalIndex))
+	{
+		FolderSizeService::GetShared().OnFolderRemoved(GetFolderSizeItemPath(internalIndex));
+	}
+	else
+	{
+		FolderSizeService::GetShared().OnFileRemoved(GetFolderSizeItemPath(internalIndex),
+			m_itemStore.GetSize(internalIndex));
+	}
+}
+
+void ShellBrowser::NotifyFolderSizeItemModified(int internalIndex,uint64_t oldSize)
+{
+	if(internalIndex == -1 || m_bVirtualFolder || m_itemStore.IsFolder(internalIndex))
+	{
+		return;
+	}
+
+	FolderSizeService::GetShared().OnFileModified(GetFolderSizeItemPath(internalIndex),
+		oldSize,m_itemStore.GetSize(internalIndex));
+}
+
+void ShellBrowser::NotifyFolderSizeItemRenamed(int internalIndex,const std::wstring &oldFileName)
+{
+	/* Renaming a file doesn't change the size of any
+	folder. */
+	if(internalIndex == -1 || m_bVirtualFolder || !m_itemStore.IsFolder(internalIndex))
+	{
+		return;
+	}
+
+	TCHAR oldPath[MAX_PATH];
+	StringCchCopy(oldPath,SIZEOF_ARRAY(oldPath),m_CurDir);
+	PathAppend(oldPath,oldFileName.c_str());
+
+	FolderSizeService::GetShared().OnFolderRenamed(oldPath,GetFolderSizeItemPath(internalIndex));
+}
 
+/* Selects any items that were due to be selected, but
+which hadn't yet been inserted. */
+void ShellBrowser::SelectPendingFiles()
+{
 	BOOL bFocusSet = FALSE;
 	int iIndex;
 
@@ -135,10 +283,92 @@ void ShellBrowser::DirectoryAltered(void)
 			++itr;
 		}
 	}
+}
 
-	LeaveCriticalSection(&m_csDirectoryAltered);
+std::vector<ChangeJournal::ListingEntry> ShellBrowser::GetItemStoreListing() const
+{
+	std::vector<ChangeJournal::ListingEntry> listing;
+	listing.reserve(m_itemStore.GetNumItems());
 
-	return;
+	for(int i = 0;i < m_itemStore.GetIdLimit();i++)
+	{
+		if(!m_itemStore.IsValidItem(i))
+		{
+			continue;
+		}
+
+		listing.push_back({ std::wstring(m_itemStore.GetFileName(i)), m_itemStore.GetSize(i),
+			m_itemStore.GetLastWriteTime(i) });
+	}
+
+	return listing;
+}
+
+/* This only depends on its arguments, so it can be called
+from a background thread. */
+boost::optional<std::vector<ChangeJournal::ListingEntry>> ShellBrowser::ListDirectory(
+	const std::wstring &directory, bool showHidden)
+{
+	std::vector<ChangeJournal::ListingEntry> listing;
+
+	TCHAR szSearchPattern[MAX_PATH];
+	StringCchCopy(szSearchPattern,SIZEOF_ARRAY(szSearchPattern),directory.c_str());
+	PathAppend(szSearchPattern,_T("*"));
+
+	WIN32_FIND_DATA wfd;
+	HANDLE hFindFile = FindFirstFile(szSearchPattern,&wfd);
+
+	if(hFindFile == INVALID_HANDLE_VALUE)
+	{
+		return boost::none;
+	}
+
+	do
+	{
+		if(lstrcmp(wfd.cFileName,_T(".")) == 0 || lstrcmp(wfd.cFileName,_T("..")) == 0)
+		{
+			continue;
+		}
+
+		if(!showHidden && WI_IsFlagSet(wfd.dwFileAttributes,FILE_ATTRIBUTE_HIDDEN))
+		{
+			continue;
+		}
+
+		ItemStore::FileData fileData = FindDataToFileData(wfd);
+		listing.push_back({ wfd.cFileName, fileData.size, fileData.lastWriteTime });
+	} while(FindNextFile(hFindFile,&wfd));
+
+	FindClose(hFindFile);
+
+	return listing;
+}
+
+void ShellBrowser::ApplyListingChanges(ChangeJournal::Changes changes)
+{
+	/* Removals are handled here, rather than by name, since
+	an item that's been filtered out still needs to be
+	removed, even though it's not in the listview. */
+	std::vector<int> removedItems;
+
+	for(const auto &fileName : changes.removed)
+	{
+		int internalIndex = m_itemStore.FindItemByFileName(fileName);
+
+		if(internalIndex == -1)
+		{
+			continue;
+		}
+
+		NotifyFolderSizeItemRemoved(internalIndex);
+		removedItems.push_back(internalIndex);
+	}
+
+	RemoveItems(removedItems);
+
+	changes.removed.clear();
+
+	ApplyDirectoryChanges(changes);
 }
 
 void CALLBACK TimerProc(HWND hwnd,UINT uMsg,UINT_PTR idEvent,DWORD dwTime)
@@ -154,17 +384,54 @@ void CALLBACK TimerProc(HWND hwnd,UINT uMsg,UINT_PTR idEvent,DWORD dwTime)
 void ShellBrowser::FilesModified(DWORD Action,const TCHAR *FileName,
 int EventId,int iFolderIndex)
 {
-	EnterCriticalSection(&m_csDirectoryAltered);
+	ChangeJournal::Action action;
 
-	SetTimer(m_hOwner,EventId,200,TimerProc);
+	switch(Action)
+	{
+	case FILE_ACTION_ADDED:
+		action = ChangeJournal::Action::Added;
+		break;
+
+	case FILE_ACTION_REMOVED:
+		action = ChangeJournal::Action::Removed;
+		break;
 
-	AlteredFile_t af;
+	case FILE_ACTION_MODIFIED:
+		action = ChangeJournal::Action::Modified;
+		break;
 
-	StringCchCopy(af.szFileName,SIZEOF_ARRAY(af.szFileName),FileName);
-	af.dwAction = Action;
-	af.iFolderIndex = iFolderIndex;
+	case FILE_ACTION_RENAMED_OLD_NAME:
+		action = ChangeJournal::Action::RenamedOldName;
+		break;
 
-	m_AlteredList.push_back(af);
+	case FILE_ACTION_RENAMED_NEW_NAME:
+		action = ChangeJournal::Action::RenamedNewName;
+		break;
+
+	default:
+		return;
+	}
+
+	EnterCriticalSection(&m_csDirectoryAltered);
+
+	/* Notifications for a previous folder are of no use once
+	a new folder has been browsed to. */
+	if(iFolderIndex != m_changeJournalFolderId)
+	{
+		m_changeJournal.Clear();
+		m_changeJournalFolderId = iFolderIndex;
+	}
+
+	/* The timer is only set when the first change in a batch
+	is received. Changes received after that are simply
+	folded into the batch, so a steady stream of changes
+	can't hold off the update indefinitely. */
+	if(m_changeJournal.IsEmpty())
+	{
+		SetTimer(m_hOwner,EventId,200,TimerProc);
+	}
+
+	m_changeJournal.AddEvent(action,FileName);
 
 	LeaveCriticalSection(&m_csDirectoryAltered);
 }
@@ -225,8 +492,9 @@ void ShellBrowser::OnFileActionAdded(const TCHAR *szFileName)
 				}
 
 				/* Only insert the item in its sorted position if it
-				wasn't dropped in. */
-				if(m_config->globalFolderSettings.insertSorted && !bDropped)
+				wasn't dropped in. An owner-data listview is always
+				sorted, so the position isn't needed in that case. */
+				if(m_config->globalFolderSettings.insertSorted && !bDropped && !m_virtualList)
 				{
 					int iItemId;
 					int iSorted;
@@ -243,7 +511,13 @@ void ShellBrowser::OnFileActionAdded(const TCHAR *szFileName)
 					AddItemInternal(m_directoryState.pidlDirectory.get(),pidlRelative,szDisplayName,-1,FALSE);
 				}
 				
-				InsertAwaitingItems(m_folderSettings.showInGroups);
+				/* Items added to an owner-data listview are inserted
+				together, once the caller has finished making
+				changes (see FlushVirtualItemChanges()). */
+				if(!m_virtualList)
+				{
+					InsertAwaitingItems(m_folderSettings.showInGroups);
+				}
 
 				bFileAdded = TRUE;
 			}
@@ -263,31 +537,21 @@ void ShellBrowser::OnFileActionAdded(const TCHAR *szFileName)
 	}
 }
 
-void ShellBrowser::RemoveItemInternal(const TCHAR *szFileName)
+/* Removes the file from the list of files whose addition
+failed (because they didn't exist at the time). Returns
+true if the file was found. */
+bool ShellBrowser::RemovePendingFileAddition(const TCHAR *szFileName)
 {
-	std::list<Added_t>::iterator itr;
-	int iItemInternal;
-	BOOL bFound = FALSE;
-
-	/* First check if this item is in the queue of awaiting
-	items. If it is, remove it. */
-	for(itr = m_FilesAdded.begin();itr != m_FilesAdded.end();itr++)
+	for(auto itr = m_FilesAdded.begin();itr != m_FilesAdded.end();itr++)
 	{
 		if(lstrcmp(szFileName,itr->szFileName) == 0)
 		{
 			m_FilesAdded.erase(itr);
-			bFound = TRUE;
-			break;
+			return true;
 		}
 	}
 
-	if(!bFound)
-	{
-		iItemInternal = LocateFileItemInternalIndex(szFileName);
-
-		if(iItemInternal != -1)
-			RemoveItem(iItemInternal);
-	}
+	return false;
 }
 
 /*
@@ -296,6 +560,7 @@ void ShellBrowser::RemoveItemInternal(const TCHAR *szFileName)
 void ShellBrowser::ModifyItemInternal(const TCHAR *FileName)
 {
 	HANDLE			hFirstFile;
+	WIN32_FIND_DATA	wfd;
 	ULARGE_INTEGER	ulFileSize;
 	LVITEM			lvItem;
 	TCHAR			FullFileName[MAX_PATH];
@@ -331,7 +596,7 @@ void ShellBrowser::ModifyItemInternal(const TCHAR *FileName)
 
 		for(itr = m_AwaitingAddList.begin();itr!= m_AwaitingAddList.end();itr++)
 		{
-			if(lstrcmp(m_itemInfoMap.at(itr->iItemInternal).wfd.cFileName,FileName) == 0)
+			if(m_itemStore.GetFileName(itr->iItemInternal) == FileName)
 			{
 				iItemInternal = itr->iItemInternal;
 				break;
@@ -376,45 +641,40 @@ void ShellBrowser::ModifyItemInternal(const TCHAR *FileName)
 	if(iItemInternal != -1)
 	{
 		/* Is this item a folder? */
-		bFolder = (m_itemInfoMap.at(iItemInternal).wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ==
-			FILE_ATTRIBUTE_DIRECTORY;
+		bFolder = m_itemStore.IsFolder(iItemInternal);
 
-		ulFileSize.LowPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeLow;
-		ulFileSize.HighPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeHigh;
+		ulFileSize.QuadPart = m_itemStore.GetSize(iItemInternal);
 
 		m_ulTotalDirSize.QuadPart -= ulFileSize.QuadPart;
 
 		if(ListView_GetItemState(m_hListView,iItem,LVIS_SELECTED)
 		== LVIS_SELECTED)
 		{
-			ulFileSize.LowPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeLow;
-			ulFileSize.HighPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeHigh;
-
 			m_ulFileSelectionSize.QuadPart -= ulFileSize.QuadPart;
 		}
 
 		StringCchCopy(FullFileName,SIZEOF_ARRAY(FullFileName),m_CurDir);
 		PathAppend(FullFileName,FileName);
 
-		hFirstFile = FindFirstFile(FullFileName,&m_itemInfoMap.at(iItemInternal).wfd);
+		hFirstFile = FindFirstFile(FullFileName,&wfd);
 
 		if(hFirstFile != INVALID_HANDLE_VALUE)
 		{
-			ulFileSize.LowPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeLow;
-			ulFileSize.HighPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeHigh;
+			m_itemStore.SetFileData(iItemInternal, FindDataToFileData(wfd));
+			UpdateItemColorRule(iItemInternal);
+			UpdateItemSnapshot(iItemInternal);
+
+			ulFileSize.QuadPart = m_itemStore.GetSize(iItemInternal);
 
 			m_ulTotalDirSize.QuadPart += ulFileSize.QuadPart;
 
 			if(ListView_GetItemState(m_hListView,iItem,LVIS_SELECTED)
 				== LVIS_SELECTED)
 			{
-				ulFileSize.LowPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeLow;
-				ulFileSize.HighPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeHigh;
-
 				m_ulFileSelectionSize.QuadPart += ulFileSize.QuadPart;
 			}
 
-			if((m_itemInfoMap.at(iItemInternal).wfd.dwFileAttributes & FILE_ATTRIBUTE_HIDDEN) ==
+			if((wfd.dwFileAttributes & FILE_ATTRIBUTE_HIDDEN) ==
 				FILE_ATTRIBUTE_HIDDEN)
 			{
 				ListView_SetItemState(m_hListView,iItem,LVIS_CUT,LVIS_CUT);
@@ -449,56 +709,15 @@ void ShellBrowser::ModifyItemInternal(const TCHAR *FileName)
 			modification. If the internal structures still hold
 			the old size, the total directory size will become
 			corrupted. */
-			m_itemInfoMap.at(iItemInternal).wfd.nFileSizeLow = 0;
-			m_itemInfoMap.at(iItemInternal).wfd.nFileSizeHigh = 0;
+			m_itemStore.SetSize(iItemInternal, 0);
+			UpdateItemSnapshot(iItemInternal);
 		}
-	}
-}
 
-void ShellBrowser::OnFileActionRenamedOldName(const TCHAR *szFileName)
-{
-	std::list<Added_t>::iterator itrAdded;
-	BOOL bFileHandled = FALSE;
-
-	/* Loop through each file that is awaiting add to check for the
-	renamed file. */
-	for(itrAdded = m_FilesAdded.begin();itrAdded != m_FilesAdded.end();itrAdded++)
-	{
-		if(lstrcmp(szFileName,itrAdded->szFileName) == 0)
+		if(m_virtualList)
 		{
-			bFileHandled = TRUE;
-
-			g_bNewFileRenamed = TRUE;
-
-			m_FilesAdded.erase(itrAdded);
-
-			break;
+			UpdateVirtualItem(iItemInternal);
 		}
 	}
-
-	if(!bFileHandled)
-	{
-		/* Find the index of the item that was renamed...
-		Store the index so that it is known which item needs
-		renaming when the files new name is received. */
-		iRenamedItem = LocateFileItemInternalIndex(szFileName);
-	}
-}
-
-void ShellBrowser::OnFileActionRenamedNewName(const TCHAR *szFileName)
-{
-	if(g_bNewFileRenamed)
-	{
-		/* The file that was previously added was renamed before
-		it could be added. Add the file now. */
-		OnFileActionAdded(szFileName);
-
-		g_bNewFileRenamed = FALSE;
-	}
-	else
-	{
-		RenameItem(iRenamedItem,szFileName);
-	}
 }
 
 /* Renames an item currently in the listview.
@@ -512,7 +731,6 @@ void ShellBrowser::RenameItem(int iItemInternal,const TCHAR *szNewFileName)
 	IShellFolder	*pShellFolder = NULL;
 	PCITEMID_CHILD	pidlRelative = NULL;
 	SHFILEINFO		shfi;
-	LVFINDINFO		lvfi;
 	TCHAR			szDisplayName[MAX_PATH];
 	LVITEM			lvItem;
 	TCHAR			szFullFileName[MAX_PATH];
@@ -523,7 +741,7 @@ void ShellBrowser::RenameItem(int iItemInternal,const TCHAR *szNewFileName)
 	if(iItemInternal == -1)
 		return;
 
-	auto &itemInfo = m_itemInfoMap.at(iItemInternal);
+	auto &itemShellInfo = m_itemShellInfo[iItemInternal];
 
 	StringCchCopy(szFullFileName,SIZEOF_ARRAY(szFullFileName),m_CurDir);
 	PathAppend(szFullFileName,szNewFileName);
@@ -541,10 +759,17 @@ void ShellBrowser::RenameItem(int iItemInternal,const TCHAR *szNewFileName)
 
 			if(SUCCEEDED(hr))
 			{
-				itemInfo.pidlComplete.reset(ILCloneFull(pidlFull.get()));
-				itemInfo.pridl.reset(ILCloneChild(pidlRelative));
-				StringCchCopy(itemInfo.szDisplayName, SIZEOF_ARRAY(itemInfo.szDisplayName), szDisplayName);
-				StringCchCopy(itemInfo.wfd.cFileName, SIZEOF_ARRAY(itemInfo.wfd.cFileName), szNewFileName);
+				itemShellInfo.pidlComplete.reset(ILCloneFull(pidlFull.get()));
+				itemShellInfo.pridl.reset(ILCloneChild(pidlRelative));
+				m_itemStore.SetDisplayName(iItemInternal, szDisplayName);
+				m_itemStore.SetFileName(iItemInternal, szNewFileName);
+				UpdateItemColorRule(iItemInternal);
+				UpdateItemSnapshot(iItemInternal);
+
+				if(m_virtualList)
+				{
+					UpdateVirtualItem(iItemInternal);
+				}
 
 				/* The files' type may have changed, so retrieve the files'
 				icon again. */
@@ -555,13 +780,13 @@ void ShellBrowser::RenameItem(int iItemInternal,const TCHAR *szNewFileName)
 				if(res != 0)
 				{
 					/* Locate the item within the listview. */
-					lvfi.flags	= LVFI_PARAM;
-					lvfi.lParam	= iItemInternal;
-					iItem = ListView_FindItem(m_hListView,-1,&lvfi);
+					auto item = LocateItemByInternalIndex(iItemInternal);
 
-					if(iItem != -1)
+					if(item)
 					{
-						BasicItemInfo_t basicItemInfo = getBasicItemInfo(iItemInternal);
+						iItem = *item;
+
+						const BasicItemInfo_t &basicItemInfo = getBasicItemInfo(iItemInternal);
 						std::wstring filename = ProcessItemFileName(basicItemInfo, m_config->globalFolderSettings);
 
 						TCHAR filenameCopy[MAX_PATH];
@@ -583,9 +808,9 @@ void ShellBrowser::RenameItem(int iItemInternal,const TCHAR *szNewFileName)
 						ListView_SetItem(m_hListView,&lvItem);
 
 						/* TODO: Does the file need to be filtered out? */
-						if(IsFileFiltered(itemInfo))
+						if(IsFileFiltered(iItemInternal))
 						{
-							RemoveFilteredItem(iItem,iItemInternal);
+							RemoveFilteredItems({ iItemInternal });
 						}
 					}
 
@@ -598,7 +823,14 @@ void ShellBrowser::RenameItem(int iItemInternal,const TCHAR *szNewFileName)
 	}
 	else
 	{
-		StringCchCopy(itemInfo.szDisplayName, SIZEOF_ARRAY(itemInfo.szDisplayName), szNewFileName);
-		StringCchCopy(itemInfo.wfd.cFileName, SIZEOF_ARRAY(itemInfo.wfd.cFileName), szNewFileName);
+		m_itemStore.SetDisplayName(iItemInternal, szNewFileName);
+		m_itemStore.SetFileName(iItemInternal, szNewFileName);
+		UpdateItemColorRule(iItemInternal);
+		UpdateItemSnapshot(iItemInternal);
+
+		if(m_virtualList)
+		{
+			UpdateVirtualItem(iItemInternal);
+		}
 	}
 }
\ No newline at end of file
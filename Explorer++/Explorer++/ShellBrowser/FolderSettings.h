@@ -35,6 +35,15 @@ struct GlobalFolderSettings
 	BOOL oneClickActivate;
 	UINT oneClickActivateHoverTime;
 
+	/* The width and height of each thumbnail in thumbnails view.
+	This is always one of ThumbnailLevels::THUMBNAIL_SIZES. */
+	int thumbnailSize;
+
+	/* The maximum amount of memory (in megabytes) used to hold
+	thumbnails in each tab. Thumbnails for items far away from
+	the viewport are discarded to stay within this. */
+	int thumbnailMemoryBudget;
+
 	FolderColumns folderColumns;
 };
 
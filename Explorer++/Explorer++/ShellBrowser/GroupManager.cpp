@@ -10,15 +10,14 @@
 #include "SortModes.h"
 #include "../Helper/Helper.h"
 #include "../Helper/Macros.h"
+#include "../Helper/ParallelSort.h"
 #include "../Helper/ShellHelper.h"
 #include "../Helper/TimeHelper.h"
-#include <boost/date_time/gregorian/gregorian.hpp>
-#include <boost/date_time/posix_time/posix_time.hpp>
 #include <wil/common.h>
 #include <iphlpapi.h>
 #include <propkey.h>
 #include <cassert>
-#include <list>
+#include <vector>
 
 namespace
 {
@@ -65,8 +64,8 @@ INT CALLBACK ShellBrowser::GroupNameComparison(INT Group1_ID, INT Group2_ID)
 {
 	int iReturnValue;
 
-	std::wstring groupHeader1 = RetrieveGroupHeader(Group1_ID);
-	std::wstring groupHeader2 = RetrieveGroupHeader(Group2_ID);
+	const std::wstring &groupHeader1 = m_groupIndex.GetGroup(Group1_ID)->header;
+	const std::wstring &groupHeader2 = m_groupIndex.GetGroup(Group2_ID)->header;
 
 	if (groupHeader1 == L"Other" && groupHeader2 != L"Other")
 	{
@@ -82,7 +81,7 @@ INT CALLBACK ShellBrowser::GroupNameComparison(INT Group1_ID, INT Group2_ID)
 	}
 	else
 	{
-		iReturnValue = groupHeader1.compare(groupHeader2);
+		iReturnValue = CompareCollationKeys(m_groupHeaderKeys[Group1_ID], m_groupHeaderKeys[Group2_ID]);
 	}
 
 	if (!m_folderSettings.sortAscending)
@@ -103,8 +102,8 @@ INT CALLBACK ShellBrowser::GroupFreeSpaceComparison(INT Group1_ID, INT Group2_ID
 {
 	int iReturnValue;
 
-	std::wstring groupHeader1 = RetrieveGroupHeader(Group1_ID);
-	std::wstring groupHeader2 = RetrieveGroupHeader(Group2_ID);
+	const std::wstring &groupHeader1 = m_groupIndex.GetGroup(Group1_ID)->header;
+	const std::wstring &groupHeader2 = m_groupIndex.GetGroup(Group2_ID)->header;
 
 	if (groupHeader1 == L"Unspecified" && groupHeader2 != L"Unspecified")
 	{
@@ -120,7 +119,7 @@ INT CALLBACK ShellBrowser::GroupFreeSpaceComparison(INT Group1_ID, INT Group2_ID
 	}
 	else
 	{
-		iReturnValue = groupHeader1.compare(groupHeader2);
+		iReturnValue = CompareCollationKeys(m_groupHeaderKeys[Group1_ID], m_groupHeaderKeys[Group2_ID]);
 	}
 
 	if (!m_folderSettings.sortAscending)
@@ -131,55 +130,80 @@ INT CALLBACK ShellBrowser::GroupFreeSpaceComparison(INT Group1_ID, INT Group2_ID
 	return iReturnValue;
 }
 
-std::wstring ShellBrowser::RetrieveGroupHeader(int groupId)
+PFNLVGROUPCOMPARE ShellBrowser::GetGroupComparison() const
 {
-	auto itr = std::find_if(m_GroupList.begin(), m_GroupList.end(), [groupId] (const TypeGroup_t &group) {
-		return group.iGroupId == groupId;
+	if (m_folderSettings.sortMode == +SortMode::FreeSpace)
+	{
+		return GroupFreeSpaceComparisonStub;
+	}
+
+	return GroupNameComparisonStub;
+}
+
+/* Determines the group headers for the specified
+items in parallel. As with sort keys, some headers
+(e.g. those for item details) are retrieved via COM. */
+std::vector<std::wstring> ShellBrowser::DetermineItemGroups(const std::vector<int> &internalIndices)
+{
+	auto dateType = GetGroupByDateType(m_folderSettings.sortMode);
+
+	if (dateType)
+	{
+		return DetermineItemDateGroups(internalIndices, *dateType);
+	}
+
+	std::vector<std::wstring> groupHeaders(internalIndices.size());
+
+	ParallelSort::ParallelFor(TaskExecutor::GetShared(), internalIndices.size(), [this, &internalIndices, &groupHeaders] (size_t begin, size_t end) {
+		HRESULT hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+
+		for(size_t i = begin;i < end;i++)
+		{
+			groupHeaders[i] = DetermineItemGroup(internalIndices[i]);
+		}
+
+		if(SUCCEEDED(hr))
+		{
+			CoUninitialize();
+		}
 	});
 
-	return itr->header;
+	return groupHeaders;
 }
 
 /*
- * Determines the id of the group the specified
+ * Determines the header of the group the specified
  * item belongs to.
  */
-int ShellBrowser::DetermineItemGroup(int iItemInternal)
+std::wstring ShellBrowser::DetermineItemGroup(int iItemInternal) const
 {
-	BasicItemInfo_t basicItemInfo = getBasicItemInfo(iItemInternal);
-	PFNLVGROUPCOMPARE groupComparison = nullptr;
+	const BasicItemInfo_t &basicItemInfo = getBasicItemInfo(iItemInternal);
 	std::wstring groupHeader;
 
 	switch(m_folderSettings.sortMode)
 	{
 		case SortMode::Name:
 			groupHeader = DetermineItemNameGroup(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::Type:
 			groupHeader = DetermineItemTypeGroupVirtual(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::Size:
 			groupHeader = DetermineItemSizeGroup(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::DateModified:
 			groupHeader = DetermineItemDateGroup(basicItemInfo, GroupByDateType::Modified);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::TotalSize:
 			groupHeader = DetermineItemTotalSizeGroup(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::FreeSpace:
 			groupHeader = DetermineItemFreeSpaceGroup(basicItemInfo);
-			groupComparison = GroupFreeSpaceComparisonStub;
 			break;
 
 		case SortMode::DateDeleted:
@@ -187,47 +211,38 @@ int ShellBrowser::DetermineItemGroup(int iItemInternal)
 
 		case SortMode::OriginalLocation:
 			groupHeader = DetermineItemSummaryGroup(basicItemInfo, &SCID_ORIGINAL_LOCATION, m_config->globalFolderSettings);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::Attributes:
 			groupHeader = DetermineItemAttributeGroup(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::ShortName:
 			groupHeader = DetermineItemNameGroup(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::Owner:
 			groupHeader = DetermineItemOwnerGroup(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::ProductName:
 			groupHeader = DetermineItemVersionGroup(basicItemInfo,_T("ProductName"));
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::Company:
 			groupHeader = DetermineItemVersionGroup(basicItemInfo,_T("CompanyName"));
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::Description:
 			groupHeader = DetermineItemVersionGroup(basicItemInfo,_T("FileDescription"));
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::FileVersion:
 			groupHeader = DetermineItemVersionGroup(basicItemInfo,_T("FileVersion"));
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::ProductVersion:
 			groupHeader = DetermineItemVersionGroup(basicItemInfo,_T("ProductVersion"));
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::ShortcutTo:
@@ -238,63 +253,51 @@ int ShellBrowser::DetermineItemGroup(int iItemInternal)
 
 		case SortMode::Extension:
 			groupHeader = DetermineItemExtensionGroup(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::Created:
 			groupHeader = DetermineItemDateGroup(basicItemInfo, GroupByDateType::Created);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::Accessed:
 			groupHeader = DetermineItemDateGroup(basicItemInfo, GroupByDateType::Accessed);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::Title:
 			groupHeader = DetermineItemSummaryGroup(basicItemInfo,&PKEY_Title, m_config->globalFolderSettings);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::Subject:
 			groupHeader = DetermineItemSummaryGroup(basicItemInfo,&PKEY_Subject, m_config->globalFolderSettings);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::Authors:
 			groupHeader = DetermineItemSummaryGroup(basicItemInfo,&PKEY_Author, m_config->globalFolderSettings);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::Keywords:
 			groupHeader = DetermineItemSummaryGroup(basicItemInfo,&PKEY_Keywords, m_config->globalFolderSettings);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::Comments:
 			groupHeader = DetermineItemSummaryGroup(basicItemInfo,&PKEY_Comment, m_config->globalFolderSettings);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 
 		case SortMode::CameraModel:
 			groupHeader = DetermineItemCameraPropertyGroup(basicItemInfo,PropertyTagEquipModel);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::DateTaken:
 			groupHeader = DetermineItemCameraPropertyGroup(basicItemInfo,PropertyTagDateTime);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::Width:
 			groupHeader = DetermineItemCameraPropertyGroup(basicItemInfo,PropertyTagImageWidth);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::Height:
 			groupHeader = DetermineItemCameraPropertyGroup(basicItemInfo,PropertyTagImageHeight);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 
@@ -303,7 +306,6 @@ int ShellBrowser::DetermineItemGroup(int iItemInternal)
 
 		case SortMode::FileSystem:
 			groupHeader = DetermineItemFileSystemGroup(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		case SortMode::NumPrinterDocuments:
@@ -320,7 +322,6 @@ int ShellBrowser::DetermineItemGroup(int iItemInternal)
 
 		case SortMode::NetworkAdapterStatus:
 			groupHeader = DetermineItemNetworkStatus(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
 			break;
 
 		default:
@@ -328,62 +329,86 @@ int ShellBrowser::DetermineItemGroup(int iItemInternal)
 			break;
 	}
 
-	return CheckGroup(groupHeader, groupComparison);
+	return groupHeader;
 }
 
 /*
- * Checks if a group with specified id is already
- * in the listview. If not, the group is inserted
- * into its sorted position with the specified
- * header text.
+ * Adds an item to the group with the specified
+ * header and returns the group's id. If the group
+ * isn't already in the listview, it's inserted into
+ * its sorted position. The header text (which
+ * includes the number of items) isn't updated until
+ * UpdateGroupHeaders() is called.
  */
-int ShellBrowser::CheckGroup(std::wstring_view groupHeader, PFNLVGROUPCOMPARE groupComparison)
+int ShellBrowser::AddItemToGroup(std::wstring_view groupHeader)
 {
-	auto itr = std::find_if(m_GroupList.begin(), m_GroupList.end(), [groupHeader] (const TypeGroup_t &group) {
-		return group.header == groupHeader;
-	});
+	auto result = m_groupIndex.AddItem(groupHeader);
 
-	auto generateListViewHeader = [] (std::wstring_view header, int numItems) {
-		return std::wstring(header) + L" (" + std::to_wstring(numItems) + L")";
-	};
-
-	if (itr != m_GroupList.end())
+	if (!result.created)
 	{
-		itr->nItems++;
-
-		std::wstring listViewHeader = generateListViewHeader(groupHeader, itr->nItems);
-
-		LVGROUP lvGroup;
-		lvGroup.cbSize = sizeof(LVGROUP);
-		lvGroup.mask = LVGF_HEADER;
-		lvGroup.pszHeader = listViewHeader.data();
-		ListView_SetGroupInfo(m_hListView, itr->iGroupId, &lvGroup);
-
-		return itr->iGroupId;
+		return result.groupId;
 	}
 
-	int groupId = m_iGroupId++;
+	assert(static_cast<size_t>(result.groupId) == m_groupHeaderKeys.size());
+	m_groupHeaderKeys.push_back(BuildCollationKey(groupHeader));
 
-	TypeGroup_t typeGroup;
-	typeGroup.header = groupHeader;
-	typeGroup.iGroupId = groupId;
-	typeGroup.nItems = 1;
-	m_GroupList.push_back(typeGroup);
-
-	std::wstring listViewHeader = generateListViewHeader(groupHeader, typeGroup.nItems);
+	std::wstring listViewHeader(groupHeader);
 
 	LVINSERTGROUPSORTED lvigs;
 	lvigs.lvGroup.cbSize	= sizeof(LVGROUP);
 	lvigs.lvGroup.mask		= LVGF_HEADER | LVGF_GROUPID | LVGF_STATE;
 	lvigs.lvGroup.state		= LVGS_COLLAPSIBLE;
 	lvigs.lvGroup.pszHeader	= listViewHeader.data();
-	lvigs.lvGroup.iGroupId	= groupId;
+	lvigs.lvGroup.iGroupId	= result.groupId;
 	lvigs.lvGroup.stateMask	= 0;
-	lvigs.pfnGroupCompare	= groupComparison;
+	lvigs.pfnGroupCompare	= GetGroupComparison();
 	lvigs.pvData			= reinterpret_cast<void *>(this);
 	ListView_InsertGroupSorted(m_hListView,&lvigs);
 
-	return groupId;
+	return result.groupId;
+}
+
+/*
+ * Removes the specified item from the count of its
+ * group. Should be called before the item is
+ * removed from the listview.
+ */
+void ShellBrowser::RemoveItemFromGroup(int iItem)
+{
+	if (!m_folderSettings.showInGroups)
+	{
+		return;
+	}
+
+	LVITEM lvItem;
+	lvItem.mask		= LVIF_GROUPID;
+	lvItem.iItem	= iItem;
+	lvItem.iSubItem	= 0;
+	BOOL res = ListView_GetItem(m_hListView, &lvItem);
+
+	if (res && m_groupIndex.GetGroup(lvItem.iGroupId))
+	{
+		m_groupIndex.RemoveItem(lvItem.iGroupId);
+	}
+}
+
+/*
+ * Sets the header of each group whose item count
+ * has changed since the last update.
+ */
+void ShellBrowser::UpdateGroupHeaders()
+{
+	for (int groupId : m_groupIndex.TakeChangedGroups())
+	{
+		const GroupIndex::Group *group = m_groupIndex.GetGroup(groupId);
+		std::wstring listViewHeader = GroupIndex::FormatHeader(group->header, group->numItems);
+
+		LVGROUP lvGroup;
+		lvGroup.cbSize		= sizeof(LVGROUP);
+		lvGroup.mask		= LVGF_HEADER;
+		lvGroup.pszHeader	= listViewHeader.data();
+		ListView_SetGroupInfo(m_hListView, groupId, &lvGroup);
+	}
 }
 
 /*
@@ -513,112 +538,193 @@ std::wstring ShellBrowser::DetermineItemTypeGroupVirtual(const BasicItemInfo_t &
 	return shfi.szTypeName;
 }
 
-std::wstring ShellBrowser::DetermineItemDateGroup(const BasicItemInfo_t &itemInfo, GroupByDateType dateType) const
+/* Date groups are determined by comparing each timestamp
+against the start of each group. Those boundaries only
+need to be worked out (in local time) once per day,
+rather than each item's timestamp being converted to a
+local date. */
+std::vector<std::wstring> ShellBrowser::DetermineItemDateGroups(const std::vector<int> &internalIndices,
+	GroupByDateType dateType)
 {
-	using namespace boost::gregorian;
-	using namespace boost::posix_time;
+	UpdateDateBuckets();
 
-	SYSTEMTIME stFileTime;
-	BOOL ret = FALSE;
+	std::vector<uint64_t> timestamps(internalIndices.size());
+
+	for(size_t i = 0;i < internalIndices.size();i++)
+	{
+		switch(dateType)
+		{
+		case GroupByDateType::Modified:
+			timestamps[i] = m_itemStore.GetLastWriteTime(internalIndices[i]);
+			break;
+
+		case GroupByDateType::Created:
+			timestamps[i] = m_itemStore.GetCreationTime(internalIndices[i]);
+			break;
+
+		case GroupByDateType::Accessed:
+			timestamps[i] = m_itemStore.GetLastAccessTime(internalIndices[i]);
+			break;
+
+		default:
+			throw std::runtime_error("Incorrect date type");
+		}
+	}
+
+	std::vector<DateBuckets::Bucket> buckets(timestamps.size());
+	m_dateBuckets->Classify(timestamps.data(), timestamps.size(), buckets.data());
+
+	std::vector<std::wstring> groupHeaders;
+	groupHeaders.reserve(buckets.size());
+
+	for(DateBuckets::Bucket bucket : buckets)
+	{
+		groupHeaders.push_back(m_dateGroupHeaders[static_cast<size_t>(bucket)]);
+	}
+
+	return groupHeaders;
+}
+
+/* Expects the date buckets to have already been
+built (see DetermineItemDateGroups()). */
+std::wstring ShellBrowser::DetermineItemDateGroup(const BasicItemInfo_t &itemInfo, GroupByDateType dateType) const
+{
+	const FILETIME *fileTime = nullptr;
 
 	switch(dateType)
 	{
 	case GroupByDateType::Modified:
-		ret = FileTimeToLocalSystemTime(&itemInfo.wfd.ftLastWriteTime, &stFileTime);
+		fileTime = &itemInfo.wfd.ftLastWriteTime;
 		break;
 
 	case GroupByDateType::Created:
-		ret = FileTimeToLocalSystemTime(&itemInfo.wfd.ftCreationTime, &stFileTime);
+		fileTime = &itemInfo.wfd.ftCreationTime;
 		break;
 
 	case GroupByDateType::Accessed:
-		ret = FileTimeToLocalSystemTime(&itemInfo.wfd.ftLastAccessTime, &stFileTime);
+		fileTime = &itemInfo.wfd.ftLastAccessTime;
 		break;
 
 	default:
 		throw std::runtime_error("Incorrect date type");
 	}
 
-	if (!ret)
-	{
-		return ResourceHelper::LoadString(m_hResourceModule, IDS_GROUPBY_UNSPECIFIED);
-	}
+	assert(m_dateBuckets);
+
+	ULARGE_INTEGER timestamp;
+	timestamp.LowPart = fileTime->dwLowDateTime;
+	timestamp.HighPart = fileTime->dwHighDateTime;
 
-	FILETIME localFileTime;
-	ret = SystemTimeToFileTime(&stFileTime, &localFileTime);
+	return m_dateGroupHeaders[static_cast<size_t>(m_dateBuckets->Classify(timestamp.QuadPart))];
+}
 
-	if (!ret)
+boost::optional<ShellBrowser::GroupByDateType> ShellBrowser::GetGroupByDateType(SortMode sortMode)
+{
+	switch(sortMode)
 	{
-		return ResourceHelper::LoadString(m_hResourceModule, IDS_GROUPBY_UNSPECIFIED);
-	}
+	case SortMode::DateModified:
+		return GroupByDateType::Modified;
 
-	ptime filePosixTime = from_ftime<ptime>(localFileTime);
-	date fileDate = filePosixTime.date();
+	case SortMode::Created:
+		return GroupByDateType::Created;
 
-	date today = day_clock::local_day();
+	case SortMode::Accessed:
+		return GroupByDateType::Accessed;
 
-	if (fileDate > today)
-	{
-		return ResourceHelper::LoadString(m_hResourceModule, IDS_GROUPBY_DATE_FUTURE);
+	default:
+		return boost::none;
 	}
+}
 
-	if (fileDate == today)
-	{
-		return ResourceHelper::LoadString(m_hResourceModule, IDS_GROUPBY_DATE_TODAY);
-	}
+/* Builds the date buckets for the current day, if
+they haven't already been built, and sets a timer for
+the end of the day, so that the items can then be
+regrouped. */
+void ShellBrowser::UpdateDateBuckets()
+{
+	FILETIME currentTime;
+	GetSystemTimeAsFileTime(&currentTime);
 
-	date yesterday = today - days(1);
+	ULARGE_INTEGER now;
+	now.LowPart = currentTime.dwLowDateTime;
+	now.HighPart = currentTime.dwHighDateTime;
 
-	if (fileDate == yesterday)
+	if (!m_dateBuckets || m_dateBuckets->IsExpired(now.QuadPart))
 	{
-		return ResourceHelper::LoadString(m_hResourceModule, IDS_GROUPBY_DATE_YESTERDAY);
+		BuildDateBuckets();
 	}
 
-	// Note that this assumes that Sunday is the first day of the week.
-	unsigned short currentWeekday = today.day_of_week().as_number();
-	date startOfWeek = today - days(currentWeekday);
+	/* FILETIME intervals are 100 nanoseconds long. */
+	uint64_t millisecondsUntilExpiry = (m_dateBuckets->GetExpiryTime() - now.QuadPart) / 10000;
 
-	if (fileDate >= startOfWeek)
-	{
-		return ResourceHelper::LoadString(m_hResourceModule, IDS_GROUPBY_DATE_THIS_WEEK);
-	}
+	SetTimer(m_hListView, DATE_GROUPS_TIMER_ID,
+		static_cast<UINT>((std::min)(millisecondsUntilExpiry + 1, static_cast<uint64_t>(USER_TIMER_MAXIMUM))),
+		nullptr);
+}
 
-	date startOfLastWeek = startOfWeek - weeks(1);
+void ShellBrowser::BuildDateBuckets()
+{
+	SYSTEMTIME localTime;
+	GetLocalTime(&localTime);
 
-	if (fileDate >= startOfLastWeek)
-	{
-		return ResourceHelper::LoadString(m_hResourceModule, IDS_GROUPBY_DATE_LAST_WEEK);
-	}
+	DateBuckets::Date today = { localTime.wYear, localTime.wMonth, localTime.wDay };
 
-	date startOfMonth = date(today.year(), today.month(), 1);
+	m_dateBuckets.emplace(today, [] (const DateBuckets::Date &date) {
+		SYSTEMTIME dayStart = {};
+		dayStart.wYear = static_cast<WORD>(date.year);
+		dayStart.wMonth = static_cast<WORD>(date.month);
+		dayStart.wDay = static_cast<WORD>(date.day);
 
-	if (fileDate >= startOfMonth)
-	{
-		return ResourceHelper::LoadString(m_hResourceModule, IDS_GROUPBY_DATE_THIS_MONTH);
-	}
+		FILETIME fileTime;
 
-	date startOfLastMonth = startOfMonth - months(1);
+		if (!LocalSystemTimeToFileTime(&dayStart, &fileTime))
+		{
+			return uint64_t{ 0 };
+		}
 
-	if (fileDate >= startOfLastMonth)
-	{
-		return ResourceHelper::LoadString(m_hResourceModule, IDS_GROUPBY_DATE_LAST_MONTH);
-	}
+		ULARGE_INTEGER timestamp;
+		timestamp.LowPart = fileTime.dwLowDateTime;
+		timestamp.HighPart = fileTime.dwHighDateTime;
+		return timestamp.QuadPart;
+	});
+
+	static const UINT BUCKET_STRING_IDS[] = {
+		IDS_GROUPBY_DATE_FUTURE,
+		IDS_GROUPBY_DATE_TODAY,
+		IDS_GROUPBY_DATE_YESTERDAY,
+		IDS_GROUPBY_DATE_THIS_WEEK,
+		IDS_GROUPBY_DATE_LAST_WEEK,
+		IDS_GROUPBY_DATE_THIS_MONTH,
+		IDS_GROUPBY_DATE_LAST_MONTH,
+		IDS_GROUPBY_DATE_THIS_YEAR,
+		IDS_GROUPBY_DATE_LAST_YEAR,
+		IDS_GROUPBY_DATE_LONG_AGO,
+		IDS_GROUPBY_UNSPECIFIED
+	};
 
-	date startOfYear = date(today.year(), 1, 1);
+	static_assert(std::size(BUCKET_STRING_IDS) == DateBuckets::NUM_BUCKETS);
 
-	if (fileDate >= startOfYear)
+	for (size_t i = 0; i < DateBuckets::NUM_BUCKETS; i++)
 	{
-		return ResourceHelper::LoadString(m_hResourceModule, IDS_GROUPBY_DATE_THIS_YEAR);
+		m_dateGroupHeaders[i] = ResourceHelper::LoadString(m_hResourceModule, BUCKET_STRING_IDS[i]);
 	}
+}
 
-	date startOfLastYear = startOfYear - years(1);
+void ShellBrowser::OnDateGroupsTimer()
+{
+	KillTimer(m_hListView, DATE_GROUPS_TIMER_ID);
 
-	if (fileDate >= startOfLastYear)
+	if (!m_folderSettings.showInGroups || !GetGroupByDateType(m_folderSettings.sortMode))
 	{
-		return ResourceHelper::LoadString(m_hResourceModule, IDS_GROUPBY_DATE_LAST_YEAR);
+		m_dateBuckets.reset();
+		return;
 	}
 
-	return ResourceHelper::LoadString(m_hResourceModule, IDS_GROUPBY_DATE_LONG_AGO);
+	/* The items are simply regrouped. Their timestamps are
+	already stored, so nothing needs to be re-read. If the
+	timer fired slightly early, the buckets won't be rebuilt
+	yet, but the timer will be set again. */
+	MoveItemsIntoGroups();
 }
 
 std::wstring ShellBrowser::DetermineItemSummaryGroup(const BasicItemInfo_t &itemInfo,
@@ -867,34 +973,38 @@ void ShellBrowser::InsertItemIntoGroup(int iItem,int iGroupId)
 	ListView_SetItem(m_hListView,&Item);
 }
 
+/* The group headers for every item are determined up
+front (in parallel), after which assigning each item to
+its group is just a hash lookup. Each group's header is
+then set once, with its final item count. */
 void ShellBrowser::MoveItemsIntoGroups(void)
 {
-	LVITEM Item;
-	int nItems;
-	int iGroupId;
-	int i = 0;
-
 	ListView_RemoveAllGroups(m_hListView);
 	ListView_EnableGroupView(m_hListView,TRUE);
 
-	nItems = ListView_GetItemCount(m_hListView);
+	int nItems = ListView_GetItemCount(m_hListView);
 
 	SendMessage(m_hListView,WM_SETREDRAW,(WPARAM)FALSE,(LPARAM)NULL);
 
-	m_GroupList.clear();
-	m_iGroupId = 0;
+	m_groupIndex.Clear();
+	m_groupHeaderKeys.clear();
+
+	std::vector<int> internalIndices(nItems);
 
-	for(i = 0;i < nItems ;i++)
+	for(int i = 0;i < nItems;i++)
 	{
-		Item.mask		= LVIF_PARAM;
-		Item.iItem		= i;
-		Item.iSubItem	= 0;
-		ListView_GetItem(m_hListView,&Item);
+		internalIndices[i] = GetItemInternalIndex(i);
+	}
 
-		iGroupId = DetermineItemGroup((int)Item.lParam);
+	std::vector<std::wstring> groupHeaders = DetermineItemGroups(internalIndices);
 
+	for(int i = 0;i < nItems;i++)
+	{
+		int iGroupId = AddItemToGroup(groupHeaders[i]);
 		InsertItemIntoGroup(i,iGroupId);
 	}
 
+	UpdateGroupHeaders();
+
 	SendMessage(m_hListView,WM_SETREDRAW,(WPARAM)TRUE,(LPARAM)NULL);
 }
\ No newline at end of file
@@ -4,23 +4,23 @@
 
 #include "stdafx.h"
 #include "ShellBrowser.h"
+#include "Config.h"
 #include "ViewModes.h"
 #include "../Helper/Controls.h"
 #include "../Helper/FileOperations.h"
-#include "../Helper/FolderSize.h"
 #include "../Helper/Helper.h"
+#include "../Helper/Logging.h"
+#include "../Helper/PixelKernels.h"
 #include "../Helper/ShellHelper.h"
+#include "../Helper/ThumbnailCache.h"
 #include <boost/scope_exit.hpp>
 #include <list>
+#include <vector>
 
 #pragma warning(disable:4459) // declaration of 'boost_scope_exit_aux_args' hides global declaration
 
-#define THUMBNAIL_TYPE_ICON			0
-#define THUMBNAIL_TYPE_EXTRACTED	1
-
 void ShellBrowser::SetupThumbnailsView(void)
 {
-	HIMAGELIST himl;
 	LVITEM lvItem;
 	int nItems;
 	int i = 0;
@@ -40,11 +40,10 @@ void ShellBrowser::SetupThumbnailsView(void)
 
 	ListView_SetExtendedListViewStyleEx(m_hListView,LVS_EX_BORDERSELECT,LVS_EX_BORDERSELECT);
 
-	ListView_SetIconSpacing(m_hListView,THUMBNAIL_ITEM_HORIZONTAL_SPACING + THUMBNAIL_ITEM_WIDTH,
-		THUMBNAIL_ITEM_VERTICAL_SPACING + THUMBNAIL_ITEM_HEIGHT);
-
-	himl = ImageList_Create(THUMBNAIL_ITEM_WIDTH,THUMBNAIL_ITEM_HEIGHT,ILC_COLOR32,nItems,nItems + 100);
-	ListView_SetImageList(m_hListView,himl,LVSIL_NORMAL);
+	/* The image list set above is the system image list,
+	which mustn't be destroyed. */
+	ListView_SetImageList(m_hListView,nullptr,LVSIL_NORMAL);
+	CreateThumbnailImageList();
 
 	for(i = 0;i < nItems;i++)
 	{
@@ -56,6 +55,77 @@ void ShellBrowser::SetupThumbnailsView(void)
 	}
 
 	m_bThumbnailsSetup = TRUE;
+
+	RefreshThumbnailItems();
+}
+
+/* Replaces the thumbnails image list with an empty one,
+sized according to the current thumbnail size and memory
+budget settings. Any images in the previous list (including
+the icon images) are discarded. */
+void ShellBrowser::CreateThumbnailImageList()
+{
+	m_thumbnailSize = m_config->globalFolderSettings.thumbnailSize;
+
+	ListView_SetIconSpacing(m_hListView,THUMBNAIL_ITEM_HORIZONTAL_SPACING + m_thumbnailSize,
+		THUMBNAIL_ITEM_VERTICAL_SPACING + m_thumbnailSize);
+
+	ResetThumbnailResidency();
+
+	/* The image list never holds more thumbnails than can be
+	resident at once, so there's no point reserving space for
+	every item. */
+	int nItems = ListView_GetItemCount(m_hListView);
+	int initialSize = static_cast<int>((std::min)(static_cast<size_t>(nItems), m_thumbnailResidency.GetMaxResidentItems()));
+	HIMAGELIST himl = ImageList_Create(m_thumbnailSize,m_thumbnailSize,ILC_COLOR32,initialSize,100);
+	HIMAGELIST himlOld = ListView_SetImageList(m_hListView,himl,LVSIL_NORMAL);
+
+	if (himlOld)
+	{
+		ImageList_Destroy(himlOld);
+	}
+
+	m_iconThumbnailImages.clear();
+}
+
+size_t ShellBrowser::GetMaxResidentThumbnails(const Config *config)
+{
+	size_t memoryBudget = static_cast<size_t>(config->globalFolderSettings.thumbnailMemoryBudget) * 1024 * 1024;
+	return ThumbnailResidency::GetMaxResidentItems(memoryBudget, config->globalFolderSettings.thumbnailSize);
+}
+
+/* Called whenever the thumbnails image list is destroyed, since
+the residency slots refer to images within it. */
+void ShellBrowser::ResetThumbnailResidency()
+{
+	auto statistics = m_thumbnailResidency.GetStatistics();
+
+	LOG(debug) << _T("ShellBrowser - Thumbnail residency: ") << m_thumbnailResidency.GetNumSlots()
+		<< _T(" slots (maximum ") << m_thumbnailResidency.GetMaxResidentItems() << _T("), ")
+		<< statistics.numAllocated << _T(" allocated, ") << statistics.numRecycled << _T(" recycled, ")
+		<< statistics.numEvicted << _T(" evicted, ") << statistics.numRefetched << _T(" refetched, ")
+		<< statistics.numRejected << _T(" rejected, peak ") << statistics.peakResidentItems;
+
+	m_thumbnailResidency.Reset(GetMaxResidentThumbnails(m_config));
+	m_thumbnailSlotImages.clear();
+
+	m_thumbnailScheduler.SetMaxStartDistance(m_thumbnailResidency.GetWorkingSetDistance());
+}
+
+/* Shows the item's icon in place of its thumbnail and makes
+it pending again, so that the thumbnail is retrieved (most
+likely from the thumbnail cache) if the item comes back into
+view. */
+void ShellBrowser::EvictThumbnail(int internalIndex)
+{
+	auto index = LocateItemByInternalIndex(internalIndex);
+
+	if (index)
+	{
+		SetItemImage(*index, I_IMAGECALLBACK);
+	}
+
+	m_thumbnailScheduler.RestartItem(internalIndex);
 }
 
 void ShellBrowser::RemoveThumbnailsView(void)
@@ -73,8 +143,11 @@ void ShellBrowser::RemoveThumbnailsView(void)
 
 	nItems = ListView_GetItemCount(m_hListView);
 
-	m_thumbnailThreadPool.clear_queue();
-	m_thumbnailResults.clear();
+	m_thumbnailTasks.Cancel();
+	m_thumbnailTasksInFlight.clear();
+	m_thumbnailScheduler.Reset();
+	m_iconThumbnailImages.clear();
+	ResetThumbnailResidency();
 
 	for(i = 0;i < nItems;i++)
 	{
@@ -93,30 +166,212 @@ void ShellBrowser::RemoveThumbnailsView(void)
 	m_bThumbnailsSetup = FALSE;
 }
 
-void ShellBrowser::QueueThumbnailTask(int internalIndex)
+ThumbnailScheduler::Options ShellBrowser::GetThumbnailSchedulerOptions()
 {
-	int thumbnailResultID = m_thumbnailResultIDCounter++;
+	ThumbnailScheduler::Options options;
+	options.maxItemsInFlight = TaskExecutor::GetShared().GetNumThreads() * THUMBNAIL_TASKS_PER_THREAD;
+	return options;
+}
+
+/* Passes the current set of items (in display order) to
+the thumbnail scheduler. This needs to be called whenever
+items are added or their order changes. */
+void ShellBrowser::RefreshThumbnailItems()
+{
+	int nItems = ListView_GetItemCount(m_hListView);
+
+	std::vector<int> internalIndices(nItems);
+
+	for(int i = 0;i < nItems;i++)
+	{
+		internalIndices[i] = GetItemInternalIndex(i);
+	}
+
+	m_thumbnailScheduler.SetItems(internalIndices);
+
+	/* Items that are no longer shown don't need their slots
+	(and their images will simply be replaced). */
+	m_thumbnailResidency.SetItems(internalIndices);
+}
+
+/* Determines which items are visible and passes that on to
+the thumbnail scheduler. In thumbnails view, items are
+arranged in rows, in display order, so the visible range can
+be calculated from the scroll position, without having to
+query each item. When items are shown in groups, the range
+is only approximate (since group headers take up space). */
+void ShellBrowser::UpdateThumbnailViewport()
+{
+	int nItems = ListView_GetItemCount(m_hListView);
+	DWORD itemSpacing = ListView_GetItemSpacing(m_hListView, FALSE);
+	int itemWidth = LOWORD(itemSpacing);
+	int itemHeight = HIWORD(itemSpacing);
+
+	if (nItems == 0 || itemWidth == 0 || itemHeight == 0)
+	{
+		return;
+	}
+
+	RECT clientRect;
+	GetClientRect(m_hListView, &clientRect);
+
+	POINT origin;
+	ListView_GetOrigin(m_hListView, &origin);
+
+	int numColumns = (std::max)(static_cast<int>(clientRect.right / itemWidth), 1);
+	int firstRow = (std::max)(static_cast<int>(origin.y / itemHeight), 0);
+	int lastRow = (std::max)(static_cast<int>((origin.y + clientRect.bottom - 1) / itemHeight), firstRow);
+
+	int first = (std::min)(firstRow * numColumns, nItems - 1);
+	int last = (std::min)((lastRow + 1) * numColumns - 1, nItems - 1);
+
+	auto cancelledItems = m_thumbnailScheduler.SetViewport(first, last);
 
-	BasicItemInfo_t basicItemInfo = getBasicItemInfo(internalIndex);
+	for (int internalIndex : m_thumbnailResidency.SetViewport(first, last))
+	{
+		EvictThumbnail(internalIndex);
+	}
+
+	m_thumbnailScheduler.SetMaxStartDistance(m_thumbnailResidency.GetWorkingSetDistance());
 
-	auto result = m_thumbnailThreadPool.push([this, thumbnailResultID, internalIndex, basicItemInfo](int id) {
-		UNREFERENCED_PARAMETER(id);
+	for (int internalIndex : cancelledItems)
+	{
+		for (auto &task : m_thumbnailTasksInFlight)
+		{
+			if (task.second.itemInternalIndex == internalIndex)
+			{
+				task.second.cancelled->store(true);
+			}
+		}
+	}
 
-		return FindThumbnailAsync(m_hListView, thumbnailResultID, internalIndex, basicItemInfo);
+	QueueThumbnailTasks();
+}
+
+/* Queues tasks for the items the scheduler picks, until the
+limit on the number of tasks in flight is reached. */
+void ShellBrowser::QueueThumbnailTasks()
+{
+	while (auto next = m_thumbnailScheduler.StartNextItem())
+	{
+		QueueThumbnailTask(next->item, next->priority);
+	}
+}
+
+void ShellBrowser::QueueThumbnailTask(int internalIndex, TaskPriority priority)
+{
+	int thumbnailResultID = m_thumbnailResultIDCounter++;
+
+	auto basicItemInfo = GetItemSnapshot(internalIndex);
+	ThumbnailCache *thumbnailCache = CanCacheThumbnail(*basicItemInfo) ? m_thumbnailCache : nullptr;
+	int thumbnailSize = m_thumbnailSize;
+	auto cancelled = std::make_shared<std::atomic<bool>>(false);
+
+	/* A result is always pushed (even if no thumbnail was
+	found), so that the scheduler knows the item is no
+	longer in flight. */
+	m_thumbnailTasks.Push(priority, [this, thumbnailResultID, internalIndex, basicItemInfo, thumbnailCache,
+		thumbnailSize, cancelled] {
+		ThumbnailResult_t result;
+		result.thumbnailResultId = thumbnailResultID;
+		result.itemInternalIndex = internalIndex;
+		result.thumbnailSize = thumbnailSize;
+		result.pixels = FindThumbnailAsync(*basicItemInfo, thumbnailCache, thumbnailSize, *cancelled);
+
+		m_thumbnailResults.Push(std::move(result));
+
+		if (!m_thumbnailResultsPending.exchange(true))
+		{
+			PostMessage(m_hListView, WM_APP_THUMBNAIL_RESULTS_READY, 0, 0);
+		}
 	});
 
-	m_thumbnailResults.insert({ thumbnailResultID, std::move(result) });
+	ThumbnailTask_t task;
+	task.itemInternalIndex = internalIndex;
+	task.cancelled = cancelled;
+	m_thumbnailTasksInFlight.insert({ thumbnailResultID, std::move(task) });
 }
 
-boost::optional<ShellBrowser::ThumbnailResult_t> ShellBrowser::FindThumbnailAsync(HWND listView,
-	int thumbnailResultId, int internalIndex, const BasicItemInfo_t &basicItemInfo)
+/* Items in virtual folders don't necessarily have a size
+or modification time that can be used to detect changes.
+The same is true of folders, since their thumbnails are
+based on their contents. */
+bool ShellBrowser::CanCacheThumbnail(const BasicItemInfo_t &basicItemInfo) const
+{
+	return m_thumbnailCache && !m_bVirtualFolder
+		&& WI_IsFlagClear(basicItemInfo.wfd.dwFileAttributes, FILE_ATTRIBUTE_DIRECTORY);
+}
+
+/* Retrieves the thumbnail from the thumbnail cache if it's
+there, otherwise extracts and composites it (and then adds
+it to the cache). The cache is only used if a cache is
+passed in. Extraction can't be interrupted, so cancellation
+is only checked before it starts. Returns an empty buffer if
+no thumbnail was found.
+
+The cache may return a larger level than the one requested
+(e.g. after the thumbnail size has been reduced). That
+image is scaled down with the sharper filter, since a box
+filter would visibly soften it. */
+std::vector<uint32_t> ShellBrowser::FindThumbnailAsync(const BasicItemInfo_t &basicItemInfo,
+	ThumbnailCache *thumbnailCache, int thumbnailSize, const std::atomic<bool> &cancelled)
+{
+	if (cancelled)
+	{
+		return {};
+	}
+
+	boost::optional<ThumbnailCacheKey> cacheKey;
+
+	if (thumbnailCache)
+	{
+		cacheKey = GetThumbnailCacheKey(basicItemInfo);
+	}
+
+	CachedThumbnail thumbnail;
+	bool found = cacheKey && thumbnailCache->Find(*cacheKey, thumbnailSize, thumbnail);
+	auto filter = PixelKernels::ResampleFilter::Lanczos3;
+
+	if (!found)
+	{
+		if (cancelled)
+		{
+			return {};
+		}
+
+		wil::unique_hbitmap thumbnailBitmap = ExtractThumbnail(basicItemInfo, thumbnailSize);
+
+		if (!thumbnailBitmap || !CompositeThumbnail(thumbnailBitmap.get(), thumbnailSize, thumbnail))
+		{
+			return {};
+		}
+
+		if (cacheKey)
+		{
+			thumbnailCache->Insert(*cacheKey, thumbnail);
+		}
+
+		/* The image already fits, so it's only being
+		centered. */
+		filter = PixelKernels::ResampleFilter::Box;
+	}
+
+	std::vector<uint32_t> pixels(static_cast<size_t>(thumbnailSize) * thumbnailSize);
+	PixelKernels::Letterbox({ thumbnail.pixels.data(), static_cast<int>(thumbnail.width),
+		static_cast<int>(thumbnail.height), static_cast<int>(thumbnail.width) },
+		{ pixels.data(), thumbnailSize, thumbnailSize, thumbnailSize }, 0, filter);
+
+	return pixels;
+}
+
+wil::unique_hbitmap ShellBrowser::ExtractThumbnail(const BasicItemInfo_t &basicItemInfo, int thumbnailSize)
 {
 	IShellFolder *pShellFolder = nullptr;
 	HRESULT hr = SHBindToParent(basicItemInfo.pidlComplete.get(), IID_PPV_ARGS(&pShellFolder), nullptr);
 
 	if (FAILED(hr))
 	{
-		return boost::none;
+		return nullptr;
 	}
 
 	BOOST_SCOPE_EXIT(pShellFolder) {
@@ -129,7 +384,7 @@ boost::optional<ShellBrowser::ThumbnailResult_t> ShellBrowser::FindThumbnailAsyn
 
 	if (FAILED(hr))
 	{
-		return boost::none;
+		return nullptr;
 	}
 
 	BOOST_SCOPE_EXIT(pExtractImage) {
@@ -137,8 +392,8 @@ boost::optional<ShellBrowser::ThumbnailResult_t> ShellBrowser::FindThumbnailAsyn
 	} BOOST_SCOPE_EXIT_END
 
 	SIZE size;
-	size.cx = THUMBNAIL_ITEM_WIDTH;
-	size.cy = THUMBNAIL_ITEM_HEIGHT;
+	size.cx = thumbnailSize;
+	size.cy = thumbnailSize;
 
 	DWORD dwFlags = IEIFLAG_OFFLINE | IEIFLAG_QUALITY;
 
@@ -150,7 +405,7 @@ boost::optional<ShellBrowser::ThumbnailResult_t> ShellBrowser::FindThumbnailAsyn
 
 	if (FAILED(hr))
 	{
-		return boost::none;
+		return nullptr;
 	}
 
 	wil::unique_hbitmap thumbnailBitmap;
@@ -158,157 +413,380 @@ boost::optional<ShellBrowser::ThumbnailResult_t> ShellBrowser::FindThumbnailAsyn
 
 	if (FAILED(hr))
 	{
-		return boost::none;
+		return nullptr;
 	}
 
-	PostMessage(listView, WM_APP_THUMBNAIL_RESULT_READY, thumbnailResultId, 0);
-
-	ThumbnailResult_t result;
-	result.itemInternalIndex = internalIndex;
-	result.bitmap = std::move(thumbnailBitmap);
-
-	return result;
+	return thumbnailBitmap;
 }
 
-void ShellBrowser::ProcessThumbnailResult(int thumbnailResultId)
+boost::optional<ThumbnailCacheKey> ShellBrowser::GetThumbnailCacheKey(const BasicItemInfo_t &basicItemInfo)
 {
-	auto itr = m_thumbnailResults.find(thumbnailResultId);
+	TCHAR path[MAX_PATH];
+	HRESULT hr = GetDisplayName(basicItemInfo.pidlComplete.get(), path, SIZEOF_ARRAY(path), SHGDN_FORPARSING);
 
-	if (itr == m_thumbnailResults.end())
+	if (FAILED(hr))
 	{
-		return;
+		return boost::none;
 	}
 
-	if (m_folderSettings.viewMode != +ViewMode::Thumbnails)
+	ULARGE_INTEGER fileSize = { basicItemInfo.wfd.nFileSizeLow, basicItemInfo.wfd.nFileSizeHigh };
+	ULARGE_INTEGER lastWriteTime = { basicItemInfo.wfd.ftLastWriteTime.dwLowDateTime,
+		basicItemInfo.wfd.ftLastWriteTime.dwHighDateTime };
+
+	ThumbnailCacheKey cacheKey;
+	cacheKey.path = path;
+	cacheKey.fileSize = fileSize.QuadPart;
+	cacheKey.lastWriteTime = lastWriteTime.QuadPart;
+
+	return cacheKey;
+}
+
+/* Creates a top-down 32-bit DIB section, holding the
+specified number of thumbnail items side by side. The pixels
+can be written directly, with no padding between rows. */
+wil::unique_hbitmap ShellBrowser::CreateThumbnailBitmap(int thumbnailSize, int numThumbnails, uint32_t **pixels)
+{
+	BITMAPINFO bitmapInfo = {};
+	bitmapInfo.bmiHeader.biSize = sizeof(bitmapInfo.bmiHeader);
+	bitmapInfo.bmiHeader.biWidth = thumbnailSize * numThumbnails;
+	bitmapInfo.bmiHeader.biHeight = -thumbnailSize;
+	bitmapInfo.bmiHeader.biPlanes = 1;
+	bitmapInfo.bmiHeader.biBitCount = 32;
+	bitmapInfo.bmiHeader.biCompression = BI_RGB;
+
+	void *bits = nullptr;
+	wil::unique_hbitmap bitmap(CreateDIBSection(nullptr, &bitmapInfo, DIB_RGB_COLORS, &bits, nullptr, 0));
+
+	if (!bitmap)
 	{
-		return;
+		return nullptr;
 	}
 
-	auto result = itr->second.get();
+	*pixels = static_cast<uint32_t *>(bits);
+
+	return bitmap;
+}
 
-	if (!result)
+/* Scales the extracted thumbnail down to fit within a
+square of the specified size (if it's too large), keeping
+its aspect ratio. Nothing is drawn around the image; it's
+centered when it's letterboxed into a thumbnail item, where
+the area around it is left transparent, so that the
+listview background shows through. That means the result
+doesn't depend on the listview's background color, so it
+can be cached. */
+bool ShellBrowser::CompositeThumbnail(HBITMAP thumbnailBitmap, int thumbnailSize, CachedThumbnail &thumbnail)
+{
+	BITMAP bm;
+
+	if (GetObject(thumbnailBitmap, sizeof(bm), &bm) == 0 || bm.bmWidth <= 0 || bm.bmHeight <= 0)
 	{
-		// Thumbnail lookup failed.
-		return;
+		return false;
 	}
 
-	int imageIndex = GetExtractedThumbnail(result->bitmap.get());
+	BITMAPINFO bitmapInfo = {};
+	bitmapInfo.bmiHeader.biSize = sizeof(bitmapInfo.bmiHeader);
+	bitmapInfo.bmiHeader.biWidth = bm.bmWidth;
+	bitmapInfo.bmiHeader.biHeight = -bm.bmHeight;
+	bitmapInfo.bmiHeader.biPlanes = 1;
+	bitmapInfo.bmiHeader.biBitCount = 32;
+	bitmapInfo.bmiHeader.biCompression = BI_RGB;
+
+	std::vector<uint32_t> thumbnailPixels(static_cast<size_t>(bm.bmWidth) * bm.bmHeight);
 
-	auto index = LocateItemByInternalIndex(result->itemInternalIndex);
+	wil::unique_hdc hdc(CreateCompatibleDC(nullptr));
+	int res = GetDIBits(hdc.get(), thumbnailBitmap, 0, bm.bmHeight, thumbnailPixels.data(), &bitmapInfo,
+		DIB_RGB_COLORS);
 
-	if (!index)
+	if (res == 0)
 	{
-		return;
+		return false;
 	}
 
-	LVITEM lvItem;
-	lvItem.mask = LVIF_IMAGE;
-	lvItem.iItem = *index;
-	lvItem.iSubItem = 0;
-	lvItem.iImage = imageIndex;
-	ListView_SetItem(m_hListView, &lvItem);
-}
+	PixelKernels::ImageView thumbnailImage = { thumbnailPixels.data(), bm.bmWidth, bm.bmHeight, bm.bmWidth };
 
-/* Draws a thumbnail based on an items icon. */
-int ShellBrowser::GetIconThumbnail(int iInternalIndex) const
-{
-	return GetThumbnailInternal(THUMBNAIL_TYPE_ICON,iInternalIndex,
-		NULL);
-}
+	/* Most extracted thumbnails have no alpha information at
+	all (i.e. every alpha value is zero), in which case the
+	image is treated as being opaque. */
+	auto alphaMode = PixelKernels::HasAlpha(PixelKernels::MakeConstView(thumbnailImage))
+		? PixelKernels::AlphaMode::Straight : PixelKernels::AlphaMode::Ignore;
+	PixelKernels::ConvertToPremultiplied(thumbnailImage, alphaMode);
 
-/* Draws an items extracted thumbnail. */
-int ShellBrowser::GetExtractedThumbnail(HBITMAP hThumbnailBitmap) const
-{
-	return GetThumbnailInternal(THUMBNAIL_TYPE_EXTRACTED,0,
-		hThumbnailBitmap);
+	auto rect = PixelKernels::GetLetterboxRect(bm.bmWidth, bm.bmHeight, thumbnailSize, thumbnailSize);
+
+	thumbnail.level = thumbnailSize;
+	thumbnail.width = rect.width;
+	thumbnail.height = rect.height;
+	thumbnail.pixels.resize(static_cast<size_t>(rect.width) * rect.height);
+
+	PixelKernels::Resample(PixelKernels::MakeConstView(thumbnailImage),
+		{ thumbnail.pixels.data(), rect.width, rect.height, rect.width }, PixelKernels::ResampleFilter::Box);
+
+	return true;
 }
 
-int ShellBrowser::GetThumbnailInternal(int iType,
-int iInternalIndex,HBITMAP hThumbnailBitmap) const
+void ShellBrowser::ProcessThumbnailResults()
 {
-	HDC hdc;
-	HDC hdcBacking;
-	HBITMAP hBackingBitmap;
-	HBITMAP hBackingBitmapOld;
-	HIMAGELIST himl;
-	HBRUSH hbr;
-	int iImage;
+	/* As with column results, this needs to be reset before
+	the queue is checked. */
+	m_thumbnailResultsPending = false;
 
-	hdc = GetDC(m_hListView);
-	hdcBacking = CreateCompatibleDC(hdc);
+	std::vector<ThumbnailResult_t> completedResults;
+	ThumbnailResult_t result;
 
-	/* Backing bitmap. */
-	hBackingBitmap = CreateCompatibleBitmap(hdc,THUMBNAIL_ITEM_WIDTH,THUMBNAIL_ITEM_HEIGHT);
-	hBackingBitmapOld = (HBITMAP)SelectObject(hdcBacking,hBackingBitmap);
+	while (completedResults.size() < MAX_THUMBNAIL_RESULT_BATCH_SIZE && m_thumbnailResults.TryPop(result))
+	{
+		auto itr = m_thumbnailTasksInFlight.find(result.thumbnailResultId);
+
+		/* If the task isn't found, this result is for a
+		previous folder (or view), and can be ignored. */
+		if (itr == m_thumbnailTasksInFlight.end())
+		{
+			continue;
+		}
+
+		ThumbnailTask_t task = std::move(itr->second);
+		m_thumbnailTasksInFlight.erase(itr);
+
+		/* The thumbnail size can't be changed without the
+		folder being reloaded (which clears the tasks in
+		flight), so this is only a safeguard. */
+		if (result.thumbnailSize != m_thumbnailSize)
+		{
+			m_thumbnailScheduler.CompleteItem(task.itemInternalIndex);
+			continue;
+		}
+
+		if (result.pixels.empty())
+		{
+			// Either the thumbnail lookup failed, or the task was
+			// cancelled. In the second case, the item is pending again and
+			// will be retried once it's closer to the viewport.
+			if (!*task.cancelled)
+			{
+				m_thumbnailScheduler.CompleteItem(task.itemInternalIndex);
+			}
+
+			continue;
+		}
+
+		// A task that was cancelled may still have found a thumbnail (if it
+		// was cancelled after the thumbnail was extracted). In that case,
+		// the item might have been started again, so only the first result
+		// is used.
+		if (m_thumbnailScheduler.CompleteItem(task.itemInternalIndex))
+		{
+			completedResults.push_back(std::move(result));
+		}
+	}
 
-	/* Set the background of the new bitmap to be the same color as the
-	background in the listview. */
-	hbr = CreateSolidBrush(ListView_GetBkColor(m_hListView));
-	RECT rect = {0,0,THUMBNAIL_ITEM_WIDTH,THUMBNAIL_ITEM_HEIGHT};
-	FillRect(hdcBacking,&rect,hbr);
-
-	if(iType == THUMBNAIL_TYPE_ICON)
-		DrawIconThumbnailInternal(hdcBacking,iInternalIndex);
-	else if(iType == THUMBNAIL_TYPE_EXTRACTED)
-		DrawThumbnailInternal(hdcBacking,hThumbnailBitmap);
-
-	/* Clean up...
-	Everything EXCEPT the backing bitmap should be
-	deleted here (at the very least, the backing
-	bitmap needs to be selected out of its DC). */
-	SelectObject(hdcBacking,hBackingBitmapOld);
-	DeleteDC(hdcBacking);
-	ReleaseDC(m_hListView,hdc);
-
-	/* Add the new bitmap to the imagelist. */
-	himl = ListView_GetImageList(m_hListView,LVSIL_NORMAL);
-	iImage = ImageList_Add(himl,hBackingBitmap,NULL);
+	if (!m_thumbnailResults.IsEmpty() && !m_thumbnailResultsPending.exchange(true))
+	{
+		PostMessage(m_hListView, WM_APP_THUMBNAIL_RESULTS_READY, 0, 0);
+	}
 
-	/* Now delete the backing bitmap. */
-	DeleteObject(hBackingBitmap);
+	QueueThumbnailTasks();
 
-	return iImage;
+	if (!completedResults.empty() && m_folderSettings.viewMode == +ViewMode::Thumbnails)
+	{
+		AddThumbnailsToImageList(completedResults);
+	}
 }
 
-void ShellBrowser::DrawIconThumbnailInternal(HDC hdcBacking,int iInternalIndex) const
+/* Each thumbnail is given a residency slot. Thumbnails in
+recycled slots replace the image that's already there.
+Thumbnails in new slots are copied side by side into a
+single bitmap, which is then added to the image list in one
+call (the image list splits it into individual images). */
+void ShellBrowser::AddThumbnailsToImageList(const std::vector<ThumbnailResult_t> &results)
 {
-	HICON hIcon;
-	SHFILEINFO shfi;
-	int iIconWidth;
-	int iIconHeight;
+	HIMAGELIST himl = ListView_GetImageList(m_hListView, LVSIL_NORMAL);
 
-	SHGetFileInfo((LPCTSTR)m_itemInfoMap.at(iInternalIndex).pidlComplete.get(),0,&shfi,sizeof(shfi),SHGFI_PIDL|SHGFI_SYSICONINDEX);
+	std::vector<const ThumbnailResult_t *> newImageResults;
+	std::vector<int> newImageSlots;
 
-	hIcon = ImageList_GetIcon(m_hListViewImageList,
-		shfi.iIcon,ILD_NORMAL);
+	wil::unique_hbitmap replacementBitmap;
+	uint32_t *replacementPixels = nullptr;
 
-	ImageList_GetIconSize(m_hListViewImageList,&iIconWidth,&iIconHeight);
+	for (const auto &result : results)
+	{
+		auto index = LocateItemByInternalIndex(result.itemInternalIndex);
+
+		if (!index)
+		{
+			continue;
+		}
+
+		/* If there's no slot, the item is further from the
+		viewport than every resident item, so it simply keeps
+		showing its icon. */
+		auto allocation = m_thumbnailResidency.AllocateSlot(result.itemInternalIndex);
+
+		if (!allocation)
+		{
+			continue;
+		}
+
+		if (allocation->evictedItem)
+		{
+			EvictThumbnail(*allocation->evictedItem);
+		}
+
+		if (allocation->slot >= static_cast<int>(m_thumbnailSlotImages.size())
+			|| m_thumbnailSlotImages[allocation->slot] == -1)
+		{
+			newImageResults.push_back(&result);
+			newImageSlots.push_back(allocation->slot);
+			continue;
+		}
+
+		if (!replacementBitmap)
+		{
+			replacementBitmap = CreateThumbnailBitmap(m_thumbnailSize, 1, &replacementPixels);
+
+			if (!replacementBitmap)
+			{
+				continue;
+			}
+		}
+
+		PixelKernels::Copy({ result.pixels.data(), m_thumbnailSize, m_thumbnailSize, m_thumbnailSize },
+			{ replacementPixels, m_thumbnailSize, m_thumbnailSize, m_thumbnailSize });
+
+		int imageIndex = m_thumbnailSlotImages[allocation->slot];
+		ImageList_Replace(himl, imageIndex, replacementBitmap.get(), nullptr);
+
+		SetItemImage(*index, imageIndex);
+	}
 
-	DrawIconEx(hdcBacking,(THUMBNAIL_ITEM_WIDTH - iIconWidth) / 2,
-		(THUMBNAIL_ITEM_HEIGHT - iIconHeight) / 2,hIcon,0,0,
-		NULL,NULL,DI_NORMAL);
-	DestroyIcon(hIcon);
+	if (newImageResults.empty())
+	{
+		return;
+	}
+
+	int numThumbnails = static_cast<int>(newImageResults.size());
+	int firstImageIndex = -1;
+
+	uint32_t *pixels;
+	wil::unique_hbitmap bitmap = CreateThumbnailBitmap(m_thumbnailSize, numThumbnails, &pixels);
+
+	if (bitmap)
+	{
+		PixelKernels::ImageView strip = { pixels, m_thumbnailSize * numThumbnails, m_thumbnailSize,
+			m_thumbnailSize * numThumbnails };
+
+		for (int i = 0; i < numThumbnails; i++)
+		{
+			PixelKernels::Copy({ newImageResults[i]->pixels.data(), m_thumbnailSize, m_thumbnailSize, m_thumbnailSize },
+				PixelKernels::GetSubImage(strip, { i * m_thumbnailSize, 0, m_thumbnailSize, m_thumbnailSize }));
+		}
+
+		firstImageIndex = ImageList_Add(himl, bitmap.get(), nullptr);
+	}
+
+	for (int i = 0; i < numThumbnails; i++)
+	{
+		int slot = newImageSlots[i];
+
+		if (slot >= static_cast<int>(m_thumbnailSlotImages.size()))
+		{
+			m_thumbnailSlotImages.resize(slot + 1, -1);
+		}
+
+		/* If the images couldn't be added, the slots are left
+		without an image, and the items keep showing their
+		icons. */
+		if (firstImageIndex == -1)
+		{
+			continue;
+		}
+
+		m_thumbnailSlotImages[slot] = firstImageIndex + i;
+
+		auto index = LocateItemByInternalIndex(newImageResults[i]->itemInternalIndex);
+
+		if (index)
+		{
+			SetItemImage(*index, firstImageIndex + i);
+		}
+	}
 }
 
-void ShellBrowser::DrawThumbnailInternal(HDC hdcBacking,HBITMAP hThumbnailBitmap) const
+void ShellBrowser::SetItemImage(int index, int imageIndex)
 {
-	HDC hdcThumbnail;
-	HBITMAP hThumbnailBitmapOld;
-	BITMAP bm;
+	LVITEM lvItem;
+	lvItem.mask = LVIF_IMAGE;
+	lvItem.iItem = index;
+	lvItem.iSubItem = 0;
+	lvItem.iImage = imageIndex;
+	ListView_SetItem(m_hListView, &lvItem);
+}
 
-	/* Thumbnail bitmap. */
-	hdcThumbnail = CreateCompatibleDC(hdcBacking);
-	hThumbnailBitmapOld = (HBITMAP)SelectObject(hdcThumbnail,hThumbnailBitmap);
+/* Returns an image showing the item's icon, centered within
+a thumbnail item. Items that share an icon also share the
+image, so it only has to be drawn once. */
+int ShellBrowser::GetIconThumbnail(int internalIndex)
+{
+	int iconIndex;
+	auto cachedIconIndex = GetCachedIconIndex(internalIndex);
+
+	if (cachedIconIndex)
+	{
+		/* The upper eight bits hold the overlay index. */
+		iconIndex = *cachedIconIndex & 0x00FFFFFF;
+	}
+	else
+	{
+		SHFILEINFO shfi;
+		SHGetFileInfo(reinterpret_cast<LPCTSTR>(m_itemShellInfo[internalIndex].pidlComplete.get()), 0, &shfi,
+			sizeof(shfi), SHGFI_PIDL | SHGFI_SYSICONINDEX);
+		iconIndex = shfi.iIcon;
+	}
+
+	auto itr = m_iconThumbnailImages.find(iconIndex);
+
+	if (itr != m_iconThumbnailImages.end())
+	{
+		return itr->second;
+	}
+
+	int imageIndex = DrawIconThumbnail(iconIndex);
 
-	GetObject(hThumbnailBitmap,sizeof(BITMAP),&bm);
+	if (imageIndex != -1)
+	{
+		m_iconThumbnailImages.insert({ iconIndex, imageIndex });
+	}
+
+	return imageIndex;
+}
 
-	/* Now, draw the thumbnail bitmap (in its centered position)
-	directly on top of the new bitmap. */
-	BitBlt(hdcBacking,(THUMBNAIL_ITEM_WIDTH - bm.bmWidth) / 2,
-		(THUMBNAIL_ITEM_HEIGHT - bm.bmHeight) / 2,
-		THUMBNAIL_ITEM_WIDTH,THUMBNAIL_ITEM_HEIGHT,
-		hdcThumbnail,0,0,SRCCOPY);
+int ShellBrowser::DrawIconThumbnail(int iconIndex)
+{
+	uint32_t *pixels;
+	wil::unique_hbitmap bitmap = CreateThumbnailBitmap(m_thumbnailSize, 1, &pixels);
 
-	SelectObject(hdcThumbnail,hThumbnailBitmapOld);
-	DeleteDC(hdcThumbnail);
-}
\ No newline at end of file
+	if (!bitmap)
+	{
+		return -1;
+	}
+
+	/* Set the background of the new bitmap to be the same color as the
+	background in the listview. */
+	COLORREF backgroundColor = ListView_GetBkColor(m_hListView);
+	PixelKernels::Fill({ pixels, m_thumbnailSize, m_thumbnailSize, m_thumbnailSize },
+		0xFF000000 | (GetRValue(backgroundColor) << 16) | (GetGValue(backgroundColor) << 8)
+		| GetBValue(backgroundColor));
+
+	int iconWidth;
+	int iconHeight;
+	ImageList_GetIconSize(m_hListViewImageList, &iconWidth, &iconHeight);
+
+	wil::unique_hdc hdc(CreateCompatibleDC(nullptr));
+	auto previousBitmap = wil::SelectObject(hdc.get(), bitmap.get());
+	ImageList_Draw(m_hListViewImageList, iconIndex, hdc.get(), (m_thumbnailSize - iconWidth) / 2,
+		(m_thumbnailSize - iconHeight) / 2, ILD_NORMAL);
+	previousBitmap.reset();
+
+	HIMAGELIST himl = ListView_GetImageList(m_hListView, LVSIL_NORMAL);
+	return ImageList_Add(himl, bitmap.get(), nullptr);
+}
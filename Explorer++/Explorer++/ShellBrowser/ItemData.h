@@ -13,9 +13,9 @@ struct BasicItemInfo_t
 	BasicItemInfo_t() = default;
 	BasicItemInfo_t(BasicItemInfo_t &&) = default;
 
-	// Being able to explicitly copy this structure is important. The
-	// structure can be passed to a background thread and that thread
-	// needs to be able to hold its own copy of the data. A shallow copy
+	// Background tasks normally share an immutable snapshot of this
+	// structure (see ShellBrowser::GetItemSnapshot), rather than copying
+	// it. When a copy is needed, it has to be a deep copy. A shallow copy
 	// wouldn't work, as the copies would share the same underlying
 	// PIDLs.
 	BasicItemInfo_t(const BasicItemInfo_t &other)
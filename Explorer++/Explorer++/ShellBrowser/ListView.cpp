@@ -53,6 +53,16 @@ LRESULT CALLBACK ShellBrowser::ListViewProcStub(HWND hwnd, UINT uMsg, WPARAM wPa
 
 LRESULT CALLBACK ShellBrowser::ListViewProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
+	if (m_virtualList)
+	{
+		auto res = HandleVirtualListViewMessage(hwnd, uMsg, wParam, lParam);
+
+		if (res)
+		{
+			return *res;
+		}
+	}
+
 	switch (uMsg)
 	{
 	case WM_MBUTTONDOWN:
@@ -71,17 +81,33 @@ LRESULT CALLBACK ShellBrowser::ListViewProc(HWND hwnd, UINT uMsg, WPARAM wParam,
 	}
 	break;
 
-	case WM_APP_COLUMN_RESULT_READY:
-		ProcessColumnResult(static_cast<int>(wParam));
+	case WM_APP_COLUMN_RESULTS_READY:
+		ProcessColumnResults();
 		break;
 
-	case WM_APP_THUMBNAIL_RESULT_READY:
-		ProcessThumbnailResult(static_cast<int>(wParam));
+	case WM_APP_THUMBNAIL_RESULTS_READY:
+		ProcessThumbnailResults();
 		break;
 
 	case WM_APP_INFO_TIP_READY:
 		ProcessInfoTipResult(static_cast<int>(wParam));
 		break;
+
+	case WM_APP_ENUMERATION_BATCH_READY:
+		ProcessEnumerationBatches();
+		break;
+
+	case WM_APP_REVALIDATION_READY:
+		ProcessRevalidationResult(static_cast<int>(wParam));
+		break;
+
+	case WM_TIMER:
+		if (wParam == DATE_GROUPS_TIMER_ID)
+		{
+			OnDateGroupsTimer();
+			return 0;
+		}
+		break;
 	}
 
 	return DefSubclassProc(hwnd, uMsg, wParam, lParam);
@@ -105,7 +131,26 @@ LRESULT CALLBACK ShellBrowser::ListViewParentProc(HWND hwnd, UINT uMsg, WPARAM w
 			switch (reinterpret_cast<LPNMHDR>(lParam)->code)
 			{
 			case LVN_GETDISPINFO:
-				OnListViewGetDisplayInfo(lParam);
+				if (m_virtualList)
+				{
+					OnVirtualListViewGetDisplayInfo(reinterpret_cast<NMLVDISPINFO *>(lParam));
+				}
+				else
+				{
+					OnListViewGetDisplayInfo(lParam);
+				}
+				break;
+
+			case LVN_ODCACHEHINT:
+				OnVirtualListViewCacheHint(reinterpret_cast<NMLVCACHEHINT *>(lParam));
+				break;
+
+			case LVN_ODSTATECHANGED:
+				OnVirtualListViewStateChanged(reinterpret_cast<NMLVODSTATECHANGE *>(lParam));
+				break;
+
+			case LVN_ODFINDITEM:
+				return OnVirtualListViewFindItem(reinterpret_cast<NMLVFINDITEM *>(lParam));
 				break;
 
 			case LVN_GETINFOTIP:
@@ -113,13 +158,27 @@ LRESULT CALLBACK ShellBrowser::ListViewParentProc(HWND hwnd, UINT uMsg, WPARAM w
 				break;
 
 			case LVN_ITEMCHANGED:
-				OnListViewItemChanged(reinterpret_cast<NMLISTVIEW *>(lParam));
+				if (m_virtualList)
+				{
+					OnVirtualListViewItemChanged(reinterpret_cast<NMLISTVIEW *>(lParam));
+				}
+				else
+				{
+					OnListViewItemChanged(reinterpret_cast<NMLISTVIEW *>(lParam));
+				}
 				break;
 
 			case LVN_KEYDOWN:
 				OnListViewKeyDown(reinterpret_cast<NMLVKEYDOWN *>(lParam));
 				break;
 
+			case LVN_ENDSCROLL:
+				if (m_folderSettings.viewMode == +ViewMode::Thumbnails)
+				{
+					UpdateThumbnailViewport();
+				}
+				break;
+
 			case LVN_COLUMNCLICK:
 				ColumnClicked(reinterpret_cast<NMLISTVIEW *>(lParam)->iSubItem);
 				break;
@@ -179,14 +238,14 @@ void ShellBrowser::OnListViewMButtonUp(const POINT *pt)
 		return;
 	}
 
-	const ItemInfo_t &itemInfo = GetItemByIndex(m_middleButtonItem);
+	int internalIndex = GetItemInternalIndex(m_middleButtonItem);
 
-	if (!WI_IsAnyFlagSet(itemInfo.wfd.dwFileAttributes, FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_ARCHIVE))
+	if (!WI_IsAnyFlagSet(m_itemStore.GetAttributes(internalIndex), FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_ARCHIVE))
 	{
 		return;
 	}
 
-	m_tabNavigation->CreateNewTab(itemInfo.pidlComplete.get(), false);
+	m_tabNavigation->CreateNewTab(m_itemShellInfo[internalIndex].pidlComplete.get(), false);
 }
 
 void ShellBrowser::OnListViewGetDisplayInfo(LPARAM lParam)
@@ -215,20 +274,36 @@ void ShellBrowser::OnListViewGetDisplayInfo(LPARAM lParam)
 		plvItem->iImage = GetIconThumbnail(internalIndex);
 		plvItem->mask |= LVIF_DI_SETITEM;
 
-		QueueThumbnailTask(internalIndex);
+		/* Items that have been added since the scheduler
+		was last updated won't be known to it yet. */
+		if (!m_thumbnailScheduler.IsItemKnown(internalIndex))
+		{
+			RefreshThumbnailItems();
+		}
+
+		UpdateThumbnailViewport();
 
 		return;
 	}
 
 	if (m_folderSettings.viewMode == +ViewMode::Details && (plvItem->mask & LVIF_TEXT) == LVIF_TEXT)
 	{
-		QueueColumnTask(internalIndex, plvItem->iSubItem);
+		auto cachedColumnText = GetCachedColumnText(internalIndex, plvItem->iSubItem);
+
+		if (cachedColumnText)
+		{
+			StringCchCopy(plvItem->pszText, plvItem->cchTextMax, cachedColumnText->c_str());
+			plvItem->mask |= LVIF_DI_SETITEM;
+		}
+		else
+		{
+			QueueColumnTask(internalIndex, plvItem->iSubItem);
+		}
 	}
 
 	if ((plvItem->mask & LVIF_IMAGE) == LVIF_IMAGE)
 	{
-		const ItemInfo_t &itemInfo = m_itemInfoMap.at(internalIndex);
-		auto cachedIconIndex = GetCachedIconIndex(itemInfo);
+		auto cachedIconIndex = GetCachedIconIndex(internalIndex);
 
 		if (cachedIconIndex)
 		{
@@ -251,7 +326,7 @@ void ShellBrowser::OnListViewGetDisplayInfo(LPARAM lParam)
 		}
 		else
 		{
-			if ((itemInfo.wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY)
+			if (m_itemStore.IsFolder(internalIndex))
 			{
 				plvItem->iImage = m_iFolderIcon;
 			}
@@ -261,7 +336,7 @@ void ShellBrowser::OnListViewGetDisplayInfo(LPARAM lParam)
 			}
 		}
 
-		m_iconFetcher->QueueIconTask(itemInfo.pidlComplete.get(), [this, internalIndex] (PCIDLIST_ABSOLUTE pidl, int iconIndex) {
+		m_iconFetcher->QueueIconTask(m_itemShellInfo[internalIndex].pidlComplete.get(), [this, internalIndex] (PCIDLIST_ABSOLUTE pidl, int iconIndex) {
 			UNREFERENCED_PARAMETER(pidl);
 
 			ProcessIconResult(internalIndex, iconIndex);
@@ -271,10 +346,10 @@ void ShellBrowser::OnListViewGetDisplayInfo(LPARAM lParam)
 	plvItem->mask |= LVIF_DI_SETITEM;
 }
 
-boost::optional<int> ShellBrowser::GetCachedIconIndex(const ItemInfo_t &itemInfo)
+boost::optional<int> ShellBrowser::GetCachedIconIndex(int internalIndex)
 {
 	TCHAR filePath[MAX_PATH];
-	HRESULT hr = GetDisplayName(itemInfo.pidlComplete.get(),
+	HRESULT hr = GetDisplayName(m_itemShellInfo[internalIndex].pidlComplete.get(),
 		filePath, SIZEOF_ARRAY(filePath), SHGDN_FORPARSING);
 
 	if (FAILED(hr))
@@ -282,14 +357,15 @@ boost::optional<int> ShellBrowser::GetCachedIconIndex(const ItemInfo_t &itemInfo
 		return boost::none;
 	}
 
-	auto cachedItr = m_cachedIcons->findByPath(filePath);
+	auto itemType = m_itemStore.IsFolder(internalIndex) ? CachedIcons::ItemType::Folder : CachedIcons::ItemType::File;
+	auto cachedIcon = m_cachedIcons->findIcon(filePath, itemType);
 
-	if (cachedItr == m_cachedIcons->end())
+	if (!cachedIcon)
 	{
 		return boost::none;
 	}
 
-	return cachedItr->iconIndex;
+	return cachedIcon->iconIndex;
 }
 
 void ShellBrowser::ProcessIconResult(int internalIndex, int iconIndex)
@@ -328,15 +404,13 @@ void ShellBrowser::QueueInfoTipTask(int internalIndex, const std::wstring &exist
 {
 	int infoTipResultId = m_infoTipResultIDCounter++;
 
-	BasicItemInfo_t basicItemInfo = getBasicItemInfo(internalIndex);
+	auto basicItemInfo = GetItemSnapshot(internalIndex);
 	Config configCopy = *m_config;
 	bool virtualFolder = InVirtualFolder();
 
-	auto result = m_infoTipsThreadPool.push([this, infoTipResultId, internalIndex,
-		basicItemInfo, configCopy, virtualFolder, existingInfoTip](int id) {
-		UNREFERENCED_PARAMETER(id);
-
-		auto result = GetInfoTipAsync(m_hListView, infoTipResultId, internalIndex, basicItemInfo, configCopy,
+	auto result = m_infoTipTasks.Push(TaskPriority::Visible, [this, infoTipResultId, internalIndex,
+		basicItemInfo, configCopy, virtualFolder, existingInfoTip] {
+		auto result = GetInfoTipAsync(m_hListView, infoTipResultId, internalIndex, *basicItemInfo, configCopy,
 			m_hResourceModule, virtualFolder);
 
 		// If the item name is truncated in the listview,
@@ -483,11 +557,9 @@ void ShellBrowser::UpdateFileSelectionInfo(int internalIndex, BOOL Selected)
 	ULARGE_INTEGER	ulFileSize;
 	BOOL			IsFolder;
 
-	IsFolder = (m_itemInfoMap.at(internalIndex).wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
-		== FILE_ATTRIBUTE_DIRECTORY;
+	IsFolder = m_itemStore.IsFolder(internalIndex);
 
-	ulFileSize.LowPart = m_itemInfoMap.at(internalIndex).wfd.nFileSizeLow;
-	ulFileSize.HighPart = m_itemInfoMap.at(internalIndex).wfd.nFileSizeHigh;
+	ulFileSize.QuadPart = m_itemStore.GetSize(internalIndex);
 
 	if (Selected)
 	{
@@ -559,12 +631,6 @@ void ShellBrowser::OnListViewKeyDown(const NMLVKEYDOWN *lvKeyDown)
 	}
 }
 
-ShellBrowser::ItemInfo_t &ShellBrowser::GetItemByIndex(int index)
-{
-	int internalIndex = GetItemInternalIndex(index);
-	return m_itemInfoMap.at(internalIndex);
-}
-
 int ShellBrowser::GetItemInternalIndex(int item) const
 {
 	LVITEM lvItem;
@@ -605,7 +671,7 @@ BOOL ShellBrowser::GhostItemInternal(int iItem, BOOL bGhost)
 	{
 		/* If the file is hidden, prevent changes to its visibility state (i.e.
 		hidden items will ALWAYS be ghosted). */
-		if (m_itemInfoMap.at((int)lvItem.lParam).wfd.dwFileAttributes & FILE_ATTRIBUTE_HIDDEN)
+		if (m_itemStore.GetAttributes((int)lvItem.lParam) & FILE_ATTRIBUTE_HIDDEN)
 			return FALSE;
 
 		if (bGhost)
@@ -785,10 +851,10 @@ void ShellBrowser::SetFileAttributesForSelection()
 	{
 		NSetFileAttributesDialogExternal::SetFileAttributesInfo_t sfai;
 
-		const ItemInfo_t &item = GetItemByIndex(index);
-		sfai.wfd = item.wfd;
+		int internalIndex = GetItemInternalIndex(index);
+		sfai.wfd = GetItemFindData(internalIndex);
 
-		GetDisplayName(item.pidlComplete.get(), sfai.szFullFileName,
+		GetDisplayName(m_itemShellInfo[internalIndex].pidlComplete.get(), sfai.szFullFileName,
 			static_cast<UINT>(std::size(sfai.szFullFileName)), SHGDN_FORPARSING);
 
 		sfaiList.push_back(sfai);
@@ -0,0 +1,306 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "ShellBrowser.h"
+#include "ItemData.h"
+#include "../Helper/Logging.h"
+#include "../Helper/ShellHelper.h"
+#include <algorithm>
+
+/* Moves the state of the current folder into a snapshot,
+keyed by the history entry the folder was visited through.
+This needs to be called before the listview is emptied, since
+the order of the items (and the selection) is taken from it.
+Afterwards, the folder state should be reset. */
+void ShellBrowser::SaveListingSnapshot()
+{
+	/* Virtual folders can't be checked for changes when
+	they're restored, so they're always read in again. A
+	folder with items still waiting to be inserted is only
+	partially shown. */
+	if(m_bVirtualFolder || m_currentHistoryEntryId == -1 || !m_AwaitingAddList.empty())
+	{
+		return;
+	}
+
+	ListingSnapshot_t snapshot{ unique_pidl_absolute(ILCloneFull(m_directoryState.pidlDirectory.get())),
+		m_folderSettings };
+
+	int nItems = ListView_GetItemCount(m_hListView);
+	snapshot.rows.reserve(nItems);
+
+	for(int i = 0;i < nItems;i++)
+	{
+		snapshot.rows.push_back(GetItemInternalIndex(i));
+	}
+
+	int iSelected = -1;
+
+	while((iSelected = ListView_GetNextItem(m_hListView,iSelected,LVNI_SELECTED)) != -1)
+	{
+		snapshot.selectedItems.push_back(GetItemInternalIndex(iSelected));
+	}
+
+	int iFocused = ListView_GetNextItem(m_hListView,-1,LVNI_FOCUSED);
+	snapshot.focusedItem = (iFocused != -1) ? GetItemInternalIndex(iFocused) : -1;
+
+	int iTop = ListView_GetTopIndex(m_hListView);
+	snapshot.topItem = (iTop >= 0 && iTop < nItems) ? GetItemInternalIndex(iTop) : -1;
+
+	snapshot.itemStore = std::move(m_itemStore);
+	snapshot.itemShellInfo = std::move(m_itemShellInfo);
+	snapshot.itemSnapshotArena = std::move(m_itemSnapshotArena);
+
+	/* The moved-from state is cleared when the folder
+	state is reset, but that relies on it being valid. */
+	m_itemStore.Clear();
+	m_itemShellInfo.clear();
+
+	size_t size = GetListingSnapshotSize(snapshot);
+
+	if(!m_listingSnapshots.Insert(m_currentHistoryEntryId, std::move(snapshot), size))
+	{
+		LOG(debug) << _T("ShellBrowser - Folder \"") << m_CurDir << _T("\" is too large to snapshot");
+	}
+}
+
+/* Returns the snapshot for the history entry, provided it can
+still be used to show the specified folder. */
+boost::optional<ShellBrowser::ListingSnapshot_t> ShellBrowser::TakeListingSnapshot(int historyEntryId,
+	PCIDLIST_ABSOLUTE pidlDirectory)
+{
+	auto snapshot = m_listingSnapshots.Take(historyEntryId);
+
+	if(!snapshot)
+	{
+		return boost::none;
+	}
+
+	/* Hidden items are left out of the listing entirely, so a
+	snapshot taken with a different setting is missing items
+	(or has too many). */
+	if(!CompareIdls(snapshot->pidlDirectory.get(), pidlDirectory)
+		|| snapshot->folderSettings.showHidden != m_folderSettings.showHidden)
+	{
+		return boost::none;
+	}
+
+	return std::move(*snapshot);
+}
+
+/* Adds the items from the snapshot back into the listview.
+Column text, icons and thumbnails aren't held in the snapshot;
+they're retrieved as they are for any other item, which means
+they'll generally be found in the shared caches. Returns true
+if the items were inserted in an order that's still valid (in
+which case, they don't need to be sorted again). */
+bool ShellBrowser::RestoreListingSnapshot(ListingSnapshot_t &snapshot)
+{
+	m_itemStore = std::move(snapshot.itemStore);
+	m_itemShellInfo = std::move(snapshot.itemShellInfo);
+	m_itemSnapshotArena = std::move(snapshot.itemSnapshotArena);
+
+	/* The color rules may have changed while the snapshot was
+	held (OnColorRulesChanged() only updates the items that
+	are shown), in which case the rule stored for each item
+	would be out of date. */
+	for(int i = 0;i < m_itemStore.GetIdLimit();i++)
+	{
+		if(m_itemStore.IsValidItem(i))
+		{
+			UpdateItemColorRule(i);
+		}
+	}
+
+	std::vector<bool> inSavedRows(m_itemStore.GetIdLimit());
+
+	for(int internalIndex : snapshot.rows)
+	{
+		inSavedRows[internalIndex] = true;
+	}
+
+	for(auto &itemShellInfo : m_itemShellInfo)
+	{
+		itemShellInfo.bInListView = false;
+	}
+
+	for(int internalIndex : snapshot.rows)
+	{
+		AddItemInternal(-1, internalIndex, FALSE);
+	}
+
+	/* Items that weren't shown are still added, since the
+	filter may have changed. They'll be filtered out again
+	if not. */
+	for(int i = 0;i < m_itemStore.GetIdLimit();i++)
+	{
+		if(m_itemStore.IsValidItem(i) && !inSavedRows[i])
+		{
+			AddItemInternal(-1, i, FALSE);
+		}
+	}
+
+	InsertAwaitingItems(FALSE);
+
+	if(snapshot.folderSettings.sortMode != m_folderSettings.sortMode
+		|| snapshot.folderSettings.sortAscending != m_folderSettings.sortAscending)
+	{
+		return false;
+	}
+
+	for(int i = 0;i < m_itemStore.GetIdLimit();i++)
+	{
+		if(m_itemStore.IsValidItem(i) && !inSavedRows[i] && m_itemShellInfo[i].bInListView)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void ShellBrowser::RestoreListingViewState(const ListingSnapshot_t &snapshot)
+{
+	for(int internalIndex : snapshot.selectedItems)
+	{
+		auto index = LocateItemByInternalIndex(internalIndex);
+
+		if(index)
+		{
+			ListView_SetItemState(m_hListView, *index, LVIS_SELECTED, LVIS_SELECTED);
+		}
+	}
+
+	boost::optional<int> topIndex;
+
+	if(snapshot.topItem != -1)
+	{
+		topIndex = LocateItemByInternalIndex(snapshot.topItem);
+	}
+
+	/* Scrolling to the last item first means that the top
+	item ends up at the top of the view, rather than just
+	inside the bottom of it. */
+	if(topIndex && *topIndex > 0)
+	{
+		ListView_EnsureVisible(m_hListView, ListView_GetItemCount(m_hListView) - 1, FALSE);
+		ListView_EnsureVisible(m_hListView, *topIndex, FALSE);
+	}
+	else
+	{
+		ListView_EnsureVisible(m_hListView, 0, FALSE);
+	}
+
+	boost::optional<int> focusedIndex;
+
+	if(snapshot.focusedItem != -1)
+	{
+		focusedIndex = LocateItemByInternalIndex(snapshot.focusedItem);
+	}
+
+	ListView_SetItemState(m_hListView, focusedIndex ? *focusedIndex : 0, LVIS_FOCUSED, LVIS_FOCUSED);
+}
+
+/* An estimate of the memory held by the snapshot. */
+size_t ShellBrowser::GetListingSnapshotSize(const ListingSnapshot_t &snapshot) const
+{
+	size_t size = sizeof(snapshot);
+	size += snapshot.itemStore.GetMemoryUsage();
+	size += snapshot.itemShellInfo.capacity() * sizeof(ItemShellInfo_t);
+	size += (snapshot.rows.capacity() + snapshot.selectedItems.capacity()) * sizeof(int);
+
+	if(snapshot.itemSnapshotArena)
+	{
+		size += snapshot.itemSnapshotArena->GetMemoryUsage();
+	}
+
+	for(const auto &itemShellInfo : snapshot.itemShellInfo)
+	{
+		if(itemShellInfo.pidlComplete)
+		{
+			size += ILGetSize(itemShellInfo.pidlComplete.get());
+		}
+
+		if(itemShellInfo.pridl)
+		{
+			size += ILGetSize(itemShellInfo.pridl.get());
+		}
+	}
+
+	return size;
+}
+
+/* Lists the current folder in the background, so that
+any changes made since it was snapshotted (or that were too
+numerous to be tracked individually) can be applied. The
+listing is compared with the items known about now. */
+void ShellBrowser::QueueRevalidation()
+{
+	auto before = GetItemStoreListing();
+	std::wstring directory = m_CurDir;
+	bool showHidden = (m_folderSettings.showHidden != FALSE);
+	HWND listView = m_hListView;
+	int folderId = m_uniqueFolderId;
+
+	m_revalidationResult = m_revalidationTasks.Push(TaskPriority::Visible,
+		[before = std::move(before), directory, showHidden, listView, folderId] () mutable {
+		boost::optional<ChangeJournal::Changes> changes;
+		auto after = ListDirectory(directory, showHidden);
+
+		if(after)
+		{
+			changes = ChangeJournal::DiffListings(std::move(before), std::move(*after));
+		}
+
+		PostMessage(listView, WM_APP_REVALIDATION_READY, folderId, 0);
+
+		return changes;
+	}, TaskKind::Blocking);
+}
+
+void ShellBrowser::ProcessRevalidationResult(int folderId)
+{
+	if(folderId != m_uniqueFolderId || !m_revalidationResult.valid())
+	{
+		return;
+	}
+
+	/* If the folder was revalidated again before this result
+	arrived, the result will have been replaced. The newer
+	task will post its own message once it's finished. */
+	if(m_revalidationResult.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+	{
+		return;
+	}
+
+	auto changes = m_revalidationResult.get();
+
+	if(!changes)
+	{
+		return;
+	}
+
+	/* Items created after the listing was queued may already
+	have been added, in response to a change notification. */
+	changes->added.erase(std::remove_if(changes->added.begin(), changes->added.end(),
+		[this] (const std::wstring &fileName) {
+		return m_itemStore.FindItemByFileName(fileName) != -1;
+	}), changes->added.end());
+
+	if(changes->removed.empty() && changes->modified.empty() && changes->added.empty())
+	{
+		return;
+	}
+
+	LOG(debug) << _T("ShellBrowser - Applying changes from listing of \"") << m_CurDir << _T("\" (")
+		<< changes->removed.size() << _T(" removed, ") << changes->modified.size() << _T(" modified, ")
+		<< changes->added.size() << _T(" added)");
+
+	SendMessage(m_hListView, WM_SETREDRAW, FALSE, NULL);
+	ApplyListingChanges(std::move(*changes));
+	SendMessage(m_hListView, WM_SETREDRAW, TRUE, NULL);
+
+	SendMessage(m_hOwner, WM_USER_DIRECTORYMODIFIED, m_ID, 0);
+}
@@ -10,17 +10,22 @@
 #include "PreservedFolderState.h"
 #include "SortModes.h"
 #include "ViewModes.h"
+#include "../Helper/ColorRuleSet.h"
 #include "../Helper/Controls.h"
 #include "../Helper/DriveInfo.h"
 #include "../Helper/FileOperations.h"
-#include "../Helper/FolderSize.h"
 #include "../Helper/Helper.h"
 #include "../Helper/ListViewHelper.h"
 #include "../Helper/Macros.h"
+#include "../Helper/ParallelSort.h"
 #include "../Helper/ShellHelper.h"
 #include <boost/scope_exit.hpp>
 #include <wil/com.h>
+#include <algorithm>
+#include <cassert>
+#include <functional>
 #include <list>
+#include <unordered_map>
 
 #pragma warning(disable:4459) // declaration of 'boost_scope_exit_aux_args' hides global declaration
 
@@ -66,27 +71,27 @@ ULONG __stdcall ShellBrowser::Release(void)
 }
 
 ShellBrowser *ShellBrowser::CreateNew(int id, HINSTANCE resourceInstance, HWND hOwner,
-	CachedIcons *cachedIcons, const Config *config, TabNavigationInterface *tabNavigation,
+	CachedIcons *cachedIcons, ColumnCache *columnCache, ThumbnailCache *thumbnailCache, const ColorRuleSet *colorRuleSet, const Config *config, TabNavigationInterface *tabNavigation,
 	const FolderSettings &folderSettings, boost::optional<FolderColumns> initialColumns)
 {
-	return new ShellBrowser(id, resourceInstance, hOwner, cachedIcons, config, tabNavigation,
+	return new ShellBrowser(id, resourceInstance, hOwner, cachedIcons, columnCache, thumbnailCache, colorRuleSet, config, tabNavigation,
 		folderSettings, initialColumns);
 }
 
 ShellBrowser *ShellBrowser::CreateFromPreserved(int id, HINSTANCE resourceInstance, HWND hOwner,
-	CachedIcons *cachedIcons, const Config *config, TabNavigationInterface *tabNavigation,
+	CachedIcons *cachedIcons, ColumnCache *columnCache, ThumbnailCache *thumbnailCache, const ColorRuleSet *colorRuleSet, const Config *config, TabNavigationInterface *tabNavigation,
 	const std::vector<std::unique_ptr<PreservedHistoryEntry>> &history, int currentEntry,
 	const PreservedFolderState &preservedFolderState)
 {
-	return new ShellBrowser(id, resourceInstance, hOwner, cachedIcons, config, tabNavigation,
+	return new ShellBrowser(id, resourceInstance, hOwner, cachedIcons, columnCache, thumbnailCache, colorRuleSet, config, tabNavigation,
 		history, currentEntry, preservedFolderState);
 }
 
 ShellBrowser::ShellBrowser(int id, HINSTANCE resourceInstance, HWND hOwner,
-	CachedIcons *cachedIcons, const Config *config, TabNavigationInterface *tabNavigation,
+	CachedIcons *cachedIcons, ColumnCache *columnCache, ThumbnailCache *thumbnailCache, const ColorRuleSet *colorRuleSet, const Config *config, TabNavigationInterface *tabNavigation,
 	const std::vector<std::unique_ptr<PreservedHistoryEntry>> &history, int currentEntry,
 	const PreservedFolderState &preservedFolderState) :
-	ShellBrowser(id, resourceInstance, hOwner, cachedIcons, config, tabNavigation,
+	ShellBrowser(id, resourceInstance, hOwner, cachedIcons, columnCache, thumbnailCache, colorRuleSet, config, tabNavigation,
 		preservedFolderState.folderSettings, boost::none)
 {
 	m_navigationController = std::make_unique<NavigationController>(this, tabNavigation, m_iconFetcher.get(),
@@ -94,8 +99,8 @@ ShellBrowser::ShellBrowser(int id, HINSTANCE resourceInstance, HWND hOwner,
 }
 
 ShellBrowser::ShellBrowser(int id, HINSTANCE resourceInstance, HWND hOwner, CachedIcons *cachedIcons,
-	const Config *config, TabNavigationInterface *tabNavigation, const FolderSettings &folderSettings,
-	boost::optional<FolderColumns> initialColumns) :
+	ColumnCache *columnCache, ThumbnailCache *thumbnailCache, const ColorRuleSet *colorRuleSet, const Config *config, TabNavigationInterface *tabNavigation,
+	const FolderSettings &folderSettings, boost::optional<FolderColumns> initialColumns) :
 	m_ID(id),
 	m_hResourceModule(resourceInstance),
 	m_hOwner(hOwner),
@@ -104,15 +109,38 @@ ShellBrowser::ShellBrowser(int id, HINSTANCE resourceInstance, HWND hOwner, Cach
 	m_tabNavigation(tabNavigation),
 	m_folderSettings(folderSettings),
 	m_folderColumns(initialColumns ? *initialColumns : config->globalFolderSettings.folderColumns),
-	m_columnThreadPool(1),
-	m_columnResultIDCounter(0),
-	m_thumbnailThreadPool(1),
+	m_columnTasks(TaskExecutor::GetShared()),
+	m_columnResultsPending(false),
+	m_columnResultGeneration(0),
+	m_columnCache(columnCache),
+	m_thumbnailScheduler(GetThumbnailSchedulerOptions()),
+	m_thumbnailTasks(TaskExecutor::GetShared()),
 	m_thumbnailResultIDCounter(0),
-	m_infoTipsThreadPool(1),
-	m_infoTipResultIDCounter(0)
+	m_thumbnailResultsPending(false),
+	m_thumbnailSize(config->globalFolderSettings.thumbnailSize),
+	m_thumbnailResidency(GetMaxResidentThumbnails(config)),
+	m_thumbnailCache(thumbnailCache),
+	m_colorRuleSet(colorRuleSet),
+	m_infoTipTasks(TaskExecutor::GetShared()),
+	m_infoTipResultIDCounter(0),
+	m_enumerationTasks(TaskExecutor::GetShared()),
+	m_listingSnapshots(MAX_LISTING_SNAPSHOTS, LISTING_SNAPSHOT_BUDGET),
+	m_currentHistoryEntryId(-1),
+	m_revalidationTasks(TaskExecutor::GetShared()),
+	m_changeJournal(MAX_CHANGE_JOURNAL_ENTRIES),
+	m_itemFilter([this] (int id) {
+		return m_itemStore.GetDisplayName(id);
+	})
 {
 	m_iRefCount = 1;
 
+	m_itemSnapshotArena = SnapshotArena<BasicItemInfo_t>::Create();
+
+	if(m_folderSettings.applyFilter)
+	{
+		m_itemFilter.SetFilter(m_folderSettings.filter, m_folderSettings.filterCaseSensitive != FALSE);
+	}
+
 	m_hListView = SetUpListView(hOwner);
 	m_iconFetcher = std::make_unique<IconFetcher>(m_hListView, cachedIcons);
 	m_navigationController = std::make_unique<NavigationController>(this, tabNavigation, m_iconFetcher.get());
@@ -136,6 +164,7 @@ ShellBrowser::ShellBrowser(int id, HINSTANCE resourceInstance, HWND hOwner, Cach
 	m_middleButtonItem = -1;
 
 	m_uniqueFolderId = 0;
+	m_changeJournalFolderId = 0;
 
 	m_PreviousSortColumnExists = false;
 
@@ -143,27 +172,25 @@ ShellBrowser::ShellBrowser(int id, HINSTANCE resourceInstance, HWND hOwner, Cach
 
 	m_iFolderIcon = GetDefaultFolderIconIndex();
 	m_iFileIcon = GetDefaultFileIconIndex();
-
-	m_thumbnailThreadPool.push([] (int id) {
-		UNREFERENCED_PARAMETER(id);
-
-		CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
-	});
 }
 
 ShellBrowser::~ShellBrowser()
 {
 	DestroyWindow(m_hListView);
 
-	m_columnThreadPool.clear_queue();
-	m_thumbnailThreadPool.clear_queue();
-	m_infoTipsThreadPool.clear_queue();
+	CancelEnumeration();
 
-	m_thumbnailThreadPool.push([] (int id) {
-		UNREFERENCED_PARAMETER(id);
-
-		CoUninitialize();
-	});
+	/* Any tasks that are still running will be waited on
+	when the groups are destroyed. Column and thumbnail
+	tasks push their results into queues that are destroyed
+	before the groups are, so they need to be waited on
+	now. */
+	m_columnTasks.Cancel();
+	m_columnTasks.Wait();
+	m_thumbnailTasks.Cancel();
+	m_thumbnailTasks.Wait();
+	m_infoTipTasks.Cancel();
+	m_revalidationTasks.Cancel();
 
 	/* Release the drag and drop helpers. */
 	m_pDropTargetHelper->Release();
@@ -176,9 +203,18 @@ ShellBrowser::~ShellBrowser()
 
 HWND ShellBrowser::SetUpListView(HWND parent)
 {
-	HWND hListView = CreateListView(parent, WS_CHILD | WS_VISIBLE | WS_CLIPSIBLINGS |
+	DWORD dwStyle = WS_CHILD | WS_VISIBLE | WS_CLIPSIBLINGS |
 		WS_CLIPCHILDREN | LVS_ICON | LVS_EDITLABELS | LVS_SHOWSELALWAYS |
-		LVS_SHAREIMAGELISTS | LVS_AUTOARRANGE | WS_TABSTOP | LVS_ALIGNTOP);
+		LVS_SHAREIMAGELISTS | LVS_AUTOARRANGE | WS_TABSTOP | LVS_ALIGNTOP;
+
+	/* This style can only be set when the listview is
+	created. */
+	if (m_config->virtualListView)
+	{
+		dwStyle |= LVS_OWNERDATA;
+	}
+
+	HWND hListView = CreateListView(parent, dwStyle);
 
 	if (hListView == nullptr)
 	{
@@ -192,13 +228,26 @@ HWND ShellBrowser::SetUpListView(HWND parent)
 		dwExtendedStyle |= LVS_EX_FULLROWSELECT;
 	}
 
-	if (m_config->checkBoxSelection)
+	if (m_config->checkBoxSelection && !m_config->virtualListView)
 	{
 		dwExtendedStyle |= LVS_EX_CHECKBOXES;
 	}
 
 	ListView_SetExtendedListViewStyle(hListView, dwExtendedStyle);
 
+	if (m_config->virtualListView)
+	{
+		/* The listview doesn't store these states for each
+		item, so they're held in m_virtualList instead. */
+		ListView_SetCallbackMask(hListView, VIRTUAL_LIST_VIEW_CALLBACK_MASK);
+
+		m_virtualList = std::make_unique<VirtualListState_t>();
+		m_virtualList->filter = [this] (int internalIndex) {
+			return m_itemFilter.IsVisible(internalIndex);
+		};
+		m_virtualList->items.SetFilter(m_virtualList->filter);
+	}
+
 	NListView::ListView_SetAutoArrange(m_hListView, m_folderSettings.autoArrange);
 	NListView::ListView_SetGridlines(m_hListView, m_config->globalFolderSettings.showGridlines);
 
@@ -367,8 +416,8 @@ void ShellBrowser::SetViewModeInternal(ViewMode viewMode)
 
 	if (viewMode != +ViewMode::Details)
 	{
-		m_columnThreadPool.clear_queue();
-		m_columnResults.clear();
+		m_columnTasks.Cancel();
+		m_columnResultGeneration++;
 	}
 
 	SendMessage(m_hListView, LVM_SETVIEW, dwStyle, 0);
@@ -415,18 +464,10 @@ void ShellBrowser::OnGridlinesSettingChanged()
 	NListView::ListView_SetGridlines(m_hListView, m_config->globalFolderSettings.showGridlines);
 }
 
-BOOL ShellBrowser::IsFilenameFiltered(const TCHAR *FileName) const
-{
-	if(CheckWildcardMatch(m_folderSettings.filter.c_str(),FileName,m_folderSettings.filterCaseSensitive))
-		return FALSE;
-
-	return TRUE;
-}
-
 int ShellBrowser::GetItemDisplayName(int iItem,UINT BufferSize,TCHAR *Buffer) const
 {
 	int internalIndex = GetItemInternalIndex(iItem);
-	StringCchCopy(Buffer,BufferSize,m_itemInfoMap.at(internalIndex).wfd.cFileName);
+	StringCchCopy(Buffer,BufferSize,m_itemStore.GetFileName(internalIndex).data());
 
 	return lstrlen(Buffer);
 }
@@ -453,7 +494,7 @@ HRESULT ShellBrowser::GetItemFullName(int iIndex,TCHAR *FullItemPath,UINT cchMax
 
 void ShellBrowser::QueryFullItemNameInternal(int iItemInternal,TCHAR *szFullFileName,UINT cchMax) const
 {
-	GetDisplayName(m_itemInfoMap.at(iItemInternal).pidlComplete.get(),szFullFileName,cchMax,SHGDN_FORPARSING);
+	GetDisplayName(m_itemShellInfo[iItemInternal].pidlComplete.get(),szFullFileName,cchMax,SHGDN_FORPARSING);
 }
 
 std::wstring ShellBrowser::GetDirectory() const
@@ -483,71 +524,145 @@ int ShellBrowser::SelectFiles(const TCHAR *FileNamePattern)
 		return 1;
 	}
 
+	/* The item may not have been read yet, in which case
+	it will be selected once it's inserted. */
+	if(m_enumerationState)
+	{
+		m_FileSelectionList.push_back(FileNamePattern);
+	}
+
 	return 0;
 }
 
 int ShellBrowser::LocateFileItemIndex(const TCHAR *szFileName) const
 {
-	LV_FINDINFO	lvFind;
-	int			iItem;
-	int			iInternalIndex;
-
-	iInternalIndex = LocateFileItemInternalIndex(szFileName);
+	int iInternalIndex = LocateFileItemInternalIndex(szFileName);
 
 	if(iInternalIndex != -1)
 	{
-		lvFind.flags	= LVFI_PARAM;
-		lvFind.lParam	= iInternalIndex;
-		iItem			= ListView_FindItem(m_hListView,-1,&lvFind);
+		auto item = LocateItemByInternalIndex(iInternalIndex);
 
-		return iItem;
+		if(item)
+		{
+			return *item;
+		}
 	}
 
 	return -1;
 }
 
+/* Finds the item with the specified file name (or
+alternate file name) in the listview. Items are looked
+up via the store's name index, rather than by checking
+each item in the listview in turn. */
 int ShellBrowser::LocateFileItemInternalIndex(const TCHAR *szFileName) const
 {
-	LVITEM	lvItem;
-	int		i = 0;
+	int internalIndex = m_itemStore.FindItemByFileName(szFileName);
 
-	for(i = 0;i < m_nTotalItems;i++)
+	if(internalIndex == -1 || !m_itemShellInfo[internalIndex].bInListView)
 	{
-		lvItem.mask		= LVIF_PARAM;
-		lvItem.iItem	= i;
-		lvItem.iSubItem	= 0;
-		ListView_GetItem(m_hListView,&lvItem);
+		internalIndex = m_itemStore.FindItemByAlternateFileName(szFileName);
+	}
 
-		if((lstrcmp(m_itemInfoMap.at((int)lvItem.lParam).wfd.cFileName,szFileName) == 0) ||
-			(lstrcmp(m_itemInfoMap.at((int)lvItem.lParam).wfd.cAlternateFileName,szFileName) == 0))
-		{
-			return (int)lvItem.lParam;
-			break;
-		}
+	if(internalIndex == -1 || !m_itemShellInfo[internalIndex].bInListView)
+	{
+		return -1;
 	}
 
-	return -1;
+	return internalIndex;
 }
 
 boost::optional<int> ShellBrowser::LocateItemByInternalIndex(int internalIndex) const
 {
-	LVFINDINFO lvfi;
-	lvfi.flags = LVFI_PARAM;
-	lvfi.lParam = internalIndex;
-	int item = ListView_FindItem(m_hListView, -1, &lvfi);
+	if (!m_itemShellInfo[internalIndex].bInListView)
+	{
+		return boost::none;
+	}
 
-	if (item == -1)
+	if (m_virtualList)
+	{
+		auto row = m_virtualList->items.GetRowForItem(internalIndex);
+
+		if (!row)
+		{
+			return boost::none;
+		}
+
+		return static_cast<int>(*row);
+	}
+
+	assert(m_rowIndex.GetNumRows() == ListView_GetItemCount(m_hListView));
+
+	int row = m_rowIndex.FindRow(internalIndex);
+
+	if (row == -1)
 	{
 		return boost::none;
 	}
 
-	return item;
+	return row;
+}
+
+/* Rebuilds the row index from the listview. Only needed
+when the listview has been rearranged directly (rather
+than via SortItems()). */
+void ShellBrowser::RebuildRowIndex()
+{
+	/* An owner-data listview can't be rearranged directly. */
+	if (m_virtualList)
+	{
+		return;
+	}
+
+	int numItems = ListView_GetItemCount(m_hListView);
+
+	std::vector<int> internalIndices(numItems);
+
+	for (int i = 0; i < numItems; i++)
+	{
+		internalIndices[i] = GetItemInternalIndex(i);
+	}
+
+	m_rowIndex.SetRows(std::move(internalIndices));
 }
 
 WIN32_FIND_DATA ShellBrowser::GetItemFileFindData(int iItem) const
 {
 	int internalIndex = GetItemInternalIndex(iItem);
-	return m_itemInfoMap.at(internalIndex).wfd;
+	return GetItemFindData(internalIndex);
+}
+
+boost::optional<uint16_t> ShellBrowser::GetItemColorRule(int iItem) const
+{
+	int internalIndex = GetItemInternalIndex(iItem);
+	uint16_t colorRule = m_itemStore.GetColorRule(internalIndex);
+
+	if(colorRule == ItemStore::NO_COLOR_RULE)
+	{
+		return boost::none;
+	}
+
+	return colorRule;
+}
+
+void ShellBrowser::UpdateItemColorRule(int internalIndex)
+{
+	auto colorRule = m_colorRuleSet->Classify(m_itemStore.GetFileName(internalIndex),
+		m_itemStore.GetAttributes(internalIndex));
+	m_itemStore.SetColorRule(internalIndex, colorRule.value_or(ItemStore::NO_COLOR_RULE));
+}
+
+void ShellBrowser::OnColorRulesChanged()
+{
+	for(int i = 0; i < m_itemStore.GetIdLimit(); i++)
+	{
+		if(m_itemStore.IsValidItem(i))
+		{
+			UpdateItemColorRule(i);
+		}
+	}
+
+	InvalidateRect(m_hListView, nullptr, FALSE);
 }
 
 void ShellBrowser::DragStarted(int iFirstItem,POINT *ptCursor)
@@ -598,7 +713,7 @@ unique_pidl_absolute ShellBrowser::GetItemCompleteIdl(int iItem) const
 		return nullptr;
 	}
 
-	unique_pidl_absolute pidlComplete(ILCombine(m_directoryState.pidlDirectory.get(), m_itemInfoMap.at((int)lvItem.lParam).pridl.get()));
+	unique_pidl_absolute pidlComplete(ILCombine(m_directoryState.pidlDirectory.get(), m_itemShellInfo[(int)lvItem.lParam].pridl.get()));
 
 	return pidlComplete;
 }
@@ -618,7 +733,7 @@ unique_pidl_child ShellBrowser::GetItemChildIdl(int iItem) const
 		return nullptr;
 	}
 
-	unique_pidl_child pidlRelative(ILCloneChild(m_itemInfoMap.at((int)lvItem.lParam).pridl.get()));
+	unique_pidl_child pidlRelative(ILCloneChild(m_itemShellInfo[(int)lvItem.lParam].pridl.get()));
 
 	return pidlRelative;
 }
@@ -667,11 +782,6 @@ BOOL ShellBrowser::CompareVirtualFolders(UINT uFolderCSIDL) const
 	return FALSE;
 }
 
-int ShellBrowser::GenerateUniqueItemId(void)
-{
-	return m_directoryState.itemIDCounter++;
-}
-
 void ShellBrowser::PositionDroppedItems(void)
 {
 	std::list<DroppedFile_t>::iterator	itr;
@@ -887,29 +997,121 @@ int ShellBrowser::DetermineItemSortedPosition(LPARAM lParam) const
 	return i - 1;
 }
 
-void ShellBrowser::RemoveFilteredItems(void)
+/* Removes the specified items (which the filter has
+hidden) from the listview. Each item is located through
+the row index, so only the affected rows are visited.
+The rows are deleted from the bottom up, so that the row
+index can then be updated once for the whole batch. The
+group headers aren't updated here. */
+void ShellBrowser::RemoveFilteredItems(const std::vector<int> &internalIndices)
+{
+	if(m_virtualList)
+	{
+		HideVirtualItems(internalIndices);
+		return;
+	}
+
+	std::vector<int> rows;
+	rows.reserve(internalIndices.size());
+
+	for(int internalIndex : internalIndices)
+	{
+		auto item = LocateItemByInternalIndex(internalIndex);
+
+		if(item)
+		{
+			rows.push_back(*item);
+		}
+	}
+
+	std::sort(rows.begin(), rows.end(), std::greater<int>());
+
+	for(int row : rows)
+	{
+		RemoveFilteredItem(row, m_rowIndex.GetId(row));
+	}
+
+	m_rowIndex.RemoveRows(std::move(rows));
+}
+
+/* Inserts the specified items (which the filter has shown
+again) into the listview. The listview is already sorted,
+so rather than appending the items and resorting every
+item, the shown items are sorted amongst themselves and
+the position of each one is then found with a binary
+search over the existing rows. Only the rows that are
+actually compared need a sort key. */
+void ShellBrowser::InsertFilteredItems(const std::vector<int> &internalIndices)
 {
-	if (!m_folderSettings.applyFilter)
+	if(m_virtualList)
 	{
+		ShowVirtualItems(internalIndices);
 		return;
 	}
 
-	int nItems = ListView_GetItemCount(m_hListView);
+	std::vector<SortKey> sortKeys = BuildSortKeys(internalIndices);
+	std::vector<SortedItem_t> shownItems;
+	shownItems.reserve(internalIndices.size());
+
+	for(size_t i = 0;i < internalIndices.size();i++)
+	{
+		shownItems.push_back({ internalIndices[i], std::move(sortKeys[i]) });
+	}
+
+	bool foldersFirst = !CompareVirtualFolders(CSIDL_BITBUCKET);
+
+	auto compareItems = [this, foldersFirst] (const SortedItem_t &item1, const SortedItem_t &item2) {
+		return CompareItems(item1.internalIndex, item1.sortKey, item2.internalIndex, item2.sortKey, foldersFirst) < 0;
+	};
+
+	ParallelSort::ParallelMergeSort(TaskExecutor::GetShared(), shownItems, compareItems);
+
+	std::unordered_map<int, SortedItem_t> existingItems;
+
+	auto getExistingItem = [this, &existingItems] (int row) -> const SortedItem_t & {
+		auto itr = existingItems.find(row);
+
+		if(itr == existingItems.end())
+		{
+			int internalIndex = m_rowIndex.GetId(row);
+			itr = existingItems.emplace(row, SortedItem_t{ internalIndex, GetSortKey(internalIndex) }).first;
+		}
+
+		return itr->second;
+	};
+
+	int numRows = m_rowIndex.GetNumRows();
+	int first = 0;
 
-	for(int i = nItems - 1;i >= 0;i--)
+	for(size_t i = 0;i < shownItems.size();i++)
 	{
-		int internalIndex = GetItemInternalIndex(i);
+		/* Since the shown items are sorted, each one can only
+		go at or after the position of the previous one. As in
+		MergeEnumeratedItems(), shown items are placed after
+		any equal items. */
+		int last = numRows;
 
-		if(!((m_itemInfoMap.at(internalIndex).wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY))
+		while(first < last)
 		{
-			if(IsFilenameFiltered(m_itemInfoMap.at(internalIndex).szDisplayName))
+			int middle = first + (last - first) / 2;
+
+			if(compareItems(shownItems[i], getExistingItem(middle)))
+			{
+				last = middle;
+			}
+			else
 			{
-				RemoveFilteredItem(i, internalIndex);
+				first = middle + 1;
 			}
 		}
+
+		/* The positions are in ascending order, so inserting
+		each item at its final position places it correctly
+		relative to the items inserted before it. */
+		AddItemInternal(first + static_cast<int>(i), shownItems[i].internalIndex, FALSE);
 	}
 
-	SendMessage(m_hOwner,WM_USER_UPDATEWINDOWS,0,0);
+	InsertAwaitingItems(m_folderSettings.showInGroups);
 }
 
 void ShellBrowser::RemoveFilteredItem(int iItem,int iItemInternal)
@@ -919,25 +1121,25 @@ void ShellBrowser::RemoveFilteredItem(int iItem,int iItemInternal)
 	if(ListView_GetItemState(m_hListView,iItem,LVIS_SELECTED)
 		== LVIS_SELECTED)
 	{
-		ulFileSize.LowPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeLow;
-		ulFileSize.HighPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeHigh;
+		ulFileSize.QuadPart = m_itemStore.GetSize(iItemInternal);
 
 		m_ulFileSelectionSize.QuadPart -= ulFileSize.QuadPart;
 	}
 
 	/* Take the file size of the removed file away from the total
 	directory size. */
-	ulFileSize.LowPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeLow;
-	ulFileSize.HighPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeHigh;
+	ulFileSize.QuadPart = m_itemStore.GetSize(iItemInternal);
 
 	m_ulTotalDirSize.QuadPart -= ulFileSize.QuadPart;
 
-	/* Remove the item from the m_hListView. */
+	RemoveItemFromGroup(iItem);
+
+	/* Remove the item from the m_hListView. The caller
+	is responsible for updating the row index. */
 	ListView_DeleteItem(m_hListView,iItem);
+	m_itemShellInfo[iItemInternal].bInListView = false;
 
 	m_nTotalItems--;
-
-	m_FilteredItemsList.push_back(iItemInternal);
 }
 
 int ShellBrowser::GetNumItems(void) const
@@ -995,7 +1197,6 @@ void ShellBrowser::SetFilter(std::wstring_view filter)
 
 	if(m_folderSettings.applyFilter)
 	{
-		UnfilterAllItems();
 		UpdateFiltering();
 	}
 }
@@ -1015,6 +1216,11 @@ BOOL ShellBrowser::GetFilterStatus(void) const
 void ShellBrowser::SetFilterCaseSensitive(BOOL bFilterCaseSensitive)
 {
 	m_folderSettings.filterCaseSensitive = bFilterCaseSensitive;
+
+	if(m_folderSettings.applyFilter)
+	{
+		UpdateFiltering();
+	}
 }
 
 BOOL ShellBrowser::GetFilterCaseSensitive(void) const
@@ -1022,17 +1228,21 @@ BOOL ShellBrowser::GetFilterCaseSensitive(void) const
 	return m_folderSettings.filterCaseSensitive;
 }
 
+/* Only the items that the change to the filter can
+affect are tested again (e.g. if the filter has been
+narrowed, only the items that are currently shown). */
 void ShellBrowser::UpdateFiltering(void)
 {
 	if(m_folderSettings.applyFilter)
 	{
-		RemoveFilteredItems();
+		ApplyFilterChanges(m_itemFilter.SetFilter(m_folderSettings.filter,
+			m_folderSettings.filterCaseSensitive != FALSE));
 
 		ApplyFilteringBackgroundImage(true);
 	}
 	else
 	{
-		UnfilterAllItems();
+		ApplyFilterChanges(m_itemFilter.RemoveFilter());
 
 		if(m_nTotalItems == 0)
 			ApplyFolderEmptyBackgroundImage(true);
@@ -1041,26 +1251,36 @@ void ShellBrowser::UpdateFiltering(void)
 	}
 }
 
-void ShellBrowser::UnfilterAllItems(void)
+/* Applies the items whose visibility has changed to the
+listview as a single batch, with redrawing suspended
+throughout. Only the items whose visibility has changed
+are touched; the remaining items stay where they are. */
+void ShellBrowser::ApplyFilterChanges(const IncrementalFilter::Changes &changes)
 {
-	std::list<int>::iterator	itr;
-	AwaitingAdd_t		AwaitingAdd;
-
-	for(itr = m_FilteredItemsList.begin();itr != m_FilteredItemsList.end();itr++)
+	if(changes.hidden.empty() && changes.shown.empty())
 	{
-		int iSorted = DetermineItemSortedPosition(*itr);
+		return;
+	}
 
-		AwaitingAdd.iItem			= iSorted;
-		AwaitingAdd.bPosition		= TRUE;
-		AwaitingAdd.iAfter			= iSorted - 1;
-		AwaitingAdd.iItemInternal	= *itr;
+	SendMessage(m_hListView,WM_SETREDRAW,FALSE,NULL);
 
-		m_AwaitingAddList.push_back(AwaitingAdd);
+	if(!changes.hidden.empty())
+	{
+		RemoveFilteredItems(changes.hidden);
 	}
 
-	m_FilteredItemsList.clear();
+	if(!changes.shown.empty())
+	{
+		InsertFilteredItems(changes.shown);
+	}
 
-	InsertAwaitingItems(m_folderSettings.showInGroups);
+	UpdateGroupHeaders();
+
+	/* If the folder is still being read, the remaining items
+	can no longer simply be merged in. */
+	m_enumerationSortedItems.clear();
+
+	SendMessage(m_hListView,WM_SETREDRAW,TRUE,NULL);
 
 	SendMessage(m_hOwner,WM_USER_UPDATEWINDOWS,0,0);
 }
@@ -1190,7 +1410,7 @@ void ShellBrowser::QueueRename(PCIDLIST_ABSOLUTE pidlItem)
 		lvItem.iSubItem	= 0;
 		ListView_GetItem(m_hListView,&lvItem);
 
-		if(CompareIdls(pidlItem, m_itemInfoMap.at((int)lvItem.lParam).pidlComplete.get()))
+		if(CompareIdls(pidlItem, m_itemShellInfo[(int)lvItem.lParam].pidlComplete.get()))
 		{
 			bItemFound = TRUE;
 
@@ -1278,6 +1498,11 @@ void ShellBrowser::OnDeviceChange(WPARAM wParam,LPARAM lParam)
 					else
 					{
 						OnFileActionAdded(szDrive);
+
+						if(m_virtualList)
+						{
+							FlushVirtualItemChanges();
+						}
 					}
 				}
 			}
@@ -1352,7 +1577,7 @@ void ShellBrowser::UpdateDriveIcon(const TCHAR *szDrive)
 			lvItem.iSubItem	= 0;
 			ListView_GetItem(m_hListView,&lvItem);
 
-			if(CompareIdls(pidlDrive.get(), m_itemInfoMap.at((int)lvItem.lParam).pidlComplete.get()))
+			if(CompareIdls(pidlDrive.get(), m_itemShellInfo[(int)lvItem.lParam].pidlComplete.get()))
 			{
 				iItem = i;
 				iItemInternal = (int)lvItem.lParam;
@@ -1366,9 +1591,8 @@ void ShellBrowser::UpdateDriveIcon(const TCHAR *szDrive)
 	{
 		SHGetFileInfo(szDrive,0,&shfi,sizeof(shfi),SHGFI_SYSICONINDEX);
 
-		StringCchCopy(m_itemInfoMap.at(iItemInternal).szDisplayName,
-			SIZEOF_ARRAY(m_itemInfoMap.at(iItemInternal).szDisplayName),
-			szDisplayName);
+		m_itemStore.SetDisplayName(iItemInternal, szDisplayName);
+		UpdateItemSnapshot(iItemInternal);
 
 		/* Update the drives icon and display name. */
 		lvItem.mask		= LVIF_TEXT|LVIF_IMAGE;
@@ -1393,9 +1617,9 @@ void ShellBrowser::RemoveDrive(const TCHAR *szDrive)
 		lvItem.iSubItem	= 0;
 		ListView_GetItem(m_hListView,&lvItem);
 
-		if(m_itemInfoMap.at((int)lvItem.lParam).bDrive)
+		if(m_itemShellInfo[(int)lvItem.lParam].bDrive)
 		{
-			if(lstrcmp(szDrive,m_itemInfoMap.at((int)lvItem.lParam).szDrive) == 0)
+			if(lstrcmp(szDrive,m_itemShellInfo[(int)lvItem.lParam].szDrive) == 0)
 			{
 				iItemInternal = (int)lvItem.lParam;
 				break;
@@ -1404,7 +1628,10 @@ void ShellBrowser::RemoveDrive(const TCHAR *szDrive)
 	}
 
 	if(iItemInternal != -1)
+	{
 		RemoveItem(iItemInternal);
+		UpdateGroupHeaders();
+	}
 }
 
 int ShellBrowser::GetUniqueFolderId() const
@@ -1412,18 +1639,79 @@ int ShellBrowser::GetUniqueFolderId() const
 	return m_uniqueFolderId;
 }
 
-BasicItemInfo_t ShellBrowser::getBasicItemInfo(int internalIndex) const
+/* The returned reference remains valid until the item
+changes. Anything that may need the information for
+longer (such as a background task) should hold onto
+the snapshot itself instead. */
+const BasicItemInfo_t &ShellBrowser::getBasicItemInfo(int internalIndex) const
 {
-	const ItemInfo_t &itemInfo = m_itemInfoMap.at(internalIndex);
+	return *m_itemShellInfo[internalIndex].snapshot;
+}
 
-	BasicItemInfo_t basicItemInfo;
-	basicItemInfo.pidlComplete.reset(ILCloneFull(itemInfo.pidlComplete.get()));
-	basicItemInfo.pridl.reset(ILCloneChild(itemInfo.pridl.get()));
-	basicItemInfo.wfd = itemInfo.wfd;
-	StringCchCopy(basicItemInfo.szDisplayName, SIZEOF_ARRAY(basicItemInfo.szDisplayName), itemInfo.szDisplayName);
-	basicItemInfo.isRoot = itemInfo.bDrive;
+std::shared_ptr<const BasicItemInfo_t> ShellBrowser::GetItemSnapshot(int internalIndex) const
+{
+	return m_itemShellInfo[internalIndex].snapshot;
+}
+
+/* Needs to be called whenever the item's shell information
+or its data in the item store changes. Any tasks holding
+the previous snapshot will continue to see the previous
+data. */
+void ShellBrowser::UpdateItemSnapshot(int internalIndex)
+{
+	ItemShellInfo_t &itemShellInfo = m_itemShellInfo[internalIndex];
 
-	return basicItemInfo;
+	BasicItemInfo_t basicItemInfo;
+	basicItemInfo.pidlComplete.reset(ILCloneFull(itemShellInfo.pidlComplete.get()));
+	basicItemInfo.pridl.reset(ILCloneChild(itemShellInfo.pridl.get()));
+	basicItemInfo.wfd = GetItemFindData(internalIndex);
+	StringCchCopy(basicItemInfo.szDisplayName, SIZEOF_ARRAY(basicItemInfo.szDisplayName),
+		m_itemStore.GetDisplayName(internalIndex).data());
+	basicItemInfo.isRoot = itemShellInfo.bDrive;
+
+	itemShellInfo.snapshot = m_itemSnapshotArena->MakeSnapshot(std::move(basicItemInfo));
+}
+
+WIN32_FIND_DATA ShellBrowser::GetItemFindData(int internalIndex) const
+{
+	WIN32_FIND_DATA wfd = {};
+	wfd.dwFileAttributes = m_itemStore.GetAttributes(internalIndex);
+
+	ULARGE_INTEGER size;
+	size.QuadPart = m_itemStore.GetSize(internalIndex);
+	wfd.nFileSizeLow = size.LowPart;
+	wfd.nFileSizeHigh = size.HighPart;
+
+	ULARGE_INTEGER time;
+	time.QuadPart = m_itemStore.GetCreationTime(internalIndex);
+	wfd.ftCreationTime = { time.LowPart, time.HighPart };
+	time.QuadPart = m_itemStore.GetLastAccessTime(internalIndex);
+	wfd.ftLastAccessTime = { time.LowPart, time.HighPart };
+	time.QuadPart = m_itemStore.GetLastWriteTime(internalIndex);
+	wfd.ftLastWriteTime = { time.LowPart, time.HighPart };
+
+	StringCchCopy(wfd.cFileName, SIZEOF_ARRAY(wfd.cFileName),
+		m_itemStore.GetFileName(internalIndex).data());
+	StringCchCopy(wfd.cAlternateFileName, SIZEOF_ARRAY(wfd.cAlternateFileName),
+		m_itemStore.GetAlternateFileName(internalIndex).data());
+
+	return wfd;
+}
+
+ItemStore::FileData ShellBrowser::FindDataToFileData(const WIN32_FIND_DATA &wfd)
+{
+	ItemStore::FileData fileData;
+	fileData.attributes = wfd.dwFileAttributes;
+	fileData.size = (static_cast<uint64_t>(wfd.nFileSizeHigh) << 32) | wfd.nFileSizeLow;
+	fileData.creationTime = (static_cast<uint64_t>(wfd.ftCreationTime.dwHighDateTime) << 32)
+		| wfd.ftCreationTime.dwLowDateTime;
+	fileData.lastAccessTime = (static_cast<uint64_t>(wfd.ftLastAccessTime.dwHighDateTime) << 32)
+		| wfd.ftLastAccessTime.dwLowDateTime;
+	fileData.lastWriteTime = (static_cast<uint64_t>(wfd.ftLastWriteTime.dwHighDateTime) << 32)
+		| wfd.ftLastWriteTime.dwLowDateTime;
+	fileData.fileName = wfd.cFileName;
+	fileData.alternateFileName = wfd.cAlternateFileName;
+	return fileData;
 }
 
 HWND ShellBrowser::GetListView() const
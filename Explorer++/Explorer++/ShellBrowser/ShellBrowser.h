@@ -10,21 +10,41 @@
 #include "NavigationController.h"
 #include "NavigatorInterface.h"
 #include "SignalWrapper.h"
+#include "SortHelper.h"
 #include "SortModes.h"
 #include "TabNavigationInterface.h"
 #include "ViewModes.h"
+#include "../Helper/ChangeJournal.h"
+#include "../Helper/CollationKey.h"
+#include "../Helper/DateBuckets.h"
 #include "../Helper/DropHandler.h"
+#include "../Helper/GroupIndex.h"
 #include "../Helper/Helper.h"
+#include "../Helper/HistorySnapshotCache.h"
 #include "../Helper/IconFetcher.h"
+#include "../Helper/IncrementalFilter.h"
+#include "../Helper/ItemStore.h"
 #include "../Helper/Macros.h"
+#include "../Helper/MpscQueue.h"
+#include "../Helper/ProgressiveEnumeration.h"
+#include "../Helper/RowIndex.h"
 #include "../Helper/ShellHelper.h"
+#include "../Helper/SnapshotArena.h"
 #include "../Helper/StringHelper.h"
+#include "../Helper/TaskExecutor.h"
+#include "../Helper/ThumbnailResidency.h"
+#include "../Helper/ThumbnailScheduler.h"
+#include "../Helper/VirtualItemList.h"
 #include "../Helper/WindowSubclassWrapper.h"
-#include "../ThirdParty/CTPL/cpl_stl.h"
 #include <boost/optional.hpp>
 #include <wil/resource.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <future>
 #include <list>
+#include <mutex>
 #include <unordered_map>
 
 #define WM_USER_UPDATEWINDOWS		(WM_APP + 17)
@@ -39,31 +59,26 @@ typedef struct
 	ULARGE_INTEGER TotalSelectionSize;
 } FolderInfo_t;
 
-typedef struct
-{
-	std::wstring header;
-	int iGroupId;
-
-	/* Used to record the number of items in this group.
-	Mimics the feature available in Windows Vista and later. */
-	int nItems;
-} TypeGroup_t;
-
 struct BasicItemInfo_t;
 class CachedIcons;
+struct CachedThumbnail;
+class ColorRuleSet;
+class ColumnCache;
 struct Config;
 struct PreservedFolderState;
+class ThumbnailCache;
+struct ThumbnailCacheKey;
 
 class ShellBrowser : public IDropTarget, public IDropFilesCallback, public NavigatorInterface
 {
 public:
 
 	static ShellBrowser *CreateNew(int id, HINSTANCE resourceInstance, HWND hOwner,
-		CachedIcons *cachedIcons, const Config *config, TabNavigationInterface *tabNavigation,
+		CachedIcons *cachedIcons, ColumnCache *columnCache, ThumbnailCache *thumbnailCache, const ColorRuleSet *colorRuleSet, const Config *config, TabNavigationInterface *tabNavigation,
 		const FolderSettings &folderSettings, boost::optional<FolderColumns> initialColumns);
 
 	static ShellBrowser *CreateFromPreserved(int id, HINSTANCE resourceInstance, HWND hOwner,
-		CachedIcons *cachedIcons, const Config *config, TabNavigationInterface *tabNavigation,
+		CachedIcons *cachedIcons, ColumnCache *columnCache, ThumbnailCache *thumbnailCache, const ColorRuleSet *colorRuleSet, const Config *config, TabNavigationInterface *tabNavigation,
 		const std::vector<std::unique_ptr<PreservedHistoryEntry>> &history, int currentEntry,
 		const PreservedFolderState &preservedFolderState);
 
@@ -122,6 +137,10 @@ public:
 	unique_pidl_child	GetItemChildIdl(int iItem) const;
 	int					GetItemDisplayName(int iItem,UINT BufferSize,TCHAR *Buffer) const;
 	HRESULT				GetItemFullName(int iIndex,TCHAR *FullItemPath,UINT cchMax) const;
+	boost::optional<uint16_t>	GetItemColorRule(int iItem) const;
+
+	/* Color rule support. */
+	void				OnColorRulesChanged();
 
 	void				ShowPropertiesForSelectedFiles() const;
 	
@@ -176,22 +195,15 @@ private:
 	struct DirectoryState
 	{
 		unique_pidl_absolute pidlDirectory;
-		int itemIDCounter;
-
-		DirectoryState() :
-			itemIDCounter(0)
-		{
-
-		}
 	};
 
-	struct ItemInfo_t
+	/* The shell-specific information for an item. The
+	file system information (attributes, size, names,
+	etc) is held separately, in m_itemStore. */
+	struct ItemShellInfo_t
 	{
 		unique_pidl_absolute	pidlComplete;
 		unique_pidl_child	pridl;
-		WIN32_FIND_DATA	wfd;
-		TCHAR			szDisplayName[MAX_PATH];
-		int				iIcon;
 
 		/* These are only used for drives. They are
 		needed for when a drive is removed from the
@@ -203,15 +215,138 @@ private:
 		/* Used for temporary sorting in details mode (i.e.
 		when items need to be rearranged). */
 		int				iRelativeSort;
+
+		/* Whether or not the item is currently in the
+		listview (items that have been filtered out, or
+		that are still waiting to be inserted, aren't). */
+		bool			bInListView;
+
+		/* An immutable copy of the item's basic information,
+		which is shared with any background tasks for the item
+		(rather than each task being given its own copy).
+		Replaced whenever the item changes. */
+		std::shared_ptr<const BasicItemInfo_t>	snapshot;
+	};
+
+	/* File system information for an item. This is
+	retrieved separately from the shell information,
+	since it can be retrieved on a background thread. */
+	struct ItemFileInfo_t
+	{
+		WIN32_FIND_DATA	wfd;
+		BOOL			bDrive;
+		TCHAR			szDrive[4];
+	};
+
+	/* An item read by the background enumeration. */
+	struct EnumeratedItem_t
+	{
+		unique_pidl_child	pidlChild;
+		std::wstring		displayName;
+		ItemFileInfo_t		fileInfo;
+	};
+
+	struct EnumerationBatch_t
+	{
+		std::vector<EnumeratedItem_t>	items;
+		bool	finished;
+	};
+
+	/* The state shared with a background enumeration. Each
+	enumeration has its own instance, so an enumeration that's
+	been cancelled can't interfere with the one that replaced
+	it. */
+	struct EnumerationState_t
+	{
+		unique_pidl_absolute	pidlDirectory;
+		std::atomic<bool>	cancelled = false;
+
+		std::mutex			mutex;
+		std::condition_variable	batchAvailable;
+		std::list<EnumerationBatch_t>	batches;
+
+		/* Set (before the final batch is published) if the
+		folder couldn't be enumerated. */
+		HRESULT				result = S_OK;
+	};
+
+	/* An item in the listview, along with its sort key. Kept in
+	listview order while a folder is being enumerated. */
+	struct SortedItem_t
+	{
+		int		internalIndex;
+		SortKey	sortKey;
+	};
+
+	/* The state of a folder that's been navigated away from.
+	Going back (or forward) to the folder restores this
+	state, rather than reading the folder in again. The
+	folder is then checked for changes in the background. */
+	struct ListingSnapshot_t
+	{
+		unique_pidl_absolute	pidlDirectory;
+
+		/* The settings in effect when the folder was left.
+		The saved row order is only reused if the sorting
+		settings still match. */
+		FolderSettings		folderSettings;
+
+		ItemStore			itemStore;
+		std::vector<ItemShellInfo_t>	itemShellInfo;
+		std::shared_ptr<SnapshotArena<BasicItemInfo_t>>	itemSnapshotArena;
+
+		/* The internal indices of the items in the listview,
+		in the order they were shown. */
+		std::vector<int>	rows;
+		std::vector<int>	selectedItems;
+		int					focusedItem;
+		int					topItem;
 	};
 
-	struct AlteredFile_t
+	/* Information held for an item in an owner-data listview.
+	The listview doesn't store anything for its items, so what
+	would normally be set on an item is kept here instead. */
+	struct VirtualItemInfo_t
 	{
-		TCHAR	szFileName[MAX_PATH];
-		DWORD	dwAction;
-		int		iFolderIndex;
+		int		iImage = I_IMAGECALLBACK;
+
+		/* Only the bits in the callback mask are held. */
+		UINT	state = 0;
+
+		/* Indexed by subitem. The item name (subitem 0) is
+		always taken from the item store. */
+		std::unordered_map<int, std::wstring>	subItemText;
 	};
 
+	/* The state of an owner-data listview (see
+	VirtualListView.cpp). */
+	struct VirtualListState_t
+	{
+		/* Holds every item in the folder (other than those
+		still waiting to be inserted), in sorted order. The
+		filter determines which of them are shown. */
+		VirtualItemList		items;
+		VirtualItemList::Filter	filter;
+
+		/* Sort keys are kept once built, so that items can
+		be merged in without rebuilding the keys for the
+		items already shown. */
+		std::unordered_map<int, SortKey>	sortKeys;
+
+		std::unordered_map<int, VirtualItemInfo_t>	itemInfo;
+
+		/* Items that need to be moved to their new sorted
+		position (e.g. because they've been renamed). */
+		std::vector<int>	updatedItems;
+
+		/* Set while the listview selection is being brought
+		into line with the model, so that the resulting
+		notifications can be ignored. */
+		bool	applyingSelection = false;
+	};
+
+	class ShellEnumerationSource;
+
 	struct AwaitingAdd_t
 	{
 		int		iItem;
@@ -237,17 +372,53 @@ private:
 		TCHAR szFileName[MAX_PATH];
 	};
 
+	/* Identifies the version of a file that a column
+	value was retrieved for. */
+	struct ColumnCacheKey_t
+	{
+		std::wstring path;
+		ULONGLONG fileSize;
+		ULONGLONG lastWriteTime;
+	};
+
 	struct ColumnResult_t
 	{
+		/* The value of m_columnResultGeneration when the
+		task was queued. Results from earlier generations
+		are discarded. */
+		int generation;
 		int itemInternalIndex;
 		int columnID;
 		std::wstring columnText;
+
+		/* Only set if the text can be stored in the
+		column cache. */
+		boost::optional<ColumnCacheKey_t> cacheKey;
 	};
 
 	struct ThumbnailResult_t
 	{
+		int thumbnailResultId;
 		int itemInternalIndex;
-		wil::unique_hbitmap bitmap;
+
+		/* The thumbnail size in effect when the task was
+		queued. Results for any other size are discarded. */
+		int thumbnailSize;
+
+		/* Premultiplied 32-bit pixels, top-down, the full
+		size of a thumbnail item. The thumbnail is
+		centered, with transparent pixels around it. Empty
+		if no thumbnail was found. */
+		std::vector<uint32_t> pixels;
+	};
+
+	struct ThumbnailTask_t
+	{
+		int itemInternalIndex;
+
+		/* Set if the item has scrolled far enough away
+		that the task is no longer needed. */
+		std::shared_ptr<std::atomic<bool>> cancelled;
 	};
 
 	struct InfoTipResult
@@ -268,24 +439,67 @@ private:
 
 	static const UINT_PTR LISTVIEW_SUBCLASS_ID = 0;
 
-	static const UINT WM_APP_COLUMN_RESULT_READY = WM_APP + 150;
-	static const UINT WM_APP_THUMBNAIL_RESULT_READY = WM_APP + 151;
-	static const UINT WM_APP_INFO_TIP_READY = WM_APP + 152;
+	/* The item state that an owner-data listview asks for
+	(rather than storing). */
+	static const UINT VIRTUAL_LIST_VIEW_CALLBACK_MASK = LVIS_OVERLAYMASK | LVIS_CUT;
 
-	static const int THUMBNAIL_ITEM_WIDTH = 120;
-	static const int THUMBNAIL_ITEM_HEIGHT = 120;
+	static const UINT WM_APP_COLUMN_RESULTS_READY = WM_APP + 150;
+	static const UINT WM_APP_THUMBNAIL_RESULTS_READY = WM_APP + 151;
+	static const UINT WM_APP_INFO_TIP_READY = WM_APP + 152;
+	static const UINT WM_APP_ENUMERATION_BATCH_READY = WM_APP + 153;
+	static const UINT WM_APP_REVALIDATION_READY = WM_APP + 154;
+
+	/* Set to fire at midnight when items are grouped by
+	date, so that they can be moved into their new groups.
+	The listview uses small timer ids internally. */
+	static const UINT_PTR DATE_GROUPS_TIMER_ID = 0x4000;
+
+	/* The number of thumbnail tasks that can be in flight
+	for each thread in the executor. Having more than one
+	means the workers are kept busy while results are
+	being processed. */
+	static const int THUMBNAIL_TASKS_PER_THREAD = 2;
+
+	/* The maximum number of thumbnails added to the
+	image list in one go. */
+	static const size_t MAX_THUMBNAIL_RESULT_BATCH_SIZE = 64;
+
+	/* The maximum number of distinct items that will be
+	tracked in a single batch of directory changes. Beyond
+	this, the directory is simply rescanned. */
+	static const size_t MAX_CHANGE_JOURNAL_ENTRIES = 5000;
+
+	/* Limits on the snapshots kept for the folders in this
+	tab's history. The size of a snapshot is an estimate of
+	the memory it holds. */
+	static const size_t MAX_LISTING_SNAPSHOTS = 8;
+	static const size_t LISTING_SNAPSHOT_BUDGET = 32 * 1024 * 1024;
+
+	/* How long navigation will wait for the first screenful of
+	items before showing the folder. Whatever hasn't arrived by
+	then is merged in once it does. The enumeration publishes
+	its first batch after half of this time, which leaves the
+	rest for binding to the folder and for any read that's in
+	progress at that point. */
+	static constexpr std::chrono::milliseconds ENUMERATION_FIRST_BATCH_TIMEOUT{ 250 };
+
+	/* The maximum amount of time spent applying column
+	results in a single go. Anything left over is applied
+	once other pending messages (e.g. input and painting)
+	have been handled. */
+	static constexpr std::chrono::milliseconds COLUMN_RESULT_TIME_SLICE{ 10 };
 
 	ShellBrowser(int id, HINSTANCE resourceInstance, HWND hOwner, CachedIcons *cachedIcons,
-		const Config *config, TabNavigationInterface *tabNavigation,
+		ColumnCache *columnCache, ThumbnailCache *thumbnailCache, const ColorRuleSet *colorRuleSet, const Config *config, TabNavigationInterface *tabNavigation,
 		const std::vector<std::unique_ptr<PreservedHistoryEntry>> &history, int currentEntry,
 		const PreservedFolderState &preservedFolderState);
 	ShellBrowser(int id, HINSTANCE resourceInstance, HWND hOwner, CachedIcons *cachedIcons,
-		const Config *config, TabNavigationInterface *tabNavigation, const FolderSettings &folderSettings,
+		ColumnCache *columnCache, ThumbnailCache *thumbnailCache, const ColorRuleSet *colorRuleSet, const Config *config, TabNavigationInterface *tabNavigation,
+		const FolderSettings &folderSettings,
 		boost::optional<FolderColumns> initialColumns);
 	~ShellBrowser();
 
 	HWND				SetUpListView(HWND parent);
-	int					GenerateUniqueItemId();
 	BOOL				GhostItemInternal(int iItem,BOOL bGhost);
 	void				DetermineFolderVirtual(PCIDLIST_ABSOLUTE pidlDirectory);
 	void				VerifySortMode();
@@ -294,14 +508,32 @@ private:
 	HRESULT				BrowseFolder(PCIDLIST_ABSOLUTE pidlDirectory, bool addHistoryEntry = true);
 
 	/* Browsing support. */
-	HRESULT				EnumerateFolder(PCIDLIST_ABSOLUTE pidlDirectory);
+	void				StartEnumeration(PCIDLIST_ABSOLUTE pidlDirectory);
+	static void			EnumerateFolderAsync(HWND listView, HWND owner, SHCONTF enumFlags, bool virtualFolder, std::shared_ptr<EnumerationState_t> state);
+	void				CancelEnumeration();
+	bool				TakeEnumeratedItems(std::vector<EnumeratedItem_t> &items, std::chrono::milliseconds timeout);
+	void				ProcessEnumerationBatches();
+	void				AddEnumeratedItems(std::vector<EnumeratedItem_t> &items);
+	void				MergeEnumeratedItems(std::vector<EnumeratedItem_t> &items);
+	void				FinishEnumeration();
 	void				ClearPendingResults();
 	void				ResetFolderState();
+
+	/* Listing snapshots. */
+	void				SaveListingSnapshot();
+	boost::optional<ListingSnapshot_t>	TakeListingSnapshot(int historyEntryId, PCIDLIST_ABSOLUTE pidlDirectory);
+	bool				RestoreListingSnapshot(ListingSnapshot_t &snapshot);
+	void				RestoreListingViewState(const ListingSnapshot_t &snapshot);
+	size_t				GetListingSnapshotSize(const ListingSnapshot_t &snapshot) const;
+	void				QueueRevalidation();
+	void				ProcessRevalidationResult(int folderId);
 	void				InsertAwaitingItems(BOOL bInsertIntoGroup);
-	BOOL				IsFileFiltered(const ItemInfo_t &itemInfo) const;
+	BOOL				IsFileFiltered(int internalIndex);
 	HRESULT				AddItemInternal(PCIDLIST_ABSOLUTE pidlDirectory, PCITEMID_CHILD pidlChild, const TCHAR *szFileName, int iItemIndex, BOOL bPosition);
 	HRESULT				AddItemInternal(int iItemIndex,int iItemId,BOOL bPosition);
 	int					SetItemInformation(PCIDLIST_ABSOLUTE pidlDirectory, PCITEMID_CHILD pidlChild, const TCHAR *szFileName);
+	static ItemFileInfo_t	GetItemFileInfo(PCIDLIST_ABSOLUTE pidlDirectory, PCITEMID_CHILD pidlChild, const TCHAR *szFileName);
+	int					AddItemToStore(PCIDLIST_ABSOLUTE pidlDirectory, PCITEMID_CHILD pidlChild, const TCHAR *szFileName, const ItemFileInfo_t &fileInfo);
 	void				SetViewModeInternal(ViewMode viewMode);
 	void				ApplyFolderEmptyBackgroundImage(bool apply);
 	void				ApplyFilteringBackgroundImage(bool apply);
@@ -313,7 +545,7 @@ private:
 	static LRESULT CALLBACK	ListViewParentProcStub(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam, UINT_PTR uIdSubclass, DWORD_PTR dwRefData);
 	LRESULT CALLBACK	ListViewParentProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
-	static int CALLBACK	SortStub(LPARAM lParam1, LPARAM lParam2, LPARAM lParamSort);
+	static int CALLBACK	SortedPositionStub(LPARAM lParam1, LPARAM lParam2, LPARAM lParamSort);
 
 	/* Message handlers. */
 	void				ColumnClicked(int iClickedColumn);
@@ -332,23 +564,35 @@ private:
 	void				OnListViewHeaderRightClick(const POINTS &cursorPos);
 	void				OnListViewHeaderMenuItemSelected(int menuItemId, const std::unordered_map<int, UINT> &menuItemMappings);
 
-	ItemInfo_t			&GetItemByIndex(int index);
 	int					GetItemInternalIndex(int item) const;
 
-	BasicItemInfo_t		getBasicItemInfo(int internalIndex) const;
+	const BasicItemInfo_t	&getBasicItemInfo(int internalIndex) const;
+	std::shared_ptr<const BasicItemInfo_t>	GetItemSnapshot(int internalIndex) const;
+	void				UpdateItemSnapshot(int internalIndex);
+	WIN32_FIND_DATA		GetItemFindData(int internalIndex) const;
+	static ItemStore::FileData	FindDataToFileData(const WIN32_FIND_DATA &wfd);
 
 	/* Sorting. */
+	void				SortItems();
+	std::vector<SortKey>	BuildSortKeys(const std::vector<int> &internalIndices);
 	int CALLBACK		Sort(int InternalIndex1,int InternalIndex2) const;
+	int					CompareItems(int internalIndex1, const SortKey &sortKey1,
+		int internalIndex2, const SortKey &sortKey2, bool foldersFirst) const;
+	SortKey				GetSortKey(int internalIndex) const;
+	SortKey				GetSortKeyForSortMode(const BasicItemInfo_t &basicItemInfo) const;
 
 	/* Listview column support. */
 	void				PlaceColumns();
 	void				QueueColumnTask(int itemInternalIndex, int columnIndex);
-	static ColumnResult_t	GetColumnTextAsync(HWND listView, int columnResultId, unsigned int ColumnID, int InternalIndex, const BasicItemInfo_t &basicItemInfo, const GlobalFolderSettings &globalFolderSettings);
+	boost::optional<std::wstring>	GetCachedColumnText(int itemInternalIndex, int columnIndex);
+	bool				CanCacheColumnText(unsigned int columnId) const;
+	static boost::optional<ColumnCacheKey_t>	GetColumnCacheKey(PCIDLIST_ABSOLUTE pidl, const WIN32_FIND_DATA &wfd);
+	static ColumnResult_t	GetColumnTextAsync(unsigned int ColumnID, int InternalIndex, const BasicItemInfo_t &basicItemInfo, const GlobalFolderSettings &globalFolderSettings);
 	void				InsertColumn(unsigned int ColumnId,int iColumndIndex,int iWidth);
 	void				SetActiveColumnSet();
 	void				GetColumnInternal(unsigned int id,Column_t *pci) const;
 	void				SaveColumnWidths();
-	void				ProcessColumnResult(int columnResultId);
+	void				ProcessColumnResults();
 	boost::optional<int>	GetColumnIndexById(unsigned int id) const;
 	boost::optional<unsigned int>	GetColumnIdByIndex(int index) const;
 
@@ -359,27 +603,45 @@ private:
 	/* Directory altered support. */
 	void				OnFileActionAdded(const TCHAR *szFileName);
 	void				RemoveItem(int iItemInternal);
-	void				RemoveItemInternal(const TCHAR *szFileName);
+	void				RemoveItems(const std::vector<int> &internalIndices);
 	void				ModifyItemInternal(const TCHAR *FileName);
-	void				OnFileActionRenamedOldName(const TCHAR *szFileName);
-	void				OnFileActionRenamedNewName(const TCHAR *szFileName);
+	bool				RemovePendingFileAddition(const TCHAR *szFileName);
+	void				ApplyDirectoryChanges(const ChangeJournal::Changes &changes);
+	void				SelectPendingFiles();
+	std::vector<ChangeJournal::ListingEntry>	GetItemStoreListing() const;
+	static boost::optional<std::vector<ChangeJournal::ListingEntry>>	ListDirectory(const std::wstring &directory, bool showHidden);
+	void				ApplyListingChanges(ChangeJournal::Changes changes);
 	void				RenameItem(int iItemInternal, const TCHAR *szNewFileName);
+	std::wstring		GetFolderSizeItemPath(int internalIndex) const;
+	void				NotifyFolderSizeItemAdded(int internalIndex);
+	void				NotifyFolderSizeItemRemoved(int internalIndex);
+	void				NotifyFolderSizeItemModified(int internalIndex, uint64_t oldSize);
+	void				NotifyFolderSizeItemRenamed(int internalIndex, const std::wstring &oldFileName);
 	int					DetermineItemSortedPosition(LPARAM lParam) const;
 
+	/* Color rule support. */
+	void				UpdateItemColorRule(int internalIndex);
+
 	/* Filtering support. */
-	BOOL				IsFilenameFiltered(const TCHAR *FileName) const;
-	void				RemoveFilteredItems(void);
+	void				RemoveFilteredItems(const std::vector<int> &internalIndices);
 	void				RemoveFilteredItem(int iItem,int iItemInternal);
+	void				InsertFilteredItems(const std::vector<int> &internalIndices);
 	void				UpdateFiltering(void);
-	void				UnfilterAllItems(void);
+	void				ApplyFilterChanges(const IncrementalFilter::Changes &changes);
 
 	/* Listview group support (real files). */
 	static INT CALLBACK	GroupNameComparisonStub(INT Group1_ID, INT Group2_ID, void *pvData);
 	INT CALLBACK		GroupNameComparison(INT Group1_ID, INT Group2_ID);
 	static INT CALLBACK	GroupFreeSpaceComparisonStub(INT Group1_ID, INT Group2_ID, void *pvData);
 	INT CALLBACK		GroupFreeSpaceComparison(INT Group1_ID, INT Group2_ID);
-	std::wstring		RetrieveGroupHeader(int groupId);
-	int					DetermineItemGroup(int iItemInternal);
+	PFNLVGROUPCOMPARE	GetGroupComparison() const;
+	std::vector<std::wstring>	DetermineItemGroups(const std::vector<int> &internalIndices);
+	std::vector<std::wstring>	DetermineItemDateGroups(const std::vector<int> &internalIndices, GroupByDateType dateType);
+	static boost::optional<GroupByDateType>	GetGroupByDateType(SortMode sortMode);
+	void				UpdateDateBuckets();
+	void				BuildDateBuckets();
+	void				OnDateGroupsTimer();
+	std::wstring		DetermineItemGroup(int iItemInternal) const;
 	std::wstring		DetermineItemNameGroup(const BasicItemInfo_t &itemInfo) const;
 	std::wstring		DetermineItemSizeGroup(const BasicItemInfo_t &itemInfo) const;
 	std::wstring		DetermineItemTotalSizeGroup(const BasicItemInfo_t &itemInfo) const;
@@ -397,25 +659,39 @@ private:
 	std::wstring		DetermineItemNetworkStatus(const BasicItemInfo_t &itemInfo) const;
 
 	/* Other grouping support. */
-	int					CheckGroup(std::wstring_view groupHeader, PFNLVGROUPCOMPARE groupComparison);
+	int					AddItemToGroup(std::wstring_view groupHeader);
+	void				RemoveItemFromGroup(int iItem);
+	void				UpdateGroupHeaders();
 	void				InsertItemIntoGroup(int iItem,int iGroupId);
 	void				MoveItemsIntoGroups(void);
 
 	/* Listview icons. */
 	void				ProcessIconResult(int internalIndex, int iconIndex);
-	boost::optional<int>	GetCachedIconIndex(const ItemInfo_t &itemInfo);
+	boost::optional<int>	GetCachedIconIndex(int internalIndex);
 
 	/* Thumbnails view. */
-	void				QueueThumbnailTask(int internalIndex);
-	static boost::optional<ThumbnailResult_t>	FindThumbnailAsync(HWND listView, int thumbnailResultId, int internalIndex, const BasicItemInfo_t &basicItemInfo);
-	void				ProcessThumbnailResult(int thumbnailResultId);
+	static ThumbnailScheduler::Options	GetThumbnailSchedulerOptions();
+	void				RefreshThumbnailItems();
+	void				UpdateThumbnailViewport();
+	void				QueueThumbnailTasks();
+	void				QueueThumbnailTask(int internalIndex, TaskPriority priority);
+	static std::vector<uint32_t>	FindThumbnailAsync(const BasicItemInfo_t &basicItemInfo, ThumbnailCache *thumbnailCache, int thumbnailSize, const std::atomic<bool> &cancelled);
+	static wil::unique_hbitmap	ExtractThumbnail(const BasicItemInfo_t &basicItemInfo, int thumbnailSize);
+	static boost::optional<ThumbnailCacheKey>	GetThumbnailCacheKey(const BasicItemInfo_t &basicItemInfo);
+	static wil::unique_hbitmap	CreateThumbnailBitmap(int thumbnailSize, int numThumbnails, uint32_t **pixels);
+	static bool			CompositeThumbnail(HBITMAP thumbnailBitmap, int thumbnailSize, CachedThumbnail &thumbnail);
+	bool				CanCacheThumbnail(const BasicItemInfo_t &basicItemInfo) const;
+	void				ProcessThumbnailResults();
+	void				AddThumbnailsToImageList(const std::vector<ThumbnailResult_t> &results);
+	void				SetItemImage(int index, int imageIndex);
 	void				SetupThumbnailsView(void);
+	void				CreateThumbnailImageList();
+	static size_t		GetMaxResidentThumbnails(const Config *config);
+	void				ResetThumbnailResidency();
+	void				EvictThumbnail(int internalIndex);
 	void				RemoveThumbnailsView(void);
-	int					GetIconThumbnail(int iInternalIndex) const;
-	int					GetExtractedThumbnail(HBITMAP hThumbnailBitmap) const;
-	int					GetThumbnailInternal(int iType, int iInternalIndex, HBITMAP hThumbnailBitmap) const;
-	void				DrawIconThumbnailInternal(HDC hdcBacking, int iInternalIndex) const;
-	void				DrawThumbnailInternal(HDC hdcBacking, HBITMAP hThumbnailBitmap) const;
+	int					GetIconThumbnail(int internalIndex);
+	int					DrawIconThumbnail(int iconIndex);
 
 	/* Tiles view. */
 	void				InsertTileViewColumns();
@@ -436,6 +712,30 @@ private:
 	BOOL				CompareVirtualFolders(UINT uFolderCSIDL) const;
 	int					LocateFileItemInternalIndex(const TCHAR *szFileName) const;
 	boost::optional<int>	LocateItemByInternalIndex(int internalIndex) const;
+	void				RebuildRowIndex();
+
+	/* Owner-data listview support. */
+	boost::optional<LRESULT>	HandleVirtualListViewMessage(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+	LRESULT				SetVirtualItemState(HWND hwnd, int iItem, const LVITEM &lvItem);
+	void				SetVirtualItemText(int iItem, int iSubItem, const TCHAR *text);
+	void				OnVirtualListViewGetDisplayInfo(NMLVDISPINFO *dispInfo);
+	void				OnVirtualListViewCacheHint(const NMLVCACHEHINT *cacheHint);
+	void				OnVirtualListViewItemChanged(const NMLISTVIEW *changeData);
+	void				OnVirtualListViewStateChanged(const NMLVODSTATECHANGE *stateChange);
+	int					OnVirtualListViewFindItem(const NMLVFINDITEM *findItem);
+	void				SetVirtualRowSelected(int iItem, bool selected);
+	void				ClearVirtualItems();
+	void				InsertVirtualItems();
+	void				RemoveVirtualItems(const std::vector<int> &internalIndices);
+	void				HideVirtualItems(const std::vector<int> &internalIndices);
+	void				ShowVirtualItems(const std::vector<int> &internalIndices);
+	void				SortVirtualItems();
+	const SortKey		&GetVirtualSortKey(int internalIndex);
+	void				UpdateVirtualItem(int internalIndex);
+	void				FlushVirtualItemChanges();
+	int					GetVirtualFocusedItem() const;
+	void				UpdateVirtualListView(int focusedItem);
+
 	void				ApplyHeaderSortArrow();
 	void				QueryFullItemNameInternal(int iItemInternal,TCHAR *szFullFileName,UINT cchMax) const;
 
@@ -463,27 +763,100 @@ private:
 
 	DirectoryState		m_directoryState;
 
-	/* Stores various extra information on files, such
-	as display name. */
-	std::unordered_map<int, ItemInfo_t>	m_itemInfoMap;
-
-	ctpl::thread_pool	m_columnThreadPool;
-	std::unordered_map<int, std::future<ColumnResult_t>> m_columnResults;
-	int					m_columnResultIDCounter;
+	/* Stores the file system information for each item
+	in the current folder. The internal index of an item
+	is its ID within the store. */
+	ItemStore			m_itemStore;
+
+	/* Shell information for each item, indexed by
+	internal index. */
+	std::vector<ItemShellInfo_t>	m_itemShellInfo;
+
+	/* The item snapshots for the current folder are allocated
+	from this arena. A new arena is created each time the folder
+	changes, with the previous one being freed once any tasks
+	still holding its snapshots have finished. */
+	std::shared_ptr<SnapshotArena<BasicItemInfo_t>>	m_itemSnapshotArena;
+
+	/* Background work is run on the shared executor.
+	Each type of work has its own group, so that it can
+	be cancelled independently. */
+	TaskGroup			m_columnTasks;
+
+	/* Completed column results are queued here and
+	applied in batches. A single message is posted
+	whenever the queue goes from being drained to having
+	results in it. */
+	MpscQueue<ColumnResult_t>	m_columnResults;
+	std::atomic<bool>	m_columnResultsPending;
+	int					m_columnResultGeneration;
+
+	/* Shared between tabs and persisted across
+	sessions. */
+	ColumnCache			*m_columnCache;
 
 	std::unique_ptr<IconFetcher> m_iconFetcher;
 	CachedIcons			*m_cachedIcons;
 
-	ctpl::thread_pool	m_thumbnailThreadPool;
-	std::unordered_map<int, std::future<boost::optional<ThumbnailResult_t>>> m_thumbnailResults;
+	/* Decides which thumbnails are retrieved next, based
+	on which items are visible. Only a limited number of
+	thumbnail tasks are queued at once. */
+	ThumbnailScheduler	m_thumbnailScheduler;
+	TaskGroup			m_thumbnailTasks;
+	std::unordered_map<int, ThumbnailTask_t> m_thumbnailTasksInFlight;
 	int					m_thumbnailResultIDCounter;
-
-	ctpl::thread_pool	m_infoTipsThreadPool;
+	MpscQueue<ThumbnailResult_t> m_thumbnailResults;
+	std::atomic<bool>	m_thumbnailResultsPending;
+
+	/* Maps each system image list icon index to the
+	thumbnails image list entry that shows that icon. Used
+	for items whose thumbnail hasn't been found yet. */
+	std::unordered_map<int, int> m_iconThumbnailImages;
+
+	/* The size of the images in the current thumbnails
+	image list. */
+	int					m_thumbnailSize;
+
+	/* Limits the number of thumbnails held in the image list.
+	Each residency slot maps to an image in the image list
+	(or -1, if the image couldn't be added), so that the
+	images of evicted items can be replaced, rather than the
+	image list growing. */
+	ThumbnailResidency	m_thumbnailResidency;
+	std::vector<int>	m_thumbnailSlotImages;
+
+	/* Shared between tabs and persisted across
+	sessions. */
+	ThumbnailCache		*m_thumbnailCache;
+
+	/* Shared between tabs. The rule that applies to each
+	item is stored in the item store. */
+	const ColorRuleSet	*m_colorRuleSet;
+
+	TaskGroup			m_infoTipTasks;
 	std::unordered_map<int, std::future<boost::optional<InfoTipResult>>> m_infoTipResults;
 	int					m_infoTipResultIDCounter;
 
-	/* Cached folder size data. */
-	mutable std::unordered_map<int, ULONGLONG>	m_cachedFolderSizes;
+	/* Folders are enumerated in the background. The
+	enumeration state is only set while an enumeration
+	is in progress. */
+	TaskGroup			m_enumerationTasks;
+	std::shared_ptr<EnumerationState_t>	m_enumerationState;
+	std::vector<SortedItem_t>	m_enumerationSortedItems;
+
+	/* Snapshots of recently visited folders, keyed by the
+	ID of the history entry the folder was visited through.
+	m_currentHistoryEntryId is the ID of the entry for the
+	folder that's currently shown (or -1, if no folder has
+	been shown yet). */
+	HistorySnapshotCache<ListingSnapshot_t>	m_listingSnapshots;
+	int					m_currentHistoryEntryId;
+
+	/* A folder restored from a snapshot is listed again in
+	the background and compared with the snapshot. Only the
+	differences are then applied. */
+	TaskGroup			m_revalidationTasks;
+	std::future<boost::optional<ChangeJournal::Changes>>	m_revalidationResult;
 
 	/* Internal state. */
 	const HINSTANCE		m_hResourceModule;
@@ -514,9 +887,13 @@ private:
 
 	/* Stores information on files that
 	have been modified (i.e. created, deleted,
-	renamed, etc). */
+	renamed, etc). Notifications are coalesced
+	until the next update. m_changeJournalFolderId
+	is the unique folder ID the notifications
+	were received for. */
 	CRITICAL_SECTION	m_csDirectoryAltered;
-	std::list<AlteredFile_t>	m_AlteredList;
+	ChangeJournal		m_changeJournal;
+	int					m_changeJournalFolderId;
 	std::list<Added_t>	m_FilesAdded;
 
 	/* Stores information on files that have
@@ -560,13 +937,34 @@ private:
 	int					m_bOverFolder;
 	int					m_iDropFolder;
 
-	/* Listview groups. The group id is declared
-	explicitly, rather than taken from the size
-	of the group list, to avoid warnings concerning
-	size_t and int. */
-	std::list<TypeGroup_t>	m_GroupList;
-	int					m_iGroupId;
-
-	/* Filtering related data. */
-	std::list<int>		m_FilteredItemsList;
+	/* Listview groups. Header updates (which include the
+	number of items in each group) are deferred until a
+	batch of items has been added or removed. */
+	GroupIndex			m_groupIndex;
+
+	/* Indexed by group id. Built once, when the group is
+	created, so that sorting the groups doesn't need to
+	repeatedly compare the header text. */
+	std::vector<CollationKey>	m_groupHeaderKeys;
+
+	/* Used when grouping by date. Rebuilt once the
+	day they were built for has ended. */
+	boost::optional<DateBuckets>	m_dateBuckets;
+	std::array<std::wstring, DateBuckets::NUM_BUCKETS>	m_dateGroupHeaders;
+
+	/* Tracks which items pass the filter from the folder
+	settings. An item is visible here exactly when it's in
+	the listview (hidden system files aren't tracked at all). */
+	IncrementalFilter	m_itemFilter;
+
+	/* Maps between internal indexes and listview rows.
+	Updated whenever items are inserted into, removed from
+	or rearranged within the listview, so that an item can
+	be located without searching the listview. */
+	RowIndex			m_rowIndex;
+
+	/* Only set if the listview was created with
+	LVS_OWNERDATA (see Config::virtualListView). In that
+	case, the row index isn't used. */
+	std::unique_ptr<VirtualListState_t>	m_virtualList;
 };
\ No newline at end of file
@@ -4,118 +4,145 @@
 
 #include "stdafx.h"
 #include "SortHelper.h"
+#include "../Helper/FolderSizeService.h"
 #include <wil/common.h>
 #include <propvarutil.h>
 
-int SortByName(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, const GlobalFolderSettings &globalFolderSettings)
+namespace
 {
-	if (itemInfo1.isRoot && !itemInfo2.isRoot)
+	SortKey BuildTextSortKey(const std::wstring &text)
 	{
-		return -1;
+		SortKey key;
+		key.type = SortKey::Type::Text;
+		key.text = BuildCollationKey(text);
+		return key;
 	}
-	else if (!itemInfo1.isRoot && itemInfo2.isRoot)
+
+	SortKey BuildNumberSortKey(ULONGLONG number)
 	{
-		return 1;
+		SortKey key;
+		key.type = SortKey::Type::Number;
+		key.number = number;
+		return key;
 	}
-	else if (itemInfo1.isRoot && itemInfo2.isRoot)
+
+	ULONGLONG FileTimeToNumber(const FILETIME &fileTime)
 	{
-		/* If the items been compared are both drives,
-		sort by drive letter, rather than display name. */
-		return StrCmpLogicalW(itemInfo1.getFullPath().c_str(), itemInfo2.getFullPath().c_str());
+		ULARGE_INTEGER number = { fileTime.dwLowDateTime, fileTime.dwHighDateTime };
+		return number.QuadPart;
 	}
-
-	std::wstring Name1 = GetNameColumnText(itemInfo1, globalFolderSettings);
-	std::wstring Name2 = GetNameColumnText(itemInfo2, globalFolderSettings);
-
-	return StrCmpLogicalW(Name1.c_str(), Name2.c_str());
 }
 
-int SortBySize(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
+int CompareSortKeys(const SortKey &key1, const SortKey &key2)
 {
-	bool IsFolder1 = WI_IsFlagSet(itemInfo1.wfd.dwFileAttributes, FILE_ATTRIBUTE_DIRECTORY);
-	bool IsFolder2 = WI_IsFlagSet(itemInfo2.wfd.dwFileAttributes, FILE_ATTRIBUTE_DIRECTORY);
-
-	ULONGLONG size1;
-	ULONGLONG size2;
-
-	if (IsFolder1 && IsFolder2)
+	if (key1.rank != key2.rank)
 	{
-		// Temporarily disabled.
-		/*auto itr1 = m_cachedFolderSizes.find(InternalIndex1);
-		auto itr2 = m_cachedFolderSizes.find(InternalIndex2);
+		return (key1.rank < key2.rank) ? -1 : 1;
+	}
 
-		if (itr1 == m_cachedFolderSizes.end() && itr2 == m_cachedFolderSizes.end())
+	if (key1.type != key2.type)
+	{
+		/* Items whose value couldn't be retrieved
+		sort first. */
+		if (key1.type == SortKey::Type::None)
+		{
+			return -1;
+		}
+		else if (key2.type == SortKey::Type::None)
 		{
-			return 0;
+			return 1;
 		}
-		else if (itr1 != m_cachedFolderSizes.end() && itr2 == m_cachedFolderSizes.end())
+
+		return 0;
+	}
+
+	switch (key1.type)
+	{
+	case SortKey::Type::Text:
+		return CompareCollationKeys(key1.text, key2.text);
+
+	case SortKey::Type::Number:
+		if (key1.number > key2.number)
 		{
 			return 1;
 		}
-		else if (itr1 == m_cachedFolderSizes.end() && itr2 != m_cachedFolderSizes.end())
+		else if (key1.number < key2.number)
 		{
 			return -1;
 		}
+		break;
 
-		size1 = itr1->second;
-		size2 = itr2->second;*/
+	case SortKey::Type::Variant:
+		if (key1.variant.vt == key2.variant.vt && key1.variant.vt != VT_EMPTY)
+		{
+			return VariantCompare(key1.variant, key2.variant);
+		}
+		break;
 
-		size1 = 0;
-		size2 = 0;
+	case SortKey::Type::None:
+		break;
 	}
-	else
-	{
-		// Both items are files (as opposed to folders).
-		ULARGE_INTEGER FileSize1 = { itemInfo1.wfd.nFileSizeLow, itemInfo1.wfd.nFileSizeHigh };
-		ULARGE_INTEGER FileSize2 = { itemInfo2.wfd.nFileSizeLow, itemInfo2.wfd.nFileSizeHigh };
 
-		size1 = FileSize1.QuadPart;
-		size2 = FileSize2.QuadPart;
-	}
+	return 0;
+}
 
-	if (size1 > size2)
-	{
-		return 1;
-	}
-	else if (size1 < size2)
+SortKey GetNameSortKey(const BasicItemInfo_t &itemInfo, const GlobalFolderSettings &globalFolderSettings)
+{
+	/* If the items been compared are both drives,
+	sort by drive letter, rather than display name. */
+	if (itemInfo.isRoot)
 	{
-		return -1;
+		return BuildTextSortKey(itemInfo.getFullPath());
 	}
 
-	return 0;
+	SortKey key = BuildTextSortKey(GetNameColumnText(itemInfo, globalFolderSettings));
+	key.rank = 1;
+	return key;
 }
 
-int SortByType(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
+SortKey GetSizeSortKey(const BasicItemInfo_t &itemInfo)
 {
-	if (itemInfo1.isRoot && !itemInfo2.isRoot)
+	bool IsFolder = WI_IsFlagSet(itemInfo.wfd.dwFileAttributes, FILE_ATTRIBUTE_DIRECTORY);
+
+	if (IsFolder)
 	{
-		return -1;
+		// Folder sizes aren't calculated here, since that could take a
+		// long time. If the size has already been calculated (e.g. for
+		// the size column), that will be used.
+		auto totals = FolderSizeService::GetShared().GetCachedSize(itemInfo.getFullPath());
+		return BuildNumberSortKey(totals ? totals->size : 0);
 	}
-	else if (!itemInfo1.isRoot && itemInfo2.isRoot)
+
+	ULARGE_INTEGER FileSize = { itemInfo.wfd.nFileSizeLow, itemInfo.wfd.nFileSizeHigh };
+	return BuildNumberSortKey(FileSize.QuadPart);
+}
+
+SortKey GetTypeSortKey(const BasicItemInfo_t &itemInfo)
+{
+	SortKey key = BuildTextSortKey(GetTypeColumnText(itemInfo));
+
+	if (!itemInfo.isRoot)
 	{
-		return 1;
+		key.rank = 1;
 	}
 
-	std::wstring Type1 = GetTypeColumnText(itemInfo1);
-	std::wstring Type2 = GetTypeColumnText(itemInfo2);
-
-	return StrCmpLogicalW(Type1.c_str(), Type2.c_str());
+	return key;
 }
 
-int SortByDate(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, DateType_t DateType)
+SortKey GetDateSortKey(const BasicItemInfo_t &itemInfo, DateType_t DateType)
 {
 	switch (DateType)
 	{
 	case DATE_TYPE_CREATED:
-		return CompareFileTime(&itemInfo1.wfd.ftCreationTime, &itemInfo2.wfd.ftCreationTime);
+		return BuildNumberSortKey(FileTimeToNumber(itemInfo.wfd.ftCreationTime));
 		break;
 
 	case DATE_TYPE_MODIFIED:
-		return CompareFileTime(&itemInfo1.wfd.ftLastWriteTime, &itemInfo2.wfd.ftLastWriteTime);
+		return BuildNumberSortKey(FileTimeToNumber(itemInfo.wfd.ftLastWriteTime));
 		break;
 
 	case DATE_TYPE_ACCESSED:
-		return CompareFileTime(&itemInfo1.wfd.ftLastAccessTime, &itemInfo2.wfd.ftLastAccessTime);
+		return BuildNumberSortKey(FileTimeToNumber(itemInfo.wfd.ftLastAccessTime));
 		break;
 
 	default:
@@ -123,203 +150,121 @@ int SortByDate(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo
 		break;
 	}
 
-	return 0;
+	return SortKey();
 }
 
-int SortByTotalSize(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, bool TotalSize)
+SortKey GetTotalSizeSortKey(const BasicItemInfo_t &itemInfo, bool TotalSize)
 {
-	ULARGE_INTEGER DriveSpace1;
-	BOOL Res1 = GetDriveSpaceColumnRawData(itemInfo1, TotalSize, DriveSpace1);
-
-	ULARGE_INTEGER DriveSpace2;
-	BOOL Res2 = GetDriveSpaceColumnRawData(itemInfo2, TotalSize, DriveSpace2);
-
-	if (Res1 && !Res2)
-	{
-		return 1;
-	}
-	else if (!Res1 && Res2)
-	{
-		return -1;
-	}
-	else if (!Res1 && !Res2)
-	{
-		return 0;
-	}
+	ULARGE_INTEGER DriveSpace;
+	BOOL Res = GetDriveSpaceColumnRawData(itemInfo, TotalSize, DriveSpace);
 
-	if (DriveSpace1.QuadPart > DriveSpace2.QuadPart)
+	if (!Res)
 	{
-		return 1;
-	}
-	else if (DriveSpace1.QuadPart < DriveSpace2.QuadPart)
-	{
-		return -1;
+		return SortKey();
 	}
 
-	return 0;
+	return BuildNumberSortKey(DriveSpace.QuadPart);
 }
 
-int SortByAttributes(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
+SortKey GetAttributesSortKey(const BasicItemInfo_t &itemInfo)
 {
-	std::wstring AttributeString1 = GetAttributeColumnText(itemInfo1);
-	std::wstring AttributeString2 = GetAttributeColumnText(itemInfo2);
-
-	return StrCmpLogicalW(AttributeString1.c_str(), AttributeString2.c_str());
+	return BuildTextSortKey(GetAttributeColumnText(itemInfo));
 }
 
-int SortByRealSize(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
+SortKey GetRealSizeSortKey(const BasicItemInfo_t &itemInfo)
 {
-	ULARGE_INTEGER RealFileSize1;
-	bool Res1 = GetRealSizeColumnRawData(itemInfo1, RealFileSize1);
-
-	ULARGE_INTEGER RealFileSize2;
-	bool Res2 = GetRealSizeColumnRawData(itemInfo2, RealFileSize2);
-
-	if (Res1 && !Res2)
-	{
-		return 1;
-	}
-	else if (!Res1 && Res2)
-	{
-		return -1;
-	}
-	else if (!Res1 && !Res2)
-	{
-		return 0;
-	}
+	ULARGE_INTEGER RealFileSize;
+	bool Res = GetRealSizeColumnRawData(itemInfo, RealFileSize);
 
-	if (RealFileSize1.QuadPart > RealFileSize2.QuadPart)
-	{
-		return 1;
-	}
-	else if (RealFileSize1.QuadPart < RealFileSize2.QuadPart)
+	if (!Res)
 	{
-		return -1;
+		return SortKey();
 	}
 
-	return 0;
+	return BuildNumberSortKey(RealFileSize.QuadPart);
 }
 
-int SortByShortName(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
+SortKey GetShortNameSortKey(const BasicItemInfo_t &itemInfo)
 {
-	std::wstring ShortName1 = GetShortNameColumnText(itemInfo1);
-	std::wstring ShortName2 = GetShortNameColumnText(itemInfo2);
-
-	return StrCmpLogicalW(ShortName1.c_str(), ShortName2.c_str());
+	return BuildTextSortKey(GetShortNameColumnText(itemInfo));
 }
 
-int SortByOwner(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
+SortKey GetOwnerSortKey(const BasicItemInfo_t &itemInfo)
 {
-	std::wstring Owner1 = GetOwnerColumnText(itemInfo1);
-	std::wstring Owner2 = GetOwnerColumnText(itemInfo2);
-
-	return StrCmpLogicalW(Owner1.c_str(), Owner2.c_str());
+	return BuildTextSortKey(GetOwnerColumnText(itemInfo));
 }
 
-int SortByVersionInfo(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, VersionInfoType_t VersioninfoType)
+SortKey GetVersionInfoSortKey(const BasicItemInfo_t &itemInfo, VersionInfoType_t VersioninfoType)
 {
-	std::wstring VersionInfo1 = GetVersionColumnText(itemInfo1, VersioninfoType);
-	std::wstring VersionInfo2 = GetVersionColumnText(itemInfo2, VersioninfoType);
-
-	return StrCmpLogicalW(VersionInfo1.c_str(), VersionInfo2.c_str());
+	return BuildTextSortKey(GetVersionColumnText(itemInfo, VersioninfoType));
 }
 
-int SortByShortcutTo(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
+SortKey GetShortcutToSortKey(const BasicItemInfo_t &itemInfo)
 {
-	std::wstring ResolvedLinkPath1 = GetShortcutToColumnText(itemInfo1);
-	std::wstring ResolvedLinkPath2 = GetShortcutToColumnText(itemInfo2);
-
-	return StrCmpLogicalW(ResolvedLinkPath1.c_str(), ResolvedLinkPath2.c_str());
+	return BuildTextSortKey(GetShortcutToColumnText(itemInfo));
 }
 
-int SortByHardlinks(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
+SortKey GetHardlinksSortKey(const BasicItemInfo_t &itemInfo)
 {
-	DWORD NumHardLinks1 = GetHardLinksColumnRawData(itemInfo1);
-	DWORD NumHardLinks2 = GetHardLinksColumnRawData(itemInfo2);
+	DWORD NumHardLinks = GetHardLinksColumnRawData(itemInfo);
+
+	if (NumHardLinks == -1)
+	{
+		return SortKey();
+	}
 
-	return NumHardLinks1 - NumHardLinks2;
+	return BuildNumberSortKey(NumHardLinks);
 }
 
-int SortByExtension(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
+SortKey GetExtensionSortKey(const BasicItemInfo_t &itemInfo)
 {
-	std::wstring Extension1 = GetExtensionColumnText(itemInfo1);
-	std::wstring Extension2 = GetExtensionColumnText(itemInfo2);
-
-	return StrCmpLogicalW(Extension1.c_str(), Extension2.c_str());
+	return BuildTextSortKey(GetExtensionColumnText(itemInfo));
 }
 
-int SortByItemDetails(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, const SHCOLUMNID *pscid)
+SortKey GetItemDetailsSortKey(const BasicItemInfo_t &itemInfo, const SHCOLUMNID *pscid)
 {
-	VARIANT vt1;
-	HRESULT hr1 = GetItemDetailsRawData(itemInfo1, pscid, &vt1);
-
-	VARIANT vt2;
-	HRESULT hr2 = GetItemDetailsRawData(itemInfo2, pscid, &vt2);
-
-	int ret = 0;
+	SortKey key;
+	key.type = SortKey::Type::Variant;
 
-	if (SUCCEEDED(hr1) && SUCCEEDED(hr2) && vt1.vt == vt2.vt)
-	{
-		ret = VariantCompare(vt1, vt2);
-	}
+	/* If the details can't be retrieved, the variant
+	is left empty. Empty variants compare equal to
+	everything else. */
+	HRESULT hr = GetItemDetailsRawData(itemInfo, pscid, key.variant.reset_and_addressof());
 
-	if (SUCCEEDED(hr1))
+	if (FAILED(hr))
 	{
-		VariantClear(&vt1);
+		key.variant.reset();
 	}
 
-	if (SUCCEEDED(hr2))
-	{
-		VariantClear(&vt2);
-	}
-
-	return ret;
+	return key;
 }
 
-int SortByImageProperty(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, PROPID PropertyId)
+SortKey GetImagePropertySortKey(const BasicItemInfo_t &itemInfo, PROPID PropertyId)
 {
-	std::wstring ImageProperty1 = GetImageColumnText(itemInfo1, PropertyId);
-	std::wstring ImageProperty2 = GetImageColumnText(itemInfo2, PropertyId);
-
-	return StrCmpLogicalW(ImageProperty1.c_str(), ImageProperty2.c_str());
+	return BuildTextSortKey(GetImageColumnText(itemInfo, PropertyId));
 }
 
-int SortByVirtualComments(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
+SortKey GetVirtualCommentsSortKey(const BasicItemInfo_t &itemInfo)
 {
-	std::wstring Comments1 = GetControlPanelCommentsColumnText(itemInfo1);
-	std::wstring Comments2 = GetControlPanelCommentsColumnText(itemInfo2);
-
-	return StrCmpLogicalW(Comments1.c_str(), Comments2.c_str());
+	return BuildTextSortKey(GetControlPanelCommentsColumnText(itemInfo));
 }
 
-int SortByFileSystem(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
+SortKey GetFileSystemSortKey(const BasicItemInfo_t &itemInfo)
 {
-	std::wstring FileSystemName1 = GetFileSystemColumnText(itemInfo1);
-	std::wstring FileSystemName2 = GetFileSystemColumnText(itemInfo2);
-
-	return StrCmpLogicalW(FileSystemName1.c_str(), FileSystemName2.c_str());
+	return BuildTextSortKey(GetFileSystemColumnText(itemInfo));
 }
 
-int SortByPrinterProperty(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, PrinterInformationType_t PrinterInformationType)
+SortKey GetPrinterPropertySortKey(const BasicItemInfo_t &itemInfo, PrinterInformationType_t PrinterInformationType)
 {
-	std::wstring PrinterInformation1 = GetPrinterColumnText(itemInfo1, PrinterInformationType);
-	std::wstring PrinterInformation2 = GetPrinterColumnText(itemInfo2, PrinterInformationType);
-
-	return StrCmpLogicalW(PrinterInformation1.c_str(), PrinterInformation2.c_str());
+	return BuildTextSortKey(GetPrinterColumnText(itemInfo, PrinterInformationType));
 }
 
-int SortByNetworkAdapterStatus(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
+SortKey GetNetworkAdapterStatusSortKey(const BasicItemInfo_t &itemInfo)
 {
-	std::wstring Status1 = GetNetworkAdapterColumnText(itemInfo1);
-	std::wstring Status2 = GetNetworkAdapterColumnText(itemInfo2);
-
-	return StrCmpLogicalW(Status1.c_str(), Status2.c_str());
+	return BuildTextSortKey(GetNetworkAdapterColumnText(itemInfo));
 }
 
-int SortByMediaMetadata(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, MediaMetadataType_t MediaMetaDataType)
+SortKey GetMediaMetadataSortKey(const BasicItemInfo_t &itemInfo, MediaMetadataType_t MediaMetaDataType)
 {
-	std::wstring MediaMetadata1 = GetMediaMetadataColumnText(itemInfo1, MediaMetaDataType);
-	std::wstring MediaMetadata2 = GetMediaMetadataColumnText(itemInfo2, MediaMetaDataType);
-
-	return StrCmpLogicalW(MediaMetadata1.c_str(), MediaMetadata2.c_str());
-}
\ No newline at end of file
+	return BuildTextSortKey(GetMediaMetadataColumnText(itemInfo, MediaMetaDataType));
+}
@@ -7,6 +7,8 @@
 #include "ColumnDataRetrieval.h"
 #include "FolderSettings.h"
 #include "ItemData.h"
+#include "../Helper/CollationKey.h"
+#include <wil/resource.h>
 
 enum DateType_t
 {
@@ -15,23 +17,72 @@ enum DateType_t
 	DATE_TYPE_ACCESSED
 };
 
-int SortByName(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, const GlobalFolderSettings &globalFolderSettings);
-int SortBySize(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByType(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByDate(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, DateType_t DateType);
-int SortByTotalSize(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, bool TotalSize);
-int SortByAttributes(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByRealSize(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByShortName(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByOwner(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByVersionInfo(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, VersionInfoType_t VersioninfoType);
-int SortByShortcutTo(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByHardlinks(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByExtension(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByItemDetails(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, const SHCOLUMNID *pscid);
-int SortByImageProperty(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, PROPID PropertyId);
-int SortByVirtualComments(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByFileSystem(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByPrinterProperty(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, PrinterInformationType_t PrinterInformationType);
-int SortByNetworkAdapterStatus(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByMediaMetadata(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, MediaMetadataType_t MediaMetaDataType);
\ No newline at end of file
+/* Rather than comparing items directly, a sort key is
+built once for each item and the keys are then compared.
+That means that any expensive work needed to sort an item
+(e.g. reading the owner of a file, or its version
+information) only has to be done once per item, rather
+than once per comparison. */
+struct SortKey
+{
+	enum class Type
+	{
+		/* The value couldn't be retrieved. These keys
+		sort before all others. */
+		None,
+
+		Text,
+		Number,
+		Variant
+	};
+
+	SortKey() :
+		rank(0),
+		type(Type::None),
+		number(0)
+	{
+
+	}
+
+	/* Compared before anything else. Used to place
+	certain items (e.g. drives, when sorting by name)
+	ahead of all other items. */
+	int rank;
+
+	Type type;
+
+	/* Text values are stored as natural order collation
+	keys, so that comparing two of them is just a memcmp. */
+	CollationKey text;
+
+	ULONGLONG number;
+	wil::unique_variant variant;
+
+	/* Only used to sub-sort items that are otherwise equal.
+	Filled in by the caller, rather than by the functions
+	below. */
+	CollationKey displayNameKey;
+};
+
+int CompareSortKeys(const SortKey &key1, const SortKey &key2);
+
+SortKey GetNameSortKey(const BasicItemInfo_t &itemInfo, const GlobalFolderSettings &globalFolderSettings);
+SortKey GetSizeSortKey(const BasicItemInfo_t &itemInfo);
+SortKey GetTypeSortKey(const BasicItemInfo_t &itemInfo);
+SortKey GetDateSortKey(const BasicItemInfo_t &itemInfo, DateType_t DateType);
+SortKey GetTotalSizeSortKey(const BasicItemInfo_t &itemInfo, bool TotalSize);
+SortKey GetAttributesSortKey(const BasicItemInfo_t &itemInfo);
+SortKey GetRealSizeSortKey(const BasicItemInfo_t &itemInfo);
+SortKey GetShortNameSortKey(const BasicItemInfo_t &itemInfo);
+SortKey GetOwnerSortKey(const BasicItemInfo_t &itemInfo);
+SortKey GetVersionInfoSortKey(const BasicItemInfo_t &itemInfo, VersionInfoType_t VersioninfoType);
+SortKey GetShortcutToSortKey(const BasicItemInfo_t &itemInfo);
+SortKey GetHardlinksSortKey(const BasicItemInfo_t &itemInfo);
+SortKey GetExtensionSortKey(const BasicItemInfo_t &itemInfo);
+SortKey GetItemDetailsSortKey(const BasicItemInfo_t &itemInfo, const SHCOLUMNID *pscid);
+SortKey GetImagePropertySortKey(const BasicItemInfo_t &itemInfo, PROPID PropertyId);
+SortKey GetVirtualCommentsSortKey(const BasicItemInfo_t &itemInfo);
+SortKey GetFileSystemSortKey(const BasicItemInfo_t &itemInfo);
+SortKey GetPrinterPropertySortKey(const BasicItemInfo_t &itemInfo, PrinterInformationType_t PrinterInformationType);
+SortKey GetNetworkAdapterStatusSortKey(const BasicItemInfo_t &itemInfo);
+SortKey GetMediaMetadataSortKey(const BasicItemInfo_t &itemInfo, MediaMetadataType_t MediaMetaDataType);
@@ -8,8 +8,10 @@
 #include "SortHelper.h"
 #include "SortModes.h"
 #include "ViewModes.h"
+#include "../Helper/ParallelSort.h"
 #include <propkey.h>
 #include <cassert>
+#include <numeric>
 
 void ShellBrowser::SortFolder(SortMode sortMode)
 {
@@ -24,7 +26,7 @@ void ShellBrowser::SortFolder(SortMode sortMode)
 		SetShowInGroups(TRUE);
 	}
 
-	SendMessage(m_hListView,LVM_SORTITEMS,reinterpret_cast<WPARAM>(this),reinterpret_cast<LPARAM>(SortStub));
+	SortItems();
 
 	/* If in details view, the column sort
 	arrow will need to be changed to reflect
@@ -35,303 +37,365 @@ void ShellBrowser::SortFolder(SortMode sortMode)
 	}
 }
 
-int CALLBACK ShellBrowser::SortStub(LPARAM lParam1,LPARAM lParam2,LPARAM lParamSort)
+/* Sorts the items currently in the listview. Rather than
+having the listview compare items directly (which would
+mean retrieving the information needed to sort each item
+many times over), a sort key is built for each item up
+front (in parallel), the keys are sorted and the listview
+is then simply rearranged to match. */
+void ShellBrowser::SortItems()
 {
-	ShellBrowser *pShellBrowser = reinterpret_cast<ShellBrowser *>(lParamSort);
-	return pShellBrowser->Sort(static_cast<int>(lParam1),static_cast<int>(lParam2));
+	if(m_virtualList)
+	{
+		SortVirtualItems();
+		return;
+	}
+
+	int nItems = ListView_GetItemCount(m_hListView);
+
+	std::vector<int> internalIndices(nItems);
+
+	for(int i = 0;i < nItems;i++)
+	{
+		internalIndices[i] = GetItemInternalIndex(i);
+	}
+
+	std::vector<SortKey> sortKeys = BuildSortKeys(internalIndices);
+
+	bool foldersFirst = !CompareVirtualFolders(CSIDL_BITBUCKET);
+
+	std::vector<int> order(nItems);
+	std::iota(order.begin(), order.end(), 0);
+
+	ParallelSort::ParallelMergeSort(TaskExecutor::GetShared(), order,
+		[this, &internalIndices, &sortKeys, foldersFirst] (int index1, int index2) {
+		return CompareItems(internalIndices[index1], sortKeys[index1],
+			internalIndices[index2], sortKeys[index2], foldersFirst) < 0;
+	});
+
+	std::vector<int> sortedPositions(m_itemStore.GetIdLimit());
+
+	for(int i = 0;i < nItems;i++)
+	{
+		sortedPositions[internalIndices[order[i]]] = i;
+	}
+
+	/* Each comparison here is now just a lookup. */
+	ListView_SortItems(m_hListView, SortedPositionStub, reinterpret_cast<LPARAM>(&sortedPositions));
+
+	std::vector<int> sortedInternalIndices(nItems);
+
+	for(int i = 0;i < nItems;i++)
+	{
+		sortedInternalIndices[i] = internalIndices[order[i]];
+	}
+
+	m_rowIndex.SetRows(std::move(sortedInternalIndices));
+
+	/* While the folder is still being read, the sorted keys
+	are kept, so that the remaining items can be merged in. */
+	if(m_enumerationState)
+	{
+		m_enumerationSortedItems.clear();
+		m_enumerationSortedItems.reserve(nItems);
+
+		for(int i = 0;i < nItems;i++)
+		{
+			m_enumerationSortedItems.push_back({ internalIndices[order[i]], std::move(sortKeys[order[i]]) });
+		}
+	}
+
+	/* The position of each item has changed, which affects
+	the order thumbnails are retrieved in. */
+	if(m_folderSettings.viewMode == +ViewMode::Thumbnails)
+	{
+		RefreshThumbnailItems();
+		UpdateThumbnailViewport();
+	}
+}
+
+/* Builds the sort keys for the specified items in parallel. */
+std::vector<SortKey> ShellBrowser::BuildSortKeys(const std::vector<int> &internalIndices)
+{
+	std::vector<SortKey> sortKeys(internalIndices.size());
+
+	ParallelSort::ParallelFor(TaskExecutor::GetShared(), internalIndices.size(), [this, &internalIndices, &sortKeys] (size_t begin, size_t end) {
+		/* Some sort keys (e.g. those for item details) are
+		retrieved via COM. */
+		HRESULT hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+
+		for(size_t i = begin;i < end;i++)
+		{
+			sortKeys[i] = GetSortKey(internalIndices[i]);
+		}
+
+		if(SUCCEEDED(hr))
+		{
+			CoUninitialize();
+		}
+	});
+
+	return sortKeys;
+}
+
+int CALLBACK ShellBrowser::SortedPositionStub(LPARAM lParam1,LPARAM lParam2,LPARAM lParamSort)
+{
+	const auto *sortedPositions = reinterpret_cast<const std::vector<int> *>(lParamSort);
+	return (*sortedPositions)[lParam1] - (*sortedPositions)[lParam2];
 }
 
 /* Also see NBookmarkHelper::Sort. */
 int CALLBACK ShellBrowser::Sort(int InternalIndex1,int InternalIndex2) const
+{
+	SortKey sortKey1 = GetSortKey(InternalIndex1);
+	SortKey sortKey2 = GetSortKey(InternalIndex2);
+
+	return CompareItems(InternalIndex1, sortKey1, InternalIndex2, sortKey2,
+		!CompareVirtualFolders(CSIDL_BITBUCKET));
+}
+
+int ShellBrowser::CompareItems(int internalIndex1, const SortKey &sortKey1,
+	int internalIndex2, const SortKey &sortKey2, bool foldersFirst) const
 {
 	int ComparisonResult = 0;
 
-	BasicItemInfo_t basicItemInfo1 = getBasicItemInfo(InternalIndex1);
-	BasicItemInfo_t basicItemInfo2 = getBasicItemInfo(InternalIndex2);
+	bool IsFolder1 = m_itemStore.IsFolder(internalIndex1);
+	bool IsFolder2 = m_itemStore.IsFolder(internalIndex2);
 
-	bool IsFolder1 = ((basicItemInfo1.wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY) ? true : false;
-	bool IsFolder2 = ((basicItemInfo2.wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY) ? true : false;
-	
 	/* Folders will always be sorted separately from files,
 	except in the recycle bin. */
-	if(IsFolder1 && !IsFolder2 && !CompareVirtualFolders(CSIDL_BITBUCKET))
+	if(IsFolder1 && !IsFolder2 && foldersFirst)
 	{
 		ComparisonResult = -1;
 	}
-	else if(!IsFolder1 && IsFolder2 && !CompareVirtualFolders(CSIDL_BITBUCKET))
+	else if(!IsFolder1 && IsFolder2 && foldersFirst)
 	{
 		ComparisonResult = 1;
 	}
 	else
 	{
-		switch(m_folderSettings.sortMode)
-		{
-		case SortMode::Name:
-			ComparisonResult = SortByName(basicItemInfo1, basicItemInfo2, m_config->globalFolderSettings);
-			break;
+		ComparisonResult = CompareSortKeys(sortKey1, sortKey2);
+	}
+
+	if(ComparisonResult == 0)
+	{
+		/* By default, items that are equal will be sub-sorted
+		by their display names. */
+		ComparisonResult = CompareCollationKeys(sortKey1.displayNameKey, sortKey2.displayNameKey);
+	}
+
+	if(!m_folderSettings.sortAscending)
+	{
+		ComparisonResult = -ComparisonResult;
+	}
 
-		case SortMode::Type:
-			ComparisonResult = SortByType(basicItemInfo1,basicItemInfo2);
-			break;
+	return ComparisonResult;
+}
 
-		case SortMode::Size:
-			ComparisonResult = SortBySize(basicItemInfo1,basicItemInfo2);
-			break;
+SortKey ShellBrowser::GetSortKey(int internalIndex) const
+{
+	const BasicItemInfo_t &basicItemInfo = getBasicItemInfo(internalIndex);
 
-		case SortMode::DateModified:
-			ComparisonResult = SortByDate(basicItemInfo1,basicItemInfo2,DATE_TYPE_MODIFIED);
-			break;
+	SortKey sortKey = GetSortKeyForSortMode(basicItemInfo);
+	sortKey.displayNameKey = BuildCollationKey(m_itemStore.GetDisplayName(internalIndex));
 
-		case SortMode::TotalSize:
-			ComparisonResult = SortByTotalSize(basicItemInfo1,basicItemInfo2,TRUE);
-			break;
+	return sortKey;
+}
 
-		case SortMode::FreeSpace:
-			ComparisonResult = SortByTotalSize(basicItemInfo1,basicItemInfo2,FALSE);
-			break;
+SortKey ShellBrowser::GetSortKeyForSortMode(const BasicItemInfo_t &basicItemInfo) const
+{
+	switch(m_folderSettings.sortMode)
+	{
+	case SortMode::Name:
+		return GetNameSortKey(basicItemInfo, m_config->globalFolderSettings);
 
-		case SortMode::DateDeleted:
-			ComparisonResult = SortByItemDetails(basicItemInfo1, basicItemInfo2, &SCID_DATE_DELETED);
-			break;
+	case SortMode::Type:
+		return GetTypeSortKey(basicItemInfo);
 
-		case SortMode::OriginalLocation:
-			ComparisonResult = SortByItemDetails(basicItemInfo1, basicItemInfo2, &SCID_ORIGINAL_LOCATION);
-			break;
+	case SortMode::Size:
+		return GetSizeSortKey(basicItemInfo);
 
-		case SortMode::Attributes:
-			ComparisonResult = SortByAttributes(basicItemInfo1, basicItemInfo2);
-			break;
+	case SortMode::DateModified:
+		return GetDateSortKey(basicItemInfo, DATE_TYPE_MODIFIED);
 
-		case SortMode::RealSize:
-			ComparisonResult = SortByRealSize(basicItemInfo1, basicItemInfo2);
-			break;
+	case SortMode::TotalSize:
+		return GetTotalSizeSortKey(basicItemInfo, TRUE);
 
-		case SortMode::ShortName:
-			ComparisonResult = SortByShortName(basicItemInfo1, basicItemInfo2);
-			break;
+	case SortMode::FreeSpace:
+		return GetTotalSizeSortKey(basicItemInfo, FALSE);
 
-		case SortMode::Owner:
-			ComparisonResult = SortByOwner(basicItemInfo1, basicItemInfo2);
-			break;
+	case SortMode::DateDeleted:
+		return GetItemDetailsSortKey(basicItemInfo, &SCID_DATE_DELETED);
 
-		case SortMode::ProductName:
-			ComparisonResult = SortByVersionInfo(basicItemInfo1, basicItemInfo2,VERSION_INFO_PRODUCT_NAME);
-			break;
+	case SortMode::OriginalLocation:
+		return GetItemDetailsSortKey(basicItemInfo, &SCID_ORIGINAL_LOCATION);
 
-		case SortMode::Company:
-			ComparisonResult = SortByVersionInfo(basicItemInfo1, basicItemInfo2,VERSION_INFO_COMPANY);
-			break;
+	case SortMode::Attributes:
+		return GetAttributesSortKey(basicItemInfo);
 
-		case SortMode::Description:
-			ComparisonResult = SortByVersionInfo(basicItemInfo1, basicItemInfo2,VERSION_INFO_DESCRIPTION);
-			break;
+	case SortMode::RealSize:
+		return GetRealSizeSortKey(basicItemInfo);
 
-		case SortMode::FileVersion:
-			ComparisonResult = SortByVersionInfo(basicItemInfo1, basicItemInfo2,VERSION_INFO_FILE_VERSION);
-			break;
+	case SortMode::ShortName:
+		return GetShortNameSortKey(basicItemInfo);
 
-		case SortMode::ProductVersion:
-			ComparisonResult = SortByVersionInfo(basicItemInfo1, basicItemInfo2,VERSION_INFO_PRODUCT_VERSION);
-			break;
+	case SortMode::Owner:
+		return GetOwnerSortKey(basicItemInfo);
 
-		case SortMode::ShortcutTo:
-			ComparisonResult = SortByShortcutTo(basicItemInfo1, basicItemInfo2);
-			break;
+	case SortMode::ProductName:
+		return GetVersionInfoSortKey(basicItemInfo, VERSION_INFO_PRODUCT_NAME);
 
-		case SortMode::HardLinks:
-			ComparisonResult = SortByHardlinks(basicItemInfo1, basicItemInfo2);
-			break;
+	case SortMode::Company:
+		return GetVersionInfoSortKey(basicItemInfo, VERSION_INFO_COMPANY);
 
-		case SortMode::Extension:
-			ComparisonResult = SortByExtension(basicItemInfo1,basicItemInfo2);
-			break;
+	case SortMode::Description:
+		return GetVersionInfoSortKey(basicItemInfo, VERSION_INFO_DESCRIPTION);
 
-		case SortMode::Created:
-			ComparisonResult = SortByDate(basicItemInfo1,basicItemInfo2,DATE_TYPE_CREATED);
-			break;
+	case SortMode::FileVersion:
+		return GetVersionInfoSortKey(basicItemInfo, VERSION_INFO_FILE_VERSION);
 
-		case SortMode::Accessed:
-			ComparisonResult = SortByDate(basicItemInfo1,basicItemInfo2,DATE_TYPE_ACCESSED);
-			break;
+	case SortMode::ProductVersion:
+		return GetVersionInfoSortKey(basicItemInfo, VERSION_INFO_PRODUCT_VERSION);
 
-		case SortMode::Title:
-			ComparisonResult = SortByItemDetails(basicItemInfo1, basicItemInfo2,&PKEY_Title);
-			break;
+	case SortMode::ShortcutTo:
+		return GetShortcutToSortKey(basicItemInfo);
 
-		case SortMode::Subject:
-			ComparisonResult = SortByItemDetails(basicItemInfo1, basicItemInfo2,&PKEY_Subject);
-			break;
+	case SortMode::HardLinks:
+		return GetHardlinksSortKey(basicItemInfo);
 
-		case SortMode::Authors:
-			ComparisonResult = SortByItemDetails(basicItemInfo1, basicItemInfo2,&PKEY_Author);
-			break;
+	case SortMode::Extension:
+		return GetExtensionSortKey(basicItemInfo);
 
-		case SortMode::Keywords:
-			ComparisonResult = SortByItemDetails(basicItemInfo1, basicItemInfo2,&PKEY_Keywords);
-			break;
+	case SortMode::Created:
+		return GetDateSortKey(basicItemInfo, DATE_TYPE_CREATED);
 
-		case SortMode::Comments:
-			ComparisonResult = SortByItemDetails(basicItemInfo1, basicItemInfo2,&PKEY_Comment);
-			break;
+	case SortMode::Accessed:
+		return GetDateSortKey(basicItemInfo, DATE_TYPE_ACCESSED);
 
-		case SortMode::CameraModel:
-			ComparisonResult = SortByImageProperty(basicItemInfo1, basicItemInfo2,PropertyTagEquipModel);
-			break;
+	case SortMode::Title:
+		return GetItemDetailsSortKey(basicItemInfo, &PKEY_Title);
 
-		case SortMode::DateTaken:
-			ComparisonResult = SortByImageProperty(basicItemInfo1, basicItemInfo2,PropertyTagDateTime);
-			break;
+	case SortMode::Subject:
+		return GetItemDetailsSortKey(basicItemInfo, &PKEY_Subject);
 
-		case SortMode::Width:
-			ComparisonResult = SortByImageProperty(basicItemInfo1, basicItemInfo2,PropertyTagImageWidth);
-			break;
+	case SortMode::Authors:
+		return GetItemDetailsSortKey(basicItemInfo, &PKEY_Author);
 
-		case SortMode::Height:
-			ComparisonResult = SortByImageProperty(basicItemInfo1, basicItemInfo2,PropertyTagImageHeight);
-			break;
+	case SortMode::Keywords:
+		return GetItemDetailsSortKey(basicItemInfo, &PKEY_Keywords);
 
-		case SortMode::VirtualComments:
-			ComparisonResult = SortByVirtualComments(basicItemInfo1, basicItemInfo2);
-			break;
+	case SortMode::Comments:
+		return GetItemDetailsSortKey(basicItemInfo, &PKEY_Comment);
 
-		case SortMode::FileSystem:
-			ComparisonResult = SortByFileSystem(basicItemInfo1,basicItemInfo2);
-			break;
+	case SortMode::CameraModel:
+		return GetImagePropertySortKey(basicItemInfo, PropertyTagEquipModel);
 
-		case SortMode::NumPrinterDocuments:
-			ComparisonResult = SortByPrinterProperty(basicItemInfo1,basicItemInfo2,PRINTER_INFORMATION_TYPE_NUM_JOBS);
-			break;
+	case SortMode::DateTaken:
+		return GetImagePropertySortKey(basicItemInfo, PropertyTagDateTime);
 
-		case SortMode::PrinterStatus:
-			ComparisonResult = SortByPrinterProperty(basicItemInfo1,basicItemInfo2,PRINTER_INFORMATION_TYPE_STATUS);
-			break;
+	case SortMode::Width:
+		return GetImagePropertySortKey(basicItemInfo, PropertyTagImageWidth);
 
-		case SortMode::PrinterComments:
-			ComparisonResult = SortByPrinterProperty(basicItemInfo1,basicItemInfo2,PRINTER_INFORMATION_TYPE_COMMENTS);
-			break;
+	case SortMode::Height:
+		return GetImagePropertySortKey(basicItemInfo, PropertyTagImageHeight);
 
-		case SortMode::PrinterLocation:
-			ComparisonResult = SortByPrinterProperty(basicItemInfo1,basicItemInfo2,PRINTER_INFORMATION_TYPE_LOCATION);
-			break;
+	case SortMode::VirtualComments:
+		return GetVirtualCommentsSortKey(basicItemInfo);
 
-		case SortMode::NetworkAdapterStatus:
-			ComparisonResult = SortByNetworkAdapterStatus(basicItemInfo1,basicItemInfo2);
-			break;
+	case SortMode::FileSystem:
+		return GetFileSystemSortKey(basicItemInfo);
 
-		case SortMode::MediaBitrate:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_BITRATE);
-			break;
+	case SortMode::NumPrinterDocuments:
+		return GetPrinterPropertySortKey(basicItemInfo, PRINTER_INFORMATION_TYPE_NUM_JOBS);
 
-		case SortMode::MediaCopyright:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_COPYRIGHT);
-			break;
+	case SortMode::PrinterStatus:
+		return GetPrinterPropertySortKey(basicItemInfo, PRINTER_INFORMATION_TYPE_STATUS);
 
-		case SortMode::MediaDuration:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_DURATION);
-			break;
+	case SortMode::PrinterComments:
+		return GetPrinterPropertySortKey(basicItemInfo, PRINTER_INFORMATION_TYPE_COMMENTS);
 
-		case SortMode::MediaProtected:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_PROTECTED);
-			break;
+	case SortMode::PrinterLocation:
+		return GetPrinterPropertySortKey(basicItemInfo, PRINTER_INFORMATION_TYPE_LOCATION);
 
-		case SortMode::MediaRating:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_RATING);
-			break;
+	case SortMode::NetworkAdapterStatus:
+		return GetNetworkAdapterStatusSortKey(basicItemInfo);
 
-		case SortMode::MediaAlbumArtist:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_ALBUM_ARTIST);
-			break;
+	case SortMode::MediaBitrate:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_BITRATE);
 
-		case SortMode::MediaAlbum:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_ALBUM_TITLE);
-			break;
+	case SortMode::MediaCopyright:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_COPYRIGHT);
 
-		case SortMode::MediaBeatsPerMinute:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_BEATS_PER_MINUTE);
-			break;
+	case SortMode::MediaDuration:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_DURATION);
 
-		case SortMode::MediaComposer:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_COMPOSER);
-			break;
+	case SortMode::MediaProtected:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_PROTECTED);
 
-		case SortMode::MediaConductor:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_CONDUCTOR);
-			break;
+	case SortMode::MediaRating:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_RATING);
 
-		case SortMode::MediaDirector:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_DIRECTOR);
-			break;
+	case SortMode::MediaAlbumArtist:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_ALBUM_ARTIST);
 
-		case SortMode::MediaGenre:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_GENRE);
-			break;
+	case SortMode::MediaAlbum:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_ALBUM_TITLE);
 
-		case SortMode::MediaLanguage:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_LANGUAGE);
-			break;
+	case SortMode::MediaBeatsPerMinute:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_BEATS_PER_MINUTE);
 
-		case SortMode::MediaBroadcastDate:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_BROADCASTDATE);
-			break;
+	case SortMode::MediaComposer:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_COMPOSER);
 
-		case SortMode::MediaChannel:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_CHANNEL);
-			break;
+	case SortMode::MediaConductor:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_CONDUCTOR);
 
-		case SortMode::MediaStationName:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_STATIONNAME);
-			break;
+	case SortMode::MediaDirector:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_DIRECTOR);
 
-		case SortMode::MediaMood:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_MOOD);
-			break;
+	case SortMode::MediaGenre:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_GENRE);
 
-		case SortMode::MediaParentalRating:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_PARENTALRATING);
-			break;
+	case SortMode::MediaLanguage:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_LANGUAGE);
 
-		case SortMode::MediaParentalRatingReason:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_PARENTALRATINGREASON);
-			break;
+	case SortMode::MediaBroadcastDate:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_BROADCASTDATE);
 
-		case SortMode::MediaPeriod:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_PERIOD);
-			break;
+	case SortMode::MediaChannel:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_CHANNEL);
 
-		case SortMode::MediaProducer:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_PRODUCER);
-			break;
+	case SortMode::MediaStationName:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_STATIONNAME);
 
-		case SortMode::MediaPublisher:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_PUBLISHER);
-			break;
+	case SortMode::MediaMood:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_MOOD);
 
-		case SortMode::MediaWriter:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_WRITER);
-			break;
+	case SortMode::MediaParentalRating:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_PARENTALRATING);
 
-		case SortMode::MediaYear:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_YEAR);
-			break;
+	case SortMode::MediaParentalRatingReason:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_PARENTALRATINGREASON);
 
-		default:
-			assert(false);
-			break;
-		}
-	}
+	case SortMode::MediaPeriod:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_PERIOD);
 
-	if(ComparisonResult == 0)
-	{
-		/* By default, items that are equal will be sub-sorted
-		by their display names. */
-		ComparisonResult = StrCmpLogicalW(basicItemInfo1.szDisplayName,
-			basicItemInfo2.szDisplayName);
-	}
+	case SortMode::MediaProducer:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_PRODUCER);
 
-	if(!m_folderSettings.sortAscending)
-	{
-		ComparisonResult = -ComparisonResult;
+	case SortMode::MediaPublisher:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_PUBLISHER);
+
+	case SortMode::MediaWriter:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_WRITER);
+
+	case SortMode::MediaYear:
+		return GetMediaMetadataSortKey(basicItemInfo, MEDIAMETADATA_TYPE_YEAR);
+
+	default:
+		assert(false);
+		break;
 	}
 
-	return ComparisonResult;
+	return SortKey();
 }
\ No newline at end of file
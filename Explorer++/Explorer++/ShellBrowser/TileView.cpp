@@ -86,14 +86,12 @@ void ShellBrowser::SetTileViewItemInfo(int iItem, int iItemInternal)
 
 	ListView_SetItemText(m_hListView, iItem, 1, shfi.szTypeName);
 
-	if ((m_itemInfoMap.at(iItemInternal).wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) !=
-		FILE_ATTRIBUTE_DIRECTORY)
+	if (!m_itemStore.IsFolder(iItemInternal))
 	{
 		TCHAR			lpszFileSize[32];
 		ULARGE_INTEGER	lFileSize;
 
-		lFileSize.LowPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeLow;
-		lFileSize.HighPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeHigh;
+		lFileSize.QuadPart = m_itemStore.GetSize(iItemInternal);
 
 		FormatSizeString(lFileSize, lpszFileSize, SIZEOF_ARRAY(lpszFileSize),
 			m_config->globalFolderSettings.forceSize, m_config->globalFolderSettings.sizeDisplayFormat);
@@ -0,0 +1,759 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+/* Support for showing folders in an owner-data
+(LVS_OWNERDATA) listview. The listview only stores the
+number of rows (along with the selection and focus); the
+items themselves are held in a VirtualItemList, which maps
+each row to an internal index.
+
+Rather than changing every place that sets information on
+a listview item, the messages that would normally store
+that information are intercepted and the information is
+held in m_virtualList instead. It's then handed back to the
+listview as each item is drawn. */
+
+#include "stdafx.h"
+#include "ShellBrowser.h"
+#include "Config.h"
+#include "ViewModes.h"
+#include "../Helper/Macros.h"
+#include <algorithm>
+
+boost::optional<LRESULT> ShellBrowser::HandleVirtualListViewMessage(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+	auto &items = m_virtualList->items;
+
+	switch (uMsg)
+	{
+	case LVM_GETITEM:
+	{
+		auto *lvItem = reinterpret_cast<LVITEM *>(lParam);
+
+		if (lvItem->iItem < 0 || static_cast<size_t>(lvItem->iItem) >= items.GetNumRows())
+		{
+			return FALSE;
+		}
+
+		UINT mask = lvItem->mask;
+		LRESULT res = TRUE;
+
+		/* Retrieving the internal index of an item is by far
+		the most common case, so the listview is only asked if
+		something else is needed. */
+		if ((mask & ~LVIF_PARAM) != 0)
+		{
+			lvItem->mask = mask & ~LVIF_PARAM;
+			res = DefSubclassProc(hwnd, uMsg, wParam, lParam);
+			lvItem->mask = mask;
+		}
+
+		if (WI_IsFlagSet(mask, LVIF_PARAM))
+		{
+			lvItem->lParam = items.GetItemAtRow(lvItem->iItem);
+		}
+
+		return res;
+	}
+
+	case LVM_SETITEM:
+	{
+		const auto *lvItem = reinterpret_cast<const LVITEM *>(lParam);
+
+		if (lvItem->iItem < 0 || static_cast<size_t>(lvItem->iItem) >= items.GetNumRows())
+		{
+			return FALSE;
+		}
+
+		if (WI_IsFlagSet(lvItem->mask, LVIF_TEXT))
+		{
+			SetVirtualItemText(lvItem->iItem, lvItem->iSubItem, lvItem->pszText);
+		}
+
+		if (lvItem->iSubItem == 0 && WI_IsFlagSet(lvItem->mask, LVIF_IMAGE))
+		{
+			int internalIndex = items.GetItemAtRow(lvItem->iItem);
+
+			if (lvItem->iImage != I_IMAGECALLBACK)
+			{
+				m_virtualList->itemInfo[internalIndex].iImage = lvItem->iImage;
+			}
+			else
+			{
+				auto itr = m_virtualList->itemInfo.find(internalIndex);
+
+				if (itr != m_virtualList->itemInfo.end())
+				{
+					itr->second.iImage = I_IMAGECALLBACK;
+				}
+			}
+		}
+
+		if (lvItem->iSubItem == 0 && WI_IsFlagSet(lvItem->mask, LVIF_STATE))
+		{
+			SetVirtualItemState(hwnd, lvItem->iItem, *lvItem);
+		}
+
+		ListView_RedrawItems(hwnd, lvItem->iItem, lvItem->iItem);
+
+		return TRUE;
+	}
+
+	case LVM_SETITEMSTATE:
+	{
+		int iItem = static_cast<int>(wParam);
+
+		if (iItem != -1 && (iItem < 0 || static_cast<size_t>(iItem) >= items.GetNumRows()))
+		{
+			return FALSE;
+		}
+
+		return SetVirtualItemState(hwnd, iItem, *reinterpret_cast<const LVITEM *>(lParam));
+	}
+
+	case LVM_SETITEMTEXT:
+	{
+		int iItem = static_cast<int>(wParam);
+
+		if (iItem < 0 || static_cast<size_t>(iItem) >= items.GetNumRows())
+		{
+			return FALSE;
+		}
+
+		const auto *lvItem = reinterpret_cast<const LVITEM *>(lParam);
+		SetVirtualItemText(iItem, lvItem->iSubItem, lvItem->pszText);
+
+		ListView_RedrawItems(hwnd, iItem, iItem);
+
+		return TRUE;
+	}
+
+	/* Subitem text is stored by position, so it's no
+	longer valid once the columns change. */
+	case LVM_INSERTCOLUMN:
+	case LVM_DELETECOLUMN:
+		for (auto &itemInfo : m_virtualList->itemInfo)
+		{
+			itemInfo.second.subItemText.clear();
+		}
+		break;
+
+	case LVM_DELETEALLITEMS:
+		ClearVirtualItems();
+		break;
+
+	/* The items are sorted by the model. */
+	case LVM_SORTITEMS:
+	case LVM_SORTITEMSEX:
+		return FALSE;
+	}
+
+	return boost::none;
+}
+
+/* Stores any bits in the callback mask and passes anything
+else (e.g. the selected or focused state) on to the
+listview. */
+LRESULT ShellBrowser::SetVirtualItemState(HWND hwnd, int iItem, const LVITEM &lvItem)
+{
+	UINT callbackMask = lvItem.stateMask & VIRTUAL_LIST_VIEW_CALLBACK_MASK;
+
+	/* Only individual items can be ghosted or have an overlay
+	set on them. */
+	if (callbackMask != 0 && iItem != -1)
+	{
+		auto &itemInfo = m_virtualList->itemInfo[m_virtualList->items.GetItemAtRow(iItem)];
+		itemInfo.state = (itemInfo.state & ~callbackMask) | (lvItem.state & callbackMask);
+
+		ListView_RedrawItems(hwnd, iItem, iItem);
+	}
+
+	UINT stateMask = lvItem.stateMask & ~VIRTUAL_LIST_VIEW_CALLBACK_MASK;
+
+	if (stateMask == 0)
+	{
+		return TRUE;
+	}
+
+	LVITEM lvStateItem = lvItem;
+	lvStateItem.stateMask = stateMask;
+
+	return DefSubclassProc(hwnd, LVM_SETITEMSTATE, iItem, reinterpret_cast<LPARAM>(&lvStateItem));
+}
+
+void ShellBrowser::SetVirtualItemText(int iItem, int iSubItem, const TCHAR *text)
+{
+	if (iSubItem == 0)
+	{
+		return;
+	}
+
+	int internalIndex = m_virtualList->items.GetItemAtRow(iItem);
+
+	if (text == nullptr || text == LPSTR_TEXTCALLBACK)
+	{
+		auto itr = m_virtualList->itemInfo.find(internalIndex);
+
+		if (itr != m_virtualList->itemInfo.end())
+		{
+			itr->second.subItemText.erase(iSubItem);
+		}
+
+		return;
+	}
+
+	m_virtualList->itemInfo[internalIndex].subItemText[iSubItem] = text;
+}
+
+/* Returns anything that's been stored for the item. Whatever
+else is needed is then retrieved as it would be for a normal
+listview, with anything the listview would be asked to store
+(via LVIF_DI_SETITEM) being stored here instead. */
+void ShellBrowser::OnVirtualListViewGetDisplayInfo(NMLVDISPINFO *dispInfo)
+{
+	LVITEM *plvItem = &dispInfo->item;
+
+	if (plvItem->iItem < 0 || static_cast<size_t>(plvItem->iItem) >= m_virtualList->items.GetNumRows())
+	{
+		return;
+	}
+
+	int internalIndex = m_virtualList->items.GetItemAtRow(plvItem->iItem);
+
+	auto itr = m_virtualList->itemInfo.find(internalIndex);
+	const VirtualItemInfo_t *itemInfo = (itr != m_virtualList->itemInfo.end()) ? &itr->second : nullptr;
+
+	UINT mask = plvItem->mask;
+	UINT remaining = mask & (LVIF_TEXT | LVIF_IMAGE);
+
+	if (WI_IsFlagSet(mask, LVIF_PARAM))
+	{
+		plvItem->lParam = internalIndex;
+	}
+
+	if (WI_IsFlagSet(mask, LVIF_STATE))
+	{
+		plvItem->state = itemInfo ? (itemInfo->state & plvItem->stateMask) : 0;
+	}
+
+	/* Tile view columns are never shown. */
+	if (WI_IsFlagSet(mask, LVIF_COLUMNS))
+	{
+		plvItem->cColumns = 0;
+	}
+
+	if (WI_IsFlagSet(mask, LVIF_TEXT))
+	{
+		if (plvItem->iSubItem == 0)
+		{
+			std::wstring filename = ProcessItemFileName(getBasicItemInfo(internalIndex), m_config->globalFolderSettings);
+			StringCchCopy(plvItem->pszText, plvItem->cchTextMax, filename.c_str());
+			WI_ClearFlag(remaining, LVIF_TEXT);
+		}
+		else if (itemInfo && itemInfo->subItemText.count(plvItem->iSubItem) != 0)
+		{
+			StringCchCopy(plvItem->pszText, plvItem->cchTextMax, itemInfo->subItemText.at(plvItem->iSubItem).c_str());
+			WI_ClearFlag(remaining, LVIF_TEXT);
+		}
+		else
+		{
+			/* Column text that hasn't been retrieved yet is shown
+			as empty until the result arrives. */
+			StringCchCopy(plvItem->pszText, plvItem->cchTextMax, EMPTY_STRING);
+
+			if (m_folderSettings.viewMode != +ViewMode::Details)
+			{
+				WI_ClearFlag(remaining, LVIF_TEXT);
+			}
+		}
+	}
+
+	if (WI_IsFlagSet(mask, LVIF_IMAGE) && itemInfo && itemInfo->iImage != I_IMAGECALLBACK)
+	{
+		plvItem->iImage = itemInfo->iImage;
+		WI_ClearFlag(remaining, LVIF_IMAGE);
+	}
+
+	if (remaining == 0)
+	{
+		return;
+	}
+
+	plvItem->mask = remaining;
+	plvItem->lParam = internalIndex;
+
+	OnListViewGetDisplayInfo(reinterpret_cast<LPARAM>(dispInfo));
+
+	if (WI_IsFlagSet(plvItem->mask, LVIF_DI_SETITEM))
+	{
+		auto &storedItemInfo = m_virtualList->itemInfo[internalIndex];
+
+		if (WI_IsFlagSet(remaining, LVIF_IMAGE))
+		{
+			storedItemInfo.iImage = plvItem->iImage;
+		}
+
+		if (WI_IsFlagSet(remaining, LVIF_TEXT))
+		{
+			storedItemInfo.subItemText[plvItem->iSubItem] = plvItem->pszText;
+		}
+	}
+
+	plvItem->mask = mask;
+}
+
+/* Sent before a range of rows is drawn. Everything those
+rows need is retrieved (or queued) now, in one go, rather
+than as each item is drawn. */
+void ShellBrowser::OnVirtualListViewCacheHint(const NMLVCACHEHINT *cacheHint)
+{
+	int numRows = static_cast<int>(m_virtualList->items.GetNumRows());
+	int numColumns = 1;
+
+	if (m_folderSettings.viewMode == +ViewMode::Details)
+	{
+		numColumns = Header_GetItemCount(ListView_GetHeader(m_hListView));
+	}
+
+	for (int iItem = (std::max)(cacheHint->iFrom, 0); iItem <= cacheHint->iTo && iItem < numRows; iItem++)
+	{
+		for (int iSubItem = 0; iSubItem < numColumns; iSubItem++)
+		{
+			TCHAR text[512];
+
+			NMLVDISPINFO dispInfo = {};
+			dispInfo.hdr = cacheHint->hdr;
+			dispInfo.hdr.code = LVN_GETDISPINFO;
+			dispInfo.item.mask = (iSubItem == 0) ? LVIF_IMAGE : LVIF_TEXT;
+			dispInfo.item.iItem = iItem;
+			dispInfo.item.iSubItem = iSubItem;
+			dispInfo.item.pszText = text;
+			dispInfo.item.cchTextMax = SIZEOF_ARRAY(text);
+			OnVirtualListViewGetDisplayInfo(&dispInfo);
+		}
+	}
+}
+
+/* The selection is held by the model as well as the listview,
+since the model (unlike the listview) can follow each item
+as the rows are rearranged. */
+void ShellBrowser::OnVirtualListViewItemChanged(const NMLISTVIEW *changeData)
+{
+	if (changeData->uChanged != LVIF_STATE || m_virtualList->applyingSelection)
+	{
+		return;
+	}
+
+	bool previouslySelected = WI_IsFlagSet(changeData->uOldState, LVIS_SELECTED);
+	bool currentlySelected = WI_IsFlagSet(changeData->uNewState, LVIS_SELECTED);
+
+	if (previouslySelected == currentlySelected)
+	{
+		return;
+	}
+
+	int numRows = static_cast<int>(m_virtualList->items.GetNumRows());
+
+	/* An item of -1 means the change applies to every item. */
+	if (changeData->iItem == -1)
+	{
+		for (int iItem = 0; iItem < numRows; iItem++)
+		{
+			SetVirtualRowSelected(iItem, currentlySelected);
+		}
+	}
+	else if (changeData->iItem < numRows)
+	{
+		SetVirtualRowSelected(changeData->iItem, currentlySelected);
+	}
+
+	if (m_bPerformingDrag)
+	{
+		return;
+	}
+
+	listViewSelectionChanged.m_signal();
+}
+
+/* Sent when a range of items is selected (e.g. with shift
+and click). */
+void ShellBrowser::OnVirtualListViewStateChanged(const NMLVODSTATECHANGE *stateChange)
+{
+	if (m_virtualList->applyingSelection)
+	{
+		return;
+	}
+
+	bool previouslySelected = WI_IsFlagSet(stateChange->uOldState, LVIS_SELECTED);
+	bool currentlySelected = WI_IsFlagSet(stateChange->uNewState, LVIS_SELECTED);
+
+	if (previouslySelected == currentlySelected)
+	{
+		return;
+	}
+
+	int numRows = static_cast<int>(m_virtualList->items.GetNumRows());
+
+	for (int iItem = (std::max)(stateChange->iFrom, 0); iItem <= stateChange->iTo && iItem < numRows; iItem++)
+	{
+		SetVirtualRowSelected(iItem, currentlySelected);
+	}
+
+	if (m_bPerformingDrag)
+	{
+		return;
+	}
+
+	listViewSelectionChanged.m_signal();
+}
+
+/* Used by the listview for incremental (type-ahead)
+searches. Only searches by name are supported. */
+int ShellBrowser::OnVirtualListViewFindItem(const NMLVFINDITEM *findItem)
+{
+	const LVFINDINFO &findInfo = findItem->lvfi;
+
+	if (!WI_IsAnyFlagSet(findInfo.flags, LVFI_STRING | LVFI_PARTIAL) || findInfo.psz == nullptr)
+	{
+		return -1;
+	}
+
+	int numRows = static_cast<int>(m_virtualList->items.GetNumRows());
+
+	if (numRows == 0)
+	{
+		return -1;
+	}
+
+	int start = (findItem->iStart >= 0 && findItem->iStart < numRows) ? findItem->iStart : 0;
+	int length = lstrlen(findInfo.psz);
+	bool partial = WI_IsFlagSet(findInfo.flags, LVFI_PARTIAL);
+
+	for (int i = 0; i < numRows; i++)
+	{
+		int iItem = start + i;
+
+		if (iItem >= numRows)
+		{
+			if (WI_IsFlagClear(findInfo.flags, LVFI_WRAP))
+			{
+				break;
+			}
+
+			iItem -= numRows;
+		}
+
+		int internalIndex = m_virtualList->items.GetItemAtRow(iItem);
+		std::wstring filename = ProcessItemFileName(getBasicItemInfo(internalIndex), m_config->globalFolderSettings);
+
+		if (partial ? (StrCmpNI(filename.c_str(), findInfo.psz, length) == 0)
+			: (lstrcmpi(filename.c_str(), findInfo.psz) == 0))
+		{
+			return iItem;
+		}
+	}
+
+	return -1;
+}
+
+void ShellBrowser::SetVirtualRowSelected(int iItem, bool selected)
+{
+	auto &items = m_virtualList->items;
+
+	if (items.IsRowSelected(iItem) == selected)
+	{
+		return;
+	}
+
+	UpdateFileSelectionInfo(items.GetItemAtRow(iItem), selected);
+	items.SetRowSelected(iItem, selected);
+}
+
+/* The sort order and filter are kept. Both read the current
+folder settings each time they're used, so remain valid when
+another folder is shown. */
+void ShellBrowser::ClearVirtualItems()
+{
+	m_virtualList->items.Clear();
+	m_virtualList->sortKeys.clear();
+	m_virtualList->itemInfo.clear();
+	m_virtualList->updatedItems.clear();
+}
+
+/* Adds the items waiting to be inserted. Items that are
+filtered out are still added to the model (the filter
+decides which items are shown), so that they can be shown
+again later without being merged back in. */
+void ShellBrowser::InsertVirtualItems()
+{
+	int focusedItem = GetVirtualFocusedItem();
+	int newItem = -1;
+
+	std::vector<int> internalIndices;
+	internalIndices.reserve(m_AwaitingAddList.size());
+
+	for (const auto &awaitingItem : m_AwaitingAddList)
+	{
+		int internalIndex = awaitingItem.iItemInternal;
+		internalIndices.push_back(internalIndex);
+
+		if (IsFileFiltered(internalIndex))
+		{
+			continue;
+		}
+
+		m_itemShellInfo[internalIndex].bInListView = true;
+
+		/* If the file is marked as hidden, ghost it out. */
+		if (WI_IsFlagSet(m_itemStore.GetAttributes(internalIndex), FILE_ATTRIBUTE_HIDDEN))
+		{
+			m_virtualList->itemInfo[internalIndex].state |= LVIS_CUT;
+		}
+
+		m_ulTotalDirSize.QuadPart += m_itemStore.GetSize(internalIndex);
+		m_nTotalItems++;
+
+		if (m_bNewItemCreated && CompareIdls(m_itemShellInfo[internalIndex].pidlComplete.get(), m_pidlNewItem))
+		{
+			m_bNewItemCreated = FALSE;
+			newItem = internalIndex;
+		}
+	}
+
+	m_AwaitingAddList.clear();
+
+	m_virtualList->items.AddItems(internalIndices);
+
+	UpdateVirtualListView(focusedItem);
+
+	if (newItem != -1)
+	{
+		auto row = m_virtualList->items.GetRowForItem(newItem);
+
+		if (row)
+		{
+			m_iIndexNewItem = static_cast<int>(*row);
+		}
+	}
+}
+
+/* Removes items that have been deleted. */
+void ShellBrowser::RemoveVirtualItems(const std::vector<int> &internalIndices)
+{
+	int focusedItem = GetVirtualFocusedItem();
+
+	for (int internalIndex : internalIndices)
+	{
+		if (m_itemShellInfo[internalIndex].bInListView)
+		{
+			if (m_virtualList->items.IsItemSelected(internalIndex))
+			{
+				UpdateFileSelectionInfo(internalIndex, FALSE);
+			}
+
+			m_ulTotalDirSize.QuadPart -= m_itemStore.GetSize(internalIndex);
+			m_nTotalItems--;
+		}
+
+		m_virtualList->sortKeys.erase(internalIndex);
+		m_virtualList->itemInfo.erase(internalIndex);
+	}
+
+	m_virtualList->items.RemoveItems(internalIndices);
+
+	UpdateVirtualListView(focusedItem);
+}
+
+/* Hides items that the filter no longer shows. The filter
+has already been updated, so the rows only need to be
+rebuilt. */
+void ShellBrowser::HideVirtualItems(const std::vector<int> &internalIndices)
+{
+	int focusedItem = GetVirtualFocusedItem();
+
+	for (int internalIndex : internalIndices)
+	{
+		if (!m_itemShellInfo[internalIndex].bInListView)
+		{
+			continue;
+		}
+
+		if (m_virtualList->items.IsItemSelected(internalIndex))
+		{
+			UpdateFileSelectionInfo(internalIndex, FALSE);
+		}
+
+		m_ulTotalDirSize.QuadPart -= m_itemStore.GetSize(internalIndex);
+		m_itemShellInfo[internalIndex].bInListView = false;
+		m_nTotalItems--;
+	}
+
+	m_virtualList->items.SetFilter(m_virtualList->filter);
+
+	UpdateVirtualListView(focusedItem);
+}
+
+/* Shows items that the filter now shows. The items are
+already in sorted order within the model. */
+void ShellBrowser::ShowVirtualItems(const std::vector<int> &internalIndices)
+{
+	int focusedItem = GetVirtualFocusedItem();
+
+	for (int internalIndex : internalIndices)
+	{
+		if (m_itemShellInfo[internalIndex].bInListView)
+		{
+			continue;
+		}
+
+		m_ulTotalDirSize.QuadPart += m_itemStore.GetSize(internalIndex);
+		m_itemShellInfo[internalIndex].bInListView = true;
+		m_nTotalItems++;
+	}
+
+	m_virtualList->items.SetFilter(m_virtualList->filter);
+
+	UpdateVirtualListView(focusedItem);
+}
+
+/* The sort keys for every item are built up front (in
+parallel). Items added later have their keys built as
+they're merged in. */
+void ShellBrowser::SortVirtualItems()
+{
+	int focusedItem = GetVirtualFocusedItem();
+
+	std::vector<int> internalIndices;
+
+	for (int i = 0; i < m_itemStore.GetIdLimit(); i++)
+	{
+		if (m_itemStore.IsValidItem(i))
+		{
+			internalIndices.push_back(i);
+		}
+	}
+
+	std::vector<SortKey> sortKeys = BuildSortKeys(internalIndices);
+
+	m_virtualList->sortKeys.clear();
+	m_virtualList->sortKeys.reserve(internalIndices.size());
+
+	for (size_t i = 0; i < internalIndices.size(); i++)
+	{
+		m_virtualList->sortKeys.emplace(internalIndices[i], std::move(sortKeys[i]));
+	}
+
+	bool foldersFirst = !CompareVirtualFolders(CSIDL_BITBUCKET);
+
+	m_virtualList->items.SetSortOrder([this, foldersFirst] (int internalIndex1, int internalIndex2) {
+		return CompareItems(internalIndex1, GetVirtualSortKey(internalIndex1),
+			internalIndex2, GetVirtualSortKey(internalIndex2), foldersFirst) < 0;
+	});
+
+	UpdateVirtualListView(focusedItem);
+
+	/* The position of each item has changed, which affects
+	the order thumbnails are retrieved in. */
+	if (m_folderSettings.viewMode == +ViewMode::Thumbnails)
+	{
+		RefreshThumbnailItems();
+		UpdateThumbnailViewport();
+	}
+}
+
+/* References remain valid as other keys are added, so
+both keys used in a comparison can be retrieved here. */
+const SortKey &ShellBrowser::GetVirtualSortKey(int internalIndex)
+{
+	auto itr = m_virtualList->sortKeys.find(internalIndex);
+
+	if (itr == m_virtualList->sortKeys.end())
+	{
+		itr = m_virtualList->sortKeys.emplace(internalIndex, GetSortKey(internalIndex)).first;
+	}
+
+	return itr->second;
+}
+
+/* Called when the properties of an item have changed. The
+item is moved once the current batch of changes has been
+applied (see FlushVirtualItemChanges()). */
+void ShellBrowser::UpdateVirtualItem(int internalIndex)
+{
+	m_virtualList->sortKeys.erase(internalIndex);
+	m_virtualList->updatedItems.push_back(internalIndex);
+}
+
+/* Each change to the model costs a pass over every item,
+so directory changes are applied to it as a single batch. */
+void ShellBrowser::FlushVirtualItemChanges()
+{
+	InsertAwaitingItems(FALSE);
+
+	if (m_virtualList->updatedItems.empty())
+	{
+		return;
+	}
+
+	int focusedItem = GetVirtualFocusedItem();
+
+	m_virtualList->items.UpdateItems(m_virtualList->updatedItems);
+	m_virtualList->updatedItems.clear();
+
+	UpdateVirtualListView(focusedItem);
+}
+
+int ShellBrowser::GetVirtualFocusedItem() const
+{
+	int iFocused = ListView_GetNextItem(m_hListView, -1, LVNI_FOCUSED);
+
+	if (iFocused < 0 || static_cast<size_t>(iFocused) >= m_virtualList->items.GetNumRows())
+	{
+		return -1;
+	}
+
+	return m_virtualList->items.GetItemAtRow(iFocused);
+}
+
+/* Brings the listview into line with the model, once the
+model has changed. The listview holds the selection by row,
+so the selection (and the focused item) is moved to the
+rows the items are now in. */
+void ShellBrowser::UpdateVirtualListView(int focusedItem)
+{
+	auto &items = m_virtualList->items;
+	int numRows = static_cast<int>(items.GetNumRows());
+
+	ListView_SetItemCountEx(m_hListView, numRows, LVSICF_NOSCROLL);
+
+	m_virtualList->applyingSelection = true;
+
+	if (numRows > 0 && items.GetNumSelected() == static_cast<size_t>(numRows))
+	{
+		ListView_SetItemState(m_hListView, -1, LVIS_SELECTED, LVIS_SELECTED);
+	}
+	else
+	{
+		ListView_SetItemState(m_hListView, -1, 0, LVIS_SELECTED);
+
+		for (int internalIndex : items.GetSelectedItems())
+		{
+			int iItem = static_cast<int>(*items.GetRowForItem(internalIndex));
+			ListView_SetItemState(m_hListView, iItem, LVIS_SELECTED, LVIS_SELECTED);
+		}
+	}
+
+	if (focusedItem != -1)
+	{
+		auto row = items.GetRowForItem(focusedItem);
+
+		if (row)
+		{
+			ListView_SetItemState(m_hListView, static_cast<int>(*row), LVIS_FOCUSED, LVIS_FOCUSED);
+			ListView_SetSelectionMark(m_hListView, static_cast<int>(*row));
+		}
+	}
+
+	m_virtualList->applyingSelection = false;
+}
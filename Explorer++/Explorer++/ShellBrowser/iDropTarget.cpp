@@ -282,8 +282,7 @@ void ShellBrowser::HandleDragSelection(const POINT *ppt)
 		if(bOverItem)
 		{
 			/* Check for a clash (only if over a folder). */
-			if((m_itemInfoMap.at(iInternalIndex).wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
-				== FILE_ATTRIBUTE_DIRECTORY)
+			if(m_itemStore.IsFolder(iInternalIndex))
 			{
 				if(m_bDragging)
 				{
@@ -432,7 +431,7 @@ DWORD grfKeyState,POINTL ptl,DWORD *pdwEffect)
 		lvItem.iSubItem	= 0;
 		ListView_GetItem(m_hListView,&lvItem);
 
-		PathAppend(finalDestDirectory, m_itemInfoMap.at((int)lvItem.lParam).wfd.cFileName);
+		PathAppend(finalDestDirectory, m_itemStore.GetFileName((int)lvItem.lParam).data());
 	}
 
 	if(m_bDataAccept)
@@ -521,8 +520,8 @@ int CALLBACK SortTemporaryStub(LPARAM lParam1,LPARAM lParam2,LPARAM lParamSort)
 
 int CALLBACK ShellBrowser::SortTemporary(LPARAM lParam1,LPARAM lParam2)
 {
-	return m_itemInfoMap.at(static_cast<int>(lParam1)).iRelativeSort -
-		m_itemInfoMap.at(static_cast<int>(lParam2)).iRelativeSort;
+	return m_itemShellInfo[static_cast<int>(lParam1)].iRelativeSort -
+		m_itemShellInfo[static_cast<int>(lParam2)].iRelativeSort;
 }
 
 void ShellBrowser::RepositionLocalFiles(const POINT *ppt)
@@ -593,14 +592,14 @@ void ShellBrowser::RepositionLocalFiles(const POINT *ppt)
 					{
 						if(i == iItem)
 						{
-							m_itemInfoMap.at((int)lvItem.lParam).iRelativeSort = iInsert;
+							m_itemShellInfo[(int)lvItem.lParam].iRelativeSort = iInsert;
 						}
 						else
 						{
 							if(iSort == iInsert)
 								iSort++;
 
-							m_itemInfoMap.at((int)lvItem.lParam).iRelativeSort = iSort;
+							m_itemShellInfo[(int)lvItem.lParam].iRelativeSort = iSort;
 						}
 					}
 
@@ -608,6 +607,7 @@ void ShellBrowser::RepositionLocalFiles(const POINT *ppt)
 				}
 
 				ListView_SortItems(m_hListView,SortTemporaryStub,(LPARAM)this);
+				RebuildRowIndex();
 			}
 			else
 			{
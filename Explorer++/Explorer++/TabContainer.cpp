@@ -705,11 +705,12 @@ void TabContainer::SetTabIcon(const Tab &tab)
 	}
 	else
 	{
-		auto itr = m_cachedIcons->findByPath(tab.GetShellBrowser()->GetDirectory());
+		auto cachedIcon = m_cachedIcons->findIcon(tab.GetShellBrowser()->GetDirectory(),
+			CachedIcons::ItemType::Folder);
 
-		if (itr != m_cachedIcons->end())
+		if (cachedIcon)
 		{
-			SetTabIconFromSystemImageList(tab, itr->iconIndex);
+			SetTabIconFromSystemImageList(tab, cachedIcon->iconIndex);
 		}
 		else
 		{
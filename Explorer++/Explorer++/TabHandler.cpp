@@ -273,6 +273,12 @@ void Explorerplusplus::OnTabListViewSelectionChanged(const Tab &tab)
 
 	if (m_tabContainer->IsTabSelected(tab))
 	{
+		/* Folder sizes are only calculated for the selected
+		tab, so none of the calculations still in progress are
+		needed any more. */
+		m_folderSizeTasks.Cancel();
+		m_DWFolderSizes.clear();
+
 		SetTimer(m_hContainer, LISTVIEW_ITEM_CHANGED_TIMER_ID, LISTVIEW_ITEM_CHANGED_TIMEOUT, nullptr);
 	}
 }
\ No newline at end of file
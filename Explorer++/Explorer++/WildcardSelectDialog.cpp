@@ -8,6 +8,7 @@
 #include "MainResource.h"
 #include "ShellBrowser/ShellBrowser.h"
 #include "../Helper/BaseDialog.h"
+#include "../Helper/CompiledWildcard.h"
 #include "../Helper/Helper.h"
 #include "../Helper/ListViewHelper.h"
 #include "../Helper/Macros.h"
@@ -145,12 +146,14 @@ void WildcardSelectDialog::SelectItems(TCHAR *szPattern)
 
 	int nItems = ListView_GetItemCount(hListView);
 
+	CompiledWildcard compiledWildcard(szPattern, false);
+
 	for(int i = 0;i < nItems;i++)
 	{
 		TCHAR szFilename[MAX_PATH];
 		m_pexpp->GetActiveShellBrowser()->GetItemDisplayName(i,SIZEOF_ARRAY(szFilename),szFilename);
 
-		if(CheckWildcardMatch(szPattern,szFilename,FALSE) == 1)
+		if(compiledWildcard.Match(szFilename))
 		{
 			NListView::ListView_SelectItem(hListView,i,m_bSelect);
 		}
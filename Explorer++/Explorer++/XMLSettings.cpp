@@ -25,6 +25,7 @@
 #include "../DisplayWindow/DisplayWindow.h"
 #include "../Helper/Macros.h"
 #include "../Helper/ProcessHelper.h"
+#include "../Helper/ThumbnailLevels.h"
 #include "../Helper/XMLSettings.h"
 #include <boost/range/adaptor/map.hpp>
 #include <MsXml2.h>
@@ -109,6 +110,9 @@ will need to be changed correspondingly. */
 #define HASH_LARGETOOLBARICONS		10895007
 #define HASH_PLAYNAVIGATIONSOUND	1987363412
 #define HASH_ICON_THEME				3998265761
+#define HASH_THUMBNAILSIZE			1248073604
+#define HASH_THUMBNAILMEMORYBUDGET	65743613
+#define HASH_VIRTUALLISTVIEW		2982620611
 
 struct ColumnXMLSaveData
 {
@@ -583,9 +587,15 @@ IXMLDOMElement *pRoot)
 	NXMLSettings::AddWhiteSpaceToNode(pXMLDom,bstr_wsntt,pe);
 	NXMLSettings::WriteStandardSetting(pXMLDom,pe,_T("Setting"),_T("SynchronizeTreeview"),NXMLSettings::EncodeBoolValue(m_config->synchronizeTreeview));
 	NXMLSettings::AddWhiteSpaceToNode(pXMLDom,bstr_wsntt,pe);
+	NXMLSettings::WriteStandardSetting(pXMLDom,pe,_T("Setting"),_T("ThumbnailMemoryBudget"),NXMLSettings::EncodeIntValue(m_config->globalFolderSettings.thumbnailMemoryBudget));
+	NXMLSettings::AddWhiteSpaceToNode(pXMLDom,bstr_wsntt,pe);
+	NXMLSettings::WriteStandardSetting(pXMLDom,pe,_T("Setting"),_T("ThumbnailSize"),NXMLSettings::EncodeIntValue(m_config->globalFolderSettings.thumbnailSize));
+	NXMLSettings::AddWhiteSpaceToNode(pXMLDom,bstr_wsntt,pe);
 	NXMLSettings::WriteStandardSetting(pXMLDom,pe,_T("Setting"),_T("TVAutoExpandSelected"),NXMLSettings::EncodeBoolValue(m_config->treeViewAutoExpandSelected));
 	NXMLSettings::AddWhiteSpaceToNode(pXMLDom,bstr_wsntt,pe);
 	NXMLSettings::WriteStandardSetting(pXMLDom,pe,_T("Setting"),_T("UseFullRowSelect"),NXMLSettings::EncodeBoolValue(m_config->useFullRowSelect));
+	NXMLSettings::AddWhiteSpaceToNode(pXMLDom,bstr_wsntt,pe);
+	NXMLSettings::WriteStandardSetting(pXMLDom,pe,_T("Setting"),_T("VirtualListView"),NXMLSettings::EncodeBoolValue(m_config->virtualListView));
 
 	NXMLSettings::AddWhiteSpaceToNode(pXMLDom, bstr_wsntt, pe);
 	NXMLSettings::WriteStandardSetting(pXMLDom, pe, _T("Setting"), _T("IconTheme"), NXMLSettings::EncodeIntValue(m_config->iconTheme));
@@ -1695,6 +1705,14 @@ WCHAR *wszName,WCHAR *wszValue)
 		m_config->synchronizeTreeview = NXMLSettings::DecodeBoolValue(wszValue);
 		break;
 
+	case HASH_THUMBNAILMEMORYBUDGET:
+		m_config->globalFolderSettings.thumbnailMemoryBudget = (std::max)(NXMLSettings::DecodeIntValue(wszValue), MIN_THUMBNAIL_MEMORY_BUDGET);
+		break;
+
+	case HASH_THUMBNAILSIZE:
+		m_config->globalFolderSettings.thumbnailSize = ThumbnailLevels::ClampThumbnailSize(NXMLSettings::DecodeIntValue(wszValue));
+		break;
+
 	case HASH_TVAUTOEXPAND:
 		m_config->treeViewAutoExpandSelected = NXMLSettings::DecodeBoolValue(wszValue);
 		break;
@@ -1703,6 +1721,10 @@ WCHAR *wszName,WCHAR *wszValue)
 		m_config->useFullRowSelect = NXMLSettings::DecodeBoolValue(wszValue);
 		break;
 
+	case HASH_VIRTUALLISTVIEW:
+		m_config->virtualListView = NXMLSettings::DecodeBoolValue(wszValue);
+		break;
+
 	case HASH_TOOLBARSTATE:
 		MainToolbarPersistentSettings::GetInstance().LoadXMLSettings(pNode);
 		break;
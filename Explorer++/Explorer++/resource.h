@@ -329,6 +329,7 @@
 #define ID_RUN                          1324
 #define IDC_STATIC_COMMAND_LABEL        1326
 #define IDC_OPTIONS_ICON_THEME          1327
+#define IDC_OPTIONS_THUMBNAIL_SIZE      1328
 #define IDS_COLUMN_DESCRIPTION_NAME     2000
 #define IDS_COLUMN_DESCRIPTION_TYPE     2001
 #define IDS_COLUMN_DESCRIPTION_SIZE     2002
@@ -903,7 +904,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        322
 #define _APS_NEXT_COMMAND_VALUE         40526
-#define _APS_NEXT_CONTROL_VALUE         1328
+#define _APS_NEXT_CONTROL_VALUE         1329
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
 #endif
@@ -0,0 +1,580 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include "MpscQueue.h"
+#include "TaskExecutor.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Resolves requests on a TaskExecutor in batches, with each batch made up of
+// requests that share a batch key (e.g. items in the same folder). A request
+// that's identical to one that's already queued or being resolved is merged
+// into it, so the work is only done once and the result is delivered to
+// every caller that asked for it.
+//
+// Results are handed back in bulk. Workers queue each completed batch and
+// the owner is only notified (through the notification handler, which is
+// called on a worker thread) if there isn't already a notification
+// outstanding. The owner then calls DeliverResults() to receive everything
+// that's completed so far.
+//
+// Request records and batches are pooled, so once the pools have grown to
+// the number of outstanding requests, pushing a request doesn't allocate
+// (beyond anything Traits::Assign does).
+//
+// Traits must provide the following:
+//
+// - Key: the type that's passed to Push().
+// - Request: a copy of a key, which is kept until the request is delivered.
+// - Result: the result of resolving a request.
+// - Waiter: the data that's delivered along with a result (e.g. a callback).
+// - static size_t Hash(const Key &key)
+// - static size_t GetBatchKey(const Key &key)
+// - static bool Equals(const Request &request, const Key &key)
+// - static void Assign(Request &request, const Key &key), which should reuse
+//   the storage in the existing request, where possible.
+//
+// Other than the resolver and notification handler, every method has to be
+// called from the same thread.
+template <typename Traits>
+class BatchedRequestQueue
+{
+public:
+
+	using Key = typename Traits::Key;
+	using Request = typename Traits::Request;
+	using Result = typename Traits::Result;
+	using Waiter = typename Traits::Waiter;
+
+	struct BatchItem
+	{
+		const Request *request;
+		std::optional<Result> *result;
+	};
+
+	// Called on a worker thread. Should set the result of each item that can
+	// be resolved. Every item in a batch has the same batch key.
+	using BatchResolver = std::function<void(const std::vector<BatchItem> &items)>;
+
+	using NotificationHandler = std::function<void()>;
+
+	// Called once for each request, with every waiter that asked for it (in
+	// the order they asked).
+	using DeliveryHandler = std::function<void(const Request &request, const std::optional<Result> &result,
+		std::vector<Waiter> &waiters)>;
+
+	struct Statistics
+	{
+		uint64_t numRequests = 0;
+
+		// Requests that were merged into an identical request that was
+		// already queued or being resolved.
+		uint64_t numMerged = 0;
+
+		uint64_t numBatches = 0;
+		uint64_t numResolved = 0;
+		uint64_t numFailed = 0;
+
+		// Calls to DeliverResults() that delivered at least one result.
+		uint64_t numDeliveries = 0;
+
+		// The number of request records and batches that have been allocated.
+		// These stop growing once the pools are large enough.
+		size_t numRecordsAllocated = 0;
+		size_t numBatchesAllocated = 0;
+	};
+
+	// Batches are run as tasks of the specified kind (resolvers that may
+	// block on I/O should use TaskKind::Blocking).
+	BatchedRequestQueue(TaskExecutor &executor, BatchResolver batchResolver,
+		NotificationHandler notificationHandler, size_t maxBatchSize, size_t maxBatchesInFlight,
+		TaskKind taskKind = TaskKind::Normal) :
+		m_batchResolver(batchResolver),
+		m_notificationHandler(notificationHandler),
+		m_maxBatchSize((std::max)(maxBatchSize, static_cast<size_t>(1))),
+		m_maxBatchesInFlight((std::max)(maxBatchesInFlight, static_cast<size_t>(1))),
+		m_taskKind(taskKind),
+		m_generation(0),
+		m_notificationPending(false),
+		m_numLinkedRecords(0),
+		m_numBatchesInFlight(0),
+		m_numOutstanding(0),
+		m_tasks(executor)
+	{
+
+	}
+
+	BatchedRequestQueue(const BatchedRequestQueue &) = delete;
+	BatchedRequestQueue &operator=(const BatchedRequestQueue &) = delete;
+
+	void Push(const Key &key, Waiter waiter)
+	{
+		m_statistics.numRequests++;
+
+		size_t hash = Traits::Hash(key);
+		int existingIndex = FindRecord(key, hash);
+
+		if (existingIndex != NO_RECORD)
+		{
+			m_records[existingIndex].waiters.push_back(std::move(waiter));
+			m_statistics.numMerged++;
+			return;
+		}
+
+		int index = AllocateRecord();
+		Record &record = m_records[index];
+		Traits::Assign(record.request, key);
+		record.waiters.push_back(std::move(waiter));
+		record.hash = hash;
+		record.batchKey = Traits::GetBatchKey(key);
+		m_numOutstanding++;
+
+		// The record is linked before it's marked as queued, since linking can
+		// rehash every queued record.
+		LinkRecord(index);
+		record.state = RecordState::Queued;
+		AppendToGroup(index);
+		DispatchBatches();
+	}
+
+	// Queues a result that's already known (e.g. because it was cached). The
+	// result is delivered along with the next set of results, rather than
+	// from within this call.
+	void PushResult(const Key &key, Result result, Waiter waiter)
+	{
+		m_statistics.numRequests++;
+
+		int index = AllocateRecord();
+		Record &record = m_records[index];
+		Traits::Assign(record.request, key);
+		record.result = std::move(result);
+		record.waiters.push_back(std::move(waiter));
+		record.state = RecordState::Completed;
+		m_numOutstanding++;
+
+		m_completedRecords.push_back(index);
+
+		if (!m_notificationPending.exchange(true))
+		{
+			m_notificationHandler();
+		}
+	}
+
+	// Delivers every result that's available and returns the number of
+	// requests that were delivered. The handler can push new requests (or
+	// clear the queue).
+	size_t DeliverResults(const DeliveryHandler &handler)
+	{
+		// This needs to be reset before the queue is checked. Otherwise, a
+		// batch completed between the last check and the reset could go
+		// unnoticed.
+		m_notificationPending = false;
+
+		size_t numDelivered = 0;
+
+		// Results pushed by the handler are left until the next call.
+		size_t numCompletedRecords = m_completedRecords.size();
+
+		for (size_t i = 0; i < numCompletedRecords; i++)
+		{
+			numDelivered += DeliverRecord(m_completedRecords[i], handler);
+		}
+
+		m_completedRecords.erase(m_completedRecords.begin(), m_completedRecords.begin() + numCompletedRecords);
+
+		Batch *batch;
+
+		while (m_completedBatches.TryPop(batch))
+		{
+			for (int index : batch->records)
+			{
+				if (m_records[index].state == RecordState::InFlight)
+				{
+					UnlinkRecord(index);
+					m_records[index].state = RecordState::Completed;
+				}
+
+				numDelivered += DeliverRecord(index, handler);
+			}
+
+			m_numBatchesInFlight--;
+			m_freeBatches.push_back(batch);
+		}
+
+		if (numDelivered > 0)
+		{
+			m_statistics.numDeliveries++;
+		}
+
+		DispatchBatches();
+
+		return numDelivered;
+	}
+
+	// Drops every outstanding request. Requests that are being resolved will
+	// still finish, but their results will be discarded.
+	void Clear()
+	{
+		m_generation++;
+
+		for (const auto &group : m_groups)
+		{
+			for (int index = group.first; index != NO_RECORD; )
+			{
+				int next = m_records[index].nextQueued;
+				FreeRecord(index);
+				m_numOutstanding--;
+				index = next;
+			}
+		}
+
+		m_groups.clear();
+
+		// The remaining records are released once their batch (or the
+		// current delivery) is done with them.
+		for (auto &record : m_records)
+		{
+			if (record.state == RecordState::InFlight || record.state == RecordState::Completed)
+			{
+				record.state = RecordState::Abandoned;
+				record.waiters.clear();
+				m_numOutstanding--;
+			}
+		}
+
+		std::fill(m_buckets.begin(), m_buckets.end(), NO_RECORD);
+		m_numLinkedRecords = 0;
+	}
+
+	// The number of requests that have been pushed, but not yet delivered
+	// (excluding requests that were merged).
+	size_t GetNumOutstanding() const
+	{
+		return m_numOutstanding;
+	}
+
+	Statistics GetStatistics() const
+	{
+		return m_statistics;
+	}
+
+private:
+
+	static constexpr int NO_RECORD = -1;
+	static constexpr size_t MIN_BUCKETS = 16;
+
+	enum class RecordState
+	{
+		Free,
+		Queued,
+		InFlight,
+		Completed,
+		Delivering,
+		Abandoned
+	};
+
+	struct Record
+	{
+		Request request;
+		std::optional<Result> result;
+		std::vector<Waiter> waiters;
+		size_t hash = 0;
+		size_t batchKey = 0;
+		RecordState state = RecordState::Free;
+
+		// Records that are queued or in flight are chained together in the
+		// hash table, so that identical requests can be found.
+		int nextInBucket = NO_RECORD;
+
+		int nextQueued = NO_RECORD;
+	};
+
+	// The queued records that share a batch key, in the order they were
+	// pushed.
+	struct Group
+	{
+		size_t batchKey;
+		int first;
+		int last;
+	};
+
+	struct Batch
+	{
+		std::vector<int> records;
+		std::vector<BatchItem> items;
+		uint64_t generation;
+	};
+
+	int AllocateRecord()
+	{
+		if (m_freeRecords.empty())
+		{
+			// A deque is used, so that growing the pool doesn't move records
+			// that are being resolved.
+			m_records.emplace_back();
+			m_statistics.numRecordsAllocated++;
+			return static_cast<int>(m_records.size() - 1);
+		}
+
+		int index = m_freeRecords.back();
+		m_freeRecords.pop_back();
+		return index;
+	}
+
+	// The request is left as-is, so that its storage can be reused.
+	void FreeRecord(int index)
+	{
+		Record &record = m_records[index];
+		record.result.reset();
+		record.waiters.clear();
+		record.state = RecordState::Free;
+		record.nextInBucket = NO_RECORD;
+		record.nextQueued = NO_RECORD;
+		m_freeRecords.push_back(index);
+	}
+
+	int FindRecord(const Key &key, size_t hash) const
+	{
+		if (m_buckets.empty())
+		{
+			return NO_RECORD;
+		}
+
+		for (int index = m_buckets[hash & (m_buckets.size() - 1)]; index != NO_RECORD;
+			index = m_records[index].nextInBucket)
+		{
+			const Record &record = m_records[index];
+
+			if (record.hash == hash && Traits::Equals(record.request, key))
+			{
+				return index;
+			}
+		}
+
+		return NO_RECORD;
+	}
+
+	void LinkRecord(int index)
+	{
+		if (m_numLinkedRecords + 1 > m_buckets.size())
+		{
+			Rehash((std::max)(MIN_BUCKETS, m_buckets.size() * 2));
+		}
+
+		Record &record = m_records[index];
+		int &bucket = m_buckets[record.hash & (m_buckets.size() - 1)];
+		record.nextInBucket = bucket;
+		bucket = index;
+		m_numLinkedRecords++;
+	}
+
+	void UnlinkRecord(int index)
+	{
+		Record &record = m_records[index];
+		int *link = &m_buckets[record.hash & (m_buckets.size() - 1)];
+
+		while (*link != index)
+		{
+			link = &m_records[*link].nextInBucket;
+		}
+
+		*link = record.nextInBucket;
+		record.nextInBucket = NO_RECORD;
+		m_numLinkedRecords--;
+	}
+
+	void Rehash(size_t numBuckets)
+	{
+		m_buckets.assign(numBuckets, NO_RECORD);
+
+		for (size_t i = 0; i < m_records.size(); i++)
+		{
+			Record &record = m_records[i];
+
+			if (record.state != RecordState::Queued && record.state != RecordState::InFlight)
+			{
+				continue;
+			}
+
+			int &bucket = m_buckets[record.hash & (numBuckets - 1)];
+			record.nextInBucket = bucket;
+			bucket = static_cast<int>(i);
+		}
+	}
+
+	void AppendToGroup(int index)
+	{
+		Record &record = m_records[index];
+		record.nextQueued = NO_RECORD;
+
+		// There are generally only a handful of distinct batch keys
+		// outstanding at once, so a linear search is sufficient.
+		auto itr = std::find_if(m_groups.begin(), m_groups.end(), [&record] (const Group &group) {
+			return group.batchKey == record.batchKey;
+		});
+
+		if (itr == m_groups.end())
+		{
+			m_groups.push_back({ record.batchKey, index, index });
+			return;
+		}
+
+		m_records[itr->last].nextQueued = index;
+		itr->last = index;
+	}
+
+	// Groups are served in the order they were first queued.
+	void DispatchBatches()
+	{
+		while (m_numBatchesInFlight < m_maxBatchesInFlight && !m_groups.empty())
+		{
+			Batch *batch = AllocateBatch();
+			batch->generation = m_generation;
+
+			Group &group = m_groups.front();
+
+			while (group.first != NO_RECORD && batch->records.size() < m_maxBatchSize)
+			{
+				int index = group.first;
+				Record &record = m_records[index];
+				record.state = RecordState::InFlight;
+				group.first = record.nextQueued;
+				record.nextQueued = NO_RECORD;
+
+				batch->records.push_back(index);
+				batch->items.push_back({ &record.request, &record.result });
+			}
+
+			if (group.first == NO_RECORD)
+			{
+				m_groups.erase(m_groups.begin());
+			}
+
+			m_numBatchesInFlight++;
+			m_statistics.numBatches++;
+
+			m_tasks.Push(TaskPriority::Visible, [this, batch] {
+				RunBatch(batch);
+			}, m_taskKind);
+		}
+	}
+
+	Batch *AllocateBatch()
+	{
+		Batch *batch;
+
+		if (m_freeBatches.empty())
+		{
+			m_batches.push_back(std::make_unique<Batch>());
+			m_statistics.numBatchesAllocated++;
+			batch = m_batches.back().get();
+		}
+		else
+		{
+			batch = m_freeBatches.back();
+			m_freeBatches.pop_back();
+		}
+
+		batch->records.clear();
+		batch->items.clear();
+
+		return batch;
+	}
+
+	// Runs on a worker thread. Only the requests and results of the records in
+	// the batch are accessed here; nothing else in the record is touched
+	// until the batch has been delivered.
+	void RunBatch(Batch *batch)
+	{
+		if (batch->generation == m_generation)
+		{
+			m_batchResolver(batch->items);
+		}
+
+		m_completedBatches.Push(batch);
+
+		// If a notification has already been sent, but not yet handled, this
+		// batch will be picked up when it is.
+		if (!m_notificationPending.exchange(true))
+		{
+			m_notificationHandler();
+		}
+	}
+
+	size_t DeliverRecord(int index, const DeliveryHandler &handler)
+	{
+		Record &record = m_records[index];
+
+		if (record.state == RecordState::Abandoned)
+		{
+			FreeRecord(index);
+			return 0;
+		}
+
+		// The record is marked, so that it won't be touched if the handler
+		// clears the queue. Records are held in a deque, so the reference
+		// remains valid, even if the handler pushes new requests.
+		record.state = RecordState::Delivering;
+		m_numOutstanding--;
+
+		if (record.result)
+		{
+			m_statistics.numResolved++;
+		}
+		else
+		{
+			m_statistics.numFailed++;
+		}
+
+		handler(record.request, record.result, record.waiters);
+
+		FreeRecord(index);
+
+		return 1;
+	}
+
+	const BatchResolver m_batchResolver;
+	const NotificationHandler m_notificationHandler;
+	const size_t m_maxBatchSize;
+	const size_t m_maxBatchesInFlight;
+	const TaskKind m_taskKind;
+
+	// Incremented whenever the queue is cleared. Workers skip batches from a
+	// previous generation.
+	std::atomic<uint64_t> m_generation;
+
+	std::atomic<bool> m_notificationPending;
+
+	std::deque<Record> m_records;
+	std::vector<int> m_freeRecords;
+
+	// The size is always a power of two.
+	std::vector<int> m_buckets;
+	size_t m_numLinkedRecords;
+
+	std::vector<Group> m_groups;
+
+	std::vector<std::unique_ptr<Batch>> m_batches;
+	std::vector<Batch *> m_freeBatches;
+	size_t m_numBatchesInFlight;
+
+	MpscQueue<Batch *> m_completedBatches;
+	std::vector<int> m_completedRecords;
+
+	size_t m_numOutstanding;
+	Statistics m_statistics;
+
+	// Destroyed first, so that any running batches finish before the rest of
+	// the queue goes away.
+	TaskGroup m_tasks;
+};
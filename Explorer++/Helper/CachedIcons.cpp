@@ -4,64 +4,474 @@
 
 #include "stdafx.h"
 #include "CachedIcons.h"
-#include "ShellHelper.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstring>
+#include <cwctype>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
 
-CachedIcons::CachedIcons(std::size_t maxItems) :
-	m_maxItems(maxItems)
+/* The cache file consists of a header, followed by a record for each class
+entry and then a record for each path entry. Each record is followed by its
+key (the class or path) and the path of the file the icon is loaded from.
+As with the other cache files, every record and string starts on an 8 byte
+boundary.
+
+Path entries are written in order of use (most recent first), so that
+loading a file with more entries than the cache can hold drops the least
+recently used entries. */
+namespace
+{
+	const char FILE_MAGIC[8] = { 'E', 'X', 'P', 'I', 'C', 'O', 'N', 'S' };
+	const uint32_t FILE_VERSION = 1;
+
+	struct FileHeader
+	{
+		char magic[8];
+		uint32_t version;
+
+		// Strings are stored as wchar_t, so a cache file can only be used
+		// on the platform it was written on.
+		uint32_t charSize;
+
+		uint32_t numClassEntries;
+		uint32_t numPathEntries;
+	};
+
+	struct EntryRecord
+	{
+		int32_t iconIndex;
+		uint32_t keyLength;
+		uint32_t iconPathLength;
+		uint32_t reserved;
+	};
+
+	static_assert(sizeof(FileHeader) % 8 == 0 && sizeof(EntryRecord) % 8 == 0,
+		"Cache file records must be a multiple of 8 bytes in size");
+
+	// The upper eight bits of an icon index returned with SHGFI_OVERLAYINDEX
+	// hold the overlay index.
+	const int ICON_INDEX_MASK = 0x00FFFFFF;
+
+	// File types whose icon is taken from (or depends on) the file itself.
+	// Each of these files is cached individually.
+	const wchar_t *const PER_ITEM_ICON_EXTENSIONS[] = {
+		L"ani", L"appref-ms", L"cpl", L"cur", L"exe", L"ico", L"library-ms", L"lnk", L"msc", L"pif", L"scr",
+		L"url", L"website"
+	};
+
+	// Only files that are actually in the file system (or on a network
+	// share) are cached at the class level. Virtual items (whose parsing
+	// names start with "::") can have any icon.
+	bool IsFileSystemPath(std::wstring_view path)
+	{
+		if (path.size() >= 3 && path[1] == ':' && (path[2] == '\\' || path[2] == '/'))
+		{
+			return true;
+		}
+
+		return path.size() >= 2 && path[0] == '\\' && path[1] == '\\';
+	}
+
+	size_t AlignTo8(size_t size)
+	{
+		return (size + 7) & ~static_cast<size_t>(7);
+	}
+
+	class CacheFileReader
+	{
+	public:
+
+		CacheFileReader(const uint8_t *data, size_t size) :
+			m_data(data),
+			m_size(size),
+			m_offset(0)
+		{
+
+		}
+
+		template <typename T>
+		const T *Read()
+		{
+			return reinterpret_cast<const T *>(ReadBytes(sizeof(T)));
+		}
+
+		const wchar_t *ReadString(size_t length)
+		{
+			if (length > (m_size / sizeof(wchar_t)))
+			{
+				return nullptr;
+			}
+
+			return reinterpret_cast<const wchar_t *>(ReadBytes(AlignTo8(length * sizeof(wchar_t))));
+		}
+
+	private:
+
+		const uint8_t *ReadBytes(size_t numBytes)
+		{
+			if (numBytes > m_size - m_offset)
+			{
+				return nullptr;
+			}
+
+			const uint8_t *bytes = m_data + m_offset;
+			m_offset += numBytes;
+
+			return bytes;
+		}
+
+		const uint8_t *m_data;
+		size_t m_size;
+		size_t m_offset;
+	};
+
+	void AppendBytes(std::vector<uint8_t> &buffer, const void *data, size_t size)
+	{
+		auto bytes = static_cast<const uint8_t *>(data);
+		buffer.insert(buffer.end(), bytes, bytes + size);
+	}
+
+	void AppendString(std::vector<uint8_t> &buffer, std::wstring_view str)
+	{
+		size_t size = str.size() * sizeof(wchar_t);
+		AppendBytes(buffer, str.data(), size);
+		buffer.resize(buffer.size() + (AlignTo8(size) - size), 0);
+	}
+
+	void AppendEntry(std::vector<uint8_t> &buffer, std::wstring_view key, const IconLocation &iconLocation)
+	{
+		EntryRecord entryRecord;
+		entryRecord.iconIndex = iconLocation.index;
+		entryRecord.keyLength = static_cast<uint32_t>(key.size());
+		entryRecord.iconPathLength = static_cast<uint32_t>(iconLocation.path.size());
+		entryRecord.reserved = 0;
+		AppendBytes(buffer, &entryRecord, sizeof(entryRecord));
+		AppendString(buffer, key);
+		AppendString(buffer, iconLocation.path);
+	}
+}
+
+CachedIcons::CachedIcons(std::size_t maxItems, IconLocationResolver iconLocationResolver) :
+	m_maxItems(maxItems),
+	m_iconLocationResolver(iconLocationResolver)
+{
+
+}
+
+std::optional<std::wstring> CachedIcons::getIconClass(std::wstring_view filePath, ItemType itemType)
+{
+	if (itemType == ItemType::Folder || !IsFileSystemPath(filePath))
+	{
+		return std::nullopt;
+	}
+
+	size_t separator = filePath.find_last_of(L"\\/");
+	size_t dot = filePath.find_last_of(L'.');
+
+	if (dot == std::wstring_view::npos || dot < separator || dot == filePath.size() - 1)
+	{
+		// Files without an extension don't have a type.
+		return std::nullopt;
+	}
+
+	std::wstring extension(filePath.substr(dot + 1));
+	std::transform(extension.begin(), extension.end(), extension.begin(), [] (wchar_t c) {
+		return static_cast<wchar_t>(std::towlower(c));
+	});
+
+	if (std::find(std::begin(PER_ITEM_ICON_EXTENSIONS), std::end(PER_ITEM_ICON_EXTENSIONS), extension)
+		!= std::end(PER_ITEM_ICON_EXTENSIONS))
+	{
+		return std::nullopt;
+	}
+
+	return extension;
+}
+
+bool CachedIcons::load(const std::wstring &cacheFilePath)
+{
+	clear();
+
+	auto mappedFile = MappedFile::Open(cacheFilePath);
+
+	if (!mappedFile)
+	{
+		return false;
+	}
+
+	CacheFileReader reader(mappedFile->GetData(), mappedFile->GetSize());
+	auto header = reader.Read<FileHeader>();
+
+	if (!header || memcmp(header->magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0
+		|| header->version != FILE_VERSION || header->charSize != sizeof(wchar_t))
+	{
+		return false;
+	}
+
+	uint64_t numEntries = static_cast<uint64_t>(header->numClassEntries) + header->numPathEntries;
+
+	for (uint64_t i = 0; i < numEntries; i++)
+	{
+		auto entryRecord = reader.Read<EntryRecord>();
+		const wchar_t *key = entryRecord ? reader.ReadString(entryRecord->keyLength) : nullptr;
+		const wchar_t *iconPath = key ? reader.ReadString(entryRecord->iconPathLength) : nullptr;
+
+		if (!iconPath)
+		{
+			clear();
+			return false;
+		}
+
+		Entry entry;
+		entry.iconLocation = IconLocation{ { iconPath, entryRecord->iconPathLength }, entryRecord->iconIndex };
+
+		if (i < header->numClassEntries)
+		{
+			m_classEntries.insert({ { key, entryRecord->keyLength }, entry });
+		}
+		else if (m_pathEntries.size() < m_maxItems)
+		{
+			// Since the file is ordered from most to least recently used,
+			// each entry goes at the back.
+			m_pathEntries.push_back({ { key, entryRecord->keyLength }, entry });
+		}
+	}
+
+	return true;
+}
+
+bool CachedIcons::save(const std::wstring &cacheFilePath) const
 {
+	std::vector<std::pair<std::wstring_view, const IconLocation *>> classEntries;
+
+	for (const auto &classEntry : m_classEntries)
+	{
+		if (classEntry.second.iconLocation)
+		{
+			classEntries.emplace_back(classEntry.first, &*classEntry.second.iconLocation);
+		}
+	}
+
+	size_t numPathEntries = std::count_if(m_pathEntries.begin(), m_pathEntries.end(), [] (const PathEntry &pathEntry) {
+		return pathEntry.entry.iconLocation.has_value();
+	});
+
+	std::vector<uint8_t> buffer;
+
+	FileHeader header;
+	memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+	header.version = FILE_VERSION;
+	header.charSize = sizeof(wchar_t);
+	header.numClassEntries = static_cast<uint32_t>(classEntries.size());
+	header.numPathEntries = static_cast<uint32_t>(numPathEntries);
+	AppendBytes(buffer, &header, sizeof(header));
+
+	for (const auto &classEntry : classEntries)
+	{
+		AppendEntry(buffer, classEntry.first, *classEntry.second);
+	}
+
+	for (const auto &pathEntry : m_pathEntries)
+	{
+		if (pathEntry.entry.iconLocation)
+		{
+			AppendEntry(buffer, pathEntry.filePath, *pathEntry.entry.iconLocation);
+		}
+	}
+
+	// The cache is written to a temporary file first, so that a failed
+	// write won't leave a partial file behind.
+	std::filesystem::path finalPath(cacheFilePath);
+	std::filesystem::path temporaryPath(cacheFilePath + L".tmp");
+
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
 
+		if (!file)
+		{
+			return false;
+		}
+
+		file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+
+		if (!file)
+		{
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, finalPath, error);
+
+	if (error)
+	{
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+
+	return true;
 }
 
-CachedIcons::iterator CachedIcons::end()
+std::optional<CachedIcon> CachedIcons::findIcon(const std::wstring &filePath, ItemType itemType)
 {
-	CachedIconSetByPath &pathIndex = m_cachedIconSet.get<1>();
-	return pathIndex.end();
+	auto iconClass = getIconClass(filePath, itemType);
+
+	if (iconClass)
+	{
+		auto itr = m_classEntries.find(*iconClass);
+
+		if (itr != m_classEntries.end())
+		{
+			if (resolveEntry(itr->second))
+			{
+				m_statistics.numClassHits++;
+				return CachedIcon{ *itr->second.iconIndex, CachedIcon::Level::Class };
+			}
+
+			m_classEntries.erase(itr);
+		}
+
+		m_statistics.numMisses++;
+		return std::nullopt;
+	}
+
+	auto &pathIndex = m_pathEntries.get<1>();
+	auto itr = pathIndex.find(filePath);
+
+	if (itr != pathIndex.end())
+	{
+		Entry entry = itr->entry;
+
+		if (resolveEntry(entry))
+		{
+			if (!itr->entry.iconIndex)
+			{
+				pathIndex.modify(itr, [&entry] (PathEntry &pathEntry) {
+					pathEntry.entry = entry;
+				});
+			}
+
+			m_statistics.numPathHits++;
+			return CachedIcon{ *entry.iconIndex, CachedIcon::Level::Path };
+		}
+
+		pathIndex.erase(itr);
+	}
+
+	m_statistics.numMisses++;
+	return std::nullopt;
 }
 
-void CachedIcons::addOrUpdateFileIcon(const std::wstring &filePath, int iconIndex)
+void CachedIcons::addOrUpdateFileIcon(const std::wstring &filePath, ItemType itemType, int iconIndex,
+	const std::optional<IconLocation> &iconLocation)
 {
-	auto cachedItr = findByPath(filePath);
+	auto iconClass = getIconClass(filePath, itemType);
+
+	if (iconClass)
+	{
+		Entry &entry = m_classEntries[*iconClass];
+		entry = mergeEntry(entry, iconIndex & ICON_INDEX_MASK, iconLocation);
+		return;
+	}
+
+	PathEntry pathEntry;
+	pathEntry.filePath = filePath;
 
-	if (cachedItr != end())
+	auto &pathIndex = m_pathEntries.get<1>();
+	auto itr = pathIndex.find(filePath);
+
+	if (itr != pathIndex.end())
 	{
-		CachedIcon existingCachedIcon = *cachedItr;
-		existingCachedIcon.iconIndex = iconIndex;
-		replace(cachedItr, existingCachedIcon);
+		// The entry is moved to the front of the list, which will stop it
+		// from being removed if the list grows over the maximum allowed size
+		// (the first entries to be removed are those at the back of the
+		// list).
+		pathEntry.entry = mergeEntry(itr->entry, iconIndex, iconLocation);
+		pathIndex.erase(itr);
 	}
 	else
 	{
-		CachedIcon cachedIcon;
-		cachedIcon.filePath = filePath;
-		cachedIcon.iconIndex = iconIndex;
-		insert(cachedIcon);
+		pathEntry.entry.iconIndex = iconIndex;
+		pathEntry.entry.iconLocation = iconLocation;
 	}
+
+	insertPathEntry(std::move(pathEntry));
 }
 
-void CachedIcons::insert(const CachedIcon &cachedIcon)
+void CachedIcons::clear()
 {
-	m_cachedIconSet.push_front(cachedIcon);
+	m_classEntries.clear();
+	m_pathEntries.clear();
+}
 
-	if (m_cachedIconSet.size() > m_maxItems)
+std::size_t CachedIcons::getNumClassEntries() const
+{
+	return m_classEntries.size();
+}
+
+std::size_t CachedIcons::getNumPathEntries() const
+{
+	return m_pathEntries.size();
+}
+
+CachedIcons::Statistics CachedIcons::getStatistics() const
+{
+	return m_statistics;
+}
+
+// If no location is given, the existing location is kept, as long as the
+// icon itself hasn't changed.
+CachedIcons::Entry CachedIcons::mergeEntry(const Entry &existingEntry, int iconIndex,
+	const std::optional<IconLocation> &iconLocation)
+{
+	Entry entry;
+	entry.iconIndex = iconIndex;
+	entry.iconLocation = iconLocation;
+
+	if (!iconLocation && existingEntry.iconIndex
+		&& (*existingEntry.iconIndex & ICON_INDEX_MASK) == (iconIndex & ICON_INDEX_MASK))
 	{
-		m_cachedIconSet.pop_back();
+		entry.iconLocation = existingEntry.iconLocation;
 	}
+
+	return entry;
 }
 
-// Replaces an existing cached icon. The icon will also be moved to the
-// front of the list, which will stop it from being removed if the list
-// grows over the maximum allowed size (the first icons to be removed
-// are those at the back of the list).
-void CachedIcons::replace(CachedIconSetByPath::iterator itr, const CachedIcon &cachedIcon)
+bool CachedIcons::resolveEntry(Entry &entry)
 {
-	CachedIconSetByPath &pathIndex = m_cachedIconSet.get<1>();
-	pathIndex.replace(itr, cachedIcon);
+	if (entry.iconIndex)
+	{
+		return true;
+	}
+
+	std::optional<int> iconIndex;
+
+	if (entry.iconLocation && m_iconLocationResolver)
+	{
+		iconIndex = m_iconLocationResolver(*entry.iconLocation);
+	}
+
+	if (!iconIndex)
+	{
+		m_statistics.numUnresolved++;
+		return false;
+	}
+
+	entry.iconIndex = iconIndex;
 
-	auto sequenceItr = m_cachedIconSet.iterator_to(*itr);
-	m_cachedIconSet.relocate(m_cachedIconSet.begin(), sequenceItr);
+	return true;
 }
 
-CachedIcons::iterator CachedIcons::findByPath(const std::wstring &filePath)
+void CachedIcons::insertPathEntry(PathEntry pathEntry)
 {
-	CachedIconSetByPath &pathIndex = m_cachedIconSet.get<1>();
-	return pathIndex.find(filePath);
-}
\ No newline at end of file
+	m_pathEntries.push_front(std::move(pathEntry));
+
+	if (m_pathEntries.size() > m_maxItems)
+	{
+		m_pathEntries.pop_back();
+		m_statistics.numEvicted++;
+	}
+}
@@ -8,40 +8,147 @@
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/sequenced_index.hpp>
-#include <boost/optional.hpp>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// The file an icon is loaded from, along with its index within that file.
+// Unlike a system image list index, this remains valid across sessions.
+struct IconLocation
+{
+	std::wstring path;
+	int index;
+};
 
 struct CachedIcon
 {
-	std::wstring filePath;
+	enum class Level
+	{
+		// The icon is shared by every file of the same type.
+		Class,
+
+		// The icon is specific to the item.
+		Path
+	};
+
 	int iconIndex;
+	Level level;
 };
 
+// Caches the system image list index of each item's icon. Most files have an
+// icon that depends only on their type, so those icons are cached at the
+// class level (keyed by the file extension) and a single entry covers every
+// file of that type. Only items that can have their own icon (folders, as
+// well as executables, shortcuts, icon files, etc) have an entry for their
+// full path. Path entries are limited in number, with the least recently
+// updated entries being removed first.
+//
+// The cache can be saved to disk and loaded again later. System image list
+// indexes are only valid within a single session, so it's the location of
+// each icon that's saved. Once loaded, an entry is turned back into an index
+// (using the resolver passed in) the first time it's found. Entries added
+// without a location aren't saved.
+//
+// This class isn't thread-safe.
 class CachedIcons
 {
 public:
 
+	enum class ItemType
+	{
+		File,
+		Folder
+	};
+
+	// Returns the system image list index for the icon at the specified
+	// location, if it can be loaded.
+	using IconLocationResolver = std::function<std::optional<int>(const IconLocation &location)>;
+
+	struct Statistics
+	{
+		uint64_t numClassHits = 0;
+		uint64_t numPathHits = 0;
+		uint64_t numMisses = 0;
+
+		// Entries loaded from disk whose icon could no longer be loaded.
+		uint64_t numUnresolved = 0;
+
+		uint64_t numEvicted = 0;
+	};
+
+	CachedIcons(std::size_t maxItems, IconLocationResolver iconLocationResolver = nullptr);
+
+	// Returns the class (i.e. the lowercase extension) that determines the
+	// item's icon, or nothing if the item can have an icon of its own.
+	static std::optional<std::wstring> getIconClass(std::wstring_view filePath, ItemType itemType);
+
+	// Replaces the contents of the cache with the contents of the specified
+	// file. Returns false (leaving the cache empty) if the file doesn't exist
+	// or isn't a valid cache file.
+	bool load(const std::wstring &cacheFilePath);
+
+	// Writes the cache to the specified file, replacing it if it already
+	// exists.
+	bool save(const std::wstring &cacheFilePath) const;
+
+	std::optional<CachedIcon> findIcon(const std::wstring &filePath, ItemType itemType);
+
+	// The icon index may include an overlay index in its upper eight bits.
+	// Overlays are specific to an item, so they're dropped from class level
+	// entries.
+	void addOrUpdateFileIcon(const std::wstring &filePath, ItemType itemType, int iconIndex,
+		const std::optional<IconLocation> &iconLocation = std::nullopt);
+
+	void clear();
+
+	std::size_t getNumClassEntries() const;
+	std::size_t getNumPathEntries() const;
+	Statistics getStatistics() const;
+
+private:
+
+	struct Entry
+	{
+		// Empty for entries loaded from disk that haven't been looked up yet.
+		std::optional<int> iconIndex;
+
+		std::optional<IconLocation> iconLocation;
+	};
+
+	struct PathEntry
+	{
+		std::wstring filePath;
+		Entry entry;
+	};
+
 	typedef boost::multi_index_container<
-		CachedIcon,
+		PathEntry,
 		boost::multi_index::indexed_by<
 			boost::multi_index::sequenced<>,
-			boost::multi_index::hashed_unique<boost::multi_index::member<CachedIcon, std::wstring, &CachedIcon::filePath>>
+			boost::multi_index::hashed_unique<boost::multi_index::member<PathEntry, std::wstring, &PathEntry::filePath>>
 		>
-	> CachedIconSet;
+	> PathEntrySet;
 
-	typedef CachedIconSet::nth_index<1>::type CachedIconSetByPath;
-	typedef CachedIconSetByPath::iterator iterator;
+	static Entry mergeEntry(const Entry &existingEntry, int iconIndex, const std::optional<IconLocation> &iconLocation);
 
-	CachedIcons(std::size_t maxItems);
+	// Fills in the icon index for an entry loaded from disk. Returns false if
+	// the icon couldn't be loaded.
+	bool resolveEntry(Entry &entry);
 
-	iterator end();
+	void insertPathEntry(PathEntry pathEntry);
 
-	void addOrUpdateFileIcon(const std::wstring &filePath, int iconIndex);
-	void insert(const CachedIcon &cachedIcon);
-	void replace(CachedIconSetByPath::iterator itr, const CachedIcon &cachedIcon);
-	iterator findByPath(const std::wstring &filePath);
+	const std::size_t m_maxItems;
+	const IconLocationResolver m_iconLocationResolver;
 
-private:
+	// The number of distinct file types is small, so class entries are
+	// never removed.
+	std::unordered_map<std::wstring, Entry> m_classEntries;
+
+	// Ordered from most to least recently updated.
+	PathEntrySet m_pathEntries;
 
-	CachedIconSet m_cachedIconSet;
-	std::size_t m_maxItems;
-};
\ No newline at end of file
+	Statistics m_statistics;
+};
@@ -0,0 +1,317 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "ChangeJournal.h"
+#include <algorithm>
+
+ChangeJournal::ChangeJournal(size_t maxEntries) :
+	m_maxEntries(maxEntries),
+	m_overflowed(false),
+	m_numEvents(0),
+	m_nextSequence(0)
+{
+
+}
+
+void ChangeJournal::AddEvent(Action action, std::wstring_view fileName)
+{
+	m_numEvents++;
+
+	if (m_overflowed)
+	{
+		return;
+	}
+
+	/* Renames are always reported as an old name event
+	immediately followed by a new name event. Anything else
+	means that the new name was never received. */
+	if (m_pendingRename && action != Action::RenamedNewName)
+	{
+		ResolvePendingRename();
+	}
+
+	switch (action)
+	{
+	case Action::Added:
+		OnAdded(fileName);
+		break;
+
+	case Action::Removed:
+		OnRemoved(fileName);
+		break;
+
+	case Action::Modified:
+		OnModified(fileName);
+		break;
+
+	case Action::RenamedOldName:
+		OnRenamedOldName(fileName);
+		break;
+
+	case Action::RenamedNewName:
+		OnRenamedNewName(fileName);
+		break;
+	}
+
+	CheckOverflow();
+}
+
+void ChangeJournal::OnAdded(std::wstring_view fileName)
+{
+	std::wstring name(fileName);
+	auto itr = m_entries.find(name);
+
+	if (itr != m_entries.end())
+	{
+		/* The item is already known about, so the best that
+		can be done is to refresh it. */
+		itr->second.modified = true;
+		return;
+	}
+
+	/* If an item with this name existed originally and was
+	removed, it will still be reported as removed (ahead of
+	this addition). */
+	m_entries.insert({ std::move(name), { false, L"", false, m_nextSequence++ } });
+}
+
+void ChangeJournal::OnRemoved(std::wstring_view fileName)
+{
+	std::wstring name(fileName);
+	auto itr = m_entries.find(name);
+
+	if (itr == m_entries.end())
+	{
+		m_removed.insert({ std::move(name), m_nextSequence++ });
+		return;
+	}
+
+	RemoveEntry(itr->second);
+	m_entries.erase(itr);
+}
+
+void ChangeJournal::OnModified(std::wstring_view fileName)
+{
+	std::wstring name(fileName);
+	auto itr = m_entries.find(name);
+
+	if (itr != m_entries.end())
+	{
+		itr->second.modified = true;
+		return;
+	}
+
+	m_entries.insert({ name, { true, name, true, m_nextSequence++ } });
+}
+
+void ChangeJournal::OnRenamedOldName(std::wstring_view fileName)
+{
+	std::wstring name(fileName);
+	auto itr = m_entries.find(name);
+
+	if (itr != m_entries.end())
+	{
+		m_pendingRename = std::move(itr->second);
+		m_entries.erase(itr);
+	}
+	else
+	{
+		m_pendingRename = Entry{ true, name, false, m_nextSequence++ };
+	}
+}
+
+void ChangeJournal::OnRenamedNewName(std::wstring_view fileName)
+{
+	if (!m_pendingRename)
+	{
+		/* There's no item to rename, so this is equivalent to
+		the item simply appearing. */
+		OnAdded(fileName);
+		return;
+	}
+
+	std::wstring name(fileName);
+	auto itr = m_entries.find(name);
+
+	if (itr != m_entries.end())
+	{
+		/* Something already has this name. It must have gone
+		away, otherwise the rename couldn't have succeeded. */
+		RemoveEntry(itr->second);
+		m_entries.erase(itr);
+	}
+
+	m_entries.insert({ std::move(name), std::move(*m_pendingRename) });
+	m_pendingRename.reset();
+}
+
+void ChangeJournal::RemoveEntry(const Entry &entry)
+{
+	/* An item that was added during this batch simply
+	disappears. */
+	if (entry.existing)
+	{
+		m_removed.insert({ entry.originalName, entry.sequence });
+	}
+}
+
+void ChangeJournal::ResolvePendingRename()
+{
+	RemoveEntry(*m_pendingRename);
+	m_pendingRename.reset();
+}
+
+void ChangeJournal::CheckOverflow()
+{
+	if ((m_entries.size() + m_removed.size()) <= m_maxEntries)
+	{
+		return;
+	}
+
+	m_overflowed = true;
+
+	m_entries.clear();
+	m_removed.clear();
+	m_pendingRename.reset();
+}
+
+bool ChangeJournal::IsEmpty() const
+{
+	return !m_overflowed && m_entries.empty() && m_removed.empty() && !m_pendingRename;
+}
+
+size_t ChangeJournal::GetNumEvents() const
+{
+	return m_numEvents;
+}
+
+ChangeJournal::Changes ChangeJournal::TakeChanges()
+{
+	if (m_pendingRename)
+	{
+		ResolvePendingRename();
+	}
+
+	Changes changes;
+	changes.overflowed = m_overflowed;
+
+	std::vector<std::pair<uint64_t, std::wstring>> removed;
+	std::vector<std::pair<uint64_t, Rename>> renamed;
+	std::vector<std::pair<uint64_t, std::wstring>> modified;
+	std::vector<std::pair<uint64_t, std::wstring>> added;
+
+	for (auto &removedItem : m_removed)
+	{
+		removed.push_back({ removedItem.second, removedItem.first });
+	}
+
+	for (auto &entry : m_entries)
+	{
+		const std::wstring &name = entry.first;
+		const Entry &info = entry.second;
+
+		if (!info.existing)
+		{
+			added.push_back({ info.sequence, name });
+			continue;
+		}
+
+		if (info.originalName != name)
+		{
+			renamed.push_back({ info.sequence, { info.originalName, name } });
+		}
+
+		if (info.modified)
+		{
+			modified.push_back({ info.sequence, name });
+		}
+	}
+
+	auto sortBySequence = [] (auto &items) {
+		std::sort(items.begin(), items.end(), [] (const auto &item1, const auto &item2) {
+			return item1.first < item2.first;
+		});
+	};
+
+	sortBySequence(removed);
+	sortBySequence(renamed);
+	sortBySequence(modified);
+	sortBySequence(added);
+
+	for (auto &item : removed)
+	{
+		changes.removed.push_back(std::move(item.second));
+	}
+
+	for (auto &item : renamed)
+	{
+		changes.renamed.push_back(std::move(item.second));
+	}
+
+	for (auto &item : modified)
+	{
+		changes.modified.push_back(std::move(item.second));
+	}
+
+	for (auto &item : added)
+	{
+		changes.added.push_back(std::move(item.second));
+	}
+
+	Clear();
+
+	return changes;
+}
+
+void ChangeJournal::Clear()
+{
+	m_entries.clear();
+	m_removed.clear();
+	m_pendingRename.reset();
+	m_overflowed = false;
+	m_numEvents = 0;
+}
+
+ChangeJournal::Changes ChangeJournal::DiffListings(std::vector<ListingEntry> before,
+	std::vector<ListingEntry> after)
+{
+	auto compareNames = [] (const ListingEntry &entry1, const ListingEntry &entry2) {
+		return entry1.name < entry2.name;
+	};
+
+	std::sort(before.begin(), before.end(), compareNames);
+	std::sort(after.begin(), after.end(), compareNames);
+
+	Changes changes;
+
+	auto itrBefore = before.begin();
+	auto itrAfter = after.begin();
+
+	while (itrBefore != before.end() || itrAfter != after.end())
+	{
+		if (itrAfter == after.end() || (itrBefore != before.end() && itrBefore->name < itrAfter->name))
+		{
+			changes.removed.push_back(std::move(itrBefore->name));
+			++itrBefore;
+		}
+		else if (itrBefore == before.end() || itrAfter->name < itrBefore->name)
+		{
+			changes.added.push_back(std::move(itrAfter->name));
+			++itrAfter;
+		}
+		else
+		{
+			if (itrBefore->size != itrAfter->size || itrBefore->lastWriteTime != itrAfter->lastWriteTime)
+			{
+				changes.modified.push_back(std::move(itrAfter->name));
+			}
+
+			++itrBefore;
+			++itrAfter;
+		}
+	}
+
+	return changes;
+}
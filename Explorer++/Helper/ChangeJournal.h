@@ -0,0 +1,136 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Collects the change notifications for a directory and reduces them to
+// the net set of changes, so that a burst of notifications (e.g. from a
+// build that repeatedly creates, modifies and deletes temporary files)
+// can be applied in a single pass.
+//
+// Events are tracked per item:
+//
+// - An item that's added and then removed is dropped entirely.
+// - Any number of modifications to an item are reported once.
+// - A chain of renames (a -> b -> c) is reported as a single rename
+//   (a -> c). Renaming an item that was added in the same batch just
+//   changes the name that's reported as added.
+//
+// If more than the maximum number of distinct items are changed, the
+// individual changes are discarded and the journal is marked as having
+// overflowed. In that case, the directory should simply be rescanned.
+class ChangeJournal
+{
+public:
+
+	enum class Action
+	{
+		Added,
+		Removed,
+		Modified,
+		RenamedOldName,
+		RenamedNewName
+	};
+
+	struct Rename
+	{
+		std::wstring oldName;
+		std::wstring newName;
+	};
+
+	// The net changes. These should be applied in order: removals, then
+	// renames, then modifications (which use the names after renaming),
+	// then additions. Within each set, changes are listed in the order
+	// in which the items were first changed.
+	struct Changes
+	{
+		bool overflowed = false;
+		std::vector<std::wstring> removed;
+		std::vector<Rename> renamed;
+		std::vector<std::wstring> modified;
+		std::vector<std::wstring> added;
+	};
+
+	// An entry in a directory listing, used to work out the changes
+	// after an overflow.
+	struct ListingEntry
+	{
+		std::wstring name;
+		uint64_t size = 0;
+		uint64_t lastWriteTime = 0;
+	};
+
+	explicit ChangeJournal(size_t maxEntries);
+
+	void AddEvent(Action action, std::wstring_view fileName);
+
+	// Returns true if there's nothing to apply.
+	bool IsEmpty() const;
+
+	// The number of events received since the changes were last taken.
+	size_t GetNumEvents() const;
+
+	// Returns the net changes and resets the journal.
+	Changes TakeChanges();
+
+	void Clear();
+
+	// Compares two listings of the same directory and returns the changes
+	// between them. Items with the same name are considered to have been
+	// modified if either their size or last write time differ. The diff
+	// never contains renames.
+	static Changes DiffListings(std::vector<ListingEntry> before, std::vector<ListingEntry> after);
+
+private:
+
+	struct Entry
+	{
+		// Whether the item existed before the first event in this batch
+		// (as opposed to being added during it).
+		bool existing;
+
+		// The name the item had at the start of the batch. Only valid for
+		// existing items.
+		std::wstring originalName;
+
+		bool modified;
+
+		// Used to report changes in the order they first occurred.
+		uint64_t sequence;
+	};
+
+	void OnAdded(std::wstring_view fileName);
+	void OnRemoved(std::wstring_view fileName);
+	void OnModified(std::wstring_view fileName);
+	void OnRenamedOldName(std::wstring_view fileName);
+	void OnRenamedNewName(std::wstring_view fileName);
+
+	void RemoveEntry(const Entry &entry);
+	void ResolvePendingRename();
+	void CheckOverflow();
+
+	const size_t m_maxEntries;
+
+	// Keyed by the current name of each item.
+	std::unordered_map<std::wstring, Entry> m_entries;
+
+	// Items that existed at the start of the batch and have since been
+	// removed, keyed by their original name.
+	std::unordered_map<std::wstring, uint64_t> m_removed;
+
+	// The item named by a RenamedOldName event, held until the matching
+	// RenamedNewName event arrives.
+	std::optional<Entry> m_pendingRename;
+
+	bool m_overflowed;
+	size_t m_numEvents;
+	uint64_t m_nextSequence;
+};
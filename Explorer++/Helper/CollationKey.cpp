@@ -0,0 +1,290 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "CollationKey.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+	// Digit runs sort where '0' would, which matches where a digit would
+	// sort in a plain character comparison.
+	const uint16_t DIGIT_RUN_MARKER = L'0';
+
+	bool IsDigit(wchar_t c)
+	{
+		return c >= L'0' && c <= L'9';
+	}
+
+	void AppendUnit(CollationKey &key, uint16_t unit)
+	{
+		key.push_back(static_cast<char>(unit >> 8));
+		key.push_back(static_cast<char>(unit & 0xFF));
+	}
+
+	size_t FindEndOfDigitRun(std::wstring_view str, size_t start)
+	{
+		size_t end = start;
+
+		while (end < str.size() && IsDigit(str[end]))
+		{
+			end++;
+		}
+
+		return end;
+	}
+
+	size_t SkipLeadingZeros(std::wstring_view str, size_t start, size_t end)
+	{
+		while (start < end && str[start] == L'0')
+		{
+			start++;
+		}
+
+		return start;
+	}
+
+	// The base letters of the characters in the Latin-1 Supplement (from
+	// U+00C0) and Latin Extended-A blocks. A '.' indicates that the
+	// character isn't a letter with a diacritic (e.g. a ligature, or a
+	// letter that has no base letter in ASCII).
+	const char LATIN_1_BASE_LETTERS[] =
+		"aaaaaa.ceeeeiiii.nooooo.ouuuuy.."
+		"aaaaaa.ceeeeiiii.nooooo.ouuuuy.y";
+
+	const char LATIN_EXTENDED_A_BASE_LETTERS[] =
+		"aaaaaaccccccccdd"
+		"ddeeeeeeeeeegggg"
+		"gggghhhhiiiiiiii"
+		"ii..jjkk.lllllll"
+		"lllnnnnnn...oooo"
+		"oo..rrrrrrssssss"
+		"ssttttttuuuuuuuu"
+		"uuuuwwyyyzzzzzzs";
+
+	char GetBaseLetter(wchar_t c)
+	{
+		if (c >= 0xC0 && c <= 0xFF)
+		{
+			return LATIN_1_BASE_LETTERS[c - 0xC0];
+		}
+
+		if (c >= 0x100 && c <= 0x17F)
+		{
+			return LATIN_EXTENDED_A_BASE_LETTERS[c - 0x100];
+		}
+
+		return '.';
+	}
+}
+
+wchar_t FoldCollationCase(wchar_t c)
+{
+	if (c < 0x80)
+	{
+		if (c >= L'A' && c <= L'Z')
+		{
+			return c + 0x20;
+		}
+
+		return c;
+	}
+
+	/* Latin-1 Supplement (excluding the multiplication sign). */
+	if (c >= 0xC0 && c <= 0xDE && c != 0xD7)
+	{
+		return c + 0x20;
+	}
+
+	/* Latin Extended-A. Upper and lower case letters are
+	interleaved, with the alignment changing part way through. */
+	if ((c >= 0x100 && c <= 0x137) || (c >= 0x14A && c <= 0x177))
+	{
+		return c | 1;
+	}
+
+	if ((c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17E))
+	{
+		return (c & 1) ? c + 1 : c;
+	}
+
+	if (c == 0x178)
+	{
+		return 0xFF;
+	}
+
+	/* Greek. */
+	if (c >= 0x391 && c <= 0x3A9 && c != 0x3A2)
+	{
+		return c + 0x20;
+	}
+
+	/* Cyrillic. */
+	if (c >= 0x400 && c <= 0x40F)
+	{
+		return c + 0x50;
+	}
+
+	if (c >= 0x410 && c <= 0x42F)
+	{
+		return c + 0x20;
+	}
+
+	return c;
+}
+
+wchar_t FoldCollationPrimary(wchar_t c)
+{
+	char baseLetter = GetBaseLetter(c);
+
+	if (baseLetter != '.')
+	{
+		return static_cast<wchar_t>(baseLetter);
+	}
+
+	return FoldCollationCase(c);
+}
+
+CollationKey BuildCollationKey(std::wstring_view str)
+{
+	CollationKey key;
+	key.reserve(str.size() * 4 + 2);
+
+	size_t i = 0;
+
+	while (i < str.size())
+	{
+		if (!IsDigit(str[i]))
+		{
+			AppendUnit(key, static_cast<uint16_t>(FoldCollationPrimary(str[i])));
+			i++;
+			continue;
+		}
+
+		size_t end = FindEndOfDigitRun(str, i);
+		size_t significantStart = SkipLeadingZeros(str, i, end);
+		size_t numSignificantDigits = end - significantStart;
+
+		AppendUnit(key, DIGIT_RUN_MARKER);
+
+		/* The number of significant digits is written as a 32-bit value,
+		so that it can't overflow for any realistic string. */
+		AppendUnit(key, static_cast<uint16_t>(numSignificantDigits >> 16));
+		AppendUnit(key, static_cast<uint16_t>(numSignificantDigits & 0xFFFF));
+
+		for (size_t j = significantStart; j < end; j++)
+		{
+			key.push_back(static_cast<char>(str[j]));
+		}
+
+		i = end;
+	}
+
+	AppendUnit(key, 0);
+
+	for (wchar_t c : str)
+	{
+		AppendUnit(key, static_cast<uint16_t>(c));
+	}
+
+	return key;
+}
+
+int CompareCollationKeys(const CollationKey &key1, const CollationKey &key2)
+{
+	size_t commonLength = (std::min)(key1.size(), key2.size());
+	int result = memcmp(key1.data(), key2.data(), commonLength);
+
+	if (result != 0)
+	{
+		return result;
+	}
+
+	if (key1.size() == key2.size())
+	{
+		return 0;
+	}
+
+	return key1.size() < key2.size() ? -1 : 1;
+}
+
+int NaturalCompare(std::wstring_view str1, std::wstring_view str2)
+{
+	size_t i = 0;
+	size_t j = 0;
+
+	while (i < str1.size() && j < str2.size())
+	{
+		bool isDigit1 = IsDigit(str1[i]);
+		bool isDigit2 = IsDigit(str2[j]);
+
+		if (isDigit1 && isDigit2)
+		{
+			size_t end1 = FindEndOfDigitRun(str1, i);
+			size_t end2 = FindEndOfDigitRun(str2, j);
+			size_t significantStart1 = SkipLeadingZeros(str1, i, end1);
+			size_t significantStart2 = SkipLeadingZeros(str2, j, end2);
+			size_t length1 = end1 - significantStart1;
+			size_t length2 = end2 - significantStart2;
+
+			if (length1 != length2)
+			{
+				return length1 < length2 ? -1 : 1;
+			}
+
+			int result = str1.substr(significantStart1, length1).compare(str2.substr(significantStart2, length2));
+
+			if (result != 0)
+			{
+				return result;
+			}
+
+			i = end1;
+			j = end2;
+			continue;
+		}
+
+		uint16_t unit1 = isDigit1 ? DIGIT_RUN_MARKER : static_cast<uint16_t>(FoldCollationPrimary(str1[i]));
+		uint16_t unit2 = isDigit2 ? DIGIT_RUN_MARKER : static_cast<uint16_t>(FoldCollationPrimary(str2[j]));
+
+		if (unit1 != unit2)
+		{
+			return unit1 < unit2 ? -1 : 1;
+		}
+
+		i++;
+		j++;
+	}
+
+	if (i < str1.size())
+	{
+		return 1;
+	}
+	else if (j < str2.size())
+	{
+		return -1;
+	}
+
+	/* The strings are equal at the primary level, so fall back to
+	comparing the original characters. */
+	for (size_t k = 0; k < str1.size() && k < str2.size(); k++)
+	{
+		auto unit1 = static_cast<uint16_t>(str1[k]);
+		auto unit2 = static_cast<uint16_t>(str2[k]);
+
+		if (unit1 != unit2)
+		{
+			return unit1 < unit2 ? -1 : 1;
+		}
+	}
+
+	if (str1.size() == str2.size())
+	{
+		return 0;
+	}
+
+	return str1.size() < str2.size() ? -1 : 1;
+}
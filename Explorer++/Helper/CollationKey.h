@@ -0,0 +1,58 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// A binary sort key for natural ("logical") string ordering, in the style
+// of StrCmpLogicalW. That is, comparisons are case-insensitive and runs of
+// digits are compared by their numeric value (so that "file2" sorts before
+// "file10").
+//
+// The key for a string is built once and two keys can then be compared
+// with a plain memcmp, which is much cheaper than performing a full
+// natural comparison every time two items are compared during a sort.
+//
+// The key consists of two levels:
+//
+// 1. The primary level. Each character is case folded, accented Latin
+// letters are replaced with their base letter (so that, for example,
+// "\u00E9clair" sorts next to "eclair", rather than after "zebra") and the
+// result is written as two big-endian bytes. Each run of digits is written
+// as a marker (that sorts where '0' would), followed by the number of
+// significant digits (as four big-endian bytes) and then the significant
+// digits themselves. Leading zeros are dropped, so runs with the same value
+// encode identically. The level is terminated by two zero bytes, which sort
+// before any character.
+// 2. The original characters, as two big-endian bytes each. This only
+// affects strings that are equal at the primary level (e.g. "File" and
+// "file", "eclair" and "\u00E9clair", or "a01" and "a1") and ensures that
+// the ordering is total.
+//
+// Ligatures (such as U+00DF and U+00E6) aren't expanded, so they sort after
+// the ASCII letters, rather than as the letters they're made up of.
+using CollationKey = std::string;
+
+CollationKey BuildCollationKey(std::wstring_view str);
+
+// Returns a negative value, 0, or a positive value, depending on whether
+// key1 sorts before, equal to, or after key2.
+int CompareCollationKeys(const CollationKey &key1, const CollationKey &key2);
+
+// Performs the natural comparison directly on two strings, without building
+// keys. This always produces the same result as comparing the keys for
+// the two strings and is mainly useful for one-off comparisons.
+int NaturalCompare(std::wstring_view str1, std::wstring_view str2);
+
+// The case folding used as part of the primary level. Covers ASCII, Latin-1,
+// Latin Extended-A, Greek and Cyrillic. Unlike towlower, this doesn't
+// depend on the current locale.
+wchar_t FoldCollationCase(wchar_t c);
+
+// The full folding used by the primary level. This is the case folding
+// above, with accented letters in the Latin-1 Supplement and Latin
+// Extended-A blocks replaced by their (lower case) base letter.
+wchar_t FoldCollationPrimary(wchar_t c);
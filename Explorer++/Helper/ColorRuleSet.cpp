@@ -0,0 +1,79 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "ColorRuleSet.h"
+#include <algorithm>
+
+ColorRuleSet::ColorRuleSet() :
+	m_numRulesToCheck(0)
+{
+
+}
+
+ColorRuleSet::ColorRuleSet(const std::vector<Rule> &rules)
+{
+	size_t numRules = (std::min)(rules.size(), MAX_RULES);
+	m_rules.reserve(numRules);
+	m_numRulesToCheck = numRules;
+
+	for (size_t i = 0; i < numRules; i++)
+	{
+		const Rule &rule = rules[i];
+
+		CompiledRule compiledRule;
+		compiledRule.attributes = rule.attributes;
+		compiledRule.color = rule.color;
+
+		if (!rule.pattern.empty())
+		{
+			compiledRule.pattern.emplace(rule.pattern, rule.caseSensitive);
+		}
+
+		if (!compiledRule.pattern && compiledRule.attributes == 0 && m_numRulesToCheck == numRules)
+		{
+			m_numRulesToCheck = i + 1;
+		}
+
+		m_rules.push_back(std::move(compiledRule));
+	}
+}
+
+std::optional<uint16_t> ColorRuleSet::Classify(std::wstring_view fileName, uint32_t attributes) const
+{
+	for (size_t i = 0; i < m_numRulesToCheck; i++)
+	{
+		const CompiledRule &rule = m_rules[i];
+
+		// The attribute check is much cheaper, so it's done first.
+		if (rule.attributes != 0 && (rule.attributes & attributes) == 0)
+		{
+			continue;
+		}
+
+		if (rule.pattern && !rule.pattern->Match(fileName))
+		{
+			continue;
+		}
+
+		return static_cast<uint16_t>(i);
+	}
+
+	return std::nullopt;
+}
+
+std::optional<uint32_t> ColorRuleSet::GetColor(uint16_t ruleIndex) const
+{
+	if (ruleIndex >= m_rules.size())
+	{
+		return std::nullopt;
+	}
+
+	return m_rules[ruleIndex].color;
+}
+
+size_t ColorRuleSet::GetNumRules() const
+{
+	return m_rules.size();
+}
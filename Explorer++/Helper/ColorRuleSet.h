@@ -0,0 +1,68 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include "CompiledWildcard.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Determines which color rule (if any) applies to an item. The rules are
+// compiled once, when the set is built, so that each item can be classified
+// as it's added (or changed) and the result stored alongside the item.
+// Drawing an item is then just a matter of looking up the color for its
+// stored rule index.
+class ColorRuleSet
+{
+public:
+
+	struct Rule
+	{
+		// Matched against the item's filename, in the same way as
+		// CheckWildcardMatch. An empty pattern matches every item.
+		std::wstring pattern;
+		bool caseSensitive;
+
+		// An item matches if it has any of these attributes. If no
+		// attributes are specified, every item matches.
+		uint32_t attributes;
+
+		uint32_t color;
+	};
+
+	// Rule indexes need to fit into 16 bits, with one value left over to
+	// indicate that no rule matches. Any rules past this limit are ignored.
+	static constexpr size_t MAX_RULES = UINT16_MAX;
+
+	ColorRuleSet();
+	explicit ColorRuleSet(const std::vector<Rule> &rules);
+
+	// Returns the index of the first rule that the item matches.
+	std::optional<uint16_t> Classify(std::wstring_view fileName, uint32_t attributes) const;
+
+	// Returns nothing if the index doesn't refer to a rule in this set (e.g.
+	// because it was determined using a set that has since been replaced).
+	std::optional<uint32_t> GetColor(uint16_t ruleIndex) const;
+	size_t GetNumRules() const;
+
+private:
+
+	struct CompiledRule
+	{
+		// Not set if the rule has an empty pattern.
+		std::optional<CompiledWildcard> pattern;
+
+		uint32_t attributes;
+		uint32_t color;
+	};
+
+	std::vector<CompiledRule> m_rules;
+
+	// A rule that matches every item hides any rules after it, so only the
+	// rules up to (and including) the first such rule need to be checked.
+	size_t m_numRulesToCheck;
+};
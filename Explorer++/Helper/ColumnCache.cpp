@@ -0,0 +1,497 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "ColumnCache.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+/* The cache file consists of a header, followed by one record for each
+file. Each file record is followed by the columns cached for that file.
+Every record (and every string) starts on an 8 byte boundary, so the
+strings can be used directly from the mapped file.
+
+Files are written in order of use (most recent first), so that loading
+a file that's larger than the cache drops the least recently used
+entries. */
+namespace
+{
+	const char FILE_MAGIC[8] = { 'E', 'X', 'P', 'C', 'O', 'L', 'C', 'A' };
+	const uint32_t FILE_VERSION = 1;
+
+	struct FileHeader
+	{
+		char magic[8];
+		uint32_t version;
+
+		// Strings are stored as wchar_t, so a cache file can only be used
+		// on the platform it was written on.
+		uint32_t charSize;
+
+		uint64_t numFiles;
+	};
+
+	struct FileRecord
+	{
+		uint64_t fileSize;
+		uint64_t lastWriteTime;
+		uint32_t pathLength;
+		uint32_t numColumns;
+	};
+
+	struct ColumnRecord
+	{
+		uint32_t columnId;
+		uint32_t textLength;
+	};
+
+	static_assert(sizeof(FileHeader) % 8 == 0 && sizeof(FileRecord) % 8 == 0 && sizeof(ColumnRecord) % 8 == 0,
+		"Cache file records must be a multiple of 8 bytes in size");
+
+	// Roughly accounts for the list node and index entry that go along with
+	// each cache entry.
+	const size_t ENTRY_OVERHEAD = 64;
+
+	size_t AlignTo8(size_t size)
+	{
+		return (size + 7) & ~static_cast<size_t>(7);
+	}
+
+	uint64_t HashPath(std::wstring_view path)
+	{
+		// FNV-1a
+		uint64_t hash = 0xCBF29CE484222325ULL;
+
+		for (wchar_t c : path)
+		{
+			hash ^= static_cast<uint64_t>(c);
+			hash *= 0x100000001B3ULL;
+		}
+
+		return hash;
+	}
+
+	class CacheFileReader
+	{
+	public:
+
+		CacheFileReader(const uint8_t *data, size_t size) :
+			m_data(data),
+			m_size(size),
+			m_offset(0)
+		{
+
+		}
+
+		template <typename T>
+		const T *Read()
+		{
+			return reinterpret_cast<const T *>(ReadBytes(sizeof(T)));
+		}
+
+		const wchar_t *ReadString(size_t length)
+		{
+			if (length > (m_size / sizeof(wchar_t)))
+			{
+				return nullptr;
+			}
+
+			return reinterpret_cast<const wchar_t *>(ReadBytes(AlignTo8(length * sizeof(wchar_t))));
+		}
+
+	private:
+
+		const uint8_t *ReadBytes(size_t numBytes)
+		{
+			if (numBytes > m_size - m_offset)
+			{
+				return nullptr;
+			}
+
+			const uint8_t *bytes = m_data + m_offset;
+			m_offset += numBytes;
+
+			return bytes;
+		}
+
+		const uint8_t *m_data;
+		size_t m_size;
+		size_t m_offset;
+	};
+
+	void AppendBytes(std::vector<uint8_t> &buffer, const void *data, size_t size)
+	{
+		auto bytes = static_cast<const uint8_t *>(data);
+		buffer.insert(buffer.end(), bytes, bytes + size);
+	}
+
+	void AppendString(std::vector<uint8_t> &buffer, std::wstring_view str)
+	{
+		size_t size = str.size() * sizeof(wchar_t);
+		AppendBytes(buffer, str.data(), size);
+		buffer.resize(buffer.size() + (AlignTo8(size) - size), 0);
+	}
+}
+
+ColumnCache::ColumnCache(size_t maxSize) :
+	m_maxSize(maxSize),
+	m_size(0)
+{
+
+}
+
+bool ColumnCache::Load(const std::wstring &cacheFilePath)
+{
+	Clear();
+
+	auto mappedFile = MappedFile::Open(cacheFilePath);
+
+	if (!mappedFile)
+	{
+		return false;
+	}
+
+	CacheFileReader reader(mappedFile->GetData(), mappedFile->GetSize());
+	auto header = reader.Read<FileHeader>();
+
+	if (!header || memcmp(header->magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0
+		|| header->version != FILE_VERSION || header->charSize != sizeof(wchar_t))
+	{
+		return false;
+	}
+
+	for (uint64_t i = 0; i < header->numFiles; i++)
+	{
+		auto fileRecord = reader.Read<FileRecord>();
+		const wchar_t *path = fileRecord ? reader.ReadString(fileRecord->pathLength) : nullptr;
+
+		if (!path)
+		{
+			Clear();
+			return false;
+		}
+
+		uint64_t pathHash = HashPath({ path, fileRecord->pathLength });
+
+		for (uint32_t j = 0; j < fileRecord->numColumns; j++)
+		{
+			auto columnRecord = reader.Read<ColumnRecord>();
+			const wchar_t *text = columnRecord ? reader.ReadString(columnRecord->textLength) : nullptr;
+
+			if (!text)
+			{
+				Clear();
+				return false;
+			}
+
+			if (m_index.count({ pathHash, columnRecord->columnId }) > 0)
+			{
+				continue;
+			}
+
+			Entry entry;
+			entry.pathHash = pathHash;
+			entry.columnId = columnRecord->columnId;
+			entry.fileSize = fileRecord->fileSize;
+			entry.lastWriteTime = fileRecord->lastWriteTime;
+			entry.mappedPath = path;
+			entry.mappedPathLength = fileRecord->pathLength;
+			entry.mappedText = text;
+			entry.mappedTextLength = columnRecord->textLength;
+
+			if (m_size + GetEntrySize(entry) > m_maxSize)
+			{
+				// Everything that's left is less recently used than the
+				// entries that have already been loaded.
+				break;
+			}
+
+			// Since the file is ordered from most to least recently used,
+			// each entry goes at the back.
+			m_size += GetEntrySize(entry);
+			m_entries.push_back(entry);
+			m_index.insert({ { pathHash, entry.columnId }, std::prev(m_entries.end()) });
+		}
+	}
+
+	m_mappedFile = std::move(mappedFile);
+
+	return true;
+}
+
+bool ColumnCache::Save(const std::wstring &cacheFilePath)
+{
+	// The mapped file may be the one being replaced, so it has to be
+	// released first.
+	ReleaseMappedFile();
+
+	struct FileIdentity
+	{
+		std::wstring_view path;
+		uint64_t fileSize;
+		uint64_t lastWriteTime;
+
+		bool operator==(const FileIdentity &other) const
+		{
+			return path == other.path && fileSize == other.fileSize && lastWriteTime == other.lastWriteTime;
+		}
+	};
+
+	struct FileIdentityHash
+	{
+		size_t operator()(const FileIdentity &identity) const
+		{
+			return std::hash<std::wstring_view>()(identity.path) ^ static_cast<size_t>(identity.lastWriteTime);
+		}
+	};
+
+	// Groups the columns for each file, with the files ordered by their
+	// most recently used column.
+	std::vector<std::vector<const Entry *>> files;
+	std::unordered_map<FileIdentity, size_t, FileIdentityHash> fileIndexes;
+
+	for (const auto &entry : m_entries)
+	{
+		FileIdentity identity = { GetEntryPath(entry), entry.fileSize, entry.lastWriteTime };
+		auto itr = fileIndexes.find(identity);
+
+		if (itr == fileIndexes.end())
+		{
+			itr = fileIndexes.insert({ identity, files.size() }).first;
+			files.emplace_back();
+		}
+
+		files[itr->second].push_back(&entry);
+	}
+
+	std::vector<uint8_t> buffer;
+
+	FileHeader header;
+	memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+	header.version = FILE_VERSION;
+	header.charSize = sizeof(wchar_t);
+	header.numFiles = files.size();
+	AppendBytes(buffer, &header, sizeof(header));
+
+	for (const auto &columns : files)
+	{
+		const Entry &firstEntry = *columns[0];
+		std::wstring_view path = GetEntryPath(firstEntry);
+
+		FileRecord fileRecord;
+		fileRecord.fileSize = firstEntry.fileSize;
+		fileRecord.lastWriteTime = firstEntry.lastWriteTime;
+		fileRecord.pathLength = static_cast<uint32_t>(path.size());
+		fileRecord.numColumns = static_cast<uint32_t>(columns.size());
+		AppendBytes(buffer, &fileRecord, sizeof(fileRecord));
+		AppendString(buffer, path);
+
+		for (const Entry *entry : columns)
+		{
+			std::wstring_view text = GetEntryText(*entry);
+
+			ColumnRecord columnRecord;
+			columnRecord.columnId = entry->columnId;
+			columnRecord.textLength = static_cast<uint32_t>(text.size());
+			AppendBytes(buffer, &columnRecord, sizeof(columnRecord));
+			AppendString(buffer, text);
+		}
+	}
+
+	// The cache is written to a temporary file first, so that a failed
+	// write won't leave a partial file behind.
+	std::filesystem::path finalPath(cacheFilePath);
+	std::filesystem::path temporaryPath(cacheFilePath + L".tmp");
+
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+		if (!file)
+		{
+			return false;
+		}
+
+		file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+
+		if (!file)
+		{
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, finalPath, error);
+
+	if (error)
+	{
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+
+	return true;
+}
+
+std::optional<std::wstring> ColumnCache::Find(const std::wstring &path, uint64_t fileSize, uint64_t lastWriteTime,
+	unsigned int columnId)
+{
+	auto itr = m_index.find({ HashPath(path), columnId });
+
+	if (itr == m_index.end() || GetEntryPath(*itr->second) != path)
+	{
+		m_statistics.numMisses++;
+		return std::nullopt;
+	}
+
+	auto entryItr = itr->second;
+
+	if (entryItr->fileSize != fileSize || entryItr->lastWriteTime != lastWriteTime)
+	{
+		RemoveEntry(entryItr);
+
+		m_statistics.numInvalidated++;
+		m_statistics.numMisses++;
+		return std::nullopt;
+	}
+
+	m_entries.splice(m_entries.begin(), m_entries, entryItr);
+
+	m_statistics.numHits++;
+
+	return std::wstring(GetEntryText(*entryItr));
+}
+
+void ColumnCache::Insert(const std::wstring &path, uint64_t fileSize, uint64_t lastWriteTime, unsigned int columnId,
+	const std::wstring &text)
+{
+	uint64_t pathHash = HashPath(path);
+	auto itr = m_index.find({ pathHash, columnId });
+
+	if (itr != m_index.end())
+	{
+		// Either the existing entry is stale, or it's for a different path
+		// with the same hash. Either way, it's replaced.
+		RemoveEntry(itr->second);
+	}
+
+	Entry entry;
+	entry.pathHash = pathHash;
+	entry.columnId = columnId;
+	entry.fileSize = fileSize;
+	entry.lastWriteTime = lastWriteTime;
+	entry.ownedPath = path;
+	entry.ownedText = text;
+
+	if (GetEntrySize(entry) > m_maxSize)
+	{
+		return;
+	}
+
+	AddEntry(std::move(entry));
+	EvictEntries();
+}
+
+void ColumnCache::Clear()
+{
+	m_entries.clear();
+	m_index.clear();
+	m_size = 0;
+	m_mappedFile.reset();
+}
+
+size_t ColumnCache::GetNumEntries() const
+{
+	return m_entries.size();
+}
+
+size_t ColumnCache::GetSize() const
+{
+	return m_size;
+}
+
+ColumnCache::Statistics ColumnCache::GetStatistics() const
+{
+	return m_statistics;
+}
+
+std::wstring_view ColumnCache::GetEntryPath(const Entry &entry)
+{
+	if (entry.mappedPath)
+	{
+		return { entry.mappedPath, entry.mappedPathLength };
+	}
+
+	return entry.ownedPath;
+}
+
+std::wstring_view ColumnCache::GetEntryText(const Entry &entry)
+{
+	if (entry.mappedText)
+	{
+		return { entry.mappedText, entry.mappedTextLength };
+	}
+
+	return entry.ownedText;
+}
+
+size_t ColumnCache::GetEntrySize(const Entry &entry)
+{
+	return sizeof(Entry) + ENTRY_OVERHEAD
+		+ (GetEntryPath(entry).size() + GetEntryText(entry).size()) * sizeof(wchar_t);
+}
+
+void ColumnCache::AddEntry(Entry entry)
+{
+	m_size += GetEntrySize(entry);
+
+	Key key = { entry.pathHash, entry.columnId };
+	m_entries.push_front(std::move(entry));
+	m_index[key] = m_entries.begin();
+}
+
+void ColumnCache::RemoveEntry(EntryList::iterator itr)
+{
+	m_size -= GetEntrySize(*itr);
+	m_index.erase({ itr->pathHash, itr->columnId });
+	m_entries.erase(itr);
+}
+
+void ColumnCache::EvictEntries()
+{
+	while (m_size > m_maxSize && !m_entries.empty())
+	{
+		RemoveEntry(std::prev(m_entries.end()));
+		m_statistics.numEvicted++;
+	}
+}
+
+/* Copies any strings that refer to the mapped file, so that the file can
+be unmapped. */
+void ColumnCache::ReleaseMappedFile()
+{
+	if (!m_mappedFile)
+	{
+		return;
+	}
+
+	for (auto &entry : m_entries)
+	{
+		if (entry.mappedPath)
+		{
+			entry.ownedPath.assign(entry.mappedPath, entry.mappedPathLength);
+			entry.mappedPath = nullptr;
+			entry.mappedPathLength = 0;
+		}
+
+		if (entry.mappedText)
+		{
+			entry.ownedText.assign(entry.mappedText, entry.mappedTextLength);
+			entry.mappedText = nullptr;
+			entry.mappedTextLength = 0;
+		}
+	}
+
+	m_mappedFile.reset();
+}
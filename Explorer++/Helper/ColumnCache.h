@@ -0,0 +1,127 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include "MappedFile.h"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// A size-bounded cache of column text, keyed by the identity of the file
+// the text was retrieved for (its path, size and last write time) and the
+// column ID. If a file changes, its size or last write time will (almost
+// always) change as well, so a stale entry is never returned. Least
+// recently used entries are evicted once the cache is full.
+//
+// The cache can be saved to disk and loaded again later. Loading maps the
+// file into memory, rather than reading it, so entries that are never
+// looked up cost (almost) nothing.
+//
+// This class isn't thread-safe.
+class ColumnCache
+{
+public:
+
+	struct Statistics
+	{
+		uint64_t numHits = 0;
+		uint64_t numMisses = 0;
+
+		// Lookups where an entry was found, but the file had since
+		// changed.
+		uint64_t numInvalidated = 0;
+
+		uint64_t numEvicted = 0;
+	};
+
+	explicit ColumnCache(size_t maxSize);
+
+	// Replaces the contents of the cache with the contents of the specified
+	// file. Returns false (leaving the cache empty) if the file doesn't
+	// exist or isn't a valid cache file.
+	bool Load(const std::wstring &cacheFilePath);
+
+	// Writes the cache to the specified file, replacing it if it already
+	// exists. The file that was loaded can be safely overwritten.
+	bool Save(const std::wstring &cacheFilePath);
+
+	std::optional<std::wstring> Find(const std::wstring &path, uint64_t fileSize, uint64_t lastWriteTime,
+		unsigned int columnId);
+	void Insert(const std::wstring &path, uint64_t fileSize, uint64_t lastWriteTime, unsigned int columnId,
+		const std::wstring &text);
+	void Clear();
+
+	size_t GetNumEntries() const;
+
+	// The approximate amount of memory used by the entries.
+	size_t GetSize() const;
+
+	Statistics GetStatistics() const;
+
+private:
+
+	struct Entry
+	{
+		uint64_t pathHash;
+		unsigned int columnId;
+		uint64_t fileSize;
+		uint64_t lastWriteTime;
+
+		// Entries loaded from a cache file refer directly to the mapped
+		// data. Inserted entries own their strings.
+		const wchar_t *mappedPath = nullptr;
+		size_t mappedPathLength = 0;
+		const wchar_t *mappedText = nullptr;
+		size_t mappedTextLength = 0;
+
+		std::wstring ownedPath;
+		std::wstring ownedText;
+	};
+
+	struct Key
+	{
+		uint64_t pathHash;
+		unsigned int columnId;
+
+		bool operator==(const Key &other) const
+		{
+			return pathHash == other.pathHash && columnId == other.columnId;
+		}
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key &key) const
+		{
+			return static_cast<size_t>(key.pathHash ^ (static_cast<uint64_t>(key.columnId) * 0x9E3779B97F4A7C15ULL));
+		}
+	};
+
+	using EntryList = std::list<Entry>;
+
+	static std::wstring_view GetEntryPath(const Entry &entry);
+	static std::wstring_view GetEntryText(const Entry &entry);
+	static size_t GetEntrySize(const Entry &entry);
+
+	void AddEntry(Entry entry);
+	void RemoveEntry(EntryList::iterator itr);
+	void EvictEntries();
+	void ReleaseMappedFile();
+
+	const size_t m_maxSize;
+	size_t m_size;
+
+	// Ordered from most to least recently used.
+	EntryList m_entries;
+	std::unordered_map<Key, EntryList::iterator, KeyHash> m_index;
+
+	std::unique_ptr<MappedFile> m_mappedFile;
+
+	Statistics m_statistics;
+};
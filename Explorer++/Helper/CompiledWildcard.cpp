@@ -0,0 +1,448 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "CompiledWildcard.h"
+#include <algorithm>
+#include <cwchar>
+
+#ifndef _WIN32
+#include <cwctype>
+#endif
+
+namespace
+{
+	const size_t LOWERCASE_TABLE_SIZE = 0x10000;
+
+	wchar_t ToLowercase(wchar_t c)
+	{
+#ifdef _WIN32
+		wchar_t lowercase;
+
+		// Each character is mapped individually, as CheckWildcardMatch does.
+		if (LCMapString(LOCALE_USER_DEFAULT, LCMAP_LOWERCASE, &c, 1, &lowercase, 1) == 0)
+		{
+			return c;
+		}
+
+		return lowercase;
+#else
+		return static_cast<wchar_t>(std::towlower(static_cast<std::wint_t>(c)));
+#endif
+	}
+
+	std::vector<wchar_t> BuildLowercaseTable()
+	{
+		std::vector<wchar_t> table(LOWERCASE_TABLE_SIZE);
+
+		for (size_t i = 0; i < table.size(); i++)
+		{
+			table[i] = ToLowercase(static_cast<wchar_t>(i));
+		}
+
+		return table;
+	}
+
+	// Mapping a character to lowercase is comparatively expensive, so the
+	// mapping for each UTF-16 code unit is only looked up once.
+	wchar_t FoldCase(wchar_t c)
+	{
+		static const std::vector<wchar_t> lowercaseTable = BuildLowercaseTable();
+
+		auto index = static_cast<size_t>(c);
+
+		if (index >= LOWERCASE_TABLE_SIZE)
+		{
+			return ToLowercase(c);
+		}
+
+		return lowercaseTable[index];
+	}
+
+	// Mirrors PathRemoveBlanks.
+	std::wstring_view RemoveBlanks(std::wstring_view pattern)
+	{
+		size_t start = pattern.find_first_not_of(L' ');
+
+		if (start == std::wstring_view::npos)
+		{
+			return {};
+		}
+
+		size_t end = pattern.find_last_not_of(L' ');
+		return pattern.substr(start, end - start + 1);
+	}
+}
+
+CompiledWildcard::CompiledWildcard(std::wstring_view pattern, bool caseSensitive) :
+	m_caseSensitive(caseSensitive),
+	m_matchesEverything(false)
+{
+	std::wstring foldedPattern(pattern);
+
+	if (!caseSensitive)
+	{
+		std::transform(foldedPattern.begin(), foldedPattern.end(), foldedPattern.begin(), FoldCase);
+	}
+
+	std::wstring_view remaining = foldedPattern;
+
+	if (remaining.find(L':') == std::wstring_view::npos)
+	{
+		AddPattern(remaining);
+		return;
+	}
+
+	remaining = remaining.substr(0, MAX_MULTIPLE_PATTERN_LENGTH);
+
+	// Empty patterns (e.g. between two consecutive separators) are skipped,
+	// though a pattern that's empty once blanks are removed isn't.
+	while (!remaining.empty())
+	{
+		size_t separator = remaining.find(L':');
+		std::wstring_view current = remaining.substr(0, separator);
+
+		if (!current.empty())
+		{
+			AddPattern(RemoveBlanks(current));
+		}
+
+		if (separator == std::wstring_view::npos)
+		{
+			break;
+		}
+
+		remaining.remove_prefix(separator + 1);
+	}
+}
+
+void CompiledWildcard::AddPattern(std::wstring_view pattern)
+{
+	m_patterns.emplace_back(pattern);
+
+	size_t firstNonStar = pattern.find_first_not_of(L'*');
+
+	if (!pattern.empty() && firstNonStar == std::wstring_view::npos)
+	{
+		m_matchesEverything = true;
+		return;
+	}
+
+	if (pattern.find(L'?') == std::wstring_view::npos)
+	{
+		size_t firstStar = pattern.find(L'*');
+		size_t lastNonStar = pattern.find_last_not_of(L'*');
+
+		if (firstStar == std::wstring_view::npos)
+		{
+			m_exactMatches.insert(StoreLiteral(pattern));
+			return;
+		}
+
+		if (firstStar == lastNonStar + 1)
+		{
+			AddAffix(m_prefixes, pattern.substr(0, firstStar));
+			return;
+		}
+
+		if (firstNonStar > 0 && pattern.find(L'*', firstNonStar) == std::wstring_view::npos)
+		{
+			AddAffix(m_suffixes, pattern.substr(firstNonStar));
+			return;
+		}
+	}
+
+	m_globs.push_back(CompileGlob(pattern));
+}
+
+std::wstring_view CompiledWildcard::StoreLiteral(std::wstring_view literal)
+{
+	return m_literals.emplace_back(literal);
+}
+
+void CompiledWildcard::AddAffix(std::vector<AffixSet> &affixSets, std::wstring_view affix)
+{
+	auto itr = std::lower_bound(affixSets.begin(), affixSets.end(), affix.size(),
+		[] (const AffixSet &affixSet, size_t length) {
+			return affixSet.length < length;
+		});
+
+	if (itr == affixSets.end() || itr->length != affix.size())
+	{
+		itr = affixSets.insert(itr, AffixSet{ affix.size(), {} });
+	}
+
+	itr->values.insert(StoreLiteral(affix));
+}
+
+CompiledWildcard::GlobPattern CompiledWildcard::CompileGlob(std::wstring_view pattern)
+{
+	GlobPattern glob;
+	glob.anchoredStart = pattern.empty() || pattern.front() != L'*';
+	glob.anchoredEnd = pattern.empty() || pattern.back() != L'*';
+	glob.minLength = 0;
+
+	size_t position = 0;
+
+	while (position <= pattern.size())
+	{
+		size_t star = pattern.find(L'*', position);
+		std::wstring_view text = pattern.substr(position, star == std::wstring_view::npos ? star : star - position);
+
+		// Consecutive stars are equivalent to a single star, so they don't
+		// produce empty segments. A pattern without any stars is always a
+		// single segment (even if that segment is empty).
+		if (!text.empty() || (glob.segments.empty() && star == std::wstring_view::npos))
+		{
+			glob.segments.push_back({ std::wstring(text), text.find_first_not_of(L'?') });
+			glob.minLength += text.size();
+		}
+
+		if (star == std::wstring_view::npos)
+		{
+			break;
+		}
+
+		position = star + 1;
+	}
+
+	return glob;
+}
+
+bool CompiledWildcard::Narrows(const CompiledWildcard &previous) const
+{
+	// A case-insensitive pattern can match strings that a case-sensitive one
+	// doesn't, whatever the patterns are.
+	if (!m_caseSensitive && previous.m_caseSensitive)
+	{
+		return false;
+	}
+
+	// The previous patterns are case-folded if they're case-insensitive,
+	// so these patterns need to be folded in the same way before they're
+	// compared.
+	bool foldPatterns = m_caseSensitive && !previous.m_caseSensitive;
+
+	return std::all_of(m_patterns.begin(), m_patterns.end(),
+		[&previous, foldPatterns] (const std::wstring &pattern) {
+			return std::any_of(previous.m_patterns.begin(), previous.m_patterns.end(),
+				[&pattern, foldPatterns] (const std::wstring &previousPattern) {
+					return IsInstanceOf(pattern, previousPattern, foldPatterns);
+				});
+		});
+}
+
+// Determines whether the pattern can be produced from the previous pattern by
+// substituting its wildcards. This is the same as matching the pattern (as
+// text) against the previous pattern, except that a '?' can't stand in for a
+// '*'.
+bool CompiledWildcard::IsInstanceOf(std::wstring_view pattern, std::wstring_view previousPattern,
+	bool foldPattern)
+{
+	// matches[j] indicates whether the first j characters of the pattern
+	// can be produced from the part of the previous pattern that's been
+	// processed so far.
+	std::vector<bool> matches(pattern.size() + 1, false);
+	matches[0] = true;
+
+	for (wchar_t previousChar : previousPattern)
+	{
+		if (previousChar == L'*')
+		{
+			for (size_t j = 1; j <= pattern.size(); j++)
+			{
+				matches[j] = matches[j] || matches[j - 1];
+			}
+
+			continue;
+		}
+
+		for (size_t j = pattern.size(); j > 0; j--)
+		{
+			wchar_t c = foldPattern ? FoldCase(pattern[j - 1]) : pattern[j - 1];
+			bool charMatches = (previousChar == L'?') ? (c != L'*') : (c == previousChar);
+			matches[j] = matches[j - 1] && charMatches;
+		}
+
+		matches[0] = false;
+	}
+
+	return matches[pattern.size()];
+}
+
+bool CompiledWildcard::Match(std::wstring_view str) const
+{
+	if (m_matchesEverything)
+	{
+		return true;
+	}
+
+	if (m_caseSensitive)
+	{
+		return MatchFolded(str);
+	}
+
+	wchar_t stackBuffer[FOLD_BUFFER_LENGTH];
+	std::wstring heapBuffer;
+	wchar_t *buffer = stackBuffer;
+
+	if (str.size() > FOLD_BUFFER_LENGTH)
+	{
+		heapBuffer.resize(str.size());
+		buffer = heapBuffer.data();
+	}
+
+	std::transform(str.begin(), str.end(), buffer, FoldCase);
+
+	return MatchFolded({ buffer, str.size() });
+}
+
+bool CompiledWildcard::MatchFolded(std::wstring_view str) const
+{
+	if (!m_exactMatches.empty() && m_exactMatches.count(str) != 0)
+	{
+		return true;
+	}
+
+	for (const AffixSet &prefixSet : m_prefixes)
+	{
+		if (prefixSet.length > str.size())
+		{
+			break;
+		}
+
+		if (prefixSet.values.count(str.substr(0, prefixSet.length)) != 0)
+		{
+			return true;
+		}
+	}
+
+	for (const AffixSet &suffixSet : m_suffixes)
+	{
+		if (suffixSet.length > str.size())
+		{
+			break;
+		}
+
+		if (suffixSet.values.count(str.substr(str.size() - suffixSet.length)) != 0)
+		{
+			return true;
+		}
+	}
+
+	return std::any_of(m_globs.begin(), m_globs.end(), [str] (const GlobPattern &glob) {
+		return MatchGlob(glob, str);
+	});
+}
+
+bool CompiledWildcard::MatchGlob(const GlobPattern &glob, std::wstring_view str)
+{
+	if (str.size() < glob.minLength)
+	{
+		return false;
+	}
+
+	if (glob.anchoredStart && glob.anchoredEnd && glob.segments.size() == 1)
+	{
+		return str.size() == glob.minLength && SegmentMatchesAt(glob.segments[0], str, 0);
+	}
+
+	auto first = glob.segments.begin();
+	auto last = glob.segments.end();
+	size_t begin = 0;
+	size_t end = str.size();
+
+	if (glob.anchoredStart)
+	{
+		if (!SegmentMatchesAt(*first, str, 0))
+		{
+			return false;
+		}
+
+		begin = first->text.size();
+		++first;
+	}
+
+	if (glob.anchoredEnd)
+	{
+		--last;
+
+		// The length check above guarantees that this segment doesn't
+		// overlap the first.
+		if (!SegmentMatchesAt(*last, str, str.size() - last->text.size()))
+		{
+			return false;
+		}
+
+		end -= last->text.size();
+	}
+
+	for (auto itr = first; itr != last; ++itr)
+	{
+		size_t position = FindSegment(*itr, str, begin, end);
+
+		if (position == std::wstring_view::npos)
+		{
+			return false;
+		}
+
+		begin = position + itr->text.size();
+	}
+
+	return true;
+}
+
+bool CompiledWildcard::SegmentMatchesAt(const Segment &segment, std::wstring_view str, size_t position)
+{
+	for (size_t i = 0; i < segment.text.size(); i++)
+	{
+		if (segment.text[i] != L'?' && segment.text[i] != str[position + i])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Returns the first position in [begin, end) at which the segment fully
+// matches, or npos if there isn't one.
+size_t CompiledWildcard::FindSegment(const Segment &segment, std::wstring_view str, size_t begin, size_t end)
+{
+	if (segment.text.size() > end - begin)
+	{
+		return std::wstring_view::npos;
+	}
+
+	if (segment.firstLiteral == std::wstring::npos)
+	{
+		return begin;
+	}
+
+	size_t lastStart = end - segment.text.size();
+	wchar_t literal = segment.text[segment.firstLiteral];
+	size_t position = begin;
+
+	while (position <= lastStart)
+	{
+		const wchar_t *found = std::wmemchr(str.data() + position + segment.firstLiteral, literal,
+			lastStart - position + 1);
+
+		if (!found)
+		{
+			return std::wstring_view::npos;
+		}
+
+		position = static_cast<size_t>(found - str.data()) - segment.firstLiteral;
+
+		if (SegmentMatchesAt(segment, str, position))
+		{
+			return position;
+		}
+
+		position++;
+	}
+
+	return std::wstring_view::npos;
+}
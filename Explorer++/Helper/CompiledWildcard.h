@@ -0,0 +1,137 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// A wildcard pattern (or set of patterns), parsed once so that it can be
+// matched against a large number of strings. This matches exactly the same
+// strings as CheckWildcardMatch does, i.e.:
+//
+// - '*' matches any sequence of characters (including an empty sequence).
+// - '?' matches any single character.
+// - Multiple patterns can be separated by ':' (e.g. "*.h: *.cpp"), in which
+//   case each pattern has any leading or trailing spaces removed.
+//
+// Each pattern is placed into one of several categories when it's compiled:
+//
+// - Patterns without any wildcards, patterns that only have wildcards at the
+//   end (e.g. "file*") and patterns that only have wildcards at the start
+//   (e.g. "*.txt") are grouped by length and stored in hash sets. Checking a
+//   string against all the patterns in a group (e.g. every three character
+//   extension) is then a single lookup.
+// - Any other pattern is split into the literal segments between each '*'.
+//   Since a '*' can absorb any number of characters, taking the first
+//   position at which each segment matches is always correct, so no
+//   backtracking is needed. Candidate positions for a segment are found by
+//   scanning for one of its characters with wmemchr (which the C runtime
+//   vectorizes).
+//
+// Matching is thread-safe, so a single instance can be shared between
+// threads.
+class CompiledWildcard
+{
+public:
+
+	CompiledWildcard(std::wstring_view pattern, bool caseSensitive);
+
+	// The hash sets refer to strings owned by this object, so it can't be
+	// copied.
+	CompiledWildcard(const CompiledWildcard &) = delete;
+	CompiledWildcard &operator=(const CompiledWildcard &) = delete;
+	CompiledWildcard(CompiledWildcard &&) = default;
+	CompiledWildcard &operator=(CompiledWildcard &&) = default;
+
+	bool Match(std::wstring_view str) const;
+
+	// Returns true if every string that this matches is also matched by the
+	// previous pattern, i.e. if this pattern is a narrower version of the
+	// previous one (e.g. "*abcd*" narrows "*abc*"). This is conservative, so
+	// it can return false even when the statement holds. It holds for:
+	//
+	// - Patterns produced by replacing any '*' in the previous pattern with a
+	//   sequence of characters (which may itself contain wildcards).
+	// - Patterns produced by replacing any '?' with a character other than
+	//   '*'.
+	//
+	// In the case of multiple patterns, each of these patterns has to narrow
+	// one of the previous patterns.
+	bool Narrows(const CompiledWildcard &previous) const;
+
+private:
+
+	// CheckWildcardMatch copies a set of patterns into a fixed size buffer
+	// before splitting it, so anything past this length is ignored.
+	static const size_t MAX_MULTIPLE_PATTERN_LENGTH = 511;
+
+	// Strings of at most this length are case-folded on the stack.
+	static const size_t FOLD_BUFFER_LENGTH = 260;
+
+	// A set of literal prefixes or suffixes, all of the same length.
+	struct AffixSet
+	{
+		size_t length;
+		std::unordered_set<std::wstring_view> values;
+	};
+
+	struct Segment
+	{
+		// May contain '?', but not '*'.
+		std::wstring text;
+
+		// The position of the first character in the segment that isn't a
+		// '?', or npos if there isn't one.
+		size_t firstLiteral;
+	};
+
+	struct GlobPattern
+	{
+		std::vector<Segment> segments;
+
+		// Whether the first segment has to match at the start of the string
+		// and whether the last segment has to match at the end.
+		bool anchoredStart;
+		bool anchoredEnd;
+
+		// The total length of the segments.
+		size_t minLength;
+	};
+
+	void AddPattern(std::wstring_view pattern);
+	std::wstring_view StoreLiteral(std::wstring_view literal);
+	void AddAffix(std::vector<AffixSet> &affixSets, std::wstring_view affix);
+	static GlobPattern CompileGlob(std::wstring_view pattern);
+
+	static bool IsInstanceOf(std::wstring_view pattern, std::wstring_view previousPattern, bool foldPattern);
+
+	bool MatchFolded(std::wstring_view str) const;
+	static bool MatchGlob(const GlobPattern &glob, std::wstring_view str);
+	static bool SegmentMatchesAt(const Segment &segment, std::wstring_view str, size_t position);
+	static size_t FindSegment(const Segment &segment, std::wstring_view str, size_t begin, size_t end);
+
+	bool m_caseSensitive;
+
+	// Each individual pattern, exactly as it was added.
+	std::vector<std::wstring> m_patterns;
+
+	// Set if any of the patterns consists only of '*' characters.
+	bool m_matchesEverything;
+
+	// A deque is used so that the strings never move, allowing the sets
+	// below to refer to them directly.
+	std::deque<std::wstring> m_literals;
+
+	std::unordered_set<std::wstring_view> m_exactMatches;
+
+	// Sorted by length.
+	std::vector<AffixSet> m_prefixes;
+	std::vector<AffixSet> m_suffixes;
+
+	std::vector<GlobPattern> m_globs;
+};
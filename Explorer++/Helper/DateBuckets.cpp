@@ -0,0 +1,222 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "DateBuckets.h"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define DATE_BUCKETS_X64
+#endif
+
+#ifdef DATE_BUCKETS_X64
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+// See PixelKernels.cpp.
+#if defined(__clang__) || defined(__GNUC__)
+#define DATE_BUCKETS_TARGET(name) __attribute__((target(name)))
+#else
+#define DATE_BUCKETS_TARGET(name)
+#endif
+
+namespace
+{
+	// The number of days between 1970-01-01 and the specified date, in the
+	// proleptic Gregorian calendar.
+	int64_t DaysFromCivil(const DateBuckets::Date &date)
+	{
+		int64_t year = date.year - (date.month <= 2 ? 1 : 0);
+		int64_t era = (year >= 0 ? year : year - 399) / 400;
+		int64_t yearOfEra = year - era * 400;
+		int64_t dayOfYear = (153 * (date.month + (date.month > 2 ? -3 : 9)) + 2) / 5 + date.day - 1;
+		int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+		return era * 146097 + dayOfEra - 719468;
+	}
+
+	DateBuckets::Date CivilFromDays(int64_t days)
+	{
+		days += 719468;
+		int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+		int64_t dayOfEra = days - era * 146097;
+		int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+		int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+		int64_t monthIndex = (5 * dayOfYear + 2) / 153;
+		int day = static_cast<int>(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+		int month = static_cast<int>(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+		int year = static_cast<int>(yearOfEra + era * 400 + (month <= 2 ? 1 : 0));
+		return { year, month, day };
+	}
+
+	template <size_t N>
+	uint8_t CountLaterBoundaries(const std::array<int64_t, N> &boundaries, int64_t timestamp)
+	{
+		uint8_t count = 0;
+
+		for (int64_t boundary : boundaries)
+		{
+			count += static_cast<uint8_t>(boundary > timestamp);
+		}
+
+		return count;
+	}
+
+	template <size_t N>
+	void ClassifyPortable(const std::array<int64_t, N> &boundaries, const uint64_t *timestamps, size_t count,
+		DateBuckets::Bucket *buckets)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			buckets[i] = static_cast<DateBuckets::Bucket>(CountLaterBoundaries(boundaries,
+				static_cast<int64_t>(timestamps[i])));
+		}
+	}
+
+#ifdef DATE_BUCKETS_X64
+	// Classifies four timestamps at a time. Each comparison produces -1 for
+	// each boundary that's later than the timestamp, so subtracting the
+	// results gives the count directly.
+	template <size_t N>
+	DATE_BUCKETS_TARGET("avx2")
+	void ClassifyAvx2(const std::array<int64_t, N> &boundaries, const uint64_t *timestamps, size_t count,
+		DateBuckets::Bucket *buckets)
+	{
+		__m256i broadcastBoundaries[N];
+
+		for (size_t i = 0; i < N; i++)
+		{
+			broadcastBoundaries[i] = _mm256_set1_epi64x(boundaries[i]);
+		}
+
+		size_t i = 0;
+
+		for (; i + 4 <= count; i += 4)
+		{
+			__m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(timestamps + i));
+			__m256i counts = _mm256_setzero_si256();
+
+			for (size_t j = 0; j < N; j++)
+			{
+				counts = _mm256_sub_epi64(counts, _mm256_cmpgt_epi64(broadcastBoundaries[j], values));
+			}
+
+			// Each count fits in the low byte of its lane. Gather those four
+			// bytes into the low 32 bits.
+			__m256i packed = _mm256_shuffle_epi8(counts, _mm256_setr_epi8(
+				0, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				0, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+			uint32_t low = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_castsi256_si128(packed)));
+			uint32_t high = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_extracti128_si256(packed, 1)));
+
+			buckets[i] = static_cast<DateBuckets::Bucket>(low & 0xFF);
+			buckets[i + 1] = static_cast<DateBuckets::Bucket>((low >> 8) & 0xFF);
+			buckets[i + 2] = static_cast<DateBuckets::Bucket>(high & 0xFF);
+			buckets[i + 3] = static_cast<DateBuckets::Bucket>((high >> 8) & 0xFF);
+		}
+
+		ClassifyPortable(boundaries, timestamps + i, count - i, buckets + i);
+	}
+#endif
+}
+
+bool DateBuckets::Date::operator==(const Date &other) const
+{
+	return year == other.year && month == other.month && day == other.day;
+}
+
+DateBuckets::DateBuckets(const Date &today, const DayStartResolver &dayStartResolver) :
+	m_today(today)
+{
+	Date startOfWeek = AddDays(today, -GetDayOfWeek(today));
+	Date startOfMonth = { today.year, today.month, 1 };
+	Date startOfLastMonth = (today.month == 1) ? Date{ today.year - 1, 12, 1 } : Date{ today.year, today.month - 1, 1 };
+
+	// In the same order as the buckets.
+	Date bucketStarts[] = {
+		AddDays(today, 1),
+		today,
+		AddDays(today, -1),
+		startOfWeek,
+		AddDays(startOfWeek, -7),
+		startOfMonth,
+		startOfLastMonth,
+		{ today.year, 1, 1 },
+		{ today.year - 1, 1, 1 }
+	};
+
+	static_assert(std::size(bucketStarts) == NUM_BOUNDARIES - 1);
+
+	// A bucket can start after the one preceding it (e.g. this month can
+	// start after this week does). In that case, it's the preceding bucket
+	// that takes precedence, so the later bucket is empty.
+	int64_t previous = INT64_MAX;
+
+	for (size_t i = 0; i < std::size(bucketStarts); i++)
+	{
+		int64_t start = static_cast<int64_t>(dayStartResolver(bucketStarts[i]));
+		previous = (std::min)(previous, start);
+		m_boundaries[i] = previous;
+	}
+
+	m_boundaries[NUM_BOUNDARIES - 1] = 0;
+}
+
+int DateBuckets::GetDayOfWeek(const Date &date)
+{
+	// January 1, 1970 was a Thursday.
+	int64_t dayOfWeek = (DaysFromCivil(date) + 4) % 7;
+
+	if (dayOfWeek < 0)
+	{
+		dayOfWeek += 7;
+	}
+
+	return static_cast<int>(dayOfWeek);
+}
+
+DateBuckets::Date DateBuckets::AddDays(const Date &date, int days)
+{
+	return CivilFromDays(DaysFromCivil(date) + days);
+}
+
+const DateBuckets::Date &DateBuckets::GetToday() const
+{
+	return m_today;
+}
+
+uint64_t DateBuckets::GetExpiryTime() const
+{
+	return static_cast<uint64_t>(m_boundaries[static_cast<size_t>(Bucket::Future)]);
+}
+
+bool DateBuckets::IsExpired(uint64_t now) const
+{
+	return now >= GetExpiryTime();
+}
+
+DateBuckets::Bucket DateBuckets::Classify(uint64_t timestamp) const
+{
+	return static_cast<Bucket>(CountLaterBoundaries(m_boundaries, static_cast<int64_t>(timestamp)));
+}
+
+void DateBuckets::Classify(const uint64_t *timestamps, size_t count, Bucket *buckets,
+	PixelKernels::InstructionSet instructionSet) const
+{
+#ifdef DATE_BUCKETS_X64
+	if (instructionSet == PixelKernels::InstructionSet::Avx2)
+	{
+		ClassifyAvx2(m_boundaries, timestamps, count, buckets);
+		return;
+	}
+#else
+	(void) instructionSet;
+#endif
+
+	ClassifyPortable(m_boundaries, timestamps, count, buckets);
+}
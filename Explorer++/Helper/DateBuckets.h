@@ -0,0 +1,101 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include "PixelKernels.h"
+#include <array>
+#include <cstdint>
+#include <functional>
+
+// Sorts timestamps into the buckets used when grouping items by date (today,
+// yesterday, this week, etc). Timestamps are in the same format as a
+// FILETIME (i.e. the number of 100-nanosecond intervals since January 1,
+// 1601 UTC).
+//
+// Rather than converting each timestamp to a local date, the start of each
+// bucket is converted to a timestamp once, when the buckets are built. That
+// way, time zone and daylight saving time rules only need to be applied to
+// the handful of bucket boundaries, and classifying a timestamp is just a
+// matter of comparing it against those boundaries.
+//
+// The buckets are only valid until the end of the day they were built on.
+// Once IsExpired() returns true, they should be rebuilt (and the items
+// classified again).
+class DateBuckets
+{
+public:
+
+	// Buckets are listed from the most recent to the least recent. An item
+	// is placed into the first bucket it falls into, so, for example, an
+	// item modified yesterday is placed into Yesterday, even if yesterday
+	// was part of this week.
+	enum class Bucket : uint8_t
+	{
+		Future,
+		Today,
+		Yesterday,
+		ThisWeek,
+		LastWeek,
+		ThisMonth,
+		LastMonth,
+		ThisYear,
+		LastYear,
+		LongAgo,
+
+		// The timestamp couldn't be converted to a date (i.e. it's larger
+		// than the largest value a FILETIME can be converted from).
+		Unspecified
+	};
+
+	static const size_t NUM_BUCKETS = static_cast<size_t>(Bucket::Unspecified) + 1;
+
+	struct Date
+	{
+		int year;
+
+		// 1 - 12.
+		int month;
+
+		// 1 - 31.
+		int day;
+
+		bool operator==(const Date &other) const;
+	};
+
+	// Returns the timestamp at which the specified local date starts. That's
+	// normally midnight on that date, though if midnight was skipped (because
+	// of a daylight saving time transition), it's the first time that exists
+	// on the date.
+	using DayStartResolver = std::function<uint64_t(const Date &date)>;
+
+	// Weeks are considered to start on Sunday.
+	DateBuckets(const Date &today, const DayStartResolver &dayStartResolver);
+
+	// 0 is Sunday.
+	static int GetDayOfWeek(const Date &date);
+	static Date AddDays(const Date &date, int days);
+
+	const Date &GetToday() const;
+
+	// The time at which the buckets go out of date (i.e. the start of
+	// tomorrow).
+	uint64_t GetExpiryTime() const;
+	bool IsExpired(uint64_t now) const;
+
+	Bucket Classify(uint64_t timestamp) const;
+	void Classify(const uint64_t *timestamps, size_t count, Bucket *buckets,
+		PixelKernels::InstructionSet instructionSet = PixelKernels::GetBestInstructionSet()) const;
+
+private:
+
+	// The start of each bucket (apart from Unspecified), followed by 0.
+	// Every boundary is at or before the one preceding it, so the bucket a
+	// timestamp falls into is simply the number of boundaries that are
+	// later than it.
+	static const size_t NUM_BOUNDARIES = NUM_BUCKETS - 1;
+
+	Date m_today;
+	std::array<int64_t, NUM_BOUNDARIES> m_boundaries;
+};
@@ -0,0 +1,775 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "FolderSizeService.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <cwctype>
+#include <deque>
+
+#ifndef _WIN32
+#include <filesystem>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+#ifdef _WIN32
+	const wchar_t PATH_SEPARATOR = L'\\';
+#else
+	const wchar_t PATH_SEPARATOR = L'/';
+#endif
+
+	std::wstring JoinPath(const std::wstring &parent, const std::wstring &name)
+	{
+		std::wstring path;
+		path.reserve(parent.size() + 1 + name.size());
+		path = parent;
+
+		if (!path.empty() && path.back() != PATH_SEPARATOR)
+		{
+			path += PATH_SEPARATOR;
+		}
+
+		path += name;
+
+		return path;
+	}
+
+	// The key used for a path in the cache. Trailing separators are removed
+	// (unless they're part of a root, like "C:\" or "/") and, on Windows,
+	// case is ignored.
+	std::wstring GetFolderKey(const std::wstring &path)
+	{
+		std::wstring key = path;
+
+#ifdef _WIN32
+		for (auto &c : key)
+		{
+			c = (c == L'/') ? PATH_SEPARATOR : static_cast<wchar_t>(std::towlower(c));
+		}
+#endif
+
+		while (key.size() > 1 && key.back() == PATH_SEPARATOR && key[key.size() - 2] != L':')
+		{
+			key.pop_back();
+		}
+
+		return key;
+	}
+
+	std::optional<std::wstring> GetParentKey(const std::wstring &key)
+	{
+		size_t separator = key.find_last_of(PATH_SEPARATOR);
+
+		// A root has no parent.
+		if (separator == std::wstring::npos || separator == key.size() - 1)
+		{
+			return std::nullopt;
+		}
+
+		std::wstring parent = key.substr(0, separator);
+
+		if (parent.empty() || parent.back() == L':')
+		{
+			parent += PATH_SEPARATOR;
+		}
+
+		return parent;
+	}
+
+	bool IsInSubtree(const std::wstring &key, const std::wstring &subtreeKey)
+	{
+		if (key.size() <= subtreeKey.size() || key.compare(0, subtreeKey.size(), subtreeKey) != 0)
+		{
+			return false;
+		}
+
+		return subtreeKey.back() == PATH_SEPARATOR || key[subtreeKey.size()] == PATH_SEPARATOR;
+	}
+
+	uint64_t ApplyDelta(uint64_t value, int64_t delta)
+	{
+		if (delta < 0 && static_cast<uint64_t>(-delta) > value)
+		{
+			return 0;
+		}
+
+		return value + delta;
+	}
+
+	class FileSystemFolderReader : public FolderReader
+	{
+	public:
+
+		bool ReadFolder(const std::wstring &path, FolderContents &contents) override
+		{
+#ifdef _WIN32
+			WIN32_FIND_DATA wfd;
+			HANDLE findHandle = FindFirstFileEx(JoinPath(GetExtendedLengthPath(path), L"*").c_str(),
+				FindExInfoBasic, &wfd, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+
+			if (findHandle == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+
+			do
+			{
+				if (lstrcmp(wfd.cFileName, L".") == 0 || lstrcmp(wfd.cFileName, L"..") == 0)
+				{
+					continue;
+				}
+
+				if (WI_IsFlagSet(wfd.dwFileAttributes, FILE_ATTRIBUTE_DIRECTORY))
+				{
+					contents.numFolders++;
+
+					if (WI_IsFlagClear(wfd.dwFileAttributes, FILE_ATTRIBUTE_REPARSE_POINT))
+					{
+						contents.subfolders.emplace_back(wfd.cFileName);
+					}
+				}
+				else
+				{
+					ULARGE_INTEGER fileSize = { wfd.nFileSizeLow, wfd.nFileSizeHigh };
+					contents.fileSize += fileSize.QuadPart;
+					contents.numFiles++;
+				}
+			} while (FindNextFile(findHandle, &wfd));
+
+			FindClose(findHandle);
+
+			return true;
+#else
+			DIR *dir = opendir(std::filesystem::path(path).c_str());
+
+			if (!dir)
+			{
+				return false;
+			}
+
+			int dirFd = dirfd(dir);
+			struct dirent *entry;
+
+			while ((entry = readdir(dir)) != nullptr)
+			{
+				if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+				{
+					continue;
+				}
+
+				struct stat status;
+
+				if (fstatat(dirFd, entry->d_name, &status, AT_SYMLINK_NOFOLLOW) != 0)
+				{
+					continue;
+				}
+
+				if (S_ISDIR(status.st_mode))
+				{
+					contents.numFolders++;
+					contents.subfolders.push_back(std::filesystem::path(entry->d_name).wstring());
+				}
+				else if (S_ISLNK(status.st_mode) && IsLinkToFolder(dirFd, entry->d_name))
+				{
+					contents.numFolders++;
+				}
+				else
+				{
+					contents.fileSize += static_cast<uint64_t>(status.st_size);
+					contents.numFiles++;
+				}
+			}
+
+			closedir(dir);
+
+			return true;
+#endif
+		}
+
+	private:
+
+#ifdef _WIN32
+		// Allows paths longer than MAX_PATH to be read.
+		static std::wstring GetExtendedLengthPath(const std::wstring &path)
+		{
+			if (path.compare(0, 4, L"\\\\?\\") == 0)
+			{
+				return path;
+			}
+
+			if (path.compare(0, 2, L"\\\\") == 0)
+			{
+				return L"\\\\?\\UNC\\" + path.substr(2);
+			}
+
+			if (path.size() >= 2 && path[1] == L':')
+			{
+				return L"\\\\?\\" + path;
+			}
+
+			return path;
+		}
+#else
+		static bool IsLinkToFolder(int dirFd, const char *name)
+		{
+			struct stat status;
+			return fstatat(dirFd, name, &status, 0) == 0 && S_ISDIR(status.st_mode);
+		}
+#endif
+	};
+}
+
+struct FolderSizeService::WalkFolder
+{
+	std::wstring path;
+	WalkFolder *parent = nullptr;
+
+	// Totals for everything within this folder that's been counted so far.
+	std::atomic<uint64_t> size = 0;
+	std::atomic<uint64_t> numFiles = 0;
+	std::atomic<uint64_t> numFolders = 0;
+
+	// The folder itself, plus each of its subfolders that hasn't yet been
+	// fully counted. Once this reaches 0, the totals are complete.
+	std::atomic<size_t> numPending = 1;
+};
+
+// Each worker pushes the subfolders it finds onto its own queue and takes
+// the most recently pushed folder first, so that it works through a single
+// part of the tree at a time. A worker without any folders of its own takes
+// the oldest folder from another worker's queue, since that's likely to be
+// the root of the largest remaining part of the tree.
+struct FolderSizeService::Walk
+{
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<WalkFolder *> folders;
+	};
+
+	Walk(size_t numWorkers, const CancellationToken &cancellationToken, const ProgressCallback &progressCallback,
+		uint64_t changeCounter) :
+		cancellationToken(cancellationToken),
+		progressCallback(progressCallback),
+		changeCounter(changeCounter),
+		queues(numWorkers),
+		folders(numWorkers),
+		lastProgressTime(std::chrono::steady_clock::now())
+	{
+
+	}
+
+	const CancellationToken &cancellationToken;
+	const ProgressCallback &progressCallback;
+	const uint64_t changeCounter;
+
+	std::vector<WorkerQueue> queues;
+
+	// The folders allocated by each worker.
+	std::vector<std::vector<std::unique_ptr<WalkFolder>>> folders;
+
+	std::atomic<size_t> numQueued = 0;
+
+	// The number of folders that have been queued, but not yet read. The
+	// walk is finished once this reaches 0.
+	std::atomic<size_t> numOutstanding = 0;
+
+	std::atomic<size_t> numIdle = 0;
+	std::mutex idleMutex;
+	std::condition_variable workAvailable;
+
+	std::atomic<uint64_t> partialSize = 0;
+	std::atomic<uint64_t> partialNumFiles = 0;
+	std::atomic<uint64_t> partialNumFolders = 0;
+
+	std::mutex progressMutex;
+	std::chrono::steady_clock::time_point lastProgressTime;
+};
+
+FolderSizeService &FolderSizeService::GetShared()
+{
+	static FolderSizeService service(TaskExecutor::GetShared(), CreateFileSystemFolderReader());
+	return service;
+}
+
+FolderSizeService::FolderSizeService(TaskExecutor &executor, std::unique_ptr<FolderReader> reader,
+	size_t maxCachedFolders, std::chrono::milliseconds progressInterval) :
+	m_executor(executor),
+	m_reader(std::move(reader)),
+	m_maxCachedFolders(maxCachedFolders),
+	m_progressInterval(progressInterval)
+{
+
+}
+
+std::optional<FolderSizeTotals> FolderSizeService::CalculateSize(const std::wstring &path,
+	const CancellationToken &cancellationToken, const ProgressCallback &progressCallback)
+{
+	auto cachedTotals = FindCachedSizeByKey(GetFolderKey(path));
+
+	if (cachedTotals)
+	{
+		return cachedTotals;
+	}
+
+	uint64_t changeCounter;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		changeCounter = m_changeCounter;
+	}
+
+	// The walk is made up of blocking tasks, so only a share of the
+	// executor's workers (plus the calling thread) will take part in it.
+	size_t numWorkers = static_cast<size_t>(m_executor.GetMaxBlockingTasks()) + 1;
+	Walk walk(numWorkers, cancellationToken, progressCallback, changeCounter);
+
+	WalkFolder root;
+	root.path = path;
+
+	walk.queues[0].folders.push_back(&root);
+	walk.numQueued = 1;
+	walk.numOutstanding = 1;
+
+	m_executor.RunParallel(numWorkers, [this, &walk] (size_t workerIndex) {
+		RunWalkWorker(walk, workerIndex);
+	}, TaskPriority::Background, TaskKind::Blocking);
+
+	if (cancellationToken.IsCancelled())
+	{
+		return std::nullopt;
+	}
+
+	FolderSizeTotals totals;
+	totals.size = root.size;
+	totals.numFiles = root.numFiles;
+	totals.numFolders = root.numFolders;
+
+	return totals;
+}
+
+void FolderSizeService::RunWalkWorker(Walk &walk, size_t workerIndex)
+{
+	while (true)
+	{
+		WalkFolder *folder = PopFolder(walk, workerIndex);
+
+		if (!folder)
+		{
+			if (walk.numOutstanding == 0)
+			{
+				return;
+			}
+
+			walk.numIdle++;
+
+			{
+				std::unique_lock<std::mutex> lock(walk.idleMutex);
+				walk.workAvailable.wait(lock, [&walk] {
+					return walk.numQueued > 0 || walk.numOutstanding == 0;
+				});
+			}
+
+			walk.numIdle--;
+
+			continue;
+		}
+
+		// Once cancelled, the remaining folders are simply discarded.
+		if (!walk.cancellationToken.IsCancelled())
+		{
+			ReadWalkFolder(walk, workerIndex, folder);
+		}
+
+		if (--walk.numOutstanding == 0)
+		{
+			std::lock_guard<std::mutex> lock(walk.idleMutex);
+			walk.workAvailable.notify_all();
+		}
+	}
+}
+
+FolderSizeService::WalkFolder *FolderSizeService::PopFolder(Walk &walk, size_t workerIndex)
+{
+	size_t numWorkers = walk.queues.size();
+
+	for (size_t i = 0; i < numWorkers; i++)
+	{
+		auto &queue = walk.queues[(workerIndex + i) % numWorkers];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (queue.folders.empty())
+		{
+			continue;
+		}
+
+		WalkFolder *folder;
+
+		if (i == 0)
+		{
+			folder = queue.folders.back();
+			queue.folders.pop_back();
+		}
+		else
+		{
+			folder = queue.folders.front();
+			queue.folders.pop_front();
+		}
+
+		walk.numQueued--;
+
+		return folder;
+	}
+
+	return nullptr;
+}
+
+void FolderSizeService::ReadWalkFolder(Walk &walk, size_t workerIndex, WalkFolder *folder)
+{
+	FolderContents contents;
+	m_reader->ReadFolder(folder->path, contents);
+	m_numFoldersRead++;
+
+	uint64_t size = contents.fileSize;
+	uint64_t numFiles = contents.numFiles;
+	uint64_t numFolders = contents.numFolders;
+
+	for (const auto &subfolder : contents.subfolders)
+	{
+		std::wstring subfolderPath = JoinPath(folder->path, subfolder);
+		auto cachedTotals = FindCachedSizeByKey(GetFolderKey(subfolderPath));
+
+		if (cachedTotals)
+		{
+			size += cachedTotals->size;
+			numFiles += cachedTotals->numFiles;
+			numFolders += cachedTotals->numFolders;
+			continue;
+		}
+
+		auto child = std::make_unique<WalkFolder>();
+		child->path = std::move(subfolderPath);
+		child->parent = folder;
+
+		folder->numPending++;
+		walk.numOutstanding++;
+
+		// This is incremented first, so that it can't drop below 0 if
+		// another worker takes the folder straight away.
+		walk.numQueued++;
+
+		auto &queue = walk.queues[workerIndex];
+
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.folders.push_back(child.get());
+		}
+
+		walk.folders[workerIndex].push_back(std::move(child));
+
+		if (walk.numIdle > 0)
+		{
+			std::lock_guard<std::mutex> lock(walk.idleMutex);
+			walk.workAvailable.notify_one();
+		}
+	}
+
+	folder->size += size;
+	folder->numFiles += numFiles;
+	folder->numFolders += numFolders;
+
+	walk.partialSize += size;
+	walk.partialNumFiles += numFiles;
+	walk.partialNumFolders += numFolders;
+
+	ReportProgress(walk);
+
+	CompleteWalkFolder(walk, folder);
+}
+
+void FolderSizeService::CompleteWalkFolder(Walk &walk, WalkFolder *folder)
+{
+	while (folder && --folder->numPending == 0)
+	{
+		FolderSizeTotals totals;
+		totals.size = folder->size;
+		totals.numFiles = folder->numFiles;
+		totals.numFolders = folder->numFolders;
+
+		CacheSize(GetFolderKey(folder->path), totals, walk.changeCounter);
+
+		WalkFolder *parent = folder->parent;
+
+		if (parent)
+		{
+			parent->size += totals.size;
+			parent->numFiles += totals.numFiles;
+			parent->numFolders += totals.numFolders;
+		}
+
+		folder = parent;
+	}
+}
+
+void FolderSizeService::ReportProgress(Walk &walk)
+{
+	if (!walk.progressCallback)
+	{
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(walk.progressMutex, std::try_to_lock);
+
+	if (!lock.owns_lock())
+	{
+		return;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+
+	if (now - walk.lastProgressTime < m_progressInterval)
+	{
+		return;
+	}
+
+	walk.lastProgressTime = now;
+
+	FolderSizeTotals partialTotals;
+	partialTotals.size = walk.partialSize;
+	partialTotals.numFiles = walk.partialNumFiles;
+	partialTotals.numFolders = walk.partialNumFolders;
+	walk.progressCallback(partialTotals);
+}
+
+std::optional<FolderSizeTotals> FolderSizeService::GetCachedSize(const std::wstring &path) const
+{
+	return FindCachedSizeByKey(GetFolderKey(path));
+}
+
+std::optional<FolderSizeTotals> FolderSizeService::FindCachedSizeByKey(const std::wstring &key) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto itr = m_cache.find(key);
+
+	if (itr == m_cache.end())
+	{
+		return std::nullopt;
+	}
+
+	m_numCacheHits++;
+
+	return itr->second;
+}
+
+void FolderSizeService::CacheSize(const std::wstring &key, const FolderSizeTotals &totals, uint64_t changeCounter)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (changeCounter != m_changeCounter || m_maxCachedFolders == 0)
+	{
+		return;
+	}
+
+	auto itr = m_cache.find(key);
+
+	if (itr != m_cache.end())
+	{
+		itr->second = totals;
+		return;
+	}
+
+	// Any entry can be dropped without affecting the others, since the
+	// totals for a folder never depend on a cached subfolder still being
+	// present.
+	if (m_cache.size() >= m_maxCachedFolders)
+	{
+		m_cache.erase(m_cache.begin());
+	}
+
+	m_cache.insert({ key, totals });
+}
+
+void FolderSizeService::OnFileAdded(const std::wstring &path, uint64_t size)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_changeCounter++;
+	AdjustParents(GetFolderKey(path), static_cast<int64_t>(size), 1, 0);
+}
+
+void FolderSizeService::OnFileRemoved(const std::wstring &path, uint64_t size)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_changeCounter++;
+	AdjustParents(GetFolderKey(path), -static_cast<int64_t>(size), -1, 0);
+}
+
+void FolderSizeService::OnFileModified(const std::wstring &path, uint64_t oldSize, uint64_t newSize)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_changeCounter++;
+	AdjustParents(GetFolderKey(path), static_cast<int64_t>(newSize - oldSize), 0, 0);
+}
+
+void FolderSizeService::OnFolderAdded(const std::wstring &path)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_changeCounter++;
+
+	// The folder may not be empty (e.g. if it was moved here), so its
+	// parents will need to be counted again. Only the parents themselves
+	// will need to be read, since everything else within them is still
+	// cached.
+	std::wstring key = GetFolderKey(path);
+	EraseSubtree(key);
+	EraseParents(key);
+}
+
+void FolderSizeService::OnFolderRemoved(const std::wstring &path)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_changeCounter++;
+
+	std::wstring key = GetFolderKey(path);
+	auto itr = m_cache.find(key);
+
+	if (itr != m_cache.end())
+	{
+		AdjustParents(key, -static_cast<int64_t>(itr->second.size), -static_cast<int64_t>(itr->second.numFiles),
+			-static_cast<int64_t>(itr->second.numFolders + 1));
+	}
+	else
+	{
+		EraseParents(key);
+	}
+
+	EraseSubtree(key);
+}
+
+void FolderSizeService::OnFolderRenamed(const std::wstring &oldPath, const std::wstring &newPath)
+{
+	std::wstring oldKey = GetFolderKey(oldPath);
+	std::wstring newKey = GetFolderKey(newPath);
+
+	if (GetParentKey(oldKey) != GetParentKey(newKey))
+	{
+		// The folder has moved, which changes the totals for the parents
+		// on both sides.
+		OnFolderRemoved(oldPath);
+		OnFolderAdded(newPath);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_changeCounter++;
+
+	EraseSubtree(newKey);
+
+	std::vector<std::pair<std::wstring, FolderSizeTotals>> renamedEntries;
+
+	for (auto itr = m_cache.begin(); itr != m_cache.end();)
+	{
+		if (itr->first == oldKey || IsInSubtree(itr->first, oldKey))
+		{
+			renamedEntries.push_back({ newKey + itr->first.substr(oldKey.size()), itr->second });
+			itr = m_cache.erase(itr);
+		}
+		else
+		{
+			++itr;
+		}
+	}
+
+	for (auto &entry : renamedEntries)
+	{
+		m_cache.insert(std::move(entry));
+	}
+}
+
+void FolderSizeService::Invalidate(const std::wstring &path)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_changeCounter++;
+
+	std::wstring key = GetFolderKey(path);
+	EraseSubtree(key);
+	EraseParents(key);
+}
+
+void FolderSizeService::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_changeCounter++;
+	m_cache.clear();
+}
+
+void FolderSizeService::AdjustParents(const std::wstring &key, int64_t sizeDelta, int64_t numFilesDelta,
+	int64_t numFoldersDelta)
+{
+	// A parent that isn't cached is skipped, rather than stopping there,
+	// since the folders above it may still be cached.
+	for (auto parentKey = GetParentKey(key); parentKey; parentKey = GetParentKey(*parentKey))
+	{
+		auto itr = m_cache.find(*parentKey);
+
+		if (itr == m_cache.end())
+		{
+			continue;
+		}
+
+		itr->second.size = ApplyDelta(itr->second.size, sizeDelta);
+		itr->second.numFiles = ApplyDelta(itr->second.numFiles, numFilesDelta);
+		itr->second.numFolders = ApplyDelta(itr->second.numFolders, numFoldersDelta);
+	}
+}
+
+void FolderSizeService::EraseSubtree(const std::wstring &key)
+{
+	m_cache.erase(key);
+
+	for (auto itr = m_cache.begin(); itr != m_cache.end();)
+	{
+		if (IsInSubtree(itr->first, key))
+		{
+			itr = m_cache.erase(itr);
+		}
+		else
+		{
+			++itr;
+		}
+	}
+}
+
+void FolderSizeService::EraseParents(const std::wstring &key)
+{
+	for (auto parentKey = GetParentKey(key); parentKey; parentKey = GetParentKey(*parentKey))
+	{
+		m_cache.erase(*parentKey);
+	}
+}
+
+size_t FolderSizeService::GetNumCachedFolders() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_cache.size();
+}
+
+FolderSizeService::Statistics FolderSizeService::GetStatistics() const
+{
+	Statistics statistics;
+	statistics.numFoldersRead = m_numFoldersRead;
+	statistics.numCacheHits = m_numCacheHits;
+	return statistics;
+}
+
+std::unique_ptr<FolderReader> CreateFileSystemFolderReader()
+{
+	return std::make_unique<FileSystemFolderReader>();
+}
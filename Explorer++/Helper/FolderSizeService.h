@@ -0,0 +1,158 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include "TaskExecutor.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct FolderSizeTotals
+{
+	uint64_t size = 0;
+	uint64_t numFiles = 0;
+
+	// The number of folders within the folder (at any depth), not including
+	// the folder itself.
+	uint64_t numFolders = 0;
+};
+
+// The immediate contents of a single folder.
+struct FolderContents
+{
+	uint64_t fileSize = 0;
+	uint64_t numFiles = 0;
+	uint64_t numFolders = 0;
+
+	// The names of the subfolders that should be descended into. Links to
+	// other folders (symbolic links, junctions, etc) are counted in
+	// numFolders, but aren't listed here, since following them could count
+	// the same items more than once (or never finish).
+	std::vector<std::wstring> subfolders;
+};
+
+class FolderReader
+{
+public:
+
+	virtual ~FolderReader() = default;
+
+	// Returns false if the folder couldn't be read.
+	virtual bool ReadFolder(const std::wstring &path, FolderContents &contents) = 0;
+};
+
+// Reads folders from the file system. Paths aren't limited to MAX_PATH.
+std::unique_ptr<FolderReader> CreateFileSystemFolderReader();
+
+// Calculates the size of a folder (and everything within it). The subfolders
+// are read in parallel, with the calling thread taking part. The total for
+// every folder read is cached, so that a later request for the same folder,
+// one of its subfolders or one of its parents only has to read what hasn't
+// already been counted.
+//
+// Cached totals are kept up to date by passing in changes (e.g. from a
+// directory monitor). Changes that aren't reported won't be picked up
+// until the affected folders are invalidated or evicted from the cache.
+//
+// All methods can be called from any thread.
+class FolderSizeService
+{
+public:
+
+	struct Statistics
+	{
+		uint64_t numFoldersRead = 0;
+		uint64_t numCacheHits = 0;
+	};
+
+	// Called with the running totals while a folder is being counted. May
+	// be called from any of the threads taking part, but never from more
+	// than one at once.
+	using ProgressCallback = std::function<void(const FolderSizeTotals &partialTotals)>;
+
+	static const size_t DEFAULT_MAX_CACHED_FOLDERS = 100000;
+	static constexpr std::chrono::milliseconds DEFAULT_PROGRESS_INTERVAL{ 100 };
+
+	// Uses the shared executor and reads from the file system.
+	static FolderSizeService &GetShared();
+
+	FolderSizeService(TaskExecutor &executor, std::unique_ptr<FolderReader> reader,
+		size_t maxCachedFolders = DEFAULT_MAX_CACHED_FOLDERS,
+		std::chrono::milliseconds progressInterval = DEFAULT_PROGRESS_INTERVAL);
+
+	FolderSizeService(const FolderSizeService &) = delete;
+	FolderSizeService &operator=(const FolderSizeService &) = delete;
+
+	// Blocks until the folder has been counted. Returns nothing if the
+	// token was cancelled first. A folder that can't be read counts as
+	// being empty.
+	std::optional<FolderSizeTotals> CalculateSize(const std::wstring &path,
+		const CancellationToken &cancellationToken = {}, const ProgressCallback &progressCallback = nullptr);
+
+	std::optional<FolderSizeTotals> GetCachedSize(const std::wstring &path) const;
+
+	// The path passed to each of these is the full path of the item that
+	// changed.
+	void OnFileAdded(const std::wstring &path, uint64_t size);
+	void OnFileRemoved(const std::wstring &path, uint64_t size);
+	void OnFileModified(const std::wstring &path, uint64_t oldSize, uint64_t newSize);
+	void OnFolderAdded(const std::wstring &path);
+	void OnFolderRemoved(const std::wstring &path);
+	void OnFolderRenamed(const std::wstring &oldPath, const std::wstring &newPath);
+
+	// Drops the cached totals for the folder, everything within it and
+	// each of its parents.
+	void Invalidate(const std::wstring &path);
+
+	void Clear();
+
+	size_t GetNumCachedFolders() const;
+	Statistics GetStatistics() const;
+
+private:
+
+	struct Walk;
+	struct WalkFolder;
+
+	void RunWalkWorker(Walk &walk, size_t workerIndex);
+	WalkFolder *PopFolder(Walk &walk, size_t workerIndex);
+	void ReadWalkFolder(Walk &walk, size_t workerIndex, WalkFolder *folder);
+	void CompleteWalkFolder(Walk &walk, WalkFolder *folder);
+	void ReportProgress(Walk &walk);
+
+	std::optional<FolderSizeTotals> FindCachedSizeByKey(const std::wstring &key) const;
+	void CacheSize(const std::wstring &key, const FolderSizeTotals &totals, uint64_t changeCounter);
+
+	// Applies the difference to every cached parent of the item. Must be
+	// called with the mutex held.
+	void AdjustParents(const std::wstring &key, int64_t sizeDelta, int64_t numFilesDelta,
+		int64_t numFoldersDelta);
+	void EraseSubtree(const std::wstring &key);
+	void EraseParents(const std::wstring &key);
+
+	TaskExecutor &m_executor;
+	const std::unique_ptr<FolderReader> m_reader;
+	const size_t m_maxCachedFolders;
+	const std::chrono::milliseconds m_progressInterval;
+
+	// Keyed by the normalized path (see GetFolderKey).
+	mutable std::mutex m_mutex;
+	std::unordered_map<std::wstring, FolderSizeTotals> m_cache;
+
+	// Incremented whenever a change is applied. A walk that started before
+	// a change may have counted items from before it, so its results
+	// aren't cached.
+	uint64_t m_changeCounter = 0;
+
+	std::atomic<uint64_t> m_numFoldersRead = 0;
+	mutable std::atomic<uint64_t> m_numCacheHits = 0;
+};
@@ -0,0 +1,101 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "GroupIndex.h"
+#include <cassert>
+#include <utility>
+
+std::wstring GroupIndex::FormatHeader(std::wstring_view header, int numItems)
+{
+	return std::wstring(header) + L" (" + std::to_wstring(numItems) + L")";
+}
+
+GroupIndex::AddResult GroupIndex::AddItem(std::wstring_view header)
+{
+	auto itr = m_groupIds.find(header);
+
+	if (itr != m_groupIds.end())
+	{
+		Group &group = m_groups[itr->second];
+		group.numItems++;
+		MarkChanged(group.id);
+
+		return { group.id, false };
+	}
+
+	int groupId = static_cast<int>(m_groups.size());
+	const Group &group = m_groups.emplace_back(Group{ groupId, std::wstring(header), 1 });
+	m_groupIds.emplace(group.header, groupId);
+
+	m_changed.push_back(false);
+	MarkChanged(groupId);
+
+	return { groupId, true };
+}
+
+void GroupIndex::RemoveItem(int groupId)
+{
+	assert(groupId >= 0 && static_cast<size_t>(groupId) < m_groups.size());
+
+	Group &group = m_groups[groupId];
+	assert(group.numItems > 0);
+
+	group.numItems--;
+	MarkChanged(groupId);
+}
+
+std::optional<int> GroupIndex::FindGroup(std::wstring_view header) const
+{
+	auto itr = m_groupIds.find(header);
+
+	if (itr == m_groupIds.end())
+	{
+		return std::nullopt;
+	}
+
+	return itr->second;
+}
+
+const GroupIndex::Group *GroupIndex::GetGroup(int groupId) const
+{
+	if (groupId < 0 || static_cast<size_t>(groupId) >= m_groups.size())
+	{
+		return nullptr;
+	}
+
+	return &m_groups[groupId];
+}
+
+std::vector<int> GroupIndex::TakeChangedGroups()
+{
+	for (int groupId : m_changedGroups)
+	{
+		m_changed[groupId] = false;
+	}
+
+	return std::exchange(m_changedGroups, {});
+}
+
+void GroupIndex::Clear()
+{
+	m_groupIds.clear();
+	m_groups.clear();
+	m_changed.clear();
+	m_changedGroups.clear();
+}
+
+size_t GroupIndex::GetNumGroups() const
+{
+	return m_groups.size();
+}
+
+void GroupIndex::MarkChanged(int groupId)
+{
+	if (!m_changed[groupId])
+	{
+		m_changed[groupId] = true;
+		m_changedGroups.push_back(groupId);
+	}
+}
@@ -0,0 +1,81 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Assigns an ID to each distinct group header and keeps a count of the items
+// in each group. IDs are allocated sequentially, starting from 0, and aren't
+// reused until the index is cleared.
+//
+// Updating the header shown for a group (which includes the number of items
+// in it) is comparatively expensive, so rather than updating it each time an
+// item is added or removed, the groups whose counts have changed are
+// recorded. Once a batch of items has been added or removed, the changed
+// groups can be retrieved and each header updated once.
+//
+// This class isn't thread-safe.
+class GroupIndex
+{
+public:
+
+	struct Group
+	{
+		int id;
+		std::wstring header;
+		int numItems;
+	};
+
+	struct AddResult
+	{
+		int groupId;
+
+		// True if the group didn't previously exist.
+		bool created;
+	};
+
+	// Returns the header text shown for a group, which includes the number
+	// of items in the group.
+	static std::wstring FormatHeader(std::wstring_view header, int numItems);
+
+	// Adds an item to the group with the specified header, creating the
+	// group if necessary.
+	AddResult AddItem(std::wstring_view header);
+
+	// Removes an item from the specified group. A group that becomes empty
+	// is kept, so that its ID remains valid.
+	void RemoveItem(int groupId);
+
+	std::optional<int> FindGroup(std::wstring_view header) const;
+
+	// Returns nullptr if there's no group with the specified ID.
+	const Group *GetGroup(int groupId) const;
+
+	// Returns the IDs of the groups whose item count has changed since the
+	// last call, in the order they were first changed.
+	std::vector<int> TakeChangedGroups();
+
+	void Clear();
+
+	size_t GetNumGroups() const;
+
+private:
+
+	void MarkChanged(int groupId);
+
+	// A deque is used so that group headers never move, allowing the map
+	// below to refer to them directly.
+	std::deque<Group> m_groups;
+	std::unordered_map<std::wstring_view, int> m_groupIds;
+
+	// Indexed by group ID.
+	std::vector<bool> m_changed;
+	std::vector<int> m_changedGroups;
+};
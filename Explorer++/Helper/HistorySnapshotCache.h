@@ -0,0 +1,148 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+// Holds snapshots of recently visited folders, keyed by the ID of the history
+// entry each folder was visited through. When going back (or forward) to one
+// of those entries, the folder can then be shown straight from its snapshot,
+// rather than having to be read in again.
+//
+// The cache is bounded both by the number of snapshots and by their total
+// size (as estimated by the caller). Once either limit is exceeded, the
+// snapshots that were inserted least recently are evicted.
+//
+// A snapshot is removed from the cache when it's taken, since the state it
+// holds is then handed back to the folder. If the folder is left again, a new
+// snapshot is inserted.
+template <typename T>
+class HistorySnapshotCache
+{
+public:
+
+	HistorySnapshotCache(size_t maxEntries, size_t maxSize) :
+		m_maxEntries(maxEntries),
+		m_maxSize(maxSize),
+		m_size(0),
+		m_numEvicted(0)
+	{
+
+	}
+
+	// Stores the snapshot for the entry, replacing any existing snapshot.
+	// Returns false (discarding the snapshot) if it wouldn't fit in the
+	// cache, even with every other snapshot evicted.
+	bool Insert(int entryId, T snapshot, size_t size)
+	{
+		Remove(entryId);
+
+		if (m_maxEntries == 0 || size > m_maxSize)
+		{
+			return false;
+		}
+
+		m_entries.push_front({ entryId, std::move(snapshot), size });
+		m_index.insert({ entryId, m_entries.begin() });
+		m_size += size;
+
+		while (m_entries.size() > m_maxEntries || m_size > m_maxSize)
+		{
+			RemoveEntry(std::prev(m_entries.end()));
+			m_numEvicted++;
+		}
+
+		return true;
+	}
+
+	// Removes the snapshot for the entry from the cache and returns it.
+	std::optional<T> Take(int entryId)
+	{
+		auto itr = m_index.find(entryId);
+
+		if (itr == m_index.end())
+		{
+			return std::nullopt;
+		}
+
+		std::optional<T> snapshot(std::move(itr->second->snapshot));
+		RemoveEntry(itr->second);
+
+		return snapshot;
+	}
+
+	bool Contains(int entryId) const
+	{
+		return m_index.count(entryId) != 0;
+	}
+
+	void Remove(int entryId)
+	{
+		auto itr = m_index.find(entryId);
+
+		if (itr != m_index.end())
+		{
+			RemoveEntry(itr->second);
+		}
+	}
+
+	void Clear()
+	{
+		m_entries.clear();
+		m_index.clear();
+		m_size = 0;
+	}
+
+	size_t GetNumEntries() const
+	{
+		return m_entries.size();
+	}
+
+	// The total size of the snapshots currently in the cache.
+	size_t GetSize() const
+	{
+		return m_size;
+	}
+
+	// The number of snapshots that have been evicted to make room for
+	// others.
+	uint64_t GetNumEvicted() const
+	{
+		return m_numEvicted;
+	}
+
+private:
+
+	struct Entry
+	{
+		int entryId;
+		T snapshot;
+		size_t size;
+	};
+
+	using EntryList = std::list<Entry>;
+
+	void RemoveEntry(typename EntryList::iterator itr)
+	{
+		m_size -= itr->size;
+		m_index.erase(itr->entryId);
+		m_entries.erase(itr);
+	}
+
+	const size_t m_maxEntries;
+	const size_t m_maxSize;
+
+	// Ordered from most to least recently inserted.
+	EntryList m_entries;
+	std::unordered_map<int, typename EntryList::iterator> m_index;
+
+	size_t m_size;
+	uint64_t m_numEvicted;
+};
@@ -4,33 +4,36 @@
 
 #include "stdafx.h"
 #include "IconFetcher.h"
-#include "CachedIcons.h"
+#include <cstring>
 
-IconFetcher::IconFetcher(HWND hwnd, CachedIcons *cachedIcons) :
-	m_hwnd(hwnd),
-	m_cachedIcons(cachedIcons),
-	m_iconThreadPool(1),
-	m_iconResultIDCounter(0)
+namespace
 {
-	m_windowSubclasses.push_back(WindowSubclassWrapper(hwnd, WindowSubclassStub,
-		SUBCLASS_ID, reinterpret_cast<DWORD_PTR>(this)));
+	size_t HashBytes(const void *data, size_t size)
+	{
+		// FNV-1a
+		auto bytes = static_cast<const unsigned char *>(data);
+		uint64_t hash = 14695981039346656037ULL;
 
-	m_iconThreadPool.push([] (int id) {
-		UNREFERENCED_PARAMETER(id);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
 
-		CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
-	});
+		return static_cast<size_t>(hash);
+	}
 }
 
-IconFetcher::~IconFetcher()
+IconFetcher::IconFetcher(HWND hwnd, CachedIcons *cachedIcons) :
+	m_hwnd(hwnd),
+	m_cachedIcons(cachedIcons),
+	m_iconRequests(TaskExecutor::GetShared(), FindIconsAsync, [hwnd] {
+		PostMessage(hwnd, WM_APP_ICON_RESULTS_READY, 0, 0);
+	}, MAX_ICONS_PER_BATCH, static_cast<size_t>(TaskExecutor::GetShared().GetMaxBlockingTasks()),
+		TaskKind::Blocking)
 {
-	m_iconThreadPool.clear_queue();
-
-	m_iconThreadPool.push([] (int id) {
-		UNREFERENCED_PARAMETER(id);
-
-		CoUninitialize();
-	});
+	m_windowSubclasses.push_back(WindowSubclassWrapper(hwnd, WindowSubclassStub,
+		SUBCLASS_ID, reinterpret_cast<DWORD_PTR>(this)));
 }
 
 LRESULT CALLBACK IconFetcher::WindowSubclassStub(HWND hwnd, UINT uMsg,
@@ -47,8 +50,8 @@ LRESULT CALLBACK IconFetcher::WindowSubclass(HWND hwnd, UINT msg, WPARAM wParam,
 {
 	switch (msg)
 	{
-	case WM_APP_ICON_RESULT_READY:
-		ProcessIconResult(static_cast<int>(wParam));
+	case WM_APP_ICON_RESULTS_READY:
+		ProcessIconResults();
 		return 0;
 		break;
 	}
@@ -58,26 +61,64 @@ LRESULT CALLBACK IconFetcher::WindowSubclass(HWND hwnd, UINT msg, WPARAM wParam,
 
 void IconFetcher::QueueIconTask(PCIDLIST_ABSOLUTE pidl, Callback callback)
 {
-	int iconResultID = m_iconResultIDCounter++;
+	auto cachedIconIndex = FindCachedClassIcon(pidl);
 
-	BasicItemInfo basicItemInfo;
-	basicItemInfo.pidl.reset(ILCloneFull(pidl));
+	if (cachedIconIndex)
+	{
+		// The result is still delivered via the message loop, so that the
+		// callback is never invoked from within this call. As the path is
+		// left empty, the result won't be added back into the cache.
+		IconResult result;
+		result.iconIndex = *cachedIconIndex;
+		result.itemType = CachedIcons::ItemType::File;
+
+		m_iconRequests.PushResult(pidl, std::move(result), std::move(callback));
+		return;
+	}
 
-	auto iconResult = m_iconThreadPool.push([this, iconResultID, basicItemInfo] (int id) {
-		UNREFERENCED_PARAMETER(id);
+	m_iconRequests.Push(pidl, std::move(callback));
+}
 
-		return FindIconAsync(m_hwnd, iconResultID, basicItemInfo.pidl.get());
-	});
+std::optional<int> IconFetcher::FindCachedClassIcon(PCIDLIST_ABSOLUTE pidl)
+{
+	TCHAR filePath[MAX_PATH];
+	HRESULT hr = GetDisplayName(pidl, filePath, static_cast<UINT>(std::size(filePath)),
+		SHGDN_FORPARSING);
+
+	// The attributes are only retrieved if the path has an extension that
+	// could be cached, since that's the less common case for folders.
+	if (FAILED(hr) || !CachedIcons::getIconClass(filePath, CachedIcons::ItemType::File))
+	{
+		return std::nullopt;
+	}
+
+	SFGAOF attributes = SFGAO_FOLDER;
+	hr = GetItemAttributes(pidl, &attributes);
+
+	if (FAILED(hr) || WI_IsFlagSet(attributes, SFGAO_FOLDER))
+	{
+		return std::nullopt;
+	}
+
+	auto cachedIcon = m_cachedIcons->findIcon(filePath, CachedIcons::ItemType::File);
+
+	if (!cachedIcon || cachedIcon->level != CachedIcon::Level::Class)
+	{
+		return std::nullopt;
+	}
 
-	FutureResult futureResult;
-	futureResult.callback = callback;
-	futureResult.pidl.reset(ILCloneFull(pidl));
-	futureResult.iconResult = std::move(iconResult);
-	m_iconResults.insert({ iconResultID, std::move(futureResult) });
+	return cachedIcon->iconIndex;
 }
 
-std::optional<IconFetcher::IconResult> IconFetcher::FindIconAsync(HWND hwnd, int iconResultId,
-	PCIDLIST_ABSOLUTE pidl)
+void IconFetcher::FindIconsAsync(const std::vector<IconRequestQueue::BatchItem> &items)
+{
+	for (const auto &item : items)
+	{
+		*item.result = FindIconAsync(item.request->get());
+	}
+}
+
+std::optional<IconFetcher::IconResult> IconFetcher::FindIconAsync(PCIDLIST_ABSOLUTE pidl)
 {
 	// Must use SHGFI_ICON here, rather than SHGFO_SYSICONINDEX, or else 
 	// icon overlays won't be applied.
@@ -95,6 +136,26 @@ std::optional<IconFetcher::IconResult> IconFetcher::FindIconAsync(HWND hwnd, int
 	IconResult result;
 	result.iconIndex = shfi.iIcon;
 
+	// The location of the icon is what's saved in the icon cache, since the
+	// index above is only valid for the current session.
+	shfi.dwAttributes = SFGAO_FOLDER;
+	res = SHGetFileInfo(reinterpret_cast<LPCTSTR>(pidl), 0, &shfi, sizeof(SHFILEINFO),
+		SHGFI_PIDL | SHGFI_ICONLOCATION | SHGFI_ATTRIBUTES | SHGFI_ATTR_SPECIFIED);
+
+	if (res != 0 && WI_IsFlagSet(shfi.dwAttributes, SFGAO_FOLDER))
+	{
+		result.itemType = CachedIcons::ItemType::Folder;
+	}
+	else
+	{
+		result.itemType = CachedIcons::ItemType::File;
+	}
+
+	if (res != 0 && shfi.szDisplayName[0] != '\0')
+	{
+		result.iconLocation = IconLocation{ shfi.szDisplayName, shfi.iIcon };
+	}
+
 	TCHAR filePath[MAX_PATH];
 	HRESULT hr = GetDisplayName(pidl, filePath, static_cast<UINT>(std::size(filePath)),
 		SHGDN_FORPARSING);
@@ -104,39 +165,78 @@ std::optional<IconFetcher::IconResult> IconFetcher::FindIconAsync(HWND hwnd, int
 		result.path = filePath;
 	}
 
-	PostMessage(hwnd, WM_APP_ICON_RESULT_READY, iconResultId, 0);
-
 	return result;
 }
 
-void IconFetcher::ProcessIconResult(int iconResultId)
+void IconFetcher::ProcessIconResults()
 {
-	auto itr = m_iconResults.find(iconResultId);
+	m_iconRequests.DeliverResults([this] (const unique_pidl_absolute &pidl, const std::optional<IconResult> &result,
+		std::vector<Callback> &callbacks) {
+		if (!result)
+		{
+			// Icon lookup failed.
+			return;
+		}
+
+		if (!result->path.empty())
+		{
+			m_cachedIcons->addOrUpdateFileIcon(result->path, result->itemType, result->iconIndex,
+				result->iconLocation);
+		}
+
+		for (auto &callback : callbacks)
+		{
+			callback(pidl.get(), result->iconIndex);
+		}
+	});
+}
 
-	if (itr == m_iconResults.end())
-	{
-		return;
-	}
+void IconFetcher::ClearQueue()
+{
+	m_iconRequests.Clear();
+}
 
-	auto &futureResult = itr->second;
-	auto result = futureResult.iconResult.get();
+size_t IconFetcher::IconRequestTraits::Hash(PCIDLIST_ABSOLUTE pidl)
+{
+	return HashBytes(pidl, ILGetSize(pidl));
+}
 
-	if (!result)
-	{
-		// Icon lookup failed.
-		return;
-	}
+// Items are batched by their parent folder.
+size_t IconFetcher::IconRequestTraits::GetBatchKey(PCIDLIST_ABSOLUTE pidl)
+{
+	auto lastId = ILFindLastID(pidl);
+	return HashBytes(pidl, reinterpret_cast<const BYTE *>(lastId) - reinterpret_cast<const BYTE *>(pidl));
+}
+
+bool IconFetcher::IconRequestTraits::Equals(const unique_pidl_absolute &request, PCIDLIST_ABSOLUTE pidl)
+{
+	UINT size = ILGetSize(pidl);
+	return ILGetSize(request.get()) == size && memcmp(request.get(), pidl, size) == 0;
+}
+
+void IconFetcher::IconRequestTraits::Assign(unique_pidl_absolute &request, PCIDLIST_ABSOLUTE pidl)
+{
+	UINT size = ILGetSize(pidl);
 
-	if (!result->path.empty())
+	// The request is pooled, so its existing buffer is reused if the new pidl
+	// fits.
+	if (request && ILGetSize(request.get()) >= size)
 	{
-		m_cachedIcons->addOrUpdateFileIcon(result->path, result->iconIndex);
+		memcpy(request.get(), pidl, size);
+		return;
 	}
 
-	futureResult.callback(futureResult.pidl.get(), result->iconIndex);
+	request.reset(ILCloneFull(pidl));
 }
 
-void IconFetcher::ClearQueue()
+std::optional<int> IconFetcher::ResolveIconLocation(const IconLocation &iconLocation)
 {
-	m_iconThreadPool.clear_queue();
-	m_iconResults.clear();
+	int iconIndex = Shell_GetCachedImageIndex(iconLocation.path.c_str(), iconLocation.index, 0);
+
+	if (iconIndex == -1)
+	{
+		return std::nullopt;
+	}
+
+	return iconIndex;
 }
\ No newline at end of file
@@ -4,16 +4,18 @@
 
 #pragma once
 
+#include "BatchedRequestQueue.h"
+#include "CachedIcons.h"
 #include "ShellHelper.h"
 #include "WindowSubclassWrapper.h"
-#include "../ThirdParty/CTPL/cpl_stl.h"
-#include <future>
 #include <functional>
 #include <optional>
-#include <unordered_map>
-
-class CachedIcons;
+#include <vector>
 
+// Looks up icons in the background. Requests for items in the same folder are
+// resolved together and identical requests that are outstanding at the same
+// time are only resolved once. Results are delivered to the window in
+// batches, rather than with a message per icon.
 class IconFetcher
 {
 public:
@@ -21,54 +23,64 @@ public:
 	using Callback = std::function<void(PCIDLIST_ABSOLUTE pidl, int iconIndex)>;
 
 	IconFetcher(HWND hwnd, CachedIcons *cachedIcons);
-	~IconFetcher();
 
+	// If the item's icon is shared by every file of its type and that icon is
+	// already cached, no background work is done and the cached icon is
+	// passed to the callback once control returns to the message loop.
 	void QueueIconTask(PCIDLIST_ABSOLUTE pidl, Callback callback);
 	void ClearQueue();
 
+	// Loads an icon that was saved by the icon cache into the system image
+	// list.
+	static std::optional<int> ResolveIconLocation(const IconLocation &iconLocation);
+
 private:
 
 	static const UINT_PTR SUBCLASS_ID = 0;
 
-	static const UINT WM_APP_ICON_RESULT_READY = WM_APP + 200;
+	static const UINT WM_APP_ICON_RESULTS_READY = WM_APP + 200;
 
-	struct BasicItemInfo
-	{
-		BasicItemInfo() = default;
-
-		BasicItemInfo(const BasicItemInfo &other)
-		{
-			pidl.reset(ILCloneFull(other.pidl.get()));
-		}
-
-		unique_pidl_absolute pidl;
-	};
+	// The maximum number of icons that are looked up in a single task.
+	static const size_t MAX_ICONS_PER_BATCH = 16;
 
 	struct IconResult
 	{
 		int iconIndex;
 		std::wstring path;
+		CachedIcons::ItemType itemType;
+		std::optional<IconLocation> iconLocation;
 	};
 
-	struct FutureResult
+	// Requests are compared by their binary pidl. Two different pidls for the
+	// same item won't be merged, but that only costs an extra lookup.
+	struct IconRequestTraits
 	{
-		Callback callback;
-		unique_pidl_absolute pidl;
-		std::future<std::optional<IconResult>> iconResult;
+		using Key = PCIDLIST_ABSOLUTE;
+		using Request = unique_pidl_absolute;
+		using Result = IconResult;
+		using Waiter = Callback;
+
+		static size_t Hash(PCIDLIST_ABSOLUTE pidl);
+		static size_t GetBatchKey(PCIDLIST_ABSOLUTE pidl);
+		static bool Equals(const unique_pidl_absolute &request, PCIDLIST_ABSOLUTE pidl);
+		static void Assign(unique_pidl_absolute &request, PCIDLIST_ABSOLUTE pidl);
 	};
 
+	using IconRequestQueue = BatchedRequestQueue<IconRequestTraits>;
+
 	static LRESULT CALLBACK WindowSubclassStub(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam, UINT_PTR uIdSubclass, DWORD_PTR dwRefData);
 	LRESULT CALLBACK WindowSubclass(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
-	static std::optional<IconResult> FindIconAsync(HWND hwnd, int iconResultId, PCIDLIST_ABSOLUTE pidl);
-	void ProcessIconResult(int iconResultId);
+	std::optional<int> FindCachedClassIcon(PCIDLIST_ABSOLUTE pidl);
+	static void FindIconsAsync(const std::vector<IconRequestQueue::BatchItem> &items);
+	static std::optional<IconResult> FindIconAsync(PCIDLIST_ABSOLUTE pidl);
+	void ProcessIconResults();
 
 	const HWND m_hwnd;
+	CachedIcons *m_cachedIcons;
 	std::vector<WindowSubclassWrapper> m_windowSubclasses;
 
-	ctpl::thread_pool m_iconThreadPool;
-	std::unordered_map<int, FutureResult> m_iconResults;
-	int m_iconResultIDCounter;
-	CachedIcons *m_cachedIcons;
-	std::function<void(int data)> m_callback;
+	// Destroyed first, so that no lookups are running once the rest of the
+	// object has gone.
+	IconRequestQueue m_iconRequests;
 };
\ No newline at end of file
@@ -0,0 +1,213 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "IncrementalFilter.h"
+
+IncrementalFilter::IncrementalFilter(NameCallback nameCallback) :
+	m_nameCallback(std::move(nameCallback)),
+	m_numItems(0),
+	m_numVisibleItems(0),
+	m_numItemsLastTested(0)
+{
+
+}
+
+bool IncrementalFilter::AddItem(int id, bool exempt)
+{
+	auto index = static_cast<size_t>(id);
+
+	if (index >= m_items.size())
+	{
+		m_items.resize(index + 1, false);
+		m_exempt.resize(index + 1, false);
+		m_visible.resize(index + 1, false);
+	}
+
+	if (m_items[index])
+	{
+		RemoveItem(id);
+	}
+
+	m_items[index] = true;
+	m_exempt[index] = exempt;
+	m_numItems++;
+
+	bool visible = exempt || PassesFilter(id);
+	SetVisible(id, visible);
+
+	return visible;
+}
+
+void IncrementalFilter::RemoveItem(int id)
+{
+	if (static_cast<size_t>(id) >= m_items.size() || !m_items[id])
+	{
+		return;
+	}
+
+	SetVisible(id, false);
+	m_items[id] = false;
+	m_exempt[id] = false;
+	m_numItems--;
+}
+
+bool IncrementalFilter::UpdateItem(int id)
+{
+	if (static_cast<size_t>(id) >= m_items.size() || !m_items[id])
+	{
+		return false;
+	}
+
+	bool visible = m_exempt[id] || PassesFilter(id);
+	SetVisible(id, visible);
+
+	return visible;
+}
+
+void IncrementalFilter::Clear()
+{
+	m_items.clear();
+	m_exempt.clear();
+	m_visible.clear();
+	m_numItems = 0;
+	m_numVisibleItems = 0;
+}
+
+IncrementalFilter::Changes IncrementalFilter::SetFilter(std::wstring_view pattern, bool caseSensitive)
+{
+	CompiledWildcard filter(pattern, caseSensitive);
+
+	if (!m_filter)
+	{
+		m_filter = std::move(filter);
+		return Update(Candidates::Visible);
+	}
+
+	bool narrower = filter.Narrows(*m_filter);
+	bool wider = m_filter->Narrows(filter);
+	m_filter = std::move(filter);
+
+	if (narrower && wider)
+	{
+		// The filters are equivalent, so nothing can change.
+		m_numItemsLastTested = 0;
+		return {};
+	}
+	else if (narrower)
+	{
+		return Update(Candidates::Visible);
+	}
+	else if (wider)
+	{
+		return Update(Candidates::Hidden);
+	}
+
+	return Update(Candidates::All);
+}
+
+IncrementalFilter::Changes IncrementalFilter::RemoveFilter()
+{
+	if (!m_filter)
+	{
+		m_numItemsLastTested = 0;
+		return {};
+	}
+
+	m_filter.reset();
+	return Update(Candidates::Hidden);
+}
+
+bool IncrementalFilter::HasFilter() const
+{
+	return m_filter.has_value();
+}
+
+IncrementalFilter::Changes IncrementalFilter::Update(Candidates candidates)
+{
+	Changes changes;
+	m_numItemsLastTested = 0;
+
+	for (size_t i = 0; i < m_items.size(); i++)
+	{
+		if (!m_items[i] || m_exempt[i])
+		{
+			continue;
+		}
+
+		bool visible = m_visible[i];
+
+		if ((candidates == Candidates::Visible && !visible)
+			|| (candidates == Candidates::Hidden && visible))
+		{
+			continue;
+		}
+
+		int id = static_cast<int>(i);
+		bool passes = PassesFilter(id);
+		m_numItemsLastTested++;
+
+		if (passes == visible)
+		{
+			continue;
+		}
+
+		SetVisible(id, passes);
+
+		if (passes)
+		{
+			changes.shown.push_back(id);
+		}
+		else
+		{
+			changes.hidden.push_back(id);
+		}
+	}
+
+	return changes;
+}
+
+bool IncrementalFilter::PassesFilter(int id) const
+{
+	return !m_filter || m_filter->Match(m_nameCallback(id));
+}
+
+void IncrementalFilter::SetVisible(int id, bool visible)
+{
+	if (m_visible[id] == visible)
+	{
+		return;
+	}
+
+	m_visible[id] = visible;
+
+	if (visible)
+	{
+		m_numVisibleItems++;
+	}
+	else
+	{
+		m_numVisibleItems--;
+	}
+}
+
+bool IncrementalFilter::IsVisible(int id) const
+{
+	return static_cast<size_t>(id) < m_visible.size() && m_visible[id];
+}
+
+size_t IncrementalFilter::GetNumItems() const
+{
+	return m_numItems;
+}
+
+size_t IncrementalFilter::GetNumVisibleItems() const
+{
+	return m_numVisibleItems;
+}
+
+size_t IncrementalFilter::GetNumItemsLastTested() const
+{
+	return m_numItemsLastTested;
+}
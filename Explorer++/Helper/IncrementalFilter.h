@@ -0,0 +1,91 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include "CompiledWildcard.h"
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Tracks which items pass the current filename filter, so that a change to
+// the filter only has to re-test the items it can actually affect:
+//
+// - If the new filter is narrower than the previous one (e.g. "*abcd*" after
+//   "*abc*", as happens when a character is typed), only the items that are
+//   currently visible are tested.
+// - If it's wider (e.g. when a character is deleted), only the items that are
+//   currently hidden are tested.
+// - Otherwise, every item is tested.
+//
+// Visibility is stored as a bitset indexed by item ID (as allocated by
+// ItemStore). Each change to the filter returns the items whose visibility
+// changed, so that the view can be updated in a single batch.
+class IncrementalFilter
+{
+public:
+
+	// Returns the name that the filter is matched against.
+	using NameCallback = std::function<std::wstring_view(int id)>;
+
+	// Both lists are in order of item ID.
+	struct Changes
+	{
+		std::vector<int> hidden;
+		std::vector<int> shown;
+	};
+
+	explicit IncrementalFilter(NameCallback nameCallback);
+
+	// Exempt items (e.g. folders) are never filtered. Returns true if the
+	// item is visible.
+	bool AddItem(int id, bool exempt);
+	void RemoveItem(int id);
+
+	// Tests the item against the current filter again (e.g. after its name
+	// has changed). Returns true if the item is visible.
+	bool UpdateItem(int id);
+
+	void Clear();
+
+	Changes SetFilter(std::wstring_view pattern, bool caseSensitive);
+	Changes RemoveFilter();
+	bool HasFilter() const;
+
+	// Items that haven't been added are never visible.
+	bool IsVisible(int id) const;
+
+	size_t GetNumItems() const;
+	size_t GetNumVisibleItems() const;
+
+	// The number of items that were tested during the last change to the
+	// filter.
+	size_t GetNumItemsLastTested() const;
+
+private:
+
+	enum class Candidates
+	{
+		Visible,
+		Hidden,
+		All
+	};
+
+	Changes Update(Candidates candidates);
+	bool PassesFilter(int id) const;
+	void SetVisible(int id, bool visible);
+
+	NameCallback m_nameCallback;
+	std::optional<CompiledWildcard> m_filter;
+
+	// Each of these is indexed by item ID.
+	std::vector<bool> m_items;
+	std::vector<bool> m_exempt;
+	std::vector<bool> m_visible;
+
+	size_t m_numItems;
+	size_t m_numVisibleItems;
+	size_t m_numItemsLastTested;
+};
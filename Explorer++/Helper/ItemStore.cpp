@@ -0,0 +1,443 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "ItemStore.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+ItemStore::ItemStore() :
+	m_numItems(0)
+{
+
+}
+
+int ItemStore::AddItem(const FileData &fileData, std::wstring_view displayName)
+{
+	int id = static_cast<int>(m_live.size());
+
+	m_live.push_back(1);
+	m_attributes.push_back(fileData.attributes);
+	m_sizes.push_back(fileData.size);
+	m_creationTimes.push_back(fileData.creationTime);
+	m_lastAccessTimes.push_back(fileData.lastAccessTime);
+	m_lastWriteTimes.push_back(fileData.lastWriteTime);
+	m_fileNames.push_back(m_strings.Intern(fileData.fileName));
+	m_alternateFileNames.push_back(m_strings.Intern(fileData.alternateFileName));
+	m_displayNames.push_back(m_strings.Intern(displayName));
+	m_colorRules.push_back(NO_COLOR_RULE);
+
+	AddToIndex(m_fileNameIndex, m_fileNames.back(), id);
+	AddToIndex(m_alternateFileNameIndex, m_alternateFileNames.back(), id);
+
+	m_numItems++;
+
+	return id;
+}
+
+void ItemStore::RemoveItem(int id)
+{
+	CheckId(id);
+
+	if (!m_live[id])
+	{
+		return;
+	}
+
+	RemoveFromIndex(m_fileNameIndex, m_fileNames[id], id);
+	RemoveFromIndex(m_alternateFileNameIndex, m_alternateFileNames[id], id);
+
+	m_live[id] = 0;
+	m_numItems--;
+}
+
+bool ItemStore::IsValidItem(int id) const
+{
+	return id >= 0 && id < static_cast<int>(m_live.size()) && m_live[id];
+}
+
+void ItemStore::Clear()
+{
+	m_live.clear();
+	m_attributes.clear();
+	m_sizes.clear();
+	m_creationTimes.clear();
+	m_lastAccessTimes.clear();
+	m_lastWriteTimes.clear();
+	m_fileNames.clear();
+	m_alternateFileNames.clear();
+	m_displayNames.clear();
+	m_colorRules.clear();
+	m_numItems = 0;
+
+	m_fileNameIndex.clear();
+	m_alternateFileNameIndex.clear();
+
+	m_strings.Clear();
+}
+
+int ItemStore::GetNumItems() const
+{
+	return m_numItems;
+}
+
+int ItemStore::GetIdLimit() const
+{
+	return static_cast<int>(m_live.size());
+}
+
+void ItemStore::SetFileData(int id, const FileData &fileData)
+{
+	CheckId(id);
+
+	m_attributes[id] = fileData.attributes;
+	m_sizes[id] = fileData.size;
+	m_creationTimes[id] = fileData.creationTime;
+	m_lastAccessTimes[id] = fileData.lastAccessTime;
+	m_lastWriteTimes[id] = fileData.lastWriteTime;
+	SetFileName(id, fileData.fileName);
+
+	StringId alternateFileName = m_strings.Intern(fileData.alternateFileName);
+
+	if (m_live[id] && alternateFileName != m_alternateFileNames[id])
+	{
+		RemoveFromIndex(m_alternateFileNameIndex, m_alternateFileNames[id], id);
+		AddToIndex(m_alternateFileNameIndex, alternateFileName, id);
+	}
+
+	m_alternateFileNames[id] = alternateFileName;
+}
+
+void ItemStore::SetFileName(int id, std::wstring_view fileName)
+{
+	CheckId(id);
+
+	StringId name = m_strings.Intern(fileName);
+
+	if (m_live[id] && name != m_fileNames[id])
+	{
+		RemoveFromIndex(m_fileNameIndex, m_fileNames[id], id);
+		AddToIndex(m_fileNameIndex, name, id);
+	}
+
+	m_fileNames[id] = name;
+}
+
+void ItemStore::SetDisplayName(int id, std::wstring_view displayName)
+{
+	CheckId(id);
+
+	m_displayNames[id] = m_strings.Intern(displayName);
+}
+
+void ItemStore::SetSize(int id, uint64_t size)
+{
+	CheckId(id);
+
+	m_sizes[id] = size;
+}
+
+void ItemStore::SetColorRule(int id, uint16_t colorRule)
+{
+	CheckId(id);
+
+	m_colorRules[id] = colorRule;
+}
+
+uint16_t ItemStore::GetColorRule(int id) const
+{
+	CheckId(id);
+
+	return m_colorRules[id];
+}
+
+uint32_t ItemStore::GetAttributes(int id) const
+{
+	CheckId(id);
+
+	return m_attributes[id];
+}
+
+bool ItemStore::IsFolder(int id) const
+{
+	CheckId(id);
+
+	return (m_attributes[id] & ATTRIBUTE_DIRECTORY) == ATTRIBUTE_DIRECTORY;
+}
+
+uint64_t ItemStore::GetSize(int id) const
+{
+	CheckId(id);
+
+	return m_sizes[id];
+}
+
+uint64_t ItemStore::GetCreationTime(int id) const
+{
+	CheckId(id);
+
+	return m_creationTimes[id];
+}
+
+uint64_t ItemStore::GetLastAccessTime(int id) const
+{
+	CheckId(id);
+
+	return m_lastAccessTimes[id];
+}
+
+uint64_t ItemStore::GetLastWriteTime(int id) const
+{
+	CheckId(id);
+
+	return m_lastWriteTimes[id];
+}
+
+std::wstring_view ItemStore::GetFileName(int id) const
+{
+	CheckId(id);
+
+	return m_strings.Get(m_fileNames[id]);
+}
+
+std::wstring_view ItemStore::GetAlternateFileName(int id) const
+{
+	CheckId(id);
+
+	return m_strings.Get(m_alternateFileNames[id]);
+}
+
+std::wstring_view ItemStore::GetDisplayName(int id) const
+{
+	CheckId(id);
+
+	return m_strings.Get(m_displayNames[id]);
+}
+
+const std::vector<uint32_t> &ItemStore::GetAttributesColumn() const
+{
+	return m_attributes;
+}
+
+const std::vector<uint64_t> &ItemStore::GetSizeColumn() const
+{
+	return m_sizes;
+}
+
+int ItemStore::FindItemByFileName(std::wstring_view fileName) const
+{
+	return FindItemByName(m_fileNameIndex, fileName);
+}
+
+int ItemStore::FindItemByAlternateFileName(std::wstring_view alternateFileName) const
+{
+	return FindItemByName(m_alternateFileNameIndex, alternateFileName);
+}
+
+int ItemStore::FindItemByName(const NameIndex &index, std::wstring_view name) const
+{
+	if (name.empty())
+	{
+		return -1;
+	}
+
+	/* Since names are interned, a name that's never been
+	interned can't belong to any item. */
+	auto nameId = m_strings.Find(name);
+
+	if (!nameId)
+	{
+		return -1;
+	}
+
+	auto range = index.equal_range(*nameId);
+	int foundId = -1;
+
+	for (auto itr = range.first; itr != range.second; ++itr)
+	{
+		if (foundId == -1 || itr->second < foundId)
+		{
+			foundId = itr->second;
+		}
+	}
+
+	return foundId;
+}
+
+void ItemStore::AddToIndex(NameIndex &index, StringId name, int id)
+{
+	/* String 0 is the empty string, which isn't indexed. */
+	if (name == 0)
+	{
+		return;
+	}
+
+	index.insert({ name, id });
+}
+
+void ItemStore::RemoveFromIndex(NameIndex &index, StringId name, int id)
+{
+	auto range = index.equal_range(name);
+
+	for (auto itr = range.first; itr != range.second; ++itr)
+	{
+		if (itr->second == id)
+		{
+			index.erase(itr);
+			break;
+		}
+	}
+}
+
+size_t ItemStore::GetMemoryUsage() const
+{
+	size_t usage = m_live.capacity() * sizeof(uint8_t);
+	usage += m_attributes.capacity() * sizeof(uint32_t);
+	usage += m_sizes.capacity() * sizeof(uint64_t);
+	usage += m_creationTimes.capacity() * sizeof(uint64_t);
+	usage += m_lastAccessTimes.capacity() * sizeof(uint64_t);
+	usage += m_lastWriteTimes.capacity() * sizeof(uint64_t);
+	usage += m_fileNames.capacity() * sizeof(StringId);
+	usage += m_alternateFileNames.capacity() * sizeof(StringId);
+	usage += m_displayNames.capacity() * sizeof(StringId);
+	usage += m_colorRules.capacity() * sizeof(uint16_t);
+	usage += m_strings.GetMemoryUsage();
+
+	/* Approximate the node overhead of the name indexes. */
+	size_t numIndexEntries = m_fileNameIndex.size() + m_alternateFileNameIndex.size();
+	usage += numIndexEntries * (sizeof(StringId) + sizeof(int) + 2 * sizeof(void *));
+	usage += (m_fileNameIndex.bucket_count() + m_alternateFileNameIndex.bucket_count()) * sizeof(void *);
+
+	return usage;
+}
+
+void ItemStore::CheckId(int id) const
+{
+	(void) id;
+
+	assert(id >= 0 && id < static_cast<int>(m_live.size()));
+}
+
+ItemStore::StringArena::StringArena() :
+	m_blockUsed(0),
+	m_blockCapacity(0),
+	m_totalAllocated(0)
+{
+	/* String 0 is always the empty string, so that items
+	without a name (e.g. no alternate file name) don't
+	need an arena allocation. */
+	m_strings.push_back(std::wstring_view(L"", 0));
+}
+
+ItemStore::StringId ItemStore::StringArena::Intern(std::wstring_view str)
+{
+	if (str.empty())
+	{
+		return 0;
+	}
+
+	auto itr = m_stringIds.find(str);
+
+	if (itr != m_stringIds.end())
+	{
+		return itr->second;
+	}
+
+	const wchar_t *data = Allocate(str);
+	std::wstring_view stored(data, str.size());
+
+	auto id = static_cast<StringId>(m_strings.size());
+	m_strings.push_back(stored);
+	m_stringIds.insert({ stored, id });
+
+	return id;
+}
+
+std::optional<ItemStore::StringId> ItemStore::StringArena::Find(std::wstring_view str) const
+{
+	auto itr = m_stringIds.find(str);
+
+	if (itr == m_stringIds.end())
+	{
+		return std::nullopt;
+	}
+
+	return itr->second;
+}
+
+std::wstring_view ItemStore::StringArena::Get(StringId id) const
+{
+	return m_strings[id];
+}
+
+const wchar_t *ItemStore::StringArena::Allocate(std::wstring_view str)
+{
+	size_t required = str.size() + 1;
+
+	if (required > BLOCK_SIZE)
+	{
+		/* Large strings get a block to themselves. The block is
+		inserted before the current block, so that the remaining
+		space in the current block can still be used. */
+		auto block = std::make_unique<wchar_t[]>(required);
+		wchar_t *data = block.get();
+
+		if (m_blocks.empty())
+		{
+			m_blocks.push_back(std::move(block));
+		}
+		else
+		{
+			m_blocks.insert(m_blocks.end() - 1, std::move(block));
+		}
+
+		std::copy(str.begin(), str.end(), data);
+		data[str.size()] = '\0';
+
+		m_totalAllocated += required;
+
+		return data;
+	}
+
+	if (m_blocks.empty() || (m_blockCapacity - m_blockUsed) < required)
+	{
+		m_blocks.push_back(std::make_unique<wchar_t[]>(BLOCK_SIZE));
+		m_blockUsed = 0;
+		m_blockCapacity = BLOCK_SIZE;
+		m_totalAllocated += BLOCK_SIZE;
+	}
+
+	wchar_t *data = m_blocks.back().get() + m_blockUsed;
+	std::copy(str.begin(), str.end(), data);
+	data[str.size()] = '\0';
+
+	m_blockUsed += required;
+
+	return data;
+}
+
+void ItemStore::StringArena::Clear()
+{
+	m_blocks.clear();
+	m_blockUsed = 0;
+	m_blockCapacity = 0;
+	m_totalAllocated = 0;
+
+	m_strings.clear();
+	m_strings.push_back(std::wstring_view(L"", 0));
+	m_stringIds.clear();
+}
+
+size_t ItemStore::StringArena::GetMemoryUsage() const
+{
+	size_t usage = m_totalAllocated * sizeof(wchar_t);
+	usage += m_strings.capacity() * sizeof(std::wstring_view);
+
+	/* Approximate the node overhead of the hash map. */
+	usage += m_stringIds.size() * (sizeof(std::wstring_view) + sizeof(StringId) + 2 * sizeof(void *));
+	usage += m_stringIds.bucket_count() * sizeof(void *);
+
+	return usage;
+}
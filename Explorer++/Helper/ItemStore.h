@@ -0,0 +1,163 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Stores the basic file system information for each item in a folder
+// listing. Rather than keeping one large structure per item, each
+// property is held in its own densely packed array (indexed by the item's
+// ID). That keeps the per-item overhead small and means that a pass over
+// a single property (e.g. checking attributes while filtering) only
+// touches the memory for that property.
+//
+// Item IDs are handed out sequentially, starting at 0, and are never
+// reused until the store is cleared.
+//
+// Names are stored in an arena of interned, null-terminated strings. The
+// views returned for a name remain valid until the store is cleared.
+//
+// File names (and alternate file names) are also indexed, so that an item
+// can be found by name without scanning every item.
+class ItemStore
+{
+public:
+
+	// Mirrors FILE_ATTRIBUTE_DIRECTORY.
+	static const uint32_t ATTRIBUTE_DIRECTORY = 0x10;
+
+	// Indicates that an item doesn't match any color rule. New items start
+	// out with this value.
+	static constexpr uint16_t NO_COLOR_RULE = UINT16_MAX;
+
+	struct FileData
+	{
+		uint32_t attributes = 0;
+		uint64_t size = 0;
+
+		// Times are stored in the same format as a FILETIME (i.e. the
+		// number of 100-nanosecond intervals since January 1, 1601).
+		uint64_t creationTime = 0;
+		uint64_t lastAccessTime = 0;
+		uint64_t lastWriteTime = 0;
+
+		std::wstring_view fileName;
+		std::wstring_view alternateFileName;
+	};
+
+	ItemStore();
+
+	int AddItem(const FileData &fileData, std::wstring_view displayName);
+	void RemoveItem(int id);
+	bool IsValidItem(int id) const;
+	void Clear();
+
+	// The number of items currently in the store.
+	int GetNumItems() const;
+
+	// One past the largest ID that has been handed out. All valid IDs are
+	// less than this value.
+	int GetIdLimit() const;
+
+	void SetFileData(int id, const FileData &fileData);
+	void SetFileName(int id, std::wstring_view fileName);
+	void SetDisplayName(int id, std::wstring_view displayName);
+	void SetSize(int id, uint64_t size);
+
+	// The index of the color rule that applies to the item (see
+	// ColorRuleSet). This isn't updated automatically when the other
+	// properties change, so it's up to the caller to classify the item again
+	// when necessary.
+	void SetColorRule(int id, uint16_t colorRule);
+	uint16_t GetColorRule(int id) const;
+
+	uint32_t GetAttributes(int id) const;
+	bool IsFolder(int id) const;
+	uint64_t GetSize(int id) const;
+	uint64_t GetCreationTime(int id) const;
+	uint64_t GetLastAccessTime(int id) const;
+	uint64_t GetLastWriteTime(int id) const;
+	std::wstring_view GetFileName(int id) const;
+	std::wstring_view GetAlternateFileName(int id) const;
+	std::wstring_view GetDisplayName(int id) const;
+
+	// Direct access to the packed columns. Entries for removed items are
+	// left in place, so callers scanning a column should check
+	// IsValidItem().
+	const std::vector<uint32_t> &GetAttributesColumn() const;
+	const std::vector<uint64_t> &GetSizeColumn() const;
+
+	// Returns the ID of the item with the specified name, or -1 if there
+	// is no such item. Names are matched exactly. If more than one item
+	// has the name, the item with the lowest ID is returned.
+	int FindItemByFileName(std::wstring_view fileName) const;
+	int FindItemByAlternateFileName(std::wstring_view alternateFileName) const;
+
+	// An estimate of the number of bytes used by the store.
+	size_t GetMemoryUsage() const;
+
+private:
+
+	using StringId = uint32_t;
+
+	class StringArena
+	{
+	public:
+
+		StringArena();
+
+		StringId Intern(std::wstring_view str);
+
+		// Returns the ID of the string, if it's been interned.
+		std::optional<StringId> Find(std::wstring_view str) const;
+		std::wstring_view Get(StringId id) const;
+		void Clear();
+		size_t GetMemoryUsage() const;
+
+	private:
+
+		static const size_t BLOCK_SIZE = 32 * 1024;
+
+		const wchar_t *Allocate(std::wstring_view str);
+
+		std::vector<std::unique_ptr<wchar_t[]>> m_blocks;
+		size_t m_blockUsed;
+		size_t m_blockCapacity;
+		size_t m_totalAllocated;
+
+		std::vector<std::wstring_view> m_strings;
+		std::unordered_map<std::wstring_view, StringId> m_stringIds;
+	};
+
+	using NameIndex = std::unordered_multimap<StringId, int>;
+
+	void CheckId(int id) const;
+
+	int FindItemByName(const NameIndex &index, std::wstring_view name) const;
+	static void AddToIndex(NameIndex &index, StringId name, int id);
+	static void RemoveFromIndex(NameIndex &index, StringId name, int id);
+
+	std::vector<uint8_t> m_live;
+	std::vector<uint32_t> m_attributes;
+	std::vector<uint64_t> m_sizes;
+	std::vector<uint64_t> m_creationTimes;
+	std::vector<uint64_t> m_lastAccessTimes;
+	std::vector<uint64_t> m_lastWriteTimes;
+	std::vector<StringId> m_fileNames;
+	std::vector<StringId> m_alternateFileNames;
+	std::vector<StringId> m_displayNames;
+	std::vector<uint16_t> m_colorRules;
+	int m_numItems;
+
+	StringArena m_strings;
+
+	NameIndex m_fileNameIndex;
+	NameIndex m_alternateFileNameIndex;
+};
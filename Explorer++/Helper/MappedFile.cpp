@@ -0,0 +1,128 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "MappedFile.h"
+
+#ifndef _WIN32
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::unique_ptr<MappedFile> MappedFile::Open(const std::wstring &path)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_FLAG_RANDOM_ACCESS, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return nullptr;
+	}
+
+	LARGE_INTEGER fileSize;
+	BOOL res = GetFileSizeEx(file, &fileSize);
+
+	if (!res || static_cast<ULONGLONG>(fileSize.QuadPart) > SIZE_MAX)
+	{
+		CloseHandle(file);
+		return nullptr;
+	}
+
+	if (fileSize.QuadPart == 0)
+	{
+		// An empty file can't be mapped.
+		CloseHandle(file);
+		return std::unique_ptr<MappedFile>(new MappedFile(nullptr, 0));
+	}
+
+	HANDLE mapping = CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	// The view keeps the mapping (and the file) open.
+	CloseHandle(file);
+
+	if (!mapping)
+	{
+		return nullptr;
+	}
+
+	void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+
+	if (!view)
+	{
+		return nullptr;
+	}
+
+	return std::unique_ptr<MappedFile>(new MappedFile(static_cast<const uint8_t *>(view),
+		static_cast<size_t>(fileSize.QuadPart)));
+#else
+	int fd = open(std::filesystem::path(path).c_str(), O_RDONLY);
+
+	if (fd == -1)
+	{
+		return nullptr;
+	}
+
+	struct stat fileStatus;
+
+	if (fstat(fd, &fileStatus) != 0)
+	{
+		close(fd);
+		return nullptr;
+	}
+
+	size_t size = static_cast<size_t>(fileStatus.st_size);
+
+	if (size == 0)
+	{
+		close(fd);
+		return std::unique_ptr<MappedFile>(new MappedFile(nullptr, 0));
+	}
+
+	void *view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (view == MAP_FAILED)
+	{
+		return nullptr;
+	}
+
+	return std::unique_ptr<MappedFile>(new MappedFile(static_cast<const uint8_t *>(view), size));
+#endif
+}
+
+MappedFile::MappedFile(const uint8_t *data, size_t size) :
+	m_data(data),
+	m_size(size)
+{
+
+}
+
+MappedFile::~MappedFile()
+{
+	if (!m_data)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(m_data);
+#else
+	munmap(const_cast<uint8_t *>(m_data), m_size);
+#endif
+}
+
+const uint8_t *MappedFile::GetData() const
+{
+	return m_data;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return m_size;
+}
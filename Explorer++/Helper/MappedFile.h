@@ -0,0 +1,38 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// A read-only view of an entire file, mapped into memory. Used by the
+// persistent caches, so that a cache file can be opened at startup without
+// having to read it in full.
+class MappedFile
+{
+public:
+
+	// Returns null if the file doesn't exist or can't be mapped. An empty
+	// file is mapped successfully, but has no data.
+	static std::unique_ptr<MappedFile> Open(const std::wstring &path);
+
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	// The data is aligned to (at least) a page boundary.
+	const uint8_t *GetData() const;
+	size_t GetSize() const;
+
+private:
+
+	MappedFile(const uint8_t *data, size_t size);
+
+	const uint8_t *m_data;
+	size_t m_size;
+};
@@ -0,0 +1,96 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+// An unbounded, lock-free queue that any number of threads can push to, but
+// only a single thread can pop from. Used to pass results from background
+// tasks back to the UI thread without the UI thread having to take a lock
+// (or receive a message) for each one.
+//
+// Pushing never blocks. A pop can briefly fail to see an item whose push is
+// still in progress on another thread; the item will be seen by a later pop.
+//
+// T must be default constructible.
+template <typename T>
+class MpscQueue
+{
+public:
+
+	MpscQueue()
+	{
+		// The queue always contains at least one node. The value in the
+		// front node has already been consumed (or is the initial,
+		// default constructed value).
+		Node *stub = new Node();
+		m_back.store(stub);
+		m_front = stub;
+	}
+
+	~MpscQueue()
+	{
+		Node *node = m_front;
+
+		while (node)
+		{
+			Node *next = node->next.load(std::memory_order_relaxed);
+			delete node;
+			node = next;
+		}
+	}
+
+	MpscQueue(const MpscQueue &) = delete;
+	MpscQueue &operator=(const MpscQueue &) = delete;
+
+	// Can be called from any thread.
+	void Push(T value)
+	{
+		Node *node = new Node();
+		node->value = std::move(value);
+
+		Node *previous = m_back.exchange(node, std::memory_order_acq_rel);
+		previous->next.store(node, std::memory_order_release);
+	}
+
+	// Can only be called from the consuming thread.
+	bool TryPop(T &value)
+	{
+		Node *front = m_front;
+		Node *next = front->next.load(std::memory_order_acquire);
+
+		if (!next)
+		{
+			return false;
+		}
+
+		value = std::move(next->value);
+		m_front = next;
+		delete front;
+
+		return true;
+	}
+
+	// Can only be called from the consuming thread.
+	bool IsEmpty() const
+	{
+		return m_front->next.load(std::memory_order_acquire) == nullptr;
+	}
+
+private:
+
+	struct Node
+	{
+		std::atomic<Node *> next = nullptr;
+		T value;
+	};
+
+	// Producers append to the back, while the consumer removes from the
+	// front. These are kept on separate cache lines, so that pushes don't
+	// slow down pops.
+	alignas(64) std::atomic<Node *> m_back;
+	alignas(64) Node *m_front;
+};
@@ -0,0 +1,122 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include "TaskExecutor.h"
+#include <algorithm>
+#include <vector>
+
+namespace ParallelSort
+{
+	// Inputs smaller than this won't be split across threads, since the
+	// overhead of scheduling the work would outweigh any benefit.
+	const size_t DEFAULT_MIN_BLOCK_SIZE = 2048;
+
+	// Splits the range [0, count) into contiguous blocks and calls
+	// function(begin, end) for each block on the executor. Returns once
+	// every block has been processed. If the range is small (or the
+	// executor only has a single thread), the function is simply called on
+	// the current thread.
+	template <typename Function>
+	void ParallelFor(TaskExecutor &executor, size_t count, Function function,
+		size_t minBlockSize = DEFAULT_MIN_BLOCK_SIZE)
+	{
+		size_t maxBlocks = (count + minBlockSize - 1) / minBlockSize;
+		size_t numBlocks = (std::min)(static_cast<size_t>(executor.GetNumThreads()), maxBlocks);
+
+		if (numBlocks <= 1)
+		{
+			function(static_cast<size_t>(0), count);
+			return;
+		}
+
+		executor.RunParallel(numBlocks, [count, numBlocks, &function] (size_t block) {
+			function((count * block) / numBlocks, (count * (block + 1)) / numBlocks);
+		});
+	}
+
+	// A stable merge sort. The input is split into one block per thread,
+	// each block is sorted independently and the sorted blocks are then
+	// merged pairwise (with the merges at each level also run in
+	// parallel). T must be default constructible.
+	template <typename T, typename Compare>
+	void ParallelMergeSort(TaskExecutor &executor, std::vector<T> &items, Compare compare,
+		size_t minBlockSize = DEFAULT_MIN_BLOCK_SIZE)
+	{
+		size_t count = items.size();
+		size_t maxBlocks = (count + minBlockSize - 1) / minBlockSize;
+		size_t numBlocks = (std::min)(static_cast<size_t>(executor.GetNumThreads()), maxBlocks);
+
+		if (numBlocks <= 1)
+		{
+			std::stable_sort(items.begin(), items.end(), compare);
+			return;
+		}
+
+		// Each run is [bounds[i], bounds[i + 1]).
+		std::vector<size_t> bounds;
+
+		for (size_t i = 0; i < numBlocks; i++)
+		{
+			bounds.push_back((count * i) / numBlocks);
+		}
+
+		bounds.push_back(count);
+
+		executor.RunParallel(numBlocks, [&items, &bounds, &compare] (size_t block) {
+			std::stable_sort(items.begin() + bounds[block], items.begin() + bounds[block + 1], compare);
+		});
+
+		std::vector<T> buffer(count);
+		std::vector<T> *source = &items;
+		std::vector<T> *destination = &buffer;
+
+		while (bounds.size() > 2)
+		{
+			size_t numRuns = bounds.size() - 1;
+			std::vector<size_t> mergedBounds;
+
+			for (size_t i = 0; i < numRuns; i += 2)
+			{
+				mergedBounds.push_back(bounds[i]);
+			}
+
+			// Each job merges a pair of runs. If there's an odd number of
+			// runs, the last one has no partner at this level, so it's simply
+			// carried over.
+			executor.RunParallel((numRuns + 1) / 2, [source, destination, numRuns, &bounds, &compare] (size_t pair) {
+				size_t i = pair * 2;
+
+				auto first = source->begin() + bounds[i];
+				auto middle = source->begin() + bounds[i + 1];
+				auto output = destination->begin() + bounds[i];
+
+				if (i + 1 == numRuns)
+				{
+					std::move(first, middle, output);
+					return;
+				}
+
+				auto last = source->begin() + bounds[i + 2];
+
+				// std::merge takes elements from the first range when
+				// elements compare equal, which keeps the sort stable.
+				std::merge(std::make_move_iterator(first), std::make_move_iterator(middle),
+					std::make_move_iterator(middle), std::make_move_iterator(last),
+					output, compare);
+			});
+
+			mergedBounds.push_back(count);
+			bounds = std::move(mergedBounds);
+
+			std::swap(source, destination);
+		}
+
+		if (source != &items)
+		{
+			items.swap(buffer);
+		}
+	}
+}
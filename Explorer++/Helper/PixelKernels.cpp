@@ -0,0 +1,1014 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "PixelKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define PIXEL_KERNELS_X86
+#endif
+
+#ifdef PIXEL_KERNELS_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+// MSVC allows any intrinsic to be used in any function, whereas gcc and clang
+// (including clang-cl) require functions using AVX2 instructions to be
+// explicitly marked.
+#if defined(__clang__) || defined(__GNUC__)
+#define PIXEL_KERNELS_TARGET(name) __attribute__((target(name)))
+#else
+#define PIXEL_KERNELS_TARGET(name)
+#endif
+
+using namespace PixelKernels;
+
+namespace
+{
+	const uint32_t ALPHA_MASK = 0xFF000000;
+
+	// (value * alpha) / 255, rounded to the nearest integer.
+	uint32_t MultiplyChannel(uint32_t value, uint32_t alpha)
+	{
+		uint32_t product = value * alpha + 128;
+		return (product + (product >> 8)) >> 8;
+	}
+
+	uint32_t PremultiplyPixel(uint32_t pixel)
+	{
+		uint32_t alpha = pixel >> 24;
+
+		return (pixel & ALPHA_MASK)
+			| (MultiplyChannel((pixel >> 16) & 0xFF, alpha) << 16)
+			| (MultiplyChannel((pixel >> 8) & 0xFF, alpha) << 8)
+			| MultiplyChannel(pixel & 0xFF, alpha);
+	}
+
+	void FillRowPortable(uint32_t *row, int width, uint32_t pixel)
+	{
+		std::fill(row, row + width, pixel);
+	}
+
+	void MakeOpaqueRowPortable(uint32_t *row, int width)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			row[x] |= ALPHA_MASK;
+		}
+	}
+
+	void PremultiplyRowPortable(uint32_t *row, int width)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			row[x] = PremultiplyPixel(row[x]);
+		}
+	}
+
+	uint32_t OrRowPortable(const uint32_t *row, int width)
+	{
+		uint32_t result = 0;
+
+		for (int x = 0; x < width; x++)
+		{
+			result |= row[x];
+		}
+
+		return result;
+	}
+
+	// Resampling uses 14-bit fixed point weights, which sum to 1 << 14 for
+	// each output pixel. Weights can be negative (for the Lanczos filter), so
+	// channels are accumulated as signed 32-bit values and clamped at the
+	// end. The vectorized implementations multiply and add pairs of 16-bit
+	// values (with pmaddwd), which gives exactly the same sums.
+	const int WEIGHT_BITS = 14;
+	const int32_t WEIGHT_ROUNDING = 1 << (WEIGHT_BITS - 1);
+
+	uint32_t PackChannels(const int32_t sums[4])
+	{
+		uint32_t result = 0;
+
+		for (int channel = 0; channel < 4; channel++)
+		{
+			int32_t value = (sums[channel] + WEIGHT_ROUNDING) >> WEIGHT_BITS;
+			value = (std::min)((std::max)(value, 0), 255);
+			result |= static_cast<uint32_t>(value) << (8 * channel);
+		}
+
+		return result;
+	}
+
+	// Applies the weights to the same pixel in each of the rows, for the
+	// pixels in [begin, end).
+	void ResampleColumnsPortable(const uint32_t *const *rows, const int16_t *weights, int numTaps,
+		uint32_t *output, int begin, int end)
+	{
+		for (int x = begin; x < end; x++)
+		{
+			int32_t sums[4] = {};
+
+			for (int tap = 0; tap < numTaps; tap++)
+			{
+				uint32_t pixel = rows[tap][x];
+
+				for (int channel = 0; channel < 4; channel++)
+				{
+					sums[channel] += weights[tap] * static_cast<int32_t>((pixel >> (8 * channel)) & 0xFF);
+				}
+			}
+
+			output[x] = PackChannels(sums);
+		}
+	}
+
+	// Applies the weights to a run of adjacent pixels.
+	uint32_t ResamplePixelPortable(const uint32_t *pixels, const int16_t *weights, int numTaps)
+	{
+		int32_t sums[4] = {};
+
+		for (int tap = 0; tap < numTaps; tap++)
+		{
+			for (int channel = 0; channel < 4; channel++)
+			{
+				sums[channel] += weights[tap] * static_cast<int32_t>((pixels[tap] >> (8 * channel)) & 0xFF);
+			}
+		}
+
+		return PackChannels(sums);
+	}
+
+	// Filters with negative lobes can produce color values larger than the
+	// alpha value, which isn't valid for a premultiplied pixel.
+	void ClampToAlphaRowPortable(uint32_t *row, int width)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			uint32_t alpha = row[x] >> 24;
+			uint32_t pixel = row[x] & ALPHA_MASK;
+
+			for (int shift = 0; shift < 24; shift += 8)
+			{
+				pixel |= (std::min)((row[x] >> shift) & 0xFF, alpha) << shift;
+			}
+
+			row[x] = pixel;
+		}
+	}
+
+#ifdef PIXEL_KERNELS_X86
+	void FillRowSse2(uint32_t *row, int width, uint32_t pixel)
+	{
+		__m128i value = _mm_set1_epi32(static_cast<int>(pixel));
+		int x = 0;
+
+		for (; x + 4 <= width; x += 4)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(row + x), value);
+		}
+
+		FillRowPortable(row + x, width - x, pixel);
+	}
+
+	void MakeOpaqueRowSse2(uint32_t *row, int width)
+	{
+		__m128i mask = _mm_set1_epi32(static_cast<int>(ALPHA_MASK));
+		int x = 0;
+
+		for (; x + 4 <= width; x += 4)
+		{
+			__m128i *pointer = reinterpret_cast<__m128i *>(row + x);
+			_mm_storeu_si128(pointer, _mm_or_si128(_mm_loadu_si128(pointer), mask));
+		}
+
+		MakeOpaqueRowPortable(row + x, width - x);
+	}
+
+	// Premultiplies two pixels, unpacked to 16 bits per channel. The alpha
+	// channel is multiplied by itself here, so needs to be restored
+	// afterwards.
+	__m128i PremultiplyUnpackedSse2(__m128i pixels)
+	{
+		__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)),
+			_MM_SHUFFLE(3, 3, 3, 3));
+		__m128i product = _mm_add_epi16(_mm_mullo_epi16(pixels, alpha), _mm_set1_epi16(128));
+		return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+	}
+
+	void PremultiplyRowSse2(uint32_t *row, int width)
+	{
+		__m128i zero = _mm_setzero_si128();
+		__m128i mask = _mm_set1_epi32(static_cast<int>(ALPHA_MASK));
+		int x = 0;
+
+		for (; x + 4 <= width; x += 4)
+		{
+			__m128i *pointer = reinterpret_cast<__m128i *>(row + x);
+			__m128i pixels = _mm_loadu_si128(pointer);
+
+			__m128i low = PremultiplyUnpackedSse2(_mm_unpacklo_epi8(pixels, zero));
+			__m128i high = PremultiplyUnpackedSse2(_mm_unpackhi_epi8(pixels, zero));
+			__m128i result = _mm_packus_epi16(low, high);
+
+			_mm_storeu_si128(pointer, _mm_or_si128(_mm_andnot_si128(mask, result), _mm_and_si128(mask, pixels)));
+		}
+
+		PremultiplyRowPortable(row + x, width - x);
+	}
+
+	uint32_t OrRowSse2(const uint32_t *row, int width)
+	{
+		__m128i accumulator = _mm_setzero_si128();
+		int x = 0;
+
+		for (; x + 4 <= width; x += 4)
+		{
+			accumulator = _mm_or_si128(accumulator, _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x)));
+		}
+
+		accumulator = _mm_or_si128(accumulator, _mm_srli_si128(accumulator, 8));
+		accumulator = _mm_or_si128(accumulator, _mm_srli_si128(accumulator, 4));
+
+		return static_cast<uint32_t>(_mm_cvtsi128_si32(accumulator)) | OrRowPortable(row + x, width - x);
+	}
+
+	// Combines the channels of two unpacked pixels (or rows) with their
+	// weights, adding the results to the accumulator. Each channel of the
+	// first is interleaved with the same channel of the second, so that
+	// pmaddwd multiplies both by their weights and adds them together.
+	__m128i MultiplyAddPairSse2(__m128i accumulator, __m128i first, __m128i second, __m128i weights)
+	{
+		return _mm_add_epi32(accumulator, _mm_madd_epi16(_mm_unpacklo_epi16(first, second), weights));
+	}
+
+	__m128i MakeWeightPairSse2(int16_t weight1, int16_t weight2)
+	{
+		return _mm_set1_epi32(static_cast<int>(static_cast<uint16_t>(weight1)
+			| (static_cast<uint32_t>(static_cast<uint16_t>(weight2)) << 16)));
+	}
+
+	// Four output pixels are handled at once, with one accumulator for
+	// each. Rows are taken in pairs; an odd final row is paired with itself
+	// and given a second weight of zero.
+	void ResampleColumnsSse2(const uint32_t *const *rows, const int16_t *weights, int numTaps,
+		uint32_t *output, int begin, int end)
+	{
+		__m128i zero = _mm_setzero_si128();
+		int x = begin;
+
+		for (; x + 4 <= end; x += 4)
+		{
+			__m128i sums[4];
+
+			for (__m128i &sum : sums)
+			{
+				sum = _mm_set1_epi32(WEIGHT_ROUNDING);
+			}
+
+			for (int tap = 0; tap < numTaps; tap += 2)
+			{
+				bool paired = (tap + 1 < numTaps);
+				__m128i weightPair = MakeWeightPairSse2(weights[tap], paired ? weights[tap + 1] : 0);
+
+				__m128i pixels1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[tap] + x));
+				__m128i pixels2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[paired ? tap + 1 : tap] + x));
+
+				__m128i low1 = _mm_unpacklo_epi8(pixels1, zero);
+				__m128i low2 = _mm_unpacklo_epi8(pixels2, zero);
+				__m128i high1 = _mm_unpackhi_epi8(pixels1, zero);
+				__m128i high2 = _mm_unpackhi_epi8(pixels2, zero);
+
+				sums[0] = MultiplyAddPairSse2(sums[0], low1, low2, weightPair);
+				sums[1] = MultiplyAddPairSse2(sums[1], _mm_srli_si128(low1, 8), _mm_srli_si128(low2, 8), weightPair);
+				sums[2] = MultiplyAddPairSse2(sums[2], high1, high2, weightPair);
+				sums[3] = MultiplyAddPairSse2(sums[3], _mm_srli_si128(high1, 8), _mm_srli_si128(high2, 8),
+					weightPair);
+			}
+
+			for (__m128i &sum : sums)
+			{
+				sum = _mm_srai_epi32(sum, WEIGHT_BITS);
+			}
+
+			// The saturating packs clamp each channel to [0, 255].
+			__m128i result = _mm_packus_epi16(_mm_packs_epi32(sums[0], sums[1]), _mm_packs_epi32(sums[2], sums[3]));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(output + x), result);
+		}
+
+		ResampleColumnsPortable(rows, weights, numTaps, output, x, end);
+	}
+
+	uint32_t ResamplePixelSse2(const uint32_t *pixels, const int16_t *weights, int numTaps)
+	{
+		__m128i zero = _mm_setzero_si128();
+		__m128i sum = _mm_set1_epi32(WEIGHT_ROUNDING);
+		int tap = 0;
+
+		for (; tap + 2 <= numTaps; tap += 2)
+		{
+			__m128i pair = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(pixels + tap)), zero);
+			sum = MultiplyAddPairSse2(sum, pair, _mm_srli_si128(pair, 8),
+				MakeWeightPairSse2(weights[tap], weights[tap + 1]));
+		}
+
+		if (tap < numTaps)
+		{
+			__m128i pixel = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(pixels[tap])), zero);
+			sum = MultiplyAddPairSse2(sum, pixel, zero, MakeWeightPairSse2(weights[tap], 0));
+		}
+
+		sum = _mm_srai_epi32(sum, WEIGHT_BITS);
+		sum = _mm_packs_epi32(sum, sum);
+		return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(sum, sum)));
+	}
+
+	// Copies each pixel's alpha value into all four of its bytes, so that
+	// an unsigned minimum clamps the color channels.
+	__m128i ClampToAlphaSse2(__m128i pixels)
+	{
+		__m128i alpha = _mm_srli_epi32(pixels, 24);
+		alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 8));
+		alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+		return _mm_min_epu8(pixels, alpha);
+	}
+
+	void ClampToAlphaRowSse2(uint32_t *row, int width)
+	{
+		int x = 0;
+
+		for (; x + 4 <= width; x += 4)
+		{
+			__m128i *pointer = reinterpret_cast<__m128i *>(row + x);
+			_mm_storeu_si128(pointer, ClampToAlphaSse2(_mm_loadu_si128(pointer)));
+		}
+
+		ClampToAlphaRowPortable(row + x, width - x);
+	}
+
+	// The AVX2 implementations mirror the SSE2 ones. Unpacking and packing
+	// both operate within each 128-bit lane, so pixels come out in the same
+	// order they went in.
+
+	PIXEL_KERNELS_TARGET("avx2")
+	void FillRowAvx2(uint32_t *row, int width, uint32_t pixel)
+	{
+		__m256i value = _mm256_set1_epi32(static_cast<int>(pixel));
+		int x = 0;
+
+		for (; x + 8 <= width; x += 8)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(row + x), value);
+		}
+
+		FillRowSse2(row + x, width - x, pixel);
+	}
+
+	PIXEL_KERNELS_TARGET("avx2")
+	void MakeOpaqueRowAvx2(uint32_t *row, int width)
+	{
+		__m256i mask = _mm256_set1_epi32(static_cast<int>(ALPHA_MASK));
+		int x = 0;
+
+		for (; x + 8 <= width; x += 8)
+		{
+			__m256i *pointer = reinterpret_cast<__m256i *>(row + x);
+			_mm256_storeu_si256(pointer, _mm256_or_si256(_mm256_loadu_si256(pointer), mask));
+		}
+
+		MakeOpaqueRowSse2(row + x, width - x);
+	}
+
+	PIXEL_KERNELS_TARGET("avx2")
+	__m256i PremultiplyUnpackedAvx2(__m256i pixels)
+	{
+		__m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)),
+			_MM_SHUFFLE(3, 3, 3, 3));
+		__m256i product = _mm256_add_epi16(_mm256_mullo_epi16(pixels, alpha), _mm256_set1_epi16(128));
+		return _mm256_srli_epi16(_mm256_add_epi16(product, _mm256_srli_epi16(product, 8)), 8);
+	}
+
+	PIXEL_KERNELS_TARGET("avx2")
+	void PremultiplyRowAvx2(uint32_t *row, int width)
+	{
+		__m256i zero = _mm256_setzero_si256();
+		__m256i mask = _mm256_set1_epi32(static_cast<int>(ALPHA_MASK));
+		int x = 0;
+
+		for (; x + 8 <= width; x += 8)
+		{
+			__m256i *pointer = reinterpret_cast<__m256i *>(row + x);
+			__m256i pixels = _mm256_loadu_si256(pointer);
+
+			__m256i low = PremultiplyUnpackedAvx2(_mm256_unpacklo_epi8(pixels, zero));
+			__m256i high = PremultiplyUnpackedAvx2(_mm256_unpackhi_epi8(pixels, zero));
+			__m256i result = _mm256_packus_epi16(low, high);
+
+			_mm256_storeu_si256(pointer,
+				_mm256_or_si256(_mm256_andnot_si256(mask, result), _mm256_and_si256(mask, pixels)));
+		}
+
+		PremultiplyRowSse2(row + x, width - x);
+	}
+
+	PIXEL_KERNELS_TARGET("avx2")
+	uint32_t OrRowAvx2(const uint32_t *row, int width)
+	{
+		__m256i accumulator = _mm256_setzero_si256();
+		int x = 0;
+
+		for (; x + 8 <= width; x += 8)
+		{
+			accumulator = _mm256_or_si256(accumulator,
+				_mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + x)));
+		}
+
+		__m128i combined = _mm_or_si128(_mm256_castsi256_si128(accumulator),
+			_mm256_extracti128_si256(accumulator, 1));
+		combined = _mm_or_si128(combined, _mm_srli_si128(combined, 8));
+		combined = _mm_or_si128(combined, _mm_srli_si128(combined, 4));
+
+		return static_cast<uint32_t>(_mm_cvtsi128_si32(combined)) | OrRowSse2(row + x, width - x);
+	}
+
+	PIXEL_KERNELS_TARGET("avx2")
+	__m256i MultiplyAddPairAvx2(__m256i accumulator, __m256i first, __m256i second, __m256i weights)
+	{
+		return _mm256_add_epi32(accumulator, _mm256_madd_epi16(_mm256_unpacklo_epi16(first, second), weights));
+	}
+
+	// Works on eight pixels at a time. Within each lane, the accumulators
+	// hold the pixels in the same order as ResampleColumnsSse2; the lower
+	// lane has pixels 0-3, and the upper lane has pixels 4-7.
+	PIXEL_KERNELS_TARGET("avx2")
+	void ResampleColumnsAvx2(const uint32_t *const *rows, const int16_t *weights, int numTaps,
+		uint32_t *output, int begin, int end)
+	{
+		__m256i zero = _mm256_setzero_si256();
+		int x = begin;
+
+		for (; x + 8 <= end; x += 8)
+		{
+			__m256i sums[4];
+
+			for (__m256i &sum : sums)
+			{
+				sum = _mm256_set1_epi32(WEIGHT_ROUNDING);
+			}
+
+			for (int tap = 0; tap < numTaps; tap += 2)
+			{
+				bool paired = (tap + 1 < numTaps);
+				__m256i weightPair = _mm256_broadcastsi128_si256(
+					MakeWeightPairSse2(weights[tap], paired ? weights[tap + 1] : 0));
+
+				__m256i pixels1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows[tap] + x));
+				__m256i pixels2 = _mm256_loadu_si256(
+					reinterpret_cast<const __m256i *>(rows[paired ? tap + 1 : tap] + x));
+
+				__m256i low1 = _mm256_unpacklo_epi8(pixels1, zero);
+				__m256i low2 = _mm256_unpacklo_epi8(pixels2, zero);
+				__m256i high1 = _mm256_unpackhi_epi8(pixels1, zero);
+				__m256i high2 = _mm256_unpackhi_epi8(pixels2, zero);
+
+				sums[0] = MultiplyAddPairAvx2(sums[0], low1, low2, weightPair);
+				sums[1] = MultiplyAddPairAvx2(sums[1], _mm256_srli_si256(low1, 8), _mm256_srli_si256(low2, 8),
+					weightPair);
+				sums[2] = MultiplyAddPairAvx2(sums[2], high1, high2, weightPair);
+				sums[3] = MultiplyAddPairAvx2(sums[3], _mm256_srli_si256(high1, 8), _mm256_srli_si256(high2, 8),
+					weightPair);
+			}
+
+			for (__m256i &sum : sums)
+			{
+				sum = _mm256_srai_epi32(sum, WEIGHT_BITS);
+			}
+
+			__m256i result = _mm256_packus_epi16(_mm256_packs_epi32(sums[0], sums[1]),
+				_mm256_packs_epi32(sums[2], sums[3]));
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(output + x), result);
+		}
+
+		ResampleColumnsSse2(rows, weights, numTaps, output, x, end);
+	}
+
+	PIXEL_KERNELS_TARGET("avx2")
+	void ClampToAlphaRowAvx2(uint32_t *row, int width)
+	{
+		int x = 0;
+
+		for (; x + 8 <= width; x += 8)
+		{
+			__m256i *pointer = reinterpret_cast<__m256i *>(row + x);
+			__m256i pixels = _mm256_loadu_si256(pointer);
+			__m256i alpha = _mm256_srli_epi32(pixels, 24);
+			alpha = _mm256_or_si256(alpha, _mm256_slli_epi32(alpha, 8));
+			alpha = _mm256_or_si256(alpha, _mm256_slli_epi32(alpha, 16));
+			_mm256_storeu_si256(pointer, _mm256_min_epu8(pixels, alpha));
+		}
+
+		ClampToAlphaRowSse2(row + x, width - x);
+	}
+
+#ifdef _MSC_VER
+	// _xgetbv requires the xsave target in clang-cl.
+	PIXEL_KERNELS_TARGET("xsave")
+	bool IsAvx2Supported()
+	{
+		int info[4];
+		__cpuid(info, 0);
+
+		if (info[0] < 7)
+		{
+			return false;
+		}
+
+		__cpuid(info, 1);
+
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+
+		// Besides the processor supporting AVX, the OS has to save the
+		// upper halves of the YMM registers on context switches.
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+		{
+			return false;
+		}
+
+		__cpuidex(info, 7, 0);
+
+		return (info[1] & (1 << 5)) != 0;
+	}
+#else
+	bool IsAvx2Supported()
+	{
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+	}
+#endif
+#endif
+
+	// Limits the requested instruction set to the ones compiled in.
+	InstructionSet GetAvailableInstructionSet(InstructionSet instructionSet)
+	{
+#ifdef PIXEL_KERNELS_X86
+		return instructionSet;
+#else
+		(void) instructionSet;
+		return InstructionSet::Portable;
+#endif
+	}
+
+	void FillRow(uint32_t *row, int width, uint32_t pixel, InstructionSet instructionSet)
+	{
+		switch (instructionSet)
+		{
+#ifdef PIXEL_KERNELS_X86
+		case InstructionSet::Avx2:
+			FillRowAvx2(row, width, pixel);
+			break;
+
+		case InstructionSet::Sse2:
+			FillRowSse2(row, width, pixel);
+			break;
+#endif
+
+		default:
+			FillRowPortable(row, width, pixel);
+			break;
+		}
+	}
+
+	const double PI = 3.14159265358979323846;
+
+	double Sinc(double x)
+	{
+		if (x == 0)
+		{
+			return 1;
+		}
+
+		x *= PI;
+		return std::sin(x) / x;
+	}
+
+	// The source pixels, and their weights, that contribute to each
+	// destination pixel along one dimension. The contributing pixels are
+	// always a contiguous run.
+	class FilterTaps
+	{
+	public:
+
+		FilterTaps(int sourceSize, int destinationSize, ResampleFilter filter) :
+			m_starts(destinationSize),
+			m_numTaps(destinationSize),
+			m_maxTaps(0)
+		{
+			// When reducing, the filter is stretched to cover all of the source
+			// pixels that map to each destination pixel.
+			double scale = static_cast<double>(sourceSize) / destinationSize;
+			double filterScale = (std::max)(scale, 1.0);
+			double radius = ((filter == ResampleFilter::Box) ? 0.5 : 3.0) * filterScale;
+
+			std::vector<std::vector<double>> allWeights(destinationSize);
+
+			for (int i = 0; i < destinationSize; i++)
+			{
+				double center = (i + 0.5) * scale;
+				int first = (std::max)(static_cast<int>(std::floor(center - radius)), 0);
+				int last = (std::min)(static_cast<int>(std::ceil(center + radius)), sourceSize);
+
+				std::vector<double> &weights = allWeights[i];
+
+				for (int j = first; j < last; j++)
+				{
+					double weight;
+
+					if (filter == ResampleFilter::Box)
+					{
+						// The portion of the source pixel covered by the box.
+						weight = (std::min)(j + 1.0, center + radius)
+							- (std::max)(static_cast<double>(j), center - radius);
+						weight = (std::max)(weight, 0.0);
+					}
+					else
+					{
+						double distance = (j + 0.5 - center) / filterScale;
+						weight = (std::abs(distance) < 3) ? Sinc(distance) * Sinc(distance / 3) : 0;
+					}
+
+					weights.push_back(weight);
+				}
+
+				// Pixels that don't contribute are trimmed from either end.
+				while (!weights.empty() && weights.back() == 0)
+				{
+					weights.pop_back();
+				}
+
+				size_t numLeadingZeros = 0;
+
+				while (numLeadingZeros < weights.size() && weights[numLeadingZeros] == 0)
+				{
+					numLeadingZeros++;
+				}
+
+				weights.erase(weights.begin(), weights.begin() + numLeadingZeros);
+				first += static_cast<int>(numLeadingZeros);
+
+				if (weights.empty())
+				{
+					first = (std::min)(static_cast<int>(center), sourceSize - 1);
+					weights.push_back(1);
+				}
+
+				m_starts[i] = first;
+				m_numTaps[i] = static_cast<int>(weights.size());
+				m_maxTaps = (std::max)(m_maxTaps, m_numTaps[i]);
+			}
+
+			m_weights.resize(static_cast<size_t>(destinationSize) * m_maxTaps);
+
+			for (int i = 0; i < destinationSize; i++)
+			{
+				QuantizeWeights(allWeights[i], &m_weights[static_cast<size_t>(i) * m_maxTaps]);
+			}
+		}
+
+		int GetStart(int index) const
+		{
+			return m_starts[index];
+		}
+
+		int GetNumTaps(int index) const
+		{
+			return m_numTaps[index];
+		}
+
+		int GetMaxTaps() const
+		{
+			return m_maxTaps;
+		}
+
+		const int16_t *GetWeights(int index) const
+		{
+			return &m_weights[static_cast<size_t>(index) * m_maxTaps];
+		}
+
+	private:
+
+		// Normalizes the weights and converts them to fixed point. Any
+		// rounding error is given to the largest weight, so that the weights
+		// always sum to exactly 1 << WEIGHT_BITS (and solid areas are left
+		// unchanged).
+		static void QuantizeWeights(const std::vector<double> &weights, int16_t *output)
+		{
+			double total = 0;
+
+			for (double weight : weights)
+			{
+				total += weight;
+			}
+
+			int sum = 0;
+			size_t largest = 0;
+
+			for (size_t i = 0; i < weights.size(); i++)
+			{
+				output[i] = static_cast<int16_t>(std::lround(weights[i] / total * (1 << WEIGHT_BITS)));
+				sum += output[i];
+
+				if (output[i] > output[largest])
+				{
+					largest = i;
+				}
+			}
+
+			output[largest] = static_cast<int16_t>(output[largest] + (1 << WEIGHT_BITS) - sum);
+		}
+
+		std::vector<int> m_starts;
+		std::vector<int> m_numTaps;
+		std::vector<int16_t> m_weights;
+		int m_maxTaps;
+	};
+
+	void ResampleColumns(const uint32_t *const *rows, const int16_t *weights, int numTaps, uint32_t *output,
+		int width, InstructionSet instructionSet)
+	{
+		switch (instructionSet)
+		{
+#ifdef PIXEL_KERNELS_X86
+		case InstructionSet::Avx2:
+			ResampleColumnsAvx2(rows, weights, numTaps, output, 0, width);
+			break;
+
+		case InstructionSet::Sse2:
+			ResampleColumnsSse2(rows, weights, numTaps, output, 0, width);
+			break;
+#endif
+
+		default:
+			ResampleColumnsPortable(rows, weights, numTaps, output, 0, width);
+			break;
+		}
+	}
+
+	// Each destination pixel uses a different set of source pixels here, so
+	// pixels are computed one at a time. The AVX2 implementation would be no
+	// faster than the SSE2 one, so it isn't separate.
+	void ResampleRow(const uint32_t *row, const FilterTaps &taps, uint32_t *output, int width,
+		InstructionSet instructionSet)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			const uint32_t *pixels = row + taps.GetStart(x);
+
+#ifdef PIXEL_KERNELS_X86
+			if (instructionSet != InstructionSet::Portable)
+			{
+				output[x] = ResamplePixelSse2(pixels, taps.GetWeights(x), taps.GetNumTaps(x));
+				continue;
+			}
+#else
+			(void) instructionSet;
+#endif
+
+			output[x] = ResamplePixelPortable(pixels, taps.GetWeights(x), taps.GetNumTaps(x));
+		}
+	}
+
+	void ClampToAlphaRow(uint32_t *row, int width, InstructionSet instructionSet)
+	{
+		switch (instructionSet)
+		{
+#ifdef PIXEL_KERNELS_X86
+		case InstructionSet::Avx2:
+			ClampToAlphaRowAvx2(row, width);
+			break;
+
+		case InstructionSet::Sse2:
+			ClampToAlphaRowSse2(row, width);
+			break;
+#endif
+
+		default:
+			ClampToAlphaRowPortable(row, width);
+			break;
+		}
+	}
+}
+
+
+InstructionSet PixelKernels::GetBestInstructionSet()
+{
+#ifdef PIXEL_KERNELS_X86
+	static const InstructionSet instructionSet = IsAvx2Supported() ? InstructionSet::Avx2 : InstructionSet::Sse2;
+	return instructionSet;
+#else
+	return InstructionSet::Portable;
+#endif
+}
+
+ConstImageView PixelKernels::MakeConstView(const ImageView &image)
+{
+	return { image.pixels, image.width, image.height, image.stride };
+}
+
+ImageView PixelKernels::GetSubImage(const ImageView &image, const Rect &rect)
+{
+	return { image.pixels + static_cast<ptrdiff_t>(rect.y) * image.stride + rect.x, rect.width, rect.height,
+		image.stride };
+}
+
+void PixelKernels::Fill(const ImageView &image, uint32_t pixel, InstructionSet instructionSet)
+{
+	instructionSet = GetAvailableInstructionSet(instructionSet);
+
+	for (int y = 0; y < image.height; y++)
+	{
+		FillRow(image.pixels + static_cast<ptrdiff_t>(y) * image.stride, image.width, pixel, instructionSet);
+	}
+}
+
+void PixelKernels::ConvertToPremultiplied(const ImageView &image, AlphaMode alphaMode,
+	InstructionSet instructionSet)
+{
+	instructionSet = GetAvailableInstructionSet(instructionSet);
+
+	for (int y = 0; y < image.height; y++)
+	{
+		uint32_t *row = image.pixels + static_cast<ptrdiff_t>(y) * image.stride;
+
+		switch (instructionSet)
+		{
+#ifdef PIXEL_KERNELS_X86
+		case InstructionSet::Avx2:
+			alphaMode == AlphaMode::Ignore ? MakeOpaqueRowAvx2(row, image.width)
+				: PremultiplyRowAvx2(row, image.width);
+			break;
+
+		case InstructionSet::Sse2:
+			alphaMode == AlphaMode::Ignore ? MakeOpaqueRowSse2(row, image.width)
+				: PremultiplyRowSse2(row, image.width);
+			break;
+#endif
+
+		default:
+			alphaMode == AlphaMode::Ignore ? MakeOpaqueRowPortable(row, image.width)
+				: PremultiplyRowPortable(row, image.width);
+			break;
+		}
+	}
+}
+
+bool PixelKernels::HasAlpha(const ConstImageView &image, InstructionSet instructionSet)
+{
+	instructionSet = GetAvailableInstructionSet(instructionSet);
+
+	uint32_t combined = 0;
+
+	for (int y = 0; y < image.height && (combined & ALPHA_MASK) == 0; y++)
+	{
+		const uint32_t *row = image.pixels + static_cast<ptrdiff_t>(y) * image.stride;
+
+		switch (instructionSet)
+		{
+#ifdef PIXEL_KERNELS_X86
+		case InstructionSet::Avx2:
+			combined |= OrRowAvx2(row, image.width);
+			break;
+
+		case InstructionSet::Sse2:
+			combined |= OrRowSse2(row, image.width);
+			break;
+#endif
+
+		default:
+			combined |= OrRowPortable(row, image.width);
+			break;
+		}
+	}
+
+	return (combined & ALPHA_MASK) != 0;
+}
+
+void PixelKernels::Copy(const ConstImageView &source, const ImageView &destination)
+{
+	for (int y = 0; y < destination.height; y++)
+	{
+		memcpy(destination.pixels + static_cast<ptrdiff_t>(y) * destination.stride,
+			source.pixels + static_cast<ptrdiff_t>(y) * source.stride, destination.width * sizeof(uint32_t));
+	}
+}
+
+// Resampling is split into two passes for each output row. The source rows
+// that contribute to the output row are first combined into a temporary row
+// (which is contiguous, so is straightforward to vectorize). That row is then
+// filtered horizontally.
+void PixelKernels::Resample(const ConstImageView &source, const ImageView &destination, ResampleFilter filter,
+	InstructionSet instructionSet)
+{
+	if (source.width <= 0 || source.height <= 0 || destination.width <= 0 || destination.height <= 0)
+	{
+		return;
+	}
+
+	instructionSet = GetAvailableInstructionSet(instructionSet);
+
+	FilterTaps columnTaps(source.width, destination.width, filter);
+	FilterTaps rowTaps(source.height, destination.height, filter);
+
+	std::vector<uint32_t> combinedRow(source.width);
+	std::vector<const uint32_t *> rows(rowTaps.GetMaxTaps());
+
+	for (int y = 0; y < destination.height; y++)
+	{
+		int numTaps = rowTaps.GetNumTaps(y);
+
+		for (int tap = 0; tap < numTaps; tap++)
+		{
+			rows[tap] = source.pixels + static_cast<ptrdiff_t>(rowTaps.GetStart(y) + tap) * source.stride;
+		}
+
+		ResampleColumns(rows.data(), rowTaps.GetWeights(y), numTaps, combinedRow.data(), source.width,
+			instructionSet);
+
+		uint32_t *output = destination.pixels + static_cast<ptrdiff_t>(y) * destination.stride;
+		ResampleRow(combinedRow.data(), columnTaps, output, destination.width, instructionSet);
+
+		// The box filter has no negative weights, so can't produce colors
+		// brighter than the alpha value.
+		if (filter != ResampleFilter::Box)
+		{
+			ClampToAlphaRow(output, destination.width, instructionSet);
+		}
+	}
+}
+
+Rect PixelKernels::GetLetterboxRect(int sourceWidth, int sourceHeight, int destinationWidth,
+	int destinationHeight)
+{
+	int width = sourceWidth;
+	int height = sourceHeight;
+
+	if (width > destinationWidth || height > destinationHeight)
+	{
+		// Compare the aspect ratios of the source and destination, to work
+		// out which dimension is the limiting one.
+		if (static_cast<int64_t>(sourceWidth) * destinationHeight > static_cast<int64_t>(sourceHeight) * destinationWidth)
+		{
+			width = destinationWidth;
+			height = static_cast<int>((static_cast<int64_t>(sourceHeight) * destinationWidth + sourceWidth / 2)
+				/ sourceWidth);
+		}
+		else
+		{
+			height = destinationHeight;
+			width = static_cast<int>((static_cast<int64_t>(sourceWidth) * destinationHeight + sourceHeight / 2)
+				/ sourceHeight);
+		}
+
+		width = (std::max)(width, 1);
+		height = (std::max)(height, 1);
+	}
+
+	return { (destinationWidth - width) / 2, (destinationHeight - height) / 2, width, height };
+}
+
+void PixelKernels::Letterbox(const ConstImageView &source, const ImageView &destination, uint32_t background,
+	ResampleFilter filter, InstructionSet instructionSet)
+{
+	if (source.width <= 0 || source.height <= 0)
+	{
+		Fill(destination, background, instructionSet);
+		return;
+	}
+
+	Rect rect = GetLetterboxRect(source.width, source.height, destination.width, destination.height);
+
+	// Only the margins are filled, so that no pixel is written twice.
+	Fill(GetSubImage(destination, { 0, 0, destination.width, rect.y }), background, instructionSet);
+	Fill(GetSubImage(destination, { 0, rect.y + rect.height, destination.width,
+		destination.height - rect.y - rect.height }), background, instructionSet);
+	Fill(GetSubImage(destination, { 0, rect.y, rect.x, rect.height }), background, instructionSet);
+	Fill(GetSubImage(destination, { rect.x + rect.width, rect.y, destination.width - rect.x - rect.width,
+		rect.height }), background, instructionSet);
+
+	ImageView target = GetSubImage(destination, rect);
+
+	if (source.width == rect.width && source.height == rect.height)
+	{
+		Copy(source, target);
+		return;
+	}
+
+	Resample(source, target, filter, instructionSet);
+}
@@ -0,0 +1,114 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <cstdint>
+
+// Operations on images made up of 32-bit BGRA pixels (the layout used by
+// 32-bit DIB sections). Apart from ConvertToPremultiplied, every operation
+// expects (and produces) premultiplied alpha, which is what image lists use
+// when drawing 32-bit images.
+//
+// Each operation has a portable implementation, along with SSE2 and AVX2
+// implementations on x86. The vectorized implementations produce exactly the
+// same output as the portable ones. By default, the best implementation
+// supported by the processor is used.
+//
+// None of these functions allocate, except for Resample and Letterbox (which
+// need space for the filter weights and an intermediate row).
+namespace PixelKernels
+{
+	enum class InstructionSet
+	{
+		Portable,
+		Sse2,
+		Avx2
+	};
+
+	// Returns the best instruction set supported by both the build and the
+	// processor.
+	InstructionSet GetBestInstructionSet();
+
+	struct ImageView
+	{
+		uint32_t *pixels;
+		int width;
+		int height;
+
+		// The distance between the start of consecutive rows, in pixels.
+		int stride;
+	};
+
+	struct ConstImageView
+	{
+		const uint32_t *pixels;
+		int width;
+		int height;
+		int stride;
+	};
+
+	struct Rect
+	{
+		int x;
+		int y;
+		int width;
+		int height;
+	};
+
+	enum class ResampleFilter
+	{
+		// Averages the source pixels covered by each destination pixel. When
+		// enlarging, this is equivalent to linear interpolation.
+		Box,
+
+		// Sharper than the box filter, but around six times as many source
+		// pixels are sampled in each direction.
+		Lanczos3
+	};
+
+	enum class AlphaMode
+	{
+		// The alpha channel is meaningless (as it is for most bitmaps), and
+		// every pixel is made fully opaque.
+		Ignore,
+
+		// The alpha channel holds straight (non-premultiplied) alpha.
+		Straight
+	};
+
+	ConstImageView MakeConstView(const ImageView &image);
+	ImageView GetSubImage(const ImageView &image, const Rect &rect);
+
+	void Fill(const ImageView &image, uint32_t pixel,
+		InstructionSet instructionSet = GetBestInstructionSet());
+
+	// Converts the image, in place, to premultiplied alpha.
+	void ConvertToPremultiplied(const ImageView &image, AlphaMode alphaMode,
+		InstructionSet instructionSet = GetBestInstructionSet());
+
+	// Returns true if any pixel has a non-zero alpha value. Bitmaps with no
+	// alpha information generally have an alpha value of zero throughout.
+	bool HasAlpha(const ConstImageView &image, InstructionSet instructionSet = GetBestInstructionSet());
+
+	// Both images must be the same size.
+	void Copy(const ConstImageView &source, const ImageView &destination);
+
+	// Resizes the source to fill the destination, using a separable filter.
+	// Every source pixel contributes to the result, however large the
+	// reduction.
+	void Resample(const ConstImageView &source, const ImageView &destination, ResampleFilter filter,
+		InstructionSet instructionSet = GetBestInstructionSet());
+
+	// Returns the largest rectangle, centered within the destination, that
+	// has the same aspect ratio as the source. Images that already fit are
+	// left at their original size, rather than being enlarged.
+	Rect GetLetterboxRect(int sourceWidth, int sourceHeight, int destinationWidth, int destinationHeight);
+
+	// Draws the source into the destination, scaled down (if necessary) to
+	// fit and centered, with the area around it filled with the background
+	// pixel.
+	void Letterbox(const ConstImageView &source, const ImageView &destination, uint32_t background,
+		ResampleFilter filter = ResampleFilter::Box, InstructionSet instructionSet = GetBestInstructionSet());
+}
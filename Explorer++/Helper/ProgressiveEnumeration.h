@@ -0,0 +1,168 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+// Support for enumerating a folder in the background and showing its
+// contents as they arrive, rather than only once the entire folder has been
+// read.
+namespace ProgressiveEnumeration
+{
+	// A source of items (e.g. the contents of a folder). Items are read in
+	// batches, so that a source can take advantage of any batching the
+	// underlying API provides.
+	template <typename Item>
+	class EnumerationSource
+	{
+	public:
+
+		virtual ~EnumerationSource() = default;
+
+		// Appends up to maxItems items to the vector. Returns false once the
+		// source has been exhausted (or has failed), after which it won't be
+		// called again.
+		virtual bool GetNextItems(size_t maxItems, std::vector<Item> &items) = 0;
+	};
+
+	struct Settings
+	{
+		// The first batch is published as soon as it contains this many
+		// items (roughly a screenful)...
+		size_t firstBatchSize = 256;
+
+		// ...or once this much time has passed, whichever happens first.
+		// Since a read from the source can't be interrupted, this is only
+		// checked between reads.
+		std::chrono::milliseconds firstBatchLatency{ 100 };
+
+		// Later batches are published at this interval, or once they reach
+		// the maximum size. Publishing less frequently means the cost of
+		// merging each batch into the view is spread across more items.
+		std::chrono::milliseconds batchInterval{ 250 };
+		size_t maxBatchSize = 32768;
+
+		// Reads start small (so that the first batch isn't held up by a
+		// single large read on a slow volume) and double in size up to the
+		// maximum.
+		size_t initialReadSize = 64;
+		size_t maxReadSize = 4096;
+	};
+
+	// Called with each batch of items. finished is set on the last batch,
+	// which may be empty.
+	template <typename Item>
+	using BatchCallback = std::function<void(std::vector<Item> items, bool finished)>;
+
+	// Reads the source until it's exhausted, publishing the items in batches.
+	// This blocks and would normally be run on a background thread. Returns
+	// false if the enumeration was cancelled, in which case no further
+	// batches (including the final one) will be published.
+	template <typename Item>
+	bool EnumerateInBatches(EnumerationSource<Item> &source, const Settings &settings, const std::atomic<bool> &cancelled,
+		BatchCallback<Item> callback)
+	{
+		using Clock = std::chrono::steady_clock;
+
+		auto startTime = Clock::now();
+		auto lastPublishTime = startTime;
+		bool firstBatchPublished = false;
+		size_t readSize = (std::max)(settings.initialReadSize, static_cast<size_t>(1));
+		std::vector<Item> batch;
+
+		while (true)
+		{
+			if (cancelled)
+			{
+				return false;
+			}
+
+			size_t maxItems = readSize;
+
+			if (!firstBatchPublished && settings.firstBatchSize > batch.size())
+			{
+				// Don't read past the end of the first screenful.
+				maxItems = (std::min)(maxItems, settings.firstBatchSize - batch.size());
+			}
+
+			bool finished = !source.GetNextItems(maxItems, batch);
+
+			if (cancelled)
+			{
+				return false;
+			}
+
+			auto now = Clock::now();
+			bool publish = finished;
+
+			if (!firstBatchPublished)
+			{
+				publish = publish || batch.size() >= settings.firstBatchSize
+					|| (now - startTime) >= settings.firstBatchLatency;
+			}
+			else
+			{
+				publish = publish || batch.size() >= settings.maxBatchSize
+					|| ((now - lastPublishTime) >= settings.batchInterval && !batch.empty());
+			}
+
+			if (publish)
+			{
+				callback(std::move(batch), finished);
+				batch = std::vector<Item>();
+
+				firstBatchPublished = true;
+				lastPublishTime = now;
+			}
+
+			if (finished)
+			{
+				return true;
+			}
+
+			readSize = (std::min)(readSize * 2, (std::max)(settings.maxReadSize, static_cast<size_t>(1)));
+		}
+	}
+
+	// Merges a sorted batch into a sorted set of items. Items in the batch
+	// are placed after any equal items that are already present. Returns the
+	// final position of each batch item (in ascending order), so inserting
+	// the batch items into a view at those positions, one after another,
+	// will leave the view in the same order as the merged items.
+	template <typename T, typename Compare>
+	std::vector<size_t> MergeSortedBatch(std::vector<T> &items, std::vector<T> batch, Compare compare)
+	{
+		std::vector<size_t> positions;
+		positions.reserve(batch.size());
+
+		std::vector<T> merged;
+		merged.reserve(items.size() + batch.size());
+
+		auto itemsItr = items.begin();
+
+		for (auto &batchItem : batch)
+		{
+			while (itemsItr != items.end() && !compare(batchItem, *itemsItr))
+			{
+				merged.push_back(std::move(*itemsItr));
+				++itemsItr;
+			}
+
+			positions.push_back(merged.size());
+			merged.push_back(std::move(batchItem));
+		}
+
+		std::move(itemsItr, items.end(), std::back_inserter(merged));
+
+		items = std::move(merged);
+
+		return positions;
+	}
+}
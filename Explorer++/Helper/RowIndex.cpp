@@ -0,0 +1,137 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "RowIndex.h"
+#include <algorithm>
+#include <cassert>
+
+void RowIndex::Clear()
+{
+	m_ids.clear();
+	m_positions.clear();
+	m_firstStaleRow = 0;
+}
+
+void RowIndex::InsertRow(int row, int id)
+{
+	assert(row >= 0 && row <= GetNumRows());
+	assert(id >= 0);
+
+	if (static_cast<size_t>(id) >= m_positions.size())
+	{
+		m_positions.resize(id + 1, -1);
+	}
+
+	assert(m_positions[id] == -1);
+
+	m_ids.insert(m_ids.begin() + row, id);
+	m_positions[id] = row;
+
+	m_firstStaleRow = (std::min)(m_firstStaleRow, row);
+}
+
+void RowIndex::RemoveRows(std::vector<int> rows)
+{
+	if (rows.empty())
+	{
+		return;
+	}
+
+	std::sort(rows.begin(), rows.end());
+
+	assert(rows.front() >= 0 && rows.back() < GetNumRows());
+
+	size_t nextRemoved = 0;
+	int destination = rows.front();
+
+	for (int source = rows.front(); source < GetNumRows(); source++)
+	{
+		if (nextRemoved < rows.size() && rows[nextRemoved] == source)
+		{
+			m_positions[m_ids[source]] = -1;
+
+			// Skip any duplicates.
+			while (nextRemoved < rows.size() && rows[nextRemoved] == source)
+			{
+				nextRemoved++;
+			}
+
+			continue;
+		}
+
+		m_ids[destination] = m_ids[source];
+		destination++;
+	}
+
+	m_ids.resize(destination);
+
+	m_firstStaleRow = (std::min)(m_firstStaleRow, rows.front());
+}
+
+void RowIndex::SetRows(std::vector<int> ids)
+{
+	for (int id : m_ids)
+	{
+		m_positions[id] = -1;
+	}
+
+	m_ids = std::move(ids);
+
+	for (int row = 0; row < GetNumRows(); row++)
+	{
+		int id = m_ids[row];
+		assert(id >= 0);
+
+		if (static_cast<size_t>(id) >= m_positions.size())
+		{
+			m_positions.resize(id + 1, -1);
+		}
+
+		m_positions[id] = row;
+	}
+
+	m_firstStaleRow = GetNumRows();
+}
+
+int RowIndex::FindRow(int id) const
+{
+	if (id < 0 || static_cast<size_t>(id) >= m_positions.size())
+	{
+		return -1;
+	}
+
+	int row = m_positions[id];
+
+	if (row == -1 || row < m_firstStaleRow)
+	{
+		return row;
+	}
+
+	UpdatePositions();
+
+	return m_positions[id];
+}
+
+int RowIndex::GetId(int row) const
+{
+	assert(row >= 0 && row < GetNumRows());
+
+	return m_ids[row];
+}
+
+int RowIndex::GetNumRows() const
+{
+	return static_cast<int>(m_ids.size());
+}
+
+void RowIndex::UpdatePositions() const
+{
+	for (int row = m_firstStaleRow; row < GetNumRows(); row++)
+	{
+		m_positions[m_ids[row]] = row;
+	}
+
+	m_firstStaleRow = GetNumRows();
+}
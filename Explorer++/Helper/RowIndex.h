@@ -0,0 +1,57 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <vector>
+
+// Maps between the rows of a list (e.g. a listview) and the IDs of the items
+// shown in them, in both directions. IDs are small, non-negative integers
+// (e.g. internal indexes), with each ID appearing in at most one row.
+//
+// Inserting or removing a row shifts every row after it. Rather than
+// updating the position of each of those items straight away, the index
+// records the first row whose items may have moved. Positions before that
+// row are known to be correct and are returned directly; the positions from
+// that row onwards are brought up to date (in a single pass, without calling
+// back into the list) the next time one of them is needed. That means that
+// a batch of changes followed by a batch of lookups costs a single pass,
+// rather than a pass per change.
+//
+// This class isn't thread-safe.
+class RowIndex
+{
+public:
+
+	void Clear();
+
+	// Inserts a row, shifting the rows at and after it down by one.
+	void InsertRow(int row, int id);
+
+	// Removes the specified rows (which can be given in any order) in a
+	// single pass.
+	void RemoveRows(std::vector<int> rows);
+
+	// Replaces every row (e.g. after the list has been sorted).
+	void SetRows(std::vector<int> ids);
+
+	// Returns -1 if the item isn't in any row.
+	int FindRow(int id) const;
+
+	int GetId(int row) const;
+	int GetNumRows() const;
+
+private:
+
+	void UpdatePositions() const;
+
+	// Indexed by row.
+	std::vector<int> m_ids;
+
+	// Indexed by ID. Holds -1 for items that aren't in any row. For the
+	// remaining items, the position is either correct, or is at or after
+	// m_firstStaleRow.
+	mutable std::vector<int> m_positions;
+	mutable int m_firstStaleRow = 0;
+};
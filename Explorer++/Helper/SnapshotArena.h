@@ -0,0 +1,169 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Allocates immutable, reference-counted snapshots of T from large blocks of
+// memory. A snapshot can be shared between threads without copying the data
+// it holds (copying a snapshot pointer only increments a reference count).
+//
+// The memory for an individual snapshot is never reclaimed. Instead, each
+// snapshot holds a reference to the arena and every block is freed together,
+// once the arena and all of its snapshots have been released. This suits data
+// that's created in bulk and discarded in bulk, such as the items in a
+// folder, all of which are released when the folder is left. Snapshots that
+// are still held at that point (e.g. by a background task) remain valid.
+//
+// Snapshots can be released on any thread, but they can only be created on
+// one thread at a time.
+template <typename T>
+class SnapshotArena : public std::enable_shared_from_this<SnapshotArena<T>>
+{
+public:
+
+	static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+	static std::shared_ptr<SnapshotArena> Create(size_t blockSize = DEFAULT_BLOCK_SIZE)
+	{
+		return std::shared_ptr<SnapshotArena>(new SnapshotArena(blockSize));
+	}
+
+	template <typename... Args>
+	std::shared_ptr<const T> MakeSnapshot(Args &&...args)
+	{
+		m_numSnapshots++;
+
+		// The snapshot and its reference count are placed in a single
+		// allocation within the arena.
+		return std::allocate_shared<T>(Allocator<T>(this->shared_from_this()), std::forward<Args>(args)...);
+	}
+
+	size_t GetNumSnapshots() const
+	{
+		return m_numSnapshots;
+	}
+
+	size_t GetNumBlocks() const
+	{
+		return m_blocks.size();
+	}
+
+	// The memory allocated for the blocks. Anything the snapshots
+	// themselves allocate separately isn't included.
+	size_t GetMemoryUsage() const
+	{
+		size_t memoryUsage = 0;
+
+		for (const auto &block : m_blocks)
+		{
+			memoryUsage += block.size;
+		}
+
+		return memoryUsage;
+	}
+
+private:
+
+	// Memory is allocated from the arena, but never individually returned
+	// to it. The allocator holds a reference to the arena, so the arena is
+	// kept alive for as long as any snapshot is.
+	template <typename U>
+	class Allocator
+	{
+	public:
+
+		using value_type = U;
+
+		explicit Allocator(std::shared_ptr<SnapshotArena> arena) :
+			m_arena(std::move(arena))
+		{
+
+		}
+
+		template <typename V>
+		Allocator(const Allocator<V> &other) :
+			m_arena(other.m_arena)
+		{
+
+		}
+
+		U *allocate(size_t n)
+		{
+			static_assert(alignof(U) <= alignof(std::max_align_t), "Over-aligned types aren't supported");
+
+			return static_cast<U *>(m_arena->Allocate(sizeof(U) * n, alignof(U)));
+		}
+
+		// The memory is freed along with the arena.
+		void deallocate(U *, size_t)
+		{
+
+		}
+
+		template <typename V>
+		bool operator==(const Allocator<V> &other) const
+		{
+			return m_arena == other.m_arena;
+		}
+
+		template <typename V>
+		bool operator!=(const Allocator<V> &other) const
+		{
+			return m_arena != other.m_arena;
+		}
+
+	private:
+
+		template <typename V>
+		friend class Allocator;
+
+		std::shared_ptr<SnapshotArena> m_arena;
+	};
+
+	struct Block
+	{
+		std::unique_ptr<std::max_align_t[]> memory;
+		size_t size;
+	};
+
+	explicit SnapshotArena(size_t blockSize) :
+		m_blockSize(blockSize),
+		m_blockOffset(0),
+		m_numSnapshots(0)
+	{
+
+	}
+
+	void *Allocate(size_t size, size_t alignment)
+	{
+		size_t offset = (m_blockOffset + alignment - 1) & ~(alignment - 1);
+
+		if (m_blocks.empty() || offset + size > m_blocks.back().size)
+		{
+			// Anything larger than a block gets a block of its own.
+			size_t blockSize = (std::max)(m_blockSize, size);
+			size_t numElements = (blockSize + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t);
+
+			// The memory is deliberately left uninitialized.
+			m_blocks.push_back({ std::unique_ptr<std::max_align_t[]>(new std::max_align_t[numElements]),
+				numElements * sizeof(std::max_align_t) });
+			offset = 0;
+		}
+
+		m_blockOffset = offset + size;
+
+		return reinterpret_cast<std::byte *>(m_blocks.back().memory.get()) + offset;
+	}
+
+	const size_t m_blockSize;
+	std::vector<Block> m_blocks;
+	size_t m_blockOffset;
+	size_t m_numSnapshots;
+};
@@ -0,0 +1,547 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "TaskExecutor.h"
+#include <algorithm>
+
+namespace TaskExecutorInternal
+{
+	struct GroupState
+	{
+		// Incremented each time the group is cancelled. A task is
+		// cancelled if the generation has changed since it was pushed.
+		std::atomic<uint64_t> generation = 0;
+
+		std::mutex mutex;
+		std::condition_variable tasksFinished;
+		size_t numOutstandingTasks = 0;
+	};
+}
+
+namespace
+{
+	// The index of the worker running on the current thread (if any).
+	// Used to place tasks pushed from a worker onto its own queue.
+	thread_local const void *currentExecutor = nullptr;
+	thread_local size_t currentWorkerIndex = 0;
+
+	void UpdateMaximum(std::atomic<int64_t> &maximum, int64_t value)
+	{
+		int64_t current = maximum.load();
+
+		while (value > current && !maximum.compare_exchange_weak(current, value))
+		{
+		}
+	}
+
+	void UpdateMaximum(std::atomic<size_t> &maximum, size_t value)
+	{
+		size_t current = maximum.load();
+
+		while (value > current && !maximum.compare_exchange_weak(current, value))
+		{
+		}
+	}
+
+	size_t CalculateMaxBlockingTasks(int numThreads)
+	{
+		return static_cast<size_t>((std::max)(numThreads / 2, 1));
+	}
+
+	void OnTaskFinished(TaskExecutorInternal::GroupState &group)
+	{
+		std::lock_guard<std::mutex> lock(group.mutex);
+
+		group.numOutstandingTasks--;
+
+		if (group.numOutstandingTasks == 0)
+		{
+			group.tasksFinished.notify_all();
+		}
+	}
+}
+
+bool CancellationToken::IsCancelled() const
+{
+	return m_group && m_group->generation != m_generation;
+}
+
+CancellationToken::CancellationToken(std::shared_ptr<TaskExecutorInternal::GroupState> group,
+	uint64_t generation) :
+	m_group(std::move(group)),
+	m_generation(generation)
+{
+
+}
+
+TaskExecutor::TaskExecutor(int numThreads, ThreadCallback threadStarted, ThreadCallback threadStopping) :
+	m_threadStarted(std::move(threadStarted)),
+	m_threadStopping(std::move(threadStopping)),
+	m_numQueued(0),
+	m_stopping(false),
+	m_maxBlockingTasks(CalculateMaxBlockingTasks(numThreads)),
+	m_numBlockingRunning(0),
+	m_nextQueue(0),
+	m_numSteals(0)
+{
+	numThreads = (std::max)(numThreads, 1);
+
+	for (auto &numQueuedBlocking : m_numQueuedBlocking)
+	{
+		numQueuedBlocking = 0;
+	}
+
+	for (int i = 0; i < numThreads; i++)
+	{
+		m_queues.push_back(std::make_unique<WorkerQueue>());
+	}
+
+	for (int i = 0; i < numThreads; i++)
+	{
+		m_threads.emplace_back(&TaskExecutor::WorkerMain, this, static_cast<size_t>(i));
+	}
+}
+
+TaskExecutor::~TaskExecutor()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_idleMutex);
+		m_stopping = true;
+	}
+
+	m_idleCondition.notify_all();
+
+	for (auto &thread : m_threads)
+	{
+		thread.join();
+	}
+
+	for (auto &queue : m_queues)
+	{
+		for (auto *lanes : { &queue->lanes, &queue->blockingLanes })
+		{
+			for (auto &lane : *lanes)
+			{
+				for (auto &task : lane)
+				{
+					OnTaskFinished(*task.group);
+				}
+			}
+		}
+	}
+}
+
+TaskExecutor &TaskExecutor::GetShared()
+{
+	int numThreads = (std::max)(static_cast<int>(std::thread::hardware_concurrency()), 2);
+
+#ifdef _WIN32
+	// Most tasks call into the shell, so each worker is initialized for COM.
+	static TaskExecutor executor(numThreads, [] {
+		CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
+	}, [] {
+		CoUninitialize();
+	});
+#else
+	static TaskExecutor executor(numThreads);
+#endif
+
+	return executor;
+}
+
+int TaskExecutor::GetNumThreads() const
+{
+	return static_cast<int>(m_threads.size());
+}
+
+int TaskExecutor::GetMaxBlockingTasks() const
+{
+	return static_cast<int>(m_maxBlockingTasks);
+}
+
+TaskExecutor::Statistics TaskExecutor::GetStatistics() const
+{
+	Statistics statistics;
+
+	for (size_t i = 0; i < NUM_PRIORITIES; i++)
+	{
+		const auto &source = m_laneStatistics[i];
+		auto &lane = statistics.lanes[i];
+
+		lane.queueDepth = source.queueDepth;
+		lane.maxQueueDepth = source.maxQueueDepth;
+		lane.numExecuted = source.numExecuted;
+		lane.numCancelled = source.numCancelled;
+		lane.totalQueueLatency = std::chrono::microseconds(source.totalQueueLatencyMicroseconds);
+		lane.maxQueueLatency = std::chrono::microseconds(source.maxQueueLatencyMicroseconds);
+	}
+
+	statistics.numSteals = m_numSteals;
+
+	return statistics;
+}
+
+void TaskExecutor::Enqueue(TaskPriority priority, Task task, bool atFront)
+{
+	size_t lane = static_cast<size_t>(priority);
+	bool blocking = task.blocking;
+	size_t queueIndex;
+
+	if (currentExecutor == this)
+	{
+		queueIndex = currentWorkerIndex;
+	}
+	else
+	{
+		queueIndex = m_nextQueue++ % m_queues.size();
+	}
+
+	task.queuedTime = Clock::now();
+
+	// The count is incremented first, so that it can never drop below zero
+	// (a worker may briefly find nothing to take, but will try again).
+	{
+		std::lock_guard<std::mutex> lock(m_idleMutex);
+		m_numQueued++;
+
+		if (blocking)
+		{
+			m_numQueuedBlocking[lane]++;
+		}
+	}
+
+	{
+		auto &queue = *m_queues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		auto &tasks = blocking ? queue.blockingLanes[lane] : queue.lanes[lane];
+
+		if (atFront)
+		{
+			tasks.push_front(std::move(task));
+		}
+		else
+		{
+			tasks.push_back(std::move(task));
+		}
+
+		size_t queueDepth = ++m_laneStatistics[lane].queueDepth;
+		UpdateMaximum(m_laneStatistics[lane].maxQueueDepth, queueDepth);
+	}
+
+	m_idleCondition.notify_one();
+}
+
+void TaskExecutor::WorkerMain(size_t workerIndex)
+{
+	currentExecutor = this;
+	currentWorkerIndex = workerIndex;
+
+	if (m_threadStarted)
+	{
+		m_threadStarted();
+	}
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_idleMutex);
+
+			m_idleCondition.wait(lock, [this] {
+				return m_stopping || HasRunnableTask();
+			});
+
+			if (m_stopping)
+			{
+				break;
+			}
+		}
+
+		Task task;
+		size_t lane;
+
+		if (TryTakeTask(workerIndex, task, lane))
+		{
+			RunTask(task, lane);
+
+			if (task.blocking)
+			{
+				ReleaseBlockingSlot();
+			}
+		}
+	}
+
+	if (m_threadStopping)
+	{
+		m_threadStopping();
+	}
+}
+
+// Should be called with m_idleMutex held.
+bool TaskExecutor::HasRunnableTask() const
+{
+	size_t numQueuedBlocking = 0;
+
+	for (const auto &numQueuedBlockingInLane : m_numQueuedBlocking)
+	{
+		numQueuedBlocking += numQueuedBlockingInLane;
+	}
+
+	if (m_numQueued > numQueuedBlocking)
+	{
+		return true;
+	}
+
+	return numQueuedBlocking > 0 && m_numBlockingRunning < m_maxBlockingTasks;
+}
+
+bool TaskExecutor::TryTakeTask(size_t workerIndex, Task &task, size_t &lane)
+{
+	for (lane = 0; lane < NUM_PRIORITIES; lane++)
+	{
+		if (m_laneStatistics[lane].queueDepth == 0)
+		{
+			continue;
+		}
+
+		// A blocking task is only taken if there's room for another one to
+		// run.
+		if (m_numQueuedBlocking[lane] > 0 && TryReserveBlockingSlot())
+		{
+			if (TryTakeTaskFromAnyQueue(workerIndex, lane, true, task))
+			{
+				return true;
+			}
+
+			ReleaseBlockingSlot();
+		}
+
+		if (TryTakeTaskFromAnyQueue(workerIndex, lane, false, task))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool TaskExecutor::TryTakeTaskFromAnyQueue(size_t workerIndex, size_t lane, bool blocking, Task &task)
+{
+	if (TryTakeTaskFromQueue(workerIndex, lane, blocking, task))
+	{
+		return true;
+	}
+
+	for (size_t i = 1; i < m_queues.size(); i++)
+	{
+		if (TryTakeTaskFromQueue((workerIndex + i) % m_queues.size(), lane, blocking, task))
+		{
+			m_numSteals++;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool TaskExecutor::TryTakeTaskFromQueue(size_t queueIndex, size_t lane, bool blocking, Task &task)
+{
+	auto &queue = *m_queues[queueIndex];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+
+	auto &tasks = blocking ? queue.blockingLanes[lane] : queue.lanes[lane];
+
+	if (tasks.empty())
+	{
+		return false;
+	}
+
+	task = std::move(tasks.front());
+	tasks.pop_front();
+
+	m_laneStatistics[lane].queueDepth--;
+	m_numQueued--;
+
+	if (blocking)
+	{
+		m_numQueuedBlocking[lane]--;
+	}
+
+	return true;
+}
+
+bool TaskExecutor::TryReserveBlockingSlot()
+{
+	size_t numRunning = m_numBlockingRunning.load();
+
+	while (numRunning < m_maxBlockingTasks)
+	{
+		if (m_numBlockingRunning.compare_exchange_weak(numRunning, numRunning + 1))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void TaskExecutor::ReleaseBlockingSlot()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_idleMutex);
+		m_numBlockingRunning--;
+	}
+
+	// A blocking task that was waiting for a free slot can now be run.
+	m_idleCondition.notify_one();
+}
+
+void TaskExecutor::RunTask(Task &task, size_t lane)
+{
+	auto &statistics = m_laneStatistics[lane];
+
+	if (task.group->generation != task.generation)
+	{
+		// Destroying the function without calling it will break the
+		// promise held by the task.
+		task.function = nullptr;
+		statistics.numCancelled++;
+
+		OnTaskFinished(*task.group);
+		return;
+	}
+
+	auto latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - task.queuedTime);
+	statistics.totalQueueLatencyMicroseconds += latency.count();
+	UpdateMaximum(statistics.maxQueueLatencyMicroseconds, latency.count());
+
+	task.function();
+	task.function = nullptr;
+
+	statistics.numExecuted++;
+
+	OnTaskFinished(*task.group);
+}
+
+void TaskExecutor::RunParallel(size_t numJobs, const std::function<void(size_t)> &job, TaskPriority priority,
+	TaskKind kind)
+{
+	struct SharedState
+	{
+		const std::function<void(size_t)> *job;
+		size_t numJobs;
+		std::atomic<size_t> nextJob = 0;
+
+		std::mutex mutex;
+		std::condition_variable jobsFinished;
+		size_t numFinished = 0;
+	};
+
+	auto state = std::make_shared<SharedState>();
+	state->job = &job;
+	state->numJobs = numJobs;
+
+	// Jobs are claimed one at a time, by whichever thread gets to them first.
+	// A helper that starts after every job has been claimed returns without
+	// touching the job itself (which may no longer exist by then).
+	auto runJobs = [] (SharedState &sharedState) {
+		size_t numRun = 0;
+		size_t index;
+
+		while ((index = sharedState.nextJob++) < sharedState.numJobs)
+		{
+			(*sharedState.job)(index);
+			numRun++;
+		}
+
+		if (numRun > 0)
+		{
+			std::lock_guard<std::mutex> lock(sharedState.mutex);
+			sharedState.numFinished += numRun;
+
+			if (sharedState.numFinished == sharedState.numJobs)
+			{
+				sharedState.jobsFinished.notify_all();
+			}
+		}
+	};
+
+	size_t numHelpers = (std::min)(numJobs > 0 ? numJobs - 1 : 0, m_threads.size());
+
+	if (numHelpers > 0)
+	{
+		// The helpers aren't associated with any group that can be
+		// cancelled.
+		auto group = std::make_shared<TaskExecutorInternal::GroupState>();
+		group->numOutstandingTasks = numHelpers;
+
+		for (size_t i = 0; i < numHelpers; i++)
+		{
+			Enqueue(priority, { [state, runJobs] { runJobs(*state); }, group, 0, {}, kind == TaskKind::Blocking },
+				true);
+		}
+	}
+
+	runJobs(*state);
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->jobsFinished.wait(lock, [&state] {
+		return state->numFinished == state->numJobs;
+	});
+}
+
+TaskGroup::TaskGroup(TaskExecutor &executor) :
+	m_executor(executor),
+	m_state(std::make_shared<TaskExecutorInternal::GroupState>())
+{
+
+}
+
+TaskGroup::~TaskGroup()
+{
+	Cancel();
+	Wait();
+}
+
+void TaskGroup::PushInternal(TaskPriority priority, TaskKind kind, std::function<void()> function)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		m_state->numOutstandingTasks++;
+	}
+
+	m_executor.Enqueue(priority, { std::move(function), m_state, m_state->generation, {},
+		kind == TaskKind::Blocking });
+}
+
+CancellationToken TaskGroup::GetCancellationToken() const
+{
+	return CancellationToken(m_state, m_state->generation);
+}
+
+void TaskGroup::Cancel()
+{
+	m_state->generation++;
+}
+
+void TaskGroup::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_state->mutex);
+
+	m_state->tasksFinished.wait(lock, [this] {
+		return m_state->numOutstandingTasks == 0;
+	});
+}
+
+size_t TaskGroup::GetNumOutstandingTasks() const
+{
+	std::lock_guard<std::mutex> lock(m_state->mutex);
+	return m_state->numOutstandingTasks;
+}
+
+TaskExecutor &TaskGroup::GetExecutor() const
+{
+	return m_executor;
+}
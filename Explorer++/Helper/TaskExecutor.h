@@ -0,0 +1,261 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Tasks are always taken from the highest priority lane that has work
+// available.
+enum class TaskPriority
+{
+	// Work for items that are currently visible.
+	Visible,
+
+	// Work for items that are likely to become visible soon (e.g. the rows
+	// just past the end of the view).
+	Prefetch,
+
+	// Everything else.
+	Background
+};
+
+enum class TaskKind
+{
+	Normal,
+
+	// Tasks that may block for a long time on I/O (e.g. enumerating a
+	// folder on a slow network share, or walking an entire folder tree).
+	// At most half of the workers will run these at any one time, so they
+	// can't hold up every other task.
+	Blocking
+};
+
+namespace TaskExecutorInternal
+{
+	struct GroupState;
+}
+
+// Allows a task to check whether it's been cancelled. Cancellation is
+// cooperative, so a long-running task should check this periodically and
+// return early if it's set. A default constructed token is never cancelled.
+class CancellationToken
+{
+public:
+
+	CancellationToken() = default;
+
+	bool IsCancelled() const;
+
+private:
+
+	friend class TaskGroup;
+
+	CancellationToken(std::shared_ptr<TaskExecutorInternal::GroupState> group, uint64_t generation);
+
+	std::shared_ptr<TaskExecutorInternal::GroupState> m_group;
+	uint64_t m_generation = 0;
+};
+
+// A process-wide pool of worker threads. Each worker has its own queue for
+// each priority. Tasks pushed from a worker go onto that worker's queue and
+// tasks pushed from any other thread are spread across the workers. An idle
+// worker will steal tasks from the other workers, so no single queue can hold
+// up the others.
+//
+// Blocking tasks are queued separately and are only taken by a worker while
+// fewer than GetMaxBlockingTasks() of them are running.
+//
+// Tasks aren't pushed directly; they're pushed through a TaskGroup, which
+// allows a set of related tasks (e.g. those belonging to a single tab) to be
+// cancelled and waited on together.
+class TaskExecutor
+{
+public:
+
+	static const size_t NUM_PRIORITIES = 3;
+
+	struct LaneStatistics
+	{
+		// The number of tasks currently queued, along with the largest
+		// number that have been queued at once.
+		size_t queueDepth = 0;
+		size_t maxQueueDepth = 0;
+
+		uint64_t numExecuted = 0;
+
+		// Tasks that were cancelled before they started.
+		uint64_t numCancelled = 0;
+
+		// The time tasks spent waiting in the queue before they were run.
+		std::chrono::microseconds totalQueueLatency{ 0 };
+		std::chrono::microseconds maxQueueLatency{ 0 };
+	};
+
+	struct Statistics
+	{
+		// Indexed by TaskPriority.
+		std::array<LaneStatistics, NUM_PRIORITIES> lanes;
+
+		uint64_t numSteals = 0;
+	};
+
+	using ThreadCallback = std::function<void()>;
+
+	// The callbacks are invoked on each worker thread when it starts and just
+	// before it exits (e.g. to initialize COM).
+	explicit TaskExecutor(int numThreads, ThreadCallback threadStarted = nullptr,
+		ThreadCallback threadStopping = nullptr);
+
+	// Any tasks that are still queued are discarded. Every TaskGroup that
+	// uses the executor must be destroyed before the executor is.
+	~TaskExecutor();
+
+	// The executor shared by the entire process. It has one thread per
+	// core.
+	static TaskExecutor &GetShared();
+
+	int GetNumThreads() const;
+	int GetMaxBlockingTasks() const;
+	Statistics GetStatistics() const;
+
+	// Runs job(0), ..., job(numJobs - 1) in parallel and returns once they've
+	// all completed. The calling thread runs jobs as well, so this will make
+	// progress even if every worker is busy (or if it's called from a
+	// worker). The helper tasks are queued ahead of other tasks with the same
+	// priority, since the calling thread is waiting on them.
+	void RunParallel(size_t numJobs, const std::function<void(size_t)> &job,
+		TaskPriority priority = TaskPriority::Visible, TaskKind kind = TaskKind::Normal);
+
+private:
+
+	friend class TaskGroup;
+
+	using Clock = std::chrono::steady_clock;
+
+	struct Task
+	{
+		std::function<void()> function;
+		std::shared_ptr<TaskExecutorInternal::GroupState> group;
+		uint64_t generation;
+		Clock::time_point queuedTime;
+		bool blocking;
+	};
+
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::array<std::deque<Task>, NUM_PRIORITIES> lanes;
+		std::array<std::deque<Task>, NUM_PRIORITIES> blockingLanes;
+	};
+
+	struct AtomicLaneStatistics
+	{
+		std::atomic<size_t> queueDepth = 0;
+		std::atomic<size_t> maxQueueDepth = 0;
+		std::atomic<uint64_t> numExecuted = 0;
+		std::atomic<uint64_t> numCancelled = 0;
+		std::atomic<int64_t> totalQueueLatencyMicroseconds = 0;
+		std::atomic<int64_t> maxQueueLatencyMicroseconds = 0;
+	};
+
+	void Enqueue(TaskPriority priority, Task task, bool atFront = false);
+	void WorkerMain(size_t workerIndex);
+	bool HasRunnableTask() const;
+	bool TryTakeTask(size_t workerIndex, Task &task, size_t &lane);
+	bool TryTakeTaskFromAnyQueue(size_t workerIndex, size_t lane, bool blocking, Task &task);
+	bool TryTakeTaskFromQueue(size_t queueIndex, size_t lane, bool blocking, Task &task);
+	bool TryReserveBlockingSlot();
+	void ReleaseBlockingSlot();
+	void RunTask(Task &task, size_t lane);
+
+	const ThreadCallback m_threadStarted;
+	const ThreadCallback m_threadStopping;
+
+	std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+	std::vector<std::thread> m_threads;
+
+	// Used to put idle workers to sleep. m_numQueued and m_numQueuedBlocking
+	// are only incremented (and m_numBlockingRunning only decremented) while
+	// the mutex is held, so a worker can't miss a wakeup.
+	std::mutex m_idleMutex;
+	std::condition_variable m_idleCondition;
+	std::atomic<size_t> m_numQueued;
+	std::array<std::atomic<size_t>, NUM_PRIORITIES> m_numQueuedBlocking;
+	bool m_stopping;
+
+	const size_t m_maxBlockingTasks;
+	std::atomic<size_t> m_numBlockingRunning;
+
+	std::atomic<size_t> m_nextQueue;
+
+	std::array<AtomicLaneStatistics, NUM_PRIORITIES> m_laneStatistics;
+	std::atomic<uint64_t> m_numSteals;
+};
+
+// A set of tasks that can be cancelled and waited on together. Destroying a
+// group cancels its tasks and waits for any that are running to finish, so a
+// task can safely refer to the object that owns the group.
+class TaskGroup
+{
+public:
+
+	explicit TaskGroup(TaskExecutor &executor);
+	~TaskGroup();
+
+	TaskGroup(const TaskGroup &) = delete;
+	TaskGroup &operator=(const TaskGroup &) = delete;
+
+	// If the task is cancelled before it starts, it won't be run at all and
+	// the returned future will hold a std::future_error (broken_promise).
+	template <typename F>
+	auto Push(TaskPriority priority, F &&function, TaskKind kind = TaskKind::Normal)
+		-> std::future<decltype(function())>
+	{
+		using Result = decltype(function());
+
+		auto packagedTask = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+		auto future = packagedTask->get_future();
+
+		PushInternal(priority, kind, [packagedTask] {
+			(*packagedTask)();
+		});
+
+		return future;
+	}
+
+	// A token for the tasks pushed so far (and up until the next call to
+	// Cancel()).
+	CancellationToken GetCancellationToken() const;
+
+	// Cancels every task that's been pushed so far. Queued tasks are
+	// dropped and running tasks will see their token as cancelled. Tasks
+	// pushed after this returns aren't affected.
+	void Cancel();
+
+	// Waits until none of the group's tasks are queued or running.
+	void Wait();
+
+	size_t GetNumOutstandingTasks() const;
+
+	TaskExecutor &GetExecutor() const;
+
+private:
+
+	void PushInternal(TaskPriority priority, TaskKind kind, std::function<void()> function);
+
+	TaskExecutor &m_executor;
+	std::shared_ptr<TaskExecutorInternal::GroupState> m_state;
+};
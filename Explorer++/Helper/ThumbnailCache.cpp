@@ -0,0 +1,682 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "ThumbnailCache.h"
+#include "ThumbnailLevels.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+/* The cache file consists of a header, a record for each block, a record
+for each entry (followed by its path) and finally the pixels for each
+block. Every record starts on an 8 byte boundary, and the pixels for each
+block start on a 64 byte boundary, so that everything can be used directly
+from the mapped file.
+
+Entries are written in order of use (most recent first), so that loading a
+file that's larger than the cache drops the least recently used entries.
+Blocks are written in the order they're first used by an entry, so the
+pixels for recently used thumbnails are close together. */
+namespace
+{
+	const char FILE_MAGIC[8] = { 'E', 'X', 'P', 'T', 'H', 'U', 'M', 'B' };
+	const uint32_t FILE_VERSION = 2;
+
+	struct FileHeader
+	{
+		char magic[8];
+		uint32_t version;
+
+		// Paths are stored as wchar_t, so a cache file can only be used on
+		// the platform it was written on.
+		uint32_t charSize;
+
+		uint64_t numBlocks;
+		uint64_t numEntries;
+	};
+
+	struct BlockRecord
+	{
+		uint64_t contentHash;
+		uint32_t width;
+		uint32_t height;
+
+		// The offset of the pixels, from the start of the file.
+		uint64_t pixelsOffset;
+	};
+
+	struct EntryRecord
+	{
+		uint64_t fileSize;
+		uint64_t lastWriteTime;
+		uint32_t level;
+		uint32_t blockIndex;
+		uint32_t pathLength;
+		uint32_t reserved;
+	};
+
+	static_assert(sizeof(FileHeader) % 8 == 0 && sizeof(BlockRecord) % 8 == 0 && sizeof(EntryRecord) % 8 == 0,
+		"Cache file records must be a multiple of 8 bytes in size");
+
+	const size_t PIXELS_ALIGNMENT = 64;
+
+	// Thumbnails larger than this (in either dimension) are treated as
+	// corrupt when loading a file.
+	const uint32_t MAX_THUMBNAIL_DIMENSION = 4096;
+
+	// Roughly accounts for the list node and index entries that go along
+	// with each entry and block.
+	const size_t ENTRY_OVERHEAD = 64;
+	const size_t BLOCK_OVERHEAD = 64;
+
+	size_t AlignTo(size_t size, size_t alignment)
+	{
+		return (size + alignment - 1) & ~(alignment - 1);
+	}
+
+	size_t GetPixelsSize(uint32_t width, uint32_t height)
+	{
+		return static_cast<size_t>(width) * height * sizeof(uint32_t);
+	}
+
+	uint64_t HashPath(std::wstring_view path)
+	{
+		// FNV-1a
+		uint64_t hash = 0xCBF29CE484222325ULL;
+
+		for (wchar_t c : path)
+		{
+			hash ^= static_cast<uint64_t>(c);
+			hash *= 0x100000001B3ULL;
+		}
+
+		return hash;
+	}
+
+	uint64_t HashPixels(uint32_t width, uint32_t height, const uint32_t *pixels)
+	{
+		uint64_t hash = 0xCBF29CE484222325ULL ^ ((static_cast<uint64_t>(width) << 32) | height);
+		size_t numPixels = static_cast<size_t>(width) * height;
+
+		for (size_t i = 0; i < numPixels; i++)
+		{
+			hash ^= pixels[i];
+			hash *= 0x100000001B3ULL;
+		}
+
+		// FNV mixes the low bits poorly, so the result is finalized the
+		// same way as splitmix64.
+		hash ^= hash >> 30;
+		hash *= 0xBF58476D1CE4E5B9ULL;
+		hash ^= hash >> 27;
+		hash *= 0x94D049BB133111EBULL;
+		hash ^= hash >> 31;
+
+		return hash;
+	}
+
+	class CacheFileReader
+	{
+	public:
+
+		CacheFileReader(const uint8_t *data, size_t size) :
+			m_data(data),
+			m_size(size),
+			m_offset(0)
+		{
+
+		}
+
+		template <typename T>
+		const T *Read()
+		{
+			return reinterpret_cast<const T *>(ReadBytes(sizeof(T)));
+		}
+
+		const wchar_t *ReadString(size_t length)
+		{
+			if (length > (m_size / sizeof(wchar_t)))
+			{
+				return nullptr;
+			}
+
+			return reinterpret_cast<const wchar_t *>(ReadBytes(AlignTo(length * sizeof(wchar_t), 8)));
+		}
+
+	private:
+
+		const uint8_t *ReadBytes(size_t numBytes)
+		{
+			if (numBytes > m_size - m_offset)
+			{
+				return nullptr;
+			}
+
+			const uint8_t *bytes = m_data + m_offset;
+			m_offset += numBytes;
+
+			return bytes;
+		}
+
+		const uint8_t *m_data;
+		size_t m_size;
+		size_t m_offset;
+	};
+
+	void AppendBytes(std::vector<uint8_t> &buffer, const void *data, size_t size)
+	{
+		auto bytes = static_cast<const uint8_t *>(data);
+		buffer.insert(buffer.end(), bytes, bytes + size);
+	}
+
+	void AppendString(std::vector<uint8_t> &buffer, std::wstring_view str)
+	{
+		size_t size = str.size() * sizeof(wchar_t);
+		AppendBytes(buffer, str.data(), size);
+		buffer.resize(buffer.size() + (AlignTo(size, 8) - size), 0);
+	}
+}
+
+ThumbnailCache::ThumbnailCache(size_t maxSize) :
+	m_maxSize(maxSize),
+	m_size(0),
+	m_modified(false)
+{
+
+}
+
+bool ThumbnailCache::Load(const std::wstring &cacheFilePath)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return LoadInternal(cacheFilePath);
+}
+
+bool ThumbnailCache::LoadInternal(const std::wstring &cacheFilePath)
+{
+	ClearInternal();
+
+	auto mappedFile = MappedFile::Open(cacheFilePath);
+
+	if (!mappedFile)
+	{
+		return false;
+	}
+
+	CacheFileReader reader(mappedFile->GetData(), mappedFile->GetSize());
+	auto header = reader.Read<FileHeader>();
+
+	if (!header || memcmp(header->magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0
+		|| header->version != FILE_VERSION || header->charSize != sizeof(wchar_t)
+		|| header->numBlocks > mappedFile->GetSize() / sizeof(BlockRecord))
+	{
+		return false;
+	}
+
+	std::vector<const BlockRecord *> blockRecords;
+	blockRecords.reserve(static_cast<size_t>(header->numBlocks));
+
+	for (uint64_t i = 0; i < header->numBlocks; i++)
+	{
+		auto blockRecord = reader.Read<BlockRecord>();
+
+		if (!blockRecord || blockRecord->width == 0 || blockRecord->height == 0
+			|| blockRecord->width > MAX_THUMBNAIL_DIMENSION || blockRecord->height > MAX_THUMBNAIL_DIMENSION
+			|| blockRecord->pixelsOffset % PIXELS_ALIGNMENT != 0
+			|| blockRecord->pixelsOffset > mappedFile->GetSize()
+			|| GetPixelsSize(blockRecord->width, blockRecord->height)
+				> mappedFile->GetSize() - blockRecord->pixelsOffset)
+		{
+			return false;
+		}
+
+		blockRecords.push_back(blockRecord);
+	}
+
+	for (uint64_t i = 0; i < header->numEntries; i++)
+	{
+		auto entryRecord = reader.Read<EntryRecord>();
+		const wchar_t *path = entryRecord ? reader.ReadString(entryRecord->pathLength) : nullptr;
+
+		if (!path || entryRecord->blockIndex >= blockRecords.size())
+		{
+			ClearInternal();
+			return false;
+		}
+
+		const BlockRecord *blockRecord = blockRecords[entryRecord->blockIndex];
+
+		if (entryRecord->level == 0 || entryRecord->level > MAX_THUMBNAIL_DIMENSION)
+		{
+			ClearInternal();
+			return false;
+		}
+
+		Entry entry;
+		entry.pathHash = HashPath({ path, entryRecord->pathLength });
+		entry.level = entryRecord->level;
+		entry.fileSize = entryRecord->fileSize;
+		entry.lastWriteTime = entryRecord->lastWriteTime;
+		entry.contentHash = blockRecord->contentHash;
+		entry.mappedPath = path;
+		entry.mappedPathLength = entryRecord->pathLength;
+
+		if (m_index.count(entry.pathHash) > 0)
+		{
+			continue;
+		}
+
+		auto blockItr = m_blocks.find(entry.contentHash);
+		size_t size = GetEntrySize(entry);
+
+		if (blockItr == m_blocks.end())
+		{
+			size += GetBlockSize(blockRecord->width, blockRecord->height);
+		}
+
+		if (m_size + size > m_maxSize)
+		{
+			// Everything that's left is less recently used than the entries
+			// that have already been loaded.
+			break;
+		}
+
+		if (blockItr == m_blocks.end())
+		{
+			Block block;
+			block.width = blockRecord->width;
+			block.height = blockRecord->height;
+			block.mappedPixels = reinterpret_cast<const uint32_t *>(
+				mappedFile->GetData() + blockRecord->pixelsOffset);
+			blockItr = m_blocks.insert({ entry.contentHash, std::move(block) }).first;
+		}
+
+		blockItr->second.numReferences++;
+
+		// Since the file is ordered from most to least recently used, each
+		// entry goes at the back.
+		m_size += size;
+		uint64_t pathHash = entry.pathHash;
+		m_entries.push_back(std::move(entry));
+		m_index.insert({ pathHash, std::prev(m_entries.end()) });
+	}
+
+	m_mappedFile = std::move(mappedFile);
+	m_filePath = cacheFilePath;
+	m_modified = false;
+
+	return true;
+}
+
+bool ThumbnailCache::Save(const std::wstring &cacheFilePath)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (cacheFilePath == m_filePath && !m_modified)
+	{
+		return true;
+	}
+
+	// The cache is written to a temporary file first, so that a failed
+	// write won't leave a partial file behind.
+	std::filesystem::path finalPath(cacheFilePath);
+	std::filesystem::path temporaryPath(cacheFilePath + L".tmp");
+
+	if (!WriteFile(temporaryPath.wstring()))
+	{
+		std::error_code error;
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+
+	// The mapped file may be the one being replaced, so it has to be
+	// released first. Everything in the cache has just been written out, so
+	// the cache can then be reloaded from the new file. That also means
+	// that inserted thumbnails no longer take up any memory of their own.
+	ClearInternal();
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, finalPath, error);
+
+	if (error)
+	{
+		std::filesystem::remove(temporaryPath, error);
+		LoadInternal(cacheFilePath);
+		return false;
+	}
+
+	return LoadInternal(cacheFilePath);
+}
+
+bool ThumbnailCache::WriteFile(const std::wstring &cacheFilePath) const
+{
+	std::vector<uint8_t> buffer;
+
+	// Assigns each block an index, in the order blocks are first used.
+	std::vector<std::pair<uint64_t, const Block *>> blocks;
+	std::unordered_map<uint64_t, uint32_t> blockIndexes;
+
+	for (const auto &entry : m_entries)
+	{
+		auto inserted = blockIndexes.insert({ entry.contentHash, static_cast<uint32_t>(blocks.size()) });
+
+		if (inserted.second)
+		{
+			blocks.emplace_back(entry.contentHash, &m_blocks.at(entry.contentHash));
+		}
+	}
+
+	FileHeader header;
+	memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+	header.version = FILE_VERSION;
+	header.charSize = sizeof(wchar_t);
+	header.numBlocks = blocks.size();
+	header.numEntries = m_entries.size();
+	AppendBytes(buffer, &header, sizeof(header));
+
+	// The block records are filled in once the size of everything before
+	// the pixels is known.
+	size_t blockRecordsOffset = buffer.size();
+	buffer.resize(buffer.size() + blocks.size() * sizeof(BlockRecord));
+
+	for (const auto &entry : m_entries)
+	{
+		std::wstring_view path = GetEntryPath(entry);
+
+		EntryRecord entryRecord;
+		entryRecord.fileSize = entry.fileSize;
+		entryRecord.lastWriteTime = entry.lastWriteTime;
+		entryRecord.level = entry.level;
+		entryRecord.blockIndex = blockIndexes.at(entry.contentHash);
+		entryRecord.pathLength = static_cast<uint32_t>(path.size());
+		entryRecord.reserved = 0;
+		AppendBytes(buffer, &entryRecord, sizeof(entryRecord));
+		AppendString(buffer, path);
+	}
+
+	buffer.resize(AlignTo(buffer.size(), PIXELS_ALIGNMENT), 0);
+
+	uint64_t pixelsOffset = buffer.size();
+
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		const Block *block = blocks[i].second;
+
+		BlockRecord blockRecord;
+		blockRecord.contentHash = blocks[i].first;
+		blockRecord.width = block->width;
+		blockRecord.height = block->height;
+		blockRecord.pixelsOffset = pixelsOffset;
+		memcpy(buffer.data() + blockRecordsOffset + i * sizeof(BlockRecord), &blockRecord, sizeof(blockRecord));
+
+		pixelsOffset += AlignTo(GetPixelsSize(block->width, block->height), PIXELS_ALIGNMENT);
+	}
+
+	std::ofstream file(std::filesystem::path(cacheFilePath), std::ios::binary | std::ios::trunc);
+
+	if (!file)
+	{
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+
+	// The pixels are written directly, rather than being copied into the
+	// buffer first.
+	const char padding[PIXELS_ALIGNMENT] = {};
+
+	for (const auto &block : blocks)
+	{
+		size_t pixelsSize = GetPixelsSize(block.second->width, block.second->height);
+		file.write(reinterpret_cast<const char *>(GetBlockPixels(*block.second)), pixelsSize);
+		file.write(padding, AlignTo(pixelsSize, PIXELS_ALIGNMENT) - pixelsSize);
+	}
+
+	return static_cast<bool>(file);
+}
+
+bool ThumbnailCache::Find(const ThumbnailCacheKey &key, uint32_t requestedSize, CachedThumbnail &thumbnail)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto itr = m_index.find(HashPath(key.path));
+
+	if (itr == m_index.end() || GetEntryPath(*itr->second) != key.path)
+	{
+		m_statistics.numMisses++;
+		return false;
+	}
+
+	auto entryItr = itr->second;
+
+	if (entryItr->fileSize != key.fileSize || entryItr->lastWriteTime != key.lastWriteTime)
+	{
+		RemoveEntry(entryItr);
+
+		m_statistics.numInvalidated++;
+		m_statistics.numMisses++;
+		return false;
+	}
+
+	const Block &block = m_blocks.at(entryItr->contentHash);
+
+	if (!ThumbnailLevels::CanProvideSize(entryItr->level, block.width, block.height, requestedSize))
+	{
+		m_statistics.numSmallerLevelMisses++;
+		m_statistics.numMisses++;
+		return false;
+	}
+
+	m_entries.splice(m_entries.begin(), m_entries, entryItr);
+
+	thumbnail.level = entryItr->level;
+	thumbnail.width = block.width;
+	thumbnail.height = block.height;
+	thumbnail.pixels.assign(GetBlockPixels(block),
+		GetBlockPixels(block) + static_cast<size_t>(block.width) * block.height);
+
+	m_statistics.numHits++;
+
+	if (entryItr->level > requestedSize)
+	{
+		m_statistics.numLargerLevelHits++;
+	}
+
+	return true;
+}
+
+void ThumbnailCache::Insert(const ThumbnailCacheKey &key, const CachedThumbnail &thumbnail)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	uint32_t width = thumbnail.width;
+	uint32_t height = thumbnail.height;
+	const uint32_t *pixels = thumbnail.pixels.data();
+
+	uint64_t pathHash = HashPath(key.path);
+	auto itr = m_index.find(pathHash);
+
+	if (itr != m_index.end())
+	{
+		const Entry &existingEntry = *itr->second;
+		const Block &existingBlock = m_blocks.at(existingEntry.contentHash);
+
+		// Thumbnails for several sizes may be extracted concurrently. The
+		// largest one should be the one that's kept.
+		if (GetEntryPath(existingEntry) == key.path && existingEntry.fileSize == key.fileSize
+			&& existingEntry.lastWriteTime == key.lastWriteTime
+			&& ThumbnailLevels::CanProvideSize(existingEntry.level, existingBlock.width, existingBlock.height,
+				thumbnail.level))
+		{
+			return;
+		}
+
+		// Otherwise, the existing entry is stale, smaller, or for a
+		// different path with the same hash. Either way, it's replaced.
+		RemoveEntry(itr->second);
+	}
+
+	Entry entry;
+	entry.pathHash = pathHash;
+	entry.level = thumbnail.level;
+	entry.fileSize = key.fileSize;
+	entry.lastWriteTime = key.lastWriteTime;
+	entry.contentHash = HashPixels(width, height, pixels);
+	entry.ownedPath = key.path;
+
+	auto blockItr = m_blocks.find(entry.contentHash);
+
+	if (blockItr != m_blocks.end())
+	{
+		const Block &block = blockItr->second;
+
+		if (block.width != width || block.height != height
+			|| memcmp(GetBlockPixels(block), pixels, GetPixelsSize(width, height)) != 0)
+		{
+			// A different image with the same hash. This should essentially
+			// never happen, but if it does, the image simply isn't cached.
+			return;
+		}
+
+		m_statistics.numSharedBlocks++;
+	}
+	else
+	{
+		Block block;
+		block.width = width;
+		block.height = height;
+
+		if (GetEntrySize(entry) + GetBlockSize(block.width, block.height) > m_maxSize)
+		{
+			return;
+		}
+
+		size_t numPixels = static_cast<size_t>(width) * height;
+		block.ownedPixels = std::make_unique<uint32_t[]>(numPixels);
+		memcpy(block.ownedPixels.get(), pixels, numPixels * sizeof(uint32_t));
+
+		m_size += GetBlockSize(block.width, block.height);
+		blockItr = m_blocks.insert({ entry.contentHash, std::move(block) }).first;
+	}
+
+	blockItr->second.numReferences++;
+
+	AddEntry(std::move(entry));
+	EvictEntries();
+
+	m_modified = true;
+}
+
+void ThumbnailCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	ClearInternal();
+}
+
+void ThumbnailCache::ClearInternal()
+{
+	m_entries.clear();
+	m_index.clear();
+	m_blocks.clear();
+	m_size = 0;
+	m_mappedFile.reset();
+	m_filePath.clear();
+	m_modified = false;
+}
+
+size_t ThumbnailCache::GetNumEntries() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return m_entries.size();
+}
+
+size_t ThumbnailCache::GetNumBlocks() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return m_blocks.size();
+}
+
+size_t ThumbnailCache::GetSize() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return m_size;
+}
+
+ThumbnailCache::Statistics ThumbnailCache::GetStatistics() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return m_statistics;
+}
+
+std::wstring_view ThumbnailCache::GetEntryPath(const Entry &entry)
+{
+	if (entry.mappedPath)
+	{
+		return { entry.mappedPath, entry.mappedPathLength };
+	}
+
+	return entry.ownedPath;
+}
+
+const uint32_t *ThumbnailCache::GetBlockPixels(const Block &block)
+{
+	if (block.mappedPixels)
+	{
+		return block.mappedPixels;
+	}
+
+	return block.ownedPixels.get();
+}
+
+size_t ThumbnailCache::GetEntrySize(const Entry &entry)
+{
+	return sizeof(Entry) + ENTRY_OVERHEAD + GetEntryPath(entry).size() * sizeof(wchar_t);
+}
+
+size_t ThumbnailCache::GetBlockSize(uint32_t width, uint32_t height)
+{
+	return sizeof(Block) + BLOCK_OVERHEAD + GetPixelsSize(width, height);
+}
+
+void ThumbnailCache::AddEntry(Entry entry)
+{
+	m_size += GetEntrySize(entry);
+
+	uint64_t pathHash = entry.pathHash;
+	m_entries.push_front(std::move(entry));
+	m_index[pathHash] = m_entries.begin();
+}
+
+void ThumbnailCache::RemoveEntry(EntryList::iterator itr)
+{
+	auto blockItr = m_blocks.find(itr->contentHash);
+
+	if (--blockItr->second.numReferences == 0)
+	{
+		m_size -= GetBlockSize(blockItr->second.width, blockItr->second.height);
+		m_blocks.erase(blockItr);
+	}
+
+	m_size -= GetEntrySize(*itr);
+	m_index.erase(itr->pathHash);
+	m_entries.erase(itr);
+
+	m_modified = true;
+}
+
+void ThumbnailCache::EvictEntries()
+{
+	while (m_size > m_maxSize && !m_entries.empty())
+	{
+		RemoveEntry(std::prev(m_entries.end()));
+		m_statistics.numEvicted++;
+	}
+}
@@ -0,0 +1,175 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include "MappedFile.h"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Identifies the file a thumbnail is for.
+struct ThumbnailCacheKey
+{
+	std::wstring path;
+	uint64_t fileSize;
+	uint64_t lastWriteTime;
+};
+
+// A thumbnail image, along with the level (see ThumbnailLevels) it was
+// extracted at. Pixels are stored top-down, with no padding between rows.
+struct CachedThumbnail
+{
+	uint32_t level;
+	uint32_t width;
+	uint32_t height;
+	std::vector<uint32_t> pixels;
+};
+
+// A size-bounded cache of thumbnail images. Images are stored as blocks of
+// 32-bit pixels, ready to be copied straight into a bitmap. Blocks are
+// addressed by their contents, so files with identical thumbnails (e.g.
+// copies of the same image) share a single block.
+//
+// As with ColumnCache, an entry is keyed by the identity of the file (its
+// path, size and last write time), so a stale thumbnail is never returned,
+// and least recently used entries are evicted once the cache is full.
+//
+// Only one thumbnail is kept for each file: the one extracted at the
+// largest level. Thumbnails for smaller sizes are derived from it.
+//
+// The cache can be saved to disk and loaded again later. Loading maps the
+// file into memory, so only the thumbnails that are actually looked up are
+// ever read.
+//
+// All methods can be called from any thread.
+class ThumbnailCache
+{
+public:
+
+	struct Statistics
+	{
+		uint64_t numHits = 0;
+		uint64_t numMisses = 0;
+
+		// Hits where the thumbnail was extracted at a larger level than
+		// requested.
+		uint64_t numLargerLevelHits = 0;
+
+		// Lookups where an entry was found, but its level was too small for
+		// the requested size.
+		uint64_t numSmallerLevelMisses = 0;
+
+		// Lookups where an entry was found, but the file had since
+		// changed.
+		uint64_t numInvalidated = 0;
+
+		uint64_t numEvicted = 0;
+
+		// Insertions that reused a block already in the cache.
+		uint64_t numSharedBlocks = 0;
+	};
+
+	explicit ThumbnailCache(size_t maxSize);
+
+	// Replaces the contents of the cache with the contents of the specified
+	// file. Returns false (leaving the cache empty) if the file doesn't
+	// exist or isn't a valid cache file.
+	bool Load(const std::wstring &cacheFilePath);
+
+	// Writes the cache to the specified file, replacing it if it already
+	// exists. If nothing has been inserted or removed since the cache was
+	// loaded from (or last saved to) the same file, nothing is written.
+	// Afterwards, the cache refers to the newly written file.
+	bool Save(const std::wstring &cacheFilePath);
+
+	// Retrieves the cached thumbnail for the file, provided it can be used
+	// for a thumbnail of the requested size. Returns false otherwise.
+	bool Find(const ThumbnailCacheKey &key, uint32_t requestedSize, CachedThumbnail &thumbnail);
+
+	// Stores the thumbnail for the file, replacing any existing thumbnail,
+	// unless the existing thumbnail is just as usable (i.e. it's at least
+	// as large).
+	void Insert(const ThumbnailCacheKey &key, const CachedThumbnail &thumbnail);
+	void Clear();
+
+	size_t GetNumEntries() const;
+	size_t GetNumBlocks() const;
+
+	// The approximate amount of memory (or disk space, once saved) used by
+	// the cache.
+	size_t GetSize() const;
+
+	Statistics GetStatistics() const;
+
+private:
+
+	struct Block
+	{
+		uint32_t width;
+		uint32_t height;
+
+		// Blocks loaded from a cache file refer directly to the mapped
+		// data. Inserted blocks own their pixels.
+		const uint32_t *mappedPixels = nullptr;
+		std::unique_ptr<uint32_t[]> ownedPixels;
+
+		// The number of entries using the block.
+		size_t numReferences = 0;
+	};
+
+	struct Entry
+	{
+		uint64_t pathHash;
+		uint32_t level;
+		uint64_t fileSize;
+		uint64_t lastWriteTime;
+		uint64_t contentHash;
+
+		const wchar_t *mappedPath = nullptr;
+		size_t mappedPathLength = 0;
+		std::wstring ownedPath;
+	};
+
+	using EntryList = std::list<Entry>;
+
+	static std::wstring_view GetEntryPath(const Entry &entry);
+	static const uint32_t *GetBlockPixels(const Block &block);
+	static size_t GetEntrySize(const Entry &entry);
+	static size_t GetBlockSize(uint32_t width, uint32_t height);
+
+	bool LoadInternal(const std::wstring &cacheFilePath);
+	bool WriteFile(const std::wstring &cacheFilePath) const;
+	void AddEntry(Entry entry);
+	void RemoveEntry(EntryList::iterator itr);
+	void EvictEntries();
+	void ClearInternal();
+
+	const size_t m_maxSize;
+
+	mutable std::mutex m_mutex;
+	size_t m_size;
+
+	// Ordered from most to least recently used.
+	EntryList m_entries;
+	// Keyed by the hash of the entry's path.
+	std::unordered_map<uint64_t, EntryList::iterator> m_index;
+
+	// Keyed by the hash of the block's pixels (and dimensions).
+	std::unordered_map<uint64_t, Block> m_blocks;
+
+	std::unique_ptr<MappedFile> m_mappedFile;
+
+	// The file the cache was last loaded from or saved to, and whether any
+	// entries have been added or removed since.
+	std::wstring m_filePath;
+	bool m_modified;
+
+	Statistics m_statistics;
+};
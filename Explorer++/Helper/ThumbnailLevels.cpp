@@ -0,0 +1,32 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "ThumbnailLevels.h"
+#include <cstdlib>
+
+int ThumbnailLevels::ClampThumbnailSize(int size)
+{
+	int closestSize = THUMBNAIL_SIZES[0];
+
+	for (int thumbnailSize : THUMBNAIL_SIZES)
+	{
+		if (std::abs(thumbnailSize - size) < std::abs(closestSize - size))
+		{
+			closestSize = thumbnailSize;
+		}
+	}
+
+	return closestSize;
+}
+
+bool ThumbnailLevels::CanProvideSize(uint32_t level, uint32_t width, uint32_t height, uint32_t requestedSize)
+{
+	if (level >= requestedSize)
+	{
+		return true;
+	}
+
+	return width < level && height < level;
+}
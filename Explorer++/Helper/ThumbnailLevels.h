@@ -0,0 +1,33 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <cstdint>
+
+// Thumbnails can be displayed at a number of different sizes. Rather than
+// extracting a thumbnail separately for each size, only the largest size
+// extracted for a file is kept (see ThumbnailCache), and smaller sizes are
+// derived from it by resampling.
+//
+// The size a thumbnail was extracted at is referred to as its level. The
+// extracted image keeps the aspect ratio of the file, so it only fills the
+// level in one dimension. If it doesn't fill the level in either dimension,
+// the file itself was smaller than the level, and the image is complete: no
+// larger level would provide any more detail.
+namespace ThumbnailLevels
+{
+	// The sizes thumbnails can be displayed at, in increasing order.
+	constexpr int THUMBNAIL_SIZES[] = { 64, 96, 120, 160, 192, 256, 384, 512 };
+
+	constexpr int DEFAULT_THUMBNAIL_SIZE = 120;
+
+	// Returns the supported size closest to the specified size. Used to
+	// sanitize sizes read from the settings.
+	int ClampThumbnailSize(int size);
+
+	// Returns true if the image extracted at the given level can be used
+	// for a thumbnail of the requested size, without being enlarged.
+	bool CanProvideSize(uint32_t level, uint32_t width, uint32_t height, uint32_t requestedSize);
+}
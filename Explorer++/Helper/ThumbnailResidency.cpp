@@ -0,0 +1,295 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "ThumbnailResidency.h"
+#include <algorithm>
+#include <climits>
+#include <utility>
+
+ThumbnailResidency::ThumbnailResidency(size_t maxResidentItems) :
+	m_maxResidentItems((std::max)(maxResidentItems, size_t{ 1 })),
+	m_viewportFirst(0),
+	m_viewportLast(-1)
+{
+
+}
+
+size_t ThumbnailResidency::GetMaxResidentItems(size_t memoryBudget, int thumbnailSize)
+{
+	size_t thumbnailBytes = static_cast<size_t>(thumbnailSize) * thumbnailSize * sizeof(uint32_t);
+
+	if (thumbnailBytes == 0)
+	{
+		return 1;
+	}
+
+	return (std::max)(memoryBudget / thumbnailBytes, size_t{ 1 });
+}
+
+std::vector<int> ThumbnailResidency::SetItems(const std::vector<int> &items)
+{
+	m_positions.clear();
+
+	for (int position = 0; position < static_cast<int>(items.size()); position++)
+	{
+		m_positions.insert({ items[position], position });
+	}
+
+	std::vector<int> evictedItems;
+
+	for (int item : m_slotItems)
+	{
+		if (item != NO_ITEM && m_positions.count(item) == 0)
+		{
+			evictedItems.push_back(item);
+		}
+	}
+
+	for (int item : evictedItems)
+	{
+		FreeSlot(item);
+	}
+
+	for (auto itr = m_evictedItems.begin(); itr != m_evictedItems.end();)
+	{
+		if (m_positions.count(*itr) == 0)
+		{
+			itr = m_evictedItems.erase(itr);
+		}
+		else
+		{
+			++itr;
+		}
+	}
+
+	m_statistics.numEvicted += evictedItems.size();
+
+	return evictedItems;
+}
+
+void ThumbnailResidency::RemoveItem(int item)
+{
+	FreeSlot(item);
+	m_positions.erase(item);
+	m_evictedItems.erase(item);
+}
+
+std::vector<int> ThumbnailResidency::SetViewport(int first, int last)
+{
+	if (last < first)
+	{
+		return {};
+	}
+
+	m_viewportFirst = first;
+	m_viewportLast = last;
+
+	int workingSetDistance = GetWorkingSetDistance();
+	std::vector<std::pair<int, int>> outsideItems;
+
+	for (const auto &residentItem : m_residentItems)
+	{
+		int position = m_positions.at(residentItem.first);
+
+		if (GetDistanceFromViewport(position) > workingSetDistance)
+		{
+			outsideItems.emplace_back(position, residentItem.first);
+		}
+	}
+
+	// As in ThumbnailScheduler, the items are sorted, since the order they
+	// were found in is arbitrary.
+	std::sort(outsideItems.begin(), outsideItems.end());
+
+	std::vector<int> evictedItems;
+
+	for (const auto &outsideItem : outsideItems)
+	{
+		FreeSlot(outsideItem.second);
+		m_evictedItems.insert(outsideItem.second);
+		evictedItems.push_back(outsideItem.second);
+	}
+
+	m_statistics.numEvicted += evictedItems.size();
+
+	return evictedItems;
+}
+
+int ThumbnailResidency::GetWorkingSetDistance() const
+{
+	int viewportSize = m_viewportLast - m_viewportFirst + 1;
+	int maxResidentItems = static_cast<int>((std::min)(m_maxResidentItems, size_t{ INT_MAX }));
+
+	return (std::max)((maxResidentItems - viewportSize) / 2, 0);
+}
+
+std::optional<ThumbnailResidency::Allocation> ThumbnailResidency::AllocateSlot(int item)
+{
+	auto positionItr = m_positions.find(item);
+
+	if (positionItr == m_positions.end())
+	{
+		return std::nullopt;
+	}
+
+	auto residentItr = m_residentItems.find(item);
+
+	if (residentItr != m_residentItems.end())
+	{
+		return Allocation{ residentItr->second, true, std::nullopt };
+	}
+
+	Allocation allocation;
+	allocation.recycled = true;
+
+	if (!m_freeSlots.empty())
+	{
+		allocation.slot = m_freeSlots.back();
+		m_freeSlots.pop_back();
+	}
+	else if (m_slotItems.size() < m_maxResidentItems)
+	{
+		allocation.slot = static_cast<int>(m_slotItems.size());
+		allocation.recycled = false;
+		m_slotItems.push_back(NO_ITEM);
+	}
+	else
+	{
+		auto furthestItem = FindFurthestResidentItem();
+
+		if (!furthestItem || GetDistanceFromViewport(m_positions.at(*furthestItem))
+			<= GetDistanceFromViewport(positionItr->second))
+		{
+			m_statistics.numRejected++;
+			return std::nullopt;
+		}
+
+		allocation.slot = m_residentItems.at(*furthestItem);
+		allocation.evictedItem = *furthestItem;
+
+		FreeSlot(*furthestItem);
+		m_freeSlots.pop_back();
+		m_evictedItems.insert(*furthestItem);
+
+		m_statistics.numEvicted++;
+	}
+
+	m_slotItems[allocation.slot] = item;
+	m_residentItems.insert({ item, allocation.slot });
+
+	if (m_evictedItems.erase(item) > 0)
+	{
+		m_statistics.numRefetched++;
+	}
+
+	m_statistics.numAllocated++;
+
+	if (allocation.recycled)
+	{
+		m_statistics.numRecycled++;
+	}
+
+	m_statistics.peakResidentItems = (std::max)(m_statistics.peakResidentItems, m_residentItems.size());
+
+	return allocation;
+}
+
+std::optional<int> ThumbnailResidency::GetSlot(int item) const
+{
+	auto itr = m_residentItems.find(item);
+
+	if (itr == m_residentItems.end())
+	{
+		return std::nullopt;
+	}
+
+	return itr->second;
+}
+
+void ThumbnailResidency::Reset(size_t maxResidentItems)
+{
+	m_maxResidentItems = (std::max)(maxResidentItems, size_t{ 1 });
+	m_positions.clear();
+	m_residentItems.clear();
+	m_slotItems.clear();
+	m_freeSlots.clear();
+	m_evictedItems.clear();
+	m_viewportFirst = 0;
+	m_viewportLast = -1;
+}
+
+size_t ThumbnailResidency::GetMaxResidentItems() const
+{
+	return m_maxResidentItems;
+}
+
+size_t ThumbnailResidency::GetNumResidentItems() const
+{
+	return m_residentItems.size();
+}
+
+size_t ThumbnailResidency::GetNumSlots() const
+{
+	return m_slotItems.size();
+}
+
+ThumbnailResidency::Statistics ThumbnailResidency::GetStatistics() const
+{
+	return m_statistics;
+}
+
+int ThumbnailResidency::GetDistanceFromViewport(int position) const
+{
+	if (position < m_viewportFirst)
+	{
+		return m_viewportFirst - position;
+	}
+	else if (position > m_viewportLast)
+	{
+		return position - m_viewportLast;
+	}
+
+	return 0;
+}
+
+void ThumbnailResidency::FreeSlot(int item)
+{
+	auto itr = m_residentItems.find(item);
+
+	if (itr == m_residentItems.end())
+	{
+		return;
+	}
+
+	m_slotItems[itr->second] = NO_ITEM;
+	m_freeSlots.push_back(itr->second);
+	m_residentItems.erase(itr);
+}
+
+// Ties go to the item in the lowest slot, so that the choice doesn't depend
+// on hash map ordering.
+std::optional<int> ThumbnailResidency::FindFurthestResidentItem() const
+{
+	std::optional<int> furthestItem;
+	int furthestDistance = -1;
+
+	for (int item : m_slotItems)
+	{
+		if (item == NO_ITEM)
+		{
+			continue;
+		}
+
+		int distance = GetDistanceFromViewport(m_positions.at(item));
+
+		if (distance > furthestDistance)
+		{
+			furthestItem = item;
+			furthestDistance = distance;
+		}
+	}
+
+	return furthestItem;
+}
@@ -0,0 +1,124 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Decides which items have their thumbnail resident (i.e. held in an image
+// list), so that the memory used by thumbnails stays bounded, however many
+// items there are. Each resident item occupies a slot (which corresponds to
+// an image in an image list) and there are never more slots than the maximum number of
+// resident items.
+//
+// Items are kept resident within a working set, centered on the viewport,
+// that contains as many items as there are slots. When the viewport moves,
+// items that fall outside the working set are evicted and their slots are
+// reused for other items. Items are identified by a non-negative ID and have
+// a position (their index in display order), as with ThumbnailScheduler.
+//
+// This class isn't thread-safe.
+class ThumbnailResidency
+{
+public:
+
+	struct Allocation
+	{
+		int slot;
+
+		// True if the slot was previously used by another item (in which case
+		// the image in it needs to be replaced). Otherwise, this is a new slot,
+		// one past the last slot allocated.
+		bool recycled;
+
+		// The item evicted to make room, if any.
+		std::optional<int> evictedItem;
+	};
+
+	struct Statistics
+	{
+		uint64_t numAllocated = 0;
+		uint64_t numRecycled = 0;
+		uint64_t numEvicted = 0;
+
+		// Allocations for items that had previously been evicted.
+		uint64_t numRefetched = 0;
+
+		// Allocations that failed because every resident item was closer to
+		// the viewport than the item being allocated.
+		uint64_t numRejected = 0;
+
+		size_t peakResidentItems = 0;
+	};
+
+	explicit ThumbnailResidency(size_t maxResidentItems);
+
+	// Returns the number of thumbnails of the specified size that fit within
+	// the memory budget (in bytes). Always at least one.
+	static size_t GetMaxResidentItems(size_t memoryBudget, int thumbnailSize);
+
+	// Sets the position of every item, in display order. Resident items that
+	// aren't in the list are evicted (and returned, in slot order).
+	std::vector<int> SetItems(const std::vector<int> &items);
+
+	// Frees the item's slot, if it has one.
+	void RemoveItem(int item);
+
+	// Sets the (inclusive) range of visible positions. Resident items outside
+	// the new working set are evicted and returned, in position order. An
+	// empty range (last < first) leaves the working set where it is.
+	std::vector<int> SetViewport(int first, int last);
+
+	// Returns the furthest distance from the viewport that an item can be
+	// and still be within the working set.
+	int GetWorkingSetDistance() const;
+
+	// Allocates a slot for the item, evicting the resident item furthest from
+	// the viewport if all the slots are in use. If the item is already
+	// resident, its existing slot is returned. Returns nothing if the item
+	// isn't known, or if every resident item is at least as close to the
+	// viewport as the item.
+	std::optional<Allocation> AllocateSlot(int item);
+
+	std::optional<int> GetSlot(int item) const;
+
+	// Forgets every item and slot (e.g. because the image list has been
+	// recreated), and sets a new maximum number of resident items.
+	void Reset(size_t maxResidentItems);
+
+	size_t GetMaxResidentItems() const;
+	size_t GetNumResidentItems() const;
+	size_t GetNumSlots() const;
+	Statistics GetStatistics() const;
+
+private:
+
+	static constexpr int NO_ITEM = -1;
+
+	int GetDistanceFromViewport(int position) const;
+	void FreeSlot(int item);
+	std::optional<int> FindFurthestResidentItem() const;
+
+	size_t m_maxResidentItems;
+
+	std::unordered_map<int, int> m_positions;
+
+	// Maps each resident item to its slot, and each slot back to its item
+	// (or NO_ITEM, if the slot is free).
+	std::unordered_map<int, int> m_residentItems;
+	std::vector<int> m_slotItems;
+	std::vector<int> m_freeSlots;
+
+	std::unordered_set<int> m_evictedItems;
+
+	int m_viewportFirst;
+	int m_viewportLast;
+
+	Statistics m_statistics;
+};
@@ -0,0 +1,322 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "ThumbnailScheduler.h"
+#include <algorithm>
+
+ThumbnailScheduler::ThumbnailScheduler(const Options &options) :
+	m_options(options),
+	m_viewportFirst(0),
+	m_viewportLast(-1),
+	m_scrollDirection(ScrollDirection::Forward)
+{
+
+}
+
+void ThumbnailScheduler::SetItems(const std::vector<int> &items)
+{
+	m_pendingItems.clear();
+	m_pendingPositions.clear();
+
+	std::unordered_map<int, int> itemsInFlight;
+
+	for (int position = 0; position < static_cast<int>(items.size()); position++)
+	{
+		int item = items[position];
+
+		auto completedItr = m_completedItems.find(item);
+
+		if (completedItr != m_completedItems.end())
+		{
+			completedItr->second = position;
+			continue;
+		}
+
+		if (m_itemsInFlight.count(item) > 0)
+		{
+			itemsInFlight.insert({ item, position });
+			continue;
+		}
+
+		AddPendingItem(item, position);
+	}
+
+	m_itemsInFlight = std::move(itemsInFlight);
+}
+
+void ThumbnailScheduler::RemoveItem(int item)
+{
+	auto itr = m_pendingPositions.find(item);
+
+	if (itr != m_pendingPositions.end())
+	{
+		m_pendingItems.erase(itr->second);
+		m_pendingPositions.erase(itr);
+	}
+
+	m_itemsInFlight.erase(item);
+	m_completedItems.erase(item);
+}
+
+std::vector<int> ThumbnailScheduler::SetViewport(int first, int last)
+{
+	if (first > m_viewportFirst)
+	{
+		m_scrollDirection = ScrollDirection::Forward;
+	}
+	else if (first < m_viewportFirst)
+	{
+		m_scrollDirection = ScrollDirection::Backward;
+	}
+
+	m_viewportFirst = first;
+	m_viewportLast = (std::max)(last, first - 1);
+
+	std::vector<std::pair<int, int>> cancelledItems;
+	int viewportSize = GetViewportSize();
+
+	if (viewportSize > 0)
+	{
+		int cancelDistance = m_options.cancelPages * viewportSize;
+
+		for (const auto &itemInFlight : m_itemsInFlight)
+		{
+			if (GetDistanceFromViewport(itemInFlight.second) > cancelDistance)
+			{
+				cancelledItems.emplace_back(itemInFlight.second, itemInFlight.first);
+			}
+		}
+	}
+
+	// The order items are iterated in above is arbitrary, so the items are
+	// sorted to keep the result deterministic.
+	std::sort(cancelledItems.begin(), cancelledItems.end());
+
+	std::vector<int> items;
+
+	for (const auto &cancelledItem : cancelledItems)
+	{
+		m_itemsInFlight.erase(cancelledItem.second);
+		AddPendingItem(cancelledItem.second, cancelledItem.first);
+		items.push_back(cancelledItem.second);
+	}
+
+	m_statistics.numCancelled += items.size();
+
+	return items;
+}
+
+std::optional<ThumbnailScheduler::ScheduledItem> ThumbnailScheduler::StartNextItem()
+{
+	if (m_itemsInFlight.size() >= m_options.maxItemsInFlight || m_pendingItems.empty())
+	{
+		return std::nullopt;
+	}
+
+	TaskPriority priority;
+	auto itr = FindNextPendingItem(priority);
+
+	// The item returned is never further away than the nearest pending item
+	// outside the prefetch window, so if it's beyond the limit, every other
+	// pending item is too.
+	if (m_maxStartDistance && GetDistanceFromViewport(itr->first) > *m_maxStartDistance)
+	{
+		return std::nullopt;
+	}
+
+	int position = itr->first;
+	int item = itr->second;
+
+	m_pendingItems.erase(itr);
+	m_pendingPositions.erase(item);
+	m_itemsInFlight.insert({ item, position });
+
+	m_statistics.numStarted++;
+
+	return ScheduledItem{ item, priority };
+}
+
+bool ThumbnailScheduler::CompleteItem(int item)
+{
+	if (m_completedItems.count(item) > 0)
+	{
+		return false;
+	}
+
+	int position = -1;
+	auto itr = m_pendingPositions.find(item);
+
+	if (itr != m_pendingPositions.end())
+	{
+		position = itr->second;
+		m_pendingItems.erase(itr->second);
+		m_pendingPositions.erase(itr);
+	}
+
+	auto inFlightItr = m_itemsInFlight.find(item);
+
+	if (inFlightItr != m_itemsInFlight.end())
+	{
+		position = inFlightItr->second;
+		m_itemsInFlight.erase(inFlightItr);
+	}
+
+	m_completedItems.insert({ item, position });
+
+	m_statistics.numCompleted++;
+
+	return true;
+}
+
+bool ThumbnailScheduler::RestartItem(int item)
+{
+	auto itr = m_completedItems.find(item);
+
+	if (itr == m_completedItems.end() || itr->second == -1)
+	{
+		return false;
+	}
+
+	AddPendingItem(item, itr->second);
+	m_completedItems.erase(itr);
+
+	m_statistics.numRestarted++;
+
+	return true;
+}
+
+void ThumbnailScheduler::SetMaxStartDistance(std::optional<int> distance)
+{
+	m_maxStartDistance = distance;
+}
+
+bool ThumbnailScheduler::IsItemKnown(int item) const
+{
+	return m_pendingPositions.count(item) > 0 || m_itemsInFlight.count(item) > 0
+		|| m_completedItems.count(item) > 0;
+}
+
+void ThumbnailScheduler::Reset()
+{
+	m_pendingItems.clear();
+	m_pendingPositions.clear();
+	m_itemsInFlight.clear();
+	m_completedItems.clear();
+	m_viewportFirst = 0;
+	m_viewportLast = -1;
+	m_scrollDirection = ScrollDirection::Forward;
+}
+
+size_t ThumbnailScheduler::GetNumPendingItems() const
+{
+	return m_pendingItems.size();
+}
+
+size_t ThumbnailScheduler::GetNumItemsInFlight() const
+{
+	return m_itemsInFlight.size();
+}
+
+ThumbnailScheduler::Statistics ThumbnailScheduler::GetStatistics() const
+{
+	return m_statistics;
+}
+
+int ThumbnailScheduler::GetViewportSize() const
+{
+	return m_viewportLast - m_viewportFirst + 1;
+}
+
+int ThumbnailScheduler::GetDistanceFromViewport(int position) const
+{
+	if (position < m_viewportFirst)
+	{
+		return m_viewportFirst - position;
+	}
+	else if (position > m_viewportLast)
+	{
+		return position - m_viewportLast;
+	}
+
+	return 0;
+}
+
+ThumbnailScheduler::PendingMap::iterator ThumbnailScheduler::FindNextPendingItem(TaskPriority &priority)
+{
+	// The first pending item after the viewport and the last pending item
+	// before it.
+	auto after = m_pendingItems.upper_bound(m_viewportLast);
+	auto before = m_pendingItems.lower_bound(m_viewportFirst);
+	bool hasBefore = (before != m_pendingItems.begin());
+
+	if (hasBefore)
+	{
+		--before;
+	}
+
+	int viewportSize = GetViewportSize();
+
+	if (viewportSize > 0)
+	{
+		auto visible = m_pendingItems.lower_bound(m_viewportFirst);
+
+		if (visible != m_pendingItems.end() && visible->first <= m_viewportLast)
+		{
+			priority = TaskPriority::Visible;
+			return visible;
+		}
+
+		int prefetchDistance = m_options.prefetchPages * viewportSize;
+
+		if (m_maxStartDistance)
+		{
+			prefetchDistance = (std::min)(prefetchDistance, *m_maxStartDistance);
+		}
+
+		if (m_scrollDirection == ScrollDirection::Forward && after != m_pendingItems.end()
+			&& GetDistanceFromViewport(after->first) <= prefetchDistance)
+		{
+			priority = TaskPriority::Prefetch;
+			return after;
+		}
+
+		if (m_scrollDirection == ScrollDirection::Backward && hasBefore
+			&& GetDistanceFromViewport(before->first) <= prefetchDistance)
+		{
+			priority = TaskPriority::Prefetch;
+			return before;
+		}
+	}
+
+	priority = TaskPriority::Background;
+
+	if (after == m_pendingItems.end())
+	{
+		return before;
+	}
+
+	if (!hasBefore)
+	{
+		return after;
+	}
+
+	int afterDistance = GetDistanceFromViewport(after->first);
+	int beforeDistance = GetDistanceFromViewport(before->first);
+
+	// Ties go to the item in the scroll direction.
+	if (afterDistance < beforeDistance
+		|| (afterDistance == beforeDistance && m_scrollDirection == ScrollDirection::Forward))
+	{
+		return after;
+	}
+
+	return before;
+}
+
+void ThumbnailScheduler::AddPendingItem(int item, int position)
+{
+	m_pendingItems.insert({ position, item });
+	m_pendingPositions.insert({ item, position });
+}
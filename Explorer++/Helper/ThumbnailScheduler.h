@@ -0,0 +1,144 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include "TaskExecutor.h"
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// Decides the order in which thumbnails are retrieved for the items in a
+// view, based on which items are currently visible. Items are identified by
+// an ID and have a position (their index in display order). Items are
+// started in three tiers:
+//
+// 1. Visible items, from first to last.
+// 2. Items within the prefetch window, which extends past the end of the
+//    viewport in the direction the view was last scrolled, nearest first.
+// 3. Everything else, nearest to the viewport first.
+//
+// Only a limited number of items are in flight at once, so that the order
+// can change as the viewport moves. Items in flight that end up far away
+// from the viewport are cancelled and go back to being pending.
+//
+// All decisions depend only on the calls made, so a sequence of calls will
+// always produce the same schedule.
+//
+// This class isn't thread-safe.
+class ThumbnailScheduler
+{
+public:
+
+	struct Options
+	{
+		size_t maxItemsInFlight = 8;
+
+		// Both distances are measured in pages, where a page is the number of
+		// items in the viewport.
+		int prefetchPages = 2;
+		int cancelPages = 4;
+	};
+
+	struct ScheduledItem
+	{
+		int item;
+
+		// The tier the item was started in.
+		TaskPriority priority;
+	};
+
+	struct Statistics
+	{
+		uint64_t numStarted = 0;
+		uint64_t numCompleted = 0;
+		uint64_t numCancelled = 0;
+		uint64_t numRestarted = 0;
+	};
+
+	explicit ThumbnailScheduler(const Options &options);
+
+	// Sets the items that need thumbnails, in display order. Items that have
+	// already been completed are ignored and items in flight stay in flight
+	// (at their new position). Items that aren't in the list are no longer
+	// tracked, even if they're in flight.
+	void SetItems(const std::vector<int> &items);
+
+	// Drops the item, wherever it is. If the ID is reused, the new item will
+	// be treated as a new item.
+	void RemoveItem(int item);
+
+	// Sets the (inclusive) range of visible positions. An empty range (last
+	// < first) means that nothing is visible. Returns the items in flight
+	// that are now too far away from the viewport, in position order.
+	// They're pending again, and the caller should cancel them.
+	std::vector<int> SetViewport(int first, int last);
+
+	// Returns the next item to start, if there is one and fewer than the
+	// maximum number of items are in flight. The item is then in flight
+	// until it's completed or cancelled.
+	std::optional<ScheduledItem> StartNextItem();
+
+	// Marks the item as finished (whether or not a thumbnail was found). The
+	// item won't be started again, unless it's restarted. Returns false if
+	// the item had already been completed.
+	bool CompleteItem(int item);
+
+	// Makes a completed item pending again (e.g. because its thumbnail was
+	// discarded). Returns false if the item isn't completed, or its position
+	// isn't known.
+	bool RestartItem(int item);
+
+	// Items further than this from the viewport (measured in items) won't be
+	// started. By default, there's no limit.
+	void SetMaxStartDistance(std::optional<int> distance);
+
+	// Returns true if the item is pending, in flight or completed.
+	bool IsItemKnown(int item) const;
+
+	// Forgets every item.
+	void Reset();
+
+	size_t GetNumPendingItems() const;
+	size_t GetNumItemsInFlight() const;
+	Statistics GetStatistics() const;
+
+private:
+
+	enum class ScrollDirection
+	{
+		Forward,
+		Backward
+	};
+
+	using PendingMap = std::map<int, int>;
+
+	int GetViewportSize() const;
+	int GetDistanceFromViewport(int position) const;
+	PendingMap::iterator FindNextPendingItem(TaskPriority &priority);
+	void AddPendingItem(int item, int position);
+
+	const Options m_options;
+
+	// Pending items, keyed by position, along with the position of each
+	// pending item.
+	PendingMap m_pendingItems;
+	std::unordered_map<int, int> m_pendingPositions;
+
+	// Maps each item in flight to its position.
+	std::unordered_map<int, int> m_itemsInFlight;
+
+	// Maps each completed item to its position (or -1, if the item was
+	// completed without ever being added).
+	std::unordered_map<int, int> m_completedItems;
+
+	int m_viewportFirst;
+	int m_viewportLast;
+	ScrollDirection m_scrollDirection;
+	std::optional<int> m_maxStartDistance;
+
+	Statistics m_statistics;
+};
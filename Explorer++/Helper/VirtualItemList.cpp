@@ -0,0 +1,332 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "VirtualItemList.h"
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+VirtualItemList::VirtualItemList() :
+	m_numSelected(0)
+{
+
+}
+
+void VirtualItemList::AddItems(const std::vector<int> &ids)
+{
+	std::vector<int> newIds;
+	newIds.reserve(ids.size());
+
+	for (int id : ids)
+	{
+		auto index = static_cast<size_t>(id);
+
+		if (index >= m_present.size())
+		{
+			m_present.resize(index + 1, false);
+			m_selected.resize(index + 1, false);
+		}
+
+		if (m_present[index])
+		{
+			continue;
+		}
+
+		m_present[index] = true;
+		newIds.push_back(id);
+	}
+
+	MergeItems(std::move(newIds));
+	RebuildRows();
+}
+
+void VirtualItemList::RemoveItems(const std::vector<int> &ids)
+{
+	for (int id : ids)
+	{
+		if (!IsPresent(id))
+		{
+			continue;
+		}
+
+		SetItemSelected(id, false);
+		m_present[id] = false;
+	}
+
+	m_items.erase(std::remove_if(m_items.begin(), m_items.end(), [this] (int id) {
+		return !m_present[id];
+	}), m_items.end());
+
+	RebuildRows();
+}
+
+void VirtualItemList::UpdateItems(const std::vector<int> &ids)
+{
+	// The items are temporarily marked as absent, so that they can be
+	// removed in a single pass.
+	std::vector<int> updatedIds;
+	updatedIds.reserve(ids.size());
+
+	for (int id : ids)
+	{
+		if (!IsPresent(id))
+		{
+			continue;
+		}
+
+		m_present[id] = false;
+		updatedIds.push_back(id);
+	}
+
+	m_items.erase(std::remove_if(m_items.begin(), m_items.end(), [this] (int id) {
+		return !m_present[id];
+	}), m_items.end());
+
+	for (int id : updatedIds)
+	{
+		m_present[id] = true;
+	}
+
+	MergeItems(std::move(updatedIds));
+	RebuildRows();
+}
+
+void VirtualItemList::Clear()
+{
+	m_items.clear();
+	m_rows.clear();
+	m_groups.clear();
+	m_present.clear();
+	m_rowForItem.clear();
+	m_selected.clear();
+	m_numSelected = 0;
+}
+
+void VirtualItemList::SetSortOrder(Compare compare)
+{
+	m_compare = std::move(compare);
+	std::stable_sort(m_items.begin(), m_items.end(), m_compare);
+	RebuildRows();
+}
+
+void VirtualItemList::SetFilter(Filter filter)
+{
+	m_filter = std::move(filter);
+	RebuildRows();
+}
+
+void VirtualItemList::RemoveFilter()
+{
+	m_filter = nullptr;
+	RebuildRows();
+}
+
+void VirtualItemList::SetGrouping(GroupKey groupKey)
+{
+	m_groupKey = std::move(groupKey);
+	RebuildRows();
+}
+
+void VirtualItemList::RemoveGrouping()
+{
+	m_groupKey = nullptr;
+	RebuildRows();
+}
+
+// The new items are sorted on their own and then merged into the existing
+// (sorted) items, so the existing items never need to be sorted again.
+void VirtualItemList::MergeItems(std::vector<int> ids)
+{
+	if (ids.empty())
+	{
+		return;
+	}
+
+	if (!m_compare)
+	{
+		m_items.insert(m_items.end(), ids.begin(), ids.end());
+		return;
+	}
+
+	std::stable_sort(ids.begin(), ids.end(), m_compare);
+
+	std::vector<int> merged;
+	merged.reserve(m_items.size() + ids.size());
+	std::merge(m_items.begin(), m_items.end(), ids.begin(), ids.end(), std::back_inserter(merged), m_compare);
+	m_items = std::move(merged);
+}
+
+void VirtualItemList::RebuildRows()
+{
+	m_rows.clear();
+	m_groups.clear();
+
+	if (m_filter)
+	{
+		std::copy_if(m_items.begin(), m_items.end(), std::back_inserter(m_rows), m_filter);
+	}
+	else
+	{
+		m_rows = m_items;
+	}
+
+	if (m_groupKey)
+	{
+		std::vector<std::pair<int, int>> keyedRows;
+		keyedRows.reserve(m_rows.size());
+
+		for (int id : m_rows)
+		{
+			keyedRows.emplace_back(m_groupKey(id), id);
+		}
+
+		std::stable_sort(keyedRows.begin(), keyedRows.end(), [] (const auto &row1, const auto &row2) {
+			return row1.first < row2.first;
+		});
+
+		for (size_t i = 0; i < keyedRows.size(); i++)
+		{
+			m_rows[i] = keyedRows[i].second;
+
+			if (m_groups.empty() || m_groups.back().key != keyedRows[i].first)
+			{
+				m_groups.push_back({ keyedRows[i].first, i, 0 });
+			}
+
+			m_groups.back().numRows++;
+		}
+	}
+
+	m_rowForItem.assign(m_present.size(), NO_ROW);
+
+	for (size_t i = 0; i < m_rows.size(); i++)
+	{
+		m_rowForItem[m_rows[i]] = i;
+	}
+
+	if (m_numSelected > 0)
+	{
+		for (size_t i = 0; i < m_selected.size(); i++)
+		{
+			if (m_selected[i] && m_rowForItem[i] == NO_ROW)
+			{
+				SetItemSelected(static_cast<int>(i), false);
+			}
+		}
+	}
+}
+
+size_t VirtualItemList::GetNumItems() const
+{
+	return m_items.size();
+}
+
+size_t VirtualItemList::GetNumRows() const
+{
+	return m_rows.size();
+}
+
+int VirtualItemList::GetItemAtRow(size_t row) const
+{
+	return m_rows[row];
+}
+
+std::optional<size_t> VirtualItemList::GetRowForItem(int id) const
+{
+	if (!IsPresent(id) || m_rowForItem[id] == NO_ROW)
+	{
+		return std::nullopt;
+	}
+
+	return m_rowForItem[id];
+}
+
+const std::vector<VirtualItemList::Group> &VirtualItemList::GetGroups() const
+{
+	return m_groups;
+}
+
+void VirtualItemList::SetRowSelected(size_t row, bool selected)
+{
+	SetItemSelected(m_rows[row], selected);
+}
+
+void VirtualItemList::SetRowRangeSelected(size_t firstRow, size_t lastRow, bool selected)
+{
+	for (size_t row = firstRow; row <= lastRow && row < m_rows.size(); row++)
+	{
+		SetItemSelected(m_rows[row], selected);
+	}
+}
+
+void VirtualItemList::SetAllSelected(bool selected)
+{
+	if (!selected)
+	{
+		std::fill(m_selected.begin(), m_selected.end(), false);
+		m_numSelected = 0;
+		return;
+	}
+
+	for (int id : m_rows)
+	{
+		SetItemSelected(id, true);
+	}
+}
+
+bool VirtualItemList::IsRowSelected(size_t row) const
+{
+	return m_selected[m_rows[row]];
+}
+
+bool VirtualItemList::IsItemSelected(int id) const
+{
+	return IsPresent(id) && m_selected[id];
+}
+
+size_t VirtualItemList::GetNumSelected() const
+{
+	return m_numSelected;
+}
+
+std::vector<int> VirtualItemList::GetSelectedItems() const
+{
+	std::vector<int> selectedItems;
+	selectedItems.reserve(m_numSelected);
+
+	for (int id : m_rows)
+	{
+		if (m_selected[id])
+		{
+			selectedItems.push_back(id);
+		}
+	}
+
+	return selectedItems;
+}
+
+bool VirtualItemList::IsPresent(int id) const
+{
+	return id >= 0 && static_cast<size_t>(id) < m_present.size() && m_present[id];
+}
+
+void VirtualItemList::SetItemSelected(int id, bool selected)
+{
+	if (m_selected[id] == selected)
+	{
+		return;
+	}
+
+	m_selected[id] = selected;
+
+	if (selected)
+	{
+		m_numSelected++;
+	}
+	else
+	{
+		m_numSelected--;
+	}
+}
@@ -0,0 +1,118 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <functional>
+#include <optional>
+#include <vector>
+
+// The model behind an owner-data (LVS_OWNERDATA) listview. Rather than
+// storing a copy of each item, the listview only stores the number of rows
+// and asks for each row as it's drawn. Each row is resolved to an item ID
+// (as allocated by ItemStore) through an index vector:
+//
+// - Sorting is a permutation of every item.
+// - Filtering selects the visible items from that permutation, in order.
+// - Grouping then stably reorders the visible items by group, so that each
+//   group occupies a contiguous range of rows (and remains sorted within
+//   that range).
+//
+// Selection is stored as a bitset indexed by item ID, so that it's
+// unaffected by changes to the sort order. Only visible items can be
+// selected; items that are filtered out are deselected.
+//
+// This class isn't thread-safe.
+class VirtualItemList
+{
+public:
+
+	// Returns true if the first item should be placed before the second.
+	using Compare = std::function<bool(int id1, int id2)>;
+
+	// Returns true if the item should be shown.
+	using Filter = std::function<bool(int id)>;
+
+	// Returns the key of the group the item belongs to. Groups are shown in
+	// ascending order of their keys.
+	using GroupKey = std::function<int(int id)>;
+
+	struct Group
+	{
+		int key;
+		size_t firstRow;
+		size_t numRows;
+	};
+
+	VirtualItemList();
+
+	// Each batch of items is sorted and then merged into the existing items,
+	// so adding items in batches is much more efficient than adding them
+	// individually.
+	void AddItems(const std::vector<int> &ids);
+	void RemoveItems(const std::vector<int> &ids);
+
+	// Should be called when the properties that the items are sorted,
+	// filtered or grouped by have changed.
+	void UpdateItems(const std::vector<int> &ids);
+
+	void Clear();
+
+	void SetSortOrder(Compare compare);
+	void SetFilter(Filter filter);
+	void RemoveFilter();
+	void SetGrouping(GroupKey groupKey);
+	void RemoveGrouping();
+
+	size_t GetNumItems() const;
+	size_t GetNumRows() const;
+	int GetItemAtRow(size_t row) const;
+	std::optional<size_t> GetRowForItem(int id) const;
+
+	// Empty if the items aren't grouped.
+	const std::vector<Group> &GetGroups() const;
+
+	void SetRowSelected(size_t row, bool selected);
+
+	// Both rows are included, matching the range reported by
+	// LVN_ODSTATECHANGED.
+	void SetRowRangeSelected(size_t firstRow, size_t lastRow, bool selected);
+
+	void SetAllSelected(bool selected);
+	bool IsRowSelected(size_t row) const;
+	bool IsItemSelected(int id) const;
+	size_t GetNumSelected() const;
+
+	// Returns the selected items in row order.
+	std::vector<int> GetSelectedItems() const;
+
+private:
+
+	static constexpr size_t NO_ROW = static_cast<size_t>(-1);
+
+	bool IsPresent(int id) const;
+	void SetItemSelected(int id, bool selected);
+	void MergeItems(std::vector<int> ids);
+	void RebuildRows();
+
+	Compare m_compare;
+	Filter m_filter;
+	GroupKey m_groupKey;
+
+	// Every item, in sorted order (or in the order in which the items were
+	// added, if there's no sort order).
+	std::vector<int> m_items;
+
+	// The visible items, in the order in which they're shown.
+	std::vector<int> m_rows;
+
+	std::vector<Group> m_groups;
+
+	// Each of these is indexed by item ID.
+	std::vector<bool> m_present;
+	std::vector<size_t> m_rowForItem;
+	std::vector<bool> m_selected;
+
+	size_t m_numSelected;
+};
@@ -481,6 +481,7 @@ void MyTreeView::RenameItem(HTREEITEM hItem, const TCHAR *szFullFileName)
 
 		ItemInfo_t &iteminfo = m_itemInfoMap.at(static_cast<int>(tvItem.lParam));
 		hr = SHParseDisplayName(szFullFileName, nullptr, wil::out_param(iteminfo.pidl), 0, nullptr);
+		iteminfo.sortInfo.reset();
 
 		pidlParent = iteminfo.pidl.get();
 
@@ -544,6 +545,7 @@ PCIDLIST_ABSOLUTE MyTreeView::UpdateItemInfo(PCIDLIST_ABSOLUTE pidlParent, int i
 {
 	ItemInfo_t &itemInfo = m_itemInfoMap.at(iItemId);
 	itemInfo.pidl.reset(ILCombine(pidlParent, itemInfo.pridl.get()));
+	itemInfo.sortInfo.reset();
 
 	return itemInfo.pidl.get();
 }
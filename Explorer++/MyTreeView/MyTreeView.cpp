@@ -338,14 +338,16 @@ std::optional<int> MyTreeView::GetCachedIconIndex(const ItemInfo_t &itemInfo)
 		return std::nullopt;
 	}
 
-	auto cachedItr = m_cachedIcons->findByPath(filePath);
+	// Every item in the treeview is a folder, so its icon is always cached by
+	// path.
+	auto cachedIcon = m_cachedIcons->findIcon(filePath, CachedIcons::ItemType::Folder);
 
-	if (cachedItr == m_cachedIcons->end())
+	if (!cachedIcon)
 	{
 		return std::nullopt;
 	}
 
-	return cachedItr->iconIndex;
+	return cachedIcon->iconIndex;
 }
 
 void MyTreeView::QueueIconTask(HTREEITEM item, int internalIndex)
@@ -417,7 +419,7 @@ void MyTreeView::ProcessIconResult(int iconResultId)
 
 	if (SUCCEEDED(hr))
 	{
-		m_cachedIcons->addOrUpdateFileIcon(filePath, result->iconIndex);
+		m_cachedIcons->addOrUpdateFileIcon(filePath, CachedIcons::ItemType::Folder, result->iconIndex);
 	}
 
 	TVITEM tvItem;
@@ -562,50 +564,62 @@ int CALLBACK CompareItemsStub(LPARAM lParam1,LPARAM lParam2,LPARAM lParamSort)
 
 int CALLBACK MyTreeView::CompareItems(LPARAM lParam1,LPARAM lParam2)
 {
-	TCHAR szDisplayName1[MAX_PATH];
-	TCHAR szDisplayName2[MAX_PATH];
-	TCHAR szTemp[MAX_PATH];
-	int iItemId1 = (int)lParam1;
-	int iItemId2 = (int)lParam2;
-
-	const ItemInfo_t &itemInfo1 = m_itemInfoMap.at(iItemId1);
-	const ItemInfo_t &itemInfo2 = m_itemInfoMap.at(iItemId2);
+	const ItemSortInfo &sortInfo1 = GetItemSortInfo(static_cast<int>(lParam1));
+	const ItemSortInfo &sortInfo2 = GetItemSortInfo(static_cast<int>(lParam2));
 
-	GetDisplayName(itemInfo1.pidl.get(),szDisplayName1,SIZEOF_ARRAY(szDisplayName1),SHGDN_FORPARSING);
-	GetDisplayName(itemInfo2.pidl.get(),szDisplayName2,SIZEOF_ARRAY(szDisplayName2),SHGDN_FORPARSING);
-
-	if(PathIsRoot(szDisplayName1) && !PathIsRoot(szDisplayName2))
+	if(sortInfo1.isRoot && !sortInfo2.isRoot)
 	{
 		return -1;
 	}
-	else if(!PathIsRoot(szDisplayName1) && PathIsRoot(szDisplayName2))
+	else if(!sortInfo1.isRoot && sortInfo2.isRoot)
 	{
 		return 1;
 	}
-	else if(PathIsRoot(szDisplayName1) && PathIsRoot(szDisplayName2))
+	else if(!sortInfo1.isRoot && !sortInfo2.isRoot)
 	{
-		return lstrcmpi(szDisplayName1,szDisplayName2);
-	}
-	else
-	{
-		if(!SHGetPathFromIDList(itemInfo1.pidl.get(),szTemp) &&
-			SHGetPathFromIDList(itemInfo2.pidl.get(),szTemp))
+		if(!sortInfo1.isFileSystemItem && sortInfo2.isFileSystemItem)
 		{
 			return -1;
 		}
-		else if(SHGetPathFromIDList(itemInfo1.pidl.get(),szTemp) &&
-			!SHGetPathFromIDList(itemInfo2.pidl.get(),szTemp))
+		else if(sortInfo1.isFileSystemItem && !sortInfo2.isFileSystemItem)
 		{
 			return 1;
 		}
-		else
-		{
-			GetDisplayName(itemInfo1.pidl.get(),szDisplayName1,SIZEOF_ARRAY(szDisplayName1),SHGDN_INFOLDER);
-			GetDisplayName(itemInfo2.pidl.get(),szDisplayName2,SIZEOF_ARRAY(szDisplayName2),SHGDN_INFOLDER);
+	}
 
-			return StrCmpLogicalW(szDisplayName1,szDisplayName2);
-		}
+	return CompareCollationKeys(sortInfo1.nameKey,sortInfo2.nameKey);
+}
+
+const MyTreeView::ItemSortInfo &MyTreeView::GetItemSortInfo(int itemId)
+{
+	ItemInfo_t &itemInfo = m_itemInfoMap.at(itemId);
+
+	if(itemInfo.sortInfo)
+	{
+		return *itemInfo.sortInfo;
+	}
+
+	TCHAR szDisplayName[MAX_PATH];
+	TCHAR szTemp[MAX_PATH];
+
+	GetDisplayName(itemInfo.pidl.get(),szDisplayName,SIZEOF_ARRAY(szDisplayName),SHGDN_FORPARSING);
+
+	ItemSortInfo sortInfo;
+	sortInfo.isRoot = PathIsRoot(szDisplayName) ? true : false;
+	sortInfo.isFileSystemItem = SHGetPathFromIDList(itemInfo.pidl.get(),szTemp) ? true : false;
+
+	/* Roots (i.e. drives) are sorted by their parsing
+	name, everything else by its display name. */
+	if(!sortInfo.isRoot)
+	{
+		GetDisplayName(itemInfo.pidl.get(),szDisplayName,SIZEOF_ARRAY(szDisplayName),SHGDN_INFOLDER);
 	}
+
+	sortInfo.nameKey = BuildCollationKey(szDisplayName);
+
+	itemInfo.sortInfo = std::move(sortInfo);
+
+	return *itemInfo.sortInfo;
 }
 
 void MyTreeView::AddDirectoryInternal(IShellFolder *pShellFolder, PCIDLIST_ABSOLUTE pidlDirectory,
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include "../Helper/CollationKey.h"
 #include "../Helper/DropHandler.h"
 #include "../Helper/iDirectoryMonitor.h"
 #include "../Helper/ShellHelper.h"
@@ -55,10 +56,25 @@ private:
 	static const UINT WM_APP_ICON_RESULT_READY = WM_APP + 1;
 	static const UINT WM_APP_SUBFOLDERS_RESULT_READY = WM_APP + 2;
 
+	/* The information needed to sort an item. Retrieving
+	this requires several calls into the shell, so it's
+	only done once per item, rather than once per
+	comparison. */
+	struct ItemSortInfo
+	{
+		bool isRoot;
+		bool isFileSystemItem;
+		CollationKey nameKey;
+	};
+
 	typedef struct
 	{
 		unique_pidl_absolute pidl;
 		unique_pidl_child pridl;
+
+		/* Built the first time the item is sorted. Should be
+		reset whenever the pidl changes. */
+		std::optional<ItemSortInfo> sortInfo;
 	} ItemInfo_t;
 
 	typedef struct
@@ -161,6 +177,9 @@ private:
 	/* Item id's. */
 	int			GenerateUniqueItemId();
 
+	/* Sorting. */
+	const ItemSortInfo	&GetItemSortInfo(int itemId);
+
 	/* Drag and drop. */
 	HRESULT		InitializeDragDropHelpers(void);
 	void		RestoreState(void);
@@ -0,0 +1,587 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/BatchedRequestQueue.h"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	// Requests are paths and the batch key is the parent folder.
+	struct PathRequestTraits
+	{
+		using Key = std::wstring_view;
+		using Request = std::wstring;
+		using Result = int;
+		using Waiter = int;
+
+		static size_t Hash(std::wstring_view key)
+		{
+			return std::hash<std::wstring_view>()(key);
+		}
+
+		static size_t GetBatchKey(std::wstring_view key)
+		{
+			return std::hash<std::wstring_view>()(key.substr(0, key.find_last_of('\\')));
+		}
+
+		static bool Equals(const std::wstring &request, std::wstring_view key)
+		{
+			return request == key;
+		}
+
+		static void Assign(std::wstring &request, std::wstring_view key)
+		{
+			request.assign(key);
+		}
+	};
+
+	using PathRequestQueue = BatchedRequestQueue<PathRequestTraits>;
+
+	struct Delivery
+	{
+		std::wstring path;
+		std::optional<int> result;
+		std::vector<int> waiters;
+	};
+
+	// Blocks the resolver until it's released, so that requests can be
+	// held in flight.
+	class Gate
+	{
+	public:
+
+		void Wait()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this] { return m_open; });
+		}
+
+		void Open()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_open = true;
+			}
+
+			m_condition.notify_all();
+		}
+
+	private:
+
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_open = false;
+	};
+
+	// Stands in for the UI thread's message queue.
+	class Notifications
+	{
+	public:
+
+		void Notify()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_numPosted++;
+			}
+
+			m_condition.notify_all();
+		}
+
+		// Waits for a notification that hasn't been handled yet.
+		bool WaitForNext()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			bool posted = m_condition.wait_for(lock, std::chrono::seconds(10), [this] {
+				return m_numPosted > m_numHandled;
+			});
+
+			if (posted)
+			{
+				m_numHandled++;
+			}
+
+			return posted;
+		}
+
+		int GetNumPosted()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_numPosted;
+		}
+
+	private:
+
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		int m_numPosted = 0;
+		int m_numHandled = 0;
+	};
+
+	int GetResult(const std::wstring &path)
+	{
+		return static_cast<int>(path.size());
+	}
+
+	// Delivers results as notifications arrive, until the expected number of
+	// requests have been delivered.
+	std::vector<Delivery> DeliverAll(PathRequestQueue &queue, Notifications &notifications, size_t numExpected)
+	{
+		std::vector<Delivery> deliveries;
+
+		while (deliveries.size() < numExpected && notifications.WaitForNext())
+		{
+			queue.DeliverResults([&deliveries] (const std::wstring &path, const std::optional<int> &result,
+				std::vector<int> &waiters) {
+				deliveries.push_back({ path, result, waiters });
+			});
+		}
+
+		return deliveries;
+	}
+}
+
+TEST(BatchedRequestQueueTest, ResolvesEveryRequest)
+{
+	TaskExecutor executor(4);
+	Notifications notifications;
+
+	PathRequestQueue queue(executor, [] (const std::vector<PathRequestQueue::BatchItem> &items) {
+		for (auto &item : items)
+		{
+			// Requests in the "missing" folder can't be resolved.
+			if (item.request->find(L"missing") == std::wstring::npos)
+			{
+				*item.result = GetResult(*item.request);
+			}
+		}
+	}, [&notifications] { notifications.Notify(); }, 4, 2);
+
+	std::vector<std::wstring> paths;
+
+	for (int i = 0; i < 20; i++)
+	{
+		paths.push_back(L"C:\\folder" + std::to_wstring(i % 3) + L"\\file" + std::to_wstring(i));
+		queue.Push(paths.back(), i);
+	}
+
+	queue.Push(L"C:\\missing\\file", 100);
+
+	auto deliveries = DeliverAll(queue, notifications, paths.size() + 1);
+	ASSERT_EQ(paths.size() + 1, deliveries.size());
+
+	for (const auto &delivery : deliveries)
+	{
+		ASSERT_EQ(1u, delivery.waiters.size());
+
+		if (delivery.waiters[0] == 100)
+		{
+			EXPECT_EQ(L"C:\\missing\\file", delivery.path);
+			EXPECT_EQ(std::nullopt, delivery.result);
+			continue;
+		}
+
+		EXPECT_EQ(paths[delivery.waiters[0]], delivery.path);
+		EXPECT_EQ(GetResult(delivery.path), delivery.result);
+	}
+
+	EXPECT_EQ(0u, queue.GetNumOutstanding());
+
+	auto statistics = queue.GetStatistics();
+	EXPECT_EQ(21u, statistics.numRequests);
+	EXPECT_EQ(20u, statistics.numResolved);
+	EXPECT_EQ(1u, statistics.numFailed);
+	EXPECT_EQ(0u, statistics.numMerged);
+}
+
+TEST(BatchedRequestQueueTest, BatchesShareKey)
+{
+	TaskExecutor executor(2);
+	Notifications notifications;
+	Gate gate;
+
+	std::mutex batchesMutex;
+	std::vector<std::vector<std::wstring>> batches;
+
+	PathRequestQueue queue(executor, [&] (const std::vector<PathRequestQueue::BatchItem> &items) {
+		gate.Wait();
+
+		std::vector<std::wstring> batch;
+
+		for (auto &item : items)
+		{
+			batch.push_back(*item.request);
+			*item.result = GetResult(*item.request);
+		}
+
+		std::lock_guard<std::mutex> lock(batchesMutex);
+		batches.push_back(batch);
+	}, [&notifications] { notifications.Notify(); }, 3, 1);
+
+	// Only one batch can be in flight, so the remaining requests are queued
+	// until it's delivered.
+	for (int i = 0; i < 12; i++)
+	{
+		queue.Push(L"C:\\folder" + std::to_wstring(i % 2) + L"\\file" + std::to_wstring(i), i);
+	}
+
+	gate.Open();
+
+	auto deliveries = DeliverAll(queue, notifications, 12);
+	EXPECT_EQ(12u, deliveries.size());
+
+	// The first request is dispatched on its own, as soon as it's pushed. The
+	// rest are grouped by folder, in the order each folder was queued.
+	std::vector<std::vector<std::wstring>> expectedBatches = {
+		{ L"C:\\folder0\\file0" },
+		{ L"C:\\folder1\\file1", L"C:\\folder1\\file3", L"C:\\folder1\\file5" },
+		{ L"C:\\folder1\\file7", L"C:\\folder1\\file9", L"C:\\folder1\\file11" },
+		{ L"C:\\folder0\\file2", L"C:\\folder0\\file4", L"C:\\folder0\\file6" },
+		{ L"C:\\folder0\\file8", L"C:\\folder0\\file10" }
+	};
+	EXPECT_EQ(expectedBatches, batches);
+	EXPECT_EQ(5u, queue.GetStatistics().numBatches);
+}
+
+TEST(BatchedRequestQueueTest, MergesIdenticalRequests)
+{
+	TaskExecutor executor(2);
+	Notifications notifications;
+	Gate gate;
+	std::atomic<int> numResolved = 0;
+
+	PathRequestQueue queue(executor, [&] (const std::vector<PathRequestQueue::BatchItem> &items) {
+		gate.Wait();
+
+		for (auto &item : items)
+		{
+			*item.result = GetResult(*item.request);
+			numResolved++;
+		}
+	}, [&notifications] { notifications.Notify(); }, 1, 1);
+
+	// The first request is in flight and the second is queued when the
+	// duplicates are pushed.
+	queue.Push(L"C:\\a", 1);
+	queue.Push(L"C:\\bb", 2);
+	queue.Push(L"C:\\a", 3);
+	queue.Push(L"C:\\bb", 4);
+	queue.Push(L"C:\\a", 5);
+
+	EXPECT_EQ(2u, queue.GetNumOutstanding());
+
+	gate.Open();
+
+	auto deliveries = DeliverAll(queue, notifications, 2);
+	ASSERT_EQ(2u, deliveries.size());
+	EXPECT_EQ(L"C:\\a", deliveries[0].path);
+	EXPECT_EQ(std::vector<int>({ 1, 3, 5 }), deliveries[0].waiters);
+	EXPECT_EQ(L"C:\\bb", deliveries[1].path);
+	EXPECT_EQ(std::vector<int>({ 2, 4 }), deliveries[1].waiters);
+	EXPECT_EQ(2, numResolved.load());
+
+	// Once delivered, a request is resolved again.
+	queue.Push(L"C:\\a", 6);
+	deliveries = DeliverAll(queue, notifications, 1);
+	ASSERT_EQ(1u, deliveries.size());
+	EXPECT_EQ(std::vector<int>({ 6 }), deliveries[0].waiters);
+	EXPECT_EQ(3, numResolved.load());
+
+	EXPECT_EQ(3u, queue.GetStatistics().numMerged);
+}
+
+TEST(BatchedRequestQueueTest, CoalescesNotifications)
+{
+	TaskExecutor executor(4);
+	Notifications notifications;
+	std::atomic<int> numResolved = 0;
+
+	PathRequestQueue queue(executor, [&numResolved] (const std::vector<PathRequestQueue::BatchItem> &items) {
+		for (auto &item : items)
+		{
+			*item.result = GetResult(*item.request);
+			numResolved++;
+		}
+	}, [&notifications] { notifications.Notify(); }, 1, 8);
+
+	for (int i = 0; i < 8; i++)
+	{
+		queue.Push(L"C:\\folder" + std::to_wstring(i) + L"\\file", i);
+	}
+
+	while (numResolved < 8)
+	{
+		std::this_thread::yield();
+	}
+
+	// Every batch is complete, but since none of the results have been
+	// delivered yet, there should only have been a single notification.
+	ASSERT_TRUE(notifications.WaitForNext());
+	EXPECT_EQ(1, notifications.GetNumPosted());
+
+	size_t numDelivered = 0;
+
+	while (numDelivered < 8)
+	{
+		numDelivered += queue.DeliverResults([] (const std::wstring &, const std::optional<int> &,
+			std::vector<int> &) {});
+	}
+
+	EXPECT_EQ(8u, numDelivered);
+}
+
+TEST(BatchedRequestQueueTest, PushResult)
+{
+	TaskExecutor executor(1);
+	Notifications notifications;
+	bool resolverCalled = false;
+
+	PathRequestQueue queue(executor, [&resolverCalled] (const std::vector<PathRequestQueue::BatchItem> &) {
+		resolverCalled = true;
+	}, [&notifications] { notifications.Notify(); }, 4, 1);
+
+	queue.PushResult(L"C:\\cached", 42, 1);
+	EXPECT_EQ(1u, queue.GetNumOutstanding());
+	EXPECT_EQ(1, notifications.GetNumPosted());
+
+	auto deliveries = DeliverAll(queue, notifications, 1);
+	ASSERT_EQ(1u, deliveries.size());
+	EXPECT_EQ(L"C:\\cached", deliveries[0].path);
+	EXPECT_EQ(42, deliveries[0].result);
+	EXPECT_FALSE(resolverCalled);
+}
+
+TEST(BatchedRequestQueueTest, Clear)
+{
+	TaskExecutor executor(1);
+	Notifications notifications;
+	Gate gate;
+
+	PathRequestQueue queue(executor, [&gate] (const std::vector<PathRequestQueue::BatchItem> &items) {
+		gate.Wait();
+
+		for (auto &item : items)
+		{
+			*item.result = GetResult(*item.request);
+		}
+	}, [&notifications] { notifications.Notify(); }, 1, 1);
+
+	queue.Push(L"C:\\in-flight", 1);
+	queue.Push(L"C:\\queued", 2);
+	queue.PushResult(L"C:\\cached", 5, 3);
+	queue.Clear();
+	EXPECT_EQ(0u, queue.GetNumOutstanding());
+
+	// The request that was in flight when the queue was cleared shouldn't be
+	// merged into.
+	queue.Push(L"C:\\in-flight", 4);
+
+	gate.Open();
+
+	auto deliveries = DeliverAll(queue, notifications, 1);
+	ASSERT_EQ(1u, deliveries.size());
+	EXPECT_EQ(L"C:\\in-flight", deliveries[0].path);
+	EXPECT_EQ(std::vector<int>({ 4 }), deliveries[0].waiters);
+	EXPECT_EQ(0u, queue.GetNumOutstanding());
+	EXPECT_EQ(0u, queue.GetStatistics().numMerged);
+}
+
+TEST(BatchedRequestQueueTest, ClearFromHandler)
+{
+	TaskExecutor executor(1);
+	Notifications notifications;
+
+	PathRequestQueue queue(executor, [] (const std::vector<PathRequestQueue::BatchItem> &items) {
+		for (auto &item : items)
+		{
+			*item.result = GetResult(*item.request);
+		}
+	}, [&notifications] { notifications.Notify(); }, 8, 1);
+
+	for (int i = 0; i < 4; i++)
+	{
+		queue.PushResult(L"C:\\file" + std::to_wstring(i), i, i);
+	}
+
+	int numDelivered = 0;
+
+	ASSERT_TRUE(notifications.WaitForNext());
+	queue.DeliverResults([&] (const std::wstring &, const std::optional<int> &, std::vector<int> &) {
+		numDelivered++;
+
+		// Stands in for a callback that navigates away.
+		queue.Clear();
+		queue.Push(L"C:\\new", 10);
+	});
+
+	EXPECT_EQ(1, numDelivered);
+
+	auto deliveries = DeliverAll(queue, notifications, 1);
+	ASSERT_EQ(1u, deliveries.size());
+	EXPECT_EQ(L"C:\\new", deliveries[0].path);
+	EXPECT_EQ(0u, queue.GetNumOutstanding());
+}
+
+TEST(BatchedRequestQueueTest, RecordsReused)
+{
+	TaskExecutor executor(2);
+	Notifications notifications;
+
+	PathRequestQueue queue(executor, [] (const std::vector<PathRequestQueue::BatchItem> &items) {
+		for (auto &item : items)
+		{
+			*item.result = GetResult(*item.request);
+		}
+	}, [&notifications] { notifications.Notify(); }, 4, 2);
+
+	for (int round = 0; round < 50; round++)
+	{
+		for (int i = 0; i < 10; i++)
+		{
+			queue.Push(L"C:\\folder\\file" + std::to_wstring(round * 10 + i), i);
+		}
+
+		EXPECT_EQ(10u, DeliverAll(queue, notifications, 10).size());
+	}
+
+	auto statistics = queue.GetStatistics();
+	EXPECT_EQ(500u, statistics.numResolved);
+	EXPECT_EQ(10u, statistics.numRecordsAllocated);
+	EXPECT_LE(statistics.numBatchesAllocated, 3u);
+}
+
+// Compares the previous approach, where each icon request was a separate task
+// with its own future and its own result message, with batched requests.
+// Run with --gtest_also_run_disabled_tests.
+TEST(BatchedRequestQueueTest, DISABLED_Benchmark)
+{
+	const int NUM_FOLDERS = 20;
+	const int NUM_ITEMS_PER_FOLDER = 5000;
+
+	// Each item is requested twice (e.g. once when it's first shown and again
+	// when it's redrawn).
+	std::vector<std::wstring> paths;
+
+	for (int i = 0; i < NUM_FOLDERS; i++)
+	{
+		for (int j = 0; j < NUM_ITEMS_PER_FOLDER; j++)
+		{
+			paths.push_back(L"C:\\folder" + std::to_wstring(i) + L"\\file" + std::to_wstring(j) + L".txt");
+		}
+	}
+
+	const size_t numRequests = paths.size() * 2;
+
+	auto toMilliseconds = [] (auto duration) {
+		return static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+	};
+
+	TaskExecutor executor((std::max)(2, static_cast<int>(std::thread::hardware_concurrency())));
+	Notifications notifications;
+
+	auto start = std::chrono::steady_clock::now();
+
+	{
+		struct FutureResult
+		{
+			std::function<void(const std::wstring &path, int result)> callback;
+			std::wstring path;
+			std::future<std::optional<int>> result;
+		};
+
+		TaskGroup tasks(executor);
+		std::unordered_map<int, FutureResult> futureResults;
+		MpscQueue<int> messages;
+		int resultIdCounter = 0;
+		size_t numDelivered = 0;
+
+		for (size_t i = 0; i < numRequests; i++)
+		{
+			int resultId = resultIdCounter++;
+			std::wstring path = paths[i % paths.size()];
+
+			auto result = tasks.Push(TaskPriority::Visible, [&messages, &notifications, resultId, path] () -> std::optional<int> {
+				int result = GetResult(path);
+				messages.Push(resultId);
+				notifications.Notify();
+				return result;
+			});
+
+			FutureResult futureResult;
+			futureResult.callback = [&numDelivered] (const std::wstring &, int) {
+				numDelivered++;
+			};
+			futureResult.path = path;
+			futureResult.result = std::move(result);
+			futureResults.insert({ resultId, std::move(futureResult) });
+		}
+
+		// Each result is handled as a separate message.
+		while (numDelivered < numRequests && notifications.WaitForNext())
+		{
+			int resultId;
+
+			if (!messages.TryPop(resultId))
+			{
+				continue;
+			}
+
+			auto itr = futureResults.find(resultId);
+			auto result = itr->second.result.get();
+			itr->second.callback(itr->second.path, *result);
+			futureResults.erase(itr);
+		}
+	}
+
+	auto perRequestDuration = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+
+	PathRequestQueue queue(executor, [] (const std::vector<PathRequestQueue::BatchItem> &items) {
+		for (auto &item : items)
+		{
+			*item.result = GetResult(*item.request);
+		}
+	}, [&notifications] { notifications.Notify(); }, 32, executor.GetNumThreads());
+
+	size_t numDelivered = 0;
+	size_t numNotifications = 0;
+
+	for (size_t i = 0; i < numRequests; i++)
+	{
+		queue.Push(paths[i % paths.size()], static_cast<int>(i));
+	}
+
+	while (queue.GetNumOutstanding() > 0 && notifications.WaitForNext())
+	{
+		numNotifications++;
+		numDelivered += queue.DeliverResults([] (const std::wstring &, const std::optional<int> &,
+			std::vector<int> &) {});
+	}
+
+	auto batchedDuration = std::chrono::steady_clock::now() - start;
+
+	auto statistics = queue.GetStatistics();
+
+	std::cout << numRequests << " requests\n"
+		<< "Task per request: " << toMilliseconds(perRequestDuration) << " ms, " << numRequests
+		<< " result messages\n"
+		<< "Batched: " << toMilliseconds(batchedDuration) << " ms, " << numNotifications
+		<< " result messages, " << statistics.numBatches << " batches, " << statistics.numMerged
+		<< " requests merged, " << statistics.numRecordsAllocated << " records and "
+		<< statistics.numBatchesAllocated << " batches allocated\n";
+
+	EXPECT_EQ(paths.size(), numDelivered);
+}
@@ -0,0 +1,343 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/CachedIcons.h"
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+
+namespace
+{
+	using ItemType = CachedIcons::ItemType;
+
+	class CachedIconsTest : public ::testing::Test
+	{
+	protected:
+
+		void SetUp() override
+		{
+			m_directory = std::filesystem::temp_directory_path()
+				/ ("CachedIconsTest-" + std::to_string(std::hash<std::string>()(
+					::testing::UnitTest::GetInstance()->current_test_info()->name())));
+			std::filesystem::create_directories(m_directory);
+		}
+
+		void TearDown() override
+		{
+			std::error_code error;
+			std::filesystem::remove_all(m_directory, error);
+		}
+
+		std::wstring GetCacheFilePath() const
+		{
+			return (m_directory / "IconCache.dat").wstring();
+		}
+
+		// Resolves icon locations using a fixed table, in place of the system
+		// image list.
+		CachedIcons::IconLocationResolver GetResolver()
+		{
+			return [this] (const IconLocation &location) -> std::optional<int> {
+				m_numResolved++;
+
+				auto itr = m_iconIndexes.find({ location.path, location.index });
+
+				if (itr == m_iconIndexes.end())
+				{
+					return std::nullopt;
+				}
+
+				return itr->second;
+			};
+		}
+
+		std::filesystem::path m_directory;
+		std::map<std::pair<std::wstring, int>, int> m_iconIndexes;
+		int m_numResolved = 0;
+	};
+
+	std::optional<int> FindIconIndex(CachedIcons &cachedIcons, const std::wstring &filePath,
+		ItemType itemType = ItemType::File)
+	{
+		auto cachedIcon = cachedIcons.findIcon(filePath, itemType);
+
+		if (!cachedIcon)
+		{
+			return std::nullopt;
+		}
+
+		return cachedIcon->iconIndex;
+	}
+}
+
+TEST(TestCachedIcons, TestMaxSize)
+{
+	CachedIcons cachedIcons(2);
+
+	cachedIcons.addOrUpdateFileIcon(L"C:\\file1", ItemType::File, 0);
+	cachedIcons.addOrUpdateFileIcon(L"C:\\file2", ItemType::File, 0);
+	EXPECT_TRUE(cachedIcons.findIcon(L"C:\\file1", ItemType::File));
+
+	cachedIcons.addOrUpdateFileIcon(L"C:\\file3", ItemType::File, 0);
+
+	// The cache can hold a maximum of 2 icons, so the addition of the third
+	// icon above should have pushed out the oldest item.
+	EXPECT_FALSE(cachedIcons.findIcon(L"C:\\file1", ItemType::File));
+
+	// But the second item should still be there.
+	EXPECT_TRUE(cachedIcons.findIcon(L"C:\\file2", ItemType::File));
+
+	EXPECT_EQ(2u, cachedIcons.getNumPathEntries());
+	EXPECT_EQ(1u, cachedIcons.getStatistics().numEvicted);
+}
+
+TEST(TestCachedIcons, TestLookup)
+{
+	CachedIcons cachedIcons(2);
+
+	cachedIcons.addOrUpdateFileIcon(L"C:\\file1", ItemType::File, 4);
+
+	EXPECT_EQ(4, FindIconIndex(cachedIcons, L"C:\\file1"));
+	EXPECT_EQ(std::nullopt, FindIconIndex(cachedIcons, L"C:\\non-existent"));
+}
+
+TEST(TestCachedIcons, TestReplace)
+{
+	CachedIcons cachedIcons(2);
+
+	cachedIcons.addOrUpdateFileIcon(L"C:\\file1", ItemType::File, 0);
+	cachedIcons.addOrUpdateFileIcon(L"C:\\file2", ItemType::File, 0);
+	cachedIcons.addOrUpdateFileIcon(L"C:\\file1", ItemType::File, 1);
+	EXPECT_EQ(1, FindIconIndex(cachedIcons, L"C:\\file1"));
+
+	cachedIcons.addOrUpdateFileIcon(L"C:\\file3", ItemType::File, 0);
+
+	// Updating the item above should have moved it to the front of the list.
+	// This means that when the third item was inserted, the second item is
+	// what should have been removed.
+	EXPECT_FALSE(cachedIcons.findIcon(L"C:\\file2", ItemType::File));
+
+	// The updated item should still exist.
+	EXPECT_TRUE(cachedIcons.findIcon(L"C:\\file1", ItemType::File));
+}
+
+TEST(TestCachedIcons, IconClass)
+{
+	EXPECT_EQ(L"txt", CachedIcons::getIconClass(L"C:\\Documents\\notes.txt", ItemType::File));
+	EXPECT_EQ(L"txt", CachedIcons::getIconClass(L"C:\\Documents\\NOTES.TXT", ItemType::File));
+	EXPECT_EQ(L"gz", CachedIcons::getIconClass(L"\\\\server\\share\\archive.tar.gz", ItemType::File));
+
+	// Folders, files without an extension and files that can have their own
+	// icon are all cached individually.
+	EXPECT_EQ(std::nullopt, CachedIcons::getIconClass(L"C:\\Documents", ItemType::Folder));
+	EXPECT_EQ(std::nullopt, CachedIcons::getIconClass(L"C:\\Folder.old", ItemType::Folder));
+	EXPECT_EQ(std::nullopt, CachedIcons::getIconClass(L"C:\\Folder.old\\README", ItemType::File));
+	EXPECT_EQ(std::nullopt, CachedIcons::getIconClass(L"C:\\Documents\\file.", ItemType::File));
+	EXPECT_EQ(std::nullopt, CachedIcons::getIconClass(L"C:\\Program\\app.exe", ItemType::File));
+	EXPECT_EQ(std::nullopt, CachedIcons::getIconClass(L"C:\\Desktop\\App.LNK", ItemType::File));
+	EXPECT_EQ(std::nullopt, CachedIcons::getIconClass(L"C:\\Icons\\folder.ico", ItemType::File));
+
+	// As are virtual items.
+	EXPECT_EQ(std::nullopt, CachedIcons::getIconClass(
+		L"::{20D04FE0-3AEA-1069-A2D8-08002B30309D}", ItemType::File));
+}
+
+TEST(TestCachedIcons, ClassEntriesShared)
+{
+	CachedIcons cachedIcons(1);
+
+	cachedIcons.addOrUpdateFileIcon(L"C:\\Documents\\a.txt", ItemType::File, 7);
+
+	auto cachedIcon = cachedIcons.findIcon(L"D:\\Other\\b.TXT", ItemType::File);
+	ASSERT_TRUE(cachedIcon);
+	EXPECT_EQ(7, cachedIcon->iconIndex);
+	EXPECT_EQ(CachedIcon::Level::Class, cachedIcon->level);
+
+	// Class entries don't count towards the limit on path entries.
+	cachedIcons.addOrUpdateFileIcon(L"C:\\Documents\\c.doc", ItemType::File, 8);
+	cachedIcons.addOrUpdateFileIcon(L"C:\\Program\\app.exe", ItemType::File, 9);
+	EXPECT_EQ(2u, cachedIcons.getNumClassEntries());
+	EXPECT_EQ(1u, cachedIcons.getNumPathEntries());
+
+	cachedIcon = cachedIcons.findIcon(L"C:\\Program\\app.exe", ItemType::File);
+	ASSERT_TRUE(cachedIcon);
+	EXPECT_EQ(CachedIcon::Level::Path, cachedIcon->level);
+
+	EXPECT_FALSE(cachedIcons.findIcon(L"C:\\Program\\other.exe", ItemType::File));
+
+	auto statistics = cachedIcons.getStatistics();
+	EXPECT_EQ(1u, statistics.numClassHits);
+	EXPECT_EQ(1u, statistics.numPathHits);
+	EXPECT_EQ(1u, statistics.numMisses);
+}
+
+TEST(TestCachedIcons, FoldersCachedByPath)
+{
+	CachedIcons cachedIcons(10);
+
+	cachedIcons.addOrUpdateFileIcon(L"C:\\Documents", ItemType::Folder, 3);
+
+	EXPECT_EQ(3, FindIconIndex(cachedIcons, L"C:\\Documents", ItemType::Folder));
+	EXPECT_EQ(std::nullopt, FindIconIndex(cachedIcons, L"C:\\Pictures", ItemType::Folder));
+}
+
+TEST(TestCachedIcons, OverlayDroppedFromClassEntries)
+{
+	CachedIcons cachedIcons(10);
+
+	int overlay = 2 << 24;
+
+	cachedIcons.addOrUpdateFileIcon(L"C:\\Documents\\shared.txt", ItemType::File, overlay | 7);
+	EXPECT_EQ(7, FindIconIndex(cachedIcons, L"C:\\Documents\\other.txt"));
+
+	cachedIcons.addOrUpdateFileIcon(L"C:\\Documents\\Shared", ItemType::Folder, overlay | 3);
+	EXPECT_EQ(overlay | 3, FindIconIndex(cachedIcons, L"C:\\Documents\\Shared", ItemType::Folder));
+}
+
+TEST_F(CachedIconsTest, SaveAndLoad)
+{
+	m_iconIndexes[{ L"C:\\Windows\\imageres.dll", 2 }] = 20;
+	m_iconIndexes[{ L"C:\\Windows\\imageres.dll", 3 }] = 30;
+	m_iconIndexes[{ L"C:\\Program\\app.exe", 0 }] = 40;
+
+	CachedIcons cachedIcons(10);
+	cachedIcons.addOrUpdateFileIcon(L"C:\\Documents\\a.txt", ItemType::File, 1,
+		IconLocation{ L"C:\\Windows\\imageres.dll", 2 });
+	cachedIcons.addOrUpdateFileIcon(L"C:\\Documents", ItemType::Folder, 2,
+		IconLocation{ L"C:\\Windows\\imageres.dll", 3 });
+	cachedIcons.addOrUpdateFileIcon(L"C:\\Program\\app.exe", ItemType::File, 3,
+		IconLocation{ L"C:\\Program\\app.exe", 0 });
+
+	// Entries without a location can't be restored, so they aren't saved.
+	cachedIcons.addOrUpdateFileIcon(L"C:\\Documents\\b.doc", ItemType::File, 4);
+	cachedIcons.addOrUpdateFileIcon(L"C:\\Pictures", ItemType::Folder, 5);
+
+	ASSERT_TRUE(cachedIcons.save(GetCacheFilePath()));
+
+	CachedIcons loadedIcons(10, GetResolver());
+	ASSERT_TRUE(loadedIcons.load(GetCacheFilePath()));
+	EXPECT_EQ(1u, loadedIcons.getNumClassEntries());
+	EXPECT_EQ(2u, loadedIcons.getNumPathEntries());
+
+	// Entries are only resolved when they're first looked up.
+	EXPECT_EQ(0, m_numResolved);
+
+	EXPECT_EQ(20, FindIconIndex(loadedIcons, L"D:\\z.txt"));
+	EXPECT_EQ(30, FindIconIndex(loadedIcons, L"C:\\Documents", ItemType::Folder));
+	EXPECT_EQ(40, FindIconIndex(loadedIcons, L"C:\\Program\\app.exe"));
+	EXPECT_EQ(std::nullopt, FindIconIndex(loadedIcons, L"C:\\Documents\\b.doc"));
+	EXPECT_EQ(std::nullopt, FindIconIndex(loadedIcons, L"C:\\Pictures", ItemType::Folder));
+	EXPECT_EQ(3, m_numResolved);
+
+	// Once resolved, the index is remembered.
+	EXPECT_EQ(20, FindIconIndex(loadedIcons, L"D:\\y.txt"));
+	EXPECT_EQ(30, FindIconIndex(loadedIcons, L"C:\\Documents", ItemType::Folder));
+	EXPECT_EQ(3, m_numResolved);
+}
+
+TEST_F(CachedIconsTest, LocationKeptWhileIconUnchanged)
+{
+	m_iconIndexes[{ L"C:\\Windows\\imageres.dll", 3 }] = 30;
+
+	CachedIcons cachedIcons(10);
+	cachedIcons.addOrUpdateFileIcon(L"C:\\Documents", ItemType::Folder, 2,
+		IconLocation{ L"C:\\Windows\\imageres.dll", 3 });
+
+	// An update with the same icon (but a different overlay) and no location
+	// keeps the location.
+	cachedIcons.addOrUpdateFileIcon(L"C:\\Documents", ItemType::Folder, (1 << 24) | 2);
+
+	// But one with a different icon doesn't.
+	cachedIcons.addOrUpdateFileIcon(L"C:\\Pictures", ItemType::Folder, 2,
+		IconLocation{ L"C:\\Windows\\imageres.dll", 3 });
+	cachedIcons.addOrUpdateFileIcon(L"C:\\Pictures", ItemType::Folder, 6);
+
+	ASSERT_TRUE(cachedIcons.save(GetCacheFilePath()));
+
+	CachedIcons loadedIcons(10, GetResolver());
+	ASSERT_TRUE(loadedIcons.load(GetCacheFilePath()));
+	EXPECT_EQ(1u, loadedIcons.getNumPathEntries());
+	EXPECT_EQ(30, FindIconIndex(loadedIcons, L"C:\\Documents", ItemType::Folder));
+}
+
+TEST_F(CachedIconsTest, UnresolvedEntriesRemoved)
+{
+	m_iconIndexes[{ L"C:\\Windows\\imageres.dll", 2 }] = 20;
+
+	CachedIcons cachedIcons(10);
+	cachedIcons.addOrUpdateFileIcon(L"C:\\Documents\\a.txt", ItemType::File, 1,
+		IconLocation{ L"C:\\Windows\\imageres.dll", 2 });
+	cachedIcons.addOrUpdateFileIcon(L"C:\\Program\\deleted.exe", ItemType::File, 3,
+		IconLocation{ L"C:\\Program\\deleted.exe", 0 });
+	ASSERT_TRUE(cachedIcons.save(GetCacheFilePath()));
+
+	CachedIcons loadedIcons(10, GetResolver());
+	ASSERT_TRUE(loadedIcons.load(GetCacheFilePath()));
+
+	EXPECT_EQ(std::nullopt, FindIconIndex(loadedIcons, L"C:\\Program\\deleted.exe"));
+	EXPECT_EQ(0u, loadedIcons.getNumPathEntries());
+
+	// The entry has been removed, so there's no further attempt to resolve
+	// it.
+	EXPECT_EQ(std::nullopt, FindIconIndex(loadedIcons, L"C:\\Program\\deleted.exe"));
+	EXPECT_EQ(1, m_numResolved);
+
+	auto statistics = loadedIcons.getStatistics();
+	EXPECT_EQ(1u, statistics.numUnresolved);
+	EXPECT_EQ(2u, statistics.numMisses);
+}
+
+TEST_F(CachedIconsTest, LoadDropsLeastRecentlyUsed)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		m_iconIndexes[{ L"C:\\Windows\\imageres.dll", i }] = i;
+	}
+
+	CachedIcons cachedIcons(10);
+
+	for (int i = 0; i < 4; i++)
+	{
+		cachedIcons.addOrUpdateFileIcon(L"C:\\Folder" + std::to_wstring(i), ItemType::Folder, i,
+			IconLocation{ L"C:\\Windows\\imageres.dll", i });
+	}
+
+	ASSERT_TRUE(cachedIcons.save(GetCacheFilePath()));
+
+	CachedIcons loadedIcons(2, GetResolver());
+	ASSERT_TRUE(loadedIcons.load(GetCacheFilePath()));
+	EXPECT_EQ(2u, loadedIcons.getNumPathEntries());
+	EXPECT_FALSE(loadedIcons.findIcon(L"C:\\Folder0", ItemType::Folder));
+	EXPECT_FALSE(loadedIcons.findIcon(L"C:\\Folder1", ItemType::Folder));
+	EXPECT_EQ(2, FindIconIndex(loadedIcons, L"C:\\Folder2", ItemType::Folder));
+	EXPECT_EQ(3, FindIconIndex(loadedIcons, L"C:\\Folder3", ItemType::Folder));
+}
+
+TEST_F(CachedIconsTest, InvalidFile)
+{
+	CachedIcons cachedIcons(10, GetResolver());
+	EXPECT_FALSE(cachedIcons.load(GetCacheFilePath()));
+
+	{
+		std::ofstream file(std::filesystem::path(GetCacheFilePath()), std::ios::binary);
+		file << "not a cache file";
+	}
+
+	EXPECT_FALSE(cachedIcons.load(GetCacheFilePath()));
+
+	// A truncated file should be rejected as a whole.
+	CachedIcons savedIcons(10);
+	savedIcons.addOrUpdateFileIcon(L"C:\\Documents", ItemType::Folder, 1,
+		IconLocation{ L"C:\\Windows\\imageres.dll", 3 });
+	savedIcons.addOrUpdateFileIcon(L"C:\\Pictures", ItemType::Folder, 2,
+		IconLocation{ L"C:\\Windows\\imageres.dll", 4 });
+	ASSERT_TRUE(savedIcons.save(GetCacheFilePath()));
+
+	std::filesystem::resize_file(GetCacheFilePath(), std::filesystem::file_size(GetCacheFilePath()) - 8);
+
+	EXPECT_FALSE(cachedIcons.load(GetCacheFilePath()));
+	EXPECT_EQ(0u, cachedIcons.getNumPathEntries());
+}
@@ -0,0 +1,375 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/ChangeJournal.h"
+#include <string>
+#include <vector>
+
+using Action = ChangeJournal::Action;
+
+namespace
+{
+	struct TraceEvent
+	{
+		Action action;
+		std::wstring fileName;
+	};
+
+	ChangeJournal::Changes ReplayTrace(const std::vector<TraceEvent> &trace, size_t maxEntries = 1000)
+	{
+		ChangeJournal changeJournal(maxEntries);
+
+		for (const auto &event : trace)
+		{
+			changeJournal.AddEvent(event.action, event.fileName);
+		}
+
+		EXPECT_EQ(trace.size(), changeJournal.GetNumEvents());
+
+		return changeJournal.TakeChanges();
+	}
+
+	void ExpectRenames(const std::vector<std::pair<std::wstring, std::wstring>> &expected,
+		const std::vector<ChangeJournal::Rename> &actual)
+	{
+		ASSERT_EQ(expected.size(), actual.size());
+
+		for (size_t i = 0; i < expected.size(); i++)
+		{
+			EXPECT_EQ(expected[i].first, actual[i].oldName);
+			EXPECT_EQ(expected[i].second, actual[i].newName);
+		}
+	}
+
+	using Names = std::vector<std::wstring>;
+}
+
+TEST(ChangeJournalTest, Empty)
+{
+	ChangeJournal changeJournal(10);
+	EXPECT_TRUE(changeJournal.IsEmpty());
+
+	auto changes = changeJournal.TakeChanges();
+	EXPECT_FALSE(changes.overflowed);
+	EXPECT_TRUE(changes.removed.empty());
+	EXPECT_TRUE(changes.renamed.empty());
+	EXPECT_TRUE(changes.modified.empty());
+	EXPECT_TRUE(changes.added.empty());
+}
+
+TEST(ChangeJournalTest, SimpleEvents)
+{
+	auto changes = ReplayTrace({
+		{ Action::Added, L"new.txt" },
+		{ Action::Modified, L"existing.txt" },
+		{ Action::Removed, L"old.txt" },
+		{ Action::RenamedOldName, L"before.txt" },
+		{ Action::RenamedNewName, L"after.txt" }
+	});
+
+	EXPECT_EQ(Names({ L"old.txt" }), changes.removed);
+	ExpectRenames({ { L"before.txt", L"after.txt" } }, changes.renamed);
+	EXPECT_EQ(Names({ L"existing.txt" }), changes.modified);
+	EXPECT_EQ(Names({ L"new.txt" }), changes.added);
+}
+
+TEST(ChangeJournalTest, AddModifyRemove)
+{
+	// A temporary file that's created, written to and deleted within a
+	// single batch shouldn't result in any changes.
+	auto changes = ReplayTrace({
+		{ Action::Added, L"temp.obj" },
+		{ Action::Modified, L"temp.obj" },
+		{ Action::Modified, L"temp.obj" },
+		{ Action::Removed, L"temp.obj" }
+	});
+
+	EXPECT_TRUE(changes.removed.empty());
+	EXPECT_TRUE(changes.renamed.empty());
+	EXPECT_TRUE(changes.modified.empty());
+	EXPECT_TRUE(changes.added.empty());
+}
+
+TEST(ChangeJournalTest, AddModify)
+{
+	auto changes = ReplayTrace({
+		{ Action::Added, L"file.txt" },
+		{ Action::Modified, L"file.txt" },
+		{ Action::Modified, L"file.txt" }
+	});
+
+	EXPECT_TRUE(changes.modified.empty());
+	EXPECT_EQ(Names({ L"file.txt" }), changes.added);
+}
+
+TEST(ChangeJournalTest, RepeatedModifications)
+{
+	auto changes = ReplayTrace({
+		{ Action::Modified, L"log.txt" },
+		{ Action::Modified, L"log.txt" },
+		{ Action::Modified, L"log.txt" }
+	});
+
+	EXPECT_EQ(Names({ L"log.txt" }), changes.modified);
+}
+
+TEST(ChangeJournalTest, ModifyRemove)
+{
+	auto changes = ReplayTrace({
+		{ Action::Modified, L"file.txt" },
+		{ Action::Removed, L"file.txt" }
+	});
+
+	EXPECT_EQ(Names({ L"file.txt" }), changes.removed);
+	EXPECT_TRUE(changes.modified.empty());
+}
+
+TEST(ChangeJournalTest, RemoveAdd)
+{
+	// An existing file that's replaced. The original item needs to be
+	// removed, since the new file could be of a different type.
+	auto changes = ReplayTrace({
+		{ Action::Removed, L"output.exe" },
+		{ Action::Added, L"output.exe" },
+		{ Action::Modified, L"output.exe" }
+	});
+
+	EXPECT_EQ(Names({ L"output.exe" }), changes.removed);
+	EXPECT_TRUE(changes.modified.empty());
+	EXPECT_EQ(Names({ L"output.exe" }), changes.added);
+}
+
+TEST(ChangeJournalTest, RenameChain)
+{
+	auto changes = ReplayTrace({
+		{ Action::RenamedOldName, L"a.txt" },
+		{ Action::RenamedNewName, L"b.txt" },
+		{ Action::RenamedOldName, L"b.txt" },
+		{ Action::RenamedNewName, L"c.txt" },
+		{ Action::Modified, L"c.txt" }
+	});
+
+	ExpectRenames({ { L"a.txt", L"c.txt" } }, changes.renamed);
+	EXPECT_EQ(Names({ L"c.txt" }), changes.modified);
+}
+
+TEST(ChangeJournalTest, RenameBack)
+{
+	auto changes = ReplayTrace({
+		{ Action::RenamedOldName, L"a.txt" },
+		{ Action::RenamedNewName, L"b.txt" },
+		{ Action::RenamedOldName, L"b.txt" },
+		{ Action::RenamedNewName, L"a.txt" }
+	});
+
+	EXPECT_TRUE(changes.renamed.empty());
+	EXPECT_TRUE(changes.added.empty());
+	EXPECT_TRUE(changes.removed.empty());
+}
+
+TEST(ChangeJournalTest, RenameRemove)
+{
+	auto changes = ReplayTrace({
+		{ Action::RenamedOldName, L"a.txt" },
+		{ Action::RenamedNewName, L"b.txt" },
+		{ Action::Removed, L"b.txt" }
+	});
+
+	// The item is removed under its original name.
+	EXPECT_EQ(Names({ L"a.txt" }), changes.removed);
+	EXPECT_TRUE(changes.renamed.empty());
+}
+
+TEST(ChangeJournalTest, AddRename)
+{
+	// The pattern used by many programs when saving: write to a
+	// temporary file, then rename it over the original.
+	auto changes = ReplayTrace({
+		{ Action::Added, L"document.tmp" },
+		{ Action::Modified, L"document.tmp" },
+		{ Action::Removed, L"document.docx" },
+		{ Action::RenamedOldName, L"document.tmp" },
+		{ Action::RenamedNewName, L"document.docx" }
+	});
+
+	EXPECT_EQ(Names({ L"document.docx" }), changes.removed);
+	EXPECT_TRUE(changes.renamed.empty());
+	EXPECT_EQ(Names({ L"document.docx" }), changes.added);
+}
+
+TEST(ChangeJournalTest, RenameOverRemoved)
+{
+	auto changes = ReplayTrace({
+		{ Action::Removed, L"target.txt" },
+		{ Action::RenamedOldName, L"source.txt" },
+		{ Action::RenamedNewName, L"target.txt" }
+	});
+
+	EXPECT_EQ(Names({ L"target.txt" }), changes.removed);
+	ExpectRenames({ { L"source.txt", L"target.txt" } }, changes.renamed);
+	EXPECT_TRUE(changes.added.empty());
+}
+
+TEST(ChangeJournalTest, Swap)
+{
+	auto changes = ReplayTrace({
+		{ Action::RenamedOldName, L"a" },
+		{ Action::RenamedNewName, L"temp" },
+		{ Action::RenamedOldName, L"b" },
+		{ Action::RenamedNewName, L"a" },
+		{ Action::RenamedOldName, L"temp" },
+		{ Action::RenamedNewName, L"b" }
+	});
+
+	ExpectRenames({ { L"a", L"b" }, { L"b", L"a" } }, changes.renamed);
+	EXPECT_TRUE(changes.added.empty());
+	EXPECT_TRUE(changes.removed.empty());
+}
+
+TEST(ChangeJournalTest, UnpairedRenames)
+{
+	// An old name without a new name means the item has gone (e.g. it was
+	// moved out of the directory). A new name without an old name means
+	// that an item has appeared.
+	auto changes = ReplayTrace({
+		{ Action::RenamedOldName, L"moved out" },
+		{ Action::Modified, L"other" },
+		{ Action::RenamedNewName, L"moved in" }
+	});
+
+	EXPECT_EQ(Names({ L"moved out" }), changes.removed);
+	EXPECT_TRUE(changes.renamed.empty());
+	EXPECT_EQ(Names({ L"other" }), changes.modified);
+	EXPECT_EQ(Names({ L"moved in" }), changes.added);
+
+	changes = ReplayTrace({
+		{ Action::RenamedOldName, L"last" }
+	});
+
+	EXPECT_EQ(Names({ L"last" }), changes.removed);
+}
+
+TEST(ChangeJournalTest, OrderOfFirstChange)
+{
+	auto changes = ReplayTrace({
+		{ Action::Added, L"c" },
+		{ Action::Added, L"a" },
+		{ Action::Added, L"b" },
+		{ Action::Modified, L"c" }
+	});
+
+	EXPECT_EQ(Names({ L"c", L"a", L"b" }), changes.added);
+}
+
+TEST(ChangeJournalTest, BuildTrace)
+{
+	// Recorded from a build directory: each object file is written to a
+	// temporary file that's renamed into place, replacing the previous
+	// object file, and intermediate files are created and deleted.
+	std::vector<TraceEvent> trace;
+	std::vector<std::wstring> names;
+
+	for (int i = 0; i < 100; i++)
+	{
+		names.push_back(L"file" + std::to_wstring(i));
+	}
+
+	for (const auto &name : names)
+	{
+		std::wstring temp = name + L".tmp";
+		std::wstring object = name + L".obj";
+		std::wstring intermediate = name + L".i";
+
+		for (const auto &fileName : { intermediate, temp })
+		{
+			trace.push_back({ Action::Added, fileName });
+			trace.push_back({ Action::Modified, fileName });
+		}
+
+		trace.push_back({ Action::Removed, intermediate });
+		trace.push_back({ Action::Removed, object });
+		trace.push_back({ Action::RenamedOldName, temp });
+		trace.push_back({ Action::RenamedNewName, object });
+		trace.push_back({ Action::Modified, L"build.log" });
+
+		auto changes = ReplayTrace(trace);
+		trace.clear();
+
+		EXPECT_EQ(Names({ object }), changes.removed);
+		EXPECT_EQ(Names({ L"build.log" }), changes.modified);
+		EXPECT_EQ(Names({ object }), changes.added);
+	}
+}
+
+TEST(ChangeJournalTest, Overflow)
+{
+	ChangeJournal changeJournal(10);
+
+	for (int i = 0; i < 11; i++)
+	{
+		changeJournal.AddEvent(Action::Added, L"file" + std::to_wstring(i));
+	}
+
+	EXPECT_FALSE(changeJournal.IsEmpty());
+
+	// Further events are ignored once the journal has overflowed.
+	changeJournal.AddEvent(Action::Removed, L"other");
+
+	auto changes = changeJournal.TakeChanges();
+	EXPECT_TRUE(changes.overflowed);
+	EXPECT_TRUE(changes.added.empty());
+	EXPECT_TRUE(changes.removed.empty());
+
+	// Taking the changes resets the journal.
+	EXPECT_TRUE(changeJournal.IsEmpty());
+	changeJournal.AddEvent(Action::Added, L"file");
+	changes = changeJournal.TakeChanges();
+	EXPECT_FALSE(changes.overflowed);
+	EXPECT_EQ(Names({ L"file" }), changes.added);
+}
+
+TEST(ChangeJournalTest, CoalescedEventsDontOverflow)
+{
+	ChangeJournal changeJournal(10);
+
+	// Many events, but only a handful of distinct items.
+	for (int i = 0; i < 10000; i++)
+	{
+		std::wstring name = L"file" + std::to_wstring(i % 5);
+		changeJournal.AddEvent(Action::Added, name);
+		changeJournal.AddEvent(Action::Modified, name);
+		changeJournal.AddEvent(Action::Removed, name);
+	}
+
+	changeJournal.AddEvent(Action::Modified, L"file0");
+
+	auto changes = changeJournal.TakeChanges();
+	EXPECT_FALSE(changes.overflowed);
+	EXPECT_EQ(Names({ L"file0" }), changes.modified);
+}
+
+TEST(ChangeJournalTest, DiffListings)
+{
+	std::vector<ChangeJournal::ListingEntry> before = {
+		{ L"unchanged", 10, 100 },
+		{ L"removed", 10, 100 },
+		{ L"resized", 10, 100 },
+		{ L"touched", 10, 100 }
+	};
+
+	std::vector<ChangeJournal::ListingEntry> after = {
+		{ L"touched", 10, 200 },
+		{ L"added", 10, 100 },
+		{ L"unchanged", 10, 100 },
+		{ L"resized", 20, 100 }
+	};
+
+	auto changes = ChangeJournal::DiffListings(before, after);
+	EXPECT_FALSE(changes.overflowed);
+	EXPECT_EQ(Names({ L"removed" }), changes.removed);
+	EXPECT_TRUE(changes.renamed.empty());
+	EXPECT_EQ(Names({ L"resized", L"touched" }), changes.modified);
+	EXPECT_EQ(Names({ L"added" }), changes.added);
+}
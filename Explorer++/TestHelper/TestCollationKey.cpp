@@ -0,0 +1,419 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/CollationKey.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	// The expected primary folding of each non-ASCII character that
+	// GenerateString() can produce. This is written out by hand (rather
+	// than using the folding functions being tested), so that any error in
+	// them will show up as a difference from the reference.
+	const std::pair<wchar_t, wchar_t> REFERENCE_PRIMARY_FOLDS[] = {
+		// Latin-1 letters with diacritics fold to their base letter.
+		{ L'\u00E9', L'e' }, { L'\u00C9', L'e' },
+		{ L'\u00F1', L'n' }, { L'\u00D1', L'n' },
+		{ L'\u00F8', L'o' }, { L'\u00D8', L'o' },
+		{ L'\u00FF', L'y' }, { L'\u0178', L'y' },
+
+		// As do those in Latin Extended-A.
+		{ L'\u010D', L'c' }, { L'\u010C', L'c' },
+		{ L'\u0142', L'l' }, { L'\u0141', L'l' },
+
+		// Letters without a base letter are only case folded.
+		{ L'\u00E6', L'\u00E6' }, { L'\u00C6', L'\u00E6' },
+		{ L'\u00DF', L'\u00DF' }, { L'\u00D7', L'\u00D7' },
+
+		// Greek.
+		{ L'\u03C3', L'\u03C3' }, { L'\u03A3', L'\u03C3' },
+
+		// Cyrillic.
+		{ L'\u0436', L'\u0436' }, { L'\u0416', L'\u0436' },
+		{ L'\u0451', L'\u0451' }, { L'\u0401', L'\u0451' }
+	};
+
+	wchar_t ReferenceFoldPrimary(wchar_t c)
+	{
+		if (c >= L'A' && c <= L'Z')
+		{
+			return static_cast<wchar_t>(c - L'A' + L'a');
+		}
+
+		for (const auto &fold : REFERENCE_PRIMARY_FOLDS)
+		{
+			if (fold.first == c)
+			{
+				return fold.second;
+			}
+		}
+
+		return c;
+	}
+
+	// A straightforward reference implementation of the natural ordering.
+	// Each string is split into tokens (single characters or runs of
+	// digits) and the token lists are then compared.
+	struct ReferenceToken
+	{
+		bool isNumber;
+		wchar_t character;
+		std::wstring digits;
+	};
+
+	std::vector<ReferenceToken> Tokenize(const std::wstring &str)
+	{
+		std::vector<ReferenceToken> tokens;
+
+		for (size_t i = 0; i < str.size();)
+		{
+			if (str[i] >= L'0' && str[i] <= L'9')
+			{
+				std::wstring digits;
+
+				while (i < str.size() && str[i] >= L'0' && str[i] <= L'9')
+				{
+					digits += str[i];
+					i++;
+				}
+
+				digits.erase(0, (std::min)(digits.find_first_not_of(L'0'), digits.size()));
+				tokens.push_back({ true, L'0', digits });
+			}
+			else
+			{
+				tokens.push_back({ false, ReferenceFoldPrimary(str[i]), L"" });
+				i++;
+			}
+		}
+
+		return tokens;
+	}
+
+	int ReferenceCompare(const std::wstring &str1, const std::wstring &str2)
+	{
+		auto tokens1 = Tokenize(str1);
+		auto tokens2 = Tokenize(str2);
+
+		for (size_t i = 0; i < tokens1.size() && i < tokens2.size(); i++)
+		{
+			const auto &token1 = tokens1[i];
+			const auto &token2 = tokens2[i];
+
+			if (token1.isNumber && token2.isNumber)
+			{
+				if (token1.digits.size() != token2.digits.size())
+				{
+					return token1.digits.size() < token2.digits.size() ? -1 : 1;
+				}
+
+				if (token1.digits != token2.digits)
+				{
+					return token1.digits < token2.digits ? -1 : 1;
+				}
+
+				continue;
+			}
+
+			if (token1.character != token2.character)
+			{
+				return token1.character < token2.character ? -1 : 1;
+			}
+		}
+
+		if (tokens1.size() != tokens2.size())
+		{
+			return tokens1.size() < tokens2.size() ? -1 : 1;
+		}
+
+		if (str1 == str2)
+		{
+			return 0;
+		}
+
+		return str1 < str2 ? -1 : 1;
+	}
+
+	int Sign(int value)
+	{
+		return (value > 0) - (value < 0);
+	}
+
+	int CompareUsingKeys(const std::wstring &str1, const std::wstring &str2)
+	{
+		return Sign(CompareCollationKeys(BuildCollationKey(str1), BuildCollationKey(str2)));
+	}
+
+	std::wstring GenerateString(std::mt19937 &generator)
+	{
+		// A small alphabet, so that strings frequently share prefixes and
+		// digit runs frequently line up.
+		const wchar_t alphabet[] = L"aAbBeE019 ._-"
+			L"\u00E9\u00C9\u00F1\u00D1\u00F8\u00D8\u00FF\u0178"
+			L"\u010D\u010C\u0142\u0141\u00E6\u00C6\u00DF\u00D7"
+			L"\u03C3\u03A3\u0436\u0416\u0451\u0401";
+		const size_t alphabetSize = (sizeof(alphabet) / sizeof(alphabet[0])) - 1;
+
+		std::uniform_int_distribution<size_t> lengthDistribution(0, 8);
+		std::uniform_int_distribution<size_t> characterDistribution(0, alphabetSize - 1);
+
+		std::wstring str;
+		size_t length = lengthDistribution(generator);
+
+		for (size_t i = 0; i < length; i++)
+		{
+			str += alphabet[characterDistribution(generator)];
+		}
+
+		return str;
+	}
+}
+
+TEST(CollationKeyTest, NumericOrder)
+{
+	EXPECT_LT(CompareUsingKeys(L"file2", L"file10"), 0);
+	EXPECT_LT(CompareUsingKeys(L"file9.txt", L"file10.txt"), 0);
+	EXPECT_LT(CompareUsingKeys(L"1", L"2"), 0);
+	EXPECT_LT(CompareUsingKeys(L"99", L"100"), 0);
+	EXPECT_GT(CompareUsingKeys(L"a100b", L"a99b"), 0);
+	EXPECT_LT(CompareUsingKeys(L"12345678901234567890", L"12345678901234567891"), 0);
+}
+
+TEST(CollationKeyTest, CaseInsensitive)
+{
+	// Strings that differ only in case are adjacent, but still have a
+	// consistent order.
+	EXPECT_LT(CompareUsingKeys(L"apple", L"Banana"), 0);
+	EXPECT_LT(CompareUsingKeys(L"Apple", L"banana"), 0);
+	EXPECT_NE(CompareUsingKeys(L"File", L"file"), 0);
+	EXPECT_GT(CompareUsingKeys(L"FILE", L"fila"), 0);
+	EXPECT_LT(CompareUsingKeys(L"\u00C9cole", L"\u00E9cole2"), 0);
+}
+
+TEST(CollationKeyTest, LeadingZeros)
+{
+	// Numbers with the same value but different numbers of leading zeros
+	// are equal at the primary level.
+	EXPECT_NE(CompareUsingKeys(L"a01", L"a1"), 0);
+	EXPECT_LT(CompareUsingKeys(L"a01", L"a2"), 0);
+	EXPECT_LT(CompareUsingKeys(L"a001b", L"a1c"), 0);
+	EXPECT_LT(CompareUsingKeys(L"a0", L"a00x"), 0);
+}
+
+TEST(CollationKeyTest, Prefixes)
+{
+	EXPECT_LT(CompareUsingKeys(L"", L"a"), 0);
+	EXPECT_LT(CompareUsingKeys(L"abc", L"abcd"), 0);
+	EXPECT_LT(CompareUsingKeys(L"file", L"file1"), 0);
+	EXPECT_EQ(0, CompareUsingKeys(L"same", L"same"));
+}
+
+TEST(CollationKeyTest, Sort)
+{
+	std::vector<std::wstring> names = { L"file10.txt", L"File2.txt", L"file1.txt", L"file01.txt",
+		L"a", L"file", L"B" };
+	std::vector<CollationKey> keys;
+
+	for (const auto &name : names)
+	{
+		keys.push_back(BuildCollationKey(name));
+	}
+
+	std::vector<size_t> order = { 0, 1, 2, 3, 4, 5, 6 };
+	std::sort(order.begin(), order.end(), [&keys] (size_t index1, size_t index2) {
+		return CompareCollationKeys(keys[index1], keys[index2]) < 0;
+	});
+
+	std::vector<std::wstring> sorted;
+
+	for (size_t index : order)
+	{
+		sorted.push_back(names[index]);
+	}
+
+	std::vector<std::wstring> expected = { L"a", L"B", L"file", L"file01.txt", L"file1.txt",
+		L"File2.txt", L"file10.txt" };
+	EXPECT_EQ(expected, sorted);
+}
+
+TEST(CollationKeyTest, MatchesReference)
+{
+	std::mt19937 generator(1234);
+
+	for (int i = 0; i < 200000; i++)
+	{
+		std::wstring str1 = GenerateString(generator);
+		std::wstring str2 = GenerateString(generator);
+
+		int expected = ReferenceCompare(str1, str2);
+
+		ASSERT_EQ(expected, CompareUsingKeys(str1, str2));
+		ASSERT_EQ(expected, Sign(NaturalCompare(str1, str2)));
+		ASSERT_EQ(-expected, CompareUsingKeys(str2, str1));
+	}
+}
+
+TEST(CollationKeyTest, FoldCase)
+{
+	EXPECT_EQ(L'a', FoldCollationCase(L'A'));
+	EXPECT_EQ(L'a', FoldCollationCase(L'a'));
+	EXPECT_EQ(L'_', FoldCollationCase(L'_'));
+	EXPECT_EQ(L'\u00E9', FoldCollationCase(L'\u00C9'));
+	EXPECT_EQ(L'\u00D7', FoldCollationCase(L'\u00D7'));
+	EXPECT_EQ(L'\u0101', FoldCollationCase(L'\u0100'));
+	EXPECT_EQ(L'\u013A', FoldCollationCase(L'\u0139'));
+	EXPECT_EQ(L'\u00FF', FoldCollationCase(L'\u0178'));
+	EXPECT_EQ(L'\u03B1', FoldCollationCase(L'\u0391'));
+	EXPECT_EQ(L'\u0436', FoldCollationCase(L'\u0416'));
+	EXPECT_EQ(L'\u0451', FoldCollationCase(L'\u0401'));
+}
+
+TEST(CollationKeyTest, FoldPrimary)
+{
+	EXPECT_EQ(L'a', FoldCollationPrimary(L'A'));
+	EXPECT_EQ(L'e', FoldCollationPrimary(L'\u00C9'));
+	EXPECT_EQ(L'e', FoldCollationPrimary(L'\u00E9'));
+	EXPECT_EQ(L'n', FoldCollationPrimary(L'\u00D1'));
+	EXPECT_EQ(L'o', FoldCollationPrimary(L'\u00F8'));
+	EXPECT_EQ(L'y', FoldCollationPrimary(L'\u00FF'));
+	EXPECT_EQ(L'y', FoldCollationPrimary(L'\u0178'));
+	EXPECT_EQ(L'c', FoldCollationPrimary(L'\u010D'));
+	EXPECT_EQ(L'l', FoldCollationPrimary(L'\u0141'));
+	EXPECT_EQ(L's', FoldCollationPrimary(L'\u0160'));
+	EXPECT_EQ(L'z', FoldCollationPrimary(L'\u017E'));
+
+	// Characters without a base letter are only case folded.
+	EXPECT_EQ(L'\u00D7', FoldCollationPrimary(L'\u00D7'));
+	EXPECT_EQ(L'\u00E6', FoldCollationPrimary(L'\u00C6'));
+	EXPECT_EQ(L'\u00DF', FoldCollationPrimary(L'\u00DF'));
+	EXPECT_EQ(L'\u0153', FoldCollationPrimary(L'\u0152'));
+	EXPECT_EQ(L'\u03B1', FoldCollationPrimary(L'\u0391'));
+}
+
+TEST(CollationKeyTest, AccentedLetters)
+{
+	std::vector<std::wstring> names = { L"zebra", L"fig", L"\u00E9clair", L"eclair", L"\u00C9clair",
+		L"ecole", L"Eclair" };
+	std::vector<CollationKey> keys;
+
+	for (const auto &name : names)
+	{
+		keys.push_back(BuildCollationKey(name));
+	}
+
+	std::vector<size_t> order = { 0, 1, 2, 3, 4, 5, 6 };
+	std::sort(order.begin(), order.end(), [&keys] (size_t index1, size_t index2) {
+		return CompareCollationKeys(keys[index1], keys[index2]) < 0;
+	});
+
+	std::vector<std::wstring> sorted;
+
+	for (size_t index : order)
+	{
+		sorted.push_back(names[index]);
+	}
+
+	// Accented names sort with their unaccented equivalents. Names that
+	// only differ by case or accents are then ordered by their original
+	// characters.
+	std::vector<std::wstring> expected = { L"Eclair", L"eclair", L"\u00C9clair", L"\u00E9clair",
+		L"ecole", L"fig", L"zebra" };
+	EXPECT_EQ(expected, sorted);
+}
+
+TEST(CollationKeyTest, Scripts)
+{
+	std::vector<std::wstring> names = { L"\u03A9\u03BC\u03AD\u03B3\u03B1", L"\u0436\u0443\u043A",
+		L"\u00C6r\u00F8", L"nut", L"\u03C3\u03B9", L"\u0141\u00F3d\u017A", L"\u0401\u043B\u043A\u0430",
+		L"\u03B1\u03BB\u03C6\u03B1", L"cider", L"\u00D1u", L"\u03A3\u03B9", L"lemon", L"\u010Caj",
+		L"\u0392\u03AE\u03C4\u03B1", L"zebra" };
+
+	std::sort(names.begin(), names.end(), [] (const std::wstring &name1, const std::wstring &name2) {
+		return CompareUsingKeys(name1, name2) < 0;
+	});
+
+	// Latin letters with diacritics sort with their base letters. Other
+	// letters sort by their lower case form, so each script is kept
+	// together.
+	std::vector<std::wstring> expected = { L"\u010Caj", L"cider", L"lemon", L"\u0141\u00F3d\u017A",
+		L"\u00D1u", L"nut", L"zebra", L"\u00C6r\u00F8", L"\u03B1\u03BB\u03C6\u03B1",
+		L"\u0392\u03AE\u03C4\u03B1", L"\u03A3\u03B9", L"\u03C3\u03B9", L"\u03A9\u03BC\u03AD\u03B3\u03B1",
+		L"\u0436\u0443\u043A", L"\u0401\u043B\u043A\u0430" };
+	EXPECT_EQ(expected, names);
+}
+
+// Compares sorting with a full natural comparison on every comparison
+// against building a collation key for each string once and sorting with
+// memcmp. Run with --gtest_also_run_disabled_tests.
+TEST(CollationKeyTest, DISABLED_SortBenchmark)
+{
+	const int NUM_ITEMS = 500000;
+
+	std::vector<std::wstring> names;
+	std::mt19937 generator(1234);
+	std::uniform_int_distribution<int> distribution(0, NUM_ITEMS * 10);
+
+	for (int i = 0; i < NUM_ITEMS; i++)
+	{
+		names.push_back(L"IMG_" + std::to_wstring(distribution(generator)) + L" (Copy " +
+			std::to_wstring(i % 7) + L").JPG");
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::wstring> comparisonSorted = names;
+	std::sort(comparisonSorted.begin(), comparisonSorted.end(), [] (const std::wstring &str1, const std::wstring &str2) {
+		return NaturalCompare(str1, str2) < 0;
+	});
+
+	auto comparisonDuration = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+
+	std::vector<CollationKey> keys;
+	keys.reserve(names.size());
+
+	for (const auto &name : names)
+	{
+		keys.push_back(BuildCollationKey(name));
+	}
+
+	auto keyDuration = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+
+	std::vector<int> order(NUM_ITEMS);
+
+	for (int i = 0; i < NUM_ITEMS; i++)
+	{
+		order[i] = i;
+	}
+
+	std::sort(order.begin(), order.end(), [&keys] (int index1, int index2) {
+		return CompareCollationKeys(keys[index1], keys[index2]) < 0;
+	});
+
+	auto sortDuration = std::chrono::steady_clock::now() - start;
+
+	for (int i = 0; i < NUM_ITEMS; i++)
+	{
+		ASSERT_EQ(comparisonSorted[i], names[order[i]]);
+	}
+
+	auto toMilliseconds = [] (auto duration) {
+		return static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+	};
+
+	printf("Items: %d\n", NUM_ITEMS);
+	printf("Natural comparison sort: %lld ms\n", toMilliseconds(comparisonDuration));
+	printf("Key building: %lld ms, key sort: %lld ms\n", toMilliseconds(keyDuration),
+		toMilliseconds(sortDuration));
+}
@@ -0,0 +1,80 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/ColorRuleSet.h"
+#include <gtest/gtest.h>
+
+namespace
+{
+	// Mirror FILE_ATTRIBUTE_HIDDEN and FILE_ATTRIBUTE_COMPRESSED.
+	const uint32_t ATTRIBUTE_HIDDEN = 0x2;
+	const uint32_t ATTRIBUTE_COMPRESSED = 0x800;
+}
+
+TEST(ColorRuleSetTest, Empty)
+{
+	ColorRuleSet colorRuleSet;
+	EXPECT_EQ(0U, colorRuleSet.GetNumRules());
+	EXPECT_EQ(std::nullopt, colorRuleSet.Classify(L"file.txt", 0));
+}
+
+TEST(ColorRuleSetTest, Pattern)
+{
+	ColorRuleSet colorRuleSet({
+		{ L"*.txt: *.log", true, 0, 0x0000FF },
+		{ L"readme*", false, 0, 0x00FF00 }
+	});
+
+	EXPECT_EQ(2U, colorRuleSet.GetNumRules());
+	EXPECT_EQ(0, colorRuleSet.Classify(L"file.txt", 0));
+	EXPECT_EQ(0, colorRuleSet.Classify(L"file.log", 0));
+	EXPECT_EQ(1, colorRuleSet.Classify(L"README.md", 0));
+	EXPECT_EQ(std::nullopt, colorRuleSet.Classify(L"file.TXT", 0));
+
+	EXPECT_EQ(0x0000FFU, colorRuleSet.GetColor(0));
+	EXPECT_EQ(0x00FF00U, colorRuleSet.GetColor(1));
+}
+
+TEST(ColorRuleSetTest, GetColorOutOfRange)
+{
+	ColorRuleSet colorRuleSet({
+		{ L"*.txt", true, 0, 0x0000FF }
+	});
+
+	// An index determined using a larger set of rules.
+	EXPECT_EQ(std::nullopt, colorRuleSet.GetColor(1));
+	EXPECT_EQ(std::nullopt, ColorRuleSet().GetColor(0));
+}
+
+TEST(ColorRuleSetTest, Attributes)
+{
+	ColorRuleSet colorRuleSet({
+		{ L"", false, ATTRIBUTE_COMPRESSED, 0x0000FF },
+		{ L"*.txt", false, ATTRIBUTE_HIDDEN, 0x00FF00 }
+	});
+
+	EXPECT_EQ(0, colorRuleSet.Classify(L"file.txt", ATTRIBUTE_COMPRESSED | ATTRIBUTE_HIDDEN));
+	EXPECT_EQ(0, colorRuleSet.Classify(L"file.png", ATTRIBUTE_COMPRESSED));
+
+	// Both the pattern and the attributes need to match.
+	EXPECT_EQ(1, colorRuleSet.Classify(L"file.txt", ATTRIBUTE_HIDDEN));
+	EXPECT_EQ(std::nullopt, colorRuleSet.Classify(L"file.png", ATTRIBUTE_HIDDEN));
+	EXPECT_EQ(std::nullopt, colorRuleSet.Classify(L"file.txt", 0));
+}
+
+TEST(ColorRuleSetTest, FirstMatchingRuleWins)
+{
+	ColorRuleSet colorRuleSet({
+		{ L"*.txt", true, 0, 1 },
+		{ L"", false, 0, 2 },
+		{ L"*.png", true, 0, 3 }
+	});
+
+	EXPECT_EQ(0, colorRuleSet.Classify(L"file.txt", 0));
+
+	// The second rule matches everything, so the third rule never applies.
+	EXPECT_EQ(1, colorRuleSet.Classify(L"file.png", 0));
+	EXPECT_EQ(1, colorRuleSet.Classify(L"file", ATTRIBUTE_HIDDEN));
+}
@@ -0,0 +1,244 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/ColumnCache.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace
+{
+	const unsigned int COLUMN_OWNER = 1;
+	const unsigned int COLUMN_TITLE = 2;
+
+	class ColumnCacheTest : public ::testing::Test
+	{
+	protected:
+
+		void SetUp() override
+		{
+			m_directory = std::filesystem::temp_directory_path()
+				/ ("ColumnCacheTest-" + std::to_string(std::hash<std::string>()(
+					::testing::UnitTest::GetInstance()->current_test_info()->name())));
+			std::filesystem::create_directories(m_directory);
+		}
+
+		void TearDown() override
+		{
+			std::error_code error;
+			std::filesystem::remove_all(m_directory, error);
+		}
+
+		std::wstring GetCacheFilePath() const
+		{
+			return (m_directory / "ColumnCache.dat").wstring();
+		}
+
+		std::filesystem::path m_directory;
+	};
+}
+
+TEST_F(ColumnCacheTest, FindInserted)
+{
+	ColumnCache cache(1024 * 1024);
+
+	cache.Insert(L"C:\\Music\\track.mp3", 1000, 5000, COLUMN_OWNER, L"owner");
+	cache.Insert(L"C:\\Music\\track.mp3", 1000, 5000, COLUMN_TITLE, L"title");
+
+	EXPECT_EQ(L"owner", cache.Find(L"C:\\Music\\track.mp3", 1000, 5000, COLUMN_OWNER));
+	EXPECT_EQ(L"title", cache.Find(L"C:\\Music\\track.mp3", 1000, 5000, COLUMN_TITLE));
+	EXPECT_EQ(std::nullopt, cache.Find(L"C:\\Music\\other.mp3", 1000, 5000, COLUMN_OWNER));
+	EXPECT_EQ(std::nullopt, cache.Find(L"C:\\Music\\track.mp3", 1000, 5000, 3));
+
+	auto statistics = cache.GetStatistics();
+	EXPECT_EQ(2u, statistics.numHits);
+	EXPECT_EQ(2u, statistics.numMisses);
+}
+
+TEST_F(ColumnCacheTest, EmptyText)
+{
+	ColumnCache cache(1024 * 1024);
+
+	// An empty value is still a valid result (e.g. a file without a title).
+	cache.Insert(L"C:\\file.txt", 1, 1, COLUMN_TITLE, L"");
+	EXPECT_EQ(L"", cache.Find(L"C:\\file.txt", 1, 1, COLUMN_TITLE));
+}
+
+TEST_F(ColumnCacheTest, ChangedFileInvalidatesEntry)
+{
+	ColumnCache cache(1024 * 1024);
+
+	cache.Insert(L"C:\\file.txt", 1000, 5000, COLUMN_TITLE, L"title");
+
+	// A different size or modification time means the file has changed.
+	EXPECT_EQ(std::nullopt, cache.Find(L"C:\\file.txt", 1001, 5000, COLUMN_TITLE));
+	EXPECT_EQ(1u, cache.GetStatistics().numInvalidated);
+
+	// The stale entry is removed.
+	EXPECT_EQ(0u, cache.GetNumEntries());
+	EXPECT_EQ(std::nullopt, cache.Find(L"C:\\file.txt", 1000, 5000, COLUMN_TITLE));
+
+	cache.Insert(L"C:\\file.txt", 1000, 5000, COLUMN_TITLE, L"title");
+	EXPECT_EQ(std::nullopt, cache.Find(L"C:\\file.txt", 1000, 5001, COLUMN_TITLE));
+	EXPECT_EQ(2u, cache.GetStatistics().numInvalidated);
+
+	// Inserting for the new identity replaces the old value.
+	cache.Insert(L"C:\\file.txt", 1000, 5000, COLUMN_TITLE, L"old title");
+	cache.Insert(L"C:\\file.txt", 2000, 6000, COLUMN_TITLE, L"new title");
+	EXPECT_EQ(1u, cache.GetNumEntries());
+	EXPECT_EQ(L"new title", cache.Find(L"C:\\file.txt", 2000, 6000, COLUMN_TITLE));
+}
+
+TEST_F(ColumnCacheTest, EvictsLeastRecentlyUsed)
+{
+	ColumnCache measure(1024 * 1024);
+	measure.Insert(L"C:\\file0.txt", 1, 1, COLUMN_TITLE, L"value");
+	size_t entrySize = measure.GetSize();
+
+	// Room for three entries of this size.
+	ColumnCache cache(entrySize * 3);
+
+	cache.Insert(L"C:\\file0.txt", 1, 1, COLUMN_TITLE, L"value");
+	cache.Insert(L"C:\\file1.txt", 1, 1, COLUMN_TITLE, L"value");
+	cache.Insert(L"C:\\file2.txt", 1, 1, COLUMN_TITLE, L"value");
+
+	// Using file0 makes file1 the least recently used entry.
+	EXPECT_NE(std::nullopt, cache.Find(L"C:\\file0.txt", 1, 1, COLUMN_TITLE));
+
+	cache.Insert(L"C:\\file3.txt", 1, 1, COLUMN_TITLE, L"value");
+
+	EXPECT_EQ(3u, cache.GetNumEntries());
+	EXPECT_LE(cache.GetSize(), entrySize * 3);
+	EXPECT_EQ(1u, cache.GetStatistics().numEvicted);
+
+	EXPECT_NE(std::nullopt, cache.Find(L"C:\\file0.txt", 1, 1, COLUMN_TITLE));
+	EXPECT_EQ(std::nullopt, cache.Find(L"C:\\file1.txt", 1, 1, COLUMN_TITLE));
+	EXPECT_NE(std::nullopt, cache.Find(L"C:\\file2.txt", 1, 1, COLUMN_TITLE));
+	EXPECT_NE(std::nullopt, cache.Find(L"C:\\file3.txt", 1, 1, COLUMN_TITLE));
+}
+
+TEST_F(ColumnCacheTest, EntryLargerThanCacheIgnored)
+{
+	ColumnCache cache(256);
+
+	cache.Insert(L"C:\\file.txt", 1, 1, COLUMN_TITLE, std::wstring(1000, 'a'));
+	EXPECT_EQ(0u, cache.GetNumEntries());
+	EXPECT_EQ(0u, cache.GetSize());
+}
+
+TEST_F(ColumnCacheTest, SaveAndLoad)
+{
+	ColumnCache cache(1024 * 1024);
+
+	for (int i = 0; i < 100; i++)
+	{
+		std::wstring path = L"C:\\Pictures\\image" + std::to_wstring(i) + L".jpg";
+		cache.Insert(path, i, i * 10, COLUMN_OWNER, L"owner" + std::to_wstring(i));
+		cache.Insert(path, i, i * 10, COLUMN_TITLE, L"title" + std::to_wstring(i));
+	}
+
+	ASSERT_TRUE(cache.Save(GetCacheFilePath()));
+
+	ColumnCache loadedCache(1024 * 1024);
+	ASSERT_TRUE(loadedCache.Load(GetCacheFilePath()));
+	EXPECT_EQ(200u, loadedCache.GetNumEntries());
+	EXPECT_EQ(cache.GetSize(), loadedCache.GetSize());
+
+	for (int i = 0; i < 100; i++)
+	{
+		std::wstring path = L"C:\\Pictures\\image" + std::to_wstring(i) + L".jpg";
+		EXPECT_EQ(L"owner" + std::to_wstring(i), loadedCache.Find(path, i, i * 10, COLUMN_OWNER));
+		EXPECT_EQ(L"title" + std::to_wstring(i), loadedCache.Find(path, i, i * 10, COLUMN_TITLE));
+	}
+
+	// Entries loaded from the file are invalidated in the same way as any
+	// other entry.
+	EXPECT_EQ(std::nullopt, loadedCache.Find(L"C:\\Pictures\\image5.jpg", 5, 51, COLUMN_TITLE));
+	EXPECT_EQ(1u, loadedCache.GetStatistics().numInvalidated);
+}
+
+TEST_F(ColumnCacheTest, SaveOverLoadedFile)
+{
+	ColumnCache cache(1024 * 1024);
+	cache.Insert(L"C:\\file1.txt", 1, 1, COLUMN_TITLE, L"title1");
+	ASSERT_TRUE(cache.Save(GetCacheFilePath()));
+
+	// The loaded entries refer to the mapped file, so they have to remain
+	// valid when that file is replaced.
+	ColumnCache loadedCache(1024 * 1024);
+	ASSERT_TRUE(loadedCache.Load(GetCacheFilePath()));
+	loadedCache.Insert(L"C:\\file2.txt", 2, 2, COLUMN_TITLE, L"title2");
+	ASSERT_TRUE(loadedCache.Save(GetCacheFilePath()));
+
+	EXPECT_EQ(L"title1", loadedCache.Find(L"C:\\file1.txt", 1, 1, COLUMN_TITLE));
+
+	ColumnCache reloadedCache(1024 * 1024);
+	ASSERT_TRUE(reloadedCache.Load(GetCacheFilePath()));
+	EXPECT_EQ(L"title1", reloadedCache.Find(L"C:\\file1.txt", 1, 1, COLUMN_TITLE));
+	EXPECT_EQ(L"title2", reloadedCache.Find(L"C:\\file2.txt", 2, 2, COLUMN_TITLE));
+}
+
+TEST_F(ColumnCacheTest, LoadKeepsMostRecentlyUsed)
+{
+	ColumnCache measure(1024 * 1024);
+	measure.Insert(L"C:\\file0.txt", 1, 1, COLUMN_TITLE, L"value");
+	size_t entrySize = measure.GetSize();
+
+	ColumnCache cache(1024 * 1024);
+
+	for (int i = 0; i < 10; i++)
+	{
+		cache.Insert(L"C:\\file" + std::to_wstring(i) + L".txt", 1, 1, COLUMN_TITLE, L"value");
+	}
+
+	cache.Find(L"C:\\file2.txt", 1, 1, COLUMN_TITLE);
+	ASSERT_TRUE(cache.Save(GetCacheFilePath()));
+
+	// If the cache is now smaller, only the most recently used entries are
+	// loaded.
+	ColumnCache smallCache(entrySize * 3);
+	ASSERT_TRUE(smallCache.Load(GetCacheFilePath()));
+	EXPECT_EQ(3u, smallCache.GetNumEntries());
+
+	EXPECT_NE(std::nullopt, smallCache.Find(L"C:\\file2.txt", 1, 1, COLUMN_TITLE));
+	EXPECT_NE(std::nullopt, smallCache.Find(L"C:\\file9.txt", 1, 1, COLUMN_TITLE));
+	EXPECT_NE(std::nullopt, smallCache.Find(L"C:\\file8.txt", 1, 1, COLUMN_TITLE));
+	EXPECT_EQ(std::nullopt, smallCache.Find(L"C:\\file7.txt", 1, 1, COLUMN_TITLE));
+}
+
+TEST_F(ColumnCacheTest, LoadInvalidFile)
+{
+	ColumnCache cache(1024 * 1024);
+
+	EXPECT_FALSE(cache.Load(GetCacheFilePath()));
+
+	{
+		std::ofstream file(std::filesystem::path(GetCacheFilePath()), std::ios::binary);
+		file << "not a cache file";
+	}
+
+	EXPECT_FALSE(cache.Load(GetCacheFilePath()));
+	EXPECT_EQ(0u, cache.GetNumEntries());
+}
+
+TEST_F(ColumnCacheTest, LoadTruncatedFile)
+{
+	ColumnCache cache(1024 * 1024);
+
+	for (int i = 0; i < 10; i++)
+	{
+		cache.Insert(L"C:\\file" + std::to_wstring(i) + L".txt", 1, 1, COLUMN_TITLE, L"value");
+	}
+
+	ASSERT_TRUE(cache.Save(GetCacheFilePath()));
+
+	auto size = std::filesystem::file_size(GetCacheFilePath());
+	std::filesystem::resize_file(GetCacheFilePath(), size - 4);
+
+	// A truncated file is rejected entirely.
+	ColumnCache loadedCache(1024 * 1024);
+	EXPECT_FALSE(loadedCache.Load(GetCacheFilePath()));
+	EXPECT_EQ(0u, loadedCache.GetNumEntries());
+}
@@ -0,0 +1,465 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/CompiledWildcard.h"
+#include <chrono>
+#include <cwctype>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+	bool ReferenceWildcardMatch(const wchar_t *wildcard, const wchar_t *str, bool caseSensitive);
+
+	bool CharactersMatch(wchar_t c1, wchar_t c2, bool caseSensitive)
+	{
+		if (caseSensitive)
+		{
+			return c1 == c2;
+		}
+
+		return std::towlower(static_cast<std::wint_t>(c1)) == std::towlower(static_cast<std::wint_t>(c2));
+	}
+
+	// A copy of the matching performed by CheckWildcardMatchInternal (in
+	// StringHelper.cpp), which is what CompiledWildcard replaces. Note that
+	// the recursive calls go through ReferenceWildcardMatch, so the rest of
+	// the pattern is split on ':' again, exactly as in the original.
+	bool ReferenceSingleWildcardMatch(const wchar_t *wildcard, const wchar_t *str, bool caseSensitive)
+	{
+		bool currentMatch = true;
+
+		while (*wildcard != '\0' && *str != '\0' && currentMatch)
+		{
+			switch (*wildcard)
+			{
+			case '*':
+			{
+				bool matched = false;
+
+				if (*(wildcard + 1) != '\0')
+				{
+					matched = ReferenceWildcardMatch(++wildcard, str, caseSensitive);
+				}
+
+				while (*wildcard != '\0' && *str != '\0' && !matched)
+				{
+					matched = ReferenceWildcardMatch(wildcard, ++str, caseSensitive);
+				}
+
+				if (matched)
+				{
+					while (*wildcard != '\0')
+					{
+						wildcard++;
+					}
+
+					wildcard--;
+
+					while (*str != '\0')
+					{
+						str++;
+					}
+				}
+
+				currentMatch = matched;
+			}
+			break;
+
+			case '?':
+				str++;
+				break;
+
+			default:
+				currentMatch = CharactersMatch(*wildcard, *str, caseSensitive);
+				str++;
+				break;
+			}
+
+			wildcard++;
+		}
+
+		while (*wildcard == '*')
+		{
+			wildcard++;
+		}
+
+		return *wildcard == '\0' && *str == '\0' && currentMatch;
+	}
+
+	// A copy of CheckWildcardMatch (in StringHelper.cpp). Patterns containing
+	// ':' are split into subpatterns (skipping empty ones, as wcstok does),
+	// with the leading and trailing spaces removed from each.
+	bool ReferenceWildcardMatch(const wchar_t *wildcard, const wchar_t *str, bool caseSensitive)
+	{
+		std::wstring_view pattern(wildcard);
+
+		if (pattern.find(':') == std::wstring_view::npos)
+		{
+			return ReferenceSingleWildcardMatch(wildcard, str, caseSensitive);
+		}
+
+		size_t start = 0;
+
+		while (start < pattern.size())
+		{
+			size_t end = pattern.find(':', start);
+
+			if (end == std::wstring_view::npos)
+			{
+				end = pattern.size();
+			}
+
+			if (end > start)
+			{
+				std::wstring_view subpattern = pattern.substr(start, end - start);
+				size_t first = subpattern.find_first_not_of(' ');
+				size_t last = subpattern.find_last_not_of(' ');
+				std::wstring trimmed;
+
+				if (first != std::wstring_view::npos)
+				{
+					trimmed = subpattern.substr(first, last - first + 1);
+				}
+
+				if (ReferenceSingleWildcardMatch(trimmed.c_str(), str, caseSensitive))
+				{
+					return true;
+				}
+			}
+
+			start = end + 1;
+		}
+
+		return false;
+	}
+
+	std::wstring GenerateString(std::mt19937 &generator, std::wstring_view alphabet, size_t maxLength)
+	{
+		std::uniform_int_distribution<size_t> lengthDistribution(0, maxLength);
+		std::uniform_int_distribution<size_t> characterDistribution(0, alphabet.size() - 1);
+
+		std::wstring str(lengthDistribution(generator), L' ');
+
+		for (wchar_t &c : str)
+		{
+			c = alphabet[characterDistribution(generator)];
+		}
+
+		return str;
+	}
+
+	// Checks that each string is matched in the same way that
+	// CheckWildcardMatch matches it (using the copy above).
+	void CheckAgainstReference(const std::wstring &pattern, const std::vector<std::wstring> &strings,
+		bool caseSensitive)
+	{
+		CompiledWildcard compiledWildcard(pattern, caseSensitive);
+
+		for (const std::wstring &str : strings)
+		{
+			bool expected = ReferenceWildcardMatch(pattern.c_str(), str.c_str(), caseSensitive);
+			ASSERT_EQ(expected, compiledWildcard.Match(str)) << L"Pattern: \"" << pattern << L"\", string: \"" << str
+				<< L"\", case sensitive: " << caseSensitive;
+		}
+	}
+}
+
+TEST(CompiledWildcardTest, ExactMatches)
+{
+	CompiledWildcard compiledWildcard(L"readme.txt", true);
+	EXPECT_TRUE(compiledWildcard.Match(L"readme.txt"));
+	EXPECT_FALSE(compiledWildcard.Match(L"README.txt"));
+	EXPECT_FALSE(compiledWildcard.Match(L"readme.txt2"));
+	EXPECT_FALSE(compiledWildcard.Match(L""));
+
+	// An empty pattern only matches an empty string.
+	CompiledWildcard empty(L"", true);
+	EXPECT_TRUE(empty.Match(L""));
+	EXPECT_FALSE(empty.Match(L"a"));
+}
+
+TEST(CompiledWildcardTest, Prefixes)
+{
+	CompiledWildcard compiledWildcard(L"file*: data**", true);
+	EXPECT_TRUE(compiledWildcard.Match(L"file"));
+	EXPECT_TRUE(compiledWildcard.Match(L"file1.txt"));
+	EXPECT_TRUE(compiledWildcard.Match(L"database"));
+	EXPECT_FALSE(compiledWildcard.Match(L"fil"));
+	EXPECT_FALSE(compiledWildcard.Match(L"myfile"));
+}
+
+TEST(CompiledWildcardTest, Suffixes)
+{
+	CompiledWildcard compiledWildcard(L"*.h:*.cpp:*.txt:**_backup", true);
+	EXPECT_TRUE(compiledWildcard.Match(L"main.cpp"));
+	EXPECT_TRUE(compiledWildcard.Match(L"main.h"));
+	EXPECT_TRUE(compiledWildcard.Match(L"notes.txt"));
+	EXPECT_TRUE(compiledWildcard.Match(L".txt"));
+	EXPECT_TRUE(compiledWildcard.Match(L"archive.tar.txt"));
+	EXPECT_TRUE(compiledWildcard.Match(L"data_backup"));
+	EXPECT_FALSE(compiledWildcard.Match(L"main.c"));
+	EXPECT_FALSE(compiledWildcard.Match(L"main.hpp"));
+	EXPECT_FALSE(compiledWildcard.Match(L"txt"));
+}
+
+TEST(CompiledWildcardTest, Globs)
+{
+	CompiledWildcard compiledWildcard(L"?ab*cd.tx?", true);
+	EXPECT_TRUE(compiledWildcard.Match(L"1abefghcd.txt"));
+	EXPECT_TRUE(compiledWildcard.Match(L"1abcd.txt"));
+	EXPECT_FALSE(compiledWildcard.Match(L"abcd.txt"));
+	EXPECT_FALSE(compiledWildcard.Match(L"1abcd.tx"));
+
+	// The segments can't overlap.
+	CompiledWildcard overlapping(L"ab*ba", true);
+	EXPECT_TRUE(overlapping.Match(L"abba"));
+	EXPECT_FALSE(overlapping.Match(L"aba"));
+
+	CompiledWildcard floating(L"*a?c*b?d*", true);
+	EXPECT_TRUE(floating.Match(L"aabcbbd"));
+	EXPECT_TRUE(floating.Match(L"xaxcxbxdx"));
+	EXPECT_FALSE(floating.Match(L"bxdaxc"));
+
+	CompiledWildcard anyCharacters(L"???", true);
+	EXPECT_TRUE(anyCharacters.Match(L"abc"));
+	EXPECT_FALSE(anyCharacters.Match(L"ab"));
+	EXPECT_FALSE(anyCharacters.Match(L"abcd"));
+}
+
+TEST(CompiledWildcardTest, MatchesEverything)
+{
+	CompiledWildcard compiledWildcard(L"**", true);
+	EXPECT_TRUE(compiledWildcard.Match(L""));
+	EXPECT_TRUE(compiledWildcard.Match(L"anything"));
+}
+
+TEST(CompiledWildcardTest, MultiplePatterns)
+{
+	// Blanks around each pattern are removed, while empty patterns are
+	// skipped.
+	CompiledWildcard compiledWildcard(L" *.h ::  *.cpp:", true);
+	EXPECT_TRUE(compiledWildcard.Match(L"main.h"));
+	EXPECT_TRUE(compiledWildcard.Match(L"main.cpp"));
+	EXPECT_FALSE(compiledWildcard.Match(L""));
+	EXPECT_FALSE(compiledWildcard.Match(L"main.h "));
+
+	// Blanks are only removed when there are multiple patterns.
+	CompiledWildcard single(L" *.h", true);
+	EXPECT_TRUE(single.Match(L" main.h"));
+	EXPECT_FALSE(single.Match(L"main.h"));
+
+	CompiledWildcard separatorsOnly(L"::", true);
+	EXPECT_FALSE(separatorsOnly.Match(L""));
+	EXPECT_FALSE(separatorsOnly.Match(L"a"));
+}
+
+TEST(CompiledWildcardTest, CaseInsensitive)
+{
+	CompiledWildcard compiledWildcard(L"*.TXT:Read*:*Ab?D*", false);
+	EXPECT_TRUE(compiledWildcard.Match(L"notes.txt"));
+	EXPECT_TRUE(compiledWildcard.Match(L"README"));
+	EXPECT_TRUE(compiledWildcard.Match(L"xaBcdx"));
+	EXPECT_FALSE(compiledWildcard.Match(L"notes.tx"));
+
+	// Long strings are case-folded on the heap.
+	EXPECT_TRUE(compiledWildcard.Match(std::wstring(1000, L'A') + L".Txt"));
+
+	CompiledWildcard caseSensitive(L"*.TXT", true);
+	EXPECT_FALSE(caseSensitive.Match(L"notes.txt"));
+}
+
+TEST(CompiledWildcardTest, MatchesReference)
+{
+	std::vector<std::wstring> patterns = { L"*.txt", L"?.txt", L"?ab*cd.tx?", L"Test?1*txt", L"*", L"",
+		L"a*b*a", L"*a*", L"**a", L"a**", L"?*?", L"*?*.txt", L"*.h: *.cpp", L": *.h :", L" : ",
+		L"A*: *B" };
+	std::vector<std::wstring> strings = { L"", L"a", L"b", L"ab", L"aba", L"Test.txt", L"1.txt",
+		L"1abefghcd.txt", L"Test11test.txt", L"main.h", L"main.cpp", L"AAB", L"xyz", L" " };
+
+	for (const auto &pattern : patterns)
+	{
+		CheckAgainstReference(pattern, strings, true);
+		CheckAgainstReference(pattern, strings, false);
+	}
+}
+
+// A differential test against (a copy of) CheckWildcardMatch. The alphabets are kept
+// small, so that patterns and strings have a reasonable chance of matching.
+TEST(CompiledWildcardTest, Fuzz)
+{
+	const int NUM_PATTERNS = 5000;
+	const int NUM_STRINGS_PER_PATTERN = 20;
+
+	std::mt19937 generator(1234);
+
+	for (int i = 0; i < NUM_PATTERNS; i++)
+	{
+		std::wstring pattern = GenerateString(generator, L"abA.*?: ", 10);
+
+		std::vector<std::wstring> strings;
+
+		for (int j = 0; j < NUM_STRINGS_PER_PATTERN; j++)
+		{
+			strings.push_back(GenerateString(generator, L"abAB. ", 12));
+		}
+
+		CheckAgainstReference(pattern, strings, true);
+		CheckAgainstReference(pattern, strings, false);
+
+		if (HasFatalFailure())
+		{
+			return;
+		}
+	}
+}
+
+TEST(CompiledWildcardTest, Narrows)
+{
+	auto narrows = [] (const wchar_t *pattern, const wchar_t *previousPattern, bool caseSensitive = true,
+		bool previousCaseSensitive = true) {
+		return CompiledWildcard(pattern, caseSensitive).Narrows(
+			CompiledWildcard(previousPattern, previousCaseSensitive));
+	};
+
+	EXPECT_TRUE(narrows(L"*abcd*", L"*abc*"));
+	EXPECT_TRUE(narrows(L"*abc*", L"*abc*"));
+	EXPECT_TRUE(narrows(L"*ab*cd", L"*cd"));
+	EXPECT_TRUE(narrows(L"a?c", L"a?c"));
+	EXPECT_TRUE(narrows(L"abc", L"a?c"));
+	EXPECT_TRUE(narrows(L"file.txt", L"*"));
+	EXPECT_TRUE(narrows(L"*.txt", L"*.txt: *.log"));
+	EXPECT_TRUE(narrows(L"*.txt: *.log", L"*.log: *.txt"));
+
+	EXPECT_FALSE(narrows(L"*abc*", L"*abcd*"));
+	EXPECT_FALSE(narrows(L"*.tx", L"*.t"));
+	EXPECT_FALSE(narrows(L"abcd", L"abc"));
+	EXPECT_FALSE(narrows(L"a*c", L"a?c"));
+	EXPECT_FALSE(narrows(L"*", L"file.txt"));
+	EXPECT_FALSE(narrows(L"*.txt: *.log", L"*.txt"));
+
+	// A case-insensitive pattern never narrows a case-sensitive one, though
+	// the reverse can apply.
+	EXPECT_TRUE(narrows(L"*ABCD*", L"*abc*", false, false));
+	EXPECT_TRUE(narrows(L"*ABCD*", L"*abc*", true, false));
+	EXPECT_FALSE(narrows(L"*abcd*", L"*abc*", false, true));
+	EXPECT_FALSE(narrows(L"*ABCD*", L"*abc*", true, true));
+}
+
+// If one pattern narrows another, any string matched by the first pattern
+// must also be matched by the second.
+TEST(CompiledWildcardTest, NarrowsFuzz)
+{
+	const int NUM_PATTERNS = 5000;
+	const int NUM_STRINGS_PER_PATTERN = 50;
+
+	std::mt19937 generator(5678);
+	std::uniform_int_distribution<size_t> positionDistribution;
+	int numNarrowing = 0;
+
+	for (int i = 0; i < NUM_PATTERNS; i++)
+	{
+		std::wstring previousPattern = GenerateString(generator, L"abA*?:", 6);
+		std::wstring insertion = GenerateString(generator, L"abA*?", 3);
+
+		// Inserting characters into the previous pattern will frequently
+		// result in a narrower pattern.
+		std::wstring pattern = previousPattern;
+		pattern.insert(positionDistribution(generator) % (pattern.size() + 1), insertion);
+
+		for (bool caseSensitive : { true, false })
+		{
+			for (bool previousCaseSensitive : { true, false })
+			{
+				CompiledWildcard compiledWildcard(pattern, caseSensitive);
+				CompiledWildcard previousCompiledWildcard(previousPattern, previousCaseSensitive);
+
+				if (!compiledWildcard.Narrows(previousCompiledWildcard))
+				{
+					continue;
+				}
+
+				numNarrowing++;
+
+				for (int j = 0; j < NUM_STRINGS_PER_PATTERN; j++)
+				{
+					std::wstring str = GenerateString(generator, L"abAB", 8);
+
+					ASSERT_TRUE(!compiledWildcard.Match(str) || previousCompiledWildcard.Match(str))
+						<< L"Pattern: \"" << pattern << L"\", previous pattern: \"" << previousPattern
+						<< L"\", string: \"" << str << L"\"";
+				}
+			}
+		}
+	}
+
+	EXPECT_GT(numNarrowing, NUM_PATTERNS / 10);
+}
+
+TEST(CompiledWildcardTest, DISABLED_Benchmark)
+{
+	const int NUM_ITEMS = 200000;
+
+	std::vector<std::wstring> extensions = { L".txt", L".cpp", L".h", L".png", L".jpg", L".docx", L".zip",
+		L".exe" };
+
+	std::mt19937 generator(42);
+	std::vector<std::wstring> fileNames;
+	fileNames.reserve(NUM_ITEMS);
+
+	for (int i = 0; i < NUM_ITEMS; i++)
+	{
+		fileNames.push_back(GenerateString(generator, L"abcdefghijklmnopqrstuvwxyz_ 0123456789", 24)
+			+ extensions[i % extensions.size()]);
+	}
+
+	std::vector<std::string> patterns = { "*.txt", "*.h: *.cpp: *.hpp: *.c", "report*",
+		"*a?c*.t*", "*.PNG: *.JPG: *.GIF: *.BMP: *.TIFF: *.WEBP" };
+
+	auto toMilliseconds = [] (auto duration) {
+		return static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+	};
+
+	for (const auto &narrowPattern : patterns)
+	{
+		std::wstring pattern(narrowPattern.begin(), narrowPattern.end());
+
+		for (bool caseSensitive : { true, false })
+		{
+			size_t referenceMatches = 0;
+			auto start = std::chrono::steady_clock::now();
+
+			for (const auto &fileName : fileNames)
+			{
+				referenceMatches += ReferenceWildcardMatch(pattern.c_str(), fileName.c_str(), caseSensitive) ? 1 : 0;
+			}
+
+			auto referenceDuration = std::chrono::steady_clock::now() - start;
+
+			size_t compiledMatches = 0;
+			start = std::chrono::steady_clock::now();
+
+			CompiledWildcard compiledWildcard(pattern, caseSensitive);
+
+			for (const auto &fileName : fileNames)
+			{
+				compiledMatches += compiledWildcard.Match(fileName) ? 1 : 0;
+			}
+
+			auto compiledDuration = std::chrono::steady_clock::now() - start;
+
+			std::cout << "\"" << narrowPattern << "\" ("
+				<< (caseSensitive ? "case sensitive" : "case insensitive") << "), " << NUM_ITEMS << " items: "
+				<< "CheckWildcardMatch " << toMilliseconds(referenceDuration) << " ms, "
+				<< "CompiledWildcard " << toMilliseconds(compiledDuration) << " ms, "
+				<< compiledMatches << " matches\n";
+
+			EXPECT_EQ(referenceMatches, compiledMatches);
+		}
+	}
+}
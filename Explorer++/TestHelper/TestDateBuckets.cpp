@@ -0,0 +1,579 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/DateBuckets.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+using Bucket = DateBuckets::Bucket;
+using Date = DateBuckets::Date;
+
+namespace
+{
+	const int64_t TICKS_PER_MINUTE = 60LL * 10000000LL;
+	const int64_t TICKS_PER_DAY = 24LL * 60LL * TICKS_PER_MINUTE;
+
+	// The number of days between January 1, 1601 (the FILETIME epoch) and
+	// January 1, 1970.
+	const int64_t EPOCH_DIFFERENCE_DAYS = 134774;
+
+	int64_t DaysSinceUnixEpoch(const Date &date)
+	{
+		int64_t year = date.year - (date.month <= 2 ? 1 : 0);
+		int64_t era = year / 400;
+		int64_t yearOfEra = year - era * 400;
+		int64_t dayOfYear = (153 * (date.month + (date.month > 2 ? -3 : 9)) + 2) / 5 + date.day - 1;
+		int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+		return era * 146097 + dayOfEra - 719468;
+	}
+
+	int64_t DateToTicks(const Date &date)
+	{
+		return (DaysSinceUnixEpoch(date) + EPOCH_DIFFERENCE_DAYS) * TICKS_PER_DAY;
+	}
+
+	struct TransitionRule
+	{
+		int month;
+
+		// 1 - 4 for the first to fourth occurrence of the day in the month,
+		// or 5 for the last occurrence.
+		int week;
+
+		int dayOfWeek;
+
+		// The local time (before the transition) at which the transition
+		// occurs.
+		int minuteOfDay;
+	};
+
+	struct DaylightSavingRules
+	{
+		TransitionRule start;
+		TransitionRule end;
+		int offsetMinutes;
+	};
+
+	// A time zone with a fixed offset and (optionally) daylight saving time,
+	// in the style of a Windows TIME_ZONE_INFORMATION.
+	class FakeTimeZone
+	{
+	public:
+
+		FakeTimeZone(int standardOffsetMinutes, std::optional<DaylightSavingRules> daylightSavingRules = std::nullopt) :
+			m_standardOffsetMinutes(standardOffsetMinutes),
+			m_daylightSavingRules(daylightSavingRules)
+		{
+		}
+
+		int64_t UtcToLocal(uint64_t timestamp) const
+		{
+			return static_cast<int64_t>(timestamp) + GetOffsetMinutes(static_cast<int64_t>(timestamp)) * TICKS_PER_MINUTE;
+		}
+
+		Date GetLocalDate(uint64_t timestamp) const
+		{
+			int64_t localDays = UtcToLocal(timestamp) / TICKS_PER_DAY;
+			Date date = { 1601, 1, 1 };
+			return DateBuckets::AddDays(date, static_cast<int>(localDays));
+		}
+
+		uint64_t GetDayStart(const Date &date) const
+		{
+			int64_t midnight = DateToTicks(date);
+			std::optional<int64_t> dayStart;
+
+			for (int offsetMinutes : { m_standardOffsetMinutes, GetDaylightOffsetMinutes() })
+			{
+				int64_t candidate = midnight - offsetMinutes * TICKS_PER_MINUTE;
+
+				if (UtcToLocal(candidate) == midnight && (!dayStart || candidate < *dayStart))
+				{
+					dayStart = candidate;
+				}
+			}
+
+			if (!dayStart)
+			{
+				// Midnight was skipped, so the day starts when daylight
+				// saving time does.
+				return static_cast<uint64_t>(GetDaylightStart(date.year));
+			}
+
+			return static_cast<uint64_t>(*dayStart);
+		}
+
+		// Builds the buckets for the local date at the specified time.
+		DateBuckets MakeBuckets(uint64_t now) const
+		{
+			return DateBuckets(GetLocalDate(now), [this] (const Date &date) {
+				return GetDayStart(date);
+			});
+		}
+
+		int64_t GetDaylightStart(int year) const
+		{
+			return GetTransitionTime(year, m_daylightSavingRules->start) - m_standardOffsetMinutes * TICKS_PER_MINUTE;
+		}
+
+		int64_t GetDaylightEnd(int year) const
+		{
+			return GetTransitionTime(year, m_daylightSavingRules->end) - GetDaylightOffsetMinutes() * TICKS_PER_MINUTE;
+		}
+
+	private:
+
+		static int64_t GetTransitionTime(int year, const TransitionRule &rule)
+		{
+			Date first = { year, rule.month, 1 };
+			int day = 1 + (rule.dayOfWeek - DateBuckets::GetDayOfWeek(first) + 7) % 7 + (rule.week - 1) * 7;
+
+			if (DateBuckets::AddDays(first, day - 1).month != rule.month)
+			{
+				day -= 7;
+			}
+
+			return DateToTicks({ year, rule.month, day }) + rule.minuteOfDay * TICKS_PER_MINUTE;
+		}
+
+		int GetDaylightOffsetMinutes() const
+		{
+			return m_standardOffsetMinutes + (m_daylightSavingRules ? m_daylightSavingRules->offsetMinutes : 0);
+		}
+
+		int GetOffsetMinutes(int64_t timestamp) const
+		{
+			if (!m_daylightSavingRules)
+			{
+				return m_standardOffsetMinutes;
+			}
+
+			int year = DateBuckets::AddDays({ 1601, 1, 1 }, static_cast<int>(timestamp / TICKS_PER_DAY)).year;
+
+			int64_t daylightStart = GetDaylightStart(year);
+			int64_t daylightEnd = GetDaylightEnd(year);
+			bool daylight;
+
+			if (daylightStart < daylightEnd)
+			{
+				daylight = (timestamp >= daylightStart && timestamp < daylightEnd);
+			}
+			else
+			{
+				// Daylight saving time spans the end of the year.
+				daylight = (timestamp >= daylightStart || timestamp < daylightEnd);
+			}
+
+			if (daylight)
+			{
+				return GetDaylightOffsetMinutes();
+			}
+
+			return m_standardOffsetMinutes;
+		}
+
+		const int m_standardOffsetMinutes;
+		const std::optional<DaylightSavingRules> m_daylightSavingRules;
+	};
+
+	// Second Sunday in March to the first Sunday in November, at 2 AM.
+	const DaylightSavingRules US_RULES = { { 3, 2, 0, 120 }, { 11, 1, 0, 120 }, 60 };
+
+	// Starts at midnight on the first Sunday in November (so that midnight
+	// doesn't exist on that day) and ends at midnight on the third Sunday in
+	// February.
+	const DaylightSavingRules MIDNIGHT_RULES = { { 11, 1, 0, 0 }, { 2, 3, 0, 0 }, 60 };
+
+	// Mirrors the checks made when grouping by date, by converting the
+	// timestamp to a local date and comparing it to each bucket in turn.
+	Bucket ReferenceClassify(const FakeTimeZone &timeZone, const Date &today, uint64_t timestamp)
+	{
+		if (timestamp > static_cast<uint64_t>(INT64_MAX))
+		{
+			return Bucket::Unspecified;
+		}
+
+		int64_t fileDay = DaysSinceUnixEpoch(timeZone.GetLocalDate(timestamp));
+		int64_t currentDay = DaysSinceUnixEpoch(today);
+
+		if (fileDay > currentDay)
+		{
+			return Bucket::Future;
+		}
+
+		if (fileDay == currentDay)
+		{
+			return Bucket::Today;
+		}
+
+		if (fileDay == currentDay - 1)
+		{
+			return Bucket::Yesterday;
+		}
+
+		int64_t startOfWeek = currentDay - DateBuckets::GetDayOfWeek(today);
+
+		if (fileDay >= startOfWeek)
+		{
+			return Bucket::ThisWeek;
+		}
+
+		if (fileDay >= startOfWeek - 7)
+		{
+			return Bucket::LastWeek;
+		}
+
+		int64_t startOfMonth = DaysSinceUnixEpoch({ today.year, today.month, 1 });
+
+		if (fileDay >= startOfMonth)
+		{
+			return Bucket::ThisMonth;
+		}
+
+		Date lastMonth = (today.month == 1) ? Date{ today.year - 1, 12, 1 } : Date{ today.year, today.month - 1, 1 };
+
+		if (fileDay >= DaysSinceUnixEpoch(lastMonth))
+		{
+			return Bucket::LastMonth;
+		}
+
+		if (fileDay >= DaysSinceUnixEpoch({ today.year, 1, 1 }))
+		{
+			return Bucket::ThisYear;
+		}
+
+		if (fileDay >= DaysSinceUnixEpoch({ today.year - 1, 1, 1 }))
+		{
+			return Bucket::LastYear;
+		}
+
+		return Bucket::LongAgo;
+	}
+
+	// Compares every timestamp (at the specified interval) from the start
+	// of the year before today until a few days after today.
+	void CheckAgainstReference(const FakeTimeZone &timeZone, const DateBuckets &dateBuckets, int64_t interval)
+	{
+		const Date &today = dateBuckets.GetToday();
+		int64_t start = DateToTicks({ today.year - 1, 1, 1 }) - TICKS_PER_DAY;
+		int64_t end = DateToTicks(DateBuckets::AddDays(today, 3));
+
+		for (int64_t timestamp = start; timestamp < end; timestamp += interval)
+		{
+			ASSERT_EQ(ReferenceClassify(timeZone, today, timestamp), dateBuckets.Classify(timestamp))
+				<< "Timestamp: " << timestamp;
+		}
+	}
+
+	uint64_t LocalTime(const Date &date, int hour, int minute, int offsetMinutes)
+	{
+		return DateToTicks(date) + (hour * 60 + minute - offsetMinutes) * TICKS_PER_MINUTE;
+	}
+}
+
+TEST(DateBucketsTest, DateArithmetic)
+{
+	EXPECT_EQ(0, DateBuckets::GetDayOfWeek({ 2020, 3, 1 }));
+	EXPECT_EQ(4, DateBuckets::GetDayOfWeek({ 1970, 1, 1 }));
+	EXPECT_EQ(1, DateBuckets::GetDayOfWeek({ 1601, 1, 1 }));
+	EXPECT_EQ(6, DateBuckets::GetDayOfWeek({ 2000, 1, 1 }));
+
+	EXPECT_EQ((Date{ 2020, 2, 29 }), DateBuckets::AddDays({ 2020, 3, 1 }, -1));
+	EXPECT_EQ((Date{ 2019, 3, 1 }), DateBuckets::AddDays({ 2019, 2, 28 }, 1));
+	EXPECT_EQ((Date{ 2021, 1, 1 }), DateBuckets::AddDays({ 2020, 12, 31 }, 1));
+	EXPECT_EQ((Date{ 2020, 12, 25 }), DateBuckets::AddDays({ 2021, 1, 1 }, -7));
+}
+
+TEST(DateBucketsTest, Classify)
+{
+	FakeTimeZone utc(0);
+
+	// A Wednesday.
+	Date today = { 2021, 6, 16 };
+	DateBuckets dateBuckets = utc.MakeBuckets(LocalTime(today, 12, 0, 0));
+	EXPECT_EQ(today, dateBuckets.GetToday());
+
+	auto classify = [&dateBuckets] (const Date &date, int hour = 12, int minute = 0) {
+		return dateBuckets.Classify(LocalTime(date, hour, minute, 0));
+	};
+
+	EXPECT_EQ(Bucket::Future, classify({ 2021, 6, 17 }, 0, 0));
+	EXPECT_EQ(Bucket::Future, classify({ 2030, 1, 1 }));
+	EXPECT_EQ(Bucket::Today, classify({ 2021, 6, 16 }, 23, 59));
+	EXPECT_EQ(Bucket::Today, classify({ 2021, 6, 16 }, 0, 0));
+	EXPECT_EQ(Bucket::Yesterday, classify({ 2021, 6, 15 }, 23, 59));
+	EXPECT_EQ(Bucket::Yesterday, classify({ 2021, 6, 15 }, 0, 0));
+	EXPECT_EQ(Bucket::ThisWeek, classify({ 2021, 6, 14 }));
+	EXPECT_EQ(Bucket::ThisWeek, classify({ 2021, 6, 13 }, 0, 0));
+	EXPECT_EQ(Bucket::LastWeek, classify({ 2021, 6, 12 }, 23, 59));
+	EXPECT_EQ(Bucket::LastWeek, classify({ 2021, 6, 6 }, 0, 0));
+	EXPECT_EQ(Bucket::ThisMonth, classify({ 2021, 6, 5 }));
+	EXPECT_EQ(Bucket::ThisMonth, classify({ 2021, 6, 1 }, 0, 0));
+	EXPECT_EQ(Bucket::LastMonth, classify({ 2021, 5, 31 }, 23, 59));
+	EXPECT_EQ(Bucket::LastMonth, classify({ 2021, 5, 1 }, 0, 0));
+	EXPECT_EQ(Bucket::ThisYear, classify({ 2021, 4, 30 }));
+	EXPECT_EQ(Bucket::ThisYear, classify({ 2021, 1, 1 }, 0, 0));
+	EXPECT_EQ(Bucket::LastYear, classify({ 2020, 12, 31 }, 23, 59));
+	EXPECT_EQ(Bucket::LastYear, classify({ 2020, 1, 1 }, 0, 0));
+	EXPECT_EQ(Bucket::LongAgo, classify({ 2019, 12, 31 }, 23, 59));
+	EXPECT_EQ(Bucket::LongAgo, dateBuckets.Classify(0));
+	EXPECT_EQ(Bucket::Unspecified, dateBuckets.Classify(static_cast<uint64_t>(INT64_MAX) + 1));
+	EXPECT_EQ(Bucket::Unspecified, dateBuckets.Classify(UINT64_MAX));
+
+	CheckAgainstReference(utc, dateBuckets, 37 * TICKS_PER_MINUTE);
+}
+
+TEST(DateBucketsTest, OverlappingBuckets)
+{
+	FakeTimeZone utc(0);
+
+	// The first of the month and a Sunday, so this week, this month and
+	// today all start together.
+	DateBuckets dateBuckets = utc.MakeBuckets(LocalTime({ 2021, 8, 1 }, 9, 0, 0));
+
+	EXPECT_EQ(Bucket::Today, dateBuckets.Classify(LocalTime({ 2021, 8, 1 }, 0, 0, 0)));
+	EXPECT_EQ(Bucket::Yesterday, dateBuckets.Classify(LocalTime({ 2021, 7, 31 }, 12, 0, 0)));
+	EXPECT_EQ(Bucket::LastWeek, dateBuckets.Classify(LocalTime({ 2021, 7, 25 }, 12, 0, 0)));
+	EXPECT_EQ(Bucket::LastMonth, dateBuckets.Classify(LocalTime({ 2021, 7, 24 }, 12, 0, 0)));
+	CheckAgainstReference(utc, dateBuckets, 37 * TICKS_PER_MINUTE);
+
+	// This week started last month (and last year).
+	dateBuckets = utc.MakeBuckets(LocalTime({ 2021, 1, 1 }, 9, 0, 0));
+
+	EXPECT_EQ(Bucket::Yesterday, dateBuckets.Classify(LocalTime({ 2020, 12, 31 }, 12, 0, 0)));
+	EXPECT_EQ(Bucket::ThisWeek, dateBuckets.Classify(LocalTime({ 2020, 12, 27 }, 12, 0, 0)));
+	EXPECT_EQ(Bucket::LastWeek, dateBuckets.Classify(LocalTime({ 2020, 12, 20 }, 12, 0, 0)));
+	EXPECT_EQ(Bucket::LastMonth, dateBuckets.Classify(LocalTime({ 2020, 12, 19 }, 12, 0, 0)));
+	EXPECT_EQ(Bucket::LastYear, dateBuckets.Classify(LocalTime({ 2020, 11, 30 }, 12, 0, 0)));
+	CheckAgainstReference(utc, dateBuckets, 37 * TICKS_PER_MINUTE);
+
+	// Every day of a year, including a leap day.
+	for (Date today = { 2020, 1, 1 }; today.year == 2020; today = DateBuckets::AddDays(today, 1))
+	{
+		dateBuckets = utc.MakeBuckets(LocalTime(today, 12, 0, 0));
+		CheckAgainstReference(utc, dateBuckets, 6 * 60 * TICKS_PER_MINUTE);
+	}
+}
+
+TEST(DateBucketsTest, DaylightSavingTime)
+{
+	FakeTimeZone eastern(-300, US_RULES);
+
+	// Daylight saving time started at 2 AM on March 14, so that day was only
+	// 23 hours long.
+	uint64_t now = LocalTime({ 2021, 3, 15 }, 0, 30, -240);
+	DateBuckets dateBuckets = eastern.MakeBuckets(now);
+	EXPECT_EQ((Date{ 2021, 3, 15 }), dateBuckets.GetToday());
+
+	EXPECT_EQ(Bucket::Today, dateBuckets.Classify(LocalTime({ 2021, 3, 15 }, 0, 0, -240)));
+	EXPECT_EQ(Bucket::Yesterday, dateBuckets.Classify(LocalTime({ 2021, 3, 14 }, 23, 59, -240)));
+	EXPECT_EQ(Bucket::Yesterday, dateBuckets.Classify(LocalTime({ 2021, 3, 14 }, 0, 0, -300)));
+	EXPECT_EQ(Bucket::LastWeek, dateBuckets.Classify(LocalTime({ 2021, 3, 13 }, 23, 59, -300)));
+	CheckAgainstReference(eastern, dateBuckets, 10 * TICKS_PER_MINUTE);
+
+	// The day daylight saving time ended was 25 hours long.
+	dateBuckets = eastern.MakeBuckets(LocalTime({ 2021, 11, 8 }, 12, 0, -300));
+
+	EXPECT_EQ(Bucket::Yesterday, dateBuckets.Classify(LocalTime({ 2021, 11, 7 }, 0, 0, -240)));
+	EXPECT_EQ(Bucket::Yesterday, dateBuckets.Classify(LocalTime({ 2021, 11, 7 }, 23, 59, -300)));
+	EXPECT_EQ(Bucket::LastWeek, dateBuckets.Classify(LocalTime({ 2021, 11, 6 }, 23, 59, -240)));
+	CheckAgainstReference(eastern, dateBuckets, 10 * TICKS_PER_MINUTE);
+
+	// The first day of the week started in daylight saving time, while
+	// today is in standard time.
+	dateBuckets = eastern.MakeBuckets(LocalTime({ 2021, 11, 10 }, 12, 0, -300));
+	EXPECT_EQ(Bucket::ThisWeek, dateBuckets.Classify(LocalTime({ 2021, 11, 7 }, 0, 0, -240)));
+	EXPECT_EQ(Bucket::LastWeek, dateBuckets.Classify(LocalTime({ 2021, 11, 6 }, 23, 59, -240)));
+	CheckAgainstReference(eastern, dateBuckets, 10 * TICKS_PER_MINUTE);
+}
+
+TEST(DateBucketsTest, MidnightSkipped)
+{
+	FakeTimeZone timeZone(-180, MIDNIGHT_RULES);
+
+	Date transitionDay = { 2021, 11, 7 };
+	int64_t transition = timeZone.GetDaylightStart(2021);
+
+	// Clocks went from 23:59:59 on the 6th straight to 01:00 on the 7th.
+	EXPECT_EQ(static_cast<uint64_t>(transition), timeZone.GetDayStart(transitionDay));
+	EXPECT_EQ(transitionDay, timeZone.GetLocalDate(transition));
+	EXPECT_EQ((Date{ 2021, 11, 6 }), timeZone.GetLocalDate(transition - 1));
+
+	DateBuckets dateBuckets = timeZone.MakeBuckets(transition + 60 * TICKS_PER_MINUTE);
+	EXPECT_EQ(transitionDay, dateBuckets.GetToday());
+	EXPECT_EQ(Bucket::Today, dateBuckets.Classify(transition));
+	EXPECT_EQ(Bucket::Yesterday, dateBuckets.Classify(transition - 1));
+	CheckAgainstReference(timeZone, dateBuckets, 10 * TICKS_PER_MINUTE);
+
+	// The same, but with the transition day as yesterday.
+	dateBuckets = timeZone.MakeBuckets(transition + 25 * 60 * TICKS_PER_MINUTE);
+	EXPECT_EQ((Date{ 2021, 11, 8 }), dateBuckets.GetToday());
+	EXPECT_EQ(Bucket::Yesterday, dateBuckets.Classify(transition));
+	EXPECT_EQ(Bucket::LastWeek, dateBuckets.Classify(transition - 1));
+	CheckAgainstReference(timeZone, dateBuckets, 10 * TICKS_PER_MINUTE);
+}
+
+TEST(DateBucketsTest, TimeZones)
+{
+	// At this point in time, it's Sunday in UTC+14, but still Saturday in
+	// UTC-12.
+	uint64_t now = LocalTime({ 2021, 5, 1 }, 11, 0, 0);
+
+	FakeTimeZone lineIslands(14 * 60);
+	DateBuckets dateBuckets = lineIslands.MakeBuckets(now);
+	EXPECT_EQ((Date{ 2021, 5, 2 }), dateBuckets.GetToday());
+	EXPECT_EQ(Bucket::Today, dateBuckets.Classify(now));
+	EXPECT_EQ(Bucket::Yesterday, dateBuckets.Classify(LocalTime({ 2021, 5, 1 }, 9, 59, 0)));
+	CheckAgainstReference(lineIslands, dateBuckets, 37 * TICKS_PER_MINUTE);
+
+	FakeTimeZone bakerIsland(-12 * 60);
+	dateBuckets = bakerIsland.MakeBuckets(now);
+	EXPECT_EQ((Date{ 2021, 4, 30 }), dateBuckets.GetToday());
+	EXPECT_EQ(Bucket::Today, dateBuckets.Classify(now));
+	EXPECT_EQ(Bucket::Future, dateBuckets.Classify(LocalTime({ 2021, 5, 1 }, 12, 0, 0)));
+	CheckAgainstReference(bakerIsland, dateBuckets, 37 * TICKS_PER_MINUTE);
+
+	// A timestamp from the last few hours of the previous year in UTC is
+	// already in this year in UTC+14.
+	dateBuckets = lineIslands.MakeBuckets(LocalTime({ 2021, 1, 1 }, 12, 0, 14 * 60));
+	EXPECT_EQ(Bucket::Today, dateBuckets.Classify(LocalTime({ 2020, 12, 31 }, 11, 0, 0)));
+	EXPECT_EQ(Bucket::Yesterday, dateBuckets.Classify(LocalTime({ 2020, 12, 31 }, 9, 59, 0)));
+}
+
+TEST(DateBucketsTest, Expiry)
+{
+	FakeTimeZone eastern(-300, US_RULES);
+
+	// Tomorrow starts just after the end of daylight saving time.
+	Date today = { 2021, 11, 6 };
+	DateBuckets dateBuckets = eastern.MakeBuckets(LocalTime(today, 12, 0, -240));
+
+	uint64_t expiryTime = dateBuckets.GetExpiryTime();
+	EXPECT_EQ(eastern.GetDayStart({ 2021, 11, 7 }), expiryTime);
+	EXPECT_EQ(LocalTime({ 2021, 11, 7 }, 0, 0, -240), expiryTime);
+	EXPECT_FALSE(dateBuckets.IsExpired(expiryTime - 1));
+	EXPECT_TRUE(dateBuckets.IsExpired(expiryTime));
+
+	uint64_t timestamp = LocalTime(today, 8, 0, -240);
+	EXPECT_EQ(Bucket::Today, dateBuckets.Classify(timestamp));
+
+	// Once the buckets are rebuilt, the same timestamp should move along.
+	DateBuckets nextDateBuckets = eastern.MakeBuckets(expiryTime);
+	EXPECT_EQ((Date{ 2021, 11, 7 }), nextDateBuckets.GetToday());
+	EXPECT_EQ(Bucket::Yesterday, nextDateBuckets.Classify(timestamp));
+	EXPECT_EQ(Bucket::Today, nextDateBuckets.Classify(expiryTime));
+	EXPECT_FALSE(nextDateBuckets.IsExpired(expiryTime));
+	EXPECT_EQ(LocalTime({ 2021, 11, 8 }, 0, 0, -300), nextDateBuckets.GetExpiryTime());
+}
+
+TEST(DateBucketsTest, ClassifyBatch)
+{
+	FakeTimeZone eastern(-300, US_RULES);
+	DateBuckets dateBuckets = eastern.MakeBuckets(LocalTime({ 2021, 6, 2 }, 12, 0, -240));
+
+	std::mt19937_64 generator(1);
+	std::uniform_int_distribution<int64_t> distribution(DateToTicks({ 2019, 6, 1 }), DateToTicks({ 2021, 6, 10 }));
+
+	std::vector<uint64_t> timestamps = { 0, 1, static_cast<uint64_t>(INT64_MAX), static_cast<uint64_t>(INT64_MAX) + 1,
+		UINT64_MAX };
+
+	for (Date date : { Date{ 2021, 6, 3 }, Date{ 2021, 6, 2 }, Date{ 2021, 6, 1 }, Date{ 2021, 5, 30 },
+		Date{ 2021, 5, 23 }, Date{ 2021, 5, 1 }, Date{ 2021, 1, 1 }, Date{ 2020, 1, 1 } })
+	{
+		uint64_t dayStart = eastern.GetDayStart(date);
+		timestamps.insert(timestamps.end(), { dayStart - 1, dayStart, dayStart + 1 });
+	}
+
+	// Not a multiple of the vector width.
+	while (timestamps.size() < 1003)
+	{
+		timestamps.push_back(distribution(generator));
+	}
+
+	std::vector<Bucket> expected;
+
+	for (uint64_t timestamp : timestamps)
+	{
+		expected.push_back(dateBuckets.Classify(timestamp));
+	}
+
+	for (auto instructionSet : { PixelKernels::InstructionSet::Portable, PixelKernels::InstructionSet::Sse2,
+		PixelKernels::GetBestInstructionSet() })
+	{
+		std::vector<Bucket> buckets(timestamps.size());
+		dateBuckets.Classify(timestamps.data(), timestamps.size(), buckets.data(), instructionSet);
+		EXPECT_EQ(expected, buckets);
+	}
+}
+
+TEST(DateBucketsTest, DISABLED_Benchmark)
+{
+	const size_t NUM_ITEMS = 5000000;
+
+	FakeTimeZone eastern(-300, US_RULES);
+	uint64_t now = LocalTime({ 2021, 6, 2 }, 12, 0, -240);
+
+	std::mt19937_64 generator(1);
+	std::uniform_int_distribution<int64_t> distribution(DateToTicks({ 2015, 1, 1 }), DateToTicks({ 2021, 6, 3 }));
+
+	std::vector<uint64_t> timestamps(NUM_ITEMS);
+
+	for (auto &timestamp : timestamps)
+	{
+		timestamp = distribution(generator);
+	}
+
+	const wchar_t *headers[] = { L"Future", L"Today", L"Yesterday", L"This week", L"Last week", L"This month",
+		L"Last month", L"This year", L"Last year", L"Long ago", L"Unspecified" };
+
+	auto toMilliseconds = [] (auto duration) {
+		return static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+	};
+
+	// Each timestamp converted to a local date and compared against each
+	// bucket in turn, with the header built for each item.
+	auto start = std::chrono::steady_clock::now();
+
+	Date today = eastern.GetLocalDate(now);
+	std::vector<std::wstring> referenceHeaders(NUM_ITEMS);
+
+	for (size_t i = 0; i < NUM_ITEMS; i++)
+	{
+		referenceHeaders[i] = headers[static_cast<size_t>(ReferenceClassify(eastern, today, timestamps[i]))];
+	}
+
+	auto referenceDuration = std::chrono::steady_clock::now() - start;
+
+	std::vector<Bucket> buckets(NUM_ITEMS);
+
+	start = std::chrono::steady_clock::now();
+
+	DateBuckets dateBuckets = eastern.MakeBuckets(now);
+	dateBuckets.Classify(timestamps.data(), timestamps.size(), buckets.data(), PixelKernels::InstructionSet::Portable);
+
+	auto portableDuration = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+
+	dateBuckets = eastern.MakeBuckets(now);
+	dateBuckets.Classify(timestamps.data(), timestamps.size(), buckets.data());
+
+	auto bestDuration = std::chrono::steady_clock::now() - start;
+
+	std::cout << NUM_ITEMS << " timestamps\n"
+		<< "Per item: " << toMilliseconds(referenceDuration) << " ms\n"
+		<< "Buckets (portable): " << toMilliseconds(portableDuration) << " ms\n"
+		<< "Buckets (best instruction set): " << toMilliseconds(bestDuration) << " ms\n";
+
+	for (size_t i = 0; i < NUM_ITEMS; i++)
+	{
+		ASSERT_EQ(referenceHeaders[i], headers[static_cast<size_t>(buckets[i])]);
+	}
+}
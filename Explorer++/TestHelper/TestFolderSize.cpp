@@ -3,25 +3,25 @@
 // See LICENSE in the top level directory
 
 #include "stdafx.h"
-#include "../Helper/FolderSize.h"
+#include "../Helper/FolderSizeService.h"
 #include "../Helper/Macros.h"
 #include "Helper.h"
 
-void TestCalculateFolderSize(const TCHAR *szFolder, int nFoldersExpected,
-	int nFilesExpected, ULARGE_INTEGER ulTotalFolderSizeExpected)
+void TestCalculateFolderSize(const TCHAR *szFolder, uint64_t nFoldersExpected,
+	uint64_t nFilesExpected, ULARGE_INTEGER ulTotalFolderSizeExpected)
 {
 	TCHAR szFullFileName[MAX_PATH];
 	GetTestResourceFilePath(szFolder, szFullFileName, SIZEOF_ARRAY(szFullFileName));
 
-	int nFolders;
-	int nFiles;
-	ULARGE_INTEGER ulTotalFolderSize;
-	HRESULT hr = CalculateFolderSize(szFullFileName, &nFolders, &nFiles, &ulTotalFolderSize);
-	ASSERT_TRUE(SUCCEEDED(hr));
+	TaskExecutor executor(2);
+	FolderSizeService folderSizeService(executor, CreateFileSystemFolderReader());
 
-	EXPECT_EQ(nFoldersExpected, nFolders);
-	EXPECT_EQ(nFilesExpected, nFiles);
-	EXPECT_EQ(ulTotalFolderSizeExpected.QuadPart, ulTotalFolderSize.QuadPart);
+	auto totals = folderSizeService.CalculateSize(szFullFileName);
+	ASSERT_TRUE(totals);
+
+	EXPECT_EQ(nFoldersExpected, totals->numFolders);
+	EXPECT_EQ(nFilesExpected, totals->numFiles);
+	EXPECT_EQ(ulTotalFolderSizeExpected.QuadPart, totals->size);
 }
 
 class CalculateFolderSizeTest : public ::testing::Test
@@ -0,0 +1,546 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/FolderSizeService.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+namespace
+{
+#ifdef _WIN32
+	const std::wstring TEST_ROOT = L"C:\\Root";
+	const wchar_t SEPARATOR = L'\\';
+#else
+	const std::wstring TEST_ROOT = L"/root";
+	const wchar_t SEPARATOR = L'/';
+#endif
+
+	// Converts a path like "a/b" to a full path below the test root.
+	std::wstring MakePath(const std::wstring &relativePath = L"")
+	{
+		std::wstring path = TEST_ROOT;
+
+		if (!relativePath.empty())
+		{
+			path += SEPARATOR;
+			path += relativePath;
+			std::replace(path.begin(), path.end(), L'/', SEPARATOR);
+		}
+
+		return path;
+	}
+
+	// An in-memory folder tree.
+	class FakeFolderReader : public FolderReader
+	{
+	public:
+
+		void AddFolder(const std::wstring &relativePath)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_folders[MakePath(relativePath)];
+
+			if (relativePath.empty())
+			{
+				return;
+			}
+
+			size_t separator = relativePath.find_last_of(L'/');
+			std::wstring parent = (separator == std::wstring::npos) ? L"" : relativePath.substr(0, separator);
+			std::wstring name = relativePath.substr(separator == std::wstring::npos ? 0 : separator + 1);
+
+			auto &parentContents = m_folders[MakePath(parent)];
+			parentContents.numFolders++;
+			parentContents.subfolders.push_back(name);
+		}
+
+		void AddFiles(const std::wstring &relativePath, uint64_t numFiles, uint64_t sizeEach)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			auto &contents = m_folders[MakePath(relativePath)];
+			contents.numFiles += numFiles;
+			contents.fileSize += numFiles * sizeEach;
+		}
+
+		bool ReadFolder(const std::wstring &path, FolderContents &contents) override
+		{
+			std::function<void()> onRead;
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				m_numReads[path]++;
+				onRead = m_onRead;
+
+				auto itr = m_folders.find(path);
+
+				if (itr == m_folders.end())
+				{
+					return false;
+				}
+
+				contents = itr->second;
+			}
+
+			if (onRead)
+			{
+				onRead();
+			}
+
+			return true;
+		}
+
+		int GetNumReads(const std::wstring &relativePath = L"")
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_numReads[MakePath(relativePath)];
+		}
+
+		int GetTotalNumReads()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			int total = 0;
+
+			for (const auto &entry : m_numReads)
+			{
+				total += entry.second;
+			}
+
+			return total;
+		}
+
+		void ResetNumReads()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_numReads.clear();
+		}
+
+		// Called each time a folder is read, outside of the lock.
+		void SetOnRead(std::function<void()> onRead)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_onRead = onRead;
+		}
+
+	private:
+
+		std::mutex m_mutex;
+		std::map<std::wstring, FolderContents> m_folders;
+		std::map<std::wstring, int> m_numReads;
+		std::function<void()> m_onRead;
+	};
+
+	class FolderSizeServiceTest : public ::testing::Test
+	{
+	protected:
+
+		FolderSizeServiceTest() :
+			m_executor(4)
+		{
+			auto reader = std::make_unique<FakeFolderReader>();
+			m_reader = reader.get();
+
+			m_service = std::make_unique<FolderSizeService>(m_executor, std::move(reader));
+
+			// root
+			//   a (2 files)
+			//     c (3 files)
+			//     d (empty)
+			//   b (1 file)
+			// (4 files in root)
+			m_reader->AddFolder(L"");
+			m_reader->AddFiles(L"", 4, 10);
+			m_reader->AddFolder(L"a");
+			m_reader->AddFiles(L"a", 2, 100);
+			m_reader->AddFolder(L"a/c");
+			m_reader->AddFiles(L"a/c", 3, 1000);
+			m_reader->AddFolder(L"a/d");
+			m_reader->AddFolder(L"b");
+			m_reader->AddFiles(L"b", 1, 10000);
+		}
+
+		void ExpectTotals(const std::optional<FolderSizeTotals> &totals, uint64_t size, uint64_t numFiles,
+			uint64_t numFolders)
+		{
+			ASSERT_TRUE(totals);
+			EXPECT_EQ(size, totals->size);
+			EXPECT_EQ(numFiles, totals->numFiles);
+			EXPECT_EQ(numFolders, totals->numFolders);
+		}
+
+		TaskExecutor m_executor;
+		FakeFolderReader *m_reader;
+		std::unique_ptr<FolderSizeService> m_service;
+	};
+}
+
+TEST_F(FolderSizeServiceTest, CalculateSize)
+{
+	ExpectTotals(m_service->CalculateSize(MakePath()), 13240, 10, 4);
+	EXPECT_EQ(5, m_reader->GetTotalNumReads());
+
+	ExpectTotals(m_service->CalculateSize(MakePath(L"a")), 3200, 5, 2);
+	ExpectTotals(m_service->CalculateSize(MakePath(L"a/d")), 0, 0, 0);
+}
+
+TEST_F(FolderSizeServiceTest, UnreadableFolder)
+{
+	ExpectTotals(m_service->CalculateSize(MakePath(L"missing")), 0, 0, 0);
+}
+
+TEST_F(FolderSizeServiceTest, TrailingSeparator)
+{
+	m_service->CalculateSize(MakePath(L"a"));
+	ExpectTotals(m_service->GetCachedSize(MakePath(L"a") + SEPARATOR), 3200, 5, 2);
+}
+
+TEST_F(FolderSizeServiceTest, CachesEveryFolder)
+{
+	m_service->CalculateSize(MakePath());
+	m_reader->ResetNumReads();
+
+	// The totals for the folder and every subfolder are now cached, so
+	// nothing needs to be read again.
+	ExpectTotals(m_service->CalculateSize(MakePath()), 13240, 10, 4);
+	ExpectTotals(m_service->CalculateSize(MakePath(L"a/c")), 3000, 3, 0);
+	EXPECT_EQ(0, m_reader->GetTotalNumReads());
+	EXPECT_EQ(5u, m_service->GetNumCachedFolders());
+}
+
+TEST_F(FolderSizeServiceTest, UsesCachedSubfolders)
+{
+	m_service->CalculateSize(MakePath(L"a"));
+	m_reader->ResetNumReads();
+
+	// Only the root and b haven't been counted yet.
+	ExpectTotals(m_service->CalculateSize(MakePath()), 13240, 10, 4);
+	EXPECT_EQ(1, m_reader->GetNumReads());
+	EXPECT_EQ(1, m_reader->GetNumReads(L"b"));
+	EXPECT_EQ(0, m_reader->GetNumReads(L"a"));
+	EXPECT_EQ(2, m_reader->GetTotalNumReads());
+}
+
+TEST_F(FolderSizeServiceTest, FileChanges)
+{
+	m_service->CalculateSize(MakePath());
+
+	m_service->OnFileAdded(MakePath(L"a/c/new"), 5);
+	ExpectTotals(m_service->GetCachedSize(MakePath(L"a/c")), 3005, 4, 0);
+	ExpectTotals(m_service->GetCachedSize(MakePath(L"a")), 3205, 6, 2);
+	ExpectTotals(m_service->GetCachedSize(MakePath()), 13245, 11, 4);
+
+	// Folders that don't contain the file aren't affected.
+	ExpectTotals(m_service->GetCachedSize(MakePath(L"b")), 10000, 1, 0);
+
+	m_service->OnFileModified(MakePath(L"a/c/new"), 5, 50);
+	ExpectTotals(m_service->GetCachedSize(MakePath()), 13290, 11, 4);
+
+	m_service->OnFileRemoved(MakePath(L"a/c/new"), 50);
+	ExpectTotals(m_service->GetCachedSize(MakePath(L"a/c")), 3000, 3, 0);
+	ExpectTotals(m_service->GetCachedSize(MakePath()), 13240, 10, 4);
+}
+
+TEST_F(FolderSizeServiceTest, FileChangeWithUncachedParents)
+{
+	m_service->CalculateSize(MakePath());
+	m_service->Invalidate(MakePath(L"a/c"));
+
+	EXPECT_FALSE(m_service->GetCachedSize(MakePath(L"a")));
+	EXPECT_FALSE(m_service->GetCachedSize(MakePath()));
+
+	m_service->OnFileAdded(MakePath(L"a/d/new"), 5);
+	ExpectTotals(m_service->GetCachedSize(MakePath(L"a/d")), 5, 1, 0);
+	EXPECT_FALSE(m_service->GetCachedSize(MakePath(L"a")));
+
+	ExpectTotals(m_service->GetCachedSize(MakePath(L"b")), 10000, 1, 0);
+}
+
+TEST_F(FolderSizeServiceTest, FolderRemoved)
+{
+	m_service->CalculateSize(MakePath());
+	m_service->OnFolderRemoved(MakePath(L"a/c"));
+
+	EXPECT_FALSE(m_service->GetCachedSize(MakePath(L"a/c")));
+	ExpectTotals(m_service->GetCachedSize(MakePath(L"a")), 200, 2, 1);
+	ExpectTotals(m_service->GetCachedSize(MakePath()), 10240, 7, 3);
+
+	// Removing the folder also removes everything that was cached within it.
+	m_service->OnFolderRemoved(MakePath(L"a"));
+	EXPECT_FALSE(m_service->GetCachedSize(MakePath(L"a/d")));
+	ExpectTotals(m_service->GetCachedSize(MakePath()), 10040, 5, 1);
+}
+
+TEST_F(FolderSizeServiceTest, FolderAdded)
+{
+	m_service->CalculateSize(MakePath());
+
+	m_reader->AddFolder(L"a/e");
+	m_reader->AddFiles(L"a/e", 1, 1);
+	m_service->OnFolderAdded(MakePath(L"a/e"));
+
+	// The contents of the new folder aren't known, so its parents need to
+	// be counted again.
+	EXPECT_FALSE(m_service->GetCachedSize(MakePath(L"a")));
+	EXPECT_FALSE(m_service->GetCachedSize(MakePath()));
+	ExpectTotals(m_service->GetCachedSize(MakePath(L"a/c")), 3000, 3, 0);
+
+	m_reader->ResetNumReads();
+
+	ExpectTotals(m_service->CalculateSize(MakePath()), 13241, 11, 5);
+	EXPECT_EQ(1, m_reader->GetNumReads());
+	EXPECT_EQ(1, m_reader->GetNumReads(L"a"));
+	EXPECT_EQ(1, m_reader->GetNumReads(L"a/e"));
+	EXPECT_EQ(3, m_reader->GetTotalNumReads());
+}
+
+TEST_F(FolderSizeServiceTest, FolderRenamed)
+{
+	m_service->CalculateSize(MakePath());
+	m_service->OnFolderRenamed(MakePath(L"a"), MakePath(L"z"));
+
+	EXPECT_FALSE(m_service->GetCachedSize(MakePath(L"a")));
+	EXPECT_FALSE(m_service->GetCachedSize(MakePath(L"a/c")));
+	ExpectTotals(m_service->GetCachedSize(MakePath(L"z")), 3200, 5, 2);
+	ExpectTotals(m_service->GetCachedSize(MakePath(L"z/c")), 3000, 3, 0);
+	ExpectTotals(m_service->GetCachedSize(MakePath()), 13240, 10, 4);
+}
+
+TEST_F(FolderSizeServiceTest, FolderMoved)
+{
+	m_service->CalculateSize(MakePath());
+	m_service->OnFolderRenamed(MakePath(L"a/c"), MakePath(L"b/c"));
+
+	ExpectTotals(m_service->GetCachedSize(MakePath(L"a")), 200, 2, 1);
+	EXPECT_FALSE(m_service->GetCachedSize(MakePath(L"b")));
+	EXPECT_FALSE(m_service->GetCachedSize(MakePath()));
+}
+
+TEST_F(FolderSizeServiceTest, Invalidate)
+{
+	m_service->CalculateSize(MakePath());
+	m_service->Invalidate(MakePath(L"a"));
+
+	EXPECT_FALSE(m_service->GetCachedSize(MakePath()));
+	EXPECT_FALSE(m_service->GetCachedSize(MakePath(L"a")));
+	EXPECT_FALSE(m_service->GetCachedSize(MakePath(L"a/c")));
+	ExpectTotals(m_service->GetCachedSize(MakePath(L"b")), 10000, 1, 0);
+}
+
+TEST_F(FolderSizeServiceTest, ChangeDuringWalkIsNotCached)
+{
+	std::atomic<bool> changed = false;
+
+	m_reader->SetOnRead([this, &changed] {
+		if (!changed.exchange(true))
+		{
+			m_service->OnFileAdded(MakePath(L"b/new"), 1);
+		}
+	});
+
+	m_service->CalculateSize(MakePath());
+	m_reader->SetOnRead(nullptr);
+
+	// The totals may or may not include the change, so they can't be kept.
+	EXPECT_EQ(0u, m_service->GetNumCachedFolders());
+
+	m_service->CalculateSize(MakePath());
+	EXPECT_EQ(5u, m_service->GetNumCachedFolders());
+}
+
+TEST_F(FolderSizeServiceTest, Cancel)
+{
+	TaskGroup group(m_executor);
+	auto cancellationToken = group.GetCancellationToken();
+
+	m_reader->SetOnRead([&group] {
+		group.Cancel();
+	});
+
+	EXPECT_FALSE(m_service->CalculateSize(MakePath(), cancellationToken));
+	EXPECT_EQ(0u, m_service->GetNumCachedFolders());
+}
+
+TEST_F(FolderSizeServiceTest, Progress)
+{
+	auto reader = std::make_unique<FakeFolderReader>();
+	FakeFolderReader *readerPtr = reader.get();
+	FolderSizeService service(m_executor, std::move(reader), FolderSizeService::DEFAULT_MAX_CACHED_FOLDERS,
+		std::chrono::milliseconds(0));
+
+	readerPtr->AddFolder(L"");
+
+	for (int i = 0; i < 100; i++)
+	{
+		std::wstring name = L"folder" + std::to_wstring(i);
+		readerPtr->AddFolder(name);
+		readerPtr->AddFiles(name, 1, 10);
+	}
+
+	std::vector<FolderSizeTotals> progress;
+
+	auto totals = service.CalculateSize(MakePath(), {}, [&progress] (const FolderSizeTotals &partialTotals) {
+		progress.push_back(partialTotals);
+	});
+
+	ExpectTotals(totals, 1000, 100, 100);
+
+	ASSERT_FALSE(progress.empty());
+
+	for (size_t i = 1; i < progress.size(); i++)
+	{
+		EXPECT_GE(progress[i].numFiles, progress[i - 1].numFiles);
+	}
+
+	EXPECT_LE(progress.back().numFiles, 100u);
+}
+
+TEST_F(FolderSizeServiceTest, CacheLimit)
+{
+	auto reader = std::make_unique<FakeFolderReader>();
+	FakeFolderReader *readerPtr = reader.get();
+	FolderSizeService service(m_executor, std::move(reader), 3);
+
+	readerPtr->AddFolder(L"");
+
+	for (int i = 0; i < 10; i++)
+	{
+		readerPtr->AddFolder(L"folder" + std::to_wstring(i));
+		readerPtr->AddFiles(L"folder" + std::to_wstring(i), 1, 1);
+	}
+
+	ExpectTotals(service.CalculateSize(MakePath()), 10, 10, 10);
+	EXPECT_EQ(3u, service.GetNumCachedFolders());
+
+	// Whichever folders are still cached, the totals are the same.
+	service.Invalidate(MakePath(L"folder0"));
+	ExpectTotals(service.CalculateSize(MakePath()), 10, 10, 10);
+}
+
+TEST_F(FolderSizeServiceTest, ManyFolders)
+{
+	auto reader = std::make_unique<FakeFolderReader>();
+	FakeFolderReader *readerPtr = reader.get();
+	FolderSizeService service(m_executor, std::move(reader));
+
+	readerPtr->AddFolder(L"");
+
+	// A tree that's both wide and deep.
+	for (int i = 0; i < 20; i++)
+	{
+		std::wstring path = L"folder" + std::to_wstring(i);
+		readerPtr->AddFolder(path);
+
+		for (int j = 0; j < 50; j++)
+		{
+			path += L"/sub";
+			readerPtr->AddFolder(path);
+			readerPtr->AddFiles(path, 2, 3);
+		}
+	}
+
+	ExpectTotals(service.CalculateSize(MakePath()), 6000, 2000, 1020);
+	EXPECT_EQ(1021u, service.GetStatistics().numFoldersRead);
+}
+
+TEST(FolderSizeServiceFileSystemTest, CalculateSize)
+{
+	auto directory = std::filesystem::temp_directory_path() / "FolderSizeServiceTest";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory / "a" / "b");
+	std::filesystem::create_directories(directory / "empty");
+
+	auto writeFile = [] (const std::filesystem::path &path, size_t size) {
+		std::ofstream file(path, std::ios::binary);
+		file << std::string(size, 'x');
+	};
+
+	writeFile(directory / "1.txt", 10);
+	writeFile(directory / "a" / "2.txt", 200);
+	writeFile(directory / "a" / "b" / "3.txt", 3000);
+	writeFile(directory / "a" / "b" / "4.txt", 40000);
+
+	TaskExecutor executor(2);
+	FolderSizeService service(executor, CreateFileSystemFolderReader());
+
+	auto totals = service.CalculateSize(directory.wstring());
+	ASSERT_TRUE(totals);
+	EXPECT_EQ(43210u, totals->size);
+	EXPECT_EQ(4u, totals->numFiles);
+	EXPECT_EQ(3u, totals->numFolders);
+
+	std::filesystem::remove_all(directory);
+}
+
+// Compares a single-threaded walk of a generated tree with a parallel one,
+// as well as with a walk that's entirely cached. The tree is created in the
+// temp directory the first time this runs and reused after that.
+TEST(FolderSizeServiceFileSystemTest, DISABLED_Benchmark)
+{
+	const int NUM_TOP_LEVEL_FOLDERS = 20;
+	const int NUM_SUBFOLDERS = 50;
+	const int NUM_FILES_PER_FOLDER = 40;
+
+	auto directory = std::filesystem::temp_directory_path() / "FolderSizeServiceBenchmark";
+
+	if (!std::filesystem::exists(directory))
+	{
+		for (int i = 0; i < NUM_TOP_LEVEL_FOLDERS; i++)
+		{
+			for (int j = 0; j < NUM_SUBFOLDERS; j++)
+			{
+				auto folder = directory / std::to_string(i) / std::to_string(j);
+				std::filesystem::create_directories(folder);
+
+				for (int k = 0; k < NUM_FILES_PER_FOLDER; k++)
+				{
+					std::ofstream file(folder / (std::to_string(k) + ".dat"), std::ios::binary);
+					file << std::string(k, 'x');
+				}
+			}
+		}
+	}
+
+	auto timeCalculation = [&directory] (FolderSizeService &service) {
+		auto start = std::chrono::steady_clock::now();
+		auto totals = service.CalculateSize(directory.wstring());
+		auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - start);
+
+		EXPECT_TRUE(totals);
+		EXPECT_EQ(static_cast<uint64_t>(NUM_TOP_LEVEL_FOLDERS * NUM_SUBFOLDERS * NUM_FILES_PER_FOLDER),
+			totals->numFiles);
+
+		return duration.count();
+	};
+
+	// An executor always has at least one thread, but with a single
+	// worker, the walk is split across the worker and the caller.
+	TaskExecutor singleExecutor(1);
+	FolderSizeService singleService(singleExecutor, CreateFileSystemFolderReader(), 0);
+
+	unsigned int numThreads = (std::max)(std::thread::hardware_concurrency(), 4u);
+	TaskExecutor parallelExecutor(numThreads);
+	FolderSizeService parallelService(parallelExecutor, CreateFileSystemFolderReader());
+
+	// Warm the file system cache first, so that every walk reads from memory.
+	timeCalculation(singleService);
+
+	auto singleTime = timeCalculation(singleService);
+	auto parallelTime = timeCalculation(parallelService);
+	auto cachedTime = timeCalculation(parallelService);
+
+	printf("2 threads: %lld us\n", static_cast<long long>(singleTime));
+	printf("%u threads: %lld us\n", numThreads + 1, static_cast<long long>(parallelTime));
+	printf("cached: %lld us\n", static_cast<long long>(cachedTime));
+}
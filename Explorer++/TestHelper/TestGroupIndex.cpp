@@ -0,0 +1,243 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/GroupIndex.h"
+#include "../Helper/ParallelSort.h"
+#include "../Helper/TaskExecutor.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <list>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// Mirrors grouping by extension.
+	std::wstring GetExtensionGroup(const std::wstring &fileName)
+	{
+		auto position = fileName.rfind(L'.');
+
+		if (position == std::wstring::npos)
+		{
+			return L"No extension";
+		}
+
+		return fileName.substr(position);
+	}
+}
+
+TEST(GroupIndexTest, AddItem)
+{
+	GroupIndex groupIndex;
+
+	auto result1 = groupIndex.AddItem(L".txt");
+	EXPECT_TRUE(result1.created);
+
+	auto result2 = groupIndex.AddItem(L".png");
+	EXPECT_TRUE(result2.created);
+	EXPECT_NE(result1.groupId, result2.groupId);
+
+	auto result3 = groupIndex.AddItem(L".txt");
+	EXPECT_FALSE(result3.created);
+	EXPECT_EQ(result1.groupId, result3.groupId);
+
+	EXPECT_EQ(2U, groupIndex.GetNumGroups());
+
+	const GroupIndex::Group *group = groupIndex.GetGroup(result1.groupId);
+	ASSERT_NE(nullptr, group);
+	EXPECT_EQ(L".txt", group->header);
+	EXPECT_EQ(2, group->numItems);
+
+	group = groupIndex.GetGroup(result2.groupId);
+	ASSERT_NE(nullptr, group);
+	EXPECT_EQ(L".png", group->header);
+	EXPECT_EQ(1, group->numItems);
+
+	EXPECT_EQ(nullptr, groupIndex.GetGroup(-1));
+	EXPECT_EQ(nullptr, groupIndex.GetGroup(2));
+}
+
+TEST(GroupIndexTest, FindGroup)
+{
+	GroupIndex groupIndex;
+
+	int groupId = groupIndex.AddItem(L"Today").groupId;
+
+	EXPECT_EQ(groupId, groupIndex.FindGroup(L"Today"));
+	EXPECT_EQ(std::nullopt, groupIndex.FindGroup(L"Yesterday"));
+}
+
+TEST(GroupIndexTest, RemoveItem)
+{
+	GroupIndex groupIndex;
+
+	int groupId = groupIndex.AddItem(L"A").groupId;
+	groupIndex.AddItem(L"A");
+	groupIndex.RemoveItem(groupId);
+	EXPECT_EQ(1, groupIndex.GetGroup(groupId)->numItems);
+
+	// Empty groups are kept, so the ID should be the same when the group is
+	// used again.
+	groupIndex.RemoveItem(groupId);
+	EXPECT_EQ(0, groupIndex.GetGroup(groupId)->numItems);
+	EXPECT_EQ(groupId, groupIndex.FindGroup(L"A"));
+
+	auto result = groupIndex.AddItem(L"A");
+	EXPECT_EQ(groupId, result.groupId);
+	EXPECT_FALSE(result.created);
+	EXPECT_EQ(1, groupIndex.GetGroup(groupId)->numItems);
+}
+
+TEST(GroupIndexTest, ChangedGroups)
+{
+	GroupIndex groupIndex;
+
+	int groupIdA = groupIndex.AddItem(L"A").groupId;
+	int groupIdB = groupIndex.AddItem(L"B").groupId;
+	groupIndex.AddItem(L"A");
+	groupIndex.AddItem(L"B");
+	groupIndex.AddItem(L"A");
+
+	// Each group should only be reported once, no matter how many times its
+	// count changed.
+	EXPECT_EQ((std::vector<int>{ groupIdA, groupIdB }), groupIndex.TakeChangedGroups());
+	EXPECT_TRUE(groupIndex.TakeChangedGroups().empty());
+
+	groupIndex.RemoveItem(groupIdB);
+	int groupIdC = groupIndex.AddItem(L"C").groupId;
+	groupIndex.RemoveItem(groupIdB);
+
+	EXPECT_EQ((std::vector<int>{ groupIdB, groupIdC }), groupIndex.TakeChangedGroups());
+}
+
+TEST(GroupIndexTest, Clear)
+{
+	GroupIndex groupIndex;
+
+	groupIndex.AddItem(L"A");
+	groupIndex.AddItem(L"B");
+	groupIndex.Clear();
+
+	EXPECT_EQ(0U, groupIndex.GetNumGroups());
+	EXPECT_EQ(std::nullopt, groupIndex.FindGroup(L"A"));
+	EXPECT_TRUE(groupIndex.TakeChangedGroups().empty());
+
+	// IDs are allocated from 0 again.
+	auto result = groupIndex.AddItem(L"B");
+	EXPECT_EQ(0, result.groupId);
+	EXPECT_TRUE(result.created);
+}
+
+TEST(GroupIndexTest, FormatHeader)
+{
+	EXPECT_EQ(L"Folders (12)", GroupIndex::FormatHeader(L"Folders", 12));
+}
+
+TEST(GroupIndexTest, DISABLED_Benchmark)
+{
+	const int NUM_ITEMS = 200000;
+	const int NUM_EXTENSIONS = 200;
+
+	std::vector<std::wstring> fileNames;
+	fileNames.reserve(NUM_ITEMS);
+
+	for (int i = 0; i < NUM_ITEMS; i++)
+	{
+		fileNames.push_back(L"file" + std::to_wstring(i) + L".ext" + std::to_wstring(i % NUM_EXTENSIONS));
+	}
+
+	auto toMilliseconds = [] (auto duration) {
+		return static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+	};
+
+	// The previous approach: a linear search through a list of groups for
+	// each item, with the group's header rebuilt (and updated) each time an
+	// item is added.
+	struct ListGroup
+	{
+		std::wstring header;
+		int id;
+		int numItems;
+	};
+
+	std::vector<int> listGroupIds(NUM_ITEMS);
+	size_t numListHeaderUpdates = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	{
+		std::list<ListGroup> groups;
+		int nextGroupId = 0;
+
+		for (int i = 0; i < NUM_ITEMS; i++)
+		{
+			std::wstring header = GetExtensionGroup(fileNames[i]);
+
+			auto itr = std::find_if(groups.begin(), groups.end(), [&header] (const ListGroup &group) {
+				return group.header == header;
+			});
+
+			if (itr == groups.end())
+			{
+				groups.push_back({ header, nextGroupId++, 0 });
+				itr = std::prev(groups.end());
+			}
+
+			itr->numItems++;
+
+			std::wstring listViewHeader = GroupIndex::FormatHeader(itr->header, itr->numItems);
+			numListHeaderUpdates++;
+
+			listGroupIds[i] = itr->id;
+		}
+	}
+
+	auto listDuration = std::chrono::steady_clock::now() - start;
+
+	TaskExecutor executor((std::max)(2, static_cast<int>(std::thread::hardware_concurrency())));
+	std::vector<int> indexGroupIds(NUM_ITEMS);
+	size_t numIndexHeaderUpdates = 0;
+
+	start = std::chrono::steady_clock::now();
+
+	{
+		std::vector<std::wstring> headers(NUM_ITEMS);
+
+		ParallelSort::ParallelFor(executor, fileNames.size(), [&fileNames, &headers] (size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+			{
+				headers[i] = GetExtensionGroup(fileNames[i]);
+			}
+		});
+
+		GroupIndex groupIndex;
+
+		for (int i = 0; i < NUM_ITEMS; i++)
+		{
+			indexGroupIds[i] = groupIndex.AddItem(headers[i]).groupId;
+		}
+
+		for (int groupId : groupIndex.TakeChangedGroups())
+		{
+			const GroupIndex::Group *group = groupIndex.GetGroup(groupId);
+			std::wstring listViewHeader = GroupIndex::FormatHeader(group->header, group->numItems);
+			numIndexHeaderUpdates++;
+		}
+	}
+
+	auto indexDuration = std::chrono::steady_clock::now() - start;
+
+	std::cout << NUM_ITEMS << " items, " << NUM_EXTENSIONS << " groups, " << executor.GetNumThreads()
+		<< " threads\n"
+		<< "List: " << toMilliseconds(listDuration) << " ms, " << numListHeaderUpdates << " header updates\n"
+		<< "Index: " << toMilliseconds(indexDuration) << " ms, " << numIndexHeaderUpdates
+		<< " header updates\n";
+
+	EXPECT_EQ(listGroupIds, indexGroupIds);
+	EXPECT_EQ(static_cast<size_t>(NUM_EXTENSIONS), numIndexHeaderUpdates);
+}
@@ -0,0 +1,296 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/ChangeJournal.h"
+#include "../Helper/HistorySnapshotCache.h"
+#include "../Helper/ItemStore.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// Mirrors the way a folder is snapshotted: the item store is moved
+	// into the snapshot, along with the order the items were shown in.
+	struct FolderSnapshot
+	{
+		ItemStore itemStore;
+		std::vector<int> rows;
+	};
+
+	FolderSnapshot BuildFolderSnapshot(int numItems)
+	{
+		FolderSnapshot snapshot;
+
+		for (int i = 0; i < numItems; i++)
+		{
+			std::wstring fileName = L"file" + std::to_wstring(i) + L".txt";
+
+			ItemStore::FileData fileData;
+			fileData.size = i;
+			fileData.lastWriteTime = 1000 + i;
+			fileData.fileName = fileName;
+
+			snapshot.rows.push_back(snapshot.itemStore.AddItem(fileData, fileName));
+		}
+
+		return snapshot;
+	}
+
+	std::vector<ChangeJournal::ListingEntry> GetListing(const ItemStore &itemStore)
+	{
+		std::vector<ChangeJournal::ListingEntry> listing;
+
+		for (int i = 0; i < itemStore.GetIdLimit(); i++)
+		{
+			if (!itemStore.IsValidItem(i))
+			{
+				continue;
+			}
+
+			listing.push_back({ std::wstring(itemStore.GetFileName(i)), itemStore.GetSize(i),
+				itemStore.GetLastWriteTime(i) });
+		}
+
+		return listing;
+	}
+}
+
+TEST(HistorySnapshotCacheTest, InsertTake)
+{
+	HistorySnapshotCache<std::wstring> cache(4, 100);
+
+	EXPECT_TRUE(cache.Insert(1, L"first", 10));
+	EXPECT_TRUE(cache.Insert(2, L"second", 20));
+	EXPECT_EQ(2u, cache.GetNumEntries());
+	EXPECT_EQ(30u, cache.GetSize());
+	EXPECT_TRUE(cache.Contains(1));
+
+	// Taking a snapshot removes it.
+	EXPECT_EQ(L"first", cache.Take(1));
+	EXPECT_FALSE(cache.Contains(1));
+	EXPECT_EQ(std::nullopt, cache.Take(1));
+	EXPECT_EQ(1u, cache.GetNumEntries());
+	EXPECT_EQ(20u, cache.GetSize());
+
+	EXPECT_EQ(std::nullopt, cache.Take(3));
+}
+
+TEST(HistorySnapshotCacheTest, Replace)
+{
+	HistorySnapshotCache<std::wstring> cache(4, 100);
+
+	cache.Insert(1, L"old", 40);
+	cache.Insert(1, L"new", 10);
+
+	EXPECT_EQ(1u, cache.GetNumEntries());
+	EXPECT_EQ(10u, cache.GetSize());
+	EXPECT_EQ(0u, cache.GetNumEvicted());
+	EXPECT_EQ(L"new", cache.Take(1));
+}
+
+TEST(HistorySnapshotCacheTest, EvictByCount)
+{
+	HistorySnapshotCache<int> cache(3, 100);
+
+	for (int i = 0; i < 5; i++)
+	{
+		EXPECT_TRUE(cache.Insert(i, i * 10, 1));
+	}
+
+	// The snapshots inserted least recently are evicted first.
+	EXPECT_EQ(3u, cache.GetNumEntries());
+	EXPECT_EQ(3u, cache.GetSize());
+	EXPECT_EQ(2u, cache.GetNumEvicted());
+	EXPECT_FALSE(cache.Contains(0));
+	EXPECT_FALSE(cache.Contains(1));
+	EXPECT_EQ(20, cache.Take(2));
+	EXPECT_EQ(40, cache.Take(4));
+
+	// Re-inserting a snapshot makes it the most recent.
+	cache.Insert(3, 30, 1);
+	cache.Insert(5, 50, 1);
+	cache.Insert(6, 60, 1);
+	cache.Insert(3, 30, 1);
+	cache.Insert(7, 70, 1);
+	EXPECT_TRUE(cache.Contains(3));
+	EXPECT_FALSE(cache.Contains(5));
+}
+
+TEST(HistorySnapshotCacheTest, EvictBySize)
+{
+	HistorySnapshotCache<int> cache(10, 100);
+
+	cache.Insert(1, 1, 40);
+	cache.Insert(2, 2, 40);
+	EXPECT_EQ(80u, cache.GetSize());
+
+	// Both of the older snapshots need to go to make room for this one.
+	cache.Insert(3, 3, 90);
+	EXPECT_EQ(1u, cache.GetNumEntries());
+	EXPECT_EQ(90u, cache.GetSize());
+	EXPECT_EQ(2u, cache.GetNumEvicted());
+	EXPECT_TRUE(cache.Contains(3));
+
+	cache.Insert(4, 4, 10);
+	EXPECT_EQ(2u, cache.GetNumEntries());
+	EXPECT_EQ(100u, cache.GetSize());
+}
+
+TEST(HistorySnapshotCacheTest, Oversized)
+{
+	HistorySnapshotCache<int> cache(10, 100);
+
+	cache.Insert(1, 1, 50);
+
+	// A snapshot larger than the whole budget is discarded, without
+	// evicting anything.
+	EXPECT_FALSE(cache.Insert(2, 2, 101));
+	EXPECT_FALSE(cache.Contains(2));
+	EXPECT_TRUE(cache.Contains(1));
+	EXPECT_EQ(50u, cache.GetSize());
+	EXPECT_EQ(0u, cache.GetNumEvicted());
+
+	// Replacing a snapshot with one that's too large still removes the
+	// original, since it's out of date.
+	EXPECT_FALSE(cache.Insert(1, 1, 101));
+	EXPECT_EQ(0u, cache.GetNumEntries());
+	EXPECT_EQ(0u, cache.GetSize());
+
+	HistorySnapshotCache<int> disabledCache(0, 100);
+	EXPECT_FALSE(disabledCache.Insert(1, 1, 1));
+	EXPECT_EQ(0u, disabledCache.GetNumEntries());
+}
+
+TEST(HistorySnapshotCacheTest, RemoveClear)
+{
+	HistorySnapshotCache<int> cache(10, 100);
+
+	cache.Insert(1, 1, 10);
+	cache.Insert(2, 2, 20);
+	cache.Insert(3, 3, 30);
+
+	cache.Remove(2);
+	cache.Remove(4);
+	EXPECT_EQ(2u, cache.GetNumEntries());
+	EXPECT_EQ(40u, cache.GetSize());
+
+	cache.Clear();
+	EXPECT_EQ(0u, cache.GetNumEntries());
+	EXPECT_EQ(0u, cache.GetSize());
+	EXPECT_FALSE(cache.Contains(1));
+
+	// Removing snapshots doesn't count as eviction.
+	EXPECT_EQ(0u, cache.GetNumEvicted());
+}
+
+TEST(HistorySnapshotCacheTest, EvictedSnapshotsAreDestroyed)
+{
+	HistorySnapshotCache<std::shared_ptr<int>> cache(2, 100);
+
+	auto value1 = std::make_shared<int>(1);
+	auto value2 = std::make_shared<int>(2);
+	std::weak_ptr<int> weak1 = value1;
+	std::weak_ptr<int> weak2 = value2;
+
+	cache.Insert(1, std::move(value1), 1);
+	cache.Insert(2, std::move(value2), 1);
+	cache.Insert(3, std::make_shared<int>(3), 1);
+	EXPECT_TRUE(weak1.expired());
+	EXPECT_FALSE(weak2.expired());
+
+	cache.Clear();
+	EXPECT_TRUE(weak2.expired());
+}
+
+TEST(HistorySnapshotCacheTest, MoveOnly)
+{
+	HistorySnapshotCache<std::unique_ptr<int>> cache(2, 100);
+
+	cache.Insert(1, std::make_unique<int>(1), 1);
+
+	auto snapshot = cache.Take(1);
+	ASSERT_TRUE(snapshot);
+	EXPECT_EQ(1, **snapshot);
+}
+
+TEST(HistorySnapshotCacheTest, FolderSnapshots)
+{
+	// Simulates visiting a series of folders, with the size of each
+	// snapshot being estimated from its item store. The budget is just
+	// large enough to hold all of them.
+	std::vector<FolderSnapshot> snapshots;
+	size_t totalSize = 0;
+
+	for (int entryId = 0; entryId < 4; entryId++)
+	{
+		snapshots.push_back(BuildFolderSnapshot(100 * (entryId + 1)));
+		totalSize += snapshots.back().itemStore.GetMemoryUsage();
+	}
+
+	HistorySnapshotCache<FolderSnapshot> cache(8, totalSize);
+
+	for (int entryId = 0; entryId < 4; entryId++)
+	{
+		size_t size = snapshots[entryId].itemStore.GetMemoryUsage();
+		EXPECT_TRUE(cache.Insert(entryId, std::move(snapshots[entryId]), size));
+	}
+
+	EXPECT_EQ(4u, cache.GetNumEntries());
+	EXPECT_EQ(totalSize, cache.GetSize());
+
+	// The item store (including the names interned in it) survives being
+	// moved into and back out of the cache.
+	auto snapshot = cache.Take(2);
+	ASSERT_TRUE(snapshot);
+	EXPECT_EQ(300, snapshot->itemStore.GetNumItems());
+	ASSERT_EQ(300u, snapshot->rows.size());
+	EXPECT_EQ(L"file123.txt", snapshot->itemStore.GetFileName(snapshot->rows[123]));
+	EXPECT_EQ(snapshot->rows[5], snapshot->itemStore.FindItemByFileName(L"file5.txt"));
+
+	// A larger folder pushes out the oldest snapshots.
+	FolderSnapshot largeSnapshot = BuildFolderSnapshot(500);
+	size_t largeSize = largeSnapshot.itemStore.GetMemoryUsage();
+	ASSERT_LT(largeSize, totalSize);
+
+	EXPECT_TRUE(cache.Insert(4, std::move(largeSnapshot), largeSize));
+	EXPECT_LE(cache.GetSize(), totalSize);
+	EXPECT_GT(cache.GetNumEvicted(), 0u);
+	EXPECT_FALSE(cache.Contains(0));
+	EXPECT_TRUE(cache.Contains(4));
+}
+
+// When a folder is shown from its snapshot, the snapshot is compared with a
+// fresh listing of the folder and only the differences are applied.
+TEST(HistorySnapshotCacheTest, RevalidateSnapshot)
+{
+	HistorySnapshotCache<FolderSnapshot> cache(8, 1024 * 1024);
+	cache.Insert(1, BuildFolderSnapshot(10), 1);
+
+	auto snapshot = cache.Take(1);
+	ASSERT_TRUE(snapshot);
+
+	std::vector<ChangeJournal::ListingEntry> current = GetListing(snapshot->itemStore);
+
+	// file0.txt has been removed, file1.txt modified and new.txt added
+	// since the snapshot was taken.
+	current.erase(current.begin());
+	current[0].lastWriteTime++;
+	current.push_back({ L"new.txt", 0, 0 });
+
+	auto changes = ChangeJournal::DiffListings(GetListing(snapshot->itemStore), current);
+	EXPECT_EQ(std::vector<std::wstring>{ L"file0.txt" }, changes.removed);
+	EXPECT_EQ(std::vector<std::wstring>{ L"file1.txt" }, changes.modified);
+	EXPECT_EQ(std::vector<std::wstring>{ L"new.txt" }, changes.added);
+	EXPECT_TRUE(changes.renamed.empty());
+
+	// An unchanged folder has nothing to apply.
+	auto noChanges = ChangeJournal::DiffListings(GetListing(snapshot->itemStore),
+		GetListing(snapshot->itemStore));
+	EXPECT_TRUE(noChanges.removed.empty());
+	EXPECT_TRUE(noChanges.modified.empty());
+	EXPECT_TRUE(noChanges.added.empty());
+}
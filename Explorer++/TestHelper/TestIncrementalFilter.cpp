@@ -0,0 +1,239 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/IncrementalFilter.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+class IncrementalFilterTest : public testing::Test
+{
+protected:
+
+	IncrementalFilterTest() :
+		m_filter([this] (int id) {
+			return std::wstring_view(m_names[id]);
+		})
+	{
+
+	}
+
+	int AddItem(const std::wstring &name, bool exempt = false)
+	{
+		int id = static_cast<int>(m_names.size());
+		m_names.push_back(name);
+		m_filter.AddItem(id, exempt);
+		return id;
+	}
+
+	std::vector<std::wstring> m_names;
+	IncrementalFilter m_filter;
+};
+
+TEST_F(IncrementalFilterTest, NoFilter)
+{
+	int id1 = AddItem(L"file.txt");
+	int id2 = AddItem(L"image.png");
+
+	EXPECT_FALSE(m_filter.HasFilter());
+	EXPECT_TRUE(m_filter.IsVisible(id1));
+	EXPECT_TRUE(m_filter.IsVisible(id2));
+	EXPECT_FALSE(m_filter.IsVisible(id2 + 1));
+	EXPECT_EQ(2U, m_filter.GetNumVisibleItems());
+}
+
+TEST_F(IncrementalFilterTest, SetFilter)
+{
+	int id1 = AddItem(L"file.txt");
+	int id2 = AddItem(L"image.png");
+	int folderId = AddItem(L"folder", true);
+
+	auto changes = m_filter.SetFilter(L"*.txt", true);
+	EXPECT_EQ(std::vector<int>{ id2 }, changes.hidden);
+	EXPECT_TRUE(changes.shown.empty());
+
+	EXPECT_TRUE(m_filter.IsVisible(id1));
+	EXPECT_FALSE(m_filter.IsVisible(id2));
+
+	// Exempt items are never filtered.
+	EXPECT_TRUE(m_filter.IsVisible(folderId));
+	EXPECT_EQ(2U, m_filter.GetNumVisibleItems());
+
+	changes = m_filter.SetFilter(L"*.png", true);
+	EXPECT_EQ(std::vector<int>{ id1 }, changes.hidden);
+	EXPECT_EQ(std::vector<int>{ id2 }, changes.shown);
+
+	changes = m_filter.RemoveFilter();
+	EXPECT_TRUE(changes.hidden.empty());
+	EXPECT_EQ(std::vector<int>{ id1 }, changes.shown);
+	EXPECT_EQ(3U, m_filter.GetNumVisibleItems());
+}
+
+TEST_F(IncrementalFilterTest, Narrowing)
+{
+	AddItem(L"abc");
+	AddItem(L"abcd");
+	AddItem(L"xyz");
+	AddItem(L"xyzw");
+
+	m_filter.SetFilter(L"*x*", true);
+	EXPECT_EQ(4U, m_filter.GetNumItemsLastTested());
+	EXPECT_EQ(2U, m_filter.GetNumVisibleItems());
+
+	// Only the items that are currently visible need to be tested.
+	auto changes = m_filter.SetFilter(L"*xyzw*", true);
+	EXPECT_EQ(2U, m_filter.GetNumItemsLastTested());
+	EXPECT_EQ(std::vector<int>{ 2 }, changes.hidden);
+
+	// Likewise, only hidden items need to be tested when the filter is
+	// widened.
+	changes = m_filter.SetFilter(L"*xy*", true);
+	EXPECT_EQ(3U, m_filter.GetNumItemsLastTested());
+	EXPECT_EQ(std::vector<int>{ 2 }, changes.shown);
+
+	// An equivalent filter doesn't require any items to be tested.
+	changes = m_filter.SetFilter(L"*xy*", true);
+	EXPECT_EQ(0U, m_filter.GetNumItemsLastTested());
+
+	// Unrelated filters require every item to be tested.
+	changes = m_filter.SetFilter(L"*b*", true);
+	EXPECT_EQ(4U, m_filter.GetNumItemsLastTested());
+	EXPECT_EQ((std::vector<int>{ 2, 3 }), changes.hidden);
+	EXPECT_EQ((std::vector<int>{ 0, 1 }), changes.shown);
+}
+
+TEST_F(IncrementalFilterTest, AddRemoveUpdate)
+{
+	m_filter.SetFilter(L"*.txt", false);
+
+	int id1 = AddItem(L"file.TXT");
+	int id2 = AddItem(L"file.png");
+	EXPECT_TRUE(m_filter.IsVisible(id1));
+	EXPECT_FALSE(m_filter.IsVisible(id2));
+
+	m_names[id2] = L"file.txt";
+	EXPECT_TRUE(m_filter.UpdateItem(id2));
+	EXPECT_EQ(2U, m_filter.GetNumVisibleItems());
+
+	m_filter.RemoveItem(id1);
+	EXPECT_FALSE(m_filter.IsVisible(id1));
+	EXPECT_EQ(1U, m_filter.GetNumItems());
+	EXPECT_EQ(1U, m_filter.GetNumVisibleItems());
+
+	// Removed items shouldn't be reported as shown.
+	auto changes = m_filter.RemoveFilter();
+	EXPECT_TRUE(changes.shown.empty());
+
+	m_filter.Clear();
+	EXPECT_FALSE(m_filter.IsVisible(id2));
+	EXPECT_EQ(0U, m_filter.GetNumItems());
+}
+
+// Types a filter one character at a time (then deletes it again), checking
+// that the incremental updates always produce the same result as testing
+// every item.
+TEST_F(IncrementalFilterTest, Typing)
+{
+	std::mt19937 generator(42);
+	std::uniform_int_distribution<int> characterDistribution(0, 3);
+
+	for (int i = 0; i < 2000; i++)
+	{
+		std::wstring name;
+
+		for (int j = 0; j < 8; j++)
+		{
+			name += static_cast<wchar_t>(L'a' + characterDistribution(generator));
+		}
+
+		AddItem(name, i % 50 == 0);
+	}
+
+	std::wstring typed = L"abcadb";
+	std::vector<std::wstring> filters;
+
+	for (size_t i = 1; i <= typed.size(); i++)
+	{
+		filters.push_back(L"*" + typed.substr(0, i) + L"*");
+	}
+
+	for (size_t i = typed.size() - 1; i > 0; i--)
+	{
+		filters.push_back(L"*" + typed.substr(0, i) + L"*");
+	}
+
+	for (const auto &filter : filters)
+	{
+		m_filter.SetFilter(filter, true);
+
+		CompiledWildcard compiledWildcard(filter, true);
+
+		for (size_t id = 0; id < m_names.size(); id++)
+		{
+			bool expected = (id % 50 == 0) || compiledWildcard.Match(m_names[id]);
+			ASSERT_EQ(expected, m_filter.IsVisible(static_cast<int>(id))) << L"Filter: " << filter;
+		}
+	}
+}
+
+TEST_F(IncrementalFilterTest, DISABLED_Benchmark)
+{
+	const int NUM_ITEMS = 200000;
+
+	std::mt19937 generator(42);
+	std::uniform_int_distribution<int> characterDistribution(0, 25);
+
+	for (int i = 0; i < NUM_ITEMS; i++)
+	{
+		std::wstring name;
+
+		for (int j = 0; j < 16; j++)
+		{
+			name += static_cast<wchar_t>(L'a' + characterDistribution(generator));
+		}
+
+		AddItem(name + L".txt");
+	}
+
+	auto toMilliseconds = [] (auto duration) {
+		return static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count())
+			/ 1000.0;
+	};
+
+	// Simulates typing "*report*" one character at a time, comparing the
+	// incremental filter to re-testing every item after each character.
+	std::string typed = "report";
+
+	for (size_t i = 1; i <= typed.size(); i++)
+	{
+		std::string narrowFilter = "*" + typed.substr(0, i) + "*";
+		std::wstring filter(narrowFilter.begin(), narrowFilter.end());
+
+		auto start = std::chrono::steady_clock::now();
+		CompiledWildcard compiledWildcard(filter, false);
+		size_t numMatches = 0;
+
+		for (const auto &name : m_names)
+		{
+			numMatches += compiledWildcard.Match(name) ? 1 : 0;
+		}
+
+		auto fullDuration = std::chrono::steady_clock::now() - start;
+
+		start = std::chrono::steady_clock::now();
+		m_filter.SetFilter(filter, false);
+		auto incrementalDuration = std::chrono::steady_clock::now() - start;
+
+		std::cout << "\"" << narrowFilter << "\", " << NUM_ITEMS << " items: "
+			<< "full " << toMilliseconds(fullDuration) << " ms, "
+			<< "incremental " << toMilliseconds(incrementalDuration) << " ms ("
+			<< m_filter.GetNumItemsLastTested() << " items tested), "
+			<< numMatches << " visible\n";
+
+		EXPECT_EQ(numMatches, m_filter.GetNumVisibleItems());
+	}
+}
@@ -0,0 +1,433 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/ItemStore.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+	ItemStore::FileData BuildFileData(std::wstring_view fileName, uint32_t attributes, uint64_t size)
+	{
+		ItemStore::FileData fileData;
+		fileData.attributes = attributes;
+		fileData.size = size;
+		fileData.creationTime = 100;
+		fileData.lastAccessTime = 200;
+		fileData.lastWriteTime = 300;
+		fileData.fileName = fileName;
+		return fileData;
+	}
+}
+
+TEST(ItemStoreTest, AddItem)
+{
+	ItemStore itemStore;
+
+	ItemStore::FileData fileData = BuildFileData(L"file.txt", 0x20, 1234);
+	fileData.alternateFileName = L"FILE~1.TXT";
+	int id = itemStore.AddItem(fileData, L"file");
+
+	EXPECT_EQ(0, id);
+	EXPECT_EQ(1, itemStore.GetNumItems());
+	EXPECT_TRUE(itemStore.IsValidItem(id));
+	EXPECT_FALSE(itemStore.IsFolder(id));
+	EXPECT_EQ(0x20u, itemStore.GetAttributes(id));
+	EXPECT_EQ(1234u, itemStore.GetSize(id));
+	EXPECT_EQ(100u, itemStore.GetCreationTime(id));
+	EXPECT_EQ(200u, itemStore.GetLastAccessTime(id));
+	EXPECT_EQ(300u, itemStore.GetLastWriteTime(id));
+	EXPECT_EQ(L"file.txt", itemStore.GetFileName(id));
+	EXPECT_EQ(L"FILE~1.TXT", itemStore.GetAlternateFileName(id));
+	EXPECT_EQ(L"file", itemStore.GetDisplayName(id));
+}
+
+TEST(ItemStoreTest, NamesAreNullTerminated)
+{
+	ItemStore itemStore;
+
+	int id = itemStore.AddItem(BuildFileData(L"name", 0, 0), L"display");
+
+	EXPECT_STREQ(L"name", itemStore.GetFileName(id).data());
+	EXPECT_STREQ(L"display", itemStore.GetDisplayName(id).data());
+	EXPECT_STREQ(L"", itemStore.GetAlternateFileName(id).data());
+}
+
+TEST(ItemStoreTest, IdsAreSequential)
+{
+	ItemStore itemStore;
+
+	for (int i = 0; i < 10; i++)
+	{
+		std::wstring name = L"file" + std::to_wstring(i);
+		EXPECT_EQ(i, itemStore.AddItem(BuildFileData(name, 0, i), name));
+	}
+
+	EXPECT_EQ(10, itemStore.GetNumItems());
+	EXPECT_EQ(10, itemStore.GetIdLimit());
+	EXPECT_EQ(L"file7", itemStore.GetFileName(7));
+	EXPECT_EQ(7u, itemStore.GetSizeColumn()[7]);
+}
+
+TEST(ItemStoreTest, RemoveItem)
+{
+	ItemStore itemStore;
+
+	int id1 = itemStore.AddItem(BuildFileData(L"a", 0, 0), L"a");
+	int id2 = itemStore.AddItem(BuildFileData(L"b", 0, 0), L"b");
+
+	itemStore.RemoveItem(id1);
+
+	EXPECT_FALSE(itemStore.IsValidItem(id1));
+	EXPECT_TRUE(itemStore.IsValidItem(id2));
+	EXPECT_EQ(1, itemStore.GetNumItems());
+
+	// IDs shouldn't be reused.
+	int id3 = itemStore.AddItem(BuildFileData(L"c", 0, 0), L"c");
+	EXPECT_EQ(2, id3);
+	EXPECT_EQ(3, itemStore.GetIdLimit());
+
+	EXPECT_FALSE(itemStore.IsValidItem(-1));
+	EXPECT_FALSE(itemStore.IsValidItem(3));
+}
+
+TEST(ItemStoreTest, UpdateItem)
+{
+	ItemStore itemStore;
+
+	int id = itemStore.AddItem(BuildFileData(L"old.txt", 0, 10), L"old");
+
+	itemStore.SetFileData(id, BuildFileData(L"new.txt", ItemStore::ATTRIBUTE_DIRECTORY, 20));
+	itemStore.SetDisplayName(id, L"new");
+
+	EXPECT_TRUE(itemStore.IsFolder(id));
+	EXPECT_EQ(20u, itemStore.GetSize(id));
+	EXPECT_EQ(L"new.txt", itemStore.GetFileName(id));
+	EXPECT_EQ(L"new", itemStore.GetDisplayName(id));
+
+	itemStore.SetFileName(id, L"renamed.txt");
+	itemStore.SetSize(id, 30);
+
+	EXPECT_EQ(L"renamed.txt", itemStore.GetFileName(id));
+	EXPECT_EQ(30u, itemStore.GetSize(id));
+}
+
+TEST(ItemStoreTest, ColorRule)
+{
+	ItemStore itemStore;
+
+	int id = itemStore.AddItem(BuildFileData(L"file.txt", 0, 0), L"file");
+	EXPECT_EQ(ItemStore::NO_COLOR_RULE, itemStore.GetColorRule(id));
+
+	itemStore.SetColorRule(id, 3);
+	EXPECT_EQ(3, itemStore.GetColorRule(id));
+
+	// Updating the other properties should leave the color rule alone.
+	itemStore.SetFileData(id, BuildFileData(L"file.png", 0, 0));
+	EXPECT_EQ(3, itemStore.GetColorRule(id));
+}
+
+TEST(ItemStoreTest, Clear)
+{
+	ItemStore itemStore;
+
+	itemStore.AddItem(BuildFileData(L"a", 0, 0), L"a");
+	itemStore.AddItem(BuildFileData(L"b", 0, 0), L"b");
+	itemStore.Clear();
+
+	EXPECT_EQ(0, itemStore.GetNumItems());
+	EXPECT_EQ(0, itemStore.GetIdLimit());
+	EXPECT_FALSE(itemStore.IsValidItem(0));
+
+	int id = itemStore.AddItem(BuildFileData(L"c", 0, 0), L"c");
+	EXPECT_EQ(0, id);
+	EXPECT_EQ(L"c", itemStore.GetFileName(id));
+}
+
+TEST(ItemStoreTest, LongNames)
+{
+	ItemStore itemStore;
+
+	// Names that are longer than a single arena block should still be
+	// stored correctly and shouldn't disturb the names around them.
+	std::wstring longName(100000, 'x');
+	int id1 = itemStore.AddItem(BuildFileData(L"before", 0, 0), L"before");
+	int id2 = itemStore.AddItem(BuildFileData(longName, 0, 0), longName);
+	int id3 = itemStore.AddItem(BuildFileData(L"after", 0, 0), L"after");
+
+	EXPECT_EQ(L"before", itemStore.GetFileName(id1));
+	EXPECT_EQ(longName, itemStore.GetFileName(id2));
+	EXPECT_EQ(L"after", itemStore.GetFileName(id3));
+}
+
+TEST(ItemStoreTest, NamesStableAcrossGrowth)
+{
+	ItemStore itemStore;
+
+	int id = itemStore.AddItem(BuildFileData(L"first", 0, 0), L"first");
+	std::wstring_view name = itemStore.GetFileName(id);
+
+	for (int i = 0; i < 50000; i++)
+	{
+		std::wstring current = L"item" + std::to_wstring(i);
+		itemStore.AddItem(BuildFileData(current, 0, 0), current);
+	}
+
+	EXPECT_EQ(name.data(), itemStore.GetFileName(id).data());
+	EXPECT_EQ(L"first", name);
+}
+
+TEST(ItemStoreTest, FindItemByName)
+{
+	ItemStore itemStore;
+
+	ItemStore::FileData fileData = BuildFileData(L"Long file name.txt", 0, 0);
+	fileData.alternateFileName = L"LONGFI~1.TXT";
+	int id1 = itemStore.AddItem(fileData, L"Long file name");
+	int id2 = itemStore.AddItem(BuildFileData(L"other.txt", 0, 0), L"other");
+
+	EXPECT_EQ(id1, itemStore.FindItemByFileName(L"Long file name.txt"));
+	EXPECT_EQ(id1, itemStore.FindItemByAlternateFileName(L"LONGFI~1.TXT"));
+	EXPECT_EQ(id2, itemStore.FindItemByFileName(L"other.txt"));
+
+	// Display names and alternate names aren't file names.
+	EXPECT_EQ(-1, itemStore.FindItemByFileName(L"Long file name"));
+	EXPECT_EQ(-1, itemStore.FindItemByFileName(L"LONGFI~1.TXT"));
+
+	// Matches are exact.
+	EXPECT_EQ(-1, itemStore.FindItemByFileName(L"OTHER.TXT"));
+	EXPECT_EQ(-1, itemStore.FindItemByFileName(L"missing.txt"));
+
+	// Items without an alternate name can't be found by an empty name.
+	EXPECT_EQ(-1, itemStore.FindItemByAlternateFileName(L""));
+}
+
+TEST(ItemStoreTest, FindItemAfterChanges)
+{
+	ItemStore itemStore;
+
+	int id1 = itemStore.AddItem(BuildFileData(L"a.txt", 0, 0), L"a");
+	int id2 = itemStore.AddItem(BuildFileData(L"b.txt", 0, 0), L"b");
+
+	itemStore.SetFileName(id1, L"renamed.txt");
+	EXPECT_EQ(-1, itemStore.FindItemByFileName(L"a.txt"));
+	EXPECT_EQ(id1, itemStore.FindItemByFileName(L"renamed.txt"));
+
+	ItemStore::FileData fileData = BuildFileData(L"c.txt", 0, 0);
+	fileData.alternateFileName = L"C~1.TXT";
+	itemStore.SetFileData(id2, fileData);
+	EXPECT_EQ(-1, itemStore.FindItemByFileName(L"b.txt"));
+	EXPECT_EQ(id2, itemStore.FindItemByFileName(L"c.txt"));
+	EXPECT_EQ(id2, itemStore.FindItemByAlternateFileName(L"C~1.TXT"));
+
+	itemStore.RemoveItem(id2);
+	EXPECT_EQ(-1, itemStore.FindItemByFileName(L"c.txt"));
+	EXPECT_EQ(-1, itemStore.FindItemByAlternateFileName(L"C~1.TXT"));
+
+	// A removed name can be reused by a new item.
+	int id3 = itemStore.AddItem(BuildFileData(L"c.txt", 0, 0), L"c");
+	EXPECT_EQ(id3, itemStore.FindItemByFileName(L"c.txt"));
+
+	itemStore.Clear();
+	EXPECT_EQ(-1, itemStore.FindItemByFileName(L"renamed.txt"));
+	EXPECT_EQ(-1, itemStore.FindItemByFileName(L"c.txt"));
+}
+
+TEST(ItemStoreTest, FindItemWithDuplicateNames)
+{
+	ItemStore itemStore;
+
+	// Names are unique within a file system folder, but that isn't
+	// necessarily true of virtual folders.
+	int id1 = itemStore.AddItem(BuildFileData(L"item", 0, 0), L"item");
+	int id2 = itemStore.AddItem(BuildFileData(L"item", 0, 0), L"item");
+
+	EXPECT_EQ(id1, itemStore.FindItemByFileName(L"item"));
+
+	itemStore.RemoveItem(id1);
+	EXPECT_EQ(id2, itemStore.FindItemByFileName(L"item"));
+
+	itemStore.RemoveItem(id2);
+	EXPECT_EQ(-1, itemStore.FindItemByFileName(L"item"));
+}
+
+// Replays a large paste (a batch of new items is added to a large folder,
+// with each new item then being looked up so that it can be selected) and
+// a burst of renames (each item is looked up by its old name and then
+// renamed). The indexed lookups are compared with a linear scan over the
+// items, which is what ShellBrowser did previously. Run with
+// --gtest_also_run_disabled_tests.
+TEST(ItemStoreTest, DISABLED_NameLookupReplayBenchmark)
+{
+	const int NUM_EXISTING_ITEMS = 100000;
+	const int NUM_PASTED_ITEMS = 10000;
+	const int NUM_RENAMED_ITEMS = 10000;
+
+	auto linearFind = [] (const ItemStore &itemStore, std::wstring_view fileName) {
+		for (int i = 0; i < itemStore.GetIdLimit(); i++)
+		{
+			if (itemStore.IsValidItem(i) && (itemStore.GetFileName(i) == fileName
+				|| itemStore.GetAlternateFileName(i) == fileName))
+			{
+				return i;
+			}
+		}
+
+		return -1;
+	};
+
+	auto indexedFind = [] (const ItemStore &itemStore, std::wstring_view fileName) {
+		int id = itemStore.FindItemByFileName(fileName);
+
+		if (id == -1)
+		{
+			id = itemStore.FindItemByAlternateFileName(fileName);
+		}
+
+		return id;
+	};
+
+	auto replay = [&] (auto find) {
+		ItemStore itemStore;
+
+		for (int i = 0; i < NUM_EXISTING_ITEMS; i++)
+		{
+			std::wstring name = L"existing " + std::to_wstring(i) + L".txt";
+			itemStore.AddItem(BuildFileData(name, 0, i), name);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < NUM_PASTED_ITEMS; i++)
+		{
+			std::wstring name = L"pasted " + std::to_wstring(i) + L".txt";
+			itemStore.AddItem(BuildFileData(name, 0, i), name);
+		}
+
+		for (int i = 0; i < NUM_PASTED_ITEMS; i++)
+		{
+			std::wstring name = L"pasted " + std::to_wstring(i) + L".txt";
+			EXPECT_NE(-1, find(itemStore, name));
+		}
+
+		auto pasteDuration = std::chrono::steady_clock::now() - start;
+
+		start = std::chrono::steady_clock::now();
+
+		// Rename items from the end of the folder, which is the worst
+		// case for a linear scan.
+		for (int i = 0; i < NUM_RENAMED_ITEMS; i++)
+		{
+			int index = NUM_EXISTING_ITEMS - 1 - i;
+			std::wstring oldName = L"existing " + std::to_wstring(index) + L".txt";
+			std::wstring newName = L"renamed " + std::to_wstring(index) + L".txt";
+
+			int id = find(itemStore, oldName);
+			EXPECT_NE(-1, id);
+
+			itemStore.SetFileName(id, newName);
+		}
+
+		auto renameDuration = std::chrono::steady_clock::now() - start;
+
+		return std::make_pair(pasteDuration, renameDuration);
+	};
+
+	auto toMilliseconds = [] (auto duration) {
+		return static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+	};
+
+	auto linearDurations = replay(linearFind);
+	auto indexedDurations = replay(indexedFind);
+
+	printf("Existing items: %d, pasted items: %d, renamed items: %d\n", NUM_EXISTING_ITEMS,
+		NUM_PASTED_ITEMS, NUM_RENAMED_ITEMS);
+	printf("Linear scan - paste: %lld ms, renames: %lld ms\n", toMilliseconds(linearDurations.first),
+		toMilliseconds(linearDurations.second));
+	printf("Indexed - paste: %lld ms, renames: %lld ms\n", toMilliseconds(indexedDurations.first),
+		toMilliseconds(indexedDurations.second));
+}
+
+// Compares the memory used by the store, and the time taken to scan the
+// attributes of every item, against a map of per-item structures (which is
+// what ShellBrowser used previously). Run with
+// --gtest_also_run_disabled_tests.
+TEST(ItemStoreTest, DISABLED_MemoryAndScanBenchmark)
+{
+	const int NUM_ITEMS = 1000000;
+	const int MAX_NAME = 260;
+
+	struct LegacyItem
+	{
+		uint32_t attributes;
+		uint64_t creationTime;
+		uint64_t lastAccessTime;
+		uint64_t lastWriteTime;
+		uint64_t size;
+		wchar_t fileName[MAX_NAME];
+		wchar_t alternateFileName[14];
+		wchar_t displayName[MAX_NAME];
+	};
+
+	std::unordered_map<int, LegacyItem> legacyItems;
+	ItemStore itemStore;
+
+	for (int i = 0; i < NUM_ITEMS; i++)
+	{
+		std::wstring name = L"document " + std::to_wstring(i) + L".txt";
+		uint32_t attributes = (i % 10 == 0) ? ItemStore::ATTRIBUTE_DIRECTORY : 0x20;
+
+		LegacyItem legacyItem = {};
+		legacyItem.attributes = attributes;
+		legacyItem.size = i;
+		name.copy(legacyItem.fileName, name.size());
+		name.copy(legacyItem.displayName, name.size());
+		legacyItems.insert({ i, legacyItem });
+
+		itemStore.AddItem(BuildFileData(name, attributes, i), name);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	int legacyFolders = 0;
+
+	for (const auto &item : legacyItems)
+	{
+		if (item.second.attributes & ItemStore::ATTRIBUTE_DIRECTORY)
+		{
+			legacyFolders++;
+		}
+	}
+
+	auto legacyDuration = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+
+	int storeFolders = 0;
+	const auto &attributes = itemStore.GetAttributesColumn();
+
+	for (uint32_t attribute : attributes)
+	{
+		if (attribute & ItemStore::ATTRIBUTE_DIRECTORY)
+		{
+			storeFolders++;
+		}
+	}
+
+	auto storeDuration = std::chrono::steady_clock::now() - start;
+
+	EXPECT_EQ(legacyFolders, storeFolders);
+
+	size_t legacyMemory = legacyItems.size() * (sizeof(LegacyItem) + sizeof(int) + 2 * sizeof(void *))
+		+ legacyItems.bucket_count() * sizeof(void *);
+
+	printf("Items: %d\n", NUM_ITEMS);
+	printf("Map memory: %zu KB, scan: %lld us\n", legacyMemory / 1024,
+		static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(legacyDuration).count()));
+	printf("Store memory: %zu KB, scan: %lld us\n", itemStore.GetMemoryUsage() / 1024,
+		static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(storeDuration).count()));
+}
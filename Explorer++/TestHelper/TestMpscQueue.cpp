@@ -0,0 +1,127 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/MpscQueue.h"
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(MpscQueueTest, Empty)
+{
+	MpscQueue<int> queue;
+
+	int value;
+	EXPECT_TRUE(queue.IsEmpty());
+	EXPECT_FALSE(queue.TryPop(value));
+}
+
+TEST(MpscQueueTest, FirstInFirstOut)
+{
+	MpscQueue<std::wstring> queue;
+
+	queue.Push(L"a");
+	queue.Push(L"b");
+	queue.Push(L"c");
+	EXPECT_FALSE(queue.IsEmpty());
+
+	std::wstring value;
+	ASSERT_TRUE(queue.TryPop(value));
+	EXPECT_EQ(L"a", value);
+	ASSERT_TRUE(queue.TryPop(value));
+	EXPECT_EQ(L"b", value);
+
+	queue.Push(L"d");
+
+	ASSERT_TRUE(queue.TryPop(value));
+	EXPECT_EQ(L"c", value);
+	ASSERT_TRUE(queue.TryPop(value));
+	EXPECT_EQ(L"d", value);
+	EXPECT_FALSE(queue.TryPop(value));
+	EXPECT_TRUE(queue.IsEmpty());
+}
+
+TEST(MpscQueueTest, MoveOnlyValues)
+{
+	MpscQueue<std::unique_ptr<int>> queue;
+
+	queue.Push(std::make_unique<int>(42));
+
+	std::unique_ptr<int> value;
+	ASSERT_TRUE(queue.TryPop(value));
+	EXPECT_EQ(42, *value);
+}
+
+TEST(MpscQueueTest, DestroyedWithItems)
+{
+	auto counter = std::make_shared<int>(0);
+
+	{
+		MpscQueue<std::shared_ptr<int>> queue;
+
+		for (int i = 0; i < 10; i++)
+		{
+			queue.Push(counter);
+		}
+
+		EXPECT_EQ(11, counter.use_count());
+	}
+
+	// Items that were never popped are released.
+	EXPECT_EQ(1, counter.use_count());
+}
+
+TEST(MpscQueueTest, MultipleProducers)
+{
+	const int NUM_PRODUCERS = 4;
+	const int NUM_ITEMS_PER_PRODUCER = 100000;
+
+	struct Item
+	{
+		int producer = 0;
+		int sequence = 0;
+	};
+
+	MpscQueue<Item> queue;
+	std::vector<std::thread> producers;
+
+	for (int i = 0; i < NUM_PRODUCERS; i++)
+	{
+		producers.emplace_back([&queue, i] {
+			for (int j = 0; j < NUM_ITEMS_PER_PRODUCER; j++)
+			{
+				queue.Push({ i, j });
+			}
+		});
+	}
+
+	// Items from any one producer should be seen in the order they were
+	// pushed.
+	std::vector<int> nextSequence(NUM_PRODUCERS, 0);
+	int numPopped = 0;
+
+	while (numPopped < NUM_PRODUCERS * NUM_ITEMS_PER_PRODUCER)
+	{
+		Item item;
+
+		if (!queue.TryPop(item))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		ASSERT_EQ(nextSequence[item.producer], item.sequence);
+		nextSequence[item.producer]++;
+		numPopped++;
+	}
+
+	for (auto &producer : producers)
+	{
+		producer.join();
+	}
+
+	Item item;
+	EXPECT_FALSE(queue.TryPop(item));
+}
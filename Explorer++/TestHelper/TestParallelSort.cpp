@@ -0,0 +1,216 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/ParallelSort.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cwctype>
+#include <numeric>
+#include <random>
+#include <string>
+
+namespace
+{
+	struct TestItem
+	{
+		int key;
+		int originalPosition;
+	};
+
+	std::vector<TestItem> BuildTestItems(size_t count, int maxKey)
+	{
+		std::mt19937 generator(1234);
+		std::uniform_int_distribution<int> distribution(0, maxKey);
+
+		std::vector<TestItem> items;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			items.push_back({ distribution(generator), static_cast<int>(i) });
+		}
+
+		return items;
+	}
+
+	bool CompareTestItems(const TestItem &item1, const TestItem &item2)
+	{
+		return item1.key < item2.key;
+	}
+
+	void TestSortMatchesStableSort(int numThreads, size_t count, int maxKey, size_t minBlockSize)
+	{
+		TaskExecutor executor(numThreads);
+
+		auto items = BuildTestItems(count, maxKey);
+		auto expected = items;
+
+		std::stable_sort(expected.begin(), expected.end(), CompareTestItems);
+		ParallelSort::ParallelMergeSort(executor, items, CompareTestItems, minBlockSize);
+
+		ASSERT_EQ(expected.size(), items.size());
+
+		for (size_t i = 0; i < items.size(); i++)
+		{
+			EXPECT_EQ(expected[i].key, items[i].key);
+			EXPECT_EQ(expected[i].originalPosition, items[i].originalPosition);
+		}
+	}
+}
+
+TEST(ParallelSortTest, Empty)
+{
+	TestSortMatchesStableSort(4, 0, 10, 1);
+}
+
+TEST(ParallelSortTest, SingleThread)
+{
+	TestSortMatchesStableSort(1, 10000, 1000, 16);
+}
+
+TEST(ParallelSortTest, SmallInput)
+{
+	// The input is smaller than the minimum block size, so it will be sorted
+	// directly.
+	TestSortMatchesStableSort(4, 100, 1000, ParallelSort::DEFAULT_MIN_BLOCK_SIZE);
+}
+
+TEST(ParallelSortTest, MultipleBlocks)
+{
+	TestSortMatchesStableSort(4, 100000, 1000000, 16);
+}
+
+TEST(ParallelSortTest, OddNumberOfBlocks)
+{
+	TestSortMatchesStableSort(3, 10007, 100000, 16);
+	TestSortMatchesStableSort(7, 10007, 100000, 16);
+}
+
+TEST(ParallelSortTest, Stable)
+{
+	// With only a handful of distinct keys, most elements compare equal, so
+	// this checks that the original order is preserved across blocks.
+	TestSortMatchesStableSort(4, 50000, 5, 16);
+}
+
+TEST(ParallelSortTest, ParallelFor)
+{
+	TaskExecutor executor(4);
+
+	std::vector<int> values(100000, 0);
+	std::atomic<int> numCalls(0);
+
+	ParallelSort::ParallelFor(executor, values.size(), [&values, &numCalls] (size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			values[i]++;
+		}
+
+		numCalls++;
+	}, 1000);
+
+	EXPECT_EQ(4, numCalls.load());
+
+	for (int value : values)
+	{
+		EXPECT_EQ(1, value);
+	}
+}
+
+TEST(ParallelSortTest, ParallelForSmallRange)
+{
+	TaskExecutor executor(4);
+
+	int numCalls = 0;
+	size_t total = 0;
+
+	ParallelSort::ParallelFor(executor, 10, [&numCalls, &total] (size_t begin, size_t end) {
+		numCalls++;
+		total += end - begin;
+	});
+
+	EXPECT_EQ(1, numCalls);
+	EXPECT_EQ(10u, total);
+}
+
+// Compares the previous approach to sorting (where the sort key for an item
+// is recalculated on every comparison) with precomputing the keys in
+// parallel and then running a parallel merge sort over the precomputed keys.
+// Run with --gtest_also_run_disabled_tests.
+TEST(ParallelSortTest, DISABLED_SortKeyBenchmark)
+{
+	const int NUM_ITEMS = 200000;
+
+	std::vector<std::wstring> names;
+	std::mt19937 generator(1234);
+	std::uniform_int_distribution<int> distribution(0, NUM_ITEMS * 10);
+
+	for (int i = 0; i < NUM_ITEMS; i++)
+	{
+		names.push_back(L"Document " + std::to_wstring(distribution(generator)) + L".TXT");
+	}
+
+	// Stands in for the work done to build a sort key (e.g. retrieving
+	// column text and normalizing it).
+	auto buildKey = [&names] (int index) {
+		std::wstring key = names[index];
+
+		for (auto &c : key)
+		{
+			c = towlower(c);
+		}
+
+		return key;
+	};
+
+	std::vector<int> order(NUM_ITEMS);
+	std::iota(order.begin(), order.end(), 0);
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<int> legacyOrder = order;
+	std::sort(legacyOrder.begin(), legacyOrder.end(), [&buildKey] (int index1, int index2) {
+		return buildKey(index1) < buildKey(index2);
+	});
+
+	auto legacyDuration = std::chrono::steady_clock::now() - start;
+
+	TaskExecutor executor((std::max)(1, static_cast<int>(std::thread::hardware_concurrency())));
+
+	start = std::chrono::steady_clock::now();
+
+	std::vector<std::wstring> keys(NUM_ITEMS);
+
+	ParallelSort::ParallelFor(executor, keys.size(), [&keys, &buildKey] (size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			keys[i] = buildKey(static_cast<int>(i));
+		}
+	});
+
+	auto extractionDuration = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+
+	ParallelSort::ParallelMergeSort(executor, order, [&keys] (int index1, int index2) {
+		return keys[index1] < keys[index2];
+	});
+
+	auto sortDuration = std::chrono::steady_clock::now() - start;
+
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		ASSERT_EQ(keys[legacyOrder[i]], keys[order[i]]);
+	}
+
+	auto toMilliseconds = [] (auto duration) {
+		return static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+	};
+
+	printf("Items: %d, threads: %d\n", NUM_ITEMS, executor.GetNumThreads());
+	printf("Per-comparison keys: %lld ms\n", toMilliseconds(legacyDuration));
+	printf("Key extraction: %lld ms, sort: %lld ms\n", toMilliseconds(extractionDuration),
+		toMilliseconds(sortDuration));
+}
@@ -0,0 +1,521 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/PixelKernels.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace PixelKernels;
+
+namespace
+{
+	// An image with some padding at the end of each row, so that the
+	// stride is taken into account.
+	class TestImage
+	{
+	public:
+
+		TestImage(int width, int height, int padding = 3) :
+			m_pixels(static_cast<size_t>(width + padding) * height, 0xDEADBEEF),
+			m_width(width),
+			m_height(height),
+			m_stride(width + padding)
+		{
+
+		}
+
+		ImageView GetView()
+		{
+			return { m_pixels.data(), m_width, m_height, m_stride };
+		}
+
+		ConstImageView GetConstView() const
+		{
+			return { m_pixels.data(), m_width, m_height, m_stride };
+		}
+
+		uint32_t GetPixel(int x, int y) const
+		{
+			return m_pixels[static_cast<size_t>(y) * m_stride + x];
+		}
+
+		void SetPixel(int x, int y, uint32_t pixel)
+		{
+			m_pixels[static_cast<size_t>(y) * m_stride + x] = pixel;
+		}
+
+		void Randomize(std::mt19937 &generator)
+		{
+			for (auto &pixel : m_pixels)
+			{
+				pixel = static_cast<uint32_t>(generator());
+			}
+		}
+
+		// Compares everything, including the padding.
+		bool operator==(const TestImage &other) const
+		{
+			return m_pixels == other.m_pixels;
+		}
+
+	private:
+
+		std::vector<uint32_t> m_pixels;
+		int m_width;
+		int m_height;
+		int m_stride;
+	};
+
+	std::vector<InstructionSet> GetSupportedInstructionSets()
+	{
+		std::vector<InstructionSet> instructionSets = { InstructionSet::Portable };
+
+		if (GetBestInstructionSet() >= InstructionSet::Sse2)
+		{
+			instructionSets.push_back(InstructionSet::Sse2);
+		}
+
+		if (GetBestInstructionSet() >= InstructionSet::Avx2)
+		{
+			instructionSets.push_back(InstructionSet::Avx2);
+		}
+
+		return instructionSets;
+	}
+
+	// Widths that cover each vector width, as well as the leftover pixels
+	// that are handled individually.
+	const int TEST_WIDTHS[] = { 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 120, 257 };
+
+	// A reference premultiplication, using floating point.
+	uint32_t Premultiply(uint32_t pixel)
+	{
+		uint32_t alpha = pixel >> 24;
+		uint32_t result = pixel & 0xFF000000;
+
+		for (int shift = 0; shift < 24; shift += 8)
+		{
+			double channel = static_cast<double>((pixel >> shift) & 0xFF) * alpha / 255.0;
+			result |= static_cast<uint32_t>(channel + 0.5) << shift;
+		}
+
+		return result;
+	}
+}
+
+TEST(PixelKernelsTest, Fill)
+{
+	for (auto instructionSet : GetSupportedInstructionSets())
+	{
+		for (int width : TEST_WIDTHS)
+		{
+			TestImage image(width, 3);
+			Fill(image.GetView(), 0x11223344, instructionSet);
+
+			TestImage expected(width, 3);
+
+			for (int y = 0; y < 3; y++)
+			{
+				for (int x = 0; x < width; x++)
+				{
+					expected.SetPixel(x, y, 0x11223344);
+				}
+			}
+
+			EXPECT_TRUE(image == expected);
+		}
+	}
+}
+
+TEST(PixelKernelsTest, PremultiplyMatchesReference)
+{
+	// Every combination of alpha and channel value.
+	TestImage image(256, 256, 0);
+
+	for (int alpha = 0; alpha < 256; alpha++)
+	{
+		for (int value = 0; value < 256; value++)
+		{
+			image.SetPixel(value, alpha, (alpha << 24) | (value << 16) | ((255 - value) << 8) | (value / 2));
+		}
+	}
+
+	for (auto instructionSet : GetSupportedInstructionSets())
+	{
+		TestImage premultiplied = image;
+		ConvertToPremultiplied(premultiplied.GetView(), AlphaMode::Straight, instructionSet);
+
+		for (int alpha = 0; alpha < 256; alpha++)
+		{
+			for (int value = 0; value < 256; value++)
+			{
+				ASSERT_EQ(Premultiply(image.GetPixel(value, alpha)), premultiplied.GetPixel(value, alpha));
+			}
+		}
+	}
+}
+
+TEST(PixelKernelsTest, IgnoreAlpha)
+{
+	for (auto instructionSet : GetSupportedInstructionSets())
+	{
+		TestImage image(9, 2);
+		image.SetPixel(0, 0, 0x00123456);
+		image.SetPixel(8, 1, 0x7F123456);
+
+		ConvertToPremultiplied(image.GetView(), AlphaMode::Ignore, instructionSet);
+
+		EXPECT_EQ(0xFF123456, image.GetPixel(0, 0));
+		EXPECT_EQ(0xFF123456, image.GetPixel(8, 1));
+	}
+}
+
+TEST(PixelKernelsTest, HasAlpha)
+{
+	for (auto instructionSet : GetSupportedInstructionSets())
+	{
+		for (int width : TEST_WIDTHS)
+		{
+			TestImage image(width, 2);
+			Fill(image.GetView(), 0x00FFFFFF);
+
+			// The padding has a non-zero alpha value, which should be
+			// ignored.
+			EXPECT_FALSE(HasAlpha(image.GetConstView(), instructionSet));
+
+			image.SetPixel(width - 1, 1, 0x01000000);
+			EXPECT_TRUE(HasAlpha(image.GetConstView(), instructionSet));
+		}
+	}
+}
+
+namespace
+{
+	const ResampleFilter RESAMPLE_FILTERS[] = { ResampleFilter::Box, ResampleFilter::Lanczos3 };
+}
+
+TEST(PixelKernelsTest, ResampleToSameSizeCopies)
+{
+	std::mt19937 generator(1);
+
+	TestImage source(37, 11);
+	source.Randomize(generator);
+
+	// Random pixels aren't valid premultiplied values, so are only left
+	// untouched by the box filter.
+	for (auto instructionSet : GetSupportedInstructionSets())
+	{
+		TestImage destination(37, 11);
+		Resample(source.GetConstView(), destination.GetView(), ResampleFilter::Box, instructionSet);
+
+		for (int y = 0; y < 11; y++)
+		{
+			for (int x = 0; x < 37; x++)
+			{
+				ASSERT_EQ(source.GetPixel(x, y), destination.GetPixel(x, y));
+			}
+		}
+	}
+}
+
+TEST(PixelKernelsTest, ResampleSolidColor)
+{
+	TestImage source(50, 40);
+	Fill(source.GetView(), 0x80402010);
+
+	for (auto filter : RESAMPLE_FILTERS)
+	{
+		for (auto instructionSet : GetSupportedInstructionSets())
+		{
+			for (auto [width, height] : { std::pair(33, 71), std::pair(7, 3), std::pair(50, 40) })
+			{
+				TestImage destination(width, height);
+				Resample(source.GetConstView(), destination.GetView(), filter, instructionSet);
+
+				for (int y = 0; y < height; y++)
+				{
+					for (int x = 0; x < width; x++)
+					{
+						ASSERT_EQ(0x80402010u, destination.GetPixel(x, y));
+					}
+				}
+			}
+		}
+	}
+}
+
+TEST(PixelKernelsTest, ResampleBox)
+{
+	// Each output pixel is the average of the three source pixels it
+	// covers.
+	TestImage source(6, 1);
+	source.SetPixel(0, 0, 0x00000000);
+	source.SetPixel(1, 0, 0x30303030);
+	source.SetPixel(2, 0, 0x60606060);
+	source.SetPixel(3, 0, 0xFFFFFFFF);
+	source.SetPixel(4, 0, 0xFFFFFFFF);
+	source.SetPixel(5, 0, 0xFFFFFFFF);
+
+	for (auto instructionSet : GetSupportedInstructionSets())
+	{
+		TestImage destination(2, 1);
+		Resample(source.GetConstView(), destination.GetView(), ResampleFilter::Box, instructionSet);
+
+		EXPECT_EQ(0x30303030u, destination.GetPixel(0, 0));
+		EXPECT_EQ(0xFFFFFFFFu, destination.GetPixel(1, 0));
+	}
+
+	// When enlarging, the box filter interpolates linearly (with the outer
+	// pixels clamped to the edges).
+	TestImage gradient(2, 1);
+	gradient.SetPixel(0, 0, 0x00000000);
+	gradient.SetPixel(1, 0, 0x80808080);
+
+	TestImage enlarged(4, 1);
+	Resample(gradient.GetConstView(), enlarged.GetView(), ResampleFilter::Box);
+
+	EXPECT_EQ(0x00000000u, enlarged.GetPixel(0, 0));
+	EXPECT_EQ(0x20202020u, enlarged.GetPixel(1, 0));
+	EXPECT_EQ(0x60606060u, enlarged.GetPixel(2, 0));
+	EXPECT_EQ(0x80808080u, enlarged.GetPixel(3, 0));
+}
+
+// A large reduction should take every source pixel into account, rather
+// than sampling a few of them.
+TEST(PixelKernelsTest, ResampleLargeReduction)
+{
+	TestImage source(64, 64);
+
+	for (int y = 0; y < 64; y++)
+	{
+		for (int x = 0; x < 64; x++)
+		{
+			source.SetPixel(x, y, ((x + y) % 2 == 0) ? 0xFFFFFFFF : 0xFF000000);
+		}
+	}
+
+	for (auto filter : RESAMPLE_FILTERS)
+	{
+		TestImage destination(4, 4);
+		Resample(source.GetConstView(), destination.GetView(), filter);
+
+		for (int y = 0; y < 4; y++)
+		{
+			for (int x = 0; x < 4; x++)
+			{
+				uint32_t pixel = destination.GetPixel(x, y);
+				EXPECT_EQ(0xFFu, pixel >> 24);
+				EXPECT_NEAR(128, static_cast<int>(pixel & 0xFF), 2);
+			}
+		}
+	}
+}
+
+// The negative lobes of the Lanczos filter overshoot at sharp edges. The
+// result should still be valid premultiplied pixels.
+TEST(PixelKernelsTest, ResampleLanczosStaysPremultiplied)
+{
+	std::mt19937 generator(2);
+
+	TestImage source(90, 70);
+	source.Randomize(generator);
+	ConvertToPremultiplied(source.GetView(), AlphaMode::Straight);
+
+	for (auto instructionSet : GetSupportedInstructionSets())
+	{
+		for (auto [width, height] : { std::pair(31, 23), std::pair(200, 150) })
+		{
+			TestImage destination(width, height);
+			Resample(source.GetConstView(), destination.GetView(), ResampleFilter::Lanczos3, instructionSet);
+
+			for (int y = 0; y < height; y++)
+			{
+				for (int x = 0; x < width; x++)
+				{
+					uint32_t pixel = destination.GetPixel(x, y);
+					uint32_t alpha = pixel >> 24;
+
+					ASSERT_LE((pixel >> 16) & 0xFF, alpha);
+					ASSERT_LE((pixel >> 8) & 0xFF, alpha);
+					ASSERT_LE(pixel & 0xFF, alpha);
+				}
+			}
+		}
+	}
+}
+
+TEST(PixelKernelsTest, LetterboxRect)
+{
+	// Images that fit are centered at their original size.
+	Rect rect = GetLetterboxRect(32, 32, 120, 120);
+	EXPECT_EQ(44, rect.x);
+	EXPECT_EQ(44, rect.y);
+	EXPECT_EQ(32, rect.width);
+	EXPECT_EQ(32, rect.height);
+
+	rect = GetLetterboxRect(240, 120, 120, 120);
+	EXPECT_EQ(0, rect.x);
+	EXPECT_EQ(30, rect.y);
+	EXPECT_EQ(120, rect.width);
+	EXPECT_EQ(60, rect.height);
+
+	rect = GetLetterboxRect(100, 300, 120, 120);
+	EXPECT_EQ(40, rect.x);
+	EXPECT_EQ(0, rect.y);
+	EXPECT_EQ(40, rect.width);
+	EXPECT_EQ(120, rect.height);
+
+	// Very thin images are still at least a pixel wide.
+	rect = GetLetterboxRect(10000, 1, 120, 120);
+	EXPECT_EQ(120, rect.width);
+	EXPECT_EQ(1, rect.height);
+}
+
+TEST(PixelKernelsTest, Letterbox)
+{
+	TestImage source(400, 200);
+	Fill(source.GetView(), 0xFF336699);
+
+	for (auto instructionSet : GetSupportedInstructionSets())
+	{
+		TestImage destination(120, 120);
+		Letterbox(source.GetConstView(), destination.GetView(), 0, ResampleFilter::Box, instructionSet);
+
+		Rect rect = GetLetterboxRect(400, 200, 120, 120);
+
+		for (int y = 0; y < 120; y++)
+		{
+			for (int x = 0; x < 120; x++)
+			{
+				bool inside = x >= rect.x && x < rect.x + rect.width && y >= rect.y && y < rect.y + rect.height;
+				ASSERT_EQ(inside ? 0xFF336699u : 0u, destination.GetPixel(x, y));
+			}
+		}
+
+		// The padding after each row is left untouched.
+		EXPECT_EQ(0xDEADBEEF, destination.GetConstView().pixels[120]);
+	}
+}
+
+// Each vectorized implementation should produce exactly the same output as
+// the portable implementation, for arbitrary input.
+TEST(PixelKernelsTest, InstructionSetsMatch)
+{
+	std::mt19937 generator(1234);
+	std::uniform_int_distribution<int> sizeDistribution(1, 300);
+
+	for (int i = 0; i < 200; i++)
+	{
+		int sourceWidth = sizeDistribution(generator);
+		int sourceHeight = sizeDistribution(generator);
+		int destinationWidth = (std::min)(sizeDistribution(generator), 2 * sourceWidth);
+		int destinationHeight = (std::min)(sizeDistribution(generator), 2 * sourceHeight);
+
+		TestImage source(sourceWidth, sourceHeight);
+		source.Randomize(generator);
+
+		TestImage expectedPremultiplied = source;
+		ConvertToPremultiplied(expectedPremultiplied.GetView(), AlphaMode::Straight, InstructionSet::Portable);
+
+		ResampleFilter filter = RESAMPLE_FILTERS[i % 2];
+
+		TestImage expectedResampled(destinationWidth, destinationHeight);
+		Resample(source.GetConstView(), expectedResampled.GetView(), filter, InstructionSet::Portable);
+
+		TestImage expectedLetterboxed(destinationWidth, destinationHeight);
+		Letterbox(source.GetConstView(), expectedLetterboxed.GetView(), 0x12345678, filter,
+			InstructionSet::Portable);
+
+		for (auto instructionSet : GetSupportedInstructionSets())
+		{
+			TestImage premultiplied = source;
+			ConvertToPremultiplied(premultiplied.GetView(), AlphaMode::Straight, instructionSet);
+			ASSERT_TRUE(premultiplied == expectedPremultiplied);
+
+			TestImage resampled(destinationWidth, destinationHeight);
+			Resample(source.GetConstView(), resampled.GetView(), filter, instructionSet);
+			ASSERT_TRUE(resampled == expectedResampled);
+
+			TestImage letterboxed(destinationWidth, destinationHeight);
+			Letterbox(source.GetConstView(), letterboxed.GetView(), 0x12345678, filter, instructionSet);
+			ASSERT_TRUE(letterboxed == expectedLetterboxed);
+
+			EXPECT_EQ(HasAlpha(source.GetConstView(), InstructionSet::Portable),
+				HasAlpha(source.GetConstView(), instructionSet));
+		}
+	}
+}
+
+// Measures the time taken to premultiply a typical extracted image and
+// letterbox it into a thumbnail (with each filter), as well as the time taken
+// to derive a smaller thumbnail from a cached one, with each instruction set.
+// Run with --gtest_also_run_disabled_tests.
+TEST(PixelKernelsTest, DISABLED_Benchmark)
+{
+	const int NUM_ITERATIONS = 500;
+
+	std::mt19937 generator(1234);
+
+	TestImage source(1024, 768, 0);
+	source.Randomize(generator);
+
+	TestImage destination(120, 120, 0);
+
+	TestImage cachedThumbnail(512, 384, 0);
+	Resample(source.GetConstView(), cachedThumbnail.GetView(), ResampleFilter::Box);
+
+	auto toMicroseconds = [] (auto duration) {
+		return static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+	};
+
+	const char *names[] = { "Portable", "SSE2", "AVX2" };
+
+	for (auto instructionSet : GetSupportedInstructionSets())
+	{
+		TestImage premultiplied = source;
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < NUM_ITERATIONS; i++)
+		{
+			ConvertToPremultiplied(premultiplied.GetView(), AlphaMode::Straight, instructionSet);
+		}
+
+		auto premultiplyDuration = std::chrono::steady_clock::now() - start;
+
+		printf("%s: premultiply %lld us", names[static_cast<int>(instructionSet)],
+			toMicroseconds(premultiplyDuration) / NUM_ITERATIONS);
+
+		for (auto filter : RESAMPLE_FILTERS)
+		{
+			start = std::chrono::steady_clock::now();
+
+			for (int i = 0; i < NUM_ITERATIONS; i++)
+			{
+				Letterbox(source.GetConstView(), destination.GetView(), 0, filter, instructionSet);
+			}
+
+			auto letterboxDuration = std::chrono::steady_clock::now() - start;
+
+			start = std::chrono::steady_clock::now();
+
+			for (int i = 0; i < NUM_ITERATIONS; i++)
+			{
+				Letterbox(cachedThumbnail.GetConstView(), destination.GetView(), 0, filter, instructionSet);
+			}
+
+			auto deriveDuration = std::chrono::steady_clock::now() - start;
+
+			printf(", %s letterbox %lld us (derived from 512x384: %lld us)",
+				(filter == ResampleFilter::Box) ? "box" : "Lanczos",
+				toMicroseconds(letterboxDuration) / NUM_ITERATIONS, toMicroseconds(deriveDuration) / NUM_ITERATIONS);
+		}
+
+		printf(" (per 1024x768 image)\n");
+	}
+}
@@ -0,0 +1,480 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/ProgressiveEnumeration.h"
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+using namespace ProgressiveEnumeration;
+
+namespace
+{
+	class VectorSource : public EnumerationSource<int>
+	{
+	public:
+
+		VectorSource(std::vector<int> items, std::chrono::milliseconds readDelay = std::chrono::milliseconds(0),
+			size_t maxItemsPerRead = SIZE_MAX) :
+			m_items(std::move(items)),
+			m_readDelay(readDelay),
+			m_maxItemsPerRead(maxItemsPerRead),
+			m_position(0),
+			m_numReads(0)
+		{
+
+		}
+
+		bool GetNextItems(size_t maxItems, std::vector<int> &items) override
+		{
+			m_numReads++;
+
+			if (m_readDelay.count() > 0)
+			{
+				std::this_thread::sleep_for(m_readDelay);
+			}
+
+			size_t count = (std::min)({ maxItems, m_maxItemsPerRead, m_items.size() - m_position });
+			items.insert(items.end(), m_items.begin() + m_position, m_items.begin() + m_position + count);
+			m_position += count;
+
+			return m_position < m_items.size();
+		}
+
+		size_t GetPosition() const
+		{
+			return m_position;
+		}
+
+		int GetNumReads() const
+		{
+			return m_numReads;
+		}
+
+	private:
+
+		const std::vector<int> m_items;
+		const std::chrono::milliseconds m_readDelay;
+		const size_t m_maxItemsPerRead;
+		size_t m_position;
+		int m_numReads;
+	};
+
+	struct Batch
+	{
+		std::vector<int> items;
+		bool finished;
+	};
+
+	std::vector<int> BuildItems(int count)
+	{
+		std::vector<int> items(count);
+		std::iota(items.begin(), items.end(), 0);
+		return items;
+	}
+
+	std::vector<Batch> RunToCompletion(EnumerationSource<int> &source, const Settings &settings)
+	{
+		std::atomic<bool> cancelled = false;
+		std::vector<Batch> batches;
+
+		bool completed = EnumerateInBatches<int>(source, settings, cancelled,
+			[&batches] (std::vector<int> items, bool finished) {
+			batches.push_back({ std::move(items), finished });
+		});
+
+		EXPECT_TRUE(completed);
+
+		return batches;
+	}
+
+	std::vector<int> Concatenate(const std::vector<Batch> &batches)
+	{
+		std::vector<int> items;
+
+		for (const auto &batch : batches)
+		{
+			items.insert(items.end(), batch.items.begin(), batch.items.end());
+		}
+
+		return items;
+	}
+
+	void CheckOnlyLastBatchFinished(const std::vector<Batch> &batches)
+	{
+		ASSERT_FALSE(batches.empty());
+
+		for (size_t i = 0; i < batches.size() - 1; i++)
+		{
+			EXPECT_FALSE(batches[i].finished);
+		}
+
+		EXPECT_TRUE(batches.back().finished);
+	}
+}
+
+TEST(ProgressiveEnumerationTest, AllItemsPublished)
+{
+	auto items = BuildItems(100000);
+	VectorSource source(items);
+
+	Settings settings;
+	settings.maxBatchSize = 10000;
+
+	auto batches = RunToCompletion(source, settings);
+
+	CheckOnlyLastBatchFinished(batches);
+	EXPECT_EQ(items, Concatenate(batches));
+
+	for (const auto &batch : batches)
+	{
+		EXPECT_LE(batch.items.size(), settings.maxBatchSize + settings.maxReadSize);
+	}
+}
+
+TEST(ProgressiveEnumerationTest, EmptySource)
+{
+	VectorSource source({});
+
+	auto batches = RunToCompletion(source, Settings());
+
+	ASSERT_EQ(1U, batches.size());
+	EXPECT_TRUE(batches[0].items.empty());
+	EXPECT_TRUE(batches[0].finished);
+}
+
+TEST(ProgressiveEnumerationTest, FirstBatchIsOneScreenful)
+{
+	VectorSource source(BuildItems(5000));
+
+	Settings settings;
+	settings.firstBatchSize = 100;
+	settings.firstBatchLatency = std::chrono::hours(1);
+
+	auto batches = RunToCompletion(source, settings);
+
+	ASSERT_GE(batches.size(), 2U);
+	EXPECT_EQ(100U, batches[0].items.size());
+	EXPECT_FALSE(batches[0].finished);
+}
+
+TEST(ProgressiveEnumerationTest, SmallFolderPublishedInOneBatch)
+{
+	auto items = BuildItems(50);
+	VectorSource source(items);
+
+	Settings settings;
+	settings.firstBatchSize = 100;
+
+	auto batches = RunToCompletion(source, settings);
+
+	ASSERT_EQ(1U, batches.size());
+	EXPECT_EQ(items, batches[0].items);
+	EXPECT_TRUE(batches[0].finished);
+}
+
+TEST(ProgressiveEnumerationTest, FirstBatchWithinLatencyBudget)
+{
+	// A slow source that only ever returns a few items at a time. The first
+	// screenful would take seconds to arrive.
+	VectorSource source(BuildItems(100), std::chrono::milliseconds(5), 2);
+
+	Settings settings;
+	settings.firstBatchSize = 100;
+	settings.firstBatchLatency = std::chrono::milliseconds(50);
+	settings.batchInterval = std::chrono::milliseconds(0);
+
+	std::atomic<bool> cancelled = false;
+	std::vector<Batch> batches;
+	size_t positionAtFirstBatch = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::duration timeToFirstBatch{};
+
+	EnumerateInBatches<int>(source, settings, cancelled, [&] (std::vector<int> items, bool finished) {
+		if (batches.empty())
+		{
+			timeToFirstBatch = std::chrono::steady_clock::now() - start;
+			positionAtFirstBatch = source.GetPosition();
+		}
+
+		batches.push_back({ std::move(items), finished });
+	});
+
+	ASSERT_GE(batches.size(), 2U);
+	EXPECT_FALSE(batches[0].items.empty());
+	EXPECT_LT(positionAtFirstBatch, 100U);
+	EXPECT_LT(timeToFirstBatch, std::chrono::milliseconds(1000));
+	EXPECT_EQ(BuildItems(100), Concatenate(batches));
+}
+
+TEST(ProgressiveEnumerationTest, ReadsGrow)
+{
+	VectorSource source(BuildItems(100000));
+
+	Settings settings;
+	settings.firstBatchSize = 64;
+	settings.initialReadSize = 64;
+	settings.maxReadSize = 4096;
+
+	RunToCompletion(source, settings);
+
+	// One read of 64 items for the first batch, then reads of 128, 256,
+	// ..., 4096 (6 reads, totalling 8064 items), then 23 reads of up to
+	// 4096 items for the remaining 91872 items.
+	EXPECT_EQ(30, source.GetNumReads());
+}
+
+TEST(ProgressiveEnumerationTest, Cancel)
+{
+	VectorSource source(BuildItems(100000));
+
+	Settings settings;
+	settings.firstBatchSize = 100;
+	settings.maxBatchSize = 1000;
+
+	std::atomic<bool> cancelled = false;
+	std::vector<Batch> batches;
+
+	bool completed = EnumerateInBatches<int>(source, settings, cancelled, [&] (std::vector<int> items, bool finished) {
+		batches.push_back({ std::move(items), finished });
+
+		// For example, the user navigating away.
+		if (batches.size() == 3)
+		{
+			cancelled = true;
+		}
+	});
+
+	EXPECT_FALSE(completed);
+	EXPECT_EQ(3U, batches.size());
+	EXPECT_FALSE(batches.back().finished);
+	EXPECT_LT(source.GetPosition(), 100000U);
+}
+
+TEST(ProgressiveEnumerationTest, CancelBeforeStart)
+{
+	VectorSource source(BuildItems(1000));
+
+	std::atomic<bool> cancelled = true;
+	bool callbackInvoked = false;
+
+	bool completed = EnumerateInBatches<int>(source, Settings(), cancelled, [&] (std::vector<int>, bool) {
+		callbackInvoked = true;
+	});
+
+	EXPECT_FALSE(completed);
+	EXPECT_FALSE(callbackInvoked);
+	EXPECT_EQ(0, source.GetNumReads());
+}
+
+TEST(ProgressiveEnumerationTest, MergeSortedBatch)
+{
+	std::mt19937 generator(1234);
+	std::uniform_int_distribution<int> distribution(0, 500);
+
+	std::vector<int> items;
+
+	// This simulates a view that items are inserted into one at a time.
+	std::vector<int> view;
+
+	for (int i = 0; i < 50; i++)
+	{
+		std::vector<int> batch(generator() % 200);
+		std::generate(batch.begin(), batch.end(), [&] { return distribution(generator); });
+		std::sort(batch.begin(), batch.end());
+
+		auto positions = MergeSortedBatch(items, batch, std::less<int>());
+
+		ASSERT_EQ(batch.size(), positions.size());
+		EXPECT_TRUE(std::is_sorted(positions.begin(), positions.end()));
+		EXPECT_TRUE(std::is_sorted(items.begin(), items.end()));
+
+		for (size_t j = 0; j < batch.size(); j++)
+		{
+			EXPECT_EQ(batch[j], items[positions[j]]);
+			view.insert(view.begin() + positions[j], batch[j]);
+		}
+
+		EXPECT_EQ(items, view);
+	}
+}
+
+TEST(ProgressiveEnumerationTest, MergeSortedBatchIsStable)
+{
+	using Item = std::pair<int, char>;
+
+	std::vector<Item> items = { { 1, 'a' }, { 2, 'a' }, { 2, 'b' }, { 4, 'a' } };
+	std::vector<Item> batch = { { 0, 'c' }, { 2, 'c' }, { 5, 'c' } };
+
+	auto positions = MergeSortedBatch(items, batch, [] (const Item &item1, const Item &item2) {
+		return item1.first < item2.first;
+	});
+
+	std::vector<Item> expectedItems = { { 0, 'c' }, { 1, 'a' }, { 2, 'a' }, { 2, 'b' }, { 2, 'c' }, { 4, 'a' },
+		{ 5, 'c' } };
+	std::vector<size_t> expectedPositions = { 0, 4, 6 };
+
+	EXPECT_EQ(expectedItems, items);
+	EXPECT_EQ(expectedPositions, positions);
+}
+
+#ifndef _WIN32
+
+namespace
+{
+	// Enumerates a directory using readdir(). This mirrors the way the shell
+	// enumerator is used, but allows the enumeration logic to be tested
+	// against a real directory.
+	class ReaddirSource : public EnumerationSource<std::string>
+	{
+	public:
+
+		explicit ReaddirSource(const std::string &path) :
+			m_dir(opendir(path.c_str()))
+		{
+
+		}
+
+		~ReaddirSource()
+		{
+			if (m_dir)
+			{
+				closedir(m_dir);
+			}
+		}
+
+		bool GetNextItems(size_t maxItems, std::vector<std::string> &items) override
+		{
+			if (!m_dir)
+			{
+				return false;
+			}
+
+			for (size_t i = 0; i < maxItems; i++)
+			{
+				dirent *entry = readdir(m_dir);
+
+				if (!entry)
+				{
+					return false;
+				}
+
+				std::string name = entry->d_name;
+
+				if (name == "." || name == "..")
+				{
+					i--;
+					continue;
+				}
+
+				items.push_back(std::move(name));
+			}
+
+			return true;
+		}
+
+	private:
+
+		DIR *m_dir;
+	};
+
+	class TemporaryDirectory
+	{
+	public:
+
+		TemporaryDirectory()
+		{
+			char pathTemplate[] = "/tmp/progressive_enumeration_XXXXXX";
+			m_path = mkdtemp(pathTemplate);
+		}
+
+		~TemporaryDirectory()
+		{
+			for (const auto &fileName : m_fileNames)
+			{
+				unlink((m_path + "/" + fileName).c_str());
+			}
+
+			rmdir(m_path.c_str());
+		}
+
+		void CreateFile(const std::string &fileName)
+		{
+			int fd = open((m_path + "/" + fileName).c_str(), O_CREAT | O_WRONLY, 0644);
+			ASSERT_NE(-1, fd);
+			close(fd);
+
+			m_fileNames.push_back(fileName);
+		}
+
+		const std::string &GetPath() const
+		{
+			return m_path;
+		}
+
+	private:
+
+		std::string m_path;
+		std::vector<std::string> m_fileNames;
+	};
+}
+
+TEST(ProgressiveEnumerationTest, ReaddirSource)
+{
+	TemporaryDirectory directory;
+	std::vector<std::string> expectedNames;
+
+	for (int i = 0; i < 1000; i++)
+	{
+		std::string fileName = "file" + std::to_string(i) + ".txt";
+		directory.CreateFile(fileName);
+		expectedNames.push_back(fileName);
+	}
+
+	ReaddirSource source(directory.GetPath());
+
+	Settings settings;
+	settings.firstBatchSize = 100;
+	settings.maxBatchSize = 500;
+
+	std::atomic<bool> cancelled = false;
+	std::vector<std::string> sortedNames;
+	size_t numBatches = 0;
+	bool finished = false;
+
+	bool completed = EnumerateInBatches<std::string>(source, settings, cancelled,
+		[&] (std::vector<std::string> names, bool batchFinished) {
+		if (numBatches == 0)
+		{
+			EXPECT_EQ(100U, names.size());
+		}
+
+		numBatches++;
+		finished = batchFinished;
+
+		// Each batch is sorted and merged in, as the view does.
+		std::sort(names.begin(), names.end());
+		MergeSortedBatch(sortedNames, std::move(names), std::less<std::string>());
+	});
+
+	EXPECT_TRUE(completed);
+	EXPECT_TRUE(finished);
+	EXPECT_GE(numBatches, 2U);
+
+	std::sort(expectedNames.begin(), expectedNames.end());
+	EXPECT_EQ(expectedNames, sortedNames);
+}
+
+#endif
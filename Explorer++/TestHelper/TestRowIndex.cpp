@@ -0,0 +1,180 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/RowIndex.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// The expected row for each ID, determined by searching the rows.
+	int FindRowBySearching(const std::vector<int> &rows, int id)
+	{
+		auto itr = std::find(rows.begin(), rows.end(), id);
+
+		if (itr == rows.end())
+		{
+			return -1;
+		}
+
+		return static_cast<int>(itr - rows.begin());
+	}
+}
+
+TEST(RowIndexTest, InsertAndFind)
+{
+	RowIndex rowIndex;
+
+	rowIndex.InsertRow(0, 5);
+	rowIndex.InsertRow(1, 7);
+	rowIndex.InsertRow(0, 2);
+
+	EXPECT_EQ(3, rowIndex.GetNumRows());
+	EXPECT_EQ(0, rowIndex.FindRow(2));
+	EXPECT_EQ(1, rowIndex.FindRow(5));
+	EXPECT_EQ(2, rowIndex.FindRow(7));
+	EXPECT_EQ(-1, rowIndex.FindRow(3));
+	EXPECT_EQ(-1, rowIndex.FindRow(100));
+
+	EXPECT_EQ(2, rowIndex.GetId(0));
+	EXPECT_EQ(5, rowIndex.GetId(1));
+	EXPECT_EQ(7, rowIndex.GetId(2));
+}
+
+TEST(RowIndexTest, RemoveRows)
+{
+	RowIndex rowIndex;
+
+	for (int i = 0; i < 10; i++)
+	{
+		rowIndex.InsertRow(i, i);
+	}
+
+	// Given out of order (and with a duplicate).
+	rowIndex.RemoveRows({ 7, 2, 3, 7 });
+
+	EXPECT_EQ(7, rowIndex.GetNumRows());
+	EXPECT_EQ(-1, rowIndex.FindRow(2));
+	EXPECT_EQ(-1, rowIndex.FindRow(3));
+	EXPECT_EQ(-1, rowIndex.FindRow(7));
+	EXPECT_EQ(0, rowIndex.FindRow(0));
+	EXPECT_EQ(1, rowIndex.FindRow(1));
+	EXPECT_EQ(2, rowIndex.FindRow(4));
+	EXPECT_EQ(4, rowIndex.FindRow(6));
+	EXPECT_EQ(5, rowIndex.FindRow(8));
+	EXPECT_EQ(6, rowIndex.FindRow(9));
+
+	// A removed ID can be inserted again.
+	rowIndex.InsertRow(0, 7);
+	EXPECT_EQ(0, rowIndex.FindRow(7));
+	EXPECT_EQ(7, rowIndex.FindRow(9));
+}
+
+TEST(RowIndexTest, SetRows)
+{
+	RowIndex rowIndex;
+
+	rowIndex.InsertRow(0, 1);
+	rowIndex.InsertRow(1, 2);
+	rowIndex.InsertRow(2, 3);
+
+	rowIndex.SetRows({ 3, 4, 1 });
+
+	EXPECT_EQ(3, rowIndex.GetNumRows());
+	EXPECT_EQ(0, rowIndex.FindRow(3));
+	EXPECT_EQ(1, rowIndex.FindRow(4));
+	EXPECT_EQ(2, rowIndex.FindRow(1));
+	EXPECT_EQ(-1, rowIndex.FindRow(2));
+}
+
+TEST(RowIndexTest, Clear)
+{
+	RowIndex rowIndex;
+
+	rowIndex.InsertRow(0, 1);
+	rowIndex.Clear();
+
+	EXPECT_EQ(0, rowIndex.GetNumRows());
+	EXPECT_EQ(-1, rowIndex.FindRow(1));
+}
+
+// Applies random inserts, removals and reorders, checking every lookup
+// against a search of a plain list of rows.
+TEST(RowIndexTest, MatchesReference)
+{
+	const int MAX_ID = 200;
+
+	std::mt19937 generator(1234);
+	std::uniform_int_distribution<int> operationDistribution(0, 9);
+	std::uniform_int_distribution<int> idDistribution(0, MAX_ID - 1);
+
+	RowIndex rowIndex;
+	std::vector<int> rows;
+
+	for (int i = 0; i < 20000; i++)
+	{
+		int operation = operationDistribution(generator);
+
+		if (operation < 5)
+		{
+			int id = idDistribution(generator);
+
+			if (FindRowBySearching(rows, id) == -1)
+			{
+				int row = std::uniform_int_distribution<int>(0, static_cast<int>(rows.size()))(generator);
+				rows.insert(rows.begin() + row, id);
+				rowIndex.InsertRow(row, id);
+			}
+		}
+		else if (operation < 8 && !rows.empty())
+		{
+			std::uniform_int_distribution<int> rowDistribution(0, static_cast<int>(rows.size()) - 1);
+			std::vector<int> removedRows;
+			int numRemoved = std::uniform_int_distribution<int>(1, 4)(generator);
+
+			for (int j = 0; j < numRemoved; j++)
+			{
+				removedRows.push_back(rowDistribution(generator));
+			}
+
+			std::vector<int> sortedRows = removedRows;
+			std::sort(sortedRows.begin(), sortedRows.end());
+			sortedRows.erase(std::unique(sortedRows.begin(), sortedRows.end()), sortedRows.end());
+
+			for (auto itr = sortedRows.rbegin(); itr != sortedRows.rend(); ++itr)
+			{
+				rows.erase(rows.begin() + *itr);
+			}
+
+			rowIndex.RemoveRows(removedRows);
+		}
+		else if (operation == 8)
+		{
+			std::shuffle(rows.begin(), rows.end(), generator);
+			rowIndex.SetRows(rows);
+		}
+
+		ASSERT_EQ(static_cast<int>(rows.size()), rowIndex.GetNumRows());
+
+		// Only some of the lookups are checked each time, so that the
+		// index is left with stale positions between operations.
+		for (int j = 0; j < 3; j++)
+		{
+			int id = idDistribution(generator);
+			ASSERT_EQ(FindRowBySearching(rows, id), rowIndex.FindRow(id));
+		}
+	}
+
+	for (int id = 0; id < MAX_ID; id++)
+	{
+		ASSERT_EQ(FindRowBySearching(rows, id), rowIndex.FindRow(id));
+	}
+
+	for (int row = 0; row < rowIndex.GetNumRows(); row++)
+	{
+		EXPECT_EQ(rows[row], rowIndex.GetId(row));
+	}
+}
@@ -0,0 +1,278 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/SnapshotArena.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// The number of PIDLs allocated for synthetic items. Copying an item
+	// deep-copies its PIDLs, so this allows the benchmark below to report
+	// the allocations that sharing a snapshot avoids.
+	std::atomic<size_t> g_numPidlAllocations(0);
+
+	struct CountedItem
+	{
+		CountedItem(int value, std::atomic<int> &numDestroyed) :
+			value(value),
+			numDestroyed(numDestroyed)
+		{
+
+		}
+
+		~CountedItem()
+		{
+			numDestroyed++;
+		}
+
+		int value;
+		std::atomic<int> &numDestroyed;
+	};
+
+	// Mirrors the layout of BasicItemInfo_t: two separately allocated
+	// PIDLs, along with the find data and display name held inline. As with
+	// BasicItemInfo_t, copying the item deep-copies both PIDLs.
+	struct SyntheticItem
+	{
+		static const size_t PIDL_SIZE = 64;
+
+		static std::unique_ptr<unsigned char[]> AllocatePidl()
+		{
+			g_numPidlAllocations++;
+			return std::unique_ptr<unsigned char[]>(new unsigned char[PIDL_SIZE]);
+		}
+
+		explicit SyntheticItem(int index) :
+			pidlComplete(AllocatePidl()),
+			pidlChild(AllocatePidl()),
+			findData(),
+			displayName()
+		{
+			std::memset(pidlComplete.get(), index & 0xFF, PIDL_SIZE);
+			std::memset(pidlChild.get(), index & 0xFF, PIDL_SIZE);
+			findData[0] = static_cast<unsigned char>(index);
+			displayName[0] = L'a' + (index % 26);
+		}
+
+		SyntheticItem(SyntheticItem &&) = default;
+
+		SyntheticItem(const SyntheticItem &other) :
+			pidlComplete(AllocatePidl()),
+			pidlChild(AllocatePidl())
+		{
+			std::memcpy(pidlComplete.get(), other.pidlComplete.get(), PIDL_SIZE);
+			std::memcpy(pidlChild.get(), other.pidlChild.get(), PIDL_SIZE);
+			std::memcpy(findData, other.findData, sizeof(findData));
+			std::memcpy(displayName, other.displayName, sizeof(displayName));
+		}
+
+		std::unique_ptr<unsigned char[]> pidlComplete;
+		std::unique_ptr<unsigned char[]> pidlChild;
+
+		// sizeof(WIN32_FIND_DATAW) and MAX_PATH.
+		unsigned char findData[592];
+		wchar_t displayName[260];
+	};
+
+	unsigned int ReadItem(const SyntheticItem &item)
+	{
+		return item.pidlComplete[0] + item.pidlChild[0] + item.findData[0] + item.displayName[0];
+	}
+}
+
+TEST(SnapshotArenaTest, MakeSnapshot)
+{
+	auto arena = SnapshotArena<std::pair<int, double>>::Create();
+
+	auto snapshot1 = arena->MakeSnapshot(1, 2.5);
+	auto snapshot2 = arena->MakeSnapshot(2, 3.5);
+
+	EXPECT_EQ(1, snapshot1->first);
+	EXPECT_EQ(2.5, snapshot1->second);
+	EXPECT_EQ(2, snapshot2->first);
+
+	EXPECT_EQ(2U, arena->GetNumSnapshots());
+	EXPECT_EQ(1U, arena->GetNumBlocks());
+
+	// Copying a snapshot shares the underlying data.
+	auto copy = snapshot1;
+	EXPECT_EQ(snapshot1.get(), copy.get());
+}
+
+TEST(SnapshotArenaTest, Blocks)
+{
+	const size_t BLOCK_SIZE = 4096;
+	auto arena = SnapshotArena<SyntheticItem>::Create(BLOCK_SIZE);
+
+	std::vector<std::shared_ptr<const SyntheticItem>> snapshots;
+
+	for (int i = 0; i < 100; i++)
+	{
+		snapshots.push_back(arena->MakeSnapshot(i));
+	}
+
+	// Multiple snapshots should fit into each block.
+	size_t snapshotsPerBlock = BLOCK_SIZE / (sizeof(SyntheticItem) + 64);
+	EXPECT_LE(arena->GetNumBlocks(), (snapshots.size() + snapshotsPerBlock - 1) / snapshotsPerBlock);
+	EXPECT_EQ(arena->GetNumBlocks() * BLOCK_SIZE, arena->GetMemoryUsage());
+
+	for (int i = 0; i < 100; i++)
+	{
+		EXPECT_EQ(L'a' + (i % 26), snapshots[i]->displayName[0]);
+		EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(snapshots[i].get()) % alignof(SyntheticItem));
+	}
+
+	// A snapshot larger than the block size gets a block to itself.
+	auto smallArena = SnapshotArena<SyntheticItem>::Create(16);
+	auto snapshot = smallArena->MakeSnapshot(1);
+	auto snapshot2 = smallArena->MakeSnapshot(2);
+	EXPECT_EQ(2U, smallArena->GetNumBlocks());
+	EXPECT_EQ(L'b', snapshot->displayName[0]);
+	EXPECT_EQ(L'c', snapshot2->displayName[0]);
+}
+
+TEST(SnapshotArenaTest, SnapshotsOutliveArena)
+{
+	std::atomic<int> numDestroyed(0);
+
+	auto arena = SnapshotArena<CountedItem>::Create();
+	auto snapshot1 = arena->MakeSnapshot(1, numDestroyed);
+	auto snapshot2 = arena->MakeSnapshot(2, numDestroyed);
+
+	// The arena is released when the folder is left, but any snapshots
+	// still held elsewhere should remain valid.
+	arena.reset();
+
+	snapshot1.reset();
+	EXPECT_EQ(1, numDestroyed);
+
+	EXPECT_EQ(2, snapshot2->value);
+
+	snapshot2.reset();
+	EXPECT_EQ(2, numDestroyed);
+}
+
+TEST(SnapshotArenaTest, ReleasedOnOtherThreads)
+{
+	const int NUM_SNAPSHOTS = 10000;
+	const int NUM_THREADS = 4;
+
+	std::atomic<int> numDestroyed(0);
+	std::atomic<int> sum(0);
+
+	std::vector<std::thread> threads;
+
+	{
+		auto arena = SnapshotArena<CountedItem>::Create();
+		std::vector<std::shared_ptr<const CountedItem>> snapshots;
+
+		for (int i = 0; i < NUM_SNAPSHOTS; i++)
+		{
+			snapshots.push_back(arena->MakeSnapshot(i, numDestroyed));
+		}
+
+		for (int i = 0; i < NUM_THREADS; i++)
+		{
+			threads.emplace_back([snapshots, i, &sum] {
+				for (size_t j = i; j < snapshots.size(); j += NUM_THREADS)
+				{
+					sum += snapshots[j]->value;
+				}
+			});
+		}
+	}
+
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+
+	EXPECT_EQ((NUM_SNAPSHOTS - 1) * NUM_SNAPSHOTS / 2, sum);
+	EXPECT_EQ(NUM_SNAPSHOTS, numDestroyed);
+}
+
+// Compares copying each item into every task that uses it (as happens with
+// BasicItemInfo_t) to sharing a single snapshot of each item.
+TEST(SnapshotArenaTest, DISABLED_Benchmark)
+{
+	const int NUM_ITEMS = 100000;
+
+	// Column, thumbnail and info tip tasks, as well as sorting.
+	const int TASKS_PER_ITEM = 4;
+
+	std::vector<SyntheticItem> items;
+	items.reserve(NUM_ITEMS);
+
+	for (int i = 0; i < NUM_ITEMS; i++)
+	{
+		items.emplace_back(i);
+	}
+
+	auto toMilliseconds = [] (auto duration) {
+		return static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+	};
+
+	unsigned int copyResult = 0;
+	size_t startAllocations = g_numPidlAllocations;
+	auto start = std::chrono::steady_clock::now();
+
+	for (const auto &item : items)
+	{
+		for (int i = 0; i < TASKS_PER_ITEM; i++)
+		{
+			std::function<void()> task = [item, &copyResult] {
+				copyResult += ReadItem(item);
+			};
+
+			task();
+		}
+	}
+
+	auto copyDuration = std::chrono::steady_clock::now() - start;
+	size_t copyAllocations = g_numPidlAllocations - startAllocations;
+
+	unsigned int snapshotResult = 0;
+	startAllocations = g_numPidlAllocations;
+	start = std::chrono::steady_clock::now();
+
+	auto arena = SnapshotArena<SyntheticItem>::Create();
+	std::vector<std::shared_ptr<const SyntheticItem>> snapshots;
+	snapshots.reserve(NUM_ITEMS);
+
+	// Moving the item into the snapshot is equivalent to building the
+	// snapshot directly from the item store.
+	for (auto &item : items)
+	{
+		snapshots.push_back(arena->MakeSnapshot(std::move(item)));
+	}
+
+	for (const auto &snapshot : snapshots)
+	{
+		for (int i = 0; i < TASKS_PER_ITEM; i++)
+		{
+			std::function<void()> task = [snapshot, &snapshotResult] {
+				snapshotResult += ReadItem(*snapshot);
+			};
+
+			task();
+		}
+	}
+
+	auto snapshotDuration = std::chrono::steady_clock::now() - start;
+	size_t snapshotAllocations = g_numPidlAllocations - startAllocations;
+
+	EXPECT_EQ(copyResult, snapshotResult);
+
+	std::cout << NUM_ITEMS << " items, " << TASKS_PER_ITEM << " tasks per item\n"
+		<< "Copies: " << copyAllocations << " PIDL allocations, " << toMilliseconds(copyDuration) << " ms\n"
+		<< "Snapshots: " << snapshotAllocations << " PIDL allocations (" << arena->GetNumBlocks() << " arena blocks), "
+		<< toMilliseconds(snapshotDuration) << " ms\n";
+}
@@ -0,0 +1,559 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/TaskExecutor.h"
+#include "../ThirdParty/CTPL/cpl_stl.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// Blocks every worker in an executor until released, so that tasks can
+	// be queued up behind them in a known state.
+	class WorkerBlocker
+	{
+	public:
+
+		WorkerBlocker(TaskExecutor &executor) :
+			m_group(executor),
+			m_released(m_releasedPromise.get_future().share())
+		{
+			for (int i = 0; i < executor.GetNumThreads(); i++)
+			{
+				std::promise<void> started;
+				auto startedFuture = started.get_future();
+				auto sharedStarted = std::make_shared<std::promise<void>>(std::move(started));
+
+				m_group.Push(TaskPriority::Visible, [sharedStarted, released = m_released] {
+					sharedStarted->set_value();
+					released.wait();
+				});
+
+				m_started.push_back(std::move(startedFuture));
+			}
+
+			for (auto &started : m_started)
+			{
+				started.wait();
+			}
+		}
+
+		~WorkerBlocker()
+		{
+			Release();
+		}
+
+		void Release()
+		{
+			if (!m_isReleased)
+			{
+				m_releasedPromise.set_value();
+				m_isReleased = true;
+			}
+
+			m_group.Wait();
+		}
+
+	private:
+
+		TaskGroup m_group;
+		std::promise<void> m_releasedPromise;
+		std::shared_future<void> m_released;
+		std::vector<std::future<void>> m_started;
+		bool m_isReleased = false;
+	};
+}
+
+TEST(TaskExecutorTest, RunsTasks)
+{
+	TaskExecutor executor(4);
+	TaskGroup group(executor);
+
+	std::vector<std::future<int>> futures;
+
+	for (int i = 0; i < 100; i++)
+	{
+		futures.push_back(group.Push(TaskPriority::Visible, [i] {
+			return i * 2;
+		}));
+	}
+
+	for (int i = 0; i < 100; i++)
+	{
+		EXPECT_EQ(i * 2, futures[i].get());
+	}
+
+	group.Wait();
+	EXPECT_EQ(0u, group.GetNumOutstandingTasks());
+
+	auto statistics = executor.GetStatistics();
+	EXPECT_EQ(100u, statistics.lanes[static_cast<size_t>(TaskPriority::Visible)].numExecuted);
+	EXPECT_EQ(0u, statistics.lanes[static_cast<size_t>(TaskPriority::Visible)].queueDepth);
+}
+
+TEST(TaskExecutorTest, HigherPriorityRunsFirst)
+{
+	TaskExecutor executor(1);
+	TaskGroup group(executor);
+
+	std::mutex mutex;
+	std::vector<TaskPriority> order;
+
+	auto recordPriority = [&mutex, &order] (TaskPriority priority) {
+		return [&mutex, &order, priority] {
+			std::lock_guard<std::mutex> lock(mutex);
+			order.push_back(priority);
+		};
+	};
+
+	{
+		WorkerBlocker blocker(executor);
+
+		// Pushed in reverse priority order.
+		for (int i = 0; i < 3; i++)
+		{
+			group.Push(TaskPriority::Background, recordPriority(TaskPriority::Background));
+			group.Push(TaskPriority::Prefetch, recordPriority(TaskPriority::Prefetch));
+			group.Push(TaskPriority::Visible, recordPriority(TaskPriority::Visible));
+		}
+
+		auto statistics = executor.GetStatistics();
+		EXPECT_EQ(3u, statistics.lanes[static_cast<size_t>(TaskPriority::Background)].queueDepth);
+		EXPECT_EQ(3u, statistics.lanes[static_cast<size_t>(TaskPriority::Prefetch)].queueDepth);
+		EXPECT_EQ(3u, statistics.lanes[static_cast<size_t>(TaskPriority::Visible)].queueDepth);
+	}
+
+	group.Wait();
+
+	std::vector<TaskPriority> expected = { TaskPriority::Visible, TaskPriority::Visible, TaskPriority::Visible,
+		TaskPriority::Prefetch, TaskPriority::Prefetch, TaskPriority::Prefetch,
+		TaskPriority::Background, TaskPriority::Background, TaskPriority::Background };
+	EXPECT_EQ(expected, order);
+}
+
+TEST(TaskExecutorTest, CancelDropsQueuedTasks)
+{
+	TaskExecutor executor(2);
+	TaskGroup group(executor);
+	TaskGroup otherGroup(executor);
+
+	std::atomic<int> numRun(0);
+	std::atomic<int> numOtherRun(0);
+	std::vector<std::future<void>> futures;
+
+	{
+		WorkerBlocker blocker(executor);
+
+		for (int i = 0; i < 10; i++)
+		{
+			futures.push_back(group.Push(TaskPriority::Visible, [&numRun] {
+				numRun++;
+			}));
+
+			otherGroup.Push(TaskPriority::Visible, [&numOtherRun] {
+				numOtherRun++;
+			});
+		}
+
+		group.Cancel();
+	}
+
+	group.Wait();
+	otherGroup.Wait();
+
+	// Cancelling one group shouldn't affect any other.
+	EXPECT_EQ(0, numRun.load());
+	EXPECT_EQ(10, numOtherRun.load());
+
+	for (auto &future : futures)
+	{
+		EXPECT_THROW(future.get(), std::future_error);
+	}
+
+	auto statistics = executor.GetStatistics();
+	EXPECT_EQ(10u, statistics.lanes[static_cast<size_t>(TaskPriority::Visible)].numCancelled);
+}
+
+TEST(TaskExecutorTest, TasksPushedAfterCancelRun)
+{
+	TaskExecutor executor(2);
+	TaskGroup group(executor);
+
+	group.Cancel();
+
+	auto future = group.Push(TaskPriority::Visible, [] {
+		return 42;
+	});
+
+	EXPECT_EQ(42, future.get());
+}
+
+TEST(TaskExecutorTest, CancellationToken)
+{
+	TaskExecutor executor(2);
+	TaskGroup group(executor);
+
+	EXPECT_FALSE(CancellationToken().IsCancelled());
+
+	std::promise<void> started;
+	auto startedFuture = started.get_future();
+	auto sharedStarted = std::make_shared<std::promise<void>>(std::move(started));
+	auto token = group.GetCancellationToken();
+
+	// A running task isn't interrupted, but can check whether it's been
+	// cancelled and stop early.
+	auto future = group.Push(TaskPriority::Visible, [token, sharedStarted] {
+		sharedStarted->set_value();
+
+		int numIterations = 0;
+
+		while (!token.IsCancelled())
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			numIterations++;
+		}
+
+		return numIterations;
+	});
+
+	startedFuture.wait();
+	EXPECT_FALSE(token.IsCancelled());
+
+	group.Cancel();
+	EXPECT_TRUE(token.IsCancelled());
+	EXPECT_GE(future.get(), 0);
+
+	EXPECT_FALSE(group.GetCancellationToken().IsCancelled());
+}
+
+TEST(TaskExecutorTest, DestroyingGroupWaitsForRunningTasks)
+{
+	TaskExecutor executor(2);
+	std::atomic<bool> finished(false);
+
+	{
+		TaskGroup group(executor);
+
+		std::promise<void> started;
+		auto startedFuture = started.get_future();
+		auto sharedStarted = std::make_shared<std::promise<void>>(std::move(started));
+
+		group.Push(TaskPriority::Visible, [&finished, sharedStarted] {
+			sharedStarted->set_value();
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			finished = true;
+		});
+
+		startedFuture.wait();
+	}
+
+	EXPECT_TRUE(finished);
+}
+
+TEST(TaskExecutorTest, IdleWorkersStealTasks)
+{
+	TaskExecutor executor(4);
+	TaskGroup group(executor);
+
+	std::mutex mutex;
+	std::vector<std::thread::id> threads;
+
+	// A single worker pushes every task onto its own queue. The other workers
+	// can only take them by stealing.
+	group.Push(TaskPriority::Visible, [&group, &mutex, &threads] {
+		for (int i = 0; i < 64; i++)
+		{
+			group.Push(TaskPriority::Visible, [&mutex, &threads] {
+				std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+				std::lock_guard<std::mutex> lock(mutex);
+				threads.push_back(std::this_thread::get_id());
+			});
+		}
+	}).get();
+
+	group.Wait();
+
+	std::sort(threads.begin(), threads.end());
+	auto numThreads = std::unique(threads.begin(), threads.end()) - threads.begin();
+
+	EXPECT_EQ(64u, threads.size());
+	EXPECT_GT(numThreads, 1);
+	EXPECT_GT(executor.GetStatistics().numSteals, 0u);
+}
+
+TEST(TaskExecutorTest, ThreadCallbacks)
+{
+	std::atomic<int> numStarted(0);
+	std::atomic<int> numStopped(0);
+
+	{
+		TaskExecutor executor(3, [&numStarted] {
+			numStarted++;
+		}, [&numStopped] {
+			numStopped++;
+		});
+
+		TaskGroup group(executor);
+		group.Push(TaskPriority::Visible, [] {}).get();
+	}
+
+	EXPECT_EQ(3, numStarted.load());
+	EXPECT_EQ(3, numStopped.load());
+}
+
+TEST(TaskExecutorTest, QueueStatistics)
+{
+	TaskExecutor executor(1);
+	TaskGroup group(executor);
+
+	{
+		WorkerBlocker blocker(executor);
+
+		for (int i = 0; i < 5; i++)
+		{
+			group.Push(TaskPriority::Prefetch, [] {});
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+
+	group.Wait();
+
+	auto statistics = executor.GetStatistics();
+	auto &lane = statistics.lanes[static_cast<size_t>(TaskPriority::Prefetch)];
+
+	EXPECT_EQ(0u, lane.queueDepth);
+	EXPECT_EQ(5u, lane.maxQueueDepth);
+	EXPECT_EQ(5u, lane.numExecuted);
+	EXPECT_GE(lane.maxQueueLatency, std::chrono::milliseconds(20));
+	EXPECT_GE(lane.totalQueueLatency, lane.maxQueueLatency);
+}
+
+TEST(TaskExecutorTest, RunParallel)
+{
+	TaskExecutor executor(4);
+
+	std::vector<std::atomic<int>> counts(1000);
+
+	executor.RunParallel(counts.size(), [&counts] (size_t index) {
+		counts[index]++;
+	});
+
+	for (auto &count : counts)
+	{
+		EXPECT_EQ(1, count.load());
+	}
+
+	// Should complete without any jobs.
+	executor.RunParallel(0, [] (size_t) {
+	});
+}
+
+TEST(TaskExecutorTest, RunParallelFromWorker)
+{
+	TaskExecutor executor(1);
+	TaskGroup group(executor);
+
+	// The only worker is busy running this task, so the calling thread has to
+	// run the jobs itself.
+	auto future = group.Push(TaskPriority::Visible, [&executor] {
+		std::atomic<int> total(0);
+
+		executor.RunParallel(10, [&total] (size_t index) {
+			total += static_cast<int>(index);
+		});
+
+		return total.load();
+	});
+
+	EXPECT_EQ(45, future.get());
+}
+
+TEST(TaskExecutorTest, RunParallelHelpersRunBeforeQueuedTasks)
+{
+	TaskExecutor executor(1);
+	TaskGroup group(executor);
+
+	WorkerBlocker blocker(executor);
+
+	std::atomic<bool> queuedTaskRun(false);
+	group.Push(TaskPriority::Visible, [&queuedTaskRun] {
+		queuedTaskRun = true;
+	});
+
+	// Each job waits until the other has started, so one of them has to be
+	// run by a helper.
+	std::atomic<int> numStarted(0);
+	std::atomic<int> numStartedAfterQueuedTask(0);
+
+	std::thread caller([&executor, &queuedTaskRun, &numStarted, &numStartedAfterQueuedTask] {
+		executor.RunParallel(2, [&queuedTaskRun, &numStarted, &numStartedAfterQueuedTask] (size_t) {
+			if (queuedTaskRun)
+			{
+				numStartedAfterQueuedTask++;
+			}
+
+			numStarted++;
+
+			while (numStarted < 2)
+			{
+				std::this_thread::yield();
+			}
+		});
+	});
+
+	// Once the calling thread has started a job, the helper has been queued.
+	while (numStarted < 1)
+	{
+		std::this_thread::yield();
+	}
+
+	blocker.Release();
+	caller.join();
+	group.Wait();
+
+	EXPECT_EQ(0, numStartedAfterQueuedTask.load());
+	EXPECT_TRUE(queuedTaskRun);
+}
+
+TEST(TaskExecutorTest, BlockingTasksAreLimited)
+{
+	TaskExecutor executor(4);
+	TaskGroup group(executor);
+
+	EXPECT_EQ(2, executor.GetMaxBlockingTasks());
+
+	std::promise<void> releasePromise;
+	std::shared_future<void> released = releasePromise.get_future().share();
+
+	std::atomic<int> numRunning(0);
+	std::atomic<int> maxRunning(0);
+
+	for (int i = 0; i < 6; i++)
+	{
+		group.Push(TaskPriority::Visible, [&numRunning, &maxRunning, released] {
+			int running = ++numRunning;
+			int currentMax = maxRunning;
+
+			while (running > currentMax && !maxRunning.compare_exchange_weak(currentMax, running))
+			{
+			}
+
+			released.wait();
+			numRunning--;
+		}, TaskKind::Blocking);
+	}
+
+	while (numRunning < 2)
+	{
+		std::this_thread::yield();
+	}
+
+	// The remaining workers are still free to run other tasks.
+	auto future = group.Push(TaskPriority::Background, [] {
+		return 1;
+	});
+
+	ASSERT_EQ(std::future_status::ready, future.wait_for(std::chrono::seconds(10)));
+	EXPECT_EQ(2, numRunning.load());
+
+	releasePromise.set_value();
+	group.Wait();
+
+	EXPECT_EQ(2, maxRunning.load());
+}
+
+// Compares running tasks for several tabs on a single shared executor with
+// the previous approach, where each tab had its own single-threaded pool for
+// each type of task. Run with --gtest_also_run_disabled_tests.
+TEST(TaskExecutorTest, DISABLED_SharedExecutorBenchmark)
+{
+	const int NUM_TABS = 8;
+	const int NUM_POOLS_PER_TAB = 4;
+	const int NUM_TASKS_PER_TAB = 2000;
+
+	auto work = [] {
+		// Stands in for a column or thumbnail lookup.
+		volatile unsigned int value = 0;
+
+		for (int i = 0; i < 20000; i++)
+		{
+			value = value * 31 + i;
+		}
+	};
+
+	auto toMilliseconds = [] (auto duration) {
+		return static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+	};
+
+	auto start = std::chrono::steady_clock::now();
+
+	{
+		std::vector<std::unique_ptr<ctpl::thread_pool>> pools;
+
+		for (int i = 0; i < NUM_TABS * NUM_POOLS_PER_TAB; i++)
+		{
+			pools.push_back(std::make_unique<ctpl::thread_pool>(1));
+		}
+
+		std::vector<std::future<void>> futures;
+
+		// Only the current tab has any work to do, so most of the threads sit
+		// idle.
+		for (int i = 0; i < NUM_TASKS_PER_TAB; i++)
+		{
+			futures.push_back(pools[i % NUM_POOLS_PER_TAB]->push([&work] (int) {
+				work();
+			}));
+		}
+
+		for (auto &future : futures)
+		{
+			future.get();
+		}
+	}
+
+	auto poolDuration = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+
+	TaskExecutor executor((std::max)(2, static_cast<int>(std::thread::hardware_concurrency())));
+
+	{
+		std::vector<std::unique_ptr<TaskGroup>> groups;
+
+		for (int i = 0; i < NUM_TABS * NUM_POOLS_PER_TAB; i++)
+		{
+			groups.push_back(std::make_unique<TaskGroup>(executor));
+		}
+
+		for (int i = 0; i < NUM_TASKS_PER_TAB; i++)
+		{
+			groups[i % NUM_POOLS_PER_TAB]->Push(TaskPriority::Visible, work);
+		}
+
+		for (auto &group : groups)
+		{
+			group->Wait();
+		}
+	}
+
+	auto executorDuration = std::chrono::steady_clock::now() - start;
+
+	auto statistics = executor.GetStatistics();
+	auto &lane = statistics.lanes[static_cast<size_t>(TaskPriority::Visible)];
+
+	printf("Per-tab pools: %d threads, %lld ms\n", NUM_TABS * NUM_POOLS_PER_TAB, toMilliseconds(poolDuration));
+	printf("Shared executor: %d threads, %lld ms\n", executor.GetNumThreads(), toMilliseconds(executorDuration));
+	printf("Max queue depth: %zu, mean queue latency: %lld us, steals: %llu\n", lane.maxQueueDepth,
+		static_cast<long long>(lane.totalQueueLatency.count() / (std::max)(lane.numExecuted, static_cast<uint64_t>(1))),
+		static_cast<unsigned long long>(statistics.numSteals));
+}
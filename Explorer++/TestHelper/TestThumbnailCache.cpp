@@ -0,0 +1,390 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/ThumbnailCache.h"
+#include "../Helper/ThumbnailLevels.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const uint32_t THUMBNAIL_SIZE = 16;
+
+	class ThumbnailCacheTest : public ::testing::Test
+	{
+	protected:
+
+		void SetUp() override
+		{
+			m_directory = std::filesystem::temp_directory_path()
+				/ ("ThumbnailCacheTest-" + std::to_string(std::hash<std::string>()(
+					::testing::UnitTest::GetInstance()->current_test_info()->name())));
+			std::filesystem::create_directories(m_directory);
+		}
+
+		void TearDown() override
+		{
+			std::error_code error;
+			std::filesystem::remove_all(m_directory, error);
+		}
+
+		std::wstring GetCacheFilePath() const
+		{
+			return (m_directory / "ThumbnailCache.dat").wstring();
+		}
+
+		std::filesystem::path m_directory;
+	};
+
+	ThumbnailCacheKey MakeKey(const std::wstring &path, uint64_t fileSize = 1000, uint64_t lastWriteTime = 5000)
+	{
+		return { path, fileSize, lastWriteTime };
+	}
+
+	// Makes a square image that fills the level, unless a smaller size is
+	// given.
+	CachedThumbnail MakeImage(uint32_t seed, uint32_t level = THUMBNAIL_SIZE, uint32_t size = 0)
+	{
+		if (size == 0)
+		{
+			size = level;
+		}
+
+		CachedThumbnail thumbnail = { level, size, size, std::vector<uint32_t>(size * size) };
+
+		for (size_t i = 0; i < thumbnail.pixels.size(); i++)
+		{
+			thumbnail.pixels[i] = 0xFF000000 | static_cast<uint32_t>(seed * 2654435761u + i);
+		}
+
+		return thumbnail;
+	}
+
+	std::vector<uint32_t> FindImage(ThumbnailCache &cache, const ThumbnailCacheKey &key,
+		uint32_t requestedSize = THUMBNAIL_SIZE)
+	{
+		CachedThumbnail thumbnail;
+
+		if (!cache.Find(key, requestedSize, thumbnail))
+		{
+			return {};
+		}
+
+		return thumbnail.pixels;
+	}
+
+	size_t MeasureEntrySize()
+	{
+		ThumbnailCache measure(1024 * 1024);
+		measure.Insert(MakeKey(L"C:\\file0.jpg"), MakeImage(0));
+		return measure.GetSize();
+	}
+}
+
+TEST_F(ThumbnailCacheTest, FindInserted)
+{
+	ThumbnailCache cache(1024 * 1024);
+
+	auto image = MakeImage(1);
+	cache.Insert(MakeKey(L"C:\\Pictures\\image.jpg"), image);
+
+	EXPECT_EQ(image.pixels, FindImage(cache, MakeKey(L"C:\\Pictures\\image.jpg")));
+	EXPECT_TRUE(FindImage(cache, MakeKey(L"C:\\Pictures\\other.jpg")).empty());
+
+	auto statistics = cache.GetStatistics();
+	EXPECT_EQ(1u, statistics.numHits);
+	EXPECT_EQ(1u, statistics.numMisses);
+}
+
+TEST_F(ThumbnailCacheTest, KeepsLargestLevel)
+{
+	ThumbnailCache cache(1024 * 1024);
+
+	auto smallImage = MakeImage(1, 8);
+	cache.Insert(MakeKey(L"C:\\image.jpg"), smallImage);
+
+	// A smaller level can be used for smaller sizes only.
+	EXPECT_EQ(smallImage.pixels, FindImage(cache, MakeKey(L"C:\\image.jpg"), 8));
+	EXPECT_TRUE(FindImage(cache, MakeKey(L"C:\\image.jpg"), 16).empty());
+	EXPECT_EQ(1u, cache.GetStatistics().numSmallerLevelMisses);
+
+	// A larger level replaces the smaller one, and is used for both sizes.
+	auto largeImage = MakeImage(2, 32);
+	cache.Insert(MakeKey(L"C:\\image.jpg"), largeImage);
+	EXPECT_EQ(1u, cache.GetNumEntries());
+	EXPECT_EQ(1u, cache.GetNumBlocks());
+	EXPECT_EQ(largeImage.pixels, FindImage(cache, MakeKey(L"C:\\image.jpg"), 8));
+	EXPECT_EQ(largeImage.pixels, FindImage(cache, MakeKey(L"C:\\image.jpg"), 32));
+	EXPECT_EQ(1u, cache.GetStatistics().numLargerLevelHits);
+
+	// Inserting a smaller level afterwards (e.g. from an extraction that
+	// was already in progress) leaves the larger one in place.
+	cache.Insert(MakeKey(L"C:\\image.jpg"), MakeImage(3, 16));
+	EXPECT_EQ(largeImage.pixels, FindImage(cache, MakeKey(L"C:\\image.jpg"), 32));
+
+	// Unless the file has changed.
+	auto changedImage = MakeImage(4, 16);
+	cache.Insert(MakeKey(L"C:\\image.jpg", 1001), changedImage);
+	EXPECT_EQ(changedImage.pixels, FindImage(cache, MakeKey(L"C:\\image.jpg", 1001), 16));
+	EXPECT_EQ(1u, cache.GetNumEntries());
+}
+
+TEST_F(ThumbnailCacheTest, CompleteImageProvidesAnySize)
+{
+	ThumbnailCache cache(1024 * 1024);
+
+	// The image is smaller than the level it was extracted at, so there's
+	// no more detail to be had from extracting at a larger level.
+	auto image = MakeImage(1, 64, 20);
+	cache.Insert(MakeKey(L"C:\\icon.png"), image);
+
+	CachedThumbnail thumbnail;
+	ASSERT_TRUE(cache.Find(MakeKey(L"C:\\icon.png"), 512, thumbnail));
+	EXPECT_EQ(64u, thumbnail.level);
+	EXPECT_EQ(20u, thumbnail.width);
+	EXPECT_EQ(20u, thumbnail.height);
+	EXPECT_EQ(image.pixels, thumbnail.pixels);
+}
+
+TEST_F(ThumbnailCacheTest, ChangedFileInvalidatesEntry)
+{
+	ThumbnailCache cache(1024 * 1024);
+
+	auto image = MakeImage(1);
+	cache.Insert(MakeKey(L"C:\\image.jpg", 1000, 5000), image);
+
+	// A different size or modification time means the file has changed.
+	EXPECT_TRUE(FindImage(cache, MakeKey(L"C:\\image.jpg", 1001, 5000)).empty());
+	EXPECT_EQ(1u, cache.GetStatistics().numInvalidated);
+
+	// The stale entry (and its block) are removed.
+	EXPECT_EQ(0u, cache.GetNumEntries());
+	EXPECT_EQ(0u, cache.GetNumBlocks());
+	EXPECT_EQ(0u, cache.GetSize());
+
+	cache.Insert(MakeKey(L"C:\\image.jpg", 1000, 5000), image);
+	EXPECT_TRUE(FindImage(cache, MakeKey(L"C:\\image.jpg", 1000, 5001)).empty());
+	EXPECT_EQ(2u, cache.GetStatistics().numInvalidated);
+
+	// Inserting for the new identity replaces the old image.
+	auto newImage = MakeImage(2);
+	cache.Insert(MakeKey(L"C:\\image.jpg", 1000, 5000), image);
+	cache.Insert(MakeKey(L"C:\\image.jpg", 2000, 6000), newImage);
+	EXPECT_EQ(1u, cache.GetNumEntries());
+	EXPECT_EQ(1u, cache.GetNumBlocks());
+	EXPECT_EQ(newImage.pixels, FindImage(cache, MakeKey(L"C:\\image.jpg", 2000, 6000)));
+}
+
+TEST_F(ThumbnailCacheTest, IdenticalImagesShareBlock)
+{
+	size_t entrySize = MeasureEntrySize();
+
+	ThumbnailCache cache(1024 * 1024);
+
+	auto image = MakeImage(1);
+	cache.Insert(MakeKey(L"C:\\file0.jpg"), image);
+	cache.Insert(MakeKey(L"C:\\file1.jpg"), image);
+	cache.Insert(MakeKey(L"C:\\file2.jpg"), image);
+	cache.Insert(MakeKey(L"C:\\file3.jpg"), MakeImage(2));
+
+	EXPECT_EQ(4u, cache.GetNumEntries());
+	EXPECT_EQ(2u, cache.GetNumBlocks());
+	EXPECT_EQ(2u, cache.GetStatistics().numSharedBlocks);
+
+	// The shared block is only counted once.
+	EXPECT_LT(cache.GetSize(), entrySize * 3);
+
+	EXPECT_EQ(image.pixels, FindImage(cache, MakeKey(L"C:\\file1.jpg")));
+
+	// The block stays around until the last entry using it is removed.
+	EXPECT_TRUE(FindImage(cache, MakeKey(L"C:\\file0.jpg", 1, 1)).empty());
+	EXPECT_TRUE(FindImage(cache, MakeKey(L"C:\\file1.jpg", 1, 1)).empty());
+	EXPECT_EQ(2u, cache.GetNumBlocks());
+	EXPECT_EQ(image.pixels, FindImage(cache, MakeKey(L"C:\\file2.jpg")));
+
+	EXPECT_TRUE(FindImage(cache, MakeKey(L"C:\\file2.jpg", 1, 1)).empty());
+	EXPECT_EQ(1u, cache.GetNumBlocks());
+}
+
+TEST_F(ThumbnailCacheTest, EvictsLeastRecentlyUsed)
+{
+	size_t entrySize = MeasureEntrySize();
+
+	// Room for three entries of this size.
+	ThumbnailCache cache(entrySize * 3);
+
+	cache.Insert(MakeKey(L"C:\\file0.jpg"), MakeImage(0));
+	cache.Insert(MakeKey(L"C:\\file1.jpg"), MakeImage(1));
+	cache.Insert(MakeKey(L"C:\\file2.jpg"), MakeImage(2));
+
+	// Using file0 makes file1 the least recently used entry.
+	EXPECT_FALSE(FindImage(cache, MakeKey(L"C:\\file0.jpg")).empty());
+
+	cache.Insert(MakeKey(L"C:\\file3.jpg"), MakeImage(3));
+
+	EXPECT_EQ(3u, cache.GetNumEntries());
+	EXPECT_EQ(3u, cache.GetNumBlocks());
+	EXPECT_LE(cache.GetSize(), entrySize * 3);
+	EXPECT_EQ(1u, cache.GetStatistics().numEvicted);
+
+	EXPECT_FALSE(FindImage(cache, MakeKey(L"C:\\file0.jpg")).empty());
+	EXPECT_TRUE(FindImage(cache, MakeKey(L"C:\\file1.jpg")).empty());
+	EXPECT_FALSE(FindImage(cache, MakeKey(L"C:\\file2.jpg")).empty());
+	EXPECT_FALSE(FindImage(cache, MakeKey(L"C:\\file3.jpg")).empty());
+}
+
+TEST_F(ThumbnailCacheTest, ImageLargerThanCacheIgnored)
+{
+	ThumbnailCache cache(1024);
+
+	cache.Insert(MakeKey(L"C:\\file.jpg", 1, 1), MakeImage(1, 64));
+	EXPECT_EQ(0u, cache.GetNumEntries());
+	EXPECT_EQ(0u, cache.GetNumBlocks());
+	EXPECT_EQ(0u, cache.GetSize());
+}
+
+TEST_F(ThumbnailCacheTest, SaveAndLoad)
+{
+	ThumbnailCache cache(16 * 1024 * 1024);
+
+	for (uint32_t i = 0; i < 100; i++)
+	{
+		// Every fourth file has the same thumbnail.
+		cache.Insert(MakeKey(L"C:\\Pictures\\image" + std::to_wstring(i) + L".jpg", i, i * 10),
+			MakeImage(i % 4 == 0 ? 1000 : i));
+	}
+
+	ASSERT_TRUE(cache.Save(GetCacheFilePath()));
+
+	ThumbnailCache loadedCache(16 * 1024 * 1024);
+	ASSERT_TRUE(loadedCache.Load(GetCacheFilePath()));
+	EXPECT_EQ(100u, loadedCache.GetNumEntries());
+	EXPECT_EQ(76u, loadedCache.GetNumBlocks());
+	EXPECT_EQ(cache.GetSize(), loadedCache.GetSize());
+
+	for (uint32_t i = 0; i < 100; i++)
+	{
+		EXPECT_EQ(MakeImage(i % 4 == 0 ? 1000 : i).pixels,
+			FindImage(loadedCache, MakeKey(L"C:\\Pictures\\image" + std::to_wstring(i) + L".jpg", i, i * 10)));
+	}
+
+	// Entries loaded from the file are invalidated in the same way as any
+	// other entry.
+	EXPECT_TRUE(FindImage(loadedCache, MakeKey(L"C:\\Pictures\\image5.jpg", 5, 51)).empty());
+	EXPECT_EQ(1u, loadedCache.GetStatistics().numInvalidated);
+
+	// Loaded blocks are still shared with newly inserted entries.
+	loadedCache.Insert(MakeKey(L"C:\\Pictures\\copy.jpg"), MakeImage(7));
+	EXPECT_EQ(1u, loadedCache.GetStatistics().numSharedBlocks);
+}
+
+TEST_F(ThumbnailCacheTest, SaveOverLoadedFile)
+{
+	ThumbnailCache cache(1024 * 1024);
+	auto image1 = MakeImage(1);
+	cache.Insert(MakeKey(L"C:\\file1.jpg"), image1);
+	ASSERT_TRUE(cache.Save(GetCacheFilePath()));
+
+	// The loaded entries refer to the mapped file, so they have to remain
+	// valid when that file is replaced.
+	ThumbnailCache loadedCache(1024 * 1024);
+	ASSERT_TRUE(loadedCache.Load(GetCacheFilePath()));
+	auto image2 = MakeImage(2);
+	loadedCache.Insert(MakeKey(L"C:\\file2.jpg"), image2);
+	ASSERT_TRUE(loadedCache.Save(GetCacheFilePath()));
+
+	EXPECT_EQ(image1.pixels, FindImage(loadedCache, MakeKey(L"C:\\file1.jpg")));
+	EXPECT_EQ(image2.pixels, FindImage(loadedCache, MakeKey(L"C:\\file2.jpg")));
+
+	ThumbnailCache reloadedCache(1024 * 1024);
+	ASSERT_TRUE(reloadedCache.Load(GetCacheFilePath()));
+	EXPECT_EQ(image1.pixels, FindImage(reloadedCache, MakeKey(L"C:\\file1.jpg")));
+	EXPECT_EQ(image2.pixels, FindImage(reloadedCache, MakeKey(L"C:\\file2.jpg")));
+}
+
+TEST_F(ThumbnailCacheTest, SaveSkippedWhenUnchanged)
+{
+	ThumbnailCache cache(1024 * 1024);
+	cache.Insert(MakeKey(L"C:\\file.jpg"), MakeImage(1));
+	ASSERT_TRUE(cache.Save(GetCacheFilePath()));
+
+	auto lastWriteTime = std::filesystem::last_write_time(GetCacheFilePath());
+	std::filesystem::last_write_time(GetCacheFilePath(), lastWriteTime - std::chrono::hours(1));
+
+	// Lookups don't count as changes.
+	EXPECT_FALSE(FindImage(cache, MakeKey(L"C:\\file.jpg")).empty());
+	ASSERT_TRUE(cache.Save(GetCacheFilePath()));
+	EXPECT_EQ(lastWriteTime - std::chrono::hours(1), std::filesystem::last_write_time(GetCacheFilePath()));
+
+	cache.Insert(MakeKey(L"C:\\other.jpg"), MakeImage(2));
+	ASSERT_TRUE(cache.Save(GetCacheFilePath()));
+	EXPECT_NE(lastWriteTime - std::chrono::hours(1), std::filesystem::last_write_time(GetCacheFilePath()));
+}
+
+TEST_F(ThumbnailCacheTest, LoadKeepsMostRecentlyUsed)
+{
+	size_t entrySize = MeasureEntrySize();
+
+	ThumbnailCache cache(1024 * 1024);
+
+	for (uint32_t i = 0; i < 10; i++)
+	{
+		cache.Insert(MakeKey(L"C:\\file" + std::to_wstring(i) + L".jpg"), MakeImage(i));
+	}
+
+	FindImage(cache, MakeKey(L"C:\\file2.jpg"));
+	ASSERT_TRUE(cache.Save(GetCacheFilePath()));
+
+	// If the cache is now smaller, only the most recently used entries are
+	// loaded.
+	ThumbnailCache smallCache(entrySize * 3);
+	ASSERT_TRUE(smallCache.Load(GetCacheFilePath()));
+	EXPECT_EQ(3u, smallCache.GetNumEntries());
+	EXPECT_EQ(3u, smallCache.GetNumBlocks());
+
+	EXPECT_FALSE(FindImage(smallCache, MakeKey(L"C:\\file2.jpg")).empty());
+	EXPECT_FALSE(FindImage(smallCache, MakeKey(L"C:\\file9.jpg")).empty());
+	EXPECT_FALSE(FindImage(smallCache, MakeKey(L"C:\\file8.jpg")).empty());
+	EXPECT_TRUE(FindImage(smallCache, MakeKey(L"C:\\file7.jpg")).empty());
+}
+
+TEST_F(ThumbnailCacheTest, LoadInvalidFile)
+{
+	ThumbnailCache cache(1024 * 1024);
+
+	EXPECT_FALSE(cache.Load(GetCacheFilePath()));
+
+	{
+		std::ofstream file(std::filesystem::path(GetCacheFilePath()), std::ios::binary);
+		file << "not a cache file";
+	}
+
+	EXPECT_FALSE(cache.Load(GetCacheFilePath()));
+	EXPECT_EQ(0u, cache.GetNumEntries());
+}
+
+TEST_F(ThumbnailCacheTest, LoadTruncatedFile)
+{
+	ThumbnailCache cache(1024 * 1024);
+
+	for (uint32_t i = 0; i < 10; i++)
+	{
+		cache.Insert(MakeKey(L"C:\\file" + std::to_wstring(i) + L".jpg"), MakeImage(i));
+	}
+
+	ASSERT_TRUE(cache.Save(GetCacheFilePath()));
+
+	// The pixels for the last block now extend past the end of the file,
+	// so the file is rejected entirely.
+	auto size = std::filesystem::file_size(GetCacheFilePath());
+	std::filesystem::resize_file(GetCacheFilePath(), size - 4);
+
+	ThumbnailCache loadedCache(1024 * 1024);
+	EXPECT_FALSE(loadedCache.Load(GetCacheFilePath()));
+	EXPECT_EQ(0u, loadedCache.GetNumEntries());
+	EXPECT_EQ(0u, loadedCache.GetNumBlocks());
+}
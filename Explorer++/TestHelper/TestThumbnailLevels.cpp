@@ -0,0 +1,45 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/ThumbnailLevels.h"
+
+using namespace ThumbnailLevels;
+
+TEST(ThumbnailLevelsTest, ClampThumbnailSize)
+{
+	for (int size : THUMBNAIL_SIZES)
+	{
+		EXPECT_EQ(size, ClampThumbnailSize(size));
+	}
+
+	EXPECT_EQ(64, ClampThumbnailSize(0));
+	EXPECT_EQ(64, ClampThumbnailSize(-100));
+	EXPECT_EQ(120, ClampThumbnailSize(128));
+	EXPECT_EQ(160, ClampThumbnailSize(150));
+	EXPECT_EQ(512, ClampThumbnailSize(100000));
+}
+
+TEST(ThumbnailLevelsTest, LargerLevelProvidesSmallerSizes)
+{
+	EXPECT_TRUE(CanProvideSize(256, 256, 192, 256));
+	EXPECT_TRUE(CanProvideSize(256, 256, 192, 120));
+	EXPECT_TRUE(CanProvideSize(256, 100, 256, 64));
+
+	EXPECT_FALSE(CanProvideSize(256, 256, 192, 384));
+	EXPECT_FALSE(CanProvideSize(120, 120, 120, 160));
+
+	// Only one dimension needs to fill the level for a larger level to
+	// potentially have more detail.
+	EXPECT_FALSE(CanProvideSize(120, 40, 120, 512));
+}
+
+TEST(ThumbnailLevelsTest, CompleteImageProvidesAnySize)
+{
+	// The file was smaller than the level in both dimensions, so
+	// extracting at a larger level wouldn't help.
+	EXPECT_TRUE(CanProvideSize(120, 48, 48, 512));
+	EXPECT_TRUE(CanProvideSize(64, 63, 10, 512));
+	EXPECT_FALSE(CanProvideSize(64, 64, 10, 512));
+}
@@ -0,0 +1,257 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/ThumbnailResidency.h"
+#include "../Helper/ThumbnailScheduler.h"
+#include <cstdlib>
+#include <numeric>
+#include <set>
+#include <vector>
+
+namespace
+{
+	// As in the scheduler tests, item IDs are offset from their positions.
+	const int ITEM_ID_OFFSET = 100000;
+
+	std::vector<int> MakeItems(int numItems)
+	{
+		std::vector<int> items(numItems);
+		std::iota(items.begin(), items.end(), ITEM_ID_OFFSET);
+		return items;
+	}
+
+	std::vector<int> GetPositions(const std::vector<int> &items)
+	{
+		std::vector<int> positions;
+
+		for (int item : items)
+		{
+			positions.push_back(item - ITEM_ID_OFFSET);
+		}
+
+		return positions;
+	}
+}
+
+TEST(ThumbnailResidencyTest, GetMaxResidentItems)
+{
+	EXPECT_EQ(ThumbnailResidency::GetMaxResidentItems(256 * 1024 * 1024, 512), 256U);
+	EXPECT_EQ(ThumbnailResidency::GetMaxResidentItems(120 * 120 * 4 * 10 + 1, 120), 10U);
+	EXPECT_EQ(ThumbnailResidency::GetMaxResidentItems(0, 120), 1U);
+}
+
+TEST(ThumbnailResidencyTest, AllocatesNewSlotsUpToMaximum)
+{
+	ThumbnailResidency residency(3);
+	residency.SetItems(MakeItems(10));
+	residency.SetViewport(0, 2);
+
+	for (int i = 0; i < 3; i++)
+	{
+		auto allocation = residency.AllocateSlot(ITEM_ID_OFFSET + i);
+		ASSERT_TRUE(allocation);
+		EXPECT_EQ(allocation->slot, i);
+		EXPECT_FALSE(allocation->recycled);
+		EXPECT_FALSE(allocation->evictedItem);
+	}
+
+	EXPECT_EQ(residency.GetNumSlots(), 3U);
+	EXPECT_EQ(residency.GetNumResidentItems(), 3U);
+
+	// Every resident item is visible, so there's nothing that can be evicted
+	// for an item that isn't.
+	EXPECT_FALSE(residency.AllocateSlot(ITEM_ID_OFFSET + 5));
+	EXPECT_EQ(residency.GetStatistics().numRejected, 1U);
+
+	// Items that are already resident keep their slot.
+	auto allocation = residency.AllocateSlot(ITEM_ID_OFFSET + 1);
+	ASSERT_TRUE(allocation);
+	EXPECT_EQ(allocation->slot, 1);
+
+	EXPECT_FALSE(residency.AllocateSlot(12345));
+}
+
+TEST(ThumbnailResidencyTest, EvictsFurthestItem)
+{
+	ThumbnailResidency residency(5);
+	residency.SetItems(MakeItems(100));
+	residency.SetViewport(10, 11);
+
+	// The working set is positions 9 to 12. Items outside it can still be
+	// allocated while there are slots left.
+	EXPECT_EQ(residency.GetWorkingSetDistance(), 1);
+
+	for (int position : { 10, 11, 9, 12, 14 })
+	{
+		ASSERT_TRUE(residency.AllocateSlot(ITEM_ID_OFFSET + position));
+	}
+
+	// Position 14 is the furthest away.
+	auto allocation = residency.AllocateSlot(ITEM_ID_OFFSET + 8);
+	ASSERT_TRUE(allocation);
+	EXPECT_TRUE(allocation->recycled);
+	ASSERT_TRUE(allocation->evictedItem);
+	EXPECT_EQ(*allocation->evictedItem, ITEM_ID_OFFSET + 14);
+	EXPECT_EQ(allocation->slot, 4);
+	EXPECT_FALSE(residency.GetSlot(ITEM_ID_OFFSET + 14));
+
+	// Position 8 is the same distance away as position 13, so it won't be
+	// evicted.
+	EXPECT_FALSE(residency.AllocateSlot(ITEM_ID_OFFSET + 13));
+	EXPECT_EQ(residency.GetStatistics().numRejected, 1U);
+}
+
+TEST(ThumbnailResidencyTest, ViewportEvictsOutsideWorkingSet)
+{
+	ThumbnailResidency residency(10);
+	residency.SetItems(MakeItems(1000));
+	residency.SetViewport(0, 3);
+
+	for (int position = 0; position < 10; position++)
+	{
+		ASSERT_TRUE(residency.AllocateSlot(ITEM_ID_OFFSET + position));
+	}
+
+	// The working set is now positions 2 to 9.
+	auto evicted = residency.SetViewport(5, 8);
+	EXPECT_EQ(residency.GetWorkingSetDistance(), 3);
+	EXPECT_EQ(GetPositions(evicted), (std::vector<int>{ 0, 1 }));
+	EXPECT_EQ(residency.GetNumResidentItems(), 8U);
+
+	// Evicted slots are reused before any new slots are created.
+	auto allocation = residency.AllocateSlot(ITEM_ID_OFFSET + 10);
+	ASSERT_TRUE(allocation);
+	EXPECT_TRUE(allocation->recycled);
+	EXPECT_LT(allocation->slot, 2);
+	EXPECT_EQ(residency.GetNumSlots(), 10U);
+
+	// Jumping to the end of the list evicts everything.
+	evicted = residency.SetViewport(996, 999);
+	EXPECT_EQ(GetPositions(evicted), (std::vector<int>{ 2, 3, 4, 5, 6, 7, 8, 9, 10 }));
+	EXPECT_EQ(residency.GetNumResidentItems(), 0U);
+
+	// Items that come back into view are counted as refetches.
+	residency.SetViewport(0, 3);
+	ASSERT_TRUE(residency.AllocateSlot(ITEM_ID_OFFSET + 0));
+	ASSERT_TRUE(residency.AllocateSlot(ITEM_ID_OFFSET + 999));
+
+	auto statistics = residency.GetStatistics();
+	EXPECT_EQ(statistics.numAllocated, 13U);
+	EXPECT_EQ(statistics.numRecycled, 3U);
+	EXPECT_EQ(statistics.numEvicted, 11U);
+	EXPECT_EQ(statistics.numRefetched, 1U);
+	EXPECT_EQ(statistics.peakResidentItems, 10U);
+}
+
+TEST(ThumbnailResidencyTest, SetItemsAndRemoveItem)
+{
+	ThumbnailResidency residency(10);
+	residency.SetItems(MakeItems(5));
+	residency.SetViewport(0, 4);
+
+	for (int position = 0; position < 5; position++)
+	{
+		ASSERT_TRUE(residency.AllocateSlot(ITEM_ID_OFFSET + position));
+	}
+
+	residency.RemoveItem(ITEM_ID_OFFSET + 2);
+	EXPECT_FALSE(residency.GetSlot(ITEM_ID_OFFSET + 2));
+	EXPECT_FALSE(residency.AllocateSlot(ITEM_ID_OFFSET + 2));
+
+	// Items that are no longer present are evicted, in slot order. Items
+	// that remain keep their slots, even though their positions change.
+	auto evicted = residency.SetItems({ ITEM_ID_OFFSET + 4, ITEM_ID_OFFSET + 1 });
+	EXPECT_EQ(GetPositions(evicted), (std::vector<int>{ 0, 3 }));
+	EXPECT_EQ(residency.GetSlot(ITEM_ID_OFFSET + 4), 4);
+	EXPECT_EQ(residency.GetSlot(ITEM_ID_OFFSET + 1), 1);
+
+	residency.Reset(2);
+	EXPECT_EQ(residency.GetNumResidentItems(), 0U);
+	EXPECT_EQ(residency.GetNumSlots(), 0U);
+	EXPECT_EQ(residency.GetMaxResidentItems(), 2U);
+}
+
+// Simulates scrolling through a large folder, with the scheduler limited to
+// the working set and evicted items restarted, as they are in the
+// thumbnails view. The number of resident items should never exceed the
+// maximum and every item should be resident once it's scrolled into view.
+TEST(ThumbnailResidencyTest, ScrollTrace)
+{
+	const int numItems = 20000;
+	const int viewportSize = 30;
+	const size_t maxResidentItems = 200;
+
+	ThumbnailScheduler::Options options;
+	options.maxItemsInFlight = 16;
+	ThumbnailScheduler scheduler(options);
+	ThumbnailResidency residency(maxResidentItems);
+
+	auto items = MakeItems(numItems);
+	scheduler.SetItems(items);
+	residency.SetItems(items);
+
+	std::set<int> imageListSlots;
+	int first = 0;
+
+	auto setViewport = [&](int newFirst) {
+		first = newFirst;
+
+		for (int item : scheduler.SetViewport(first, first + viewportSize - 1))
+		{
+			// In the real view, the task would be cancelled.
+			(void) item;
+		}
+
+		for (int item : residency.SetViewport(first, first + viewportSize - 1))
+		{
+			EXPECT_TRUE(scheduler.RestartItem(item));
+		}
+
+		scheduler.SetMaxStartDistance(residency.GetWorkingSetDistance());
+	};
+
+	auto completeAll = [&]() {
+		while (auto next = scheduler.StartNextItem())
+		{
+			int position = next->item - ITEM_ID_OFFSET;
+			EXPECT_LE(std::abs(position - first), residency.GetWorkingSetDistance() + viewportSize);
+
+			ASSERT_TRUE(scheduler.CompleteItem(next->item));
+
+			auto allocation = residency.AllocateSlot(next->item);
+			ASSERT_TRUE(allocation);
+			EXPECT_EQ(allocation->recycled, imageListSlots.count(allocation->slot) > 0);
+			imageListSlots.insert(allocation->slot);
+
+			if (allocation->evictedItem)
+			{
+				EXPECT_TRUE(scheduler.RestartItem(*allocation->evictedItem));
+			}
+
+			ASSERT_LE(residency.GetNumResidentItems(), maxResidentItems);
+		}
+	};
+
+	setViewport(0);
+	completeAll();
+
+	for (int newFirst : { 10, 50, 400, 5000, 4990, 19970, 0, 120, 19000, 60 })
+	{
+		setViewport(newFirst);
+		completeAll();
+
+		for (int position = newFirst; position < newFirst + viewportSize; position++)
+		{
+			EXPECT_TRUE(residency.GetSlot(ITEM_ID_OFFSET + position)) << position;
+		}
+	}
+
+	EXPECT_LE(imageListSlots.size(), maxResidentItems);
+
+	auto statistics = residency.GetStatistics();
+	EXPECT_EQ(statistics.peakResidentItems, maxResidentItems);
+	EXPECT_GT(statistics.numRefetched, 0U);
+	EXPECT_EQ(statistics.numRejected, 0U);
+}
@@ -0,0 +1,404 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/ThumbnailScheduler.h"
+#include <algorithm>
+#include <deque>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+	ThumbnailScheduler::Options MakeOptions(size_t maxItemsInFlight)
+	{
+		ThumbnailScheduler::Options options;
+		options.maxItemsInFlight = maxItemsInFlight;
+		options.prefetchPages = 2;
+		options.cancelPages = 4;
+		return options;
+	}
+
+	// Item IDs are offset from their positions, so that the two can't be
+	// confused.
+	const int ITEM_ID_OFFSET = 100000;
+
+	std::vector<int> MakeItems(int numItems)
+	{
+		std::vector<int> items(numItems);
+		std::iota(items.begin(), items.end(), ITEM_ID_OFFSET);
+		return items;
+	}
+
+	std::vector<ThumbnailScheduler::ScheduledItem> StartAll(ThumbnailScheduler &scheduler)
+	{
+		std::vector<ThumbnailScheduler::ScheduledItem> started;
+
+		while (auto next = scheduler.StartNextItem())
+		{
+			started.push_back(*next);
+		}
+
+		return started;
+	}
+
+	std::vector<int> GetPositions(const std::vector<ThumbnailScheduler::ScheduledItem> &scheduledItems)
+	{
+		std::vector<int> positions;
+
+		for (const auto &scheduledItem : scheduledItems)
+		{
+			positions.push_back(scheduledItem.item - ITEM_ID_OFFSET);
+		}
+
+		return positions;
+	}
+}
+
+TEST(ThumbnailSchedulerTest, VisibleThenPrefetchThenNearest)
+{
+	ThumbnailScheduler scheduler(MakeOptions(1000));
+	scheduler.SetItems(MakeItems(100));
+
+	// Scrolling down to positions 50-54.
+	scheduler.SetViewport(50, 54);
+
+	auto started = StartAll(scheduler);
+	ASSERT_EQ(100u, started.size());
+
+	auto positions = GetPositions(started);
+
+	// The visible items come first, in order.
+	EXPECT_EQ(std::vector<int>({ 50, 51, 52, 53, 54 }), std::vector<int>(positions.begin(), positions.begin() + 5));
+
+	for (int i = 0; i < 5; i++)
+	{
+		EXPECT_EQ(TaskPriority::Visible, started[i].priority);
+	}
+
+	// Then two pages below the viewport, since that's the direction of the
+	// last scroll.
+	for (int i = 5; i < 15; i++)
+	{
+		EXPECT_EQ(50 + i, positions[i]);
+		EXPECT_EQ(TaskPriority::Prefetch, started[i].priority);
+	}
+
+	// Then everything else, nearest first. Item 49 is only one away from
+	// the viewport, while item 65 is 11 away.
+	EXPECT_EQ(std::vector<int>({ 49, 48, 47 }), std::vector<int>(positions.begin() + 15, positions.begin() + 18));
+
+	for (size_t i = 15; i < started.size(); i++)
+	{
+		EXPECT_EQ(TaskPriority::Background, started[i].priority);
+	}
+
+	// Item 0 is the furthest from the viewport.
+	EXPECT_EQ(0, positions.back());
+}
+
+TEST(ThumbnailSchedulerTest, PrefetchFollowsScrollDirection)
+{
+	ThumbnailScheduler scheduler(MakeOptions(1000));
+	scheduler.SetItems(MakeItems(100));
+
+	scheduler.SetViewport(80, 84);
+	scheduler.SetViewport(50, 54);
+
+	auto positions = GetPositions(StartAll(scheduler));
+
+	// After scrolling up, the prefetch window is above the viewport,
+	// nearest first.
+	EXPECT_EQ(std::vector<int>({ 50, 51, 52, 53, 54, 49, 48, 47, 46, 45, 44, 43, 42, 41, 40 }),
+		std::vector<int>(positions.begin(), positions.begin() + 15));
+}
+
+TEST(ThumbnailSchedulerTest, NothingVisible)
+{
+	ThumbnailScheduler scheduler(MakeOptions(1000));
+	scheduler.SetItems(MakeItems(10));
+
+	// Without a viewport, items are simply started in order.
+	auto started = StartAll(scheduler);
+	EXPECT_EQ(std::vector<int>({ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }), GetPositions(started));
+	EXPECT_EQ(TaskPriority::Background, started[0].priority);
+}
+
+TEST(ThumbnailSchedulerTest, LimitsItemsInFlight)
+{
+	ThumbnailScheduler scheduler(MakeOptions(3));
+	scheduler.SetItems(MakeItems(10));
+	scheduler.SetViewport(0, 4);
+
+	EXPECT_EQ(std::vector<int>({ 0, 1, 2 }), GetPositions(StartAll(scheduler)));
+	EXPECT_EQ(3u, scheduler.GetNumItemsInFlight());
+	EXPECT_EQ(7u, scheduler.GetNumPendingItems());
+
+	EXPECT_TRUE(scheduler.CompleteItem(ITEM_ID_OFFSET + 1));
+	EXPECT_EQ(std::vector<int>({ 3 }), GetPositions(StartAll(scheduler)));
+
+	// Completing an item again has no effect.
+	EXPECT_FALSE(scheduler.CompleteItem(ITEM_ID_OFFSET + 1));
+	EXPECT_TRUE(StartAll(scheduler).empty());
+}
+
+TEST(ThumbnailSchedulerTest, ViewportChangeReprioritizes)
+{
+	ThumbnailScheduler scheduler(MakeOptions(2));
+	scheduler.SetItems(MakeItems(1000));
+	scheduler.SetViewport(0, 9);
+
+	EXPECT_EQ(std::vector<int>({ 0, 1 }), GetPositions(StartAll(scheduler)));
+
+	// Jumping to the end. Items 0 and 1 are now far away, so they're
+	// cancelled.
+	auto cancelled = scheduler.SetViewport(990, 999);
+	EXPECT_EQ(std::vector<int>({ ITEM_ID_OFFSET, ITEM_ID_OFFSET + 1 }), cancelled);
+	EXPECT_EQ(0u, scheduler.GetNumItemsInFlight());
+	EXPECT_EQ(2u, scheduler.GetStatistics().numCancelled);
+
+	EXPECT_EQ(std::vector<int>({ 990, 991 }), GetPositions(StartAll(scheduler)));
+
+	// Cancelled items are still retrieved eventually.
+	scheduler.SetViewport(0, 9);
+	EXPECT_TRUE(scheduler.SetViewport(0, 9).empty());
+	scheduler.CompleteItem(ITEM_ID_OFFSET + 990);
+	scheduler.CompleteItem(ITEM_ID_OFFSET + 991);
+	EXPECT_EQ(std::vector<int>({ 0, 1 }), GetPositions(StartAll(scheduler)));
+}
+
+TEST(ThumbnailSchedulerTest, NearbyItemsNotCancelled)
+{
+	ThumbnailScheduler scheduler(MakeOptions(100));
+	scheduler.SetItems(MakeItems(1000));
+	scheduler.SetViewport(100, 109);
+	StartAll(scheduler);
+
+	// The items in flight are now those nearest to positions 100-109.
+	// After scrolling, only those more than four pages (40 items) from the
+	// viewport are cancelled.
+	auto cancelled = scheduler.SetViewport(140, 149);
+	EXPECT_FALSE(cancelled.empty());
+	EXPECT_EQ(100u - cancelled.size(), scheduler.GetNumItemsInFlight());
+
+	for (int item : cancelled)
+	{
+		EXPECT_LT(item - ITEM_ID_OFFSET, 100);
+	}
+}
+
+TEST(ThumbnailSchedulerTest, SetItemsKeepsState)
+{
+	ThumbnailScheduler scheduler(MakeOptions(2));
+	scheduler.SetItems({ 10, 11, 12, 13, 14 });
+	scheduler.SetViewport(0, 1);
+
+	EXPECT_EQ(10, scheduler.StartNextItem()->item);
+	EXPECT_EQ(11, scheduler.StartNextItem()->item);
+	scheduler.CompleteItem(10);
+
+	// The items are now sorted in the opposite order, with a new item. The
+	// completed item isn't started again and the item in flight stays in
+	// flight.
+	scheduler.SetItems({ 15, 14, 13, 12, 11, 10 });
+	EXPECT_EQ(1u, scheduler.GetNumItemsInFlight());
+	EXPECT_EQ(4u, scheduler.GetNumPendingItems());
+
+	EXPECT_EQ(15, scheduler.StartNextItem()->item);
+	EXPECT_FALSE(scheduler.StartNextItem());
+
+	scheduler.CompleteItem(11);
+	scheduler.CompleteItem(15);
+	EXPECT_EQ(14, scheduler.StartNextItem()->item);
+	EXPECT_EQ(13, scheduler.StartNextItem()->item);
+
+	// Items that are no longer listed are dropped.
+	scheduler.SetItems({ 12 });
+	EXPECT_EQ(0u, scheduler.GetNumItemsInFlight());
+	EXPECT_EQ(12, scheduler.StartNextItem()->item);
+	EXPECT_FALSE(scheduler.StartNextItem());
+}
+
+TEST(ThumbnailSchedulerTest, RemoveItem)
+{
+	ThumbnailScheduler scheduler(MakeOptions(10));
+	scheduler.SetItems({ 10, 11, 12 });
+
+	EXPECT_EQ(10, scheduler.StartNextItem()->item);
+	scheduler.CompleteItem(10);
+
+	scheduler.RemoveItem(10);
+	scheduler.RemoveItem(11);
+	EXPECT_FALSE(scheduler.IsItemKnown(10));
+	EXPECT_FALSE(scheduler.IsItemKnown(11));
+	EXPECT_TRUE(scheduler.IsItemKnown(12));
+
+	// If an ID is reused, it's treated as a new item.
+	scheduler.SetItems({ 10, 12 });
+	EXPECT_EQ(10, scheduler.StartNextItem()->item);
+	EXPECT_EQ(12, scheduler.StartNextItem()->item);
+}
+
+// Simulates a user scrolling from the top to the bottom of a large folder and
+// then jumping back to the top, with a fixed number of workers each finishing
+// one item per tick. At every point, the item started must be the best one
+// available (no pending item is visible when a non-visible item is started,
+// etc).
+TEST(ThumbnailSchedulerTest, RestartItem)
+{
+	ThumbnailScheduler scheduler(MakeOptions(1000));
+	scheduler.SetItems(MakeItems(100));
+	scheduler.SetViewport(0, 9);
+
+	EXPECT_FALSE(scheduler.RestartItem(ITEM_ID_OFFSET + 5));
+
+	for (const auto &scheduledItem : StartAll(scheduler))
+	{
+		EXPECT_TRUE(scheduler.CompleteItem(scheduledItem.item));
+	}
+
+	// The restarted items should be pending at their current positions.
+	auto items = MakeItems(100);
+	std::reverse(items.begin(), items.end());
+	scheduler.SetItems(items);
+
+	EXPECT_TRUE(scheduler.RestartItem(ITEM_ID_OFFSET + 5));
+	EXPECT_TRUE(scheduler.RestartItem(ITEM_ID_OFFSET + 50));
+	EXPECT_FALSE(scheduler.RestartItem(ITEM_ID_OFFSET + 50));
+	EXPECT_EQ(scheduler.GetNumPendingItems(), 2U);
+
+	scheduler.SetViewport(90, 99);
+	auto started = StartAll(scheduler);
+	ASSERT_EQ(started.size(), 2U);
+	EXPECT_EQ(started[0].item, ITEM_ID_OFFSET + 5);
+	EXPECT_EQ(started[0].priority, TaskPriority::Visible);
+	EXPECT_EQ(started[1].item, ITEM_ID_OFFSET + 50);
+
+	// An item that was never added has no position to restart at.
+	EXPECT_TRUE(scheduler.CompleteItem(12345));
+	EXPECT_FALSE(scheduler.RestartItem(12345));
+
+	EXPECT_EQ(scheduler.GetStatistics().numRestarted, 2U);
+}
+
+TEST(ThumbnailSchedulerTest, MaxStartDistance)
+{
+	ThumbnailScheduler scheduler(MakeOptions(1000));
+	scheduler.SetItems(MakeItems(100));
+	scheduler.SetViewport(40, 49);
+	scheduler.SetMaxStartDistance(3);
+
+	auto positions = GetPositions(StartAll(scheduler));
+	std::sort(positions.begin(), positions.end());
+
+	std::vector<int> expectedPositions(16);
+	std::iota(expectedPositions.begin(), expectedPositions.end(), 37);
+	EXPECT_EQ(positions, expectedPositions);
+
+	scheduler.SetMaxStartDistance(std::nullopt);
+	EXPECT_EQ(StartAll(scheduler).size(), 84U);
+}
+
+TEST(ThumbnailSchedulerTest, ScrollTrace)
+{
+	const int NUM_ITEMS = 10000;
+	const int VIEWPORT_SIZE = 24;
+	const size_t NUM_WORKERS = 4;
+
+	struct Step
+	{
+		int viewportFirst;
+		int numTicks;
+	};
+
+	std::vector<Step> trace;
+
+	for (int first = 0; first < NUM_ITEMS - VIEWPORT_SIZE; first += 240)
+	{
+		trace.push_back({ first, 1 });
+	}
+
+	trace.push_back({ NUM_ITEMS - VIEWPORT_SIZE, 20 });
+	trace.push_back({ 0, 20 });
+
+	auto runTrace = [&](std::vector<int> &startOrder, std::vector<int> &ticksToShowViewport) {
+		ThumbnailScheduler scheduler(MakeOptions(NUM_WORKERS * 2));
+		scheduler.SetItems(MakeItems(NUM_ITEMS));
+
+		std::deque<int> workQueue;
+		std::vector<bool> completed(NUM_ITEMS, false);
+
+		for (const auto &step : trace)
+		{
+			int first = step.viewportFirst;
+			int last = first + VIEWPORT_SIZE - 1;
+
+			for (int item : scheduler.SetViewport(first, last))
+			{
+				workQueue.erase(std::find(workQueue.begin(), workQueue.end(), item));
+			}
+
+			int ticksToShow = -1;
+
+			for (int tick = 0; tick < step.numTicks; tick++)
+			{
+				while (auto next = scheduler.StartNextItem())
+				{
+					int position = next->item - ITEM_ID_OFFSET;
+					bool visible = (position >= first && position <= last);
+					EXPECT_EQ(visible, next->priority == TaskPriority::Visible);
+
+					if (!visible)
+					{
+						// No pending item should be visible.
+						for (int i = first; i <= last; i++)
+						{
+							EXPECT_TRUE(completed[i] || std::find(workQueue.begin(), workQueue.end(),
+								ITEM_ID_OFFSET + i) != workQueue.end()) << i;
+						}
+					}
+
+					startOrder.push_back(position);
+					workQueue.push_back(next->item);
+				}
+
+				for (size_t i = 0; i < NUM_WORKERS && !workQueue.empty(); i++)
+				{
+					int item = workQueue.front();
+					workQueue.pop_front();
+
+					scheduler.CompleteItem(item);
+					completed[item - ITEM_ID_OFFSET] = true;
+				}
+
+				if (ticksToShow == -1
+					&& std::all_of(completed.begin() + first, completed.begin() + last + 1, [](bool c) { return c; }))
+				{
+					ticksToShow = tick + 1;
+				}
+			}
+
+			ticksToShowViewport.push_back(ticksToShow);
+		}
+
+		EXPECT_LE(scheduler.GetNumItemsInFlight(), NUM_WORKERS * 2);
+	};
+
+	std::vector<int> startOrder;
+	std::vector<int> ticksToShowViewport;
+	runTrace(startOrder, ticksToShowViewport);
+
+	// After jumping to the end (and back to the start), the visible items
+	// are finished as quickly as the workers allow, rather than waiting
+	// behind everything that was scrolled past.
+	int minTicks = (VIEWPORT_SIZE + NUM_WORKERS - 1) / NUM_WORKERS;
+	EXPECT_LE(ticksToShowViewport[ticksToShowViewport.size() - 2], minTicks + 2);
+	EXPECT_LE(ticksToShowViewport.back(), minTicks + 2);
+
+	// The same trace always produces the same schedule.
+	std::vector<int> secondStartOrder;
+	std::vector<int> secondTicksToShowViewport;
+	runTrace(secondStartOrder, secondTicksToShowViewport);
+	EXPECT_EQ(startOrder, secondStartOrder);
+}
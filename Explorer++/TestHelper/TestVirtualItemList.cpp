@@ -0,0 +1,300 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/VirtualItemList.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// Enough items to be representative of a very large folder.
+	const int NUM_SYNTHETIC_ITEMS = 1 << 20;
+
+	std::vector<int> GetRows(const VirtualItemList &list)
+	{
+		std::vector<int> rows;
+
+		for (size_t i = 0; i < list.GetNumRows(); i++)
+		{
+			rows.push_back(list.GetItemAtRow(i));
+		}
+
+		return rows;
+	}
+
+	// Synthetic item properties, indexed by item ID.
+	struct SyntheticItems
+	{
+		explicit SyntheticItems(int numItems)
+		{
+			std::mt19937 generator(42);
+			std::uniform_int_distribution<int> sizeDistribution(0, 1000000);
+
+			for (int i = 0; i < numItems; i++)
+			{
+				ids.push_back(i);
+				sizes.push_back(sizeDistribution(generator));
+			}
+
+			std::shuffle(ids.begin(), ids.end(), generator);
+		}
+
+		std::vector<int> ids;
+		std::vector<int> sizes;
+	};
+}
+
+TEST(VirtualItemListTest, Basic)
+{
+	VirtualItemList list;
+	list.AddItems({ 3, 1, 2 });
+
+	EXPECT_EQ(3U, list.GetNumItems());
+	EXPECT_EQ((std::vector<int>{ 3, 1, 2 }), GetRows(list));
+	EXPECT_EQ(0U, list.GetRowForItem(3));
+	EXPECT_EQ(std::nullopt, list.GetRowForItem(0));
+	EXPECT_EQ(std::nullopt, list.GetRowForItem(10));
+
+	list.SetSortOrder(std::less<int>());
+	EXPECT_EQ((std::vector<int>{ 1, 2, 3 }), GetRows(list));
+
+	// New items are merged into the sorted items.
+	list.AddItems({ 5, 0, 4 });
+	EXPECT_EQ((std::vector<int>{ 0, 1, 2, 3, 4, 5 }), GetRows(list));
+
+	list.RemoveItems({ 2, 4 });
+	EXPECT_EQ((std::vector<int>{ 0, 1, 3, 5 }), GetRows(list));
+	EXPECT_EQ(2U, list.GetRowForItem(3));
+	EXPECT_EQ(std::nullopt, list.GetRowForItem(2));
+
+	list.Clear();
+	EXPECT_EQ(0U, list.GetNumRows());
+}
+
+TEST(VirtualItemListTest, Filter)
+{
+	VirtualItemList list;
+	list.AddItems({ 0, 1, 2, 3, 4, 5 });
+
+	list.SetFilter([] (int id) {
+		return id % 2 == 0;
+	});
+	EXPECT_EQ(6U, list.GetNumItems());
+	EXPECT_EQ((std::vector<int>{ 0, 2, 4 }), GetRows(list));
+	EXPECT_EQ(std::nullopt, list.GetRowForItem(1));
+
+	// Items added while a filter is set are filtered too.
+	list.AddItems({ 6, 7 });
+	EXPECT_EQ((std::vector<int>{ 0, 2, 4, 6 }), GetRows(list));
+
+	list.RemoveFilter();
+	EXPECT_EQ(8U, list.GetNumRows());
+}
+
+TEST(VirtualItemListTest, Groups)
+{
+	VirtualItemList list;
+	list.AddItems({ 0, 1, 2, 3, 4, 5, 6 });
+	list.SetSortOrder(std::greater<int>());
+
+	list.SetGrouping([] (int id) {
+		return id % 3;
+	});
+
+	// Each group should be contiguous and remain sorted.
+	EXPECT_EQ((std::vector<int>{ 6, 3, 0, 4, 1, 5, 2 }), GetRows(list));
+
+	auto &groups = list.GetGroups();
+	ASSERT_EQ(3U, groups.size());
+	EXPECT_EQ(0, groups[0].key);
+	EXPECT_EQ(0U, groups[0].firstRow);
+	EXPECT_EQ(3U, groups[0].numRows);
+	EXPECT_EQ(1, groups[1].key);
+	EXPECT_EQ(3U, groups[1].firstRow);
+	EXPECT_EQ(2U, groups[1].numRows);
+	EXPECT_EQ(2, groups[2].key);
+	EXPECT_EQ(5U, groups[2].firstRow);
+	EXPECT_EQ(2U, groups[2].numRows);
+
+	list.RemoveGrouping();
+	EXPECT_TRUE(list.GetGroups().empty());
+	EXPECT_EQ((std::vector<int>{ 6, 5, 4, 3, 2, 1, 0 }), GetRows(list));
+}
+
+TEST(VirtualItemListTest, UpdateItems)
+{
+	std::vector<int> sizes = { 10, 20, 30, 40 };
+
+	VirtualItemList list;
+	list.AddItems({ 0, 1, 2, 3 });
+	list.SetSortOrder([&sizes] (int id1, int id2) {
+		return sizes[id1] < sizes[id2];
+	});
+
+	sizes[0] = 35;
+	list.UpdateItems({ 0 });
+	EXPECT_EQ((std::vector<int>{ 1, 2, 0, 3 }), GetRows(list));
+}
+
+TEST(VirtualItemListTest, Selection)
+{
+	VirtualItemList list;
+	list.AddItems({ 0, 1, 2, 3, 4, 5 });
+	list.SetSortOrder(std::greater<int>());
+
+	list.SetRowRangeSelected(1, 3, true);
+	EXPECT_EQ(3U, list.GetNumSelected());
+	EXPECT_EQ((std::vector<int>{ 4, 3, 2 }), list.GetSelectedItems());
+	EXPECT_TRUE(list.IsRowSelected(1));
+	EXPECT_FALSE(list.IsRowSelected(0));
+
+	// The selection follows the items when they're sorted.
+	list.SetSortOrder(std::less<int>());
+	EXPECT_EQ((std::vector<int>{ 2, 3, 4 }), list.GetSelectedItems());
+	EXPECT_TRUE(list.IsRowSelected(2));
+
+	list.SetRowSelected(2, false);
+	EXPECT_FALSE(list.IsItemSelected(2));
+	EXPECT_EQ(2U, list.GetNumSelected());
+
+	// Items that are filtered out are deselected.
+	list.SetFilter([] (int id) {
+		return id != 3;
+	});
+	EXPECT_EQ(std::vector<int>{ 4 }, list.GetSelectedItems());
+
+	list.SetAllSelected(true);
+	EXPECT_EQ(5U, list.GetNumSelected());
+
+	list.RemoveItems({ 0 });
+	EXPECT_EQ(4U, list.GetNumSelected());
+	EXPECT_FALSE(list.IsItemSelected(0));
+
+	list.SetAllSelected(false);
+	EXPECT_EQ(0U, list.GetNumSelected());
+}
+
+TEST(VirtualItemListTest, LargeFolder)
+{
+	SyntheticItems items(NUM_SYNTHETIC_ITEMS);
+	const auto &sizes = items.sizes;
+
+	VirtualItemList list;
+	list.SetSortOrder([&sizes] (int id1, int id2) {
+		return sizes[id1] < sizes[id2];
+	});
+
+	// Add the items in several batches, as happens during enumeration.
+	const size_t BATCH_SIZE = NUM_SYNTHETIC_ITEMS / 8;
+
+	for (size_t i = 0; i < items.ids.size(); i += BATCH_SIZE)
+	{
+		list.AddItems({ items.ids.begin() + i, items.ids.begin() + (std::min)(i + BATCH_SIZE, items.ids.size()) });
+	}
+
+	ASSERT_EQ(static_cast<size_t>(NUM_SYNTHETIC_ITEMS), list.GetNumRows());
+
+	for (size_t i = 1; i < list.GetNumRows(); i++)
+	{
+		ASSERT_LE(sizes[list.GetItemAtRow(i - 1)], sizes[list.GetItemAtRow(i)]);
+	}
+
+	list.SetFilter([&sizes] (int id) {
+		return sizes[id] % 4 != 0;
+	});
+	list.SetGrouping([&sizes] (int id) {
+		return sizes[id] % 10;
+	});
+
+	size_t numVisible = std::count_if(sizes.begin(), sizes.end(), [] (int size) {
+		return size % 4 != 0;
+	});
+	ASSERT_EQ(numVisible, list.GetNumRows());
+
+	size_t numGroupedRows = 0;
+
+	for (const auto &group : list.GetGroups())
+	{
+		ASSERT_EQ(numGroupedRows, group.firstRow);
+
+		for (size_t row = group.firstRow; row < group.firstRow + group.numRows; row++)
+		{
+			int id = list.GetItemAtRow(row);
+			ASSERT_EQ(group.key, sizes[id] % 10);
+			ASSERT_EQ(row, list.GetRowForItem(id));
+
+			if (row > group.firstRow)
+			{
+				ASSERT_LE(sizes[list.GetItemAtRow(row - 1)], sizes[id]);
+			}
+		}
+
+		numGroupedRows += group.numRows;
+	}
+
+	EXPECT_EQ(list.GetNumRows(), numGroupedRows);
+
+	list.SetRowRangeSelected(0, list.GetNumRows() - 1, true);
+	EXPECT_EQ(list.GetNumRows(), list.GetNumSelected());
+
+	list.RemoveFilter();
+	EXPECT_EQ(numVisible, list.GetNumSelected());
+}
+
+TEST(VirtualItemListTest, DISABLED_Benchmark)
+{
+	SyntheticItems items(NUM_SYNTHETIC_ITEMS);
+	const auto &sizes = items.sizes;
+
+	auto toMilliseconds = [] (auto duration) {
+		return static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+	};
+
+	auto time = [&toMilliseconds] (const char *description, auto function) {
+		auto start = std::chrono::steady_clock::now();
+		function();
+		std::cout << description << ": " << toMilliseconds(std::chrono::steady_clock::now() - start) << " ms\n";
+	};
+
+	VirtualItemList list;
+
+	time("Add", [&] {
+		list.AddItems(items.ids);
+	});
+
+	time("Sort", [&] {
+		list.SetSortOrder([&sizes] (int id1, int id2) {
+			return sizes[id1] < sizes[id2];
+		});
+	});
+
+	time("Filter", [&] {
+		list.SetFilter([&sizes] (int id) {
+			return sizes[id] % 2 == 0;
+		});
+	});
+
+	time("Group", [&] {
+		list.SetGrouping([&sizes] (int id) {
+			return sizes[id] / 100000;
+		});
+	});
+
+	time("Select all", [&] {
+		list.SetAllSelected(true);
+	});
+
+	time("Get selected items", [&] {
+		EXPECT_EQ(list.GetNumRows(), list.GetSelectedItems().size());
+	});
+
+	std::cout << NUM_SYNTHETIC_ITEMS << " items, " << list.GetNumRows() << " rows, " << list.GetGroups().size()
+		<< " groups\n";
+}